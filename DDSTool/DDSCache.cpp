@@ -0,0 +1,372 @@
+#include"DDSCache.h"
+#include"DDSParser.h"
+#include"JobSystem.h"
+#include"NullDevice.h"
+#include"TextureCache.h"
+
+#include<algorithm>
+#include<cstdio>
+#include<cstdlib>
+#include<fstream>
+#include<string>
+#include<vector>
+
+namespace
+{
+	const UINT SIZE = 64;
+
+	enum CacheFile
+	{
+		FILE_A,
+		FILE_SAME_AS_A,		//The bytes of FILE_A under another name
+		FILE_B,				//The size of FILE_A, other texels
+		FILE_C,
+		FILE_ONE_LEVEL,
+		FILE_COUNT
+	};
+
+	struct CacheTexture
+	{
+		std::wstring FileName;
+		UINT MipCount;
+		size_t Bytes;
+	};
+
+	//Every texel of every level set to fill
+	bool WriteTexture(const std::string& fileName, UINT mipCount, uint8_t fill, CacheTexture& t)
+	{
+		DirectX::DDSTextureInfo info = {};
+		info.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+		info.width = SIZE;
+		info.height = SIZE;
+		info.depth = 1;
+		info.mipLevels = mipCount;
+		info.arraySize = 1;
+		info.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		info.isCubeMap = false;
+		info.alphaMode = DDS_ALPHA_MODE_UNKNOWN;
+
+		std::vector<std::vector<uint8_t> > levels(mipCount);
+		std::vector<DirectX::DDSSubresource> subresources(mipCount);
+		t.Bytes = 0;
+		for (UINT mip = 0; mip < mipCount; ++mip)
+		{
+			UINT size = std::max(SIZE >> mip, 1u);
+			levels[mip].assign(size_t(size)*size * 4, fill);
+			t.Bytes += levels[mip].size();
+
+			DirectX::DDSSubresource& sub = subresources[mip];
+			sub.pData = levels[mip].data();
+			sub.offset = 0;
+			sub.rowPitch = size * 4;
+			sub.slicePitch = size_t(size)*size * 4;
+			sub.width = size;
+			sub.height = size;
+			sub.depth = 1;
+		}
+
+		std::vector<uint8_t> ddsData;
+		if (FAILED(DirectX::WriteDDS(info, subresources, ddsData)))
+		{
+			printf("%s: cannot build the texture\n", fileName.c_str());
+			return false;
+		}
+
+		std::ofstream out(fileName.c_str(), std::ios::binary);
+		out.write(reinterpret_cast<const char*>(ddsData.data()), ddsData.size());
+		if (!out)
+		{
+			printf("%s: cannot write\n", fileName.c_str());
+			return false;
+		}
+
+		std::vector<wchar_t> wide(fileName.size() + 1);
+		size_t length = mbstowcs(wide.data(), fileName.c_str(), wide.size());
+		if (length == static_cast<size_t>(-1))
+		{
+			printf("%s: cannot convert the name\n", fileName.c_str());
+			return false;
+		}
+		t.FileName.assign(wide.data(), length);
+		t.MipCount = mipCount;
+
+		return true;
+	}
+
+	UINT ViewMipCount(ID3D11ShaderResourceView* view)
+	{
+		ID3D11Resource* resource = 0;
+		view->GetResource(&resource);
+		D3D11_TEXTURE2D_DESC desc;
+		static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+		resource->Release();
+		return desc.MipLevels;
+	}
+
+	//Returns what is wrong, 0 when nothing is
+	const char* CheckCache(const TextureCache& cache, const TextureCache::Stats& expected,
+		char* message, size_t messageSize)
+	{
+		TextureCache::Stats stats;
+		cache.GetStats(stats);
+
+		if (stats.TextureCount != expected.TextureCount || stats.ReferencedCount != expected.ReferencedCount)
+		{
+			snprintf(message, messageSize, "%u textures, %u of them held, expected %u and %u",
+				stats.TextureCount, stats.ReferencedCount, expected.TextureCount, expected.ReferencedCount);
+			return message;
+		}
+		if (stats.PathHits != expected.PathHits || stats.ContentHits != expected.ContentHits || stats.Loads != expected.Loads)
+		{
+			snprintf(message, messageSize, "%u path hits, %u content hits and %u loads, expected %u, %u and %u",
+				stats.PathHits, stats.ContentHits, stats.Loads, expected.PathHits, expected.ContentHits, expected.Loads);
+			return message;
+		}
+		if (stats.Evictions != expected.Evictions)
+		{
+			snprintf(message, messageSize, "%u evictions, expected %u", stats.Evictions, expected.Evictions);
+			return message;
+		}
+		if (stats.ResidentBytes != expected.ResidentBytes)
+		{
+			snprintf(message, messageSize, "%u resident bytes, expected %u",
+				static_cast<unsigned>(stats.ResidentBytes), static_cast<unsigned>(expected.ResidentBytes));
+			return message;
+		}
+		return 0;
+	}
+
+	//Returns what is wrong, 0 when nothing is
+	const char* RunChecks(ID3D11Device* device, const std::vector<CacheTexture>& files,
+		char* message, size_t messageSize)
+	{
+		const size_t fullBytes = files[FILE_A].Bytes;
+
+		TextureCache cache;
+		cache.Init(device, ~size_t(0));
+
+		TextureCache::Stats expected = {};
+		const char* problem = 0;
+
+		//By path and by contents
+		TextureCache::TextureHandle a = cache.Acquire(files[FILE_A].FileName);
+		if (!a)
+			return "the first file cannot be acquired";
+		expected.TextureCount = expected.ReferencedCount = expected.Loads = 1;
+		expected.ResidentBytes = fullBytes;
+
+		if (cache.Acquire(files[FILE_A].FileName) != a)
+			return "the same path gave another texture";
+		++expected.PathHits;
+
+		if (cache.Acquire(files[FILE_SAME_AS_A].FileName) != a)
+			return "a copy of a file gave another texture";
+		++expected.ContentHits;
+
+		if (cache.Acquire(files[FILE_SAME_AS_A].FileName) != a)
+			return "the path of a copy gave another texture";
+		++expected.PathHits;
+
+		TextureCache::TextureHandle b = cache.Acquire(files[FILE_B].FileName);
+		if (!b || b == a)
+			return "a file of the same size and other texels shares a texture";
+		++expected.TextureCount;
+		++expected.ReferencedCount;
+		++expected.Loads;
+		expected.ResidentBytes += fullBytes;
+
+		TextureCache::TextureHandle one = cache.Acquire(files[FILE_ONE_LEVEL].FileName);
+		if (!one)
+			return "the single level file cannot be acquired";
+		++expected.TextureCount;
+		++expected.ReferencedCount;
+		++expected.Loads;
+		expected.ResidentBytes += files[FILE_ONE_LEVEL].Bytes;
+
+		if ((problem = CheckCache(cache, expected, message, messageSize)) != 0)
+			return problem;
+
+		//Every level of the file and no more
+		if (cache.GetSize(a) != fullBytes || ViewMipCount(cache.GetView(a)) != files[FILE_A].MipCount)
+			return "the mipped texture does not hold its levels";
+		if (cache.GetSize(one) != files[FILE_ONE_LEVEL].Bytes || ViewMipCount(cache.GetView(one)) != 1)
+			return "the single level texture does not hold one level";
+
+		//Held four times: nothing goes, even without a budget
+		cache.Release(a);
+		cache.Release(a);
+		cache.Release(a);
+		cache.SetBudget(0);
+		if ((problem = CheckCache(cache, expected, message, messageSize)) != 0)
+			return problem;
+
+		cache.Release(a);
+		--expected.TextureCount;
+		--expected.ReferencedCount;
+		++expected.Evictions;
+		expected.ResidentBytes -= fullBytes;
+		if ((problem = CheckCache(cache, expected, message, messageSize)) != 0)
+			return problem;
+		if (cache.GetView(a))
+			return "an evicted texture still has a view";
+
+		//Both paths went with the texture
+		cache.SetBudget(~size_t(0));
+		TextureCache::TextureHandle copy = cache.Acquire(files[FILE_SAME_AS_A].FileName);
+		TextureCache::TextureHandle c = cache.Acquire(files[FILE_C].FileName);
+		if (!copy || !c)
+			return "files cannot be acquired again";
+		expected.TextureCount += 2;
+		expected.ReferencedCount += 2;
+		expected.Loads += 2;
+		expected.ResidentBytes += 2 * fullBytes;
+		if ((problem = CheckCache(cache, expected, message, messageSize)) != 0)
+			return problem;
+
+		//Released c, copy, b: a budget for one more than the single level
+		//texture keeps b, the last released
+		cache.Release(c);
+		cache.Release(copy);
+		cache.Release(b);
+		expected.ReferencedCount -= 3;
+		if ((problem = CheckCache(cache, expected, message, messageSize)) != 0)
+			return problem;
+
+		cache.SetBudget(files[FILE_ONE_LEVEL].Bytes + fullBytes);
+		expected.TextureCount -= 2;
+		expected.Evictions += 2;
+		expected.ResidentBytes -= 2 * fullBytes;
+		if ((problem = CheckCache(cache, expected, message, messageSize)) != 0)
+			return problem;
+		if (cache.GetView(c) || cache.GetView(copy) || !cache.GetView(b))
+			return "the least recently released textures were not the ones evicted";
+
+		if (cache.Acquire(files[FILE_B].FileName) != b)
+			return "a cached texture was not served by path";
+		++expected.ReferencedCount;
+		++expected.PathHits;
+		if ((problem = CheckCache(cache, expected, message, messageSize)) != 0)
+			return problem;
+
+		//The cache gives its views back
+		ID3D11ShaderResourceView* view = cache.GetView(b);
+		view->AddRef();
+		cache.Release(b);
+		cache.Release(one);
+		cache.Flush();
+		expected.TextureCount = expected.ReferencedCount = 0;
+		expected.Evictions += 2;
+		expected.ResidentBytes = 0;
+		if ((problem = CheckCache(cache, expected, message, messageSize)) != 0)
+		{
+			view->Release();
+			return problem;
+		}
+		if (view->Release() != 0)
+			return "a flushed texture kept its view";
+
+		return 0;
+	}
+
+	//Returns what is wrong, 0 when nothing is
+	const char* RunThreads(ID3D11Device* device, const std::vector<CacheTexture>& files,
+		char* message, size_t messageSize)
+	{
+		const UINT ACQUIRES = 4096;
+
+		TextureCache cache;
+		cache.Init(device, 0);
+
+		std::vector<TextureCache::TextureHandle> handles(ACQUIRES);
+		JobSystem::Default().ParallelFor(ACQUIRES, 16, [&](UINT begin, UINT end, UINT)
+		{
+			for (UINT i = begin; i < end; ++i)
+				handles[i] = cache.Acquire(files[i % FILE_COUNT].FileName);
+		});
+
+		TextureCache::Stats stats;
+		cache.GetStats(stats);
+		if (stats.PathHits + stats.ContentHits + stats.Loads != ACQUIRES)
+		{
+			snprintf(message, messageSize, "%u path hits, %u content hits and %u loads for %u acquires",
+				stats.PathHits, stats.ContentHits, stats.Loads, ACQUIRES);
+			return message;
+		}
+
+		for (UINT i = 0; i < ACQUIRES; ++i)
+		{
+			if (!handles[i] || handles[i] != handles[i % FILE_COUNT])
+			{
+				snprintf(message, messageSize, "acquire %u of file %u gave texture %u, the first %u",
+					i, i % FILE_COUNT, handles[i], handles[i % FILE_COUNT]);
+				return message;
+			}
+		}
+
+		//With no budget every texture goes with its last reference
+		for (UINT i = 0; i < ACQUIRES; ++i)
+			cache.Release(handles[i]);
+
+		cache.GetStats(stats);
+		if (stats.TextureCount != 0 || stats.ResidentBytes != 0 || stats.Evictions != stats.Loads)
+		{
+			snprintf(message, messageSize, "%u textures and %u bytes left, %u evicted of %u loaded",
+				stats.TextureCount, static_cast<unsigned>(stats.ResidentBytes), stats.Evictions, stats.Loads);
+			return message;
+		}
+		return 0;
+	}
+}
+
+int RunCache(int argc, char* argv[])
+{
+	if (argc != 1)
+	{
+		printf("usage: DDSTool cache directory\n");
+		return 1;
+	}
+
+	static const char* names[FILE_COUNT] = { "a", "same-as-a", "b", "c", "one-level" };
+
+	std::vector<CacheTexture> files(FILE_COUNT);
+	UINT mipCount = 1;
+	while ((SIZE >> (mipCount - 1)) > 1)
+		++mipCount;
+
+	for (UINT i = 0; i < FILE_COUNT; ++i)
+	{
+		std::string fileName = std::string(argv[0]) + "/cache-" + names[i] + ".dds";
+		UINT mips = (i == FILE_ONE_LEVEL) ? 1 : mipCount;
+		uint8_t fill = static_cast<uint8_t>(i == FILE_SAME_AS_A ? FILE_A : i);
+		if (!WriteTexture(fileName, mips, fill, files[i]))
+			return 1;
+	}
+
+	NullDevice* device = 0;
+	ID3D11DeviceContext* context = 0;
+	IDXGISwapChain* swapChain = 0;
+	NullDevice::Create(1, 1, &device, &context, &swapChain);
+
+	char message[256];
+	const char* problem = RunChecks(device, files, message, sizeof(message));
+	if (problem)
+	{
+		printf("cache: %s\n", problem);
+	}
+	else
+	{
+		problem = RunThreads(device, files, message, sizeof(message));
+		if (problem)
+			printf("cache from all workers: %s\n", problem);
+	}
+
+	ReleaseCOM(swapChain);
+	ReleaseCOM(context);
+	ReleaseCOM(device);
+
+	if (problem)
+		return 1;
+
+	printf("path hits, shared contents, references and eviction order checks passed\n");
+	return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+//DDSTool cache directory
+//
+//Writes a few small RGBA8 textures into directory, two of them with the same
+//bytes under different names, and loads them through TextureCache on a
+//NullDevice, so it needs no display adapter. Checks that a path seen before
+//is served from the cache, that files of the same bytes share one texture
+//and files of the same size do not, that textures stay cached while held
+//and go least recently released first once the budget drops, that single
+//level files keep one level, and that the cache gives the views back. Then
+//the files are acquired from all workers at once and the references are
+//checked to balance. Exits with 1 when a check fails.
+
+#ifndef _DDSCACHE_H_
+#define _DDSCACHE_H_
+
+int RunCache(int argc, char* argv[]);
+
+#endif
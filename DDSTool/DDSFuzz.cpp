@@ -0,0 +1,734 @@
+#include"DDSFuzz.h"
+#include"DDSParser.h"
+#include"JobSystem.h"
+#include"MappedFile.h"
+
+#include<algorithm>
+#include<chrono>
+#include<climits>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
+#include<map>
+#include<memory>
+#include<random>
+#include<string>
+#include<vector>
+
+namespace
+{
+	typedef std::vector<std::vector<uint8_t>> Corpus;
+
+	const size_t MAX_MIP_LEVELS = 15;
+
+	//Textures up to this size are also written back out and parsed again
+	const size_t MAX_ROUND_TRIP_BYTES = 1 << 20;
+
+	//Magic number, DDS_HEADER and DDS_HEADER_DXT10, where mutations go
+	const size_t HEADERS_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+
+	//Field offsets from the start of the file
+	const size_t OFFSET_FLAGS = 8;
+	const size_t OFFSET_HEIGHT = 12;
+	const size_t OFFSET_WIDTH = 16;
+	const size_t OFFSET_DEPTH = 24;
+	const size_t OFFSET_MIPS = 28;
+	const size_t OFFSET_PIXELFORMAT_FLAGS = 80;
+	const size_t OFFSET_CAPS2 = 112;
+	const size_t OFFSET_DXGI_FORMAT = 128;
+	const size_t OFFSET_DIMENSION = 132;
+	const size_t OFFSET_MISC = 136;
+	const size_t OFFSET_ARRAY_SIZE = 140;
+
+	const uint32_t InterestingValues[] =
+	{
+		0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 13, 14, 15, 16, 17, 31, 255, 256, 1023, 1024,
+		2047, 2048, 2049, 4096, 8192, 16383, 16384, 16385, 65535, 65536, 0x7fffffff,
+		0x80000000, 0xfffffffe, 0xffffffff, MAKEFOURCC('D', 'X', '1', '0'),
+		DDS_CUBEMAP_ALLFACES, DDS_HEADER_FLAGS_VOLUME, DDS_FLAGS_VOLUME
+	};
+
+	bool IsLarger(const DirectX::DDSSubresource& sub, size_t maxSize)
+	{
+		return sub.width > maxSize || sub.height > maxSize || sub.depth > maxSize;
+	}
+
+	//Everything the loaders rely on once ParseDDS succeeded, returns the
+	//problem found or null. parsed tells whether the input was accepted.
+	const char* CheckDDS(const uint8_t* data, size_t size, bool& parsed)
+	{
+		DirectX::DDSTextureInfo info;
+		std::vector<DirectX::DDSSubresource> subresources;
+		parsed = SUCCEEDED(DirectX::ParseDDS(data, size, info, subresources));
+		if (!parsed)
+			return subresources.empty() ? nullptr : "table left over after a failed parse";
+
+		if (info.headerSize > size)
+			return "headers larger than the input";
+		if (!info.width || !info.height || !info.depth || !info.arraySize
+			|| !info.mipLevels || info.mipLevels > MAX_MIP_LEVELS)
+			return "texture size out of range";
+		if ((info.isCubeMap && info.arraySize % 6)
+			|| (info.resourceDimension == DDS_DIMENSION_TEXTURE3D ? info.arraySize != 1 : info.depth != 1))
+			return "dimension and size disagree";
+		if (subresources.size() != info.mipLevels*info.arraySize)
+			return "table size is not mips times slices";
+
+		//Reads the first and last byte of every subresource, so a sanitizer
+		//build traps on a table the checks below let through
+		volatile uint8_t touched = 0;
+
+		uint64_t offset = info.headerSize;
+		for (size_t slice = 0; slice < info.arraySize; ++slice)
+		{
+			for (size_t mip = 0; mip < info.mipLevels; ++mip)
+			{
+				const DirectX::DDSSubresource& sub = subresources[DirectX::CalcDDSSubresource(mip, slice, info.mipLevels)];
+				if (sub.width != std::max<size_t>(info.width >> mip, 1)
+					|| sub.height != std::max<size_t>(info.height >> mip, 1)
+					|| sub.depth != std::max<size_t>(info.depth >> mip, 1))
+					return "mip size is not a halving of the top level";
+
+				size_t numBytes = 0;
+				size_t rowBytes = 0;
+				size_t numRows = 0;
+				DirectX::GetSurfaceInfo(sub.width, sub.height, info.format, &numBytes, &rowBytes, &numRows);
+				if (sub.rowPitch != rowBytes || sub.slicePitch != numBytes)
+					return "pitch differs from GetSurfaceInfo";
+				if (!rowBytes || !numRows || static_cast<uint64_t>(rowBytes)*numRows > numBytes)
+					return "rows do not fit the slice pitch";
+				if (sub.rowPitch > UINT_MAX || sub.slicePitch > UINT_MAX)
+					return "pitch does not fit D3D11_SUBRESOURCE_DATA";
+
+				if (sub.offset != offset)
+					return "subresources are not contiguous";
+				const uint64_t bytes = static_cast<uint64_t>(sub.slicePitch)*sub.depth;
+				if (bytes > size - offset)
+					return "subresource past the end of the input";
+				if (sub.pData != data + sub.offset)
+					return "pointer and offset disagree";
+
+				touched ^= sub.pData[0];
+				touched ^= sub.pData[bytes - 1];
+				offset += bytes;
+			}
+		}
+		const size_t end = static_cast<size_t>(offset);
+
+		//The streamer's table from the headers alone, exact at the end
+		std::vector<DirectX::DDSSubresource> offsets;
+		if (FAILED(DirectX::GetDDSSubresources(info, nullptr, size, offsets)) || offsets.size() != subresources.size())
+			return "offset table differs from the parsed one";
+		for (size_t i = 0; i < offsets.size(); ++i)
+		{
+			if (offsets[i].pData || offsets[i].offset != subresources[i].offset
+				|| offsets[i].rowPitch != subresources[i].rowPitch || offsets[i].slicePitch != subresources[i].slicePitch)
+				return "offset table differs from the parsed one";
+		}
+		if (SUCCEEDED(DirectX::GetDDSSubresources(info, nullptr, end - 1, offsets)) || !offsets.empty())
+			return "table accepted for an input one byte short";
+
+		//What FillInitData and the feature level retry take from the table
+		const size_t maxSizes[] = { 1, 2, 16, 256, 2048, 4096, 8192, 16384 };
+		for (size_t maxSize : maxSizes)
+		{
+			size_t skip = DirectX::CountSkippedMips(info, maxSize);
+			if (skip > info.mipLevels)
+				return "skipped more mips than there are";
+			if (info.mipLevels == 1)
+			{
+				if (skip)
+					return "skipped the only mip";
+				continue;
+			}
+			if (skip < info.mipLevels && IsLarger(subresources[skip], maxSize))
+				return "kept a mip larger than maxsize";
+			if (skip > 0 && !IsLarger(subresources[skip - 1], maxSize))
+				return "skipped a mip that fits maxsize";
+		}
+
+		if (end - info.headerSize <= MAX_ROUND_TRIP_BYTES)
+		{
+			std::vector<uint8_t> written;
+			if (FAILED(DirectX::WriteDDS(info, subresources, written)))
+				return "WriteDDS rejected a parsed texture";
+
+			DirectX::DDSTextureInfo writtenInfo;
+			std::vector<DirectX::DDSSubresource> writtenSubresources;
+			if (FAILED(DirectX::ParseDDS(written.data(), written.size(), writtenInfo, writtenSubresources)))
+				return "written texture does not parse";
+			if (writtenInfo.resourceDimension != info.resourceDimension || writtenInfo.width != info.width
+				|| writtenInfo.height != info.height || writtenInfo.depth != info.depth
+				|| writtenInfo.mipLevels != info.mipLevels || writtenInfo.arraySize != info.arraySize
+				|| writtenInfo.format != info.format || writtenInfo.isCubeMap != info.isCubeMap
+				|| writtenInfo.alphaMode != info.alphaMode)
+				return "written texture differs in its description";
+			if (written.size() - writtenInfo.headerSize != end - info.headerSize)
+				return "written texture differs in size";
+			for (size_t i = 0; i < subresources.size(); ++i)
+			{
+				if (memcmp(writtenSubresources[i].pData, subresources[i].pData, subresources[i].slicePitch*subresources[i].depth) != 0)
+					return "written texture differs in its texels";
+			}
+		}
+
+		(void)touched;
+		return nullptr;
+	}
+
+	bool CheckDDS(const std::vector<uint8_t>& input, const char*& problem)
+	{
+		//An exact copy, so a sanitizer sees reads past the end
+		std::unique_ptr<uint8_t[]> exact(new uint8_t[input.size()]);
+		if (!input.empty())
+			memcpy(exact.get(), input.data(), input.size());
+
+		bool parsed = false;
+		problem = CheckDDS(input.empty() ? nullptr : exact.get(), input.size(), parsed);
+		return parsed;
+	}
+
+	DDS_HEADER MakeHeader(uint32_t width, uint32_t height, uint32_t mips)
+	{
+		DDS_HEADER header = {};
+		header.size = sizeof(DDS_HEADER);
+		header.flags = DDS_HEADER_FLAGS_TEXTURE | (mips > 1 ? DDS_HEADER_FLAGS_MIPMAP : 0);
+		header.width = width;
+		header.height = height;
+		header.mipMapCount = mips;
+		header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+		header.caps = DDS_SURFACE_FLAGS_TEXTURE | (mips > 1 ? DDS_SURFACE_FLAGS_MIPMAP : 0);
+		return header;
+	}
+
+	//The headers plus a body of exactly the size the parser expects
+	void AddSeed(const DDS_HEADER& header, const DDS_HEADER_DXT10* ext, Corpus& corpus)
+	{
+		std::vector<uint8_t> file(sizeof(uint32_t) + sizeof(DDS_HEADER) + (ext ? sizeof(DDS_HEADER_DXT10) : 0));
+		const uint32_t magic = DDS_MAGIC;
+		memcpy(file.data(), &magic, sizeof(uint32_t));
+		memcpy(file.data() + sizeof(uint32_t), &header, sizeof(DDS_HEADER));
+		if (ext)
+			memcpy(file.data() + sizeof(uint32_t) + sizeof(DDS_HEADER), ext, sizeof(DDS_HEADER_DXT10));
+
+		DirectX::DDSTextureInfo info;
+		std::vector<DirectX::DDSSubresource> subresources;
+		if (FAILED(DirectX::ParseDDSHeader(file.data(), file.size(), info))
+			|| FAILED(DirectX::GetDDSSubresources(info, nullptr, SIZE_MAX, subresources)))
+			return;
+
+		const DirectX::DDSSubresource& last = subresources.back();
+		const size_t size = last.offset + last.slicePitch*last.depth;
+		file.resize(size);
+		for (size_t i = info.headerSize; i < size; ++i)
+			file[i] = static_cast<uint8_t>(i * 31 + 7);
+
+		corpus.push_back(file);
+	}
+
+	void AddLegacySeed(uint32_t flags, uint32_t fourCC, uint32_t bitCount,
+		uint32_t r, uint32_t g, uint32_t b, uint32_t a, Corpus& corpus)
+	{
+		DDS_HEADER header = MakeHeader(32, 16, 6);
+		header.ddspf.flags = flags;
+		header.ddspf.fourCC = fourCC;
+		header.ddspf.RGBBitCount = bitCount;
+		header.ddspf.RBitMask = r;
+		header.ddspf.GBitMask = g;
+		header.ddspf.BBitMask = b;
+		header.ddspf.ABitMask = a;
+		AddSeed(header, nullptr, corpus);
+	}
+
+	void AddDX10Seed(DXGI_FORMAT format, uint32_t dimension, uint32_t width, uint32_t height, uint32_t depth,
+		uint32_t mips, uint32_t arraySize, bool cube, uint32_t alphaMode, Corpus& corpus)
+	{
+		DDS_HEADER header = MakeHeader(width, height, mips);
+		header.ddspf.flags = DDS_FOURCC;
+		header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+
+		DDS_HEADER_DXT10 ext = {};
+		ext.dxgiFormat = format;
+		ext.resourceDimension = dimension;
+		ext.arraySize = arraySize;
+		ext.miscFlags2 = alphaMode;
+		if (dimension == DDS_DIMENSION_TEXTURE3D)
+		{
+			header.flags |= DDS_HEADER_FLAGS_VOLUME;
+			header.depth = depth;
+			header.caps2 = DDS_FLAGS_VOLUME;
+		}
+		if (cube)
+		{
+			header.caps |= DDS_SURFACE_FLAGS_CUBEMAP;
+			header.caps2 = DDS_CUBEMAP_ALLFACES;
+			ext.miscFlag = DDS_RESOURCE_MISC_TEXTURECUBE;
+		}
+		AddSeed(header, &ext, corpus);
+	}
+
+	//Every pixel format the legacy header maps, every dimension of the DX10
+	//one and the layouts with their own size rules, all small
+	void MakeCorpus(Corpus& corpus)
+	{
+		AddLegacySeed(DDS_RGB, 0, 32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000, corpus);
+		AddLegacySeed(DDS_RGB, 0, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000, corpus);
+		AddLegacySeed(DDS_RGB, 0, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000, corpus);
+		AddLegacySeed(DDS_RGB, 0, 32, 0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000, corpus);
+		AddLegacySeed(DDS_RGB, 0, 32, 0x0000ffff, 0xffff0000, 0x00000000, 0x00000000, corpus);
+		AddLegacySeed(DDS_RGB, 0, 32, 0xffffffff, 0x00000000, 0x00000000, 0x00000000, corpus);
+		AddLegacySeed(DDS_RGB, 0, 16, 0x7c00, 0x03e0, 0x001f, 0x8000, corpus);
+		AddLegacySeed(DDS_RGB, 0, 16, 0xf800, 0x07e0, 0x001f, 0x0000, corpus);
+		AddLegacySeed(DDS_RGB, 0, 16, 0x0f00, 0x00f0, 0x000f, 0xf000, corpus);
+		AddLegacySeed(DDS_LUMINANCE, 0, 8, 0xff, 0, 0, 0, corpus);
+		AddLegacySeed(DDS_LUMINANCE, 0, 16, 0xffff, 0, 0, 0, corpus);
+		AddLegacySeed(DDS_LUMINANCE, 0, 16, 0x00ff, 0, 0, 0xff00, corpus);
+		AddLegacySeed(DDS_ALPHA, 0, 8, 0, 0, 0, 0xff, corpus);
+		AddLegacySeed(DDS_BUMPDUDV, 0, 16, 0x00ff, 0xff00, 0, 0, corpus);
+		AddLegacySeed(DDS_BUMPDUDV, 0, 32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000, corpus);
+
+		const uint32_t fourCCs[] =
+		{
+			MAKEFOURCC('D', 'X', 'T', '1'), MAKEFOURCC('D', 'X', 'T', '2'), MAKEFOURCC('D', 'X', 'T', '3'),
+			MAKEFOURCC('D', 'X', 'T', '4'), MAKEFOURCC('D', 'X', 'T', '5'), MAKEFOURCC('A', 'T', 'I', '1'),
+			MAKEFOURCC('B', 'C', '4', 'S'), MAKEFOURCC('A', 'T', 'I', '2'), MAKEFOURCC('B', 'C', '5', 'S'),
+			MAKEFOURCC('R', 'G', 'B', 'G'), MAKEFOURCC('G', 'R', 'G', 'B'), MAKEFOURCC('Y', 'U', 'Y', '2'),
+			36, 110, 111, 112, 113, 114, 115, 116
+		};
+		for (uint32_t fourCC : fourCCs)
+			AddLegacySeed(DDS_FOURCC, fourCC, 0, 0, 0, 0, 0, corpus);
+
+		//Legacy shapes: single texel, odd sizes, no mip count, cube and volume
+		for (uint32_t fourCC : { 0u, MAKEFOURCC('D', 'X', 'T', '1') })
+		{
+			DDS_HEADER header = MakeHeader(1, 1, 1);
+			if (fourCC)
+			{
+				header.ddspf.flags = DDS_FOURCC;
+				header.ddspf.fourCC = fourCC;
+			}
+			else
+			{
+				header.ddspf.flags = DDS_RGB;
+				header.ddspf.RGBBitCount = 32;
+				header.ddspf.RBitMask = 0x000000ff;
+				header.ddspf.GBitMask = 0x0000ff00;
+				header.ddspf.BBitMask = 0x00ff0000;
+				header.ddspf.ABitMask = 0xff000000;
+			}
+			AddSeed(header, nullptr, corpus);
+
+			header.width = 5;
+			header.height = 3;
+			header.mipMapCount = 3;
+			AddSeed(header, nullptr, corpus);
+
+			header.width = 64;
+			header.height = 64;
+			header.mipMapCount = 0;
+			AddSeed(header, nullptr, corpus);
+
+			DDS_HEADER cube = MakeHeader(8, 8, 4);
+			cube.ddspf = header.ddspf;
+			cube.caps |= DDS_SURFACE_FLAGS_CUBEMAP;
+			cube.caps2 = DDS_CUBEMAP_ALLFACES;
+			AddSeed(cube, nullptr, corpus);
+
+			DDS_HEADER volume = MakeHeader(8, 8, 4);
+			volume.ddspf = header.ddspf;
+			volume.flags |= DDS_HEADER_FLAGS_VOLUME;
+			volume.depth = 4;
+			volume.caps2 = DDS_FLAGS_VOLUME;
+			AddSeed(volume, nullptr, corpus);
+		}
+
+		//DX10 formats with their own size rules, planar ones on even heights
+		const DXGI_FORMAT formats[] =
+		{
+			DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_R32G32B32_FLOAT,
+			DXGI_FORMAT_R9G9B9E5_SHAREDEXP, DXGI_FORMAT_R1_UNORM, DXGI_FORMAT_BC1_UNORM_SRGB,
+			DXGI_FORMAT_BC6H_UF16, DXGI_FORMAT_BC7_UNORM, DXGI_FORMAT_YUY2, DXGI_FORMAT_Y210,
+			DXGI_FORMAT_B5G6R5_UNORM, DXGI_FORMAT_R16_FLOAT
+		};
+		for (DXGI_FORMAT format : formats)
+			AddDX10Seed(format, DDS_DIMENSION_TEXTURE2D, 16, 8, 1, 5, 1, false, 0, corpus);
+
+		const DXGI_FORMAT planarFormats[] =
+		{
+			DXGI_FORMAT_NV12, DXGI_FORMAT_P010, DXGI_FORMAT_P016, DXGI_FORMAT_420_OPAQUE, DXGI_FORMAT_NV11
+		};
+		for (DXGI_FORMAT format : planarFormats)
+			AddDX10Seed(format, DDS_DIMENSION_TEXTURE2D, 16, 8, 1, 1, 1, false, 0, corpus);
+
+		for (DXGI_FORMAT format : { DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_BC3_UNORM })
+		{
+			AddDX10Seed(format, DDS_DIMENSION_TEXTURE1D, 64, 1, 1, 7, 4, false, 0, corpus);
+			AddDX10Seed(format, DDS_DIMENSION_TEXTURE2D, 12, 12, 1, 4, 3, false, DirectX::DDS_ALPHA_MODE_PREMULTIPLIED, corpus);
+			AddDX10Seed(format, DDS_DIMENSION_TEXTURE2D, 8, 8, 1, 4, 2, true, 0, corpus);
+			AddDX10Seed(format, DDS_DIMENSION_TEXTURE3D, 16, 8, 8, 5, 1, false, 0, corpus);
+		}
+	}
+
+	void WriteField(std::vector<uint8_t>& input, size_t offset, uint32_t value)
+	{
+		if (offset + sizeof(uint32_t) <= input.size())
+			memcpy(input.data() + offset, &value, sizeof(uint32_t));
+	}
+
+	uint32_t ReadField(const std::vector<uint8_t>& input, size_t offset)
+	{
+		uint32_t value = 0;
+		if (offset + sizeof(uint32_t) <= input.size())
+			memcpy(&value, input.data() + offset, sizeof(uint32_t));
+		return value;
+	}
+
+	//Input number run of a fuzzing session, from its seed and run alone
+	void Mutate(const Corpus& corpus, uint32_t seed, uint32_t run, std::vector<uint8_t>& input)
+	{
+		std::seed_seq sequence = { seed, run };
+		std::mt19937 rng(sequence);
+
+		input = corpus[rng() % corpus.size()];
+
+		const size_t sizeFields[] = { OFFSET_HEIGHT, OFFSET_WIDTH, OFFSET_DEPTH, OFFSET_MIPS, OFFSET_ARRAY_SIZE };
+		const size_t interestingCount = sizeof(InterestingValues) / sizeof(InterestingValues[0]);
+
+		const uint32_t mutations = 1 + rng() % 4;
+		for (uint32_t m = 0; m < mutations; ++m)
+		{
+			const size_t headers = std::min(input.size(), HEADERS_SIZE);
+
+			switch (rng() % 8)
+			{
+			case 0:
+				if (headers)
+					input[rng() % headers] ^= static_cast<uint8_t>(1 << (rng() % 8));
+				break;
+
+			case 1:
+				if (headers)
+					input[rng() % headers] = static_cast<uint8_t>(rng());
+				break;
+
+			case 2:
+				WriteField(input, (rng() % (HEADERS_SIZE / 4)) * 4, InterestingValues[rng() % interestingCount]);
+				break;
+
+			case 3:
+			{
+				const size_t field = sizeFields[rng() % 5];
+				const uint32_t value = (rng() % 2) ? InterestingValues[rng() % interestingCount] : ReadField(input, field) + (rng() % 5) - 2;
+				WriteField(input, field, value);
+				break;
+			}
+
+			case 4:
+				WriteField(input, OFFSET_DXGI_FORMAT, rng() % (DXGI_FORMAT_B4G4R4A4_UNORM + 8));
+				if (rng() % 2)
+					WriteField(input, OFFSET_DIMENSION, rng() % 6);
+				break;
+
+			case 5:
+				if (!input.empty())
+					input.resize((rng() % 2) ? rng() % input.size() : input.size() - 1 - rng() % std::min<size_t>(input.size(), 16));
+				break;
+
+			case 6:
+				input.resize(input.size() + 1 + rng() % 64, static_cast<uint8_t>(rng()));
+				break;
+
+			case 7:
+			{
+				const size_t flagFields[] = { OFFSET_FLAGS, OFFSET_PIXELFORMAT_FLAGS, OFFSET_CAPS2, OFFSET_MISC };
+				const uint32_t flagBits[] =
+				{
+					DDS_HEADER_FLAGS_VOLUME | DDS_HEADER_FLAGS_MIPMAP | DDS_HEIGHT | DDS_WIDTH,
+					DDS_FOURCC | DDS_RGB | DDS_LUMINANCE | DDS_ALPHA | DDS_BUMPDUDV,
+					DDS_CUBEMAP_ALLFACES | DDS_FLAGS_VOLUME,
+					DDS_RESOURCE_MISC_TEXTURECUBE
+				};
+				const size_t which = rng() % 4;
+				WriteField(input, flagFields[which], ReadField(input, flagFields[which]) ^ (flagBits[which] & rng()));
+				break;
+			}
+			}
+		}
+	}
+
+	bool LoadFile(const char* fileName, Corpus& corpus)
+	{
+		MappedFile file;
+		if (!file.Open(fileName))
+		{
+			printf("%s: cannot open or empty\n", fileName);
+			return false;
+		}
+
+		corpus.push_back(std::vector<uint8_t>(file.Data(), file.Data() + file.Size()));
+		return true;
+	}
+
+	bool SaveFile(const std::string& fileName, const std::vector<uint8_t>& data)
+	{
+		std::ofstream out(fileName.c_str(), std::ios::binary);
+		out.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!out)
+		{
+			printf("%s: cannot write\n", fileName.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	struct Failure
+	{
+		uint32_t Run;
+		const char* Problem;
+	};
+
+	typedef HRESULT(*ParseFunction)(const uint8_t*, size_t, std::vector<DirectX::DDSSubresource>&);
+
+	HRESULT ParseHeader(const uint8_t* data, size_t size, std::vector<DirectX::DDSSubresource>&)
+	{
+		DirectX::DDSTextureInfo info;
+		return DirectX::ParseDDSHeader(data, size, info);
+	}
+
+	HRESULT ParseTable(const uint8_t* data, size_t size, std::vector<DirectX::DDSSubresource>& subresources)
+	{
+		DirectX::DDSTextureInfo info;
+		return DirectX::ParseDDS(data, size, info, subresources);
+	}
+
+	//Passes over the corpus until seconds went by, returns headers per second
+	double MeasureParse(const Corpus& corpus, ParseFunction parse, double seconds, bool threaded)
+	{
+		typedef std::chrono::high_resolution_clock Clock;
+
+		JobSystem& jobs = JobSystem::Default();
+		const UINT count = static_cast<UINT>(corpus.size());
+		const UINT grain = threaded ? 64 : count;
+
+		UINT64 headers = 0;
+		auto start = Clock::now();
+		std::chrono::duration<double> elapsed(0.0);
+		do
+		{
+			jobs.ParallelFor(count, grain, [&](UINT begin, UINT end, UINT)
+			{
+				std::vector<DirectX::DDSSubresource> subresources;
+				for (int pass = 0; pass < 16; ++pass)
+				{
+					for (UINT i = begin; i < end; ++i)
+						parse(corpus[i].data(), corpus[i].size(), subresources);
+				}
+			});
+
+			headers += 16 * static_cast<UINT64>(count);
+			elapsed = Clock::now() - start;
+		} while (elapsed.count() < seconds);
+
+		return headers / elapsed.count();
+	}
+}
+
+int RunFuzz(int argc, char* argv[])
+{
+	uint32_t runs = 100000;
+	uint32_t seed = 1;
+	const char* outDir = nullptr;
+	Corpus corpus;
+
+	for (int i = 0; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-runs") == 0 && i + 1 < argc)
+			runs = strtoul(argv[++i], 0, 10);
+		else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+			seed = strtoul(argv[++i], 0, 10);
+		else if (strcmp(argv[i], "-out") == 0 && i + 1 < argc)
+			outDir = argv[++i];
+		else if (!LoadFile(argv[i], corpus))
+			return 1;
+	}
+
+	const size_t fileCount = corpus.size();
+	MakeCorpus(corpus);
+
+	UINT failed = 0;
+	for (size_t i = 0; i < corpus.size(); ++i)
+	{
+		const char* problem = nullptr;
+		CheckDDS(corpus[i], problem);
+		if (problem)
+		{
+			printf("seed %u: %s\n", static_cast<unsigned>(i), problem);
+			++failed;
+		}
+	}
+
+	JobSystem& jobs = JobSystem::Default();
+	printf("fuzz: %u runs from %u seeds (%u files), seed %u, %u workers\n", runs, static_cast<unsigned>(corpus.size()),
+		static_cast<unsigned>(fileCount), seed, jobs.ThreadCount() + 1);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const UINT grain = 256;
+	std::vector<std::vector<Failure>> failures(jobs.ChunkCount(runs, grain));
+	std::vector<UINT> accepted(failures.size(), 0);
+	jobs.ParallelFor(runs, grain, [&](UINT begin, UINT end, UINT chunk)
+	{
+		std::vector<uint8_t> input;
+		for (UINT run = begin; run < end; ++run)
+		{
+			Mutate(corpus, seed, run, input);
+
+			const char* problem = nullptr;
+			if (CheckDDS(input, problem))
+				++accepted[chunk];
+			if (problem)
+				failures[chunk].push_back({ run, problem });
+		}
+	});
+
+	std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+
+	UINT acceptedTotal = 0;
+	std::map<std::string, UINT> problems;
+	for (size_t chunk = 0; chunk < failures.size(); ++chunk)
+	{
+		acceptedTotal += accepted[chunk];
+		for (const Failure& f : failures[chunk])
+		{
+			if (failed < 20)
+				printf("run %u: %s\n", f.Run, f.Problem);
+			++problems[f.Problem];
+			++failed;
+
+			if (outDir)
+			{
+				std::vector<uint8_t> input;
+				Mutate(corpus, seed, f.Run, input);
+				char fileName[64];
+				snprintf(fileName, sizeof(fileName), "/fuzz-%u-%u.dds", seed, f.Run);
+				SaveFile(std::string(outDir) + fileName, input);
+			}
+		}
+	}
+
+	printf("%.1f%% parsed, %u failures, %.0f runs/s\n", runs ? 100.0*acceptedTotal / runs : 0.0, failed,
+		runs / std::max(seconds.count(), 1e-9));
+	for (const auto& p : problems)
+		printf("  %6u  %s\n", p.second, p.first.c_str());
+
+	return failed ? 1 : 0;
+}
+
+int RunHeaderBench(int argc, char* argv[])
+{
+	double seconds = 0.5;
+	Corpus corpus;
+
+	for (int i = 0; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-seconds") == 0 && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else if (!LoadFile(argv[i], corpus))
+			return 1;
+	}
+	if (corpus.empty())
+		MakeCorpus(corpus);
+
+	Corpus valid;
+	for (const std::vector<uint8_t>& input : corpus)
+	{
+		DirectX::DDSTextureInfo info;
+		std::vector<DirectX::DDSSubresource> subresources;
+		if (SUCCEEDED(DirectX::ParseDDS(input.data(), input.size(), info, subresources)))
+			valid.push_back(input);
+	}
+
+	Corpus mutated(1024);
+	UINT mutatedParsed = 0;
+	for (uint32_t run = 0; run < mutated.size(); ++run)
+	{
+		Mutate(corpus, 1, run, mutated[run]);
+
+		DirectX::DDSTextureInfo info;
+		std::vector<DirectX::DDSSubresource> subresources;
+		if (SUCCEEDED(DirectX::ParseDDS(mutated[run].data(), mutated[run].size(), info, subresources)))
+			++mutatedParsed;
+	}
+
+	if (valid.empty())
+	{
+		printf("no valid DDS file given\n");
+		return 1;
+	}
+
+	printf("%u valid inputs, %u mutated (%.1f%% parsed), %u workers\n", static_cast<unsigned>(valid.size()),
+		static_cast<unsigned>(mutated.size()), 100.0*mutatedParsed / mutated.size(), JobSystem::Default().ThreadCount() + 1);
+	printf("%-24s %20s %20s\n", "", "1 thread", "threaded");
+
+	struct Case
+	{
+		const char* Name;
+		const Corpus* Inputs;
+		ParseFunction Parse;
+	};
+	const Case cases[] =
+	{
+		{ "valid, header", &valid, ParseHeader },
+		{ "valid, header + table", &valid, ParseTable },
+		{ "mutated, header", &mutated, ParseHeader },
+		{ "mutated, header + table", &mutated, ParseTable },
+	};
+
+	for (const Case& c : cases)
+	{
+		double single = MeasureParse(*c.Inputs, c.Parse, seconds, false);
+		double threaded = MeasureParse(*c.Inputs, c.Parse, seconds, true);
+		printf("%-24s %8.2f M/s %6.1f ns %8.2f M/s %6.1f ns\n", c.Name,
+			single / 1e6, 1e9 / single, threaded / 1e6, 1e9 / threaded);
+	}
+
+	return 0;
+}
+
+int RunCorpus(int argc, char* argv[])
+{
+	if (argc < 1)
+	{
+		printf("usage: DDSTool corpus directory\n");
+		return 1;
+	}
+
+	Corpus corpus;
+	MakeCorpus(corpus);
+
+	for (size_t i = 0; i < corpus.size(); ++i)
+	{
+		char fileName[32];
+		snprintf(fileName, sizeof(fileName), "/seed-%03u.dds", static_cast<unsigned>(i));
+		if (!SaveFile(std::string(argv[0]) + fileName, corpus[i]))
+			return 1;
+	}
+
+	printf("%s: %u seeds\n", argv[0], static_cast<unsigned>(corpus.size()));
+	return 0;
+}
+
+#if defined(DDS_LIBFUZZER)
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	bool parsed = false;
+	const char* problem = CheckDDS(data, size, parsed);
+	if (problem)
+	{
+		fprintf(stderr, "DDS check failed: %s\n", problem);
+		abort();
+	}
+	return 0;
+}
+#endif
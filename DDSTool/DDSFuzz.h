@@ -0,0 +1,36 @@
+#pragma once
+
+//DDSTool fuzz [-runs count] [-seed value] [-out directory] [seeds.dds...]
+//
+//Feeds mutated DDS headers to the device free parser and checks everything
+//the loaders take on trust after a successful parse: every subresource lies
+//inside the input, the table is contiguous and matches GetSurfaceInfo, the
+//pitches fit D3D11_SUBRESOURCE_DATA, maxsize skipping keeps a mip that fits
+//and WriteDDS gives back the same texture. Mutations start from a built in
+//corpus of legacy and DX10 headers plus any files given. Run i only depends
+//on the seed and i, so failures written to -out reproduce on any machine.
+//Exits with 1 when a check fails. Build with -fsanitize=address to also
+//catch reads past the input.
+//
+//DDSTool headerbench [-seconds time] [files...]
+//
+//Headers parsed per second over the corpus, header only and with the
+//subresource table, for valid files and for mutated, mostly rejected ones.
+//
+//DDSTool corpus directory
+//
+//Writes the built in corpus as seed files.
+//
+//With DDS_LIBFUZZER defined DDSFuzz.cpp also exports LLVMFuzzerTestOneInput
+//running the same checks, and builds without DDSTool.cpp:
+//	clang++ -g -O1 -fsanitize=fuzzer,address -DDDS_LIBFUZZER -IDXGeneral DDSTool/DDSFuzz.cpp
+//		DXGeneral/DDSParser.cpp DXGeneral/BCDecoder.cpp DXGeneral/JobSystem.cpp DXGeneral/MappedFile.cpp
+
+#ifndef _DDSFUZZ_H_
+#define _DDSFUZZ_H_
+
+int RunFuzz(int argc, char* argv[]);
+int RunHeaderBench(int argc, char* argv[]);
+int RunCorpus(int argc, char* argv[]);
+
+#endif
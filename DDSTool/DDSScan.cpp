@@ -0,0 +1,349 @@
+#include"DDSScan.h"
+#include"DDSParser.h"
+#include"JobSystem.h"
+#include"MappedFile.h"
+
+#include<algorithm>
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<map>
+#include<string>
+#include<vector>
+
+#if !defined(_WIN32)
+#include<dirent.h>
+#include<sys/stat.h>
+#endif
+
+namespace
+{
+	enum ScanStatus
+	{
+		SCAN_OK = 0,
+		SCAN_WARNING,
+		SCAN_ERROR
+	};
+
+	struct ScanResult
+	{
+		ScanStatus Status;
+		std::string Message;
+
+		DirectX::DDSTextureInfo Info;
+		size_t FileSize;
+
+		//Summed over array slices and depth
+		std::vector<size_t> MipBytes;
+		size_t TotalBytes;
+	};
+
+	struct ScanLimits
+	{
+		size_t MaxSize;
+		size_t MaxBytes;
+	};
+
+	const char* GetFormatName(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+#define FORMAT_NAME(f) case DXGI_FORMAT_##f: return #f;
+		FORMAT_NAME(R32G32B32A32_TYPELESS) FORMAT_NAME(R32G32B32A32_FLOAT) FORMAT_NAME(R32G32B32A32_UINT)
+		FORMAT_NAME(R32G32B32A32_SINT) FORMAT_NAME(R32G32B32_TYPELESS) FORMAT_NAME(R32G32B32_FLOAT)
+		FORMAT_NAME(R32G32B32_UINT) FORMAT_NAME(R32G32B32_SINT) FORMAT_NAME(R16G16B16A16_TYPELESS)
+		FORMAT_NAME(R16G16B16A16_FLOAT) FORMAT_NAME(R16G16B16A16_UNORM) FORMAT_NAME(R16G16B16A16_UINT)
+		FORMAT_NAME(R16G16B16A16_SNORM) FORMAT_NAME(R16G16B16A16_SINT) FORMAT_NAME(R32G32_TYPELESS)
+		FORMAT_NAME(R32G32_FLOAT) FORMAT_NAME(R32G32_UINT) FORMAT_NAME(R32G32_SINT)
+		FORMAT_NAME(R32G8X24_TYPELESS) FORMAT_NAME(D32_FLOAT_S8X24_UINT) FORMAT_NAME(R32_FLOAT_X8X24_TYPELESS)
+		FORMAT_NAME(X32_TYPELESS_G8X24_UINT) FORMAT_NAME(R10G10B10A2_TYPELESS) FORMAT_NAME(R10G10B10A2_UNORM)
+		FORMAT_NAME(R10G10B10A2_UINT) FORMAT_NAME(R11G11B10_FLOAT) FORMAT_NAME(R8G8B8A8_TYPELESS)
+		FORMAT_NAME(R8G8B8A8_UNORM) FORMAT_NAME(R8G8B8A8_UNORM_SRGB) FORMAT_NAME(R8G8B8A8_UINT)
+		FORMAT_NAME(R8G8B8A8_SNORM) FORMAT_NAME(R8G8B8A8_SINT) FORMAT_NAME(R16G16_TYPELESS)
+		FORMAT_NAME(R16G16_FLOAT) FORMAT_NAME(R16G16_UNORM) FORMAT_NAME(R16G16_UINT)
+		FORMAT_NAME(R16G16_SNORM) FORMAT_NAME(R16G16_SINT) FORMAT_NAME(R32_TYPELESS)
+		FORMAT_NAME(D32_FLOAT) FORMAT_NAME(R32_FLOAT) FORMAT_NAME(R32_UINT)
+		FORMAT_NAME(R32_SINT) FORMAT_NAME(R24G8_TYPELESS) FORMAT_NAME(D24_UNORM_S8_UINT)
+		FORMAT_NAME(R24_UNORM_X8_TYPELESS) FORMAT_NAME(X24_TYPELESS_G8_UINT) FORMAT_NAME(R8G8_TYPELESS)
+		FORMAT_NAME(R8G8_UNORM) FORMAT_NAME(R8G8_UINT) FORMAT_NAME(R8G8_SNORM)
+		FORMAT_NAME(R8G8_SINT) FORMAT_NAME(R16_TYPELESS) FORMAT_NAME(R16_FLOAT)
+		FORMAT_NAME(D16_UNORM) FORMAT_NAME(R16_UNORM) FORMAT_NAME(R16_UINT)
+		FORMAT_NAME(R16_SNORM) FORMAT_NAME(R16_SINT) FORMAT_NAME(R8_TYPELESS)
+		FORMAT_NAME(R8_UNORM) FORMAT_NAME(R8_UINT) FORMAT_NAME(R8_SNORM)
+		FORMAT_NAME(R8_SINT) FORMAT_NAME(A8_UNORM) FORMAT_NAME(R1_UNORM)
+		FORMAT_NAME(R9G9B9E5_SHAREDEXP) FORMAT_NAME(R8G8_B8G8_UNORM) FORMAT_NAME(G8R8_G8B8_UNORM)
+		FORMAT_NAME(BC1_TYPELESS) FORMAT_NAME(BC1_UNORM) FORMAT_NAME(BC1_UNORM_SRGB)
+		FORMAT_NAME(BC2_TYPELESS) FORMAT_NAME(BC2_UNORM) FORMAT_NAME(BC2_UNORM_SRGB)
+		FORMAT_NAME(BC3_TYPELESS) FORMAT_NAME(BC3_UNORM) FORMAT_NAME(BC3_UNORM_SRGB)
+		FORMAT_NAME(BC4_TYPELESS) FORMAT_NAME(BC4_UNORM) FORMAT_NAME(BC4_SNORM)
+		FORMAT_NAME(BC5_TYPELESS) FORMAT_NAME(BC5_UNORM) FORMAT_NAME(BC5_SNORM)
+		FORMAT_NAME(B5G6R5_UNORM) FORMAT_NAME(B5G5R5A1_UNORM) FORMAT_NAME(B8G8R8A8_UNORM)
+		FORMAT_NAME(B8G8R8X8_UNORM) FORMAT_NAME(R10G10B10_XR_BIAS_A2_UNORM) FORMAT_NAME(B8G8R8A8_TYPELESS)
+		FORMAT_NAME(B8G8R8A8_UNORM_SRGB) FORMAT_NAME(B8G8R8X8_TYPELESS) FORMAT_NAME(B8G8R8X8_UNORM_SRGB)
+		FORMAT_NAME(BC6H_TYPELESS) FORMAT_NAME(BC6H_UF16) FORMAT_NAME(BC6H_SF16)
+		FORMAT_NAME(BC7_TYPELESS) FORMAT_NAME(BC7_UNORM) FORMAT_NAME(BC7_UNORM_SRGB)
+		FORMAT_NAME(AYUV) FORMAT_NAME(Y410) FORMAT_NAME(Y416)
+		FORMAT_NAME(NV12) FORMAT_NAME(P010) FORMAT_NAME(P016)
+		FORMAT_NAME(420_OPAQUE) FORMAT_NAME(YUY2) FORMAT_NAME(Y210)
+		FORMAT_NAME(Y216) FORMAT_NAME(NV11) FORMAT_NAME(AI44)
+		FORMAT_NAME(IA44) FORMAT_NAME(P8) FORMAT_NAME(A8P8)
+		FORMAT_NAME(B4G4R4A4_UNORM)
+#undef FORMAT_NAME
+		default:
+			return "UNKNOWN";
+		}
+	}
+
+	const char* GetErrorText(HRESULT hr)
+	{
+		if (hr == HRESULT_FROM_WIN32(ERROR_HANDLE_EOF))
+			return "truncated";
+		if (hr == HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED))
+			return "unsupported format, dimension or size";
+		if (hr == HRESULT_FROM_WIN32(ERROR_INVALID_DATA))
+			return "inconsistent header";
+		return "not a DDS file";
+	}
+
+	bool EndsWithDDS(const std::string& name)
+	{
+		if (name.size() < 4)
+			return false;
+
+		std::string extension = name.substr(name.size() - 4);
+		for (size_t i = 0; i < extension.size(); ++i)
+			extension[i] = static_cast<char>(tolower(static_cast<unsigned char>(extension[i])));
+		return extension == ".dds";
+	}
+
+	//Files are taken as given, directories are searched for .dds recursively
+	void FindFiles(const std::string& path, std::vector<std::string>& files)
+	{
+#if defined(_WIN32)
+		DWORD attributes = GetFileAttributesA(path.c_str());
+		if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY))
+		{
+			files.push_back(path);
+			return;
+		}
+
+		WIN32_FIND_DATAA data;
+		HANDLE find = FindFirstFileA((path + "\\*").c_str(), &data);
+		if (find == INVALID_HANDLE_VALUE)
+			return;
+
+		do
+		{
+			if (strcmp(data.cFileName, ".") == 0 || strcmp(data.cFileName, "..") == 0)
+				continue;
+
+			std::string child = path + "\\" + data.cFileName;
+			if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				FindFiles(child, files);
+			else if (EndsWithDDS(child))
+				files.push_back(child);
+		} while (FindNextFileA(find, &data));
+
+		FindClose(find);
+#else
+		struct stat status;
+		if (stat(path.c_str(), &status) != 0 || !S_ISDIR(status.st_mode))
+		{
+			files.push_back(path);
+			return;
+		}
+
+		DIR* dir = opendir(path.c_str());
+		if (!dir)
+			return;
+
+		while (dirent* entry = readdir(dir))
+		{
+			if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+				continue;
+
+			std::string child = path + "/" + entry->d_name;
+			if (stat(child.c_str(), &status) != 0)
+				continue;
+
+			if (S_ISDIR(status.st_mode))
+				FindFiles(child, files);
+			else if (EndsWithDDS(child))
+				files.push_back(child);
+		}
+
+		closedir(dir);
+#endif
+	}
+
+	void AddProblem(ScanResult& result, ScanStatus status, const char* message)
+	{
+		result.Status = std::max(result.Status, status);
+		if (!result.Message.empty())
+			result.Message += ", ";
+		result.Message += message;
+	}
+
+	//Only the header pages of the mapping are ever touched
+	void ScanFile(const std::string& fileName, const ScanLimits& limits, ScanResult& result)
+	{
+		result.Status = SCAN_OK;
+		result.FileSize = 0;
+		result.TotalBytes = 0;
+
+		MappedFile file;
+		if (!file.Open(fileName.c_str()))
+		{
+			AddProblem(result, SCAN_ERROR, "cannot open or empty");
+			return;
+		}
+		result.FileSize = file.Size();
+
+		HRESULT hr = DirectX::ParseDDSHeader(file.Data(), file.Size(), result.Info);
+		if (FAILED(hr))
+		{
+			AddProblem(result, SCAN_ERROR, GetErrorText(hr));
+			return;
+		}
+
+		std::vector<DirectX::DDSSubresource> subresources;
+		hr = DirectX::GetDDSSubresources(result.Info, nullptr, file.Size(), subresources);
+		if (FAILED(hr))
+		{
+			AddProblem(result, SCAN_ERROR, GetErrorText(hr));
+			return;
+		}
+
+		const DirectX::DDSTextureInfo& info = result.Info;
+		result.MipBytes.assign(info.mipLevels, 0);
+
+		size_t end = info.headerSize;
+		for (size_t slice = 0; slice < info.arraySize; ++slice)
+		{
+			for (size_t mip = 0; mip < info.mipLevels; ++mip)
+			{
+				const DirectX::DDSSubresource& sub = subresources[DirectX::CalcDDSSubresource(mip, slice, info.mipLevels)];
+				size_t bytes = sub.slicePitch*sub.depth;
+				result.MipBytes[mip] += bytes;
+				result.TotalBytes += bytes;
+				end = std::max(end, sub.offset + bytes);
+			}
+		}
+
+		if (limits.MaxSize && std::max(info.width, std::max(info.height, info.depth)) > limits.MaxSize)
+			AddProblem(result, SCAN_ERROR, "over the size limit");
+		if (limits.MaxBytes && result.TotalBytes > limits.MaxBytes)
+			AddProblem(result, SCAN_ERROR, "over the byte limit");
+
+		if (end < file.Size())
+			AddProblem(result, SCAN_WARNING, "trailing bytes");
+		if (info.mipLevels == 1 && (info.width > 1 || info.height > 1))
+			AddProblem(result, SCAN_WARNING, "no mips");
+		if (DirectX::IsCompressed(info.format) && (info.width % 4 || info.height % 4))
+			AddProblem(result, SCAN_WARNING, "block compressed size not a multiple of 4");
+	}
+
+	const char* GetDimensionName(const DirectX::DDSTextureInfo& info)
+	{
+		if (info.isCubeMap)
+			return "cube";
+
+		switch (info.resourceDimension)
+		{
+		case DDS_DIMENSION_TEXTURE1D:	return "1D";
+		case DDS_DIMENSION_TEXTURE3D:	return "3D";
+		default:						return "2D";
+		}
+	}
+}
+
+int RunScan(int argc, char* argv[])
+{
+	bool verbose = false;
+	ScanLimits limits = { 0, 0 };
+	std::vector<std::string> files;
+
+	for (int i = 0; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-v") == 0)
+			verbose = true;
+		else if (strcmp(argv[i], "-max") == 0 && i + 1 < argc)
+			limits.MaxSize = strtoul(argv[++i], 0, 10);
+		else if (strcmp(argv[i], "-maxbytes") == 0 && i + 1 < argc)
+			limits.MaxBytes = static_cast<size_t>(strtoull(argv[++i], 0, 10));
+		else
+			FindFiles(argv[i], files);
+	}
+
+	if (files.empty())
+	{
+		printf("usage: DDSTool scan [-v] [-max size] [-maxbytes bytes] paths...\n");
+		return 1;
+	}
+
+	std::sort(files.begin(), files.end());
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<ScanResult> results(files.size());
+	JobSystem::Default().ParallelFor(static_cast<UINT>(files.size()), 16, [&](UINT begin, UINT end, UINT)
+	{
+		for (UINT i = begin; i < end; ++i)
+			ScanFile(files[i], limits, results[i]);
+	});
+
+	std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+
+	UINT counts[3] = {};
+	UINT64 totalBytes = 0;
+	UINT64 fileBytes = 0;
+	std::map<std::string, UINT> formats;
+
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		const ScanResult& r = results[i];
+		++counts[r.Status];
+		fileBytes += r.FileSize;
+
+		if (r.Status == SCAN_ERROR && r.MipBytes.empty())
+		{
+			printf("%s: error: %s\n", files[i].c_str(), r.Message.c_str());
+			continue;
+		}
+
+		const DirectX::DDSTextureInfo& info = r.Info;
+		const char* format = GetFormatName(info.format);
+		++formats[format];
+		totalBytes += r.TotalBytes;
+
+		printf("%s: %s %s %ux%ux%u, %u mips, %u slices, %llu bytes", files[i].c_str(), format, GetDimensionName(info),
+			static_cast<unsigned>(info.width), static_cast<unsigned>(info.height), static_cast<unsigned>(info.depth),
+			static_cast<unsigned>(info.mipLevels), static_cast<unsigned>(info.arraySize),
+			static_cast<unsigned long long>(r.TotalBytes));
+		if (r.Status != SCAN_OK)
+			printf(" [%s: %s]", r.Status == SCAN_ERROR ? "error" : "warning", r.Message.c_str());
+		printf("\n");
+
+		if (verbose)
+		{
+			for (size_t mip = 0; mip < r.MipBytes.size(); ++mip)
+			{
+				printf("    mip %2u %5ux%-5u %12llu bytes\n", static_cast<unsigned>(mip),
+					static_cast<unsigned>(std::max<size_t>(info.width >> mip, 1)),
+					static_cast<unsigned>(std::max<size_t>(info.height >> mip, 1)),
+					static_cast<unsigned long long>(r.MipBytes[mip]));
+			}
+		}
+	}
+
+	printf("\n%u files, %u ok, %u warnings, %u errors\n", static_cast<unsigned>(files.size()),
+		counts[SCAN_OK], counts[SCAN_WARNING], counts[SCAN_ERROR]);
+	for (auto it = formats.begin(); it != formats.end(); ++it)
+		printf("    %-24s %u\n", it->first.c_str(), it->second);
+	printf("%.1f MB of texels in %.1f MB of files, scanned in %.3f s (%.0f files/s, %u workers)\n",
+		totalBytes / 1048576.0, fileBytes / 1048576.0, seconds.count(),
+		files.size() / std::max(seconds.count(), 1e-9), JobSystem::Default().ThreadCount() + 1);
+
+	return counts[SCAN_ERROR] ? 1 : 0;
+}
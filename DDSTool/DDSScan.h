@@ -0,0 +1,15 @@
+#pragma once
+
+//DDSTool scan [-v] [-max size] [-maxbytes bytes] paths...
+//
+//Validates every .dds file under the given files and directories, reading
+//headers only, and reports format, size, mips and the bytes of every level.
+//Files are mapped and checked on all workers. Exits with 1 when any file is
+//malformed, truncated or over the given limits, so it can gate asset commits.
+
+#ifndef _DDSSCAN_H_
+#define _DDSSCAN_H_
+
+int RunScan(int argc, char* argv[]);
+
+#endif
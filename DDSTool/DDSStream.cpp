@@ -0,0 +1,412 @@
+#include"DDSStream.h"
+#include"DDSParser.h"
+#include"JobSystem.h"
+#include"NullDevice.h"
+#include"TextureStreamer.h"
+
+#include<algorithm>
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
+#include<random>
+#include<string>
+#include<vector>
+
+namespace
+{
+	//Levels no larger than this are the tail, read by Open()
+	const UINT TAIL_SIZE = 64;
+
+	//Frames a settling phase may take before it counts as stuck
+	const UINT MAX_SETTLE_FRAMES = 10000;
+
+	struct StreamTexture
+	{
+		std::wstring FileName;
+		UINT Width;
+		UINT Height;
+		UINT ArraySize;
+		UINT MipCount;
+		UINT TailMip;
+
+		TextureStreamer::TextureHandle Handle;
+
+		//Most detailed level asked for since the budget last dropped
+		UINT Finest;
+	};
+
+	UINT LevelSize(UINT size, UINT mip)
+	{
+		return std::max(size >> mip, 1u);
+	}
+
+	//Levels firstMip to the last of every slice
+	size_t LevelBytes(const StreamTexture& t, UINT firstMip)
+	{
+		size_t bytes = 0;
+		for (UINT mip = firstMip; mip < t.MipCount; ++mip)
+		{
+			bytes += size_t(LevelSize(t.Width, mip))*LevelSize(t.Height, mip) * 4 * t.ArraySize;
+		}
+		return bytes;
+	}
+
+	//Each level filled with its own value, so a wrong offset would show
+	bool WriteTexture(const std::string& fileName, StreamTexture& t)
+	{
+		DirectX::DDSTextureInfo info = {};
+		info.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+		info.width = t.Width;
+		info.height = t.Height;
+		info.depth = 1;
+		info.mipLevels = t.MipCount;
+		info.arraySize = t.ArraySize;
+		info.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		info.isCubeMap = false;
+		info.alphaMode = DDS_ALPHA_MODE_UNKNOWN;
+
+		std::vector<std::vector<uint8_t> > levels(t.MipCount * t.ArraySize);
+		std::vector<DirectX::DDSSubresource> subresources(levels.size());
+		for (UINT item = 0; item < t.ArraySize; ++item)
+		{
+			for (UINT mip = 0; mip < t.MipCount; ++mip)
+			{
+				size_t index = DirectX::CalcDDSSubresource(mip, item, t.MipCount);
+				UINT width = LevelSize(t.Width, mip);
+				UINT height = LevelSize(t.Height, mip);
+				levels[index].assign(size_t(width)*height * 4, static_cast<uint8_t>(index));
+
+				DirectX::DDSSubresource& sub = subresources[index];
+				sub.pData = levels[index].data();
+				sub.offset = 0;
+				sub.rowPitch = width * 4;
+				sub.slicePitch = size_t(width)*height * 4;
+				sub.width = width;
+				sub.height = height;
+				sub.depth = 1;
+			}
+		}
+
+		std::vector<uint8_t> ddsData;
+		if (FAILED(DirectX::WriteDDS(info, subresources, ddsData)))
+		{
+			printf("%s: cannot build the texture\n", fileName.c_str());
+			return false;
+		}
+
+		std::ofstream out(fileName.c_str(), std::ios::binary);
+		out.write(reinterpret_cast<const char*>(ddsData.data()), ddsData.size());
+		if (!out)
+		{
+			printf("%s: cannot write\n", fileName.c_str());
+			return false;
+		}
+
+		std::vector<wchar_t> wide(fileName.size() + 1);
+		size_t length = mbstowcs(wide.data(), fileName.c_str(), wide.size());
+		if (length == static_cast<size_t>(-1))
+		{
+			printf("%s: cannot convert the name\n", fileName.c_str());
+			return false;
+		}
+		t.FileName.assign(wide.data(), length);
+
+		return true;
+	}
+
+	//Returns what is wrong, 0 when nothing is
+	const char* CheckStreamer(const TextureStreamer& streamer, const std::vector<StreamTexture>& textures,
+		size_t budget, char* message, size_t messageSize)
+	{
+		TextureStreamer::Stats stats;
+		streamer.GetStats(stats);
+
+		if (stats.ResidentBytes > budget)
+		{
+			snprintf(message, messageSize, "%u resident bytes over the budget of %u",
+				static_cast<unsigned>(stats.ResidentBytes), static_cast<unsigned>(budget));
+			return message;
+		}
+		if (stats.ResidentBytes + stats.PendingBytes > budget)
+		{
+			snprintf(message, messageSize, "%u resident and %u pending bytes over the budget of %u",
+				static_cast<unsigned>(stats.ResidentBytes), static_cast<unsigned>(stats.PendingBytes),
+				static_cast<unsigned>(budget));
+			return message;
+		}
+
+		size_t resident = 0;
+		for (size_t i = 0; i < textures.size(); ++i)
+		{
+			const StreamTexture& t = textures[i];
+			UINT mip = streamer.GetResidentMip(t.Handle);
+			resident += LevelBytes(t, mip);
+
+			if (streamer.GetMipCount(t.Handle) != t.MipCount)
+			{
+				snprintf(message, messageSize, "texture %u has %u mips, not %u", static_cast<unsigned>(i),
+					streamer.GetMipCount(t.Handle), t.MipCount);
+				return message;
+			}
+			if (mip > t.TailMip || mip < t.Finest)
+			{
+				snprintf(message, messageSize, "texture %u holds mip %u, asked for %u, tail at %u",
+					static_cast<unsigned>(i), mip, t.Finest, t.TailMip);
+				return message;
+			}
+
+			//The texture and its view hold the resident levels, no more
+			ID3D11ShaderResourceView* view = streamer.GetView(t.Handle);
+			if (!view)
+			{
+				snprintf(message, messageSize, "texture %u has no view", static_cast<unsigned>(i));
+				return message;
+			}
+
+			D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+			view->GetDesc(&viewDesc);
+			UINT viewMips = t.ArraySize > 1 ? viewDesc.Texture2DArray.MipLevels : viewDesc.Texture2D.MipLevels;
+
+			ID3D11Resource* resource = 0;
+			view->GetResource(&resource);
+			D3D11_TEXTURE2D_DESC desc;
+			static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+			resource->Release();
+
+			if (desc.Width != LevelSize(t.Width, mip) || desc.Height != LevelSize(t.Height, mip) ||
+				desc.MipLevels != t.MipCount - mip || desc.ArraySize != t.ArraySize || viewMips != desc.MipLevels)
+			{
+				snprintf(message, messageSize, "texture %u at mip %u is %ux%u with %u mips, its view %u",
+					static_cast<unsigned>(i), mip, desc.Width, desc.Height, desc.MipLevels, viewMips);
+				return message;
+			}
+		}
+
+		if (resident != stats.ResidentBytes)
+		{
+			snprintf(message, messageSize, "%u resident bytes counted, the textures hold %u",
+				static_cast<unsigned>(stats.ResidentBytes), static_cast<unsigned>(resident));
+			return message;
+		}
+
+		return 0;
+	}
+
+	//Finishes the reads, as if the frame took long enough for them
+	bool Frame(TextureStreamer& streamer, ID3D11DeviceContext* context, const std::vector<StreamTexture>& textures,
+		size_t budget, const char* phase)
+	{
+		streamer.Update(context);
+		JobSystem::Default().WaitAll();
+
+		char message[256];
+		const char* problem = CheckStreamer(streamer, textures, budget, message, sizeof(message));
+		if (problem)
+		{
+			printf("%s: %s\n", phase, problem);
+			return false;
+		}
+		return true;
+	}
+}
+
+int RunStream(int argc, char* argv[])
+{
+	if (argc < 1)
+	{
+		printf("usage: DDSTool stream directory [-textures count] [-size texels] [-budget percent] [-frames count]\n");
+		return 1;
+	}
+
+	UINT count = 32;
+	UINT size = 1024;
+	UINT percent = 25;
+	UINT frames = 200;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-textures") == 0 && i + 1 < argc)
+			count = static_cast<UINT>(atoi(argv[++i]));
+		else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+			size = static_cast<UINT>(atoi(argv[++i]));
+		else if (strcmp(argv[i], "-budget") == 0 && i + 1 < argc)
+			percent = static_cast<UINT>(atoi(argv[++i]));
+		else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			frames = static_cast<UINT>(atoi(argv[++i]));
+		else
+		{
+			printf("usage: DDSTool stream directory [-textures count] [-size texels] [-budget percent] [-frames count]\n");
+			return 1;
+		}
+	}
+	if (!count || size < 2 * TAIL_SIZE || size > 16384 || percent > 100)
+	{
+		printf("stream: needs textures, a size from %u to 16384 and a budget of at most 100%%\n", 2 * TAIL_SIZE);
+		return 1;
+	}
+
+	//Square and wide textures of three sizes, every fourth a two slice array
+	std::vector<StreamTexture> textures(count);
+	size_t tailBytes = 0;
+	size_t totalBytes = 0;
+	for (UINT i = 0; i < count; ++i)
+	{
+		StreamTexture& t = textures[i];
+		t.Width = size >> (i % 3);
+		t.Height = (i & 1) ? t.Width / 2 : t.Width;
+		t.ArraySize = (i % 4 == 3) ? 2 : 1;
+		t.MipCount = 1;
+		while (LevelSize(t.Width, t.MipCount - 1) > 1 || LevelSize(t.Height, t.MipCount - 1) > 1)
+			++t.MipCount;
+		t.TailMip = 0;
+		while (LevelSize(t.Width, t.TailMip) > TAIL_SIZE || LevelSize(t.Height, t.TailMip) > TAIL_SIZE)
+			++t.TailMip;
+		t.Handle = 0;
+		t.Finest = t.TailMip;
+
+		char fileName[32];
+		snprintf(fileName, sizeof(fileName), "/stream-%03u.dds", i);
+		if (!WriteTexture(std::string(argv[0]) + fileName, t))
+			return 1;
+
+		tailBytes += LevelBytes(t, t.TailMip);
+		totalBytes += LevelBytes(t, 0);
+	}
+
+	const size_t budget = tailBytes + (totalBytes - tailBytes) / 100 * percent;
+
+	NullDevice* device = 0;
+	ID3D11DeviceContext* context = 0;
+	IDXGISwapChain* swapChain = 0;
+	NullDevice::Create(1, 1, &device, &context, &swapChain);
+
+	int result = 1;
+	{
+		TextureStreamer streamer;
+		streamer.Init(device, budget, TAIL_SIZE);
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		bool passed = true;
+		for (UINT i = 0; i < count && passed; ++i)
+		{
+			textures[i].Handle = streamer.Open(textures[i].FileName);
+			if (!textures[i].Handle)
+			{
+				printf("texture %u: cannot open\n", i);
+				passed = false;
+			}
+		}
+
+		if (passed)
+		{
+			char message[256];
+			const char* problem = CheckStreamer(streamer, textures, budget, message, sizeof(message));
+			if (problem)
+			{
+				printf("open: %s\n", problem);
+				passed = false;
+			}
+		}
+
+		if (passed)
+		{
+			//Random levels, some past the last mip, which Request() clamps to the tail
+			std::mt19937 random(7);
+			for (UINT frame = 0; frame < frames && passed; ++frame)
+			{
+				for (size_t i = 0; i < textures.size(); ++i)
+				{
+					StreamTexture& t = textures[i];
+					if (random() % 4 == 0)
+						continue;
+
+					UINT mip = random() % (t.MipCount + 4);
+					streamer.Request(t.Handle, mip);
+					t.Finest = std::min(t.Finest, std::min(mip, t.TailMip));
+				}
+				passed = Frame(streamer, context, textures, budget, "random requests");
+			}
+
+			//Requests that fit the budget together, the first one past the
+			//last mip, are met from wherever the random ones left off: levels
+			//nobody wants any more make room
+			std::vector<UINT> wanted(textures.size());
+			TextureStreamer::Stats settledStats = {};
+			if (passed)
+			{
+				size_t planned = tailBytes;
+				for (size_t i = 0; i < textures.size(); ++i)
+				{
+					StreamTexture& t = textures[i];
+					wanted[i] = t.TailMip;
+					for (UINT mip = (i == 0) ? t.TailMip : (i % t.MipCount); mip < t.TailMip; ++mip)
+					{
+						size_t extra = LevelBytes(t, mip) - LevelBytes(t, t.TailMip);
+						if (planned + extra <= budget)
+						{
+							wanted[i] = mip;
+							planned += extra;
+							break;
+						}
+					}
+					t.Finest = std::min(t.Finest, wanted[i]);
+				}
+
+				UINT settled = 0;
+				for (; settled < MAX_SETTLE_FRAMES && passed; ++settled)
+				{
+					for (size_t i = 0; i < textures.size(); ++i)
+						streamer.Request(textures[i].Handle, i == 0 ? textures[i].MipCount + 10 : wanted[i]);
+					passed = Frame(streamer, context, textures, budget, "settling requests");
+
+					bool met = true;
+					for (size_t i = 0; i < textures.size(); ++i)
+						met = met && streamer.GetResidentMip(textures[i].Handle) <= wanted[i];
+					if (met)
+						break;
+				}
+
+				if (passed && settled == MAX_SETTLE_FRAMES)
+				{
+					printf("settling requests: not met after %u frames\n", MAX_SETTLE_FRAMES);
+					passed = false;
+				}
+				streamer.GetStats(settledStats);
+			}
+
+			//Down to the tails, wanted or not
+			if (passed)
+			{
+				for (size_t i = 0; i < textures.size(); ++i)
+				{
+					streamer.Request(textures[i].Handle, wanted[i]);
+					textures[i].Finest = textures[i].TailMip;
+				}
+
+				streamer.SetBudget(tailBytes);
+				passed = Frame(streamer, context, textures, tailBytes, "budget of the tails");
+			}
+
+			auto end = std::chrono::high_resolution_clock::now();
+
+			if (passed)
+			{
+				const TextureStreamer::Stats& stats = settledStats;
+				printf("%u textures, %.1f MB in full, %.1f MB of tails, budget %.1f MB, %u frames\n",
+					count, totalBytes / 1048576.0, tailBytes / 1048576.0, budget / 1048576.0, frames);
+				printf("%.1f MB resident once settled, %.1f MB read, %u levels loaded, %u evicted, %.1f ms, checks passed\n",
+					stats.ResidentBytes / 1048576.0, stats.BytesRead / 1048576.0, stats.LevelsLoaded, stats.LevelsEvicted,
+					std::chrono::duration<double, std::milli>(end - start).count());
+				result = 0;
+			}
+		}
+	}
+
+	ReleaseCOM(swapChain);
+	ReleaseCOM(context);
+	ReleaseCOM(device);
+
+	return result;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+//DDSTool stream directory [-textures count] [-size texels] [-budget percent] [-frames count]
+//
+//Writes a corpus of mipped RGBA8 textures and arrays into directory and
+//streams it through TextureStreamer on a NullDevice, so it needs no display
+//adapter. The budget is the mip tails plus a percentage of the rest.
+//
+//Random requests run for the given frames, then a set of requests that fits
+//the budget settles, then the budget drops to the tails. After every
+//Update() it checks that the resident and pending bytes stay within the
+//budget, that the resident bytes add up to the levels each texture holds,
+//that every texture and view holds exactly its resident levels, and that no
+//texture streams above the level asked for or below its tail. Exits with 1
+//when a check fails.
+
+#ifndef _DDSSTREAM_H_
+#define _DDSSTREAM_H_
+
+int RunStream(int argc, char* argv[]);
+
+#endif
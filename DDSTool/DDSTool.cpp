@@ -0,0 +1,681 @@
+//Command line companion of the DDS code in DXGeneral, needs no device
+//
+//DDSTool bcbench [width height iterations]
+//	CPU block decompression throughput per BC format, one thread and all workers
+//
+//DDSTool bcenc [width height iterations]
+//	CPU block compression throughput and PSNR per format and quality
+//
+//DDSTool convbench [width height iterations]
+//	Format conversion throughput and round trip error per format pair, fails
+//	when an error is over what the formats of the pair allow
+//
+//DDSTool compress in.dds out.dds bc1|bc3|bc4|bc5 [fast|normal|high]
+//	Block compresses every subresource of an RGBA8 texture
+//
+//DDSTool convert in.dds out.dds rgba8|rgba8srgb|bgra8|bgra8srgb|rgb10a2|rgba16f|rgba32f|rgb32f|r11g11b10|rgb9e5
+//	Repacks every subresource of an uncompressed color texture
+//
+//DDSTool mips in.dds out.dds [box|kaiser] [-srgb] [-wrap] [-alpha reference]
+//	Replaces the mips below the top of every slice with a generated chain,
+//	block compressed inputs are compressed again afterwards
+//
+//DDSTool atlas out.dds table.txt [-max size] [-pad texels] [-mips levels] in.dds...
+//	Packs textures of one format into atlas pages, writes the uv remap table
+//
+//DDSTool array out.dds [-mips levels] in.dds...
+//	Stacks textures of one format and size into a texture array
+//
+//DDSTool scan [-v] [-max size] [-maxbytes bytes] paths...
+//	Validates the headers of every DDS file found and reports their layout
+//
+//DDSTool fuzz [-runs count] [-seed value] [-out directory] [seeds.dds...]
+//	Checks the subresource table of mutated headers, see DDSFuzz.h
+//
+//DDSTool headerbench [-seconds time] [files...]
+//	Headers parsed per second, valid and mutated
+//
+//DDSTool corpus directory
+//	Writes the seed corpus of fuzz and headerbench
+//
+//DDSTool stream directory [-textures count] [-size texels] [-budget percent] [-frames count]
+//	Streams a generated corpus through TextureStreamer on a NullDevice under
+//	a budget, checking resident bytes and levels, see DDSStream.h
+//
+//DDSTool cache directory
+//	Checks path hits, shared contents, references and eviction order of
+//	TextureCache on a NullDevice, see DDSCache.h
+
+#include"DDSCache.h"
+#include"DDSFuzz.h"
+#include"DDSParser.h"
+#include"DDSScan.h"
+#include"DDSStream.h"
+#include"FormatConverter.h"
+#include"JobSystem.h"
+#include"MappedFile.h"
+#include"MipGenerator.h"
+#include"TexturePacker.h"
+
+#include<algorithm>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
+
+namespace
+{
+	void PrintUsage()
+	{
+		printf("usage: DDSTool bcbench [width height iterations]\n");
+		printf("       DDSTool bcenc [width height iterations]\n");
+		printf("       DDSTool convbench [width height iterations]\n");
+		printf("       DDSTool compress in.dds out.dds bc1|bc3|bc4|bc5 [fast|normal|high]\n");
+		printf("       DDSTool convert in.dds out.dds rgba8|rgba8srgb|bgra8|bgra8srgb|rgb10a2|rgba16f|rgba32f|rgb32f|r11g11b10|rgb9e5\n");
+		printf("       DDSTool mips in.dds out.dds [box|kaiser] [-srgb] [-wrap] [-alpha reference]\n");
+		printf("       DDSTool atlas out.dds table.txt [-max size] [-pad texels] [-mips levels] in.dds...\n");
+		printf("       DDSTool array out.dds [-mips levels] in.dds...\n");
+		printf("       DDSTool scan [-v] [-max size] [-maxbytes bytes] paths...\n");
+		printf("       DDSTool fuzz [-runs count] [-seed value] [-out directory] [seeds.dds...]\n");
+		printf("       DDSTool headerbench [-seconds time] [files...]\n");
+		printf("       DDSTool corpus directory\n");
+		printf("       DDSTool stream directory [-textures count] [-size texels] [-budget percent] [-frames count]\n");
+		printf("       DDSTool cache directory\n");
+	}
+
+	struct FormatName
+	{
+		const char* Name;
+		DXGI_FORMAT Format;
+	};
+
+	const FormatName ConvertFormats[] =
+	{
+		{ "rgba8", DXGI_FORMAT_R8G8B8A8_UNORM },
+		{ "rgba8srgb", DXGI_FORMAT_R8G8B8A8_UNORM_SRGB },
+		{ "bgra8", DXGI_FORMAT_B8G8R8A8_UNORM },
+		{ "bgra8srgb", DXGI_FORMAT_B8G8R8A8_UNORM_SRGB },
+		{ "rgb10a2", DXGI_FORMAT_R10G10B10A2_UNORM },
+		{ "rgba16f", DXGI_FORMAT_R16G16B16A16_FLOAT },
+		{ "rgba32f", DXGI_FORMAT_R32G32B32A32_FLOAT },
+		{ "rgb32f", DXGI_FORMAT_R32G32B32_FLOAT },
+		{ "r11g11b10", DXGI_FORMAT_R11G11B10_FLOAT },
+		{ "rgb9e5", DXGI_FORMAT_R9G9B9E5_SHAREDEXP },
+	};
+
+	const char* GetConvertFormatName(DXGI_FORMAT format)
+	{
+		for (const FormatName& f : ConvertFormats)
+		{
+			if (f.Format == format)
+				return f.Name;
+		}
+		return "?";
+	}
+
+	int RunBCBench(int argc, char* argv[])
+	{
+		size_t width = 2048;
+		size_t height = 2048;
+		unsigned iterations = 10;
+		if (argc >= 3)
+		{
+			width = strtoul(argv[0], 0, 10);
+			height = strtoul(argv[1], 0, 10);
+			iterations = static_cast<unsigned>(strtoul(argv[2], 0, 10));
+		}
+		if (!width || !height || !iterations)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		struct Format
+		{
+			DXGI_FORMAT Format;
+			const char* Name;
+		};
+
+		const Format formats[] =
+		{
+			{ DXGI_FORMAT_BC1_UNORM, "BC1" },
+			{ DXGI_FORMAT_BC2_UNORM, "BC2" },
+			{ DXGI_FORMAT_BC3_UNORM, "BC3" },
+			{ DXGI_FORMAT_BC4_UNORM, "BC4" },
+			{ DXGI_FORMAT_BC5_UNORM, "BC5" },
+			{ DXGI_FORMAT_BC6H_UF16, "BC6H" },
+			{ DXGI_FORMAT_BC7_UNORM, "BC7" },
+		};
+
+		printf("%s, %ux%u, %u iterations, %u workers\n", DirectX::GetBCDecoderInstructionSet(),
+			static_cast<unsigned>(width), static_cast<unsigned>(height), iterations,
+			JobSystem::Default().ThreadCount() + 1);
+		printf("%-6s %14s %14s\n", "", "1 thread", "threaded");
+
+		for (const Format& f : formats)
+		{
+			double single = DirectX::BenchmarkDecompressBC(f.Format, width, height, iterations, false);
+			double threaded = DirectX::BenchmarkDecompressBC(f.Format, width, height, iterations, true);
+			printf("%-6s %9.1f MP/s %9.1f MP/s\n", f.Name, single, threaded);
+		}
+
+		return 0;
+	}
+
+	int RunBCEnc(int argc, char* argv[])
+	{
+		size_t width = 2048;
+		size_t height = 2048;
+		unsigned iterations = 3;
+		if (argc >= 3)
+		{
+			width = strtoul(argv[0], 0, 10);
+			height = strtoul(argv[1], 0, 10);
+			iterations = static_cast<unsigned>(strtoul(argv[2], 0, 10));
+		}
+		if (!width || !height || !iterations)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		struct Format
+		{
+			DXGI_FORMAT Format;
+			const char* Name;
+		};
+
+		const Format formats[] =
+		{
+			{ DXGI_FORMAT_BC1_UNORM, "BC1" },
+			{ DXGI_FORMAT_BC3_UNORM, "BC3" },
+			{ DXGI_FORMAT_BC4_UNORM, "BC4" },
+			{ DXGI_FORMAT_BC5_UNORM, "BC5" },
+		};
+
+		const char* qualities[] = { "fast", "normal", "high" };
+
+		printf("%s, %ux%u, %u iterations, %u workers\n", DirectX::GetBCEncoderInstructionSet(),
+			static_cast<unsigned>(width), static_cast<unsigned>(height), iterations,
+			JobSystem::Default().ThreadCount() + 1);
+		printf("%-6s %-7s %14s %14s %9s\n", "", "", "1 thread", "threaded", "PSNR");
+
+		for (const Format& f : formats)
+		{
+			for (int q = DirectX::BC_COMPRESS_FAST; q <= DirectX::BC_COMPRESS_HIGH; ++q)
+			{
+				DirectX::BC_COMPRESS_QUALITY quality = static_cast<DirectX::BC_COMPRESS_QUALITY>(q);
+				double psnr = 0.0;
+				double single = DirectX::BenchmarkCompressBC(f.Format, width, height, iterations, quality, false, &psnr);
+				double threaded = DirectX::BenchmarkCompressBC(f.Format, width, height, iterations, quality, true, 0);
+				printf("%-6s %-7s %9.1f MP/s %9.1f MP/s %6.2f dB\n", f.Name, qualities[q], single, threaded, psnr);
+			}
+		}
+
+		return 0;
+	}
+
+	//Largest round trip error a format may add, relative to the brightest
+	//channel of a texel: about a step of the mantissa for the float formats,
+	//the shared exponent of RGB9E5 following the brightest channel, and half
+	//a step for the unorm ones
+	double RoundTripBound(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+			return 1e-3;
+		case DXGI_FORMAT_R11G11B10_FLOAT:
+			return 1.0 / 32.0;
+		case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+			return 1.0 / 256.0;
+		case DXGI_FORMAT_R10G10B10A2_UNORM:
+			return 0.5 / 1023.0;
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+			return 0.5 / 255.0;
+		default:
+			return 0.0;
+		}
+	}
+
+	int RunConvBench(int argc, char* argv[])
+	{
+		size_t width = 2048;
+		size_t height = 2048;
+		unsigned iterations = 10;
+		if (argc >= 3)
+		{
+			width = strtoul(argv[0], 0, 10);
+			height = strtoul(argv[1], 0, 10);
+			iterations = static_cast<unsigned>(strtoul(argv[2], 0, 10));
+		}
+		if (!width || !height || !iterations)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		//HDR sources into the packed float formats, and the LDR ones around them
+		const DXGI_FORMAT pairs[][2] =
+		{
+			{ DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_R16G16B16A16_FLOAT },
+			{ DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_R11G11B10_FLOAT },
+			{ DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_R9G9B9E5_SHAREDEXP },
+			{ DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R11G11B10_FLOAT },
+			{ DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R9G9B9E5_SHAREDEXP },
+			{ DXGI_FORMAT_R11G11B10_FLOAT, DXGI_FORMAT_R9G9B9E5_SHAREDEXP },
+			{ DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R16G16B16A16_FLOAT },
+			{ DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R11G11B10_FLOAT },
+			{ DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, DXGI_FORMAT_R16G16B16A16_FLOAT },
+			{ DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_B8G8R8A8_UNORM },
+			{ DXGI_FORMAT_R10G10B10A2_UNORM, DXGI_FORMAT_R16G16B16A16_FLOAT },
+		};
+
+		printf("%s, %ux%u, %u iterations, %u workers\n", FormatConverter::GetInstructionSet(),
+			static_cast<unsigned>(width), static_cast<unsigned>(height), iterations,
+			JobSystem::Default().ThreadCount() + 1);
+		printf("%-24s %12s %12s %12s %12s %11s\n", "", "1 thread", "threaded", "back", "back thr.", "round trip");
+
+		FormatConverter converter;
+		int result = 0;
+		for (const auto& pair : pairs)
+		{
+			double error = 0.0;
+			double single = converter.Benchmark(pair[0], pair[1], width, height, iterations, false, &error);
+			double threaded = converter.Benchmark(pair[0], pair[1], width, height, iterations, true, 0);
+			double backSingle = converter.Benchmark(pair[1], pair[0], width, height, iterations, false, 0);
+			double backThreaded = converter.Benchmark(pair[1], pair[0], width, height, iterations, true, 0);
+
+			char name[64];
+			snprintf(name, sizeof(name), "%s > %s", GetConvertFormatName(pair[0]), GetConvertFormatName(pair[1]));
+			printf("%-24s %7.2f GB/s %7.2f GB/s %7.2f GB/s %7.2f GB/s %10.5f%%\n", name,
+				single, threaded, backSingle, backThreaded, error*100.0);
+
+			//The coarser format of the pair decides
+			double bound = std::max(RoundTripBound(pair[0]), RoundTripBound(pair[1]));
+			if (!(error <= bound))
+			{
+				printf("%s: round trip error over the bound of %.5f%%\n", name, bound*100.0);
+				result = 1;
+			}
+		}
+
+		return result;
+	}
+
+	bool LoadDDS(const char* fileName, MappedFile& file,
+		DirectX::DDSTextureInfo& info, std::vector<DirectX::DDSSubresource>& subresources)
+	{
+		if (!file.Open(fileName))
+		{
+			printf("%s: cannot open\n", fileName);
+			return false;
+		}
+
+		if (FAILED(DirectX::ParseDDS(file.Data(), file.Size(), info, subresources)))
+		{
+			printf("%s: not a valid DDS file\n", fileName);
+			return false;
+		}
+		return true;
+	}
+
+	bool SaveDDS(const char* fileName,
+		const DirectX::DDSTextureInfo& info, const std::vector<DirectX::DDSSubresource>& subresources)
+	{
+		std::vector<uint8_t> ddsData;
+		if (FAILED(DirectX::WriteDDS(info, subresources, ddsData)))
+		{
+			printf("%s: cannot write the result\n", fileName);
+			return false;
+		}
+
+		std::ofstream out(fileName, std::ios::binary);
+		out.write(reinterpret_cast<const char*>(ddsData.data()), ddsData.size());
+		if (!out)
+		{
+			printf("%s: cannot write\n", fileName);
+			return false;
+		}
+
+		printf("%s: %ux%u, %u slices, %u mips\n", fileName, static_cast<unsigned>(info.width),
+			static_cast<unsigned>(info.height), static_cast<unsigned>(info.arraySize),
+			static_cast<unsigned>(info.mipLevels));
+		return true;
+	}
+
+	//Every subresource of an RGBA8 texture into format, laid out like a DDS body
+	bool CompressTexture(const DirectX::DDSTextureInfo& info, const std::vector<DirectX::DDSSubresource>& subresources,
+		DXGI_FORMAT format, DirectX::BC_COMPRESS_QUALITY quality,
+		DirectX::DDSTextureInfo& outInfo, std::vector<DirectX::DDSSubresource>& outSubresources, std::vector<uint8_t>& outData)
+	{
+		if ((info.format != DXGI_FORMAT_R8G8B8A8_UNORM && info.format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
+			|| info.resourceDimension == DDS_DIMENSION_TEXTURE3D)
+			return false;
+
+		//Keep the color space of the source
+		if (info.format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
+		{
+			if (format == DXGI_FORMAT_BC1_UNORM)
+				format = DXGI_FORMAT_BC1_UNORM_SRGB;
+			else if (format == DXGI_FORMAT_BC3_UNORM)
+				format = DXGI_FORMAT_BC3_UNORM_SRGB;
+		}
+
+		outSubresources.resize(subresources.size());
+		size_t offset = 0;
+		for (size_t i = 0; i < subresources.size(); ++i)
+		{
+			size_t bytes, rowBytes, rows;
+			DirectX::GetSurfaceInfo(subresources[i].width, subresources[i].height, format, &bytes, &rowBytes, &rows);
+
+			outSubresources[i] = subresources[i];
+			outSubresources[i].offset = offset;
+			outSubresources[i].rowPitch = rowBytes;
+			outSubresources[i].slicePitch = bytes;
+			offset += bytes;
+		}
+
+		outData.resize(offset);
+		for (size_t i = 0; i < subresources.size(); ++i)
+		{
+			const DirectX::DDSSubresource& sub = subresources[i];
+			DirectX::DDSSubresource& out = outSubresources[i];
+			out.pData = &outData[out.offset];
+			if (FAILED(DirectX::CompressBC(format, sub.width, sub.height, sub.pData, sub.rowPitch,
+				&outData[out.offset], out.rowPitch, quality)))
+				return false;
+		}
+
+		outInfo = info;
+		outInfo.format = format;
+		return true;
+	}
+
+	int RunCompress(int argc, char* argv[])
+	{
+		if (argc < 3)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		DXGI_FORMAT format;
+		if (strcmp(argv[2], "bc1") == 0)
+			format = DXGI_FORMAT_BC1_UNORM;
+		else if (strcmp(argv[2], "bc3") == 0)
+			format = DXGI_FORMAT_BC3_UNORM;
+		else if (strcmp(argv[2], "bc4") == 0)
+			format = DXGI_FORMAT_BC4_UNORM;
+		else if (strcmp(argv[2], "bc5") == 0)
+			format = DXGI_FORMAT_BC5_UNORM;
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		DirectX::BC_COMPRESS_QUALITY quality = DirectX::BC_COMPRESS_NORMAL;
+		if (argc >= 4)
+		{
+			if (strcmp(argv[3], "fast") == 0)
+				quality = DirectX::BC_COMPRESS_FAST;
+			else if (strcmp(argv[3], "high") == 0)
+				quality = DirectX::BC_COMPRESS_HIGH;
+			else if (strcmp(argv[3], "normal") != 0)
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+
+		MappedFile file;
+		DirectX::DDSTextureInfo info;
+		std::vector<DirectX::DDSSubresource> subresources;
+		if (!LoadDDS(argv[0], file, info, subresources))
+			return 1;
+
+		DirectX::DDSTextureInfo compressedInfo;
+		std::vector<DirectX::DDSSubresource> compressedSubresources;
+		std::vector<uint8_t> compressedData;
+		if (!CompressTexture(info, subresources, format, quality, compressedInfo, compressedSubresources, compressedData))
+		{
+			printf("%s: needs a 1D, 2D or cube R8G8B8A8 texture\n", argv[0]);
+			return 1;
+		}
+
+		return SaveDDS(argv[1], compressedInfo, compressedSubresources) ? 0 : 1;
+	}
+
+	int RunConvert(int argc, char* argv[])
+	{
+		if (argc < 3)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		for (const FormatName& f : ConvertFormats)
+		{
+			if (strcmp(argv[2], f.Name) == 0)
+				format = f.Format;
+		}
+		if (format == DXGI_FORMAT_UNKNOWN)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		MappedFile file;
+		DirectX::DDSTextureInfo info;
+		std::vector<DirectX::DDSSubresource> subresources;
+		if (!LoadDDS(argv[0], file, info, subresources))
+			return 1;
+
+		DirectX::DDSTextureInfo convertedInfo;
+		std::vector<DirectX::DDSSubresource> convertedSubresources;
+		std::vector<uint8_t> convertedData;
+		FormatConverter converter;
+		if (!converter.Convert(info, subresources, format, convertedInfo, convertedSubresources, convertedData))
+		{
+			printf("%s: format not supported\n", argv[0]);
+			return 1;
+		}
+
+		return SaveDDS(argv[1], convertedInfo, convertedSubresources) ? 0 : 1;
+	}
+
+	int RunMips(int argc, char* argv[])
+	{
+		if (argc < 2)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		MipGenerator::Options options;
+		for (int i = 2; i < argc; ++i)
+		{
+			if (strcmp(argv[i], "box") == 0)
+				options.Filter = MipGenerator::MIP_FILTER_BOX;
+			else if (strcmp(argv[i], "kaiser") == 0)
+				options.Filter = MipGenerator::MIP_FILTER_KAISER;
+			else if (strcmp(argv[i], "-srgb") == 0)
+				options.ForceSRGB = true;
+			else if (strcmp(argv[i], "-wrap") == 0)
+				options.Wrap = true;
+			else if (strcmp(argv[i], "-alpha") == 0 && i + 1 < argc)
+				options.AlphaReference = static_cast<float>(atof(argv[++i]));
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+
+		MappedFile file;
+		DirectX::DDSTextureInfo info;
+		std::vector<DirectX::DDSSubresource> subresources;
+		if (!LoadDDS(argv[0], file, info, subresources))
+			return 1;
+
+		DirectX::DDSTextureInfo mippedInfo;
+		std::vector<DirectX::DDSSubresource> mippedSubresources;
+		std::vector<uint8_t> mippedData;
+		MipGenerator generator;
+		if (!generator.Generate(info, subresources, options, mippedInfo, mippedSubresources, mippedData))
+		{
+			printf("%s: format or dimension not supported\n", argv[0]);
+			return 1;
+		}
+
+		if (DirectX::CanCompressBC(info.format))
+		{
+			DirectX::DDSTextureInfo compressedInfo;
+			std::vector<DirectX::DDSSubresource> compressedSubresources;
+			std::vector<uint8_t> compressedData;
+			if (!CompressTexture(mippedInfo, mippedSubresources, info.format, DirectX::BC_COMPRESS_HIGH,
+				compressedInfo, compressedSubresources, compressedData))
+			{
+				printf("%s: cannot compress the chain\n", argv[0]);
+				return 1;
+			}
+
+			return SaveDDS(argv[1], compressedInfo, compressedSubresources) ? 0 : 1;
+		}
+
+		return SaveDDS(argv[1], mippedInfo, mippedSubresources) ? 0 : 1;
+	}
+
+	//atlas and array share everything but the packing call
+	int RunPack(bool atlas, int argc, char* argv[])
+	{
+		const int outputs = atlas ? 2 : 1;
+		if (argc <= outputs)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		TexturePacker::Options options;
+		std::vector<const char*> inputs;
+		for (int i = outputs; i < argc; ++i)
+		{
+			if (strcmp(argv[i], "-max") == 0 && i + 1 < argc)
+				options.MaxSize = static_cast<UINT>(atoi(argv[++i]));
+			else if (strcmp(argv[i], "-pad") == 0 && i + 1 < argc)
+				options.Padding = static_cast<UINT>(atoi(argv[++i]));
+			else if (strcmp(argv[i], "-mips") == 0 && i + 1 < argc)
+				options.MipLevels = static_cast<UINT>(atoi(argv[++i]));
+			else
+				inputs.push_back(argv[i]);
+		}
+
+		if (inputs.empty())
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		//Files stay mapped while the packer reads them
+		std::vector<MappedFile> files(inputs.size());
+		std::vector<TexturePacker::Source> sources(inputs.size());
+		std::vector<char> loaded(inputs.size());
+		JobSystem::Default().ParallelFor(static_cast<UINT>(inputs.size()), 1, [&](UINT begin, UINT end, UINT)
+		{
+			for (UINT i = begin; i < end; ++i)
+				loaded[i] = LoadDDS(inputs[i], files[i], sources[i].Info, sources[i].Subresources);
+		});
+
+		if (std::find(loaded.begin(), loaded.end(), 0) != loaded.end())
+			return 1;
+
+		DirectX::DDSTextureInfo packedInfo;
+		std::vector<DirectX::DDSSubresource> packedSubresources;
+		std::vector<uint8_t> packedData;
+		std::vector<TexturePacker::Region> regions;
+		TexturePacker packer;
+		bool packed = atlas
+			? packer.BuildAtlas(sources, options, packedInfo, packedSubresources, packedData, regions)
+			: packer.BuildArray(sources, options, packedInfo, packedSubresources, packedData, regions);
+		if (!packed)
+		{
+			printf("%s: textures differ in format%s, are not plain 2D, or do not fit\n", argv[0], atlas ? "" : " or size");
+			return 1;
+		}
+
+		if (!SaveDDS(argv[0], packedInfo, packedSubresources))
+			return 1;
+
+		if (!atlas)
+			return 0;
+
+		double covered = 0.0;
+		for (const TexturePacker::Region& r : regions)
+			covered += double(r.Width)*r.Height;
+		printf("%u textures, %.1f%% of the texels used\n", static_cast<unsigned>(regions.size()),
+			100.0*covered / (double(packedInfo.width)*packedInfo.height*packedInfo.arraySize));
+
+		//uv in the atlas = uv * scale + offset on slice page
+		std::ofstream table(argv[1]);
+		table << "# page x y width height scaleU scaleV offsetU offsetV file\n";
+		for (size_t i = 0; i < regions.size(); ++i)
+		{
+			const TexturePacker::Region& r = regions[i];
+			table << r.Page << ' ' << r.X << ' ' << r.Y << ' ' << r.Width << ' ' << r.Height << ' '
+				<< r.ScaleU << ' ' << r.ScaleV << ' ' << r.OffsetU << ' ' << r.OffsetV << ' ' << inputs[i] << '\n';
+		}
+
+		if (!table)
+		{
+			printf("%s: cannot write\n", argv[1]);
+			return 1;
+		}
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (strcmp(argv[1], "bcbench") == 0)
+		return RunBCBench(argc - 2, argv + 2);
+	if (strcmp(argv[1], "bcenc") == 0)
+		return RunBCEnc(argc - 2, argv + 2);
+	if (strcmp(argv[1], "convbench") == 0)
+		return RunConvBench(argc - 2, argv + 2);
+	if (strcmp(argv[1], "compress") == 0)
+		return RunCompress(argc - 2, argv + 2);
+	if (strcmp(argv[1], "convert") == 0)
+		return RunConvert(argc - 2, argv + 2);
+	if (strcmp(argv[1], "mips") == 0)
+		return RunMips(argc - 2, argv + 2);
+	if (strcmp(argv[1], "atlas") == 0)
+		return RunPack(true, argc - 2, argv + 2);
+	if (strcmp(argv[1], "array") == 0)
+		return RunPack(false, argc - 2, argv + 2);
+	if (strcmp(argv[1], "scan") == 0)
+		return RunScan(argc - 2, argv + 2);
+	if (strcmp(argv[1], "fuzz") == 0)
+		return RunFuzz(argc - 2, argv + 2);
+	if (strcmp(argv[1], "headerbench") == 0)
+		return RunHeaderBench(argc - 2, argv + 2);
+	if (strcmp(argv[1], "corpus") == 0)
+		return RunCorpus(argc - 2, argv + 2);
+	if (strcmp(argv[1], "stream") == 0)
+		return RunStream(argc - 2, argv + 2);
+	if (strcmp(argv[1], "cache") == 0)
+		return RunCache(argc - 2, argv + 2);
+
+	PrintUsage();
+	return 1;
+}
@@ -0,0 +1,519 @@
+#include"AssetLoader.h"
+#include"DDSTextureLoader.h"
+#include"MappedFile.h"
+#include<cstdlib>
+
+namespace
+{
+	//Moves the cursor past the next occurrence of token, false if there is none
+	bool SkipPast(const char*& cursor, const char* end, const char* token)
+	{
+		size_t length = strlen(token);
+
+		for (; cursor + length <= end; ++cursor)
+		{
+			if (memcmp(cursor, token, length) == 0)
+			{
+				cursor += length;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	//strtof/strtoul stop at the terminating zero ParseModel requires
+	bool ReadFloat(const char*& cursor, float& value)
+	{
+		char* next = 0;
+		value = strtof(cursor, &next);
+		if (next == cursor)
+		{
+			return false;
+		}
+
+		cursor = next;
+		return true;
+	}
+
+	bool ReadUInt(const char*& cursor, UINT& value)
+	{
+		char* next = 0;
+		value = static_cast<UINT>(strtoul(cursor, &next, 10));
+		if (next == cursor)
+		{
+			return false;
+		}
+
+		cursor = next;
+		return true;
+	}
+
+	bool EndsWith(const std::wstring& s, const wchar_t* suffix)
+	{
+		size_t length = wcslen(suffix);
+
+		return s.size() >= length && _wcsicmp(s.c_str() + s.size() - length, suffix) == 0;
+	}
+
+	//UTF-8, for the narrow file names of the compiler
+	std::string ToUtf8(const std::wstring& s)
+	{
+		if (s.empty())
+			return std::string();
+
+		int length = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), static_cast<int>(s.size()), NULL, 0, NULL, NULL);
+		if (length <= 0)
+			return std::string();
+
+		std::string utf8(length, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, s.c_str(), static_cast<int>(s.size()), &utf8[0], length, NULL, NULL);
+		return utf8;
+	}
+}
+
+AssetLoader::AssetLoader(JobSystem& jobs)
+	:m_jobs(jobs), m_device(0)
+{
+
+}
+
+AssetLoader::~AssetLoader()
+{
+	//Outstanding jobs write into our records
+	WaitForAll();
+
+	for (size_t i = 0; i < m_assets.size(); ++i)
+	{
+		ReleaseCOM(m_assets[i].Texture);
+		ReleaseCOM(m_assets[i].Shader);
+		ReleaseCOM(m_assets[i].Errors);
+	}
+}
+
+void AssetLoader::SetDevice(ID3D11Device* device)
+{
+	m_device = device;
+}
+
+AssetLoader::AssetHandle AssetLoader::LoadMesh(const std::wstring& fileName,
+	JobSystem::JobPriority priority, const AssetHandle* dependencies, UINT dependencyCount)
+{
+	std::lock_guard<std::mutex> request(m_requestMutex);
+
+	Asset* asset = NewAsset();
+	asset->Type = ASSET_MESH;
+	asset->Priority = priority;
+	asset->FileName = fileName;
+
+	return Request(asset, dependencies, dependencyCount);
+}
+
+AssetLoader::AssetHandle AssetLoader::LoadTexture(const std::wstring& fileName,
+	JobSystem::JobPriority priority, const AssetHandle* dependencies, UINT dependencyCount)
+{
+	std::lock_guard<std::mutex> request(m_requestMutex);
+
+	Asset* asset = NewAsset();
+	asset->Type = ASSET_TEXTURE;
+	asset->Priority = priority;
+	asset->FileName = fileName;
+
+	return Request(asset, dependencies, dependencyCount);
+}
+
+AssetLoader::AssetHandle AssetLoader::LoadShader(const std::wstring& fileName,
+	const std::string& entryPoint, const std::string& target, UINT compileFlags,
+	JobSystem::JobPriority priority, const AssetHandle* dependencies, UINT dependencyCount)
+{
+	std::lock_guard<std::mutex> request(m_requestMutex);
+
+	Asset* asset = NewAsset();
+	asset->Type = ASSET_SHADER;
+	asset->Priority = priority;
+	asset->FileName = fileName;
+	asset->EntryPoint = entryPoint;
+	asset->Target = target;
+	asset->CompileFlags = compileFlags;
+
+	return Request(asset, dependencies, dependencyCount);
+}
+
+//Called with m_requestMutex held, asset is the last record
+AssetLoader::AssetHandle AssetLoader::Request(Asset* asset, const AssetHandle* dependencies, UINT dependencyCount)
+{
+	//The decode step waits for our own read and for the decode of every dependency
+	std::vector<JobSystem::JobHandle> decodeDeps;
+
+	AssetHandle handle = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		handle = static_cast<AssetHandle>(m_assets.size());
+
+		for (UINT i = 0; i < dependencyCount; ++i)
+		{
+			const Asset* dep = Find(dependencies[i]);
+			if (dep)
+			{
+				asset->Dependencies.push_back(dependencies[i]);
+				decodeDeps.push_back(dep->DecodeJob);
+			}
+		}
+	}
+
+	//Jobs may run inline when the pool has no workers, so m_mutex is not held here
+	JobSystem::JobHandle readJob = m_jobs.Submit([this, asset]() { Read(asset); },
+		asset->Priority, JobSystem::QUEUE_IO);
+	decodeDeps.push_back(readJob);
+
+	JobSystem::JobHandle decodeJob = m_jobs.Submit([this, asset]() { Decode(asset); },
+		asset->Priority, JobSystem::QUEUE_CPU, &decodeDeps[0], static_cast<UINT>(decodeDeps.size()));
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	asset->ReadJob = readJob;
+	asset->DecodeJob = decodeJob;
+
+	return handle;
+}
+
+AssetLoader::AssetState AssetLoader::GetState(AssetHandle asset) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const Asset* a = Find(asset);
+	return a ? a->State : ASSET_FAILED;
+}
+
+float AssetLoader::Progress() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_assets.empty())
+	{
+		return 1.0f;
+	}
+
+	UINT done = 0;
+	for (size_t i = 0; i < m_assets.size(); ++i)
+	{
+		if (m_assets[i].State == ASSET_READY || m_assets[i].State == ASSET_FAILED)
+		{
+			++done;
+		}
+	}
+
+	return static_cast<float>(done) / m_assets.size();
+}
+
+bool AssetLoader::WaitForCritical()
+{
+	return Wait(true);
+}
+
+bool AssetLoader::WaitForAll()
+{
+	return Wait(false);
+}
+
+bool AssetLoader::Wait(bool criticalOnly)
+{
+	std::vector<JobSystem::JobHandle> jobs;
+	std::vector<AssetHandle> assets;
+
+	{
+		//Requests in flight have no decode job yet
+		std::lock_guard<std::mutex> request(m_requestMutex);
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (size_t i = 0; i < m_assets.size(); ++i)
+		{
+			if (!criticalOnly || m_assets[i].Priority == JobSystem::PRIORITY_CRITICAL)
+			{
+				jobs.push_back(m_assets[i].DecodeJob);
+				assets.push_back(static_cast<AssetHandle>(i + 1));
+			}
+		}
+	}
+
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		m_jobs.Wait(jobs[i]);
+	}
+
+	bool result = true;
+	for (size_t i = 0; i < assets.size(); ++i)
+	{
+		if (GetState(assets[i]) != ASSET_READY)
+		{
+			result = false;
+		}
+	}
+
+	return result;
+}
+
+const GeometryGenerator::MeshData* AssetLoader::GetMesh(AssetHandle asset) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const Asset* a = Find(asset);
+	return (a && a->Type == ASSET_MESH && a->State == ASSET_READY) ? &a->Mesh : 0;
+}
+
+ID3D11ShaderResourceView* AssetLoader::GetTexture(AssetHandle asset) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const Asset* a = Find(asset);
+	return (a && a->Type == ASSET_TEXTURE && a->State == ASSET_READY) ? a->Texture : 0;
+}
+
+const std::vector<char>* AssetLoader::GetTextureData(AssetHandle asset) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const Asset* a = Find(asset);
+	return (a && a->Type == ASSET_TEXTURE && a->State == ASSET_READY && !a->Texture) ? &a->FileData : 0;
+}
+
+ID3D10Blob* AssetLoader::GetShaderBlob(AssetHandle asset) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const Asset* a = Find(asset);
+	return (a && a->Type == ASSET_SHADER && a->State == ASSET_READY) ? a->Shader : 0;
+}
+
+ID3D10Blob* AssetLoader::DetachShaderErrors(AssetHandle asset)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Asset* a = Find(asset);
+	if (!a || a->State != ASSET_FAILED)
+	{
+		return 0;
+	}
+
+	ID3D10Blob* errors = a->Errors;
+	a->Errors = 0;
+	return errors;
+}
+
+const std::wstring& AssetLoader::GetFileName(AssetHandle asset) const
+{
+	static const std::wstring empty;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const Asset* a = Find(asset);
+	return a ? a->FileName : empty;
+}
+
+AssetLoader::Asset* AssetLoader::NewAsset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_assets.push_back(Asset());
+
+	Asset* asset = &m_assets.back();
+	asset->State = ASSET_READING;
+	asset->CompileFlags = 0;
+	asset->ReadJob = 0;
+	asset->DecodeJob = 0;
+	asset->Texture = 0;
+	asset->Shader = 0;
+	asset->Errors = 0;
+
+	return asset;
+}
+
+AssetLoader::Asset* AssetLoader::Find(AssetHandle asset)
+{
+	return (asset > 0 && asset <= m_assets.size()) ? &m_assets[asset - 1] : 0;
+}
+
+const AssetLoader::Asset* AssetLoader::Find(AssetHandle asset) const
+{
+	return (asset > 0 && asset <= m_assets.size()) ? &m_assets[asset - 1] : 0;
+}
+
+//I/O worker: pull the whole file into memory. Empty files fail here, none
+//of the decoders would take them.
+void AssetLoader::Read(Asset* asset)
+{
+	MappedFile file;
+	bool ok = file.Open(asset->FileName.c_str());
+	if (ok)
+	{
+		const char* data = reinterpret_cast<const char*>(file.Data());
+		asset->FileData.assign(data, data + file.Size());
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	asset->State = ok ? ASSET_DECODING : ASSET_FAILED;
+}
+
+//CPU worker: turn the bytes into the runtime object
+void AssetLoader::Decode(Asset* asset)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (asset->State == ASSET_FAILED)
+		{
+			return;
+		}
+
+		//An asset built on a failed dependency fails as well
+		for (size_t i = 0; i < asset->Dependencies.size(); ++i)
+		{
+			if (Find(asset->Dependencies[i])->State != ASSET_READY)
+			{
+				asset->State = ASSET_FAILED;
+				return;
+			}
+		}
+	}
+
+	switch (asset->Type)
+	{
+	case ASSET_MESH:
+		DecodeMesh(asset);
+		break;
+
+	case ASSET_TEXTURE:
+		DecodeTexture(asset);
+		break;
+
+	case ASSET_SHADER:
+		DecodeShader(asset);
+		break;
+	}
+}
+
+void AssetLoader::DecodeMesh(Asset* asset)
+{
+	size_t size = asset->FileData.size();
+
+	//ParseModel needs the text zero terminated
+	asset->FileData.push_back('\0');
+	bool ok = size > 0 && ParseModel(&asset->FileData[0], size, asset->Mesh);
+
+	//Text is no longer needed once parsed
+	std::vector<char>().swap(asset->FileData);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	asset->State = ok ? ASSET_READY : ASSET_FAILED;
+}
+
+void AssetLoader::DecodeTexture(Asset* asset)
+{
+	bool ok = !asset->FileData.empty();
+
+	if (ok && m_device)
+	{
+		HRESULT hr = DirectX::CreateDDSTextureFromMemory(m_device,
+			reinterpret_cast<const uint8_t*>(&asset->FileData[0]), asset->FileData.size(),
+			nullptr, &asset->Texture);
+
+		ok = SUCCEEDED(hr);
+		std::vector<char>().swap(asset->FileData);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	asset->State = ok ? ASSET_READY : ASSET_FAILED;
+}
+
+void AssetLoader::DecodeShader(Asset* asset)
+{
+	HRESULT hr = E_FAIL;
+
+	if (!asset->FileData.empty())
+	{
+		if (EndsWith(asset->FileName, L".cso"))
+		{
+			//Already compiled offline
+			hr = D3DCreateBlob(asset->FileData.size(), &asset->Shader);
+			if (SUCCEEDED(hr))
+			{
+				memcpy(asset->Shader->GetBufferPointer(), &asset->FileData[0], asset->FileData.size());
+			}
+		}
+		else
+		{
+			std::string sourceName = ToUtf8(asset->FileName);
+
+			hr = D3DCompile(&asset->FileData[0], asset->FileData.size(), sourceName.c_str(),
+				NULL, D3D_COMPILE_STANDARD_FILE_INCLUDE,
+				asset->EntryPoint.c_str(), asset->Target.c_str(), asset->CompileFlags, 0,
+				&asset->Shader, &asset->Errors);
+		}
+	}
+
+	std::vector<char>().swap(asset->FileData);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	asset->State = SUCCEEDED(hr) ? ASSET_READY : ASSET_FAILED;
+}
+
+//
+//VertexCount: n
+//TriangleCount: m
+//VertexList (pos, normal)
+//{
+//	px py pz nx ny nz
+//	...
+//}
+//TriangleList
+//{
+//	i0 i1 i2
+//	...
+//}
+//
+bool AssetLoader::ParseModel(const char* text, size_t size, GeometryGenerator::MeshData& meshData)
+{
+	const char* cursor = text;
+	const char* end = text + size;
+
+	UINT vcount = 0;
+	UINT tcount = 0;
+
+	if (!SkipPast(cursor, end, "VertexCount:") || !ReadUInt(cursor, vcount) ||
+		!SkipPast(cursor, end, "TriangleCount:") || !ReadUInt(cursor, tcount) ||
+		!SkipPast(cursor, end, "{"))
+	{
+		return false;
+	}
+
+	meshData.Vertices.resize(vcount);
+	for (UINT i = 0; i < vcount; ++i)
+	{
+		GeometryGenerator::Vertex& v = meshData.Vertices[i];
+
+		if (!ReadFloat(cursor, v.Position.x) || !ReadFloat(cursor, v.Position.y) || !ReadFloat(cursor, v.Position.z) ||
+			!ReadFloat(cursor, v.Normal.x) || !ReadFloat(cursor, v.Normal.y) || !ReadFloat(cursor, v.Normal.z))
+		{
+			return false;
+		}
+
+		v.TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		v.TexC = XMFLOAT2(0.0f, 0.0f);
+	}
+
+	if (!SkipPast(cursor, end, "TriangleList") || !SkipPast(cursor, end, "{"))
+	{
+		return false;
+	}
+
+	meshData.Indices.resize(3 * tcount);
+	for (UINT i = 0; i < 3 * tcount; ++i)
+	{
+		if (!ReadUInt(cursor, meshData.Indices[i]) || meshData.Indices[i] >= vcount)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
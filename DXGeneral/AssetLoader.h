@@ -0,0 +1,144 @@
+#pragma once
+
+//Asynchronous asset loading
+//
+//Meshes (the "VertexCount/TriangleList" text format used by the book's
+//models), DDS textures and shaders are read on the I/O workers of a
+//JobSystem and decoded (parsed, compiled, created) on its CPU workers, so
+//file reads overlap with decoding instead of adding up inside Init().
+//
+//Every request has a priority and may depend on other requests; its decode
+//step only starts once the dependencies are decoded. Requests made with
+//PRIORITY_CRITICAL are the ones WaitForCritical() blocks on, everything else
+//keeps streaming in afterwards.
+
+#ifndef _ASSETLOADER_H_
+#define _ASSETLOADER_H_
+
+#include "d3dUtil.h"
+#include "GeometryGenerator.h"
+#include "JobSystem.h"
+
+#include<deque>
+#include<mutex>
+
+class AssetLoader
+{
+public:
+	//0 is never a valid handle
+	typedef UINT AssetHandle;
+
+	enum AssetType
+	{
+		ASSET_MESH,
+		ASSET_TEXTURE,
+		ASSET_SHADER
+	};
+
+	enum AssetState
+	{
+		ASSET_READING,
+		ASSET_DECODING,
+		ASSET_READY,
+		ASSET_FAILED
+	};
+
+public:
+	AssetLoader(JobSystem& jobs = JobSystem::Default());
+	~AssetLoader();
+
+	//Textures are created during decode when a device is set, ID3D11Device
+	//is free threaded. Without a device they are kept as raw DDS bytes.
+	void SetDevice(ID3D11Device* device);
+
+	AssetHandle LoadMesh(const std::wstring& fileName,
+		JobSystem::JobPriority priority = JobSystem::PRIORITY_CRITICAL,
+		const AssetHandle* dependencies = 0, UINT dependencyCount = 0);
+
+	AssetHandle LoadTexture(const std::wstring& fileName,
+		JobSystem::JobPriority priority = JobSystem::PRIORITY_NORMAL,
+		const AssetHandle* dependencies = 0, UINT dependencyCount = 0);
+
+	//".cso" files are used as precompiled blobs, anything else is compiled
+	AssetHandle LoadShader(const std::wstring& fileName,
+		const std::string& entryPoint, const std::string& target, UINT compileFlags,
+		JobSystem::JobPriority priority = JobSystem::PRIORITY_CRITICAL,
+		const AssetHandle* dependencies = 0, UINT dependencyCount = 0);
+
+	AssetState GetState(AssetHandle asset) const;
+
+	//Fraction of requested assets that are ready or failed, in [0, 1]
+	float Progress() const;
+
+	//Return false if any of the waited for assets failed
+	bool WaitForCritical();
+	bool WaitForAll();
+
+	//Results are owned by the loader and valid until it is destroyed
+	const GeometryGenerator::MeshData* GetMesh(AssetHandle asset) const;
+	ID3D11ShaderResourceView* GetTexture(AssetHandle asset) const;
+	const std::vector<char>* GetTextureData(AssetHandle asset) const;
+	ID3D10Blob* GetShaderBlob(AssetHandle asset) const;
+
+	//Hands the compiler output of a failed shader to the caller,
+	//who must release it (OutputShaderErrorMessage does)
+	ID3D10Blob* DetachShaderErrors(AssetHandle asset);
+
+	const std::wstring& GetFileName(AssetHandle asset) const;
+
+	//Parses the text model format into positions, normals and indices.
+	//text[size] must be a terminating zero.
+	static bool ParseModel(const char* text, size_t size, GeometryGenerator::MeshData& meshData);
+
+private:
+	struct Asset
+	{
+		AssetType Type;
+		AssetState State;
+		JobSystem::JobPriority Priority;
+
+		std::wstring FileName;
+		std::string EntryPoint;
+		std::string Target;
+		UINT CompileFlags;
+
+		std::vector<AssetHandle> Dependencies;
+		JobSystem::JobHandle ReadJob;
+		JobSystem::JobHandle DecodeJob;
+
+		std::vector<char> FileData;
+
+		GeometryGenerator::MeshData Mesh;
+		ID3D11ShaderResourceView* Texture;
+		ID3D10Blob* Shader;
+		ID3D10Blob* Errors;
+	};
+
+	AssetHandle Request(Asset* asset, const AssetHandle* dependencies, UINT dependencyCount);
+
+	void Read(Asset* asset);
+	void Decode(Asset* asset);
+	void DecodeMesh(Asset* asset);
+	void DecodeTexture(Asset* asset);
+	void DecodeShader(Asset* asset);
+
+	Asset* NewAsset();
+	Asset* Find(AssetHandle asset);
+	const Asset* Find(AssetHandle asset) const;
+
+	bool Wait(bool criticalOnly);
+
+private:
+	JobSystem& m_jobs;
+	ID3D11Device* m_device;
+
+	//m_requestMutex serializes requests and is taken before m_mutex,
+	//which guards the records and is never held while a job is submitted
+	mutable std::mutex m_requestMutex;
+	mutable std::mutex m_mutex;
+
+	//deque keeps the records in place while the workers fill them in
+	std::deque<Asset> m_assets;
+};
+
+#endif
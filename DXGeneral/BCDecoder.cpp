@@ -0,0 +1,1069 @@
+//--------------------------------------------------------------------------------------
+// File: BCDecoder.cpp
+//
+// CPU decompression of the BC1-BC7 block formats, declared in DDSParser.h
+//
+// Used where the GPU cannot sample a file as it is (feature level, tools, tests).
+// BC1-BC5 texels are looked up in a palette of at most eight entries; built with
+// /arch:AVX, or on x86 CPUs found to have SSSE3 at start up, the lookup is one byte
+// shuffle per row of four texels. BC6H and BC7 carry
+// their endpoints in per-mode bit layouts and are unpacked bit by bit. Rows of blocks
+// are independent and are spread over the JobSystem CPU workers.
+//--------------------------------------------------------------------------------------
+
+#include "DDSParser.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define BC_SHUFFLE
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define BC_SHUFFLE
+#elif defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+// MSVC never defines __SSSE3__ but compiles the intrinsics without /arch, the
+// CPU is asked whether it runs them
+#include <intrin.h>
+#include <tmmintrin.h>
+#define BC_SHUFFLE
+#define BC_SHUFFLE_CPUID
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+    enum BC_KIND
+    {
+        BC_NONE = 0,
+        BC_1,
+        BC_2,
+        BC_3,
+        BC_4U,
+        BC_4S,
+        BC_5U,
+        BC_5S,
+        BC_6HU,
+        BC_6HS,
+        BC_7,
+    };
+
+    BC_KIND GetBCKind(DXGI_FORMAT fmt)
+    {
+        switch (fmt)
+        {
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            return BC_1;
+
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+            return BC_2;
+
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            return BC_3;
+
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+            return BC_4U;
+
+        case DXGI_FORMAT_BC4_SNORM:
+            return BC_4S;
+
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+            return BC_5U;
+
+        case DXGI_FORMAT_BC5_SNORM:
+            return BC_5S;
+
+        case DXGI_FORMAT_BC6H_TYPELESS:
+        case DXGI_FORMAT_BC6H_UF16:
+            return BC_6HU;
+
+        case DXGI_FORMAT_BC6H_SF16:
+            return BC_6HS;
+
+        case DXGI_FORMAT_BC7_TYPELESS:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            return BC_7;
+
+        default:
+            return BC_NONE;
+        }
+    }
+
+    size_t BlockBytes(BC_KIND kind)
+    {
+        return (kind == BC_1 || kind == BC_4U || kind == BC_4S) ? 8 : 16;
+    }
+
+    size_t TexelBytes(BC_KIND kind)
+    {
+        return (kind == BC_6HU || kind == BC_6HS) ? 8 : 4;
+    }
+
+    inline uint32_t Load32(const uint8_t* p)
+    {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    inline uint64_t Load64(const uint8_t* p)
+    {
+        return uint64_t(Load32(p)) | (uint64_t(Load32(p + 4)) << 32);
+    }
+
+#if defined(BC_SHUFFLE_CPUID)
+    bool DetectShuffle()
+    {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;   // SSSE3
+    }
+
+    const bool g_hasShuffle = DetectShuffle();
+
+    inline bool HasShuffle() { return g_hasShuffle; }
+#elif defined(BC_SHUFFLE)
+    inline bool HasShuffle() { return true; }
+#endif
+
+    // n / d rounded to nearest, halves away from zero
+    inline int RoundDiv(int n, int d)
+    {
+        return (n >= 0) ? (n + d / 2) / d : -((-n + d / 2) / d);
+    }
+
+    //----------------------------------------------------------------------------------
+    // Palette lookups, 16 texels of one block in raster order
+    //----------------------------------------------------------------------------------
+    inline void Lookup4(const uint32_t palette[4], const uint8_t index[16], uint32_t out[16])
+    {
+#if defined(BC_SHUFFLE)
+        if (HasShuffle())
+        {
+            const __m128i pal = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette));
+            const __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(index));
+            const __m128i lanes = _mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3);
+            const __m128i four = _mm_set1_epi8(4);
+
+            // Byte k of a texel pulls byte k of its palette entry
+            __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+            for (size_t row = 0; row < 4; ++row)
+            {
+                __m128i sel = _mm_shuffle_epi8(idx, spread);
+                sel = _mm_add_epi8(_mm_slli_epi16(sel, 2), lanes);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + row * 4), _mm_shuffle_epi8(pal, sel));
+                spread = _mm_add_epi8(spread, four);
+            }
+            return;
+        }
+#endif
+        for (size_t i = 0; i < 16; ++i)
+            out[i] = palette[index[i]];
+    }
+
+    inline void Lookup8(const uint8_t palette[8], const uint8_t index[16], uint8_t out[16])
+    {
+#if defined(BC_SHUFFLE)
+        if (HasShuffle())
+        {
+            const __m128i pal = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(palette));
+            const __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(index));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(pal, idx));
+            return;
+        }
+#endif
+        for (size_t i = 0; i < 16; ++i)
+            out[i] = palette[index[i]];
+    }
+
+    // Replaces the alpha byte of every texel
+    inline void MergeAlpha(const uint8_t alpha[16], uint32_t rgba[16])
+    {
+#if defined(BC_SHUFFLE)
+        if (HasShuffle())
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(alpha));
+            const __m128i rgbMask = _mm_set1_epi32(0x00ffffff);
+            const __m128i four = _mm_set1_epi32(0x04000000);
+
+            __m128i spread = _mm_setr_epi8(-128, -128, -128, 0, -128, -128, -128, 1, -128, -128, -128, 2, -128, -128, -128, 3);
+            for (size_t row = 0; row < 4; ++row)
+            {
+                __m128i* p = reinterpret_cast<__m128i*>(rgba + row * 4);
+                __m128i c = _mm_and_si128(_mm_loadu_si128(p), rgbMask);
+                _mm_storeu_si128(p, _mm_or_si128(c, _mm_shuffle_epi8(a, spread)));
+                spread = _mm_add_epi8(spread, four);
+            }
+            return;
+        }
+#endif
+        for (size_t i = 0; i < 16; ++i)
+            rgba[i] = (rgba[i] & 0x00ffffff) | (uint32_t(alpha[i]) << 24);
+    }
+
+    // BC4/BC5 channels into red and green, blue zero, alpha one
+    inline void MergeChannels(const uint8_t red[16], const uint8_t* green, uint32_t alphaOne, uint32_t rgba[16])
+    {
+#if defined(BC_SHUFFLE)
+        if (HasShuffle())
+        {
+            const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(red));
+            const __m128i g = green ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(green)) : _mm_setzero_si128();
+            const __m128i a = _mm_set1_epi32(static_cast<int>(alphaOne));
+            const __m128i four = _mm_set1_epi32(4);
+            const __m128i fourG = _mm_set1_epi32(4 << 8);
+
+            __m128i spreadR = _mm_setr_epi8(0, -128, -128, -128, 1, -128, -128, -128, 2, -128, -128, -128, 3, -128, -128, -128);
+            __m128i spreadG = _mm_setr_epi8(-128, 0, -128, -128, -128, 1, -128, -128, -128, 2, -128, -128, -128, 3, -128, -128);
+            for (size_t row = 0; row < 4; ++row)
+            {
+                __m128i c = _mm_or_si128(_mm_shuffle_epi8(r, spreadR), _mm_shuffle_epi8(g, spreadG));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + row * 4), _mm_or_si128(c, a));
+                spreadR = _mm_add_epi8(spreadR, four);
+                spreadG = _mm_add_epi8(spreadG, fourG);
+            }
+            return;
+        }
+#endif
+        for (size_t i = 0; i < 16; ++i)
+            rgba[i] = uint32_t(red[i]) | (green ? uint32_t(green[i]) << 8 : 0) | alphaOne;
+    }
+
+    //----------------------------------------------------------------------------------
+    // BC1-BC5
+    //----------------------------------------------------------------------------------
+    inline uint32_t Expand565(uint32_t c)
+    {
+        uint32_t r = (c >> 11) & 31;
+        uint32_t g = (c >> 5) & 63;
+        uint32_t b = c & 31;
+        r = (r << 3) | (r >> 2);
+        g = (g << 2) | (g >> 4);
+        b = (b << 3) | (b >> 2);
+        return r | (g << 8) | (b << 16) | 0xff000000;
+    }
+
+    // (2 * c0 + c1) / 3 per channel, rounded, opaque
+    inline uint32_t Blend21(uint32_t c0, uint32_t c1)
+    {
+        uint32_t result = 0xff000000;
+        for (uint32_t shift = 0; shift < 24; shift += 8)
+        {
+            uint32_t v = 2 * ((c0 >> shift) & 0xff) + ((c1 >> shift) & 0xff) + 1;
+            result |= ((v * 0xaaab) >> 17) << shift;
+        }
+        return result;
+    }
+
+    // (c0 + c1) / 2 per channel, rounded, opaque
+    inline uint32_t Blend11(uint32_t c0, uint32_t c1)
+    {
+        return ((c0 | c1) - (((c0 ^ c1) & 0xfefefefe) >> 1)) | 0xff000000;
+    }
+
+    // BC2 and BC3 color blocks always use four colors
+    void DecodeColorBlock(const uint8_t* block, bool allowTransparent, uint32_t rgba[16])
+    {
+        uint32_t c0 = uint32_t(block[0]) | (uint32_t(block[1]) << 8);
+        uint32_t c1 = uint32_t(block[2]) | (uint32_t(block[3]) << 8);
+
+        uint32_t palette[4];
+        palette[0] = Expand565(c0);
+        palette[1] = Expand565(c1);
+        if (c0 > c1 || !allowTransparent)
+        {
+            palette[2] = Blend21(palette[0], palette[1]);
+            palette[3] = Blend21(palette[1], palette[0]);
+        }
+        else
+        {
+            palette[2] = Blend11(palette[0], palette[1]);
+            palette[3] = 0;
+        }
+
+        uint32_t bits = Load32(block + 4);
+        uint8_t index[16];
+        for (size_t i = 0; i < 16; ++i)
+            index[i] = uint8_t((bits >> (2 * i)) & 3);
+
+        Lookup4(palette, index, rgba);
+    }
+
+    void DecodeExplicitAlpha(const uint8_t* block, uint8_t alpha[16])
+    {
+        uint64_t bits = Load64(block);
+        for (size_t i = 0; i < 16; ++i)
+        {
+            uint8_t a = uint8_t((bits >> (4 * i)) & 0xf);
+            alpha[i] = uint8_t(a | (a << 4));
+        }
+    }
+
+    // One BC4 channel, also the alpha of BC3 and either half of BC5
+    void DecodeChannelBlock(const uint8_t* block, bool isSigned, uint8_t out[16])
+    {
+        uint8_t palette[8];
+        if (isSigned)
+        {
+            int a0 = std::max<int>(static_cast<int8_t>(block[0]), -127);
+            int a1 = std::max<int>(static_cast<int8_t>(block[1]), -127);
+            int p[8] = { a0, a1 };
+            if (a0 > a1)
+            {
+                for (int i = 1; i < 7; ++i)
+                    p[i + 1] = RoundDiv((7 - i) * a0 + i * a1, 7);
+            }
+            else
+            {
+                for (int i = 1; i < 5; ++i)
+                    p[i + 1] = RoundDiv((5 - i) * a0 + i * a1, 5);
+                p[6] = -127;
+                p[7] = 127;
+            }
+            for (size_t i = 0; i < 8; ++i)
+                palette[i] = static_cast<uint8_t>(static_cast<int8_t>(p[i]));
+        }
+        else
+        {
+            uint32_t a0 = block[0];
+            uint32_t a1 = block[1];
+            palette[0] = uint8_t(a0);
+            palette[1] = uint8_t(a1);
+            if (a0 > a1)
+            {
+                for (uint32_t i = 1; i < 7; ++i)
+                    palette[i + 1] = uint8_t(((7 - i) * a0 + i * a1 + 3) / 7);
+            }
+            else
+            {
+                for (uint32_t i = 1; i < 5; ++i)
+                    palette[i + 1] = uint8_t(((5 - i) * a0 + i * a1 + 2) / 5);
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+        }
+
+        uint64_t bits = Load64(block) >> 16;
+        uint8_t index[16];
+        for (size_t i = 0; i < 16; ++i)
+            index[i] = uint8_t((bits >> (3 * i)) & 7);
+
+        Lookup8(palette, index, out);
+    }
+
+    //----------------------------------------------------------------------------------
+    // Shared by BC6H and BC7
+    //----------------------------------------------------------------------------------
+
+    // Bit i set when texel i is in the second subset
+    const uint16_t c_partitions2[64] =
+    {
+        0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+        0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+        0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+        0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+        0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+        0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+        0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+        0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+    };
+
+    // Two bits per texel, subset of texel i at bit 2 * i
+    const uint32_t c_partitions3[64] =
+    {
+        0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050,
+        0x5555a0a0, 0x5a5a5050, 0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090,
+        0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250, 0xa5945040, 0x0a425054,
+        0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+        0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414,
+        0x50a4a450, 0x6a5a0200, 0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424,
+        0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50, 0x500aa550, 0xaaaa4444,
+        0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+        0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580,
+        0xaa141414, 0x96960000, 0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000,
+        0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254,
+    };
+
+    // Texels whose index drops its top bit; the first subset always anchors at 0
+    const uint8_t c_anchor2[64] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+    };
+
+    const uint8_t c_anchor3a[64] =
+    {
+         3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+         3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+         8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+         3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+    };
+
+    const uint8_t c_anchor3b[64] =
+    {
+        15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+        15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+        15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+        15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+    };
+
+    const uint8_t c_weights2[4] = { 0, 21, 43, 64 };
+    const uint8_t c_weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const uint8_t c_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    inline const uint8_t* GetWeights(uint32_t indexBits)
+    {
+        return (indexBits == 2) ? c_weights2 : (indexBits == 3) ? c_weights3 : c_weights4;
+    }
+
+    // Reads a 128 bit block from the least significant bit up
+    class BitReader
+    {
+    public:
+        explicit BitReader(const uint8_t* block) :
+            m_lo(Load64(block)),
+            m_hi(Load64(block + 8)),
+            m_pos(0)
+        {
+        }
+
+        uint32_t Read(uint32_t count)
+        {
+            if (!count)
+                return 0;
+
+            uint64_t bits;
+            if (m_pos >= 64)
+                bits = m_hi >> (m_pos - 64);
+            else if (m_pos + count <= 64)
+                bits = m_lo >> m_pos;
+            else
+                bits = (m_lo >> m_pos) | (m_hi << (64 - m_pos));
+
+            m_pos += count;
+            return uint32_t(bits & ((uint64_t(1) << count) - 1));
+        }
+
+        uint32_t Position() const { return m_pos; }
+
+    private:
+        uint64_t m_lo;
+        uint64_t m_hi;
+        uint32_t m_pos;
+    };
+
+    //----------------------------------------------------------------------------------
+    // BC7
+    //----------------------------------------------------------------------------------
+    struct BC7Mode
+    {
+        uint8_t subsets;
+        uint8_t partitionBits;
+        uint8_t rotationBits;
+        uint8_t indexSelectionBits;
+        uint8_t colorBits;
+        uint8_t alphaBits;
+        uint8_t endpointPBits;
+        uint8_t sharedPBits;
+        uint8_t indexBits;
+        uint8_t indexBits2;
+    };
+
+    const BC7Mode c_bc7Modes[8] =
+    {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+    };
+
+    inline uint32_t GetSubset(uint32_t subsets, uint32_t partition, size_t texel)
+    {
+        if (subsets == 2)
+            return (c_partitions2[partition] >> texel) & 1;
+        if (subsets == 3)
+            return (c_partitions3[partition] >> (2 * texel)) & 3;
+        return 0;
+    }
+
+    inline bool IsAnchor(uint32_t subsets, uint32_t partition, size_t texel)
+    {
+        if (texel == 0)
+            return true;
+        if (subsets == 2)
+            return texel == c_anchor2[partition];
+        if (subsets == 3)
+            return texel == c_anchor3a[partition] || texel == c_anchor3b[partition];
+        return false;
+    }
+
+    inline uint32_t Unquantize(uint32_t value, uint32_t bits)
+    {
+        value <<= (8 - bits);
+        return value | (value >> bits);
+    }
+
+    void DecodeBC7Block(const uint8_t* block, uint32_t rgba[16])
+    {
+        uint32_t mode = 0;
+        while (mode < 8 && !(block[0] & (1u << mode)))
+            ++mode;
+
+        // Reserved encoding
+        if (mode == 8)
+        {
+            memset(rgba, 0, 16 * sizeof(uint32_t));
+            return;
+        }
+
+        const BC7Mode& m = c_bc7Modes[mode];
+        BitReader bits(block);
+        bits.Read(mode + 1);
+
+        uint32_t partition = bits.Read(m.partitionBits);
+        uint32_t rotation = bits.Read(m.rotationBits);
+        uint32_t indexSelection = bits.Read(m.indexSelectionBits);
+
+        // [subset][endpoint][channel]
+        uint32_t endpoints[3][2][4];
+        for (size_t c = 0; c < 3; ++c)
+            for (size_t s = 0; s < m.subsets; ++s)
+                for (size_t e = 0; e < 2; ++e)
+                    endpoints[s][e][c] = bits.Read(m.colorBits);
+
+        for (size_t s = 0; s < m.subsets; ++s)
+            for (size_t e = 0; e < 2; ++e)
+                endpoints[s][e][3] = m.alphaBits ? bits.Read(m.alphaBits) : 255;
+
+        uint32_t colorBits = m.colorBits;
+        uint32_t alphaBits = m.alphaBits;
+        if (m.endpointPBits || m.sharedPBits)
+        {
+            for (size_t s = 0; s < m.subsets; ++s)
+            {
+                uint32_t shared = m.sharedPBits ? bits.Read(1) : 0;
+                for (size_t e = 0; e < 2; ++e)
+                {
+                    uint32_t p = m.sharedPBits ? shared : bits.Read(1);
+                    for (size_t c = 0; c < 3; ++c)
+                        endpoints[s][e][c] = (endpoints[s][e][c] << 1) | p;
+                    if (m.alphaBits)
+                        endpoints[s][e][3] = (endpoints[s][e][3] << 1) | p;
+                }
+            }
+            ++colorBits;
+            if (alphaBits)
+                ++alphaBits;
+        }
+
+        for (size_t s = 0; s < m.subsets; ++s)
+        {
+            for (size_t e = 0; e < 2; ++e)
+            {
+                for (size_t c = 0; c < 3; ++c)
+                    endpoints[s][e][c] = Unquantize(endpoints[s][e][c], colorBits);
+                if (alphaBits)
+                    endpoints[s][e][3] = Unquantize(endpoints[s][e][3], alphaBits);
+            }
+        }
+
+        uint8_t index[16];
+        for (size_t i = 0; i < 16; ++i)
+            index[i] = uint8_t(bits.Read(m.indexBits - (IsAnchor(m.subsets, partition, i) ? 1 : 0)));
+
+        uint8_t index2[16] = {};
+        if (m.indexBits2)
+        {
+            for (size_t i = 0; i < 16; ++i)
+                index2[i] = uint8_t(bits.Read(m.indexBits2 - (i == 0 ? 1 : 0)));
+        }
+
+        // Modes 4 and 5 weight alpha separately, mode 4 can swap the two index sets
+        const uint8_t* colorIndex = index;
+        const uint8_t* alphaIndex = m.indexBits2 ? index2 : index;
+        const uint8_t* colorWeights = GetWeights(m.indexBits);
+        const uint8_t* alphaWeights = GetWeights(m.indexBits2 ? m.indexBits2 : m.indexBits);
+        if (indexSelection)
+        {
+            std::swap(colorIndex, alphaIndex);
+            std::swap(colorWeights, alphaWeights);
+        }
+
+        for (size_t i = 0; i < 16; ++i)
+        {
+            const uint32_t (&ep)[2][4] = endpoints[GetSubset(m.subsets, partition, i)];
+
+            uint32_t texel[4];
+            uint32_t w = colorWeights[colorIndex[i]];
+            for (size_t c = 0; c < 3; ++c)
+                texel[c] = ((64 - w) * ep[0][c] + w * ep[1][c] + 32) >> 6;
+
+            w = alphaWeights[alphaIndex[i]];
+            texel[3] = ((64 - w) * ep[0][3] + w * ep[1][3] + 32) >> 6;
+
+            if (rotation)
+                std::swap(texel[3], texel[rotation - 1]);
+
+            rgba[i] = texel[0] | (texel[1] << 8) | (texel[2] << 16) | (texel[3] << 24);
+        }
+    }
+
+    //----------------------------------------------------------------------------------
+    // BC6H
+    //----------------------------------------------------------------------------------
+
+    // Endpoint components: w/x are the two ends of the first subset, y/z of the second
+    enum BC6H_FIELD
+    {
+        RW, GW, BW, RX, GX, BX, RY, GY, BY, RZ, GZ, BZ,
+    };
+
+    // count bits of the block go to field bits [shift, shift + count)
+    struct BC6HRun
+    {
+        uint8_t field;
+        uint8_t shift;
+        uint8_t count;
+    };
+
+    struct BC6HMode
+    {
+        uint8_t value;
+        uint8_t modeBits;
+        uint8_t regions;
+        bool transformed;
+        uint8_t endpointBits;
+        uint8_t deltaBits[3];
+        BC6HRun runs[32];
+    };
+
+    const BC6HMode c_bc6hModes[14] =
+    {
+        { 0x00, 2, 2, true, 10, { 5, 5, 5 }, {
+            { GY, 4, 1 }, { BY, 4, 1 }, { BZ, 4, 1 }, { RW, 0, 10 }, { GW, 0, 10 }, { BW, 0, 10 },
+            { RX, 0, 5 }, { GZ, 4, 1 }, { GY, 0, 4 }, { GX, 0, 5 }, { BZ, 0, 1 }, { GZ, 0, 4 },
+            { BX, 0, 5 }, { BZ, 1, 1 }, { BY, 0, 4 }, { RY, 0, 5 }, { BZ, 2, 1 }, { RZ, 0, 5 }, { BZ, 3, 1 } } },
+        { 0x01, 2, 2, true, 7, { 6, 6, 6 }, {
+            { GY, 5, 1 }, { GZ, 4, 1 }, { GZ, 5, 1 }, { RW, 0, 7 }, { BZ, 0, 1 }, { BZ, 1, 1 }, { BY, 4, 1 },
+            { GW, 0, 7 }, { BY, 5, 1 }, { BZ, 2, 1 }, { GY, 4, 1 }, { BW, 0, 7 }, { BZ, 3, 1 }, { BZ, 5, 1 },
+            { BZ, 4, 1 }, { RX, 0, 6 }, { GY, 0, 4 }, { GX, 0, 6 }, { GZ, 0, 4 }, { BX, 0, 6 }, { BY, 0, 4 },
+            { RY, 0, 6 }, { RZ, 0, 6 } } },
+        { 0x02, 5, 2, true, 11, { 5, 4, 4 }, {
+            { RW, 0, 10 }, { GW, 0, 10 }, { BW, 0, 10 }, { RX, 0, 5 }, { RW, 10, 1 }, { GY, 0, 4 },
+            { GX, 0, 4 }, { GW, 10, 1 }, { BZ, 0, 1 }, { GZ, 0, 4 }, { BX, 0, 4 }, { BW, 10, 1 },
+            { BZ, 1, 1 }, { BY, 0, 4 }, { RY, 0, 5 }, { BZ, 2, 1 }, { RZ, 0, 5 }, { BZ, 3, 1 } } },
+        { 0x06, 5, 2, true, 11, { 4, 5, 4 }, {
+            { RW, 0, 10 }, { GW, 0, 10 }, { BW, 0, 10 }, { RX, 0, 4 }, { RW, 10, 1 }, { GZ, 4, 1 },
+            { GY, 0, 4 }, { GX, 0, 5 }, { GW, 10, 1 }, { GZ, 0, 4 }, { BX, 0, 4 }, { BW, 10, 1 },
+            { BZ, 1, 1 }, { BY, 0, 4 }, { RY, 0, 4 }, { BZ, 0, 1 }, { BZ, 2, 1 }, { RZ, 0, 4 },
+            { GY, 4, 1 }, { BZ, 3, 1 } } },
+        { 0x0a, 5, 2, true, 11, { 4, 4, 5 }, {
+            { RW, 0, 10 }, { GW, 0, 10 }, { BW, 0, 10 }, { RX, 0, 4 }, { RW, 10, 1 }, { BY, 4, 1 },
+            { GY, 0, 4 }, { GX, 0, 4 }, { GW, 10, 1 }, { BZ, 0, 1 }, { GZ, 0, 4 }, { BX, 0, 5 },
+            { BW, 10, 1 }, { BY, 0, 4 }, { RY, 0, 4 }, { BZ, 1, 1 }, { BZ, 2, 1 }, { RZ, 0, 4 },
+            { BZ, 4, 1 }, { BZ, 3, 1 } } },
+        { 0x0e, 5, 2, true, 9, { 5, 5, 5 }, {
+            { RW, 0, 9 }, { BY, 4, 1 }, { GW, 0, 9 }, { GY, 4, 1 }, { BW, 0, 9 }, { BZ, 4, 1 },
+            { RX, 0, 5 }, { GZ, 4, 1 }, { GY, 0, 4 }, { GX, 0, 5 }, { BZ, 0, 1 }, { GZ, 0, 4 },
+            { BX, 0, 5 }, { BZ, 1, 1 }, { BY, 0, 4 }, { RY, 0, 5 }, { BZ, 2, 1 }, { RZ, 0, 5 }, { BZ, 3, 1 } } },
+        { 0x12, 5, 2, true, 8, { 6, 5, 5 }, {
+            { RW, 0, 8 }, { GZ, 4, 1 }, { BY, 4, 1 }, { GW, 0, 8 }, { BZ, 2, 1 }, { GY, 4, 1 },
+            { BW, 0, 8 }, { BZ, 3, 1 }, { BZ, 4, 1 }, { RX, 0, 6 }, { GY, 0, 4 }, { GX, 0, 5 },
+            { BZ, 0, 1 }, { GZ, 0, 4 }, { BX, 0, 5 }, { BZ, 1, 1 }, { BY, 0, 4 }, { RY, 0, 6 }, { RZ, 0, 6 } } },
+        { 0x16, 5, 2, true, 8, { 5, 6, 5 }, {
+            { RW, 0, 8 }, { BZ, 0, 1 }, { BY, 4, 1 }, { GW, 0, 8 }, { GY, 5, 1 }, { GY, 4, 1 },
+            { BW, 0, 8 }, { GZ, 5, 1 }, { BZ, 4, 1 }, { RX, 0, 5 }, { GZ, 4, 1 }, { GY, 0, 4 },
+            { GX, 0, 6 }, { GZ, 0, 4 }, { BX, 0, 5 }, { BZ, 1, 1 }, { BY, 0, 4 }, { RY, 0, 5 },
+            { BZ, 2, 1 }, { RZ, 0, 5 }, { BZ, 3, 1 } } },
+        { 0x1a, 5, 2, true, 8, { 5, 5, 6 }, {
+            { RW, 0, 8 }, { BZ, 1, 1 }, { BY, 4, 1 }, { GW, 0, 8 }, { BY, 5, 1 }, { GY, 4, 1 },
+            { BW, 0, 8 }, { BZ, 5, 1 }, { BZ, 4, 1 }, { RX, 0, 5 }, { GZ, 4, 1 }, { GY, 0, 4 },
+            { GX, 0, 5 }, { BZ, 0, 1 }, { GZ, 0, 4 }, { BX, 0, 6 }, { BY, 0, 4 }, { RY, 0, 5 },
+            { BZ, 2, 1 }, { RZ, 0, 5 }, { BZ, 3, 1 } } },
+        { 0x1e, 5, 2, false, 6, { 6, 6, 6 }, {
+            { RW, 0, 6 }, { GZ, 4, 1 }, { BZ, 0, 1 }, { BZ, 1, 1 }, { BY, 4, 1 }, { GW, 0, 6 },
+            { GY, 5, 1 }, { BY, 5, 1 }, { BZ, 2, 1 }, { GY, 4, 1 }, { BW, 0, 6 }, { GZ, 5, 1 },
+            { BZ, 3, 1 }, { BZ, 5, 1 }, { BZ, 4, 1 }, { RX, 0, 6 }, { GY, 0, 4 }, { GX, 0, 6 },
+            { GZ, 0, 4 }, { BX, 0, 6 }, { BY, 0, 4 }, { RY, 0, 6 }, { RZ, 0, 6 } } },
+        { 0x03, 5, 1, false, 10, { 10, 10, 10 }, {
+            { RW, 0, 10 }, { GW, 0, 10 }, { BW, 0, 10 }, { RX, 0, 10 }, { GX, 0, 10 }, { BX, 0, 10 } } },
+        { 0x07, 5, 1, true, 11, { 9, 9, 9 }, {
+            { RW, 0, 10 }, { GW, 0, 10 }, { BW, 0, 10 }, { RX, 0, 9 }, { RW, 10, 1 },
+            { GX, 0, 9 }, { GW, 10, 1 }, { BX, 0, 9 }, { BW, 10, 1 } } },
+        { 0x0b, 5, 1, true, 12, { 8, 8, 8 }, {
+            { RW, 0, 10 }, { GW, 0, 10 }, { BW, 0, 10 }, { RX, 0, 8 }, { RW, 11, 1 }, { RW, 10, 1 },
+            { GX, 0, 8 }, { GW, 11, 1 }, { GW, 10, 1 }, { BX, 0, 8 }, { BW, 11, 1 }, { BW, 10, 1 } } },
+        { 0x0f, 5, 1, true, 16, { 4, 4, 4 }, {
+            { RW, 0, 10 }, { GW, 0, 10 }, { BW, 0, 10 },
+            { RX, 0, 4 }, { RW, 15, 1 }, { RW, 14, 1 }, { RW, 13, 1 }, { RW, 12, 1 }, { RW, 11, 1 }, { RW, 10, 1 },
+            { GX, 0, 4 }, { GW, 15, 1 }, { GW, 14, 1 }, { GW, 13, 1 }, { GW, 12, 1 }, { GW, 11, 1 }, { GW, 10, 1 },
+            { BX, 0, 4 }, { BW, 15, 1 }, { BW, 14, 1 }, { BW, 13, 1 }, { BW, 12, 1 }, { BW, 11, 1 }, { BW, 10, 1 } } },
+    };
+
+    inline int SignExtend(int value, uint32_t bits)
+    {
+        int shift = 32 - int(bits);
+        return static_cast<int>(static_cast<uint32_t>(value) << shift) >> shift;
+    }
+
+    // Endpoint to the 16 bit (or signed 16 bit) interpolation range
+    int UnquantizeHalf(int value, uint32_t bits, bool isSigned)
+    {
+        if (!isSigned)
+        {
+            if (bits >= 15 || value == 0)
+                return value;
+            if (value == (1 << bits) - 1)
+                return 0xffff;
+            return ((value << 16) + 0x8000) >> bits;
+        }
+
+        if (bits >= 16)
+            return value;
+
+        bool negative = value < 0;
+        int magnitude = negative ? -value : value;
+        int result;
+        if (magnitude == 0)
+            result = 0;
+        else if (magnitude >= (1 << (bits - 1)) - 1)
+            result = 0x7fff;
+        else
+            result = ((magnitude << 15) + 0x4000) >> (bits - 1);
+        return negative ? -result : result;
+    }
+
+    // Interpolated value to half float bits, scaled by 31/64 (31/32 signed)
+    inline uint16_t FinishHalf(int value, bool isSigned)
+    {
+        if (!isSigned)
+            return uint16_t((value * 31) >> 6);
+
+        if (value < 0)
+            return uint16_t((((-value) * 31) >> 5) | 0x8000);
+        return uint16_t((value * 31) >> 5);
+    }
+
+    void DecodeBC6HBlock(const uint8_t* block, bool isSigned, uint16_t rgba[64])
+    {
+        uint32_t value = block[0] & 0x3;
+        if (value >= 2)
+            value = block[0] & 0x1f;
+
+        const BC6HMode* m = 0;
+        for (size_t i = 0; i < 14; ++i)
+        {
+            if (c_bc6hModes[i].value == value)
+            {
+                m = &c_bc6hModes[i];
+                break;
+            }
+        }
+
+        const uint16_t one = 0x3c00;
+
+        // Reserved modes decode to black
+        if (!m)
+        {
+            for (size_t i = 0; i < 16; ++i)
+            {
+                rgba[i * 4 + 0] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+                rgba[i * 4 + 3] = one;
+            }
+            return;
+        }
+
+        BitReader bits(block);
+        bits.Read(m->modeBits);
+
+        int fields[12] = {};
+        for (size_t i = 0; i < 32 && m->runs[i].count; ++i)
+        {
+            const BC6HRun& run = m->runs[i];
+            fields[run.field] |= int(bits.Read(run.count)) << run.shift;
+        }
+
+        uint32_t partition = (m->regions == 2) ? bits.Read(5) : 0;
+
+        // [region][endpoint][channel]
+        int endpoints[2][2][3];
+        size_t endpointCount = m->regions * 2;
+        for (size_t c = 0; c < 3; ++c)
+        {
+            int base = fields[RW + c];
+            if (isSigned)
+                base = SignExtend(base, m->endpointBits);
+            endpoints[0][0][c] = base;
+
+            for (size_t e = 1; e < endpointCount; ++e)
+            {
+                int v = fields[RW + 3 * e + c];
+                if (m->transformed || isSigned)
+                    v = SignExtend(v, m->deltaBits[c]);
+                if (m->transformed)
+                {
+                    v = (base + v) & ((1 << m->endpointBits) - 1);
+                    if (isSigned)
+                        v = SignExtend(v, m->endpointBits);
+                }
+                endpoints[e / 2][e % 2][c] = v;
+            }
+        }
+
+        for (size_t e = 0; e < endpointCount; ++e)
+            for (size_t c = 0; c < 3; ++c)
+                endpoints[e / 2][e % 2][c] = UnquantizeHalf(endpoints[e / 2][e % 2][c], m->endpointBits, isSigned);
+
+        uint32_t indexBits = (m->regions == 2) ? 3 : 4;
+        const uint8_t* weights = GetWeights(indexBits);
+        for (size_t i = 0; i < 16; ++i)
+        {
+            uint32_t subset = GetSubset(m->regions, partition, i);
+            uint32_t w = weights[bits.Read(indexBits - (IsAnchor(m->regions, partition, i) ? 1 : 0))];
+
+            const int (&ep)[2][3] = endpoints[subset];
+            for (size_t c = 0; c < 3; ++c)
+            {
+                int v = (int(64 - w) * ep[0][c] + int(w) * ep[1][c] + 32) >> 6;
+                rgba[i * 4 + c] = FinishHalf(v, isSigned);
+            }
+            rgba[i * 4 + 3] = one;
+        }
+    }
+
+    //----------------------------------------------------------------------------------
+    // One block into 16 texels of TexelBytes(kind)
+    void DecodeBlock(BC_KIND kind, const uint8_t* block, uint8_t* texels)
+    {
+        uint32_t* rgba = reinterpret_cast<uint32_t*>(texels);
+        uint8_t red[16];
+        uint8_t green[16];
+
+        switch (kind)
+        {
+        case BC_1:
+            DecodeColorBlock(block, true, rgba);
+            break;
+
+        case BC_2:
+            DecodeColorBlock(block + 8, false, rgba);
+            DecodeExplicitAlpha(block, red);
+            MergeAlpha(red, rgba);
+            break;
+
+        case BC_3:
+            DecodeColorBlock(block + 8, false, rgba);
+            DecodeChannelBlock(block, false, red);
+            MergeAlpha(red, rgba);
+            break;
+
+        case BC_4U:
+        case BC_4S:
+            DecodeChannelBlock(block, kind == BC_4S, red);
+            MergeChannels(red, 0, (kind == BC_4S) ? 0x7f000000 : 0xff000000, rgba);
+            break;
+
+        case BC_5U:
+        case BC_5S:
+            DecodeChannelBlock(block, kind == BC_5S, red);
+            DecodeChannelBlock(block + 8, kind == BC_5S, green);
+            MergeChannels(red, green, (kind == BC_5S) ? 0x7f000000 : 0xff000000, rgba);
+            break;
+
+        case BC_6HU:
+        case BC_6HS:
+            DecodeBC6HBlock(block, kind == BC_6HS, reinterpret_cast<uint16_t*>(texels));
+            break;
+
+        case BC_7:
+            DecodeBC7Block(block, rgba);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+bool DirectX::IsCompressed(DXGI_FORMAT fmt)
+{
+    return GetBCKind(fmt) != BC_NONE;
+}
+
+
+//--------------------------------------------------------------------------------------
+DXGI_FORMAT DirectX::GetDecompressedFormat(DXGI_FORMAT fmt)
+{
+    switch (fmt)
+    {
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+
+    case DXGI_FORMAT_BC4_SNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+        return DXGI_FORMAT_R8G8B8A8_SNORM;
+
+    default:
+        break;
+    }
+
+    switch (GetBCKind(fmt))
+    {
+    case BC_NONE:
+        return DXGI_FORMAT_UNKNOWN;
+
+    case BC_6HU:
+    case BC_6HS:
+        return DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+    default:
+        return DXGI_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::DecompressBC(
+    DXGI_FORMAT fmt,
+    size_t width,
+    size_t height,
+    const uint8_t* src,
+    size_t srcRowPitch,
+    uint8_t* dst,
+    size_t dstRowPitch,
+    bool threaded)
+{
+    if (!src || !dst)
+    {
+        return E_POINTER;
+    }
+
+    BC_KIND kind = GetBCKind(fmt);
+    if (kind == BC_NONE)
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    const size_t blockBytes = BlockBytes(kind);
+    const size_t texelBytes = TexelBytes(kind);
+    const size_t blocksWide = (width + 3) / 4;
+    const size_t blocksHigh = (height + 3) / 4;
+
+    if (!width || !height
+        || srcRowPitch < blocksWide * blockBytes
+        || dstRowPitch < width * texelBytes
+        || blocksHigh > UINT32_MAX)
+    {
+        return E_INVALIDARG;
+    }
+
+    auto decodeRows = [&](UINT begin, UINT end, UINT)
+    {
+        uint8_t texels[16 * 8];
+        for (size_t by = begin; by < end; ++by)
+        {
+            const uint8_t* block = src + by * srcRowPitch;
+            size_t rows = std::min<size_t>(4, height - by * 4);
+
+            for (size_t bx = 0; bx < blocksWide; ++bx, block += blockBytes)
+            {
+                DecodeBlock(kind, block, texels);
+
+                size_t columns = std::min<size_t>(4, width - bx * 4);
+                uint8_t* out = dst + by * 4 * dstRowPitch + bx * 4 * texelBytes;
+                if (columns == 4 && texelBytes == 4)
+                {
+                    for (size_t y = 0; y < rows; ++y)
+                        memcpy(out + y * dstRowPitch, texels + y * 16, 16);
+                }
+                else
+                {
+                    for (size_t y = 0; y < rows; ++y)
+                        memcpy(out + y * dstRowPitch, texels + y * 4 * texelBytes, columns * texelBytes);
+                }
+            }
+        }
+    };
+
+    if (threaded && blocksHigh > 1)
+    {
+        // Roughly 4096 blocks per chunk
+        UINT grain = static_cast<UINT>(std::max<size_t>(1, 4096 / blocksWide));
+        JobSystem::Default().ParallelFor(static_cast<UINT>(blocksHigh), grain, decodeRows);
+    }
+    else
+    {
+        decodeRows(0, static_cast<UINT>(blocksHigh), 0);
+    }
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+double DirectX::BenchmarkDecompressBC(
+    DXGI_FORMAT fmt,
+    size_t width,
+    size_t height,
+    unsigned iterations,
+    bool threaded)
+{
+    BC_KIND kind = GetBCKind(fmt);
+    if (kind == BC_NONE || !width || !height || !iterations)
+        return 0.0;
+
+    size_t rowPitch = (width + 3) / 4 * BlockBytes(kind);
+    std::vector<uint8_t> src(rowPitch * ((height + 3) / 4));
+    std::vector<uint8_t> dst(width * TexelBytes(kind) * height);
+
+    // Random blocks hit every mode of BC6H and BC7
+    std::mt19937 random(12345);
+    for (size_t i = 0; i < src.size(); ++i)
+        src[i] = static_cast<uint8_t>(random());
+
+    // Warm up the workers and the pages
+    DecompressBC(fmt, width, height, &src[0], rowPitch, &dst[0], width * TexelBytes(kind), threaded);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+        DecompressBC(fmt, width, height, &src[0], rowPitch, &dst[0], width * TexelBytes(kind), threaded);
+    std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+
+    return double(width) * double(height) * iterations / seconds.count() / 1e6;
+}
+
+
+//--------------------------------------------------------------------------------------
+const char* DirectX::GetBCDecoderInstructionSet()
+{
+#if defined(__AVX__)
+    return "AVX";
+#elif defined(BC_SHUFFLE)
+    return HasShuffle() ? "SSSE3" : "Scalar";
+#else
+    return "Scalar";
+#endif
+}
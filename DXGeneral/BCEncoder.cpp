@@ -0,0 +1,965 @@
+//--------------------------------------------------------------------------------------
+// File: BCEncoder.cpp
+//
+// CPU compression into BC1, BC3, BC4 and BC5, declared in DDSParser.h
+//
+// Meant for textures made at run time (procedural content, CPU mip chains) that would
+// otherwise be uploaded uncompressed. Color endpoints come from the bounding box
+// (fast) or the principal axis of the block (normal, high) and are refined by least
+// squares on the chosen indices; texels pick their nearest palette entry four at a
+// time with SSE. Single color blocks use tables of the best endpoint pairs. Rows of
+// blocks are spread over the JobSystem CPU workers like the decoder does.
+//--------------------------------------------------------------------------------------
+
+#include "DDSParser.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <float.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BC_ENCODE_SSE
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+    enum BC_ENCODE_KIND
+    {
+        BC_ENCODE_NONE = 0,
+        BC_ENCODE_1,
+        BC_ENCODE_3,
+        BC_ENCODE_4,
+        BC_ENCODE_5,
+    };
+
+    BC_ENCODE_KIND GetEncodeKind(DXGI_FORMAT fmt)
+    {
+        switch (fmt)
+        {
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            return BC_ENCODE_1;
+
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            return BC_ENCODE_3;
+
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+            return BC_ENCODE_4;
+
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+            return BC_ENCODE_5;
+
+        default:
+            return BC_ENCODE_NONE;
+        }
+    }
+
+    size_t BlockBytes(BC_ENCODE_KIND kind)
+    {
+        return (kind == BC_ENCODE_1 || kind == BC_ENCODE_4) ? 8 : 16;
+    }
+
+    inline void Store16(uint8_t* p, uint32_t v)
+    {
+        p[0] = uint8_t(v);
+        p[1] = uint8_t(v >> 8);
+    }
+
+    inline float Clamp255(float v)
+    {
+        return v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v);
+    }
+
+    //----------------------------------------------------------------------------------
+    // Color blocks of BC1 and BC3
+    //----------------------------------------------------------------------------------
+    struct ColorBlock
+    {
+        float r[16];
+        float g[16];
+        float b[16];
+
+        // BC1 texels with alpha below 128, written as index 3 of a three color block
+        bool transparent[16];
+        size_t transparentCount;
+    };
+
+    inline int Expand5(int v) { return (v << 3) | (v >> 2); }
+    inline int Expand6(int v) { return (v << 2) | (v >> 4); }
+
+    inline uint32_t Pack565(int r, int g, int b)
+    {
+        return uint32_t((r << 11) | (g << 5) | b);
+    }
+
+    inline uint32_t Quantize565(const float c[3])
+    {
+        int r = static_cast<int>(Clamp255(c[0]) * (31.0f / 255.0f) + 0.5f);
+        int g = static_cast<int>(Clamp255(c[1]) * (63.0f / 255.0f) + 0.5f);
+        int b = static_cast<int>(Clamp255(c[2]) * (31.0f / 255.0f) + 0.5f);
+        return Pack565(r, g, b);
+    }
+
+    // The palette exactly as DecodeColorBlock builds it
+    void BuildColorPalette(uint32_t c0, uint32_t c1, bool threeColor, float palette[4][3])
+    {
+        int p0[3] = { Expand5((c0 >> 11) & 31), Expand6((c0 >> 5) & 63), Expand5(c0 & 31) };
+        int p1[3] = { Expand5((c1 >> 11) & 31), Expand6((c1 >> 5) & 63), Expand5(c1 & 31) };
+
+        for (size_t ch = 0; ch < 3; ++ch)
+        {
+            palette[0][ch] = float(p0[ch]);
+            palette[1][ch] = float(p1[ch]);
+            if (threeColor)
+            {
+                palette[2][ch] = float((p0[ch] + p1[ch] + 1) / 2);
+                palette[3][ch] = 0.0f;
+            }
+            else
+            {
+                palette[2][ch] = float((2 * p0[ch] + p1[ch] + 1) / 3);
+                palette[3][ch] = float((p0[ch] + 2 * p1[ch] + 1) / 3);
+            }
+        }
+    }
+
+    // Nearest of the first entries palette colors for every texel, returns the squared
+    // error. Transparent texels get index 3 and add nothing.
+    float SelectColorIndices(const ColorBlock& block, const float palette[4][3], int entries, uint8_t index[16])
+    {
+        float error = 0.0f;
+
+#if defined(BC_ENCODE_SSE)
+        for (size_t i = 0; i < 16; i += 4)
+        {
+            __m128 r = _mm_loadu_ps(block.r + i);
+            __m128 g = _mm_loadu_ps(block.g + i);
+            __m128 b = _mm_loadu_ps(block.b + i);
+
+            __m128 best = _mm_set1_ps(FLT_MAX);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int k = 0; k < entries; ++k)
+            {
+                __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+                __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+                __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+
+                __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+                best = _mm_min_ps(d, best);
+                bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, bestIndex));
+            }
+
+            float distance[4];
+            int32_t nearest[4];
+            _mm_storeu_ps(distance, best);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(nearest), bestIndex);
+
+            for (size_t j = 0; j < 4; ++j)
+            {
+                if (block.transparent[i + j])
+                {
+                    index[i + j] = 3;
+                }
+                else
+                {
+                    index[i + j] = uint8_t(nearest[j]);
+                    error += distance[j];
+                }
+            }
+        }
+#else
+        for (size_t i = 0; i < 16; ++i)
+        {
+            if (block.transparent[i])
+            {
+                index[i] = 3;
+                continue;
+            }
+
+            float best = FLT_MAX;
+            for (int k = 0; k < entries; ++k)
+            {
+                float dr = block.r[i] - palette[k][0];
+                float dg = block.g[i] - palette[k][1];
+                float db = block.b[i] - palette[k][2];
+                float d = dr * dr + dg * dg + db * db;
+                if (d < best)
+                {
+                    best = d;
+                    index[i] = uint8_t(k);
+                }
+            }
+            error += best;
+        }
+#endif
+
+        return error;
+    }
+
+    struct ColorEncoding
+    {
+        uint32_t c0;
+        uint32_t c1;
+        uint8_t index[16];
+        float error;
+    };
+
+    // Quantizes the endpoints and picks indices. BC1 tells the modes apart by the order
+    // of the endpoints: four colors need c0 > c1, three colors c0 <= c1.
+    void EncodeColorEndpoints(const ColorBlock& block, const float e0[3], const float e1[3],
+        bool isBC1, bool threeColor, ColorEncoding& result)
+    {
+        uint32_t c0 = Quantize565(e0);
+        uint32_t c1 = Quantize565(e1);
+        int entries = threeColor ? 3 : 4;
+
+        if (isBC1)
+        {
+            if (threeColor ? (c0 > c1) : (c0 < c1))
+                std::swap(c0, c1);
+
+            // Equal endpoints always read as three colors, all of them c0
+            if (c0 == c1)
+                entries = 1;
+        }
+
+        float palette[4][3];
+        BuildColorPalette(c0, c1, threeColor && isBC1, palette);
+
+        result.c0 = c0;
+        result.c1 = c1;
+        result.error = SelectColorIndices(block, palette, entries, result.index);
+    }
+
+    // Endpoints with the least squared error for fixed indices
+    bool RefitColorEndpoints(const ColorBlock& block, const uint8_t index[16], bool threeColor, float e0[3], float e1[3])
+    {
+        static const float weights4[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        static const float weights3[4] = { 1.0f, 0.0f, 0.5f, 0.0f };
+        const float* weights = threeColor ? weights3 : weights4;
+
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[3] = {}, bx[3] = {};
+        for (size_t i = 0; i < 16; ++i)
+        {
+            if (block.transparent[i])
+                continue;
+
+            float a = weights[index[i]];
+            float b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+
+            float x[3] = { block.r[i], block.g[i], block.b[i] };
+            for (size_t ch = 0; ch < 3; ++ch)
+            {
+                ax[ch] += a * x[ch];
+                bx[ch] += b * x[ch];
+            }
+        }
+
+        float det = aa * bb - ab * ab;
+        if (fabsf(det) < 1e-4f)
+            return false;
+
+        for (size_t ch = 0; ch < 3; ++ch)
+        {
+            e0[ch] = Clamp255((ax[ch] * bb - bx[ch] * ab) / det);
+            e1[ch] = Clamp255((bx[ch] * aa - ax[ch] * ab) / det);
+        }
+        return true;
+    }
+
+    // Corners of the bounding box, inset by a sixteenth of its size since the extremes
+    // are rarely hit exactly, along the diagonal the texels follow
+    void BoundingBoxEndpoints(const ColorBlock& block, float e0[3], float e1[3])
+    {
+        const float* channels[3] = { block.r, block.g, block.b };
+        float low[3], high[3], mean[3];
+        for (size_t ch = 0; ch < 3; ++ch)
+        {
+            const float* c = channels[ch];
+            float lo = c[0], hi = c[0], sum = 0.0f;
+            for (size_t i = 0; i < 16; ++i)
+            {
+                lo = std::min(lo, c[i]);
+                hi = std::max(hi, c[i]);
+                sum += c[i];
+            }
+            low[ch] = lo;
+            high[ch] = hi;
+            mean[ch] = sum / 16.0f;
+        }
+
+        size_t major = 0;
+        for (size_t ch = 1; ch < 3; ++ch)
+        {
+            if (high[ch] - low[ch] > high[major] - low[major])
+                major = ch;
+        }
+
+        // Channels falling while the widest one rises swap their corners
+        for (size_t ch = 0; ch < 3; ++ch)
+        {
+            float covariance = 0.0f;
+            for (size_t i = 0; i < 16; ++i)
+                covariance += (channels[major][i] - mean[major]) * (channels[ch][i] - mean[ch]);
+
+            float inset = (high[ch] - low[ch]) / 16.0f;
+            e0[ch] = high[ch] - inset;
+            e1[ch] = low[ch] + inset;
+            if (covariance < 0.0f)
+                std::swap(e0[ch], e1[ch]);
+        }
+    }
+
+    // Extremes of the texels projected on the principal axis of their covariance
+    void PrincipalAxisEndpoints(const ColorBlock& block, float e0[3], float e1[3])
+    {
+        const float* channels[3] = { block.r, block.g, block.b };
+        float mean[3];
+        for (size_t ch = 0; ch < 3; ++ch)
+        {
+            float sum = 0.0f;
+            for (size_t i = 0; i < 16; ++i)
+                sum += channels[ch][i];
+            mean[ch] = sum / 16.0f;
+        }
+
+        float cov[3][3];
+        for (size_t j = 0; j < 3; ++j)
+        {
+            for (size_t k = j; k < 3; ++k)
+            {
+                float sum = 0.0f;
+                for (size_t i = 0; i < 16; ++i)
+                    sum += (channels[j][i] - mean[j]) * (channels[k][i] - mean[k]);
+                cov[j][k] = cov[k][j] = sum;
+            }
+        }
+
+        // Power iteration from the covariance row of the widest channel
+        size_t major = 0;
+        for (size_t j = 1; j < 3; ++j)
+        {
+            if (cov[j][j] > cov[major][major])
+                major = j;
+        }
+        float axis[3] = { cov[major][0], cov[major][1], cov[major][2] };
+        if (cov[major][major] <= 0.0f)
+            axis[0] = axis[1] = axis[2] = 1.0f;
+
+        for (int iteration = 0; iteration < 4; ++iteration)
+        {
+            float next[3];
+            for (size_t j = 0; j < 3; ++j)
+                next[j] = cov[j][0] * axis[0] + cov[j][1] * axis[1] + cov[j][2] * axis[2];
+
+            float length = std::max(fabsf(next[0]), std::max(fabsf(next[1]), fabsf(next[2])));
+            if (length < 1e-6f)
+                break;
+
+            for (size_t j = 0; j < 3; ++j)
+                axis[j] = next[j] / length;
+        }
+
+        float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        for (size_t j = 0; j < 3; ++j)
+            axis[j] /= length;
+
+        float tmin = FLT_MAX;
+        float tmax = -FLT_MAX;
+        for (size_t i = 0; i < 16; ++i)
+        {
+            float t = (block.r[i] - mean[0]) * axis[0] + (block.g[i] - mean[1]) * axis[1] + (block.b[i] - mean[2]) * axis[2];
+            tmin = std::min(tmin, t);
+            tmax = std::max(tmax, t);
+        }
+
+        for (size_t ch = 0; ch < 3; ++ch)
+        {
+            e0[ch] = Clamp255(mean[ch] + axis[ch] * tmax);
+            e1[ch] = Clamp255(mean[ch] + axis[ch] * tmin);
+        }
+    }
+
+    // Endpoint pairs whose 2:1 blend hits each 8 bit value most closely
+    struct SingleColorTable
+    {
+        uint8_t e0[256];
+        uint8_t e1[256];
+    };
+
+    SingleColorTable BuildSingleColorTable(int bits)
+    {
+        SingleColorTable table;
+        int levels = 1 << bits;
+        for (int v = 0; v < 256; ++v)
+        {
+            int bestError = INT32_MAX;
+            for (int q0 = 0; q0 < levels; ++q0)
+            {
+                for (int q1 = 0; q1 < levels; ++q1)
+                {
+                    int x0 = (bits == 5) ? Expand5(q0) : Expand6(q0);
+                    int x1 = (bits == 5) ? Expand5(q1) : Expand6(q1);
+                    int error = std::abs((2 * x0 + x1 + 1) / 3 - v) * 256 + std::abs(x0 - x1);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        table.e0[v] = uint8_t(q0);
+                        table.e1[v] = uint8_t(q1);
+                    }
+                }
+            }
+        }
+        return table;
+    }
+
+    void EncodeSingleColor(uint8_t r, uint8_t g, uint8_t b, bool isBC1, ColorEncoding& result)
+    {
+        static const SingleColorTable table5 = BuildSingleColorTable(5);
+        static const SingleColorTable table6 = BuildSingleColorTable(6);
+
+        uint32_t c0 = Pack565(table5.e0[r], table6.e0[g], table5.e0[b]);
+        uint32_t c1 = Pack565(table5.e1[r], table6.e1[g], table5.e1[b]);
+        uint8_t index = 2;
+
+        if (isBC1)
+        {
+            if (c0 < c1)
+            {
+                std::swap(c0, c1);
+                index = 3;
+            }
+            else if (c0 == c1)
+            {
+                index = 0;
+            }
+        }
+
+        result.c0 = c0;
+        result.c1 = c1;
+        memset(result.index, index, sizeof(result.index));
+        result.error = 0.0f;
+    }
+
+    void EncodeColorBlock(const uint8_t rgba[64], bool isBC1, BC_COMPRESS_QUALITY quality, uint8_t* out)
+    {
+        ColorBlock block;
+        block.transparentCount = 0;
+        size_t opaque = 16;
+        for (size_t i = 0; i < 16; ++i)
+        {
+            block.transparent[i] = isBC1 && rgba[i * 4 + 3] < 128;
+            if (block.transparent[i])
+                ++block.transparentCount;
+            else if (opaque == 16)
+                opaque = i;
+        }
+
+        // Transparent texels take the color of an opaque one, which keeps them out of the
+        // bounding box and the principal axis without a test per texel
+        const uint8_t* fill = rgba + (opaque < 16 ? opaque : 0) * 4;
+        bool single = true;
+        for (size_t i = 0; i < 16; ++i)
+        {
+            const uint8_t* t = block.transparent[i] ? fill : rgba + i * 4;
+            block.r[i] = t[0];
+            block.g[i] = t[1];
+            block.b[i] = t[2];
+            if (t[0] != fill[0] || t[1] != fill[1] || t[2] != fill[2])
+                single = false;
+        }
+
+        ColorEncoding best;
+        if (block.transparentCount == 16)
+        {
+            best.c0 = 0;
+            best.c1 = 0;
+            memset(best.index, 3, sizeof(best.index));
+        }
+        else if (single && !block.transparentCount)
+        {
+            EncodeSingleColor(rgba[0], rgba[1], rgba[2], isBC1, best);
+        }
+        else
+        {
+            const bool threeColor = block.transparentCount > 0;
+
+            float e0[3], e1[3];
+            if (quality == BC_COMPRESS_FAST)
+                BoundingBoxEndpoints(block, e0, e1);
+            else
+                PrincipalAxisEndpoints(block, e0, e1);
+
+            EncodeColorEndpoints(block, e0, e1, isBC1, threeColor, best);
+
+            int refinements = (quality == BC_COMPRESS_FAST) ? 0 : (quality == BC_COMPRESS_NORMAL) ? 1 : 4;
+            for (int i = 0; i < refinements && best.error > 0.0f; ++i)
+            {
+                if (!RefitColorEndpoints(block, best.index, threeColor && isBC1, e0, e1))
+                    break;
+
+                ColorEncoding refined;
+                EncodeColorEndpoints(block, e0, e1, isBC1, threeColor, refined);
+                if (refined.error >= best.error)
+                    break;
+                best = refined;
+            }
+
+            // Opaque BC1 blocks can still use three colors, a midpoint sometimes fits better
+            if (quality == BC_COMPRESS_HIGH && isBC1 && !threeColor && best.error > 0.0f)
+            {
+                PrincipalAxisEndpoints(block, e0, e1);
+
+                ColorEncoding midpoint;
+                EncodeColorEndpoints(block, e0, e1, true, true, midpoint);
+                for (int i = 0; i < refinements; ++i)
+                {
+                    if (!RefitColorEndpoints(block, midpoint.index, true, e0, e1))
+                        break;
+
+                    ColorEncoding refined;
+                    EncodeColorEndpoints(block, e0, e1, true, true, refined);
+                    if (refined.error >= midpoint.error)
+                        break;
+                    midpoint = refined;
+                }
+
+                if (midpoint.error < best.error)
+                    best = midpoint;
+            }
+        }
+
+        uint32_t bits = 0;
+        for (size_t i = 0; i < 16; ++i)
+            bits |= uint32_t(best.index[i]) << (2 * i);
+
+        Store16(out, best.c0);
+        Store16(out + 2, best.c1);
+        Store16(out + 4, bits);
+        Store16(out + 6, bits >> 16);
+    }
+
+    //----------------------------------------------------------------------------------
+    // Channel blocks of BC4, BC5 and the BC3 alpha
+    //----------------------------------------------------------------------------------
+
+    // The palette exactly as DecodeChannelBlock builds it
+    void BuildChannelPalette(int a0, int a1, int palette[8])
+    {
+        palette[0] = a0;
+        palette[1] = a1;
+        if (a0 > a1)
+        {
+            for (int i = 1; i < 7; ++i)
+                palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+        }
+        else
+        {
+            for (int i = 1; i < 5; ++i)
+                palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    // Nearest palette entry of every texel, returns the squared error
+    int SelectChannelIndices(const uint8_t values[16], const int palette[8], uint8_t index[16])
+    {
+#if defined(BC_ENCODE_SSE)
+        // All 16 texels at once as two rows of eight 16 bit distances
+        const __m128i zero = _mm_setzero_si128();
+        __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+        __m128i lo = _mm_unpacklo_epi8(texels, zero);
+        __m128i hi = _mm_unpackhi_epi8(texels, zero);
+
+        __m128i bestLo = _mm_set1_epi16(0x7fff);
+        __m128i bestHi = bestLo;
+        __m128i indexLo = zero;
+        __m128i indexHi = zero;
+        for (int k = 0; k < 8; ++k)
+        {
+            __m128i p = _mm_set1_epi16(static_cast<short>(palette[k]));
+            __m128i k16 = _mm_set1_epi16(static_cast<short>(k));
+
+            __m128i d = _mm_sub_epi16(lo, p);
+            d = _mm_max_epi16(d, _mm_sub_epi16(zero, d));
+            __m128i closer = _mm_cmplt_epi16(d, bestLo);
+            bestLo = _mm_min_epi16(d, bestLo);
+            indexLo = _mm_or_si128(_mm_and_si128(closer, k16), _mm_andnot_si128(closer, indexLo));
+
+            d = _mm_sub_epi16(hi, p);
+            d = _mm_max_epi16(d, _mm_sub_epi16(zero, d));
+            closer = _mm_cmplt_epi16(d, bestHi);
+            bestHi = _mm_min_epi16(d, bestHi);
+            indexHi = _mm_or_si128(_mm_and_si128(closer, k16), _mm_andnot_si128(closer, indexHi));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(index), _mm_packus_epi16(indexLo, indexHi));
+
+        __m128i squares = _mm_add_epi32(_mm_madd_epi16(bestLo, bestLo), _mm_madd_epi16(bestHi, bestHi));
+        squares = _mm_add_epi32(squares, _mm_shuffle_epi32(squares, _MM_SHUFFLE(1, 0, 3, 2)));
+        squares = _mm_add_epi32(squares, _mm_shuffle_epi32(squares, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(squares);
+#else
+        int error = 0;
+        for (size_t i = 0; i < 16; ++i)
+        {
+            int best = INT32_MAX;
+            for (int k = 0; k < 8; ++k)
+            {
+                int d = values[i] - palette[k];
+                if (d * d < best)
+                {
+                    best = d * d;
+                    index[i] = uint8_t(k);
+                }
+            }
+            error += best;
+        }
+        return error;
+#endif
+    }
+
+    struct ChannelEncoding
+    {
+        int a0;
+        int a1;
+        uint8_t index[16];
+        int error;
+    };
+
+    void EncodeChannelEndpoints(const uint8_t values[16], int a0, int a1, ChannelEncoding& result)
+    {
+        int palette[8];
+        BuildChannelPalette(a0, a1, palette);
+        result.a0 = a0;
+        result.a1 = a1;
+        result.error = SelectChannelIndices(values, palette, result.index);
+    }
+
+    // Least squares endpoints of an eight value block for fixed indices
+    bool RefitChannelEndpoints(const uint8_t values[16], const uint8_t index[16], int& a0, int& a1)
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax = 0.0f, bx = 0.0f;
+        for (size_t i = 0; i < 16; ++i)
+        {
+            float a = (index[i] == 0) ? 1.0f : (index[i] == 1) ? 0.0f : (8 - index[i]) / 7.0f;
+            float b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ax += a * values[i];
+            bx += b * values[i];
+        }
+
+        float det = aa * bb - ab * ab;
+        if (fabsf(det) < 1e-4f)
+            return false;
+
+        a0 = static_cast<int>(Clamp255((ax * bb - bx * ab) / det) + 0.5f);
+        a1 = static_cast<int>(Clamp255((bx * aa - ax * ab) / det) + 0.5f);
+        if (a0 < a1)
+            std::swap(a0, a1);
+        return a0 != a1;
+    }
+
+    void EncodeChannelBlock(const uint8_t values[16], BC_COMPRESS_QUALITY quality, uint8_t* out)
+    {
+        int low = 255;
+        int high = 0;
+        int innerLow = 255;
+        int innerHigh = 0;
+        bool extremes = false;
+        for (size_t i = 0; i < 16; ++i)
+        {
+            low = std::min<int>(low, values[i]);
+            high = std::max<int>(high, values[i]);
+            if (values[i] == 0 || values[i] == 255)
+            {
+                extremes = true;
+            }
+            else
+            {
+                innerLow = std::min<int>(innerLow, values[i]);
+                innerHigh = std::max<int>(innerHigh, values[i]);
+            }
+        }
+
+        ChannelEncoding best;
+        if (low == high)
+        {
+            best.a0 = best.a1 = low;
+            memset(best.index, 0, sizeof(best.index));
+        }
+        else
+        {
+            // Eight values spanning the block
+            EncodeChannelEndpoints(values, high, low, best);
+
+            if (quality != BC_COMPRESS_FAST)
+            {
+                int refinements = (quality == BC_COMPRESS_NORMAL) ? 1 : 4;
+                for (int i = 0; i < refinements && best.error > 0; ++i)
+                {
+                    int a0, a1;
+                    if (!RefitChannelEndpoints(values, best.index, a0, a1))
+                        break;
+
+                    ChannelEncoding refined;
+                    EncodeChannelEndpoints(values, a0, a1, refined);
+                    if (refined.error >= best.error)
+                        break;
+                    best = refined;
+                }
+
+                // Six values between the inner texels plus exact 0 and 255
+                if (extremes && best.error > 0)
+                {
+                    if (innerLow > innerHigh)
+                        innerLow = innerHigh = 0;
+
+                    ChannelEncoding six;
+                    EncodeChannelEndpoints(values, innerLow, innerHigh, six);
+                    if (six.error < best.error)
+                        best = six;
+                }
+            }
+        }
+
+        uint64_t bits = 0;
+        for (size_t i = 0; i < 16; ++i)
+            bits |= uint64_t(best.index[i]) << (3 * i);
+
+        out[0] = uint8_t(best.a0);
+        out[1] = uint8_t(best.a1);
+        for (size_t i = 0; i < 6; ++i)
+            out[2 + i] = uint8_t(bits >> (8 * i));
+    }
+
+    //----------------------------------------------------------------------------------
+    // 16 RGBA8 texels of one block in raster order, edges repeat the last row and column
+    void LoadBlock(const uint8_t* src, size_t srcRowPitch, size_t width, size_t height,
+        size_t bx, size_t by, uint8_t rgba[64])
+    {
+        if (bx * 4 + 4 <= width && by * 4 + 4 <= height)
+        {
+            const uint8_t* in = src + by * 4 * srcRowPitch + bx * 16;
+            for (size_t y = 0; y < 4; ++y)
+                memcpy(rgba + y * 16, in + y * srcRowPitch, 16);
+            return;
+        }
+
+        for (size_t y = 0; y < 4; ++y)
+        {
+            size_t sy = std::min(by * 4 + y, height - 1);
+            for (size_t x = 0; x < 4; ++x)
+            {
+                size_t sx = std::min(bx * 4 + x, width - 1);
+                memcpy(rgba + (y * 4 + x) * 4, src + sy * srcRowPitch + sx * 4, 4);
+            }
+        }
+    }
+
+    void EncodeBlock(BC_ENCODE_KIND kind, const uint8_t rgba[64], BC_COMPRESS_QUALITY quality, uint8_t* block)
+    {
+        uint8_t channel[16];
+
+        switch (kind)
+        {
+        case BC_ENCODE_1:
+            EncodeColorBlock(rgba, true, quality, block);
+            break;
+
+        case BC_ENCODE_3:
+            for (size_t i = 0; i < 16; ++i)
+                channel[i] = rgba[i * 4 + 3];
+            EncodeChannelBlock(channel, quality, block);
+            EncodeColorBlock(rgba, false, quality, block + 8);
+            break;
+
+        case BC_ENCODE_4:
+        case BC_ENCODE_5:
+            for (size_t i = 0; i < 16; ++i)
+                channel[i] = rgba[i * 4];
+            EncodeChannelBlock(channel, quality, block);
+            if (kind == BC_ENCODE_5)
+            {
+                for (size_t i = 0; i < 16; ++i)
+                    channel[i] = rgba[i * 4 + 1];
+                EncodeChannelBlock(channel, quality, block + 8);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+bool DirectX::CanCompressBC(DXGI_FORMAT fmt)
+{
+    return GetEncodeKind(fmt) != BC_ENCODE_NONE;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::CompressBC(
+    DXGI_FORMAT fmt,
+    size_t width,
+    size_t height,
+    const uint8_t* src,
+    size_t srcRowPitch,
+    uint8_t* dst,
+    size_t dstRowPitch,
+    BC_COMPRESS_QUALITY quality,
+    bool threaded)
+{
+    if (!src || !dst)
+    {
+        return E_POINTER;
+    }
+
+    BC_ENCODE_KIND kind = GetEncodeKind(fmt);
+    if (kind == BC_ENCODE_NONE)
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    const size_t blockBytes = BlockBytes(kind);
+    const size_t blocksWide = (width + 3) / 4;
+    const size_t blocksHigh = (height + 3) / 4;
+
+    if (!width || !height
+        || srcRowPitch < width * 4
+        || dstRowPitch < blocksWide * blockBytes
+        || blocksHigh > UINT32_MAX)
+    {
+        return E_INVALIDARG;
+    }
+
+    auto encodeRows = [&](UINT begin, UINT end, UINT)
+    {
+        uint8_t rgba[64];
+        for (size_t by = begin; by < end; ++by)
+        {
+            uint8_t* block = dst + by * dstRowPitch;
+            for (size_t bx = 0; bx < blocksWide; ++bx, block += blockBytes)
+            {
+                LoadBlock(src, srcRowPitch, width, height, bx, by, rgba);
+                EncodeBlock(kind, rgba, quality, block);
+            }
+        }
+    };
+
+    if (threaded && blocksHigh > 1)
+    {
+        // Encoding costs a lot more per block than decoding, smaller chunks balance better
+        UINT grain = static_cast<UINT>(std::max<size_t>(1, 1024 / blocksWide));
+        JobSystem::Default().ParallelFor(static_cast<UINT>(blocksHigh), grain, encodeRows);
+    }
+    else
+    {
+        encodeRows(0, static_cast<UINT>(blocksHigh), 0);
+    }
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+double DirectX::BenchmarkCompressBC(
+    DXGI_FORMAT fmt,
+    size_t width,
+    size_t height,
+    unsigned iterations,
+    BC_COMPRESS_QUALITY quality,
+    bool threaded,
+    double* psnr)
+{
+    BC_ENCODE_KIND kind = GetEncodeKind(fmt);
+    if (kind == BC_ENCODE_NONE || !width || !height || !iterations)
+        return 0.0;
+
+    // Smooth gradients with some texture on top, closer to real content than noise
+    std::vector<uint8_t> src(width * height * 4);
+    uint32_t seed = 12345;
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            float noise = float((seed >> 24) & 15) - 7.5f;
+            float u = float(x) / float(width);
+            float v = float(y) / float(height);
+
+            uint8_t* t = &src[(y * width + x) * 4];
+            t[0] = static_cast<uint8_t>(Clamp255(255.0f * u + noise));
+            t[1] = static_cast<uint8_t>(Clamp255(128.0f + 120.0f * sinf(u * 20.0f + v * 7.0f) + noise));
+            t[2] = static_cast<uint8_t>(Clamp255(255.0f * v * (1.0f - u) + noise));
+            t[3] = (kind == BC_ENCODE_1) ? 255 : static_cast<uint8_t>(Clamp255(128.0f + 127.0f * cosf(v * 13.0f)));
+        }
+    }
+
+    size_t rowPitch = (width + 3) / 4 * BlockBytes(kind);
+    std::vector<uint8_t> dst(rowPitch * ((height + 3) / 4));
+
+    // Warm up the workers and the pages
+    CompressBC(fmt, width, height, &src[0], width * 4, &dst[0], rowPitch, quality, threaded);
+
+    if (psnr)
+    {
+        std::vector<uint8_t> decoded(width * height * 4);
+        DecompressBC(fmt, width, height, &dst[0], rowPitch, &decoded[0], width * 4, threaded);
+
+        // Over the channels the format stores
+        size_t channels = (kind == BC_ENCODE_1) ? 3 : (kind == BC_ENCODE_3) ? 4 : (kind == BC_ENCODE_4) ? 1 : 2;
+        double sum = 0.0;
+        for (size_t i = 0; i < width * height; ++i)
+        {
+            for (size_t ch = 0; ch < channels; ++ch)
+            {
+                double d = double(src[i * 4 + ch]) - double(decoded[i * 4 + ch]);
+                sum += d * d;
+            }
+        }
+
+        double mse = sum / double(width * height * channels);
+        *psnr = (mse > 0.0) ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+        CompressBC(fmt, width, height, &src[0], width * 4, &dst[0], rowPitch, quality, threaded);
+    std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+
+    return double(width) * double(height) * iterations / seconds.count() / 1e6;
+}
+
+
+//--------------------------------------------------------------------------------------
+const char* DirectX::GetBCEncoderInstructionSet()
+{
+#if defined(BC_ENCODE_SSE)
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
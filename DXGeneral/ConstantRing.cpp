@@ -0,0 +1,269 @@
+#include "ConstantRing.h"
+
+namespace
+{
+	//Offset binds address whole groups of 16 constants of 16 bytes
+	const UINT CONSTANT_BYTES = 16;
+	const UINT BLOCK_ALIGNMENT = 16 * CONSTANT_BYTES;
+
+	//Alignment of the system memory blocks, for XMMATRIX stores
+	const UINT SHADOW_ALIGNMENT = 16;
+
+	const UINT NO_BLOCK = 0xffffffff;
+
+	HRESULT CreateDynamicConstantBuffer(ID3D11Device* device, UINT size, ID3D11Buffer** buffer)
+	{
+		D3D11_BUFFER_DESC desc;
+		desc.ByteWidth = size;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = 0;
+		desc.StructureByteStride = 0;
+
+		return device->CreateBuffer(&desc, 0, buffer);
+	}
+}
+
+RingAllocator::RingAllocator()
+	:m_capacity(0), m_alignment(1), m_head(0), m_wrapCount(0)
+{
+}
+
+void RingAllocator::Reset(UINT capacity, UINT alignment)
+{
+	m_alignment = alignment ? alignment : 1;
+	m_capacity = capacity & ~(m_alignment - 1);
+	m_head = m_capacity;
+	m_wrapCount = 0;
+}
+
+bool RingAllocator::Allocate(UINT count, UINT blockSize, UINT& offset, UINT& stride, bool& discard)
+{
+	if (!count || !blockSize || blockSize > m_capacity)
+		return false;
+
+	stride = (blockSize + m_alignment - 1) & ~(m_alignment - 1);
+
+	const UINT64 bytes = static_cast<UINT64>(stride)*count;
+	if (bytes > m_capacity)
+		return false;
+
+	discard = m_head + bytes > m_capacity;
+	if (discard)
+	{
+		m_head = 0;
+		++m_wrapCount;
+	}
+
+	offset = m_head;
+	m_head += static_cast<UINT>(bytes);
+	return true;
+}
+
+ConstantRing::ConstantRing()
+	:m_device(0), m_context(0), m_context1(0),
+	m_buffer(0), m_mapped(false),
+	m_blockBuffer(0), m_blockBufferSize(0), m_blockBufferIndex(NO_BLOCK),
+	m_offset(0), m_stride(0), m_count(0), m_blockSize(0),
+	m_mapCount(0)
+{
+}
+
+ConstantRing::~ConstantRing()
+{
+	Release();
+}
+
+bool ConstantRing::Init(ID3D11Device* device, ID3D11DeviceContext* context, UINT capacity)
+{
+	Release();
+
+	m_device = device;
+	m_context = context;
+	m_allocator.Reset(capacity, BLOCK_ALIGNMENT);
+	if (!m_allocator.Capacity())
+		return false;
+
+	//Offset binds and NO_OVERWRITE maps of constant buffers both need the
+	//11.1 runtime and a driver that reports them
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+	ZeroMemory(&options, sizeof(options));
+	if (SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options)))
+		&& options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer)
+	{
+		if (FAILED(context->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&m_context1))))
+			m_context1 = 0;
+	}
+
+	if (m_context1)
+	{
+		if (FAILED(CreateDynamicConstantBuffer(device, m_allocator.Capacity(), &m_buffer)))
+		{
+			Release();
+			return false;
+		}
+	}
+	else
+	{
+		//vector storage is only 8 byte aligned on x86
+		m_shadowStorage.resize(m_allocator.Capacity() + SHADOW_ALIGNMENT - 1);
+		UINT_PTR base = reinterpret_cast<UINT_PTR>(m_shadowStorage.data());
+		m_shadow = m_shadowStorage.data() + ((SHADOW_ALIGNMENT - base % SHADOW_ALIGNMENT) % SHADOW_ALIGNMENT);
+	}
+
+	return true;
+}
+
+void ConstantRing::Release()
+{
+	End();
+
+	ReleaseCOM(m_buffer);
+	ReleaseCOM(m_blockBuffer);
+	ReleaseCOM(m_context1);
+
+	m_device = 0;
+	m_context = 0;
+	m_shadowStorage.clear();
+	m_shadow = 0;
+	m_data = 0;
+	m_blockBufferSize = 0;
+	m_blockBufferIndex = NO_BLOCK;
+	m_count = 0;
+	m_mapCount = 0;
+}
+
+bool ConstantRing::Begin(UINT count, UINT blockSize)
+{
+	End();
+	m_count = 0;
+	m_data = 0;
+
+	UINT offset = 0;
+	UINT stride = 0;
+	bool discard = false;
+	if (!m_context || !m_allocator.Allocate(count, blockSize, offset, stride, discard))
+		return false;
+
+	BYTE* data = 0;
+	if (m_context1)
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(m_context->Map(m_buffer, 0, discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped)))
+			return false;
+
+		++m_mapCount;
+		m_mapped = true;
+		data = static_cast<BYTE*>(mapped.pData) + offset;
+	}
+	else
+	{
+		if (!EnsureBlockBuffer(stride))
+			return false;
+
+		m_blockBufferIndex = NO_BLOCK;
+		data = m_shadow + offset;
+	}
+
+	m_offset = offset;
+	m_stride = stride;
+	m_count = count;
+	m_blockSize = blockSize;
+	m_data = data;
+	return true;
+}
+
+void ConstantRing::End()
+{
+	if (m_mapped)
+	{
+		m_context->Unmap(m_buffer, 0);
+		m_mapped = false;
+	}
+}
+
+void ConstantRing::BindVS(UINT slot, UINT index)
+{
+	UINT firstConstant = 0;
+	UINT numConstants = 0;
+	ID3D11Buffer* buffer = PrepareBind(index, firstConstant, numConstants);
+	if (!buffer)
+		return;
+
+	if (m_context1)
+		m_context1->VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &numConstants);
+	else
+		m_context->VSSetConstantBuffers(slot, 1, &buffer);
+}
+
+void ConstantRing::BindPS(UINT slot, UINT index)
+{
+	UINT firstConstant = 0;
+	UINT numConstants = 0;
+	ID3D11Buffer* buffer = PrepareBind(index, firstConstant, numConstants);
+	if (!buffer)
+		return;
+
+	if (m_context1)
+		m_context1->PSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &numConstants);
+	else
+		m_context->PSSetConstantBuffers(slot, 1, &buffer);
+}
+
+bool ConstantRing::BindTo(ID3D11DeviceContext1* context, UINT slot, UINT index) const
+{
+	if (!m_context1 || index >= m_count || m_mapped)
+		return false;
+
+	UINT firstConstant = (m_offset + index*m_stride) / CONSTANT_BYTES;
+	UINT numConstants = m_stride / CONSTANT_BYTES;
+	ID3D11Buffer* buffer = m_buffer;
+
+	context->VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &numConstants);
+	context->PSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &numConstants);
+	return true;
+}
+
+ID3D11Buffer* ConstantRing::PrepareBind(UINT index, UINT& firstConstant, UINT& numConstants)
+{
+	if (index >= m_count || m_mapped)
+		return 0;
+
+	if (m_context1)
+	{
+		firstConstant = (m_offset + index*m_stride) / CONSTANT_BYTES;
+		numConstants = m_stride / CONSTANT_BYTES;
+		return m_buffer;
+	}
+
+	//Binding the same block to another stage needs no second copy
+	if (index != m_blockBufferIndex)
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(m_context->Map(m_blockBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+			return 0;
+
+		memcpy(mapped.pData, m_shadow + m_offset + index*m_stride, m_blockSize);
+		m_context->Unmap(m_blockBuffer, 0);
+
+		++m_mapCount;
+		m_blockBufferIndex = index;
+	}
+
+	return m_blockBuffer;
+}
+
+bool ConstantRing::EnsureBlockBuffer(UINT size)
+{
+	if (m_blockBuffer && m_blockBufferSize >= size)
+		return true;
+
+	ReleaseCOM(m_blockBuffer);
+	m_blockBufferSize = 0;
+	if (FAILED(CreateDynamicConstantBuffer(m_device, size, &m_blockBuffer)))
+		return false;
+
+	m_blockBufferSize = size;
+	return true;
+}
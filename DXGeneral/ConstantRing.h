@@ -0,0 +1,138 @@
+#pragma once
+
+//Per object constants sub-allocated from one large dynamic buffer
+//
+//Updating a small constant buffer per draw costs a Map(WRITE_DISCARD) per
+//object. ConstantRing keeps the blocks of all objects of a frame in one big
+//buffer instead: Begin() maps it once, the caller fills one block per
+//object, End() unmaps, and BindVS()/BindPS() point a shader slot at a
+//block with the Direct3D 11.1 offset binds. Each Begin() appends behind the
+//blocks of earlier frames with WRITE_NO_OVERWRITE, as the GPU may still be
+//reading those. When the end of the buffer is reached it maps with
+//WRITE_DISCARD, the driver hands out fresh memory and allocation starts
+//over at 0. Map calls follow frames, not objects.
+//
+//Blocks are 256 byte aligned, the granularity of offset binds. Devices
+//without constant buffer offsetting or NO_OVERWRITE maps on constant
+//buffers (the 11.0 runtime) get the blocks from system memory, copied into
+//a one block buffer whenever a different block is bound. They keep the old
+//Map per object, and only one block can be bound at a time.
+//
+//RingAllocator is the offset arithmetic alone and needs no device.
+
+#ifndef _CONSTANTRING_H_
+#define _CONSTANTRING_H_
+
+#include "d3dUtil.h"
+#include <d3d11_1.h>
+
+class RingAllocator
+{
+public:
+	RingAllocator();
+
+	//alignment must be a power of two. The first allocation after Reset
+	//always wraps, so the buffer is mapped with WRITE_DISCARD before any
+	//WRITE_NO_OVERWRITE.
+	void Reset(UINT capacity, UINT alignment);
+
+	//Reserves count blocks of blockSize bytes in one contiguous range and
+	//returns its offset. Blocks are stride bytes apart, blockSize rounded up
+	//to the alignment. discard is set when the range wrapped to the start,
+	//so everything before it may be overwritten. False when the range is
+	//larger than the whole buffer.
+	bool Allocate(UINT count, UINT blockSize, UINT& offset, UINT& stride, bool& discard);
+
+	UINT Capacity() const { return m_capacity; }
+	UINT Alignment() const { return m_alignment; }
+
+	//Where the next allocation starts when it fits
+	UINT Head() const { return m_head; }
+
+	//Allocations that wrapped
+	UINT WrapCount() const { return m_wrapCount; }
+
+private:
+	UINT m_capacity;
+	UINT m_alignment;
+	UINT m_head;
+	UINT m_wrapCount;
+};
+
+class ConstantRing
+{
+public:
+	ConstantRing();
+	~ConstantRing();
+
+	//capacity in bytes, room for a few frames of blocks so the ring does not
+	//wrap every frame. The ring records into context only; device and
+	//context must outlive it.
+	bool Init(ID3D11Device* device, ID3D11DeviceContext* context, UINT capacity);
+	void Release();
+
+	//Maps room for count blocks of blockSize bytes. False when the blocks
+	//do not fit the buffer or the map failed.
+	bool Begin(UINT count, UINT blockSize);
+	void End();
+
+	//Block index of the last Begin(), writable until End(). Blocks are 16
+	//byte aligned, so XMMATRIX members can be stored directly.
+	template<typename T>
+	T* Block(UINT index) { return reinterpret_cast<T*>(m_data + index*m_stride); }
+
+	UINT Stride() const { return m_stride; }
+
+	//Binds block index of the last Begin() to a constant buffer slot, after
+	//End()
+	void BindVS(UINT slot, UINT index);
+	void BindPS(UINT slot, UINT index);
+
+	//Binds block index to the slot of both stages of another context, a
+	//deferred one recording on a worker thread. Reads the ring only, so
+	//several threads may bind at once. False on the fallback, whose one
+	//block buffer belongs to the ring's own context.
+	bool BindTo(ID3D11DeviceContext1* context, UINT slot, UINT index) const;
+
+	//False on the system memory fallback
+	bool IsOffsetBinding() const { return m_context1 != 0; }
+
+	//Map calls since Init
+	UINT MapCount() const { return m_mapCount; }
+
+	const RingAllocator& Allocator() const { return m_allocator; }
+
+private:
+	//The range of a block for the offset binds, or the one block buffer
+	//after copying the block into it
+	ID3D11Buffer* PrepareBind(UINT index, UINT& firstConstant, UINT& numConstants);
+
+	bool EnsureBlockBuffer(UINT size);
+
+private:
+	ID3D11Device* m_device;
+	ID3D11DeviceContext* m_context;
+	ID3D11DeviceContext1* m_context1;
+
+	ID3D11Buffer* m_buffer;
+	RingAllocator m_allocator;
+	bool m_mapped;
+
+	//Fallback: blocks in system memory and the buffer bound in their place
+	std::vector<BYTE> m_shadowStorage;
+	BYTE* m_shadow;
+	ID3D11Buffer* m_blockBuffer;
+	UINT m_blockBufferSize;
+	UINT m_blockBufferIndex;
+
+	//The last Begin()
+	BYTE* m_data;
+	UINT m_offset;
+	UINT m_stride;
+	UINT m_count;
+	UINT m_blockSize;
+
+	UINT m_mapCount;
+};
+
+#endif
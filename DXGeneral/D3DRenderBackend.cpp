@@ -0,0 +1,224 @@
+#include "D3DRenderBackend.h"
+#include "ConstantRing.h"
+
+D3DRenderBackend::D3DRenderBackend()
+	:m_context(0), m_bindContext(0), m_ring(0), m_ringSlot(0)
+{
+}
+
+UINT D3DRenderBackend::AddShader(const ShaderState& shader)
+{
+	m_shaders.push_back(shader);
+	return static_cast<UINT>(m_shaders.size() - 1);
+}
+
+UINT D3DRenderBackend::AddMaterial(const MaterialState& material)
+{
+	m_materials.push_back(material);
+	return static_cast<UINT>(m_materials.size() - 1);
+}
+
+UINT D3DRenderBackend::AddMesh(const MeshState& mesh)
+{
+	m_meshes.push_back(mesh);
+	return static_cast<UINT>(m_meshes.size() - 1);
+}
+
+void D3DRenderBackend::SetConstantRing(ConstantRing* ring, UINT slot)
+{
+	m_ring = ring;
+	m_ringSlot = slot;
+}
+
+void D3DRenderBackend::SetShader(UINT shader)
+{
+	const ShaderState& state = m_shaders[shader];
+
+	m_context->IASetInputLayout(state.InputLayout);
+	m_context->VSSetShader(state.VertexShader, NULL, 0);
+	m_context->PSSetShader(state.PixelShader, NULL, 0);
+}
+
+void D3DRenderBackend::SetMaterial(UINT material)
+{
+	if (material >= m_materials.size())
+		return;
+
+	const MaterialState& state = m_materials[material];
+
+	if (state.Texture)
+		m_context->PSSetShaderResources(0, 1, &state.Texture);
+
+	if (state.Sampler)
+		m_context->PSSetSamplers(0, 1, &state.Sampler);
+}
+
+void D3DRenderBackend::SetMesh(UINT mesh)
+{
+	const MeshState& state = m_meshes[mesh];
+
+	UINT offset = 0;
+	m_context->IASetVertexBuffers(0, 1, &state.VertexBuffer, &state.VertexStride, &offset);
+	if (state.InstanceBuffer)
+		m_context->IASetVertexBuffers(1, 1, &state.InstanceBuffer, &state.InstanceStride, &offset);
+
+	m_context->IASetIndexBuffer(state.IndexBuffer, state.IndexFormat, 0);
+	m_context->IASetPrimitiveTopology(state.Topology);
+}
+
+void D3DRenderBackend::SetConstants(UINT block)
+{
+	if (!m_ring)
+		return;
+
+	if (m_bindContext)
+	{
+		m_ring->BindTo(m_bindContext, m_ringSlot, block);
+		return;
+	}
+
+	m_ring->BindVS(m_ringSlot, block);
+	m_ring->BindPS(m_ringSlot, block);
+}
+
+void D3DRenderBackend::Draw(const DrawPacket& packet)
+{
+	if (packet.InstanceCount > 1 || packet.StartInstance)
+	{
+		m_context->DrawIndexedInstanced(packet.IndexCount, packet.InstanceCount,
+			packet.StartIndex, packet.BaseVertex, packet.StartInstance);
+	}
+	else
+	{
+		m_context->DrawIndexed(packet.IndexCount, packet.StartIndex, packet.BaseVertex);
+	}
+}
+
+D3DParallelSubmitter::D3DParallelSubmitter()
+	:m_immediate(0), m_driverCommandLists(false),
+	m_minDrawsPerContext(DEFAULT_MIN_DRAWS_PER_CONTEXT), m_lastListCount(0)
+{
+}
+
+D3DParallelSubmitter::~D3DParallelSubmitter()
+{
+	Release();
+}
+
+bool D3DParallelSubmitter::Init(ID3D11Device* device, ID3D11DeviceContext* immediate,
+	const D3DRenderBackend& backend, UINT contextCount)
+{
+	Release();
+
+	m_immediate = immediate;
+
+	D3D11_FEATURE_DATA_THREADING threading;
+	ZeroMemory(&threading, sizeof(threading));
+	if (SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading))))
+		m_driverCommandLists = threading.DriverCommandLists != FALSE;
+
+	if (!contextCount)
+		contextCount = JobSystem::Default().ThreadCount() + 1;
+
+	for (UINT i = 0; i < contextCount; ++i)
+	{
+		ID3D11DeviceContext* context = 0;
+		if (FAILED(device->CreateDeferredContext(0, &context)))
+		{
+			Release();
+			m_immediate = immediate;
+			return false;
+		}
+
+		//Without 11.1 the ring blocks cannot be bound on this context
+		ID3D11DeviceContext1* context1 = 0;
+		if (FAILED(context->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&context1))))
+			context1 = 0;
+
+		m_contexts.push_back(context);
+		m_bindContexts.push_back(context1);
+	}
+
+	m_backends.assign(contextCount, backend);
+	for (UINT i = 0; i < contextCount; ++i)
+	{
+		m_backends[i].SetContext(m_contexts[i], m_bindContexts[i]);
+	}
+
+	m_lists.assign(contextCount, 0);
+	return true;
+}
+
+void D3DParallelSubmitter::Release()
+{
+	for (size_t i = 0; i < m_lists.size(); ++i)
+	{
+		ReleaseCOM(m_lists[i]);
+	}
+
+	for (size_t i = 0; i < m_contexts.size(); ++i)
+	{
+		ReleaseCOM(m_bindContexts[i]);
+		ReleaseCOM(m_contexts[i]);
+	}
+
+	m_contexts.clear();
+	m_bindContexts.clear();
+	m_backends.clear();
+	m_lists.clear();
+	m_immediate = 0;
+	m_driverCommandLists = false;
+	m_lastListCount = 0;
+}
+
+void D3DParallelSubmitter::Submit(ParallelRenderQueue& queue, D3DRenderBackend& backend, const SetupFunction& setup)
+{
+	const UINT contextCount = static_cast<UINT>(m_contexts.size());
+
+	bool deferred = contextCount > 1 && (m_minDrawsPerContext == 0 ||
+		(m_driverCommandLists && queue.Count() >= contextCount*m_minDrawsPerContext));
+
+	//The fallback ring binds through the immediate context only
+	if (deferred && backend.Ring())
+	{
+		deferred = backend.Ring()->IsOffsetBinding();
+		for (UINT i = 0; deferred && i < contextCount; ++i)
+		{
+			deferred = m_bindContexts[i] != 0;
+		}
+	}
+
+	if (!deferred)
+	{
+		m_lastListCount = 0;
+		queue.Submit(backend);
+		return;
+	}
+
+	for (UINT i = 0; i < contextCount; ++i)
+	{
+		setup(m_contexts[i]);
+	}
+
+	std::vector<RenderBackend*> backends(contextCount);
+	for (UINT i = 0; i < contextCount; ++i)
+	{
+		backends[i] = &m_backends[i];
+	}
+	queue.SubmitParallel(backends.data(), contextCount);
+
+	for (UINT i = 0; i < contextCount; ++i)
+	{
+		HR(m_contexts[i]->FinishCommandList(FALSE, &m_lists[i]));
+	}
+
+	//In range order, so the draws reach the GPU in key order. Each list
+	//leaves the immediate state as it found it.
+	for (UINT i = 0; i < contextCount; ++i)
+	{
+		m_immediate->ExecuteCommandList(m_lists[i], TRUE);
+		ReleaseCOM(m_lists[i]);
+	}
+
+	m_lastListCount = contextCount;
+}
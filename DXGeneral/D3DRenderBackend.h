@@ -0,0 +1,150 @@
+#pragma once
+
+//Replays a RenderQueue on a D3D11 context
+//
+//Shaders, materials and meshes are registered once and referred to by the
+//returned id in DrawPacket. The backend holds no references; the objects
+//must outlive it. Constant blocks are the blocks of a ConstantRing,
+//bound to the same slot of both stages.
+//
+//D3DParallelSubmitter replays one merged ParallelRenderQueue on several
+//deferred contexts at once, each through its own copy of a backend, and
+//executes the command lists in order on the immediate context.
+
+#ifndef _D3DRENDERBACKEND_H_
+#define _D3DRENDERBACKEND_H_
+
+#include "d3dUtil.h"
+#include "RenderQueue.h"
+#include "ParallelRenderQueue.h"
+#include <d3d11_1.h>
+#include <functional>
+
+class ConstantRing;
+
+class D3DRenderBackend : public RenderBackend
+{
+public:
+	struct ShaderState
+	{
+		ID3D11InputLayout* InputLayout;
+		ID3D11VertexShader* VertexShader;
+		ID3D11PixelShader* PixelShader;
+	};
+
+	//Any member may be null, it is then left alone
+	struct MaterialState
+	{
+		ID3D11ShaderResourceView* Texture;	//pixel shader t0
+		ID3D11SamplerState* Sampler;		//pixel shader s0
+	};
+
+	//InstanceBuffer goes to input slot 1 when set
+	struct MeshState
+	{
+		ID3D11Buffer* VertexBuffer;
+		UINT VertexStride;
+		ID3D11Buffer* InstanceBuffer;
+		UINT InstanceStride;
+		ID3D11Buffer* IndexBuffer;
+		DXGI_FORMAT IndexFormat;
+		D3D11_PRIMITIVE_TOPOLOGY Topology;
+	};
+
+public:
+	D3DRenderBackend();
+
+	//The context the replay records into, immediate or deferred. A deferred
+	//context passes its 11.1 interface too, the ring's blocks are then bound
+	//through it rather than through the ring's own context.
+	void SetContext(ID3D11DeviceContext* context, ID3D11DeviceContext1* bindContext = 0)
+	{
+		m_context = context;
+		m_bindContext = bindContext;
+	}
+
+	UINT AddShader(const ShaderState& shader);
+	UINT AddMaterial(const MaterialState& material);
+	UINT AddMesh(const MeshState& mesh);
+
+	//Where SetConstants() takes its blocks from
+	void SetConstantRing(ConstantRing* ring, UINT slot);
+	ConstantRing* Ring() const { return m_ring; }
+
+	void SetShader(UINT shader);
+	void SetMaterial(UINT material);
+	void SetMesh(UINT mesh);
+	void SetConstants(UINT block);
+	void Draw(const DrawPacket& packet);
+
+private:
+	ID3D11DeviceContext* m_context;
+	ID3D11DeviceContext1* m_bindContext;
+
+	std::vector<ShaderState> m_shaders;
+	std::vector<MaterialState> m_materials;
+	std::vector<MeshState> m_meshes;
+
+	ConstantRing* m_ring;
+	UINT m_ringSlot;
+};
+
+class D3DParallelSubmitter
+{
+public:
+	//Binds the per frame state of the immediate context (render targets,
+	//viewport, rasterizer state, frame constants) on a deferred one, which
+	//starts every command list with default state
+	typedef std::function<void(ID3D11DeviceContext* context)> SetupFunction;
+
+	//Below this many draws per context the deferred contexts cost more than
+	//they save and Submit() replays on the immediate context
+	static const UINT DEFAULT_MIN_DRAWS_PER_CONTEXT = 256;
+
+public:
+	D3DParallelSubmitter();
+	~D3DParallelSubmitter();
+
+	//Creates contextCount deferred contexts, each replaying through a copy
+	//of backend; register all state in backend first. contextCount 0 uses
+	//one per thread of the job system. False when the device creates no
+	//deferred contexts, Submit() then always replays on the immediate one.
+	bool Init(ID3D11Device* device, ID3D11DeviceContext* immediate,
+		const D3DRenderBackend& backend, UINT contextCount = 0);
+	void Release();
+
+	//Draws per context from which Submit() records on the deferred
+	//contexts. 0 records on them whenever there are any, even when the
+	//runtime emulates the command lists, to exercise the path with scenes
+	//of a few draws.
+	void SetMinDrawsPerContext(UINT draws) { m_minDrawsPerContext = draws; }
+	UINT MinDrawsPerContext() const { return m_minDrawsPerContext; }
+
+	//Replays the merged packets of queue. With enough draws they are split
+	//into contiguous ranges, recorded into command lists in parallel and
+	//executed in order; otherwise they are replayed on the immediate
+	//context through backend.
+	void Submit(ParallelRenderQueue& queue, D3DRenderBackend& backend, const SetupFunction& setup);
+
+	//Whether the driver builds command lists itself. Without it the runtime
+	//emulates them and recording in parallel saves little.
+	bool DriverCommandLists() const { return m_driverCommandLists; }
+
+	//Command lists executed by the last Submit(), 0 when it replayed on the
+	//immediate context
+	UINT LastListCount() const { return m_lastListCount; }
+
+private:
+	ID3D11DeviceContext* m_immediate;
+
+	std::vector<ID3D11DeviceContext*> m_contexts;
+	std::vector<ID3D11DeviceContext1*> m_bindContexts;
+	std::vector<D3DRenderBackend> m_backends;
+	std::vector<ID3D11CommandList*> m_lists;
+
+	bool m_driverCommandLists;
+	UINT m_minDrawsPerContext;
+	UINT m_lastListCount;
+};
+
+#endif
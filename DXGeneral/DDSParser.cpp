@@ -0,0 +1,1058 @@
+//--------------------------------------------------------------------------------------
+// File: DDSParser.cpp
+//
+// Device independent DDS parsing, split out of DDSTextureLoader
+//
+// Derived from DDSTextureLoader.cpp:
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#include "DDSParser.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace DirectX;
+
+//--------------------------------------------------------------------------------------
+namespace
+{
+    // Direct3D 11 hardware limits (D3D11_REQ_*). For security purposes we don't trust
+    // DDS file metadata larger than these.
+    const size_t REQ_MIP_LEVELS = 15;
+    const size_t REQ_TEXTURE1D_ARRAY_AXIS_DIMENSION = 2048;
+    const size_t REQ_TEXTURE1D_U_DIMENSION = 16384;
+    const size_t REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION = 2048;
+    const size_t REQ_TEXTURE2D_U_OR_V_DIMENSION = 16384;
+    const size_t REQ_TEXTURECUBE_DIMENSION = 16384;
+    const size_t REQ_TEXTURE3D_U_V_OR_W_DIMENSION = 2048;
+
+    //--------------------------------------------------------------------------------------
+    #define ISBITMASK( r,g,b,a ) ( ddpf.RBitMask == r && ddpf.GBitMask == g && ddpf.BBitMask == b && ddpf.ABitMask == a )
+
+    DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf)
+    {
+        if (ddpf.flags & DDS_RGB)
+        {
+            // Note that sRGB formats are written using the "DX10" extended header
+
+            switch (ddpf.RGBBitCount)
+            {
+            case 32:
+                if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
+                {
+                    return DXGI_FORMAT_R8G8B8A8_UNORM;
+                }
+
+                if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000))
+                {
+                    return DXGI_FORMAT_B8G8R8A8_UNORM;
+                }
+
+                if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000))
+                {
+                    return DXGI_FORMAT_B8G8R8X8_UNORM;
+                }
+
+                // No DXGI format maps to ISBITMASK(0x000000ff,0x0000ff00,0x00ff0000,0x00000000) aka D3DFMT_X8B8G8R8
+
+                // Note that many common DDS reader/writers (including D3DX) swap the
+                // the RED/BLUE masks for 10:10:10:2 formats. We assume
+                // below that the 'backwards' header mask is being used since it is most
+                // likely written by D3DX. The more robust solution is to use the 'DX10'
+                // header extension and specify the DXGI_FORMAT_R10G10B10A2_UNORM format directly
+
+                // For 'correct' writers, this should be 0x000003ff,0x000ffc00,0x3ff00000 for RGB data
+                if (ISBITMASK(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000))
+                {
+                    return DXGI_FORMAT_R10G10B10A2_UNORM;
+                }
+
+                // No DXGI format maps to ISBITMASK(0x000003ff,0x000ffc00,0x3ff00000,0xc0000000) aka D3DFMT_A2R10G10B10
+
+                if (ISBITMASK(0x0000ffff, 0xffff0000, 0x00000000, 0x00000000))
+                {
+                    return DXGI_FORMAT_R16G16_UNORM;
+                }
+
+                if (ISBITMASK(0xffffffff, 0x00000000, 0x00000000, 0x00000000))
+                {
+                    // Only 32-bit color channel format in D3D9 was R32F
+                    return DXGI_FORMAT_R32_FLOAT; // D3DX writes this out as a FourCC of 114
+                }
+                break;
+
+            case 24:
+                // No 24bpp DXGI formats aka D3DFMT_R8G8B8
+                break;
+
+            case 16:
+                if (ISBITMASK(0x7c00, 0x03e0, 0x001f, 0x8000))
+                {
+                    return DXGI_FORMAT_B5G5R5A1_UNORM;
+                }
+                if (ISBITMASK(0xf800, 0x07e0, 0x001f, 0x0000))
+                {
+                    return DXGI_FORMAT_B5G6R5_UNORM;
+                }
+
+                // No DXGI format maps to ISBITMASK(0x7c00,0x03e0,0x001f,0x0000) aka D3DFMT_X1R5G5B5
+
+                if (ISBITMASK(0x0f00, 0x00f0, 0x000f, 0xf000))
+                {
+                    return DXGI_FORMAT_B4G4R4A4_UNORM;
+                }
+
+                // No DXGI format maps to ISBITMASK(0x0f00,0x00f0,0x000f,0x0000) aka D3DFMT_X4R4G4B4
+
+                // No 3:3:2, 3:3:2:8, or paletted DXGI formats aka D3DFMT_A8R3G3B2, D3DFMT_R3G3B2, D3DFMT_P8, D3DFMT_A8P8, etc.
+                break;
+            }
+        }
+        else if (ddpf.flags & DDS_LUMINANCE)
+        {
+            if (8 == ddpf.RGBBitCount)
+            {
+                if (ISBITMASK(0x000000ff, 0x00000000, 0x00000000, 0x00000000))
+                {
+                    return DXGI_FORMAT_R8_UNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+
+                // No DXGI format maps to ISBITMASK(0x0f,0x00,0x00,0xf0) aka D3DFMT_A4L4
+
+                if (ISBITMASK(0x000000ff, 0x00000000, 0x00000000, 0x0000ff00))
+                {
+                    return DXGI_FORMAT_R8G8_UNORM; // Some DDS writers assume the bitcount should be 8 instead of 16
+                }
+            }
+
+            if (16 == ddpf.RGBBitCount)
+            {
+                if (ISBITMASK(0x0000ffff, 0x00000000, 0x00000000, 0x00000000))
+                {
+                    return DXGI_FORMAT_R16_UNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+                if (ISBITMASK(0x000000ff, 0x00000000, 0x00000000, 0x0000ff00))
+                {
+                    return DXGI_FORMAT_R8G8_UNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+            }
+        }
+        else if (ddpf.flags & DDS_ALPHA)
+        {
+            if (8 == ddpf.RGBBitCount)
+            {
+                return DXGI_FORMAT_A8_UNORM;
+            }
+        }
+        else if (ddpf.flags & DDS_BUMPDUDV)
+        {
+            if (16 == ddpf.RGBBitCount)
+            {
+                if (ISBITMASK(0x00ff, 0xff00, 0x0000, 0x0000))
+                {
+                    return DXGI_FORMAT_R8G8_SNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+            }
+
+            if (32 == ddpf.RGBBitCount)
+            {
+                if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
+                {
+                    return DXGI_FORMAT_R8G8B8A8_SNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+                if (ISBITMASK(0x0000ffff, 0xffff0000, 0x00000000, 0x00000000))
+                {
+                    return DXGI_FORMAT_R16G16_SNORM; // D3DX10/11 writes this out as DX10 extension
+                }
+
+                // No DXGI format maps to ISBITMASK(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000) aka D3DFMT_A2W10V10U10
+            }
+        }
+        else if (ddpf.flags & DDS_FOURCC)
+        {
+            if (MAKEFOURCC('D', 'X', 'T', '1') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC1_UNORM;
+            }
+            if (MAKEFOURCC('D', 'X', 'T', '3') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC2_UNORM;
+            }
+            if (MAKEFOURCC('D', 'X', 'T', '5') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC3_UNORM;
+            }
+
+            // While pre-multiplied alpha isn't directly supported by the DXGI formats,
+            // they are basically the same as these BC formats so they can be mapped
+            if (MAKEFOURCC('D', 'X', 'T', '2') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC2_UNORM;
+            }
+            if (MAKEFOURCC('D', 'X', 'T', '4') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC3_UNORM;
+            }
+
+            if (MAKEFOURCC('A', 'T', 'I', '1') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC4_UNORM;
+            }
+            if (MAKEFOURCC('B', 'C', '4', 'U') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC4_UNORM;
+            }
+            if (MAKEFOURCC('B', 'C', '4', 'S') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC4_SNORM;
+            }
+
+            if (MAKEFOURCC('A', 'T', 'I', '2') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC5_UNORM;
+            }
+            if (MAKEFOURCC('B', 'C', '5', 'U') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC5_UNORM;
+            }
+            if (MAKEFOURCC('B', 'C', '5', 'S') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_BC5_SNORM;
+            }
+
+            // BC6H and BC7 are written using the "DX10" extended header
+
+            if (MAKEFOURCC('R', 'G', 'B', 'G') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_R8G8_B8G8_UNORM;
+            }
+            if (MAKEFOURCC('G', 'R', 'G', 'B') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_G8R8_G8B8_UNORM;
+            }
+
+            if (MAKEFOURCC('Y', 'U', 'Y', '2') == ddpf.fourCC)
+            {
+                return DXGI_FORMAT_YUY2;
+            }
+
+            // Check for D3DFORMAT enums being set here
+            switch (ddpf.fourCC)
+            {
+            case 36: // D3DFMT_A16B16G16R16
+                return DXGI_FORMAT_R16G16B16A16_UNORM;
+
+            case 110: // D3DFMT_Q16W16V16U16
+                return DXGI_FORMAT_R16G16B16A16_SNORM;
+
+            case 111: // D3DFMT_R16F
+                return DXGI_FORMAT_R16_FLOAT;
+
+            case 112: // D3DFMT_G16R16F
+                return DXGI_FORMAT_R16G16_FLOAT;
+
+            case 113: // D3DFMT_A16B16G16R16F
+                return DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+            case 114: // D3DFMT_R32F
+                return DXGI_FORMAT_R32_FLOAT;
+
+            case 115: // D3DFMT_G32R32F
+                return DXGI_FORMAT_R32G32_FLOAT;
+
+            case 116: // D3DFMT_A32B32G32R32F
+                return DXGI_FORMAT_R32G32B32A32_FLOAT;
+            }
+        }
+
+        return DXGI_FORMAT_UNKNOWN;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // 4:2:0 planar formats keep one chroma row per two luma rows and need an even
+    // height, otherwise GetSurfaceInfo counts more rows than the size it returns
+    bool IsPlanar420(DXGI_FORMAT fmt)
+    {
+        switch (fmt)
+        {
+        case DXGI_FORMAT_NV12:
+        case DXGI_FORMAT_P010:
+        case DXGI_FORMAT_P016:
+        case DXGI_FORMAT_420_OPAQUE:
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    DDS_ALPHA_MODE GetAlphaMode(const DDS_HEADER* header)
+    {
+        if (header->ddspf.flags & DDS_FOURCC)
+        {
+            if (MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC)
+            {
+                auto d3d10ext = reinterpret_cast<const DDS_HEADER_DXT10*>((const char*)header + sizeof(DDS_HEADER));
+                auto mode = static_cast<DDS_ALPHA_MODE>(d3d10ext->miscFlags2 & DDS_MISC_FLAGS2_ALPHA_MODE_MASK);
+                switch (mode)
+                {
+                case DDS_ALPHA_MODE_STRAIGHT:
+                case DDS_ALPHA_MODE_PREMULTIPLIED:
+                case DDS_ALPHA_MODE_OPAQUE:
+                case DDS_ALPHA_MODE_CUSTOM:
+                    return mode;
+                }
+            }
+            else if ((MAKEFOURCC('D', 'X', 'T', '2') == header->ddspf.fourCC)
+                || (MAKEFOURCC('D', 'X', 'T', '4') == header->ddspf.fourCC))
+            {
+                return DDS_ALPHA_MODE_PREMULTIPLIED;
+            }
+        }
+
+        return DDS_ALPHA_MODE_UNKNOWN;
+    }
+} // anonymous namespace
+
+
+//--------------------------------------------------------------------------------------
+// Return the BPP for a particular format
+//--------------------------------------------------------------------------------------
+size_t DirectX::BitsPerPixel(DXGI_FORMAT fmt)
+{
+    switch (fmt)
+    {
+    case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+    case DXGI_FORMAT_R32G32B32A32_UINT:
+    case DXGI_FORMAT_R32G32B32A32_SINT:
+        return 128;
+
+    case DXGI_FORMAT_R32G32B32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32_FLOAT:
+    case DXGI_FORMAT_R32G32B32_UINT:
+    case DXGI_FORMAT_R32G32B32_SINT:
+        return 96;
+
+    case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+    case DXGI_FORMAT_R16G16B16A16_UINT:
+    case DXGI_FORMAT_R16G16B16A16_SNORM:
+    case DXGI_FORMAT_R16G16B16A16_SINT:
+    case DXGI_FORMAT_R32G32_TYPELESS:
+    case DXGI_FORMAT_R32G32_FLOAT:
+    case DXGI_FORMAT_R32G32_UINT:
+    case DXGI_FORMAT_R32G32_SINT:
+    case DXGI_FORMAT_R32G8X24_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+    case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+    case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+    case DXGI_FORMAT_Y416:
+    case DXGI_FORMAT_Y210:
+    case DXGI_FORMAT_Y216:
+        return 64;
+
+    case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+    case DXGI_FORMAT_R10G10B10A2_UNORM:
+    case DXGI_FORMAT_R10G10B10A2_UINT:
+    case DXGI_FORMAT_R11G11B10_FLOAT:
+    case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_R8G8B8A8_UINT:
+    case DXGI_FORMAT_R8G8B8A8_SNORM:
+    case DXGI_FORMAT_R8G8B8A8_SINT:
+    case DXGI_FORMAT_R16G16_TYPELESS:
+    case DXGI_FORMAT_R16G16_FLOAT:
+    case DXGI_FORMAT_R16G16_UNORM:
+    case DXGI_FORMAT_R16G16_UINT:
+    case DXGI_FORMAT_R16G16_SNORM:
+    case DXGI_FORMAT_R16G16_SINT:
+    case DXGI_FORMAT_R32_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT:
+    case DXGI_FORMAT_R32_FLOAT:
+    case DXGI_FORMAT_R32_UINT:
+    case DXGI_FORMAT_R32_SINT:
+    case DXGI_FORMAT_R24G8_TYPELESS:
+    case DXGI_FORMAT_D24_UNORM_S8_UINT:
+    case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+    case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+    case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+    case DXGI_FORMAT_AYUV:
+    case DXGI_FORMAT_Y410:
+    case DXGI_FORMAT_YUY2:
+        return 32;
+
+    case DXGI_FORMAT_P010:
+    case DXGI_FORMAT_P016:
+        return 24;
+
+    case DXGI_FORMAT_R8G8_TYPELESS:
+    case DXGI_FORMAT_R8G8_UNORM:
+    case DXGI_FORMAT_R8G8_UINT:
+    case DXGI_FORMAT_R8G8_SNORM:
+    case DXGI_FORMAT_R8G8_SINT:
+    case DXGI_FORMAT_R16_TYPELESS:
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_D16_UNORM:
+    case DXGI_FORMAT_R16_UNORM:
+    case DXGI_FORMAT_R16_UINT:
+    case DXGI_FORMAT_R16_SNORM:
+    case DXGI_FORMAT_R16_SINT:
+    case DXGI_FORMAT_B5G6R5_UNORM:
+    case DXGI_FORMAT_B5G5R5A1_UNORM:
+    case DXGI_FORMAT_A8P8:
+    case DXGI_FORMAT_B4G4R4A4_UNORM:
+        return 16;
+
+    case DXGI_FORMAT_NV12:
+    case DXGI_FORMAT_420_OPAQUE:
+    case DXGI_FORMAT_NV11:
+        return 12;
+
+    case DXGI_FORMAT_R8_TYPELESS:
+    case DXGI_FORMAT_R8_UNORM:
+    case DXGI_FORMAT_R8_UINT:
+    case DXGI_FORMAT_R8_SNORM:
+    case DXGI_FORMAT_R8_SINT:
+    case DXGI_FORMAT_A8_UNORM:
+    case DXGI_FORMAT_AI44:
+    case DXGI_FORMAT_IA44:
+    case DXGI_FORMAT_P8:
+        return 8;
+
+    case DXGI_FORMAT_R1_UNORM:
+        return 1;
+
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        return 4;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return 8;
+
+    default:
+        return 0;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Get surface information for a particular format
+//--------------------------------------------------------------------------------------
+void DirectX::GetSurfaceInfo(
+    size_t width,
+    size_t height,
+    DXGI_FORMAT fmt,
+    size_t* outNumBytes,
+    size_t* outRowBytes,
+    size_t* outNumRows)
+{
+    size_t numBytes = 0;
+    size_t rowBytes = 0;
+    size_t numRows = 0;
+
+    bool bc = false;
+    bool packed = false;
+    bool planar = false;
+    size_t bpe = 0;
+    switch (fmt)
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        bc = true;
+        bpe = 8;
+        break;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        bc = true;
+        bpe = 16;
+        break;
+
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+    case DXGI_FORMAT_YUY2:
+        packed = true;
+        bpe = 4;
+        break;
+
+    case DXGI_FORMAT_Y210:
+    case DXGI_FORMAT_Y216:
+        packed = true;
+        bpe = 8;
+        break;
+
+    case DXGI_FORMAT_NV12:
+    case DXGI_FORMAT_420_OPAQUE:
+        planar = true;
+        bpe = 2;
+        break;
+
+    case DXGI_FORMAT_P010:
+    case DXGI_FORMAT_P016:
+        planar = true;
+        bpe = 4;
+        break;
+    }
+
+    if (bc)
+    {
+        size_t numBlocksWide = 0;
+        if (width > 0)
+        {
+            numBlocksWide = std::max<size_t>(1, (width + 3) / 4);
+        }
+        size_t numBlocksHigh = 0;
+        if (height > 0)
+        {
+            numBlocksHigh = std::max<size_t>(1, (height + 3) / 4);
+        }
+        rowBytes = numBlocksWide * bpe;
+        numRows = numBlocksHigh;
+        numBytes = rowBytes * numBlocksHigh;
+    }
+    else if (packed)
+    {
+        rowBytes = ((width + 1) >> 1) * bpe;
+        numRows = height;
+        numBytes = rowBytes * height;
+    }
+    else if (fmt == DXGI_FORMAT_NV11)
+    {
+        rowBytes = ((width + 3) >> 2) * 4;
+        numRows = height * 2; // Direct3D makes this simplifying assumption, although it is larger than the 4:1:1 data
+        numBytes = rowBytes * numRows;
+    }
+    else if (planar)
+    {
+        rowBytes = ((width + 1) >> 1) * bpe;
+        numBytes = (rowBytes * height) + ((rowBytes * height + 1) >> 1);
+        numRows = height + ((height + 1) >> 1);
+    }
+    else
+    {
+        size_t bpp = BitsPerPixel(fmt);
+        rowBytes = (width * bpp + 7) / 8; // round up to nearest byte
+        numRows = height;
+        numBytes = rowBytes * height;
+    }
+
+    if (outNumBytes)
+    {
+        *outNumBytes = numBytes;
+    }
+    if (outRowBytes)
+    {
+        *outRowBytes = rowBytes;
+    }
+    if (outNumRows)
+    {
+        *outNumRows = numRows;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::ParseDDSHeader(
+    const uint8_t* ddsData,
+    size_t ddsDataSize,
+    DDSTextureInfo& info)
+{
+    if (!ddsData)
+    {
+        return E_POINTER;
+    }
+
+    // Need at least enough data to fill the header and magic number to be a valid DDS
+    if (ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER)))
+    {
+        return E_FAIL;
+    }
+
+    // DDS files always start with the same magic number ("DDS ")
+    uint32_t dwMagicNumber = *reinterpret_cast<const uint32_t*>(ddsData);
+    if (dwMagicNumber != DDS_MAGIC)
+    {
+        return E_FAIL;
+    }
+
+    auto header = reinterpret_cast<const DDS_HEADER*>(ddsData + sizeof(uint32_t));
+
+    // Verify header to validate DDS file
+    if (header->size != sizeof(DDS_HEADER) ||
+        header->ddspf.size != sizeof(DDS_PIXELFORMAT))
+    {
+        return E_FAIL;
+    }
+
+    // Check for DX10 extension
+    bool bDXT10Header = false;
+    if ((header->ddspf.flags & DDS_FOURCC) &&
+        (MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC))
+    {
+        // Must be long enough for both headers and magic value
+        if (ddsDataSize < (sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10)))
+        {
+            return E_FAIL;
+        }
+
+        bDXT10Header = true;
+    }
+
+    size_t width = header->width;
+    size_t height = header->height;
+    size_t depth = header->depth;
+
+    uint32_t resDim = 0;
+    size_t arraySize = 1;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    bool isCubeMap = false;
+
+    size_t mipCount = header->mipMapCount;
+    if (0 == mipCount)
+    {
+        mipCount = 1;
+    }
+
+    if (bDXT10Header)
+    {
+        auto d3d10ext = reinterpret_cast<const DDS_HEADER_DXT10*>((const char*)header + sizeof(DDS_HEADER));
+
+        arraySize = d3d10ext->arraySize;
+        if (arraySize == 0)
+        {
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+
+        switch (d3d10ext->dxgiFormat)
+        {
+        case DXGI_FORMAT_AI44:
+        case DXGI_FORMAT_IA44:
+        case DXGI_FORMAT_P8:
+        case DXGI_FORMAT_A8P8:
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+        default:
+            if (BitsPerPixel(d3d10ext->dxgiFormat) == 0)
+            {
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            }
+        }
+
+        format = d3d10ext->dxgiFormat;
+
+        switch (d3d10ext->resourceDimension)
+        {
+        case DDS_DIMENSION_TEXTURE1D:
+            // D3DX writes 1D textures with a fixed Height of 1
+            if ((header->flags & DDS_HEIGHT) && height != 1)
+            {
+                return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            }
+            height = depth = 1;
+            break;
+
+        case DDS_DIMENSION_TEXTURE2D:
+            if (d3d10ext->miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+            {
+                arraySize *= 6;
+                isCubeMap = true;
+            }
+            depth = 1;
+            break;
+
+        case DDS_DIMENSION_TEXTURE3D:
+            if (!(header->flags & DDS_HEADER_FLAGS_VOLUME))
+            {
+                return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            }
+
+            if (arraySize > 1)
+            {
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            }
+            break;
+
+        default:
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        resDim = d3d10ext->resourceDimension;
+    }
+    else
+    {
+        format = GetDXGIFormat(header->ddspf);
+
+        if (format == DXGI_FORMAT_UNKNOWN)
+        {
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        if (header->flags & DDS_HEADER_FLAGS_VOLUME)
+        {
+            resDim = DDS_DIMENSION_TEXTURE3D;
+        }
+        else
+        {
+            if (header->caps2 & DDS_CUBEMAP)
+            {
+                // We require all six faces to be defined
+                if ((header->caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+                {
+                    return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+                }
+
+                arraySize = 6;
+                isCubeMap = true;
+            }
+
+            depth = 1;
+            resDim = DDS_DIMENSION_TEXTURE2D;
+
+            // Note there's no way for a legacy Direct3D 9 DDS to express a '1D' texture
+        }
+
+        assert(BitsPerPixel(format) != 0);
+    }
+
+    if (!width || !height || !depth)
+    {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    // Bound sizes
+    if (mipCount > REQ_MIP_LEVELS)
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    switch (resDim)
+    {
+    case DDS_DIMENSION_TEXTURE1D:
+        if ((arraySize > REQ_TEXTURE1D_ARRAY_AXIS_DIMENSION) ||
+            (width > REQ_TEXTURE1D_U_DIMENSION))
+        {
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+        break;
+
+    case DDS_DIMENSION_TEXTURE2D:
+        if (isCubeMap)
+        {
+            // This is the right bound because we set arraySize to (NumCubes*6) above
+            if ((arraySize > REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION) ||
+                (width > REQ_TEXTURECUBE_DIMENSION) ||
+                (height > REQ_TEXTURECUBE_DIMENSION))
+            {
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            }
+        }
+        else if ((arraySize > REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION) ||
+            (width > REQ_TEXTURE2D_U_OR_V_DIMENSION) ||
+            (height > REQ_TEXTURE2D_U_OR_V_DIMENSION))
+        {
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+        break;
+
+    case DDS_DIMENSION_TEXTURE3D:
+        if ((arraySize > 1) ||
+            (width > REQ_TEXTURE3D_U_V_OR_W_DIMENSION) ||
+            (height > REQ_TEXTURE3D_U_V_OR_W_DIMENSION) ||
+            (depth > REQ_TEXTURE3D_U_V_OR_W_DIMENSION))
+        {
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+        break;
+
+    default:
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    info.resourceDimension = resDim;
+    info.width = width;
+    info.height = height;
+    info.depth = depth;
+    info.mipLevels = mipCount;
+    info.arraySize = arraySize;
+    info.format = format;
+    info.isCubeMap = isCubeMap;
+    info.alphaMode = GetAlphaMode(header);
+    info.headerSize = sizeof(uint32_t) + sizeof(DDS_HEADER)
+        + (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0);
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::ParseDDS(
+    const uint8_t* ddsData,
+    size_t ddsDataSize,
+    DDSTextureInfo& info,
+    std::vector<DDSSubresource>& subresources)
+{
+    subresources.clear();
+
+    HRESULT hr = ParseDDSHeader(ddsData, ddsDataSize, info);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    return GetDDSSubresources(info, ddsData, ddsDataSize, subresources);
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::GetDDSSubresources(
+    const DDSTextureInfo& info,
+    const uint8_t* ddsData,
+    size_t ddsDataSize,
+    std::vector<DDSSubresource>& subresources)
+{
+    subresources.clear();
+
+    if (ddsDataSize < info.headerSize)
+    {
+        return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+    }
+
+    subresources.resize(info.mipLevels * info.arraySize);
+
+    size_t offset = info.headerSize;
+    size_t index = 0;
+    for (size_t j = 0; j < info.arraySize; j++)
+    {
+        size_t w = info.width;
+        size_t h = info.height;
+        size_t d = info.depth;
+        for (size_t i = 0; i < info.mipLevels; i++)
+        {
+            if ((h & 1) && IsPlanar420(info.format))
+            {
+                subresources.clear();
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            }
+
+            size_t NumBytes = 0;
+            size_t RowBytes = 0;
+            GetSurfaceInfo(w, h, info.format, &NumBytes, &RowBytes, nullptr);
+
+            // Compare against what is left so a huge mip can't wrap the pointer
+            if (static_cast<uint64_t>(NumBytes) * d > ddsDataSize - offset)
+            {
+                subresources.clear();
+                return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+            }
+
+            DDSSubresource& sub = subresources[index++];
+            sub.pData = ddsData ? ddsData + offset : nullptr;
+            sub.offset = offset;
+            sub.rowPitch = RowBytes;
+            sub.slicePitch = NumBytes;
+            sub.width = w;
+            sub.height = h;
+            sub.depth = d;
+
+            offset += NumBytes * d;
+
+            w = std::max<size_t>(w >> 1, 1);
+            h = std::max<size_t>(h >> 1, 1);
+            d = std::max<size_t>(d >> 1, 1);
+        }
+    }
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::WriteDDS(
+    const DDSTextureInfo& info,
+    const std::vector<DDSSubresource>& subresources,
+    std::vector<uint8_t>& ddsData)
+{
+    ddsData.clear();
+
+    if (!info.width || !info.height || !info.depth || !info.mipLevels || !info.arraySize
+        || subresources.size() != info.mipLevels * info.arraySize
+        || (info.isCubeMap && (info.arraySize % 6) != 0)
+        || BitsPerPixel(info.format) == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    const size_t headerSize = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+
+    size_t total = headerSize;
+    for (const DDSSubresource& sub : subresources)
+    {
+        if (!sub.pData)
+        {
+            return E_POINTER;
+        }
+
+        size_t NumBytes = 0;
+        GetSurfaceInfo(sub.width, sub.height, info.format, &NumBytes, nullptr, nullptr);
+        total += NumBytes * sub.depth;
+    }
+
+    size_t topBytes = 0;
+    size_t topRowBytes = 0;
+    GetSurfaceInfo(info.width, info.height, info.format, &topBytes, &topRowBytes, nullptr);
+
+    DDS_HEADER header = {};
+    header.size = sizeof(DDS_HEADER);
+    header.flags = DDS_HEADER_FLAGS_TEXTURE;
+    header.height = static_cast<uint32_t>(info.height);
+    header.width = static_cast<uint32_t>(info.width);
+    header.mipMapCount = static_cast<uint32_t>(info.mipLevels);
+    header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+    header.ddspf.flags = DDS_FOURCC;
+    header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+    header.caps = DDS_SURFACE_FLAGS_TEXTURE;
+
+    if (IsCompressed(info.format))
+    {
+        header.flags |= DDS_HEADER_FLAGS_LINEARSIZE;
+        header.pitchOrLinearSize = static_cast<uint32_t>(topBytes);
+    }
+    else
+    {
+        header.flags |= DDS_HEADER_FLAGS_PITCH;
+        header.pitchOrLinearSize = static_cast<uint32_t>(topRowBytes);
+    }
+
+    if (info.mipLevels > 1)
+    {
+        header.flags |= DDS_HEADER_FLAGS_MIPMAP;
+        header.caps |= DDS_SURFACE_FLAGS_MIPMAP;
+    }
+
+    DDS_HEADER_DXT10 ext = {};
+    ext.dxgiFormat = info.format;
+    ext.resourceDimension = info.resourceDimension;
+    ext.arraySize = static_cast<uint32_t>(info.arraySize);
+    ext.miscFlags2 = static_cast<uint32_t>(info.alphaMode) & DDS_MISC_FLAGS2_ALPHA_MODE_MASK;
+
+    if (info.resourceDimension == DDS_DIMENSION_TEXTURE3D)
+    {
+        header.flags |= DDS_HEADER_FLAGS_VOLUME;
+        header.depth = static_cast<uint32_t>(info.depth);
+        header.caps2 |= DDS_FLAGS_VOLUME;
+    }
+    else if (info.isCubeMap)
+    {
+        header.caps |= DDS_SURFACE_FLAGS_CUBEMAP;
+        header.caps2 |= DDS_CUBEMAP_ALLFACES;
+        ext.miscFlag = DDS_RESOURCE_MISC_TEXTURECUBE;
+        ext.arraySize /= 6;
+    }
+
+    ddsData.resize(total);
+    uint8_t* dest = ddsData.data();
+
+    const uint32_t magic = DDS_MAGIC;
+    memcpy(dest, &magic, sizeof(uint32_t));
+    memcpy(dest + sizeof(uint32_t), &header, sizeof(DDS_HEADER));
+    memcpy(dest + sizeof(uint32_t) + sizeof(DDS_HEADER), &ext, sizeof(DDS_HEADER_DXT10));
+    dest += headerSize;
+
+    for (const DDSSubresource& sub : subresources)
+    {
+        size_t RowBytes = 0;
+        size_t NumRows = 0;
+        GetSurfaceInfo(sub.width, sub.height, info.format, nullptr, &RowBytes, &NumRows);
+
+        for (size_t z = 0; z < sub.depth; ++z)
+        {
+            const uint8_t* src = sub.pData + z * sub.slicePitch;
+            for (size_t row = 0; row < NumRows; ++row)
+            {
+                memcpy(dest, src, RowBytes);
+                dest += RowBytes;
+                src += sub.rowPitch;
+            }
+        }
+    }
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+size_t DirectX::CountSkippedMips(const DDSTextureInfo& info, size_t maxsize)
+{
+    if (info.mipLevels <= 1 || !maxsize)
+    {
+        return 0;
+    }
+
+    size_t skipMip = 0;
+    size_t w = info.width;
+    size_t h = info.height;
+    size_t d = info.depth;
+    while (skipMip < info.mipLevels && (w > maxsize || h > maxsize || d > maxsize))
+    {
+        ++skipMip;
+
+        w = std::max<size_t>(w >> 1, 1);
+        h = std::max<size_t>(h >> 1, 1);
+        d = std::max<size_t>(d >> 1, 1);
+    }
+
+    return skipMip;
+}
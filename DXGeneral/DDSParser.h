@@ -0,0 +1,323 @@
+//--------------------------------------------------------------------------------------
+// File: DDSParser.h
+//
+// Device independent DDS parsing, split out of DDSTextureLoader
+//
+// ParseDDS validates the headers of a DDS image held in memory (usually a MappedFile)
+// and describes every mip level of every array slice as a pointer into that memory
+// plus its row and slice pitch. Nothing is copied and no Direct3D device is needed,
+// so textures can be loaded and checked on build and test hosts without one. The
+// Direct3D loader only consumes the resulting table.
+//
+// Derived from DDSTextureLoader.cpp:
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#ifndef _DDSPARSER_H_
+#define _DDSPARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <dxgiformat.h>
+#else
+// DirectX-Headers package
+#include <directx/dxgiformat.h>
+
+typedef int32_t HRESULT;
+
+#define S_OK            ((HRESULT)0L)
+#define E_FAIL          ((HRESULT)0x80004005L)
+#define E_POINTER       ((HRESULT)0x80004003L)
+#define E_INVALIDARG    ((HRESULT)0x80070057L)
+#define E_OUTOFMEMORY   ((HRESULT)0x8007000EL)
+#define SUCCEEDED(hr)   (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)      (((HRESULT)(hr)) < 0)
+
+#define ERROR_INVALID_DATA  13L
+#define ERROR_HANDLE_EOF    38L
+#define ERROR_NOT_SUPPORTED 50L
+
+#define HRESULT_FROM_WIN32(x) ((HRESULT)(x) <= 0 ? ((HRESULT)(x)) : ((HRESULT)(((x) & 0x0000FFFF) | (7 << 16) | 0x80000000)))
+#endif
+
+//--------------------------------------------------------------------------------------
+// Macros
+//--------------------------------------------------------------------------------------
+#ifndef MAKEFOURCC
+    #define MAKEFOURCC(ch0, ch1, ch2, ch3)                              \
+                ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) |       \
+                ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
+#endif /* defined(MAKEFOURCC) */
+
+//--------------------------------------------------------------------------------------
+// DDS file structure definitions
+//
+// See DDS.h in the 'Texconv' sample and the 'DirectXTex' library
+//--------------------------------------------------------------------------------------
+#pragma pack(push,1)
+
+const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+struct DDS_PIXELFORMAT
+{
+    uint32_t    size;
+    uint32_t    flags;
+    uint32_t    fourCC;
+    uint32_t    RGBBitCount;
+    uint32_t    RBitMask;
+    uint32_t    GBitMask;
+    uint32_t    BBitMask;
+    uint32_t    ABitMask;
+};
+
+#define DDS_FOURCC      0x00000004  // DDPF_FOURCC
+#define DDS_RGB         0x00000040  // DDPF_RGB
+#define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
+#define DDS_ALPHA       0x00000002  // DDPF_ALPHA
+#define DDS_BUMPDUDV    0x00080000  // DDPF_BUMPDUDV
+
+#define DDS_HEADER_FLAGS_TEXTURE        0x00001007  // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
+#define DDS_HEADER_FLAGS_MIPMAP         0x00020000  // DDSD_MIPMAPCOUNT
+#define DDS_HEADER_FLAGS_VOLUME         0x00800000  // DDSD_DEPTH
+#define DDS_HEADER_FLAGS_PITCH          0x00000008  // DDSD_PITCH
+#define DDS_HEADER_FLAGS_LINEARSIZE     0x00080000  // DDSD_LINEARSIZE
+
+#define DDS_HEIGHT 0x00000002 // DDSD_HEIGHT
+#define DDS_WIDTH  0x00000004 // DDSD_WIDTH
+
+#define DDS_CUBEMAP_POSITIVEX 0x00000600 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX
+#define DDS_CUBEMAP_NEGATIVEX 0x00000a00 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEX
+#define DDS_CUBEMAP_POSITIVEY 0x00001200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEY
+#define DDS_CUBEMAP_NEGATIVEY 0x00002200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEY
+#define DDS_CUBEMAP_POSITIVEZ 0x00004200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEZ
+#define DDS_CUBEMAP_NEGATIVEZ 0x00008200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEZ
+
+#define DDS_CUBEMAP_ALLFACES ( DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX |\
+                               DDS_CUBEMAP_POSITIVEY | DDS_CUBEMAP_NEGATIVEY |\
+                               DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ )
+
+#define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
+
+#define DDS_FLAGS_VOLUME 0x00200000 // DDSCAPS2_VOLUME
+
+#define DDS_SURFACE_FLAGS_TEXTURE 0x00001000 // DDSCAPS_TEXTURE
+#define DDS_SURFACE_FLAGS_MIPMAP  0x00400008 // DDSCAPS_COMPLEX | DDSCAPS_MIPMAP
+#define DDS_SURFACE_FLAGS_CUBEMAP 0x00000008 // DDSCAPS_COMPLEX
+
+enum DDS_MISC_FLAGS2
+{
+    DDS_MISC_FLAGS2_ALPHA_MODE_MASK = 0x7L,
+};
+
+struct DDS_HEADER
+{
+    uint32_t        size;
+    uint32_t        flags;
+    uint32_t        height;
+    uint32_t        width;
+    uint32_t        pitchOrLinearSize;
+    uint32_t        depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
+    uint32_t        mipMapCount;
+    uint32_t        reserved1[11];
+    DDS_PIXELFORMAT ddspf;
+    uint32_t        caps;
+    uint32_t        caps2;
+    uint32_t        caps3;
+    uint32_t        caps4;
+    uint32_t        reserved2;
+};
+
+struct DDS_HEADER_DXT10
+{
+    DXGI_FORMAT     dxgiFormat;
+    uint32_t        resourceDimension;
+    uint32_t        miscFlag; // see D3D11_RESOURCE_MISC_FLAG
+    uint32_t        arraySize;
+    uint32_t        miscFlags2;
+};
+
+#pragma pack(pop)
+
+// Same values as D3D11_RESOURCE_DIMENSION and D3D11_RESOURCE_MISC_TEXTURECUBE
+#define DDS_DIMENSION_TEXTURE1D 2
+#define DDS_DIMENSION_TEXTURE2D 3
+#define DDS_DIMENSION_TEXTURE3D 4
+
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4L
+
+
+namespace DirectX
+{
+    enum DDS_ALPHA_MODE
+    {
+        DDS_ALPHA_MODE_UNKNOWN       = 0,
+        DDS_ALPHA_MODE_STRAIGHT      = 1,
+        DDS_ALPHA_MODE_PREMULTIPLIED = 2,
+        DDS_ALPHA_MODE_OPAQUE        = 3,
+        DDS_ALPHA_MODE_CUSTOM        = 4,
+    };
+
+    struct DDSTextureInfo
+    {
+        uint32_t        resourceDimension; // DDS_DIMENSION_*
+        size_t          width;
+        size_t          height;
+        size_t          depth;
+        size_t          mipLevels;
+        size_t          arraySize; // six per cube
+        DXGI_FORMAT     format;
+        bool            isCubeMap;
+        DDS_ALPHA_MODE  alphaMode;
+
+        // Magic number plus headers, the offset of the first texel
+        size_t          headerSize;
+    };
+
+    // One mip level of one array slice. A volume level holds depth slices
+    // of slicePitch bytes each.
+    struct DDSSubresource
+    {
+        const uint8_t*  pData;
+        size_t          offset; // from the start of the file
+        size_t          rowPitch;
+        size_t          slicePitch;
+        size_t          width;
+        size_t          height;
+        size_t          depth;
+    };
+
+    // Return the BPP for a particular format
+    size_t BitsPerPixel(DXGI_FORMAT fmt);
+
+    // Get surface information for a particular format
+    void GetSurfaceInfo(
+        size_t width,
+        size_t height,
+        DXGI_FORMAT fmt,
+        size_t* outNumBytes,
+        size_t* outRowBytes,
+        size_t* outNumRows);
+
+    // BC1-BC7, the formats DecompressBC reads
+    bool IsCompressed(DXGI_FORMAT fmt);
+
+    // What DecompressBC writes for a block compressed format: RGBA8 for BC1-BC5 and
+    // BC7 (BC4/BC5 fill red/green, SNORM stays signed, sRGB stays sRGB) and RGBA16F
+    // for BC6H. DXGI_FORMAT_UNKNOWN for anything else.
+    DXGI_FORMAT GetDecompressedFormat(DXGI_FORMAT fmt);
+
+    // Decodes a width x height image of 4x4 blocks (one DDSSubresource, or one depth
+    // slice of a volume) on the CPU. Blocks on the right and bottom edge are clipped.
+    // With threaded set the rows of blocks are split over JobSystem::Default().
+    HRESULT DecompressBC(
+        DXGI_FORMAT fmt,
+        size_t width,
+        size_t height,
+        const uint8_t* src,
+        size_t srcRowPitch,
+        uint8_t* dst,
+        size_t dstRowPitch,
+        bool threaded = true);
+
+    // Decodes an image of random blocks iterations times, returns MPixels/s
+    double BenchmarkDecompressBC(
+        DXGI_FORMAT fmt,
+        size_t width,
+        size_t height,
+        unsigned iterations,
+        bool threaded);
+
+    // "AVX", "SSSE3" or "Scalar", whichever BCDecoder.cpp runs on this CPU
+    const char* GetBCDecoderInstructionSet();
+
+    // Speed against quality of CompressBC
+    enum BC_COMPRESS_QUALITY
+    {
+        BC_COMPRESS_FAST   = 0, // bounding box endpoints, no refinement
+        BC_COMPRESS_NORMAL = 1, // principal axis endpoints, one least squares refinement
+        BC_COMPRESS_HIGH   = 2, // more refinements, BC1 also tries three color blocks
+    };
+
+    // BC1, BC3, BC4 and BC5 in their UNORM, sRGB and typeless forms, the formats
+    // CompressBC writes
+    bool CanCompressBC(DXGI_FORMAT fmt);
+
+    // Encodes a width x height RGBA8 image into 4x4 blocks, the inverse of DecompressBC:
+    // BC4 reads red, BC5 red and green. Blocks on the right and bottom edge repeat the
+    // last column and row. BC1 texels with alpha below 128 become transparent. With
+    // threaded set the rows of blocks are split over JobSystem::Default().
+    HRESULT CompressBC(
+        DXGI_FORMAT fmt,
+        size_t width,
+        size_t height,
+        const uint8_t* src,
+        size_t srcRowPitch,
+        uint8_t* dst,
+        size_t dstRowPitch,
+        BC_COMPRESS_QUALITY quality = BC_COMPRESS_NORMAL,
+        bool threaded = true);
+
+    // Encodes a synthetic image iterations times, returns MPixels/s. psnr, when given,
+    // receives the quality of the result in dB over the channels the format stores.
+    double BenchmarkCompressBC(
+        DXGI_FORMAT fmt,
+        size_t width,
+        size_t height,
+        unsigned iterations,
+        BC_COMPRESS_QUALITY quality,
+        bool threaded,
+        double* psnr);
+
+    // "SSE2" or "Scalar", whichever BCEncoder.cpp was built with
+    const char* GetBCEncoderInstructionSet();
+
+    // Validates the headers only, ddsData must hold at least info.headerSize bytes
+    HRESULT ParseDDSHeader(
+        const uint8_t* ddsData,
+        size_t ddsDataSize,
+        DDSTextureInfo& info);
+
+    // Validates the headers and fills one entry per subresource, ordered like
+    // D3D11CalcSubresource: all mips of slice 0, then slice 1 and so on. The
+    // entries point into ddsData, which must outlive them.
+    HRESULT ParseDDS(
+        const uint8_t* ddsData,
+        size_t ddsDataSize,
+        DDSTextureInfo& info,
+        std::vector<DDSSubresource>& subresources);
+
+    // Same table for a file of ddsDataSize bytes of which only the headers may be in
+    // memory. With a null ddsData only the offsets are filled in, which is enough to
+    // read single mips later on.
+    HRESULT GetDDSSubresources(
+        const DDSTextureInfo& info,
+        const uint8_t* ddsData,
+        size_t ddsDataSize,
+        std::vector<DDSSubresource>& subresources);
+
+    // Serializes a texture described like ParseDDS does into a DDS file image with
+    // a DX10 header. The subresources may be anywhere and have any row pitch, the
+    // file gets tightly packed rows.
+    HRESULT WriteDDS(
+        const DDSTextureInfo& info,
+        const std::vector<DDSSubresource>& subresources,
+        std::vector<uint8_t>& ddsData);
+
+    // Number of leading mips larger than maxsize in any dimension, 0 when
+    // maxsize is 0 or there is a single mip
+    size_t CountSkippedMips(const DDSTextureInfo& info, size_t maxsize);
+
+    inline size_t CalcDDSSubresource(size_t mipSlice, size_t arraySlice, size_t mipLevels)
+    {
+        return mipSlice + arraySlice * mipLevels;
+    }
+}
+
+#endif
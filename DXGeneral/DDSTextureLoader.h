@@ -19,16 +19,15 @@
 #include <d3d11_1.h>
 #include <stdint.h>
 
+#include "DDSParser.h"
+
 
 namespace DirectX
 {
-    enum DDS_ALPHA_MODE
+    enum DDS_LOADER_FLAGS
     {
-        DDS_ALPHA_MODE_UNKNOWN       = 0,
-        DDS_ALPHA_MODE_STRAIGHT      = 1,
-        DDS_ALPHA_MODE_PREMULTIPLIED = 2,
-        DDS_ALPHA_MODE_OPAQUE        = 3,
-        DDS_ALPHA_MODE_CUSTOM        = 4,
+        DDS_LOADER_DEFAULT = 0,
+        DDS_LOADER_GENERATE_MIPS = 0x1, // Filter a chain on the CPU for single level DEFAULT or IMMUTABLE textures
     };
 
     // Standard version
@@ -82,7 +81,8 @@ namespace DirectX
         _In_ bool forceSRGB,
         _Outptr_opt_ ID3D11Resource** texture,
         _Outptr_opt_ ID3D11ShaderResourceView** textureView,
-        _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr);
+        _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+        _In_ unsigned int loadFlags = DDS_LOADER_DEFAULT);
 
     HRESULT CreateDDSTextureFromFileEx(
         _In_ ID3D11Device* d3dDevice,
@@ -95,7 +95,8 @@ namespace DirectX
         _In_ bool forceSRGB,
         _Outptr_opt_ ID3D11Resource** texture,
         _Outptr_opt_ ID3D11ShaderResourceView** textureView,
-        _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr);
+        _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+        _In_ unsigned int loadFlags = DDS_LOADER_DEFAULT);
 
     // Extended version with optional auto-gen mipmap support
     HRESULT CreateDDSTextureFromMemoryEx(
@@ -111,7 +112,8 @@ namespace DirectX
         _In_ bool forceSRGB,
         _Outptr_opt_ ID3D11Resource** texture,
         _Outptr_opt_ ID3D11ShaderResourceView** textureView,
-        _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr);
+        _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+        _In_ unsigned int loadFlags = DDS_LOADER_DEFAULT);
 
     HRESULT CreateDDSTextureFromFileEx(
         _In_ ID3D11Device* d3dDevice,
@@ -125,5 +127,6 @@ namespace DirectX
         _In_ bool forceSRGB,
         _Outptr_opt_ ID3D11Resource** texture,
         _Outptr_opt_ ID3D11ShaderResourceView** textureView,
-        _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr);
+        _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+        _In_ unsigned int loadFlags = DDS_LOADER_DEFAULT);
 }
\ No newline at end of file
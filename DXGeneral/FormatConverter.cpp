@@ -0,0 +1,957 @@
+#include"FormatConverter.h"
+#include"TexelLayout.h"
+#include<algorithm>
+#include<chrono>
+#include<cfloat>
+#include<cmath>
+#include<cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include<emmintrin.h>
+#define CONVERT_SSE
+#if defined(__AVX2__) || defined(__F16C__)
+#include<immintrin.h>
+#define CONVERT_F16C
+#endif
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	//The layouts the converters read and write
+	TexelLayout GetLayout(DXGI_FORMAT format, bool* srgb)
+	{
+		TexelLayout layout = GetTexelLayout(format, srgb);
+		switch (layout)
+		{
+		case LAYOUT_RG8:
+		case LAYOUT_R8:
+		case LAYOUT_A8:
+		case LAYOUT_RGBA16:
+		case LAYOUT_R16F:
+		case LAYOUT_R32F:
+			return LAYOUT_NONE;
+
+		default:
+			return layout;
+		}
+	}
+
+	size_t TexelBytes(TexelLayout layout)
+	{
+		switch (layout)
+		{
+		case LAYOUT_RGBA16F:	return 8;
+		case LAYOUT_RGBA32F:	return 16;
+		case LAYOUT_RGB32F:		return 12;
+		case LAYOUT_NONE:		return 0;
+		default:				return 4;
+		}
+	}
+
+	bool HasAlpha(TexelLayout layout)
+	{
+		return layout == LAYOUT_RGBA8 || layout == LAYOUT_BGRA8 || layout == LAYOUT_RGB10A2
+			|| layout == LAYOUT_RGBA16F || layout == LAYOUT_RGBA32F;
+	}
+
+	bool IsFloat(TexelLayout layout)
+	{
+		return layout == LAYOUT_RGBA16F || layout == LAYOUT_RGBA32F || layout == LAYOUT_RGB32F
+			|| layout == LAYOUT_R11G11B10 || layout == LAYOUT_RGB9E5;
+	}
+
+	//Largest finite values of the narrow float formats
+	const float MAX_HALF = 65504.0f;
+	const float MAX_FLOAT11 = 65024.0f;
+	const float MAX_FLOAT10 = 64512.0f;
+	const float MAX_RGB9E5 = 65408.0f;
+	const float MIN_RGB9E5 = 1.0f / 65536.0f;
+
+	//Texels decoded to float per step, few enough to stay in L1
+	const size_t SPAN = 64;
+
+	inline uint32_t AsUint(float f)
+	{
+		uint32_t u;
+		memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+
+	inline float AsFloat(uint32_t u)
+	{
+		float f;
+		memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+
+	inline uint32_t LoadUint(const uint8_t* p)
+	{
+		uint32_t u;
+		memcpy(&u, p, sizeof(u));
+		return u;
+	}
+
+	//NaN becomes lo, like _mm_max_ps
+	inline float Clamp(float v, float lo, float hi)
+	{
+		return std::min(hi, std::max(lo, v));
+	}
+
+	//A float in [0, largest finite value] to 5 exponent bits (bias 15) and
+	//mantissaBits of mantissa, rounded to nearest even
+	inline uint32_t PackSmallFloat(float f, int mantissaBits)
+	{
+		uint32_t bits = AsUint(f);
+		if (bits < (113u << 23))
+		{
+			//Denormal: adding a float whose last mantissa bit is worth one
+			//denormal step does the shift and the rounding
+			float magic = AsFloat(uint32_t(127 - 15 + 23 - mantissaBits + 1) << 23);
+			return AsUint(f + magic) - AsUint(magic);
+		}
+
+		int shift = 23 - mantissaBits;
+		uint32_t odd = (bits >> shift) & 1;
+		return (bits - (112u << 23) + (1u << (shift - 1)) - 1 + odd) >> shift;
+	}
+
+	inline float UnpackSmallFloat(uint32_t h, int mantissaBits)
+	{
+		uint32_t o = h << (23 - mantissaBits);
+		uint32_t exponent = o & (0x1fu << 23);
+		o += 112u << 23;
+
+		//Inf and NaN
+		if (exponent == (0x1fu << 23))
+			o += 112u << 23;
+		//Zero and denormals
+		else if (!exponent)
+			return AsFloat(o + (1u << 23)) - AsFloat(113u << 23);
+
+		return AsFloat(o);
+	}
+
+	//Like the SIMD paths: out of range values saturate and NaN becomes 0
+	inline uint16_t SaturateToHalf(float f)
+	{
+		return f != f ? 0 : FloatToHalf(Clamp(f, -MAX_HALF, MAX_HALF));
+	}
+
+	inline uint32_t PackRGB9E5(float r, float g, float b)
+	{
+		r = Clamp(r, 0.0f, MAX_RGB9E5);
+		g = Clamp(g, 0.0f, MAX_RGB9E5);
+		b = Clamp(b, 0.0f, MAX_RGB9E5);
+
+		//Exponent of the brightest channel once rounded to 9 bits, so it can
+		//not round up to 512
+		float brightest = std::max(std::max(r, g), std::max(b, MIN_RGB9E5));
+		uint32_t exponent = (AsUint(brightest) + 0x4000) >> 23;
+		float scale = AsFloat(0x83000000u - (exponent << 23));
+
+		uint32_t rm = uint32_t(r*scale + 0.5f);
+		uint32_t gm = uint32_t(g*scale + 0.5f);
+		uint32_t bm = uint32_t(b*scale + 0.5f);
+		return rm | (gm << 9) | (bm << 18) | ((exponent - 111) << 27);
+	}
+
+	const float* SRGBToLinearTable()
+	{
+		static float table[256];
+		static bool built = [&]()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				float c = i / 255.0f;
+				table[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return true;
+		}();
+		(void)built;
+
+		return table;
+	}
+
+	//Linear values half way between consecutive sRGB codes, and for each of
+	//SRGB_BUCKETS even steps over [0, 1] the code at its lower end
+	const int SRGB_BUCKETS = 4096;
+
+	struct SRGBEncodeTables
+	{
+		float Thresholds[256];
+		uint8_t Start[SRGB_BUCKETS + 1];
+	};
+
+	const SRGBEncodeTables& GetSRGBEncodeTables()
+	{
+		static SRGBEncodeTables tables = []()
+		{
+			SRGBEncodeTables t;
+			for (int i = 0; i < 255; ++i)
+			{
+				double c = (i + 0.5) / 255.0;
+				t.Thresholds[i] = static_cast<float>((c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+			}
+			t.Thresholds[255] = FLT_MAX;
+
+			int code = 0;
+			for (int i = 0; i <= SRGB_BUCKETS; ++i)
+			{
+				while (t.Thresholds[code] <= static_cast<float>(i) / SRGB_BUCKETS)
+					++code;
+				t.Start[i] = static_cast<uint8_t>(code);
+			}
+			return t;
+		}();
+
+		return tables;
+	}
+
+	//Nearest code in sRGB space, not in linear space. The bucket gives the
+	//code at most a few thresholds short, near black where codes are dense.
+	inline uint8_t LinearToSRGB8(const SRGBEncodeTables& tables, float c)
+	{
+		c = Clamp(c, 0.0f, 1.0f);
+		int code = tables.Start[static_cast<int>(c*SRGB_BUCKETS)];
+		while (tables.Thresholds[code] <= c)
+			++code;
+		return static_cast<uint8_t>(code);
+	}
+
+	inline uint8_t ToUnorm8(float v)
+	{
+		return static_cast<uint8_t>(Clamp(v, 0.0f, 1.0f)*255.0f + 0.5f);
+	}
+
+	void DecodeTexel(TexelLayout layout, bool srgb, const uint8_t* src, float* dst)
+	{
+		switch (layout)
+		{
+		case LAYOUT_RGBA8:
+		case LAYOUT_BGRA8:
+		case LAYOUT_BGRX8:
+		{
+			const float* toLinear = SRGBToLinearTable();
+			const float unorm = 1.0f / 255.0f;
+			bool bgr = layout != LAYOUT_RGBA8;
+			uint8_t r = bgr ? src[2] : src[0];
+			uint8_t b = bgr ? src[0] : src[2];
+			dst[0] = srgb ? toLinear[r] : r*unorm;
+			dst[1] = srgb ? toLinear[src[1]] : src[1] * unorm;
+			dst[2] = srgb ? toLinear[b] : b*unorm;
+			dst[3] = (layout == LAYOUT_BGRX8) ? 1.0f : src[3] * unorm;
+			break;
+		}
+
+		case LAYOUT_RGB10A2:
+		{
+			uint32_t p = LoadUint(src);
+			dst[0] = float(p & 0x3ff) * (1.0f / 1023.0f);
+			dst[1] = float((p >> 10) & 0x3ff) * (1.0f / 1023.0f);
+			dst[2] = float((p >> 20) & 0x3ff) * (1.0f / 1023.0f);
+			dst[3] = float(p >> 30) * (1.0f / 3.0f);
+			break;
+		}
+
+		case LAYOUT_RGBA16F:
+		{
+			uint16_t h[4];
+			memcpy(h, src, sizeof(h));
+			for (int c = 0; c < 4; ++c)
+				dst[c] = HalfToFloat(h[c]);
+			break;
+		}
+
+		case LAYOUT_RGBA32F:
+			memcpy(dst, src, 16);
+			break;
+
+		case LAYOUT_RGB32F:
+			memcpy(dst, src, 12);
+			dst[3] = 1.0f;
+			break;
+
+		case LAYOUT_R11G11B10:
+		{
+			uint32_t p = LoadUint(src);
+			dst[0] = UnpackSmallFloat(p & 0x7ff, 6);
+			dst[1] = UnpackSmallFloat((p >> 11) & 0x7ff, 6);
+			dst[2] = UnpackSmallFloat(p >> 22, 5);
+			dst[3] = 1.0f;
+			break;
+		}
+
+		case LAYOUT_RGB9E5:
+		{
+			uint32_t p = LoadUint(src);
+			float scale = AsFloat(((p >> 27) + 103) << 23);
+			dst[0] = float(p & 0x1ff) * scale;
+			dst[1] = float((p >> 9) & 0x1ff) * scale;
+			dst[2] = float((p >> 18) & 0x1ff) * scale;
+			dst[3] = 1.0f;
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	void EncodeTexel(TexelLayout layout, bool srgb, const float* src, uint8_t* dst)
+	{
+		switch (layout)
+		{
+		case LAYOUT_RGBA8:
+		case LAYOUT_BGRA8:
+		case LAYOUT_BGRX8:
+		{
+			bool bgr = layout != LAYOUT_RGBA8;
+			if (srgb)
+			{
+				const SRGBEncodeTables& tables = GetSRGBEncodeTables();
+				dst[bgr ? 2 : 0] = LinearToSRGB8(tables, src[0]);
+				dst[1] = LinearToSRGB8(tables, src[1]);
+				dst[bgr ? 0 : 2] = LinearToSRGB8(tables, src[2]);
+			}
+			else
+			{
+				dst[bgr ? 2 : 0] = ToUnorm8(src[0]);
+				dst[1] = ToUnorm8(src[1]);
+				dst[bgr ? 0 : 2] = ToUnorm8(src[2]);
+			}
+			dst[3] = (layout == LAYOUT_BGRX8) ? 255 : ToUnorm8(src[3]);
+			break;
+		}
+
+		case LAYOUT_RGB10A2:
+		{
+			uint32_t r = uint32_t(Clamp(src[0], 0.0f, 1.0f)*1023.0f + 0.5f);
+			uint32_t g = uint32_t(Clamp(src[1], 0.0f, 1.0f)*1023.0f + 0.5f);
+			uint32_t b = uint32_t(Clamp(src[2], 0.0f, 1.0f)*1023.0f + 0.5f);
+			uint32_t a = uint32_t(Clamp(src[3], 0.0f, 1.0f)*3.0f + 0.5f);
+			uint32_t p = r | (g << 10) | (b << 20) | (a << 30);
+			memcpy(dst, &p, 4);
+			break;
+		}
+
+		case LAYOUT_RGBA16F:
+		{
+			uint16_t h[4];
+			for (int c = 0; c < 4; ++c)
+				h[c] = SaturateToHalf(src[c]);
+			memcpy(dst, h, sizeof(h));
+			break;
+		}
+
+		case LAYOUT_RGBA32F:
+			memcpy(dst, src, 16);
+			break;
+
+		case LAYOUT_RGB32F:
+			memcpy(dst, src, 12);
+			break;
+
+		case LAYOUT_R11G11B10:
+		{
+			uint32_t p = PackSmallFloat(Clamp(src[0], 0.0f, MAX_FLOAT11), 6)
+				| (PackSmallFloat(Clamp(src[1], 0.0f, MAX_FLOAT11), 6) << 11)
+				| (PackSmallFloat(Clamp(src[2], 0.0f, MAX_FLOAT10), 5) << 22);
+			memcpy(dst, &p, 4);
+			break;
+		}
+
+		case LAYOUT_RGB9E5:
+		{
+			uint32_t p = PackRGB9E5(src[0], src[1], src[2]);
+			memcpy(dst, &p, 4);
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+#if defined(CONVERT_SSE)
+	inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	inline __m128 Clamp(__m128 v, __m128 lo, __m128 hi)
+	{
+		return _mm_min_ps(_mm_max_ps(v, lo), hi);
+	}
+
+	//PackSmallFloat() on four lanes
+	template<int MANTISSA>
+	inline __m128i PackSmallFloat(__m128 v)
+	{
+		const __m128i bits = _mm_castps_si128(v);
+		const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((127 - 15 + 23 - MANTISSA + 1) << 23));
+		__m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(v, magic)), _mm_castps_si128(magic));
+
+		__m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 23 - MANTISSA), _mm_set1_epi32(1));
+		__m128i normal = _mm_add_epi32(bits, _mm_set1_epi32((1 << (22 - MANTISSA)) - 1 - (112 << 23)));
+		normal = _mm_srli_epi32(_mm_add_epi32(normal, odd), 23 - MANTISSA);
+
+		__m128i isNormal = _mm_cmpgt_epi32(bits, _mm_set1_epi32((113 << 23) - 1));
+		return Select(isNormal, normal, denormal);
+	}
+
+	//UnpackSmallFloat() on four lanes
+	template<int MANTISSA>
+	inline __m128 UnpackSmallFloat(__m128i h)
+	{
+		const __m128i exponentMask = _mm_set1_epi32(0x1f << 23);
+		__m128i o = _mm_slli_epi32(h, 23 - MANTISSA);
+		__m128i exponent = _mm_and_si128(o, exponentMask);
+		o = _mm_add_epi32(o, _mm_set1_epi32(112 << 23));
+		o = _mm_add_epi32(o, _mm_and_si128(_mm_cmpeq_epi32(exponent, exponentMask), _mm_set1_epi32(112 << 23)));
+
+		__m128 denormal = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(o, _mm_set1_epi32(1 << 23))),
+			_mm_castsi128_ps(_mm_set1_epi32(113 << 23)));
+		__m128i isDenormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+		return _mm_castsi128_ps(Select(isDenormal, _mm_castps_si128(denormal), o));
+	}
+
+	//Texels of one group of four as RGBA rows, or their channels as rows
+	inline void Load4(const float* src, __m128& r, __m128& g, __m128& b, __m128& a)
+	{
+		r = _mm_loadu_ps(src);
+		g = _mm_loadu_ps(src + 4);
+		b = _mm_loadu_ps(src + 8);
+		a = _mm_loadu_ps(src + 12);
+		_MM_TRANSPOSE4_PS(r, g, b, a);
+	}
+
+	inline void Store4(float* dst, __m128 r, __m128 g, __m128 b, __m128 a)
+	{
+		_MM_TRANSPOSE4_PS(r, g, b, a);
+		_mm_storeu_ps(dst, r);
+		_mm_storeu_ps(dst + 4, g);
+		_mm_storeu_ps(dst + 8, b);
+		_mm_storeu_ps(dst + 12, a);
+	}
+
+	//Decodes whole groups of texels, returns how many were done
+	size_t DecodeSSE(TexelLayout layout, bool srgb, const uint8_t* src, size_t count, float* dst)
+	{
+		const size_t groups = count / 4;
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		switch (layout)
+		{
+		case LAYOUT_RGBA8:
+		case LAYOUT_BGRA8:
+		case LAYOUT_BGRX8:
+		{
+			//Table lookups do not vectorize
+			if (srgb)
+				return 0;
+
+			const __m128 unorm = _mm_set1_ps(1.0f / 255.0f);
+			const __m128 rgbMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+			const __m128 alphaOne = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+			for (size_t i = 0; i < groups; ++i)
+			{
+				__m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 16));
+				__m128i lo = _mm_unpacklo_epi8(t, zero);
+				__m128i hi = _mm_unpackhi_epi8(t, zero);
+				__m128i texels[4] = { _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+					_mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero) };
+
+				for (int k = 0; k < 4; ++k)
+				{
+					__m128 v = _mm_mul_ps(_mm_cvtepi32_ps(texels[k]), unorm);
+					if (layout != LAYOUT_RGBA8)
+						v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+					if (layout == LAYOUT_BGRX8)
+						v = _mm_or_ps(_mm_and_ps(v, rgbMask), alphaOne);
+					_mm_storeu_ps(dst + (i * 4 + k) * 4, v);
+				}
+			}
+			return groups * 4;
+		}
+
+		case LAYOUT_RGB10A2:
+		{
+			const __m128i mask = _mm_set1_epi32(0x3ff);
+			const __m128 unorm = _mm_set1_ps(1.0f / 1023.0f);
+			for (size_t i = 0; i < groups; ++i)
+			{
+				__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 16));
+				__m128 r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(p, mask)), unorm);
+				__m128 g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 10), mask)), unorm);
+				__m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 20), mask)), unorm);
+				__m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(p, 30)), _mm_set1_ps(1.0f / 3.0f));
+				Store4(dst + i * 16, r, g, b, a);
+			}
+			return groups * 4;
+		}
+
+		case LAYOUT_RGBA16F:
+		{
+#if defined(CONVERT_F16C)
+			for (size_t i = 0; i < count; ++i)
+				_mm_storeu_ps(dst + i * 4, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i * 8))));
+			return count;
+#else
+			const __m128i signMask = _mm_set1_epi32(0x8000);
+			for (size_t i = 0; i < count / 2; ++i)
+			{
+				__m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 16));
+				__m128i halves[2] = { _mm_unpacklo_epi16(t, zero), _mm_unpackhi_epi16(t, zero) };
+				for (int k = 0; k < 2; ++k)
+				{
+					__m128i sign = _mm_slli_epi32(_mm_and_si128(halves[k], signMask), 16);
+					__m128 v = UnpackSmallFloat<10>(_mm_andnot_si128(signMask, halves[k]));
+					_mm_storeu_ps(dst + (i * 2 + k) * 4, _mm_or_ps(v, _mm_castsi128_ps(sign)));
+				}
+			}
+			return count / 2 * 2;
+#endif
+		}
+
+		case LAYOUT_RGBA32F:
+			memcpy(dst, src, count * 16);
+			return count;
+
+		case LAYOUT_R11G11B10:
+		{
+			const __m128i mask = _mm_set1_epi32(0x7ff);
+			for (size_t i = 0; i < groups; ++i)
+			{
+				__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 16));
+				__m128 r = UnpackSmallFloat<6>(_mm_and_si128(p, mask));
+				__m128 g = UnpackSmallFloat<6>(_mm_and_si128(_mm_srli_epi32(p, 11), mask));
+				__m128 b = UnpackSmallFloat<5>(_mm_srli_epi32(p, 22));
+				Store4(dst + i * 16, r, g, b, one);
+			}
+			return groups * 4;
+		}
+
+		case LAYOUT_RGB9E5:
+		{
+			const __m128i mask = _mm_set1_epi32(0x1ff);
+			for (size_t i = 0; i < groups; ++i)
+			{
+				__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 16));
+				__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_srli_epi32(p, 27), _mm_set1_epi32(103)), 23));
+				__m128 r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(p, mask)), scale);
+				__m128 g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 9), mask)), scale);
+				__m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 18), mask)), scale);
+				Store4(dst + i * 16, r, g, b, one);
+			}
+			return groups * 4;
+		}
+
+		default:
+			return 0;
+		}
+	}
+
+	//Encodes whole groups of texels, returns how many were done
+	size_t EncodeSSE(TexelLayout layout, bool srgb, const float* src, size_t count, uint8_t* dst)
+	{
+		const size_t groups = count / 4;
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+
+		switch (layout)
+		{
+		case LAYOUT_RGBA8:
+		case LAYOUT_BGRA8:
+		case LAYOUT_BGRX8:
+		{
+			if (srgb)
+				return 0;
+
+			const __m128 scale = _mm_set1_ps(255.0f);
+			const __m128 rgbMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+			const __m128 alphaOne = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+			for (size_t i = 0; i < groups; ++i)
+			{
+				__m128i texels[4];
+				for (int k = 0; k < 4; ++k)
+				{
+					__m128 v = _mm_loadu_ps(src + (i * 4 + k) * 4);
+					if (layout != LAYOUT_RGBA8)
+						v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+					if (layout == LAYOUT_BGRX8)
+						v = _mm_or_ps(_mm_and_ps(v, rgbMask), alphaOne);
+					texels[k] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(Clamp(v, zero, one), scale), half));
+				}
+
+				__m128i packed = _mm_packus_epi16(_mm_packs_epi32(texels[0], texels[1]), _mm_packs_epi32(texels[2], texels[3]));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 16), packed);
+			}
+			return groups * 4;
+		}
+
+		case LAYOUT_RGB10A2:
+		{
+			const __m128 scale = _mm_set1_ps(1023.0f);
+			for (size_t i = 0; i < groups; ++i)
+			{
+				__m128 r, g, b, a;
+				Load4(src + i * 16, r, g, b, a);
+				__m128i p = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(Clamp(r, zero, one), scale), half));
+				p = _mm_or_si128(p, _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(Clamp(g, zero, one), scale), half)), 10));
+				p = _mm_or_si128(p, _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(Clamp(b, zero, one), scale), half)), 20));
+				p = _mm_or_si128(p, _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(Clamp(a, zero, one), _mm_set1_ps(3.0f)), half)), 30));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 16), p);
+			}
+			return groups * 4;
+		}
+
+		case LAYOUT_RGBA16F:
+		{
+			const __m128 limit = _mm_set1_ps(MAX_HALF);
+			const __m128 negativeLimit = _mm_set1_ps(-MAX_HALF);
+#if defined(CONVERT_F16C)
+			for (size_t i = 0; i < count; ++i)
+			{
+				__m128 v = _mm_loadu_ps(src + i * 4);
+				v = Clamp(_mm_and_ps(v, _mm_cmpeq_ps(v, v)), negativeLimit, limit);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i * 8), _mm_cvtps_ph(v, 0));
+			}
+			return count;
+#else
+			const __m128i signMask = _mm_set1_epi32(0x80000000);
+			const __m128i bias = _mm_set1_epi32(0x8000);
+			for (size_t i = 0; i < count / 2; ++i)
+			{
+				__m128i halves[2];
+				for (int k = 0; k < 2; ++k)
+				{
+					__m128 v = _mm_loadu_ps(src + (i * 2 + k) * 4);
+					v = Clamp(_mm_and_ps(v, _mm_cmpeq_ps(v, v)), negativeLimit, limit);
+
+					__m128i sign = _mm_and_si128(_mm_castps_si128(v), signMask);
+					__m128 magnitude = _mm_castsi128_ps(_mm_andnot_si128(signMask, _mm_castps_si128(v)));
+					halves[k] = _mm_or_si128(PackSmallFloat<10>(magnitude), _mm_srli_epi32(sign, 16));
+				}
+
+				//packs saturates signed, so move the halves into its range and back
+				__m128i packed = _mm_packs_epi32(_mm_sub_epi32(halves[0], bias), _mm_sub_epi32(halves[1], bias));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 16), _mm_xor_si128(packed, _mm_set1_epi16(short(0x8000))));
+			}
+			return count / 2 * 2;
+#endif
+		}
+
+		case LAYOUT_RGBA32F:
+			memcpy(dst, src, count * 16);
+			return count;
+
+		case LAYOUT_R11G11B10:
+		{
+			const __m128 limit11 = _mm_set1_ps(MAX_FLOAT11);
+			const __m128 limit10 = _mm_set1_ps(MAX_FLOAT10);
+			for (size_t i = 0; i < groups; ++i)
+			{
+				__m128 r, g, b, a;
+				Load4(src + i * 16, r, g, b, a);
+				__m128i p = PackSmallFloat<6>(Clamp(r, zero, limit11));
+				p = _mm_or_si128(p, _mm_slli_epi32(PackSmallFloat<6>(Clamp(g, zero, limit11)), 11));
+				p = _mm_or_si128(p, _mm_slli_epi32(PackSmallFloat<5>(Clamp(b, zero, limit10)), 22));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 16), p);
+			}
+			return groups * 4;
+		}
+
+		case LAYOUT_RGB9E5:
+		{
+			const __m128 limit = _mm_set1_ps(MAX_RGB9E5);
+			for (size_t i = 0; i < groups; ++i)
+			{
+				__m128 r, g, b, a;
+				Load4(src + i * 16, r, g, b, a);
+				r = Clamp(r, zero, limit);
+				g = Clamp(g, zero, limit);
+				b = Clamp(b, zero, limit);
+
+				__m128 brightest = _mm_max_ps(_mm_max_ps(r, g), _mm_max_ps(b, _mm_set1_ps(MIN_RGB9E5)));
+				__m128i exponent = _mm_srli_epi32(_mm_add_epi32(_mm_castps_si128(brightest), _mm_set1_epi32(0x4000)), 23);
+				__m128 scale = _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(int(0x83000000)), _mm_slli_epi32(exponent, 23)));
+
+				__m128i p = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, scale), half));
+				p = _mm_or_si128(p, _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, scale), half)), 9));
+				p = _mm_or_si128(p, _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half)), 18));
+				p = _mm_or_si128(p, _mm_slli_epi32(_mm_sub_epi32(exponent, _mm_set1_epi32(111)), 27));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 16), p);
+			}
+			return groups * 4;
+		}
+
+		default:
+			return 0;
+		}
+	}
+#endif
+
+	void DecodeSpan(TexelLayout layout, bool srgb, const uint8_t* src, size_t count, float* dst)
+	{
+		size_t x = 0;
+#if defined(CONVERT_SSE)
+		x = DecodeSSE(layout, srgb, src, count, dst);
+#endif
+		const size_t texelBytes = TexelBytes(layout);
+		for (; x < count; ++x)
+			DecodeTexel(layout, srgb, src + x*texelBytes, dst + x * 4);
+	}
+
+	void EncodeSpan(TexelLayout layout, bool srgb, const float* src, size_t count, uint8_t* dst)
+	{
+		size_t x = 0;
+#if defined(CONVERT_SSE)
+		x = EncodeSSE(layout, srgb, src, count, dst);
+#endif
+		const size_t texelBytes = TexelBytes(layout);
+		for (; x < count; ++x)
+			EncodeTexel(layout, srgb, src + x * 4, dst + x*texelBytes);
+	}
+}
+
+FormatConverter::FormatConverter(JobSystem& jobs)
+	:m_jobs(jobs)
+{
+}
+
+bool FormatConverter::IsSupported(DXGI_FORMAT format)
+{
+	bool srgb;
+	return GetLayout(format, &srgb) != LAYOUT_NONE;
+}
+
+bool FormatConverter::ConvertRow(DXGI_FORMAT srcFormat, const uint8_t* src,
+	DXGI_FORMAT dstFormat, uint8_t* dst, size_t width)
+{
+	bool srcSRGB, dstSRGB;
+	const TexelLayout srcLayout = GetLayout(srcFormat, &srcSRGB);
+	const TexelLayout dstLayout = GetLayout(dstFormat, &dstSRGB);
+	if (srcLayout == LAYOUT_NONE || dstLayout == LAYOUT_NONE)
+		return false;
+
+	if (srcFormat == dstFormat)
+	{
+		memcpy(dst, src, width*TexelBytes(srcLayout));
+		return true;
+	}
+
+	const size_t srcBytes = TexelBytes(srcLayout);
+	const size_t dstBytes = TexelBytes(dstLayout);
+
+	float texels[SPAN * 4];
+	for (size_t x = 0; x < width; x += SPAN)
+	{
+		size_t count = std::min(SPAN, width - x);
+		DecodeSpan(srcLayout, srcSRGB, src + x*srcBytes, count, texels);
+		EncodeSpan(dstLayout, dstSRGB, texels, count, dst + x*dstBytes);
+	}
+	return true;
+}
+
+bool FormatConverter::Convert(const DDSTextureInfo& info,
+	const std::vector<DDSSubresource>& subresources,
+	DXGI_FORMAT format,
+	DDSTextureInfo& outInfo,
+	std::vector<DDSSubresource>& outSubresources,
+	std::vector<uint8_t>& outData)
+{
+	outSubresources.clear();
+	outData.clear();
+
+	if (!IsSupported(info.format) || !IsSupported(format)
+		|| subresources.size() != info.mipLevels*info.arraySize)
+		return false;
+
+	bool srgb;
+	const size_t texelBytes = TexelBytes(GetLayout(format, &srgb));
+
+	//Same order as the source, which is already that of a DDS body
+	outSubresources.resize(subresources.size());
+	size_t offset = 0;
+	for (size_t i = 0; i < subresources.size(); ++i)
+	{
+		DDSSubresource& sub = outSubresources[i];
+		sub = subresources[i];
+		sub.pData = 0;
+		sub.offset = offset;
+		sub.rowPitch = sub.width*texelBytes;
+		sub.slicePitch = sub.rowPitch*sub.height;
+		offset += sub.slicePitch*sub.depth;
+	}
+
+	outData.resize(offset);
+	std::vector<Image> images(subresources.size());
+	for (size_t i = 0; i < subresources.size(); ++i)
+	{
+		DDSSubresource& sub = outSubresources[i];
+		sub.pData = &outData[sub.offset];
+
+		//Depth slices follow each other, so a volume level is one tall image
+		Image& image = images[i];
+		image.Src = subresources[i].pData;
+		image.SrcPitch = subresources[i].rowPitch;
+		image.Dst = &outData[sub.offset];
+		image.DstPitch = sub.rowPitch;
+		image.Width = sub.width;
+		image.Rows = sub.height*sub.depth;
+	}
+
+	ConvertImages(images, info.format, format, true);
+
+	outInfo = info;
+	outInfo.format = format;
+	return true;
+}
+
+void FormatConverter::ConvertImages(const std::vector<Image>& images, DXGI_FORMAT srcFormat, DXGI_FORMAT dstFormat, bool threaded)
+{
+	//One item per row of any image, so long mip chains split as well as
+	//single large levels
+	std::vector<size_t> firstRow(images.size() + 1, 0);
+	size_t widest = 1;
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		firstRow[i + 1] = firstRow[i] + images[i].Rows;
+		widest = std::max(widest, images[i].Width);
+	}
+
+	auto body = [&](UINT begin, UINT end, UINT)
+	{
+		size_t i = std::upper_bound(firstRow.begin(), firstRow.end(), size_t(begin)) - firstRow.begin() - 1;
+		for (UINT row = begin; row < end; ++row)
+		{
+			while (row >= firstRow[i + 1])
+				++i;
+
+			const Image& image = images[i];
+			size_t y = row - firstRow[i];
+			ConvertRow(srcFormat, image.Src + y*image.SrcPitch, dstFormat, image.Dst + y*image.DstPitch, image.Width);
+		}
+	};
+
+	const UINT rows = static_cast<UINT>(firstRow.back());
+	if (threaded)
+		m_jobs.ParallelFor(rows, static_cast<UINT>(std::max<size_t>(1, 16384 / widest)), body);
+	else
+		body(0, rows, 0);
+}
+
+double FormatConverter::Benchmark(DXGI_FORMAT srcFormat, DXGI_FORMAT dstFormat,
+	size_t width, size_t height, unsigned iterations, bool threaded,
+	double* roundTripError)
+{
+	bool srgb;
+	const TexelLayout srcLayout = GetLayout(srcFormat, &srgb);
+	const TexelLayout dstLayout = GetLayout(dstFormat, &srgb);
+	if (srcLayout == LAYOUT_NONE || dstLayout == LAYOUT_NONE || !width || !height || !iterations)
+		return 0.0;
+
+	const size_t srcBytes = TexelBytes(srcLayout);
+	const size_t dstBytes = TexelBytes(dstLayout);
+	std::vector<uint8_t> source(width*height*srcBytes);
+	std::vector<uint8_t> converted(width*height*dstBytes);
+
+	//Gradients with noise, scaled over 2^-8 to 2^10 for float sources
+	std::vector<float> row(width * 4);
+	uint32_t seed = 12345;
+	for (size_t y = 0; y < height; ++y)
+	{
+		for (size_t x = 0; x < width; ++x)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			float noise = (seed >> 8) * (1.0f / 16777216.0f);
+			float u = float(x) / width;
+			float v = float(y) / height;
+			float intensity = IsFloat(srcLayout) ? exp2f(-8.0f + 18.0f*noise) : 1.0f;
+
+			float* t = &row[x * 4];
+			t[0] = std::min(u*0.75f + noise*0.25f, 1.0f) * intensity;
+			t[1] = std::min(v*0.75f + noise*0.25f, 1.0f) * intensity;
+			t[2] = std::min((1.0f - u)*0.75f + noise*0.25f, 1.0f) * intensity;
+			t[3] = noise;
+		}
+		ConvertRow(DXGI_FORMAT_R32G32B32A32_FLOAT, reinterpret_cast<const uint8_t*>(row.data()),
+			srcFormat, &source[y*width*srcBytes], width);
+	}
+
+	std::vector<Image> images(1);
+	images[0].Src = source.data();
+	images[0].SrcPitch = width*srcBytes;
+	images[0].Dst = converted.data();
+	images[0].DstPitch = width*dstBytes;
+	images[0].Width = width;
+	images[0].Rows = height;
+
+	if (roundTripError)
+	{
+		std::vector<uint8_t> back(source.size());
+		std::vector<Image> backImages(1);
+		backImages[0].Src = converted.data();
+		backImages[0].SrcPitch = width*dstBytes;
+		backImages[0].Dst = back.data();
+		backImages[0].DstPitch = width*srcBytes;
+		backImages[0].Width = width;
+		backImages[0].Rows = height;
+
+		ConvertImages(images, srcFormat, dstFormat, true);
+		ConvertImages(backImages, dstFormat, srcFormat, true);
+
+		//Over the channels both formats store
+		const int channels = (HasAlpha(srcLayout) && HasAlpha(dstLayout)) ? 4 : 3;
+		std::vector<float> before(width * 4);
+		std::vector<float> after(width * 4);
+		double worst = 0.0;
+		for (size_t y = 0; y < height; ++y)
+		{
+			ConvertRow(srcFormat, &source[y*width*srcBytes], DXGI_FORMAT_R32G32B32A32_FLOAT,
+				reinterpret_cast<uint8_t*>(before.data()), width);
+			ConvertRow(srcFormat, &back[y*width*srcBytes], DXGI_FORMAT_R32G32B32A32_FLOAT,
+				reinterpret_cast<uint8_t*>(after.data()), width);
+
+			for (size_t x = 0; x < width; ++x)
+			{
+				const float* a = &before[x * 4];
+				const float* b = &after[x * 4];
+				float brightest = 1.0f / 1024.0f;
+				float error = 0.0f;
+				for (int c = 0; c < channels; ++c)
+				{
+					brightest = std::max(brightest, fabsf(a[c]));
+					error = std::max(error, fabsf(a[c] - b[c]));
+				}
+				worst = std::max(worst, double(error / brightest));
+			}
+		}
+		*roundTripError = worst;
+	}
+
+	//Warm up, so page faults on the output are not timed
+	ConvertImages(images, srcFormat, dstFormat, threaded);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned i = 0; i < iterations; ++i)
+		ConvertImages(images, srcFormat, dstFormat, threaded);
+	std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+
+	return double(width*height*(srcBytes + dstBytes))*iterations / seconds.count() / 1e9;
+}
+
+const char* FormatConverter::GetInstructionSet()
+{
+#if defined(CONVERT_F16C)
+	return "F16C";
+#elif defined(CONVERT_SSE)
+	return "SSE2";
+#else
+	return "Scalar";
+#endif
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+//Repacks textures between uncompressed color formats on the CPU
+//
+//The DDS loader passes formats through as it finds them. HDR sources
+//usually arrive as RGBA32F or RGBA16F, while R11G11B10 and RGB9E5 hold the
+//same colors in a half or a quarter of the bytes. Convert() decodes runs of
+//texels to float RGBA and encodes them in the target format, with the rows
+//of every subresource spread over the job system. Texels go through SSE2
+//four at a time; FP16 uses F16C when the build targets AVX2.
+//
+//The floats in between are what a shader would sample: sRGB formats decode
+//to linear and encode from it, formats without alpha read 1. Narrower
+//targets clamp out of range values to the nearest representable one and
+//turn NaN into 0, so no conversion ever produces Inf or NaN.
+
+#ifndef _FORMATCONVERTER_H_
+#define _FORMATCONVERTER_H_
+
+#include"DDSParser.h"
+#include"JobSystem.h"
+
+class FormatConverter
+{
+public:
+	FormatConverter(JobSystem& jobs = JobSystem::Default());
+
+	//RGBA8 and BGRA8/BGRX8 (UNORM and sRGB), R10G10B10A2_UNORM, RGBA16F,
+	//RGBA32F, RGB32F, R11G11B10_FLOAT and R9G9B9E5_SHAREDEXP
+	static bool IsSupported(DXGI_FORMAT format);
+
+	//Every subresource of a 1D, 2D, 3D or cube texture into format.
+	//outSubresources point into outData, laid out like a DDS file body.
+	bool Convert(const DirectX::DDSTextureInfo& info,
+		const std::vector<DirectX::DDSSubresource>& subresources,
+		DXGI_FORMAT format,
+		DirectX::DDSTextureInfo& outInfo,
+		std::vector<DirectX::DDSSubresource>& outSubresources,
+		std::vector<uint8_t>& outData);
+
+	//One run of width texels on the calling thread
+	static bool ConvertRow(DXGI_FORMAT srcFormat, const uint8_t* src,
+		DXGI_FORMAT dstFormat, uint8_t* dst, size_t width);
+
+	//Converts a synthetic width x height image iterations times, returns GB/s
+	//of texels read plus written. roundTripError, when given, receives the
+	//largest error after converting to dstFormat and back, relative to the
+	//brightest channel of the texel.
+	double Benchmark(DXGI_FORMAT srcFormat, DXGI_FORMAT dstFormat,
+		size_t width, size_t height, unsigned iterations, bool threaded,
+		double* roundTripError);
+
+	//"F16C", "SSE2" or "Scalar", whichever this file was built with
+	static const char* GetInstructionSet();
+
+private:
+	//Rows of one subresource, or of a benchmark image
+	struct Image
+	{
+		const uint8_t* Src;
+		size_t SrcPitch;
+		uint8_t* Dst;
+		size_t DstPitch;
+		size_t Width;
+		size_t Rows;
+	};
+
+	void ConvertImages(const std::vector<Image>& images, DXGI_FORMAT srcFormat, DXGI_FORMAT dstFormat, bool threaded);
+
+private:
+	JobSystem& m_jobs;
+};
+
+#endif
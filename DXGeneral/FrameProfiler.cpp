@@ -0,0 +1,305 @@
+#include"FrameProfiler.h"
+#include<algorithm>
+#include<cmath>
+#include<cstdio>
+#include<cstring>
+
+namespace
+{
+	std::atomic<UINT64> g_nextProfilerId(1);
+
+	//The ring of the calling thread in the profiler used last, so a Scope
+	//only takes the lock the first time a thread records into a profiler
+	struct RingCache
+	{
+		UINT64 Profiler;
+		void* Ring;
+	};
+
+	thread_local RingCache t_ringCache = { 0, 0 };
+
+	UINT RoundUpToPowerOf2(UINT n)
+	{
+		UINT p = 1;
+		while (p < n)
+			p <<= 1;
+		return p;
+	}
+
+	//Nearest rank of a sorted set
+	double Percentile(const std::vector<float>& sorted, double p)
+	{
+		size_t rank = static_cast<size_t>(ceil(p*sorted.size()));
+		return sorted[rank ? rank - 1 : 0];
+	}
+
+	void WriteJsonString(FILE* file, const char* s)
+	{
+		fputc('"', file);
+		for (; *s; ++s)
+		{
+			if (*s == '"' || *s == '\\')
+				fputc('\\', file);
+			if (static_cast<unsigned char>(*s) >= 0x20)
+				fputc(*s, file);
+		}
+		fputc('"', file);
+	}
+}
+
+FrameProfiler::FrameProfiler(UINT ringCapacity, UINT historyFrames, UINT traceEvents)
+	:m_epoch(std::chrono::high_resolution_clock::now()),
+	m_id(g_nextProfilerId++),
+	m_enabled(false),
+	m_ringCapacity(RoundUpToPowerOf2(std::max(ringCapacity, 16u))),
+	m_frameStart(0), m_frameThread(0),
+	m_frameTimes(std::max(historyFrames, 1u), 0.0f), m_frames(0),
+	m_traceCapacity(traceEvents), m_dropped(0)
+{
+}
+
+FrameProfiler::~FrameProfiler()
+{
+}
+
+FrameProfiler& FrameProfiler::Default()
+{
+	static FrameProfiler profiler;
+	return profiler;
+}
+
+FrameProfiler::ThreadRing& FrameProfiler::LocalRing()
+{
+	if (t_ringCache.Profiler == m_id)
+		return *static_cast<ThreadRing*>(t_ringCache.Ring);
+
+	std::lock_guard<std::mutex> lock(m_ringsMutex);
+
+	//Back to this profiler after recording into another one
+	const std::thread::id thread = std::this_thread::get_id();
+	for (size_t r = 0; r < m_rings.size(); ++r)
+	{
+		if (m_rings[r]->Owner == thread)
+		{
+			t_ringCache.Profiler = m_id;
+			t_ringCache.Ring = m_rings[r].get();
+			return *m_rings[r];
+		}
+	}
+
+	ThreadRing* ring = new ThreadRing;
+	ring->Owner = thread;
+	ring->Events.resize(m_ringCapacity);
+	ring->Write.store(0, std::memory_order_relaxed);
+	ring->Read = 0;
+	ring->Thread = static_cast<UINT>(m_rings.size());
+	m_rings.push_back(std::unique_ptr<ThreadRing>(ring));
+
+	t_ringCache.Profiler = m_id;
+	t_ringCache.Ring = ring;
+	return *ring;
+}
+
+void FrameProfiler::Record(const char* name, UINT64 start, UINT64 end)
+{
+	ThreadRing& ring = LocalRing();
+
+	UINT64 write = ring.Write.load(std::memory_order_relaxed);
+	Event& e = ring.Events[write & (m_ringCapacity - 1)];
+	e.Name = name;
+	e.Start = start;
+	e.End = end;
+	e.Thread = ring.Thread;
+
+	ring.Write.store(write + 1, std::memory_order_release);
+}
+
+void FrameProfiler::BeginFrame()
+{
+	m_frameThread = LocalRing().Thread;
+	m_frameStart = Now();
+}
+
+void FrameProfiler::EndFrame()
+{
+	const UINT64 end = Now();
+	m_frameTimes[m_frames % m_frameTimes.size()] = static_cast<float>((end - m_frameStart)*1e-6);
+	++m_frames;
+
+	if (!Enabled())
+		return;
+
+	Record("Frame", m_frameStart, end);
+	Drain();
+
+	for (size_t p = 0; p < m_phases.size(); ++p)
+	{
+		Phase& phase = m_phases[p];
+		if (phase.Current > 0.0)
+		{
+			++phase.Frames;
+			phase.Total += phase.Current;
+			phase.Max = std::max(phase.Max, phase.Current);
+			phase.Current = 0.0;
+		}
+	}
+}
+
+void FrameProfiler::Drain()
+{
+	std::lock_guard<std::mutex> lock(m_ringsMutex);
+
+	for (size_t r = 0; r < m_rings.size(); ++r)
+	{
+		ThreadRing& ring = *m_rings[r];
+
+		//Events a full ring behind the writer are gone, the one in the slot
+		//of event write may be half overwritten by it already
+		UINT64 write = ring.Write.load(std::memory_order_acquire);
+		UINT64 first = std::max(ring.Read, write + 1 > m_ringCapacity ? write + 1 - m_ringCapacity : 0);
+
+		UINT64 lost = first - ring.Read;
+
+		const size_t copied = m_trace.size();
+		for (UINT64 i = first; i < write; ++i)
+		{
+			m_trace.push_back(ring.Events[i & (m_ringCapacity - 1)]);
+		}
+
+		//The owner kept writing meanwhile: what it reached again while
+		//being copied may be torn, drop it. The fence keeps the copies above
+		//before the load.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		UINT64 written = ring.Write.load(std::memory_order_relaxed);
+		UINT64 valid = written + 1 > m_ringCapacity ? written + 1 - m_ringCapacity : 0;
+		if (valid > first)
+		{
+			UINT64 torn = std::min(valid, write) - first;
+			m_trace.erase(m_trace.begin() + copied, m_trace.begin() + copied + static_cast<size_t>(torn));
+			lost += torn;
+		}
+
+		m_dropped += lost;
+		ring.Read = write;
+
+		for (size_t i = copied; i < m_trace.size(); ++i)
+		{
+			AddToPhase(m_trace[i]);
+		}
+
+		//The phases keep counting once the trace is full
+		if (m_trace.size() > m_traceCapacity)
+		{
+			m_trace.resize(std::max(copied, static_cast<size_t>(m_traceCapacity)));
+		}
+	}
+}
+
+void FrameProfiler::AddToPhase(const Event& e)
+{
+	const double milliseconds = (e.End - e.Start)*1e-6;
+
+	for (size_t p = 0; p < m_phases.size(); ++p)
+	{
+		if (m_phases[p].Name == e.Name || strcmp(m_phases[p].Name, e.Name) == 0)
+		{
+			m_phases[p].Current += milliseconds;
+			return;
+		}
+	}
+
+	Phase phase = { e.Name, 0, 0.0, 0.0, milliseconds };
+	m_phases.push_back(phase);
+}
+
+void FrameProfiler::Summarize(UINT lastFrames, Summary& summary) const
+{
+	UINT64 kept = std::min<UINT64>(m_frames, m_frameTimes.size());
+	UINT count = static_cast<UINT>(lastFrames ? std::min<UINT64>(lastFrames, kept) : kept);
+
+	std::vector<float> sorted(count);
+	double total = 0.0;
+	for (UINT i = 0; i < count; ++i)
+	{
+		sorted[i] = m_frameTimes[(m_frames - count + i) % m_frameTimes.size()];
+		total += sorted[i];
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	summary.Frames = count;
+	summary.MeanMilliseconds = count ? total / count : 0.0;
+	summary.P50Milliseconds = count ? Percentile(sorted, 0.50) : 0.0;
+	summary.P95Milliseconds = count ? Percentile(sorted, 0.95) : 0.0;
+	summary.P99Milliseconds = count ? Percentile(sorted, 0.99) : 0.0;
+	summary.MaxMilliseconds = count ? sorted.back() : 0.0;
+
+	summary.Phases.clear();
+	for (size_t p = 0; p < m_phases.size(); ++p)
+	{
+		const Phase& phase = m_phases[p];
+		PhaseStats stats;
+		stats.Name = phase.Name;
+		stats.Frames = phase.Frames;
+		stats.MeanMilliseconds = phase.Frames ? phase.Total / phase.Frames : 0.0;
+		stats.MaxMilliseconds = phase.Max;
+		summary.Phases.push_back(stats);
+	}
+
+	summary.TraceEvents = m_trace.size();
+	summary.DroppedEvents = m_dropped;
+}
+
+bool FrameProfiler::WriteChromeTrace(const char* fileName)
+{
+	//Scopes that ended since the last frame too
+	Drain();
+
+	FILE* file = 0;
+#if defined(_MSC_VER)
+	if (fopen_s(&file, fileName, "w") != 0)
+		file = 0;
+#else
+	file = fopen(fileName, "w");
+#endif
+	if (!file)
+		return false;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	UINT threads = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_ringsMutex);
+		threads = static_cast<UINT>(m_rings.size());
+	}
+	//Thread names first, then the events, comma separated
+	for (UINT t = 0; t < threads; ++t)
+	{
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", t ? ",\n" : "", t);
+		if (t == m_frameThread)
+		{
+			WriteJsonString(file, "Frame thread");
+		}
+		else
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "Thread %u", t);
+			WriteJsonString(file, name);
+		}
+		fprintf(file, "}}");
+	}
+
+	for (size_t i = 0; i < m_trace.size(); ++i)
+	{
+		const Event& e = m_trace[i];
+		fprintf(file, "%s{\"name\":", threads || i ? ",\n" : "");
+		WriteJsonString(file, e.Name);
+		fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			e.Thread, e.Start*1e-3, (e.End - e.Start)*1e-3);
+	}
+
+	fprintf(file, "\n]}\n");
+
+	bool written = ferror(file) == 0;
+	fclose(file);
+	return written;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+//CPU frame profiler
+//
+//Scope objects (or PROFILE_SCOPE) time a phase of the frame on whatever
+//thread they run. Every thread writes its finished scopes into a ring of its
+//own: the owner stores the event and publishes it with one release store of
+//the write index, nothing is locked or shared between threads on that path.
+//EndFrame(), on the frame thread, drains the rings, adds the events up per
+//phase and keeps them for WriteChromeTrace(). A ring that fills up between
+//two frames loses its oldest events, they are counted as dropped.
+//
+//Frame times are kept for the last frames whether scopes are enabled or
+//not, Summarize() reports their mean and p50/p95/p99/max. With scopes
+//disabled a Scope only tests one flag.
+//
+//The trace opens in chrome://tracing or ui.perfetto.dev.
+
+#ifndef _FRAMEPROFILER_H_
+#define _FRAMEPROFILER_H_
+
+#if defined(_WIN32)
+#include<Windows.h>
+#else
+#include<stdint.h>
+typedef unsigned int UINT;
+typedef uint64_t UINT64;
+#endif
+
+#include<atomic>
+#include<chrono>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+//Times the rest of the enclosing block in FrameProfiler::Default()
+#define PROFILE_SCOPE(name) FrameProfiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+class FrameProfiler
+{
+public:
+	//Nanoseconds since the profiler was created. Name is a string literal or
+	//anything else that outlives the profiler.
+	struct Event
+	{
+		const char* Name;
+		UINT64 Start;
+		UINT64 End;
+		UINT Thread;
+	};
+
+	class Scope
+	{
+	public:
+		Scope(const char* name, FrameProfiler& profiler = FrameProfiler::Default())
+			:m_profiler(profiler.Enabled() ? &profiler : 0), m_name(name), m_start(0)
+		{
+			if (m_profiler)
+				m_start = m_profiler->Now();
+		}
+
+		~Scope()
+		{
+			if (m_profiler)
+				m_profiler->Record(m_name, m_start, m_profiler->Now());
+		}
+
+	private:
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+
+		FrameProfiler* m_profiler;
+		const char* m_name;
+		UINT64 m_start;
+	};
+
+	//A phase over all frames since the profiler was enabled, per frame
+	struct PhaseStats
+	{
+		const char* Name;
+		UINT Frames;		//Frames the phase ran in
+		double MeanMilliseconds;	//Over those frames
+		double MaxMilliseconds;
+	};
+
+	struct Summary
+	{
+		UINT Frames;
+		double MeanMilliseconds;
+		double P50Milliseconds;
+		double P95Milliseconds;
+		double P99Milliseconds;
+		double MaxMilliseconds;
+
+		std::vector<PhaseStats> Phases;	//In order of first appearance
+		UINT64 TraceEvents;
+		UINT64 DroppedEvents;
+	};
+
+public:
+	//ringCapacity events per thread between two frames, rounded up to a
+	//power of 2 less the slot being written, the times of historyFrames frames and at most traceEvents
+	//events for the trace
+	FrameProfiler(UINT ringCapacity = 4096, UINT historyFrames = 8192, UINT traceEvents = 1 << 20);
+	~FrameProfiler();
+
+	//Process wide profiler, what PROFILE_SCOPE and D3DApp use
+	static FrameProfiler& Default();
+
+	//Scopes record nothing until enabled
+	void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+	bool Enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+	//On the frame thread. EndFrame() also drains the rings of all threads.
+	void BeginFrame();
+	void EndFrame();
+
+	UINT64 FrameCount() const { return m_frames; }
+
+	//The last lastFrames frames, 0 for all those kept
+	void Summarize(UINT lastFrames, Summary& summary) const;
+
+	//Chrome trace event format, one complete event per scope and frame
+	bool WriteChromeTrace(const char* fileName);
+
+	UINT64 Now() const
+	{
+		return static_cast<UINT64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::high_resolution_clock::now() - m_epoch).count());
+	}
+
+	//What a Scope does when it ends
+	void Record(const char* name, UINT64 start, UINT64 end);
+
+private:
+	//Written by its thread only, read by the frame thread
+	struct ThreadRing
+	{
+		std::vector<Event> Events;
+		std::atomic<UINT64> Write;
+		UINT64 Read;
+		UINT Thread;
+		std::thread::id Owner;
+	};
+
+	struct Phase
+	{
+		const char* Name;
+		UINT Frames;
+		double Total;
+		double Max;
+		double Current;
+	};
+
+	ThreadRing& LocalRing();
+	void Drain();
+	void AddToPhase(const Event& e);
+
+private:
+	const std::chrono::high_resolution_clock::time_point m_epoch;
+	const UINT64 m_id;		//Tells profilers apart in the thread local cache
+	std::atomic<bool> m_enabled;
+
+	std::mutex m_ringsMutex;	//Adding rings, and draining them
+	std::vector<std::unique_ptr<ThreadRing> > m_rings;
+	UINT m_ringCapacity;
+
+	UINT64 m_frameStart;
+	UINT m_frameThread;
+
+	std::vector<float> m_frameTimes;	//Milliseconds, a ring of the last frames
+	UINT64 m_frames;
+
+	std::vector<Phase> m_phases;
+
+	std::vector<Event> m_trace;
+	UINT m_traceCapacity;
+	UINT64 m_dropped;
+};
+
+#endif
@@ -0,0 +1,357 @@
+#include"FrustumCuller.h"
+#include<cfloat>
+#include<chrono>
+
+#if defined(__AVX__)
+#include<immintrin.h>
+#define CULL_AVX
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include<emmintrin.h>
+#define CULL_SSE
+#endif
+
+namespace
+{
+	//Every set is padded to this many entries
+	const UINT Padding = 8;
+
+	UINT PaddedCount(UINT count)
+	{
+		return (count + Padding - 1) / Padding*Padding;
+	}
+
+	//Fills [count, padded) with volumes outside every plane: a negative
+	//radius/extent larger than any distance fails "distance >= -radius"
+	void Pad(std::vector<float>& v, UINT count, float value)
+	{
+		v.resize(PaddedCount(count));
+		for (size_t i = count; i < v.size(); ++i)
+		{
+			v[i] = value;
+		}
+	}
+}
+
+void FrustumCuller::SphereSet::Resize(UINT count)
+{
+	Count = count;
+	Pad(CenterX, count, 0.0f);
+	Pad(CenterY, count, 0.0f);
+	Pad(CenterZ, count, 0.0f);
+	Pad(Radius, count, -FLT_MAX);
+}
+
+void FrustumCuller::SphereSet::Set(UINT i, const XMFLOAT3& center, float radius)
+{
+	CenterX[i] = center.x;
+	CenterY[i] = center.y;
+	CenterZ[i] = center.z;
+	Radius[i] = radius;
+}
+
+void FrustumCuller::AabbSet::Resize(UINT count)
+{
+	Count = count;
+	Pad(CenterX, count, 0.0f);
+	Pad(CenterY, count, 0.0f);
+	Pad(CenterZ, count, 0.0f);
+	Pad(ExtentX, count, -FLT_MAX);
+	Pad(ExtentY, count, -FLT_MAX);
+	Pad(ExtentZ, count, -FLT_MAX);
+}
+
+void FrustumCuller::AabbSet::Set(UINT i, const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	CenterX[i] = center.x;
+	CenterY[i] = center.y;
+	CenterZ[i] = center.z;
+	ExtentX[i] = extents.x;
+	ExtentY[i] = extents.y;
+	ExtentZ[i] = extents.z;
+}
+
+void FrustumCuller::AabbSet::Set(UINT i, const XMFLOAT3& localCenter, const XMFLOAT3& localExtents, CXMMATRIX world)
+{
+	XMFLOAT3 center;
+	XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&localCenter), world));
+
+	//Each world axis extent is the sum of the local extents scaled by |M|
+	XMFLOAT4X4 M;
+	XMStoreFloat4x4(&M, world);
+
+	XMFLOAT3 extents(
+		fabsf(M._11)*localExtents.x + fabsf(M._21)*localExtents.y + fabsf(M._31)*localExtents.z,
+		fabsf(M._12)*localExtents.x + fabsf(M._22)*localExtents.y + fabsf(M._32)*localExtents.z,
+		fabsf(M._13)*localExtents.x + fabsf(M._23)*localExtents.y + fabsf(M._33)*localExtents.z);
+
+	Set(i, center, extents);
+}
+
+const char* FrustumCuller::InstructionSet()
+{
+#if defined(CULL_AVX)
+	return "AVX";
+#elif defined(CULL_SSE)
+	return "SSE2";
+#else
+	return "Scalar";
+#endif
+}
+
+UINT FrustumCuller::CullSpheres(const XMFLOAT4 planes[6], const SphereSet& spheres, std::vector<UINT>& visible)
+{
+	UINT padded = PaddedCount(spheres.Count);
+
+	//Room for a whole batch past the last visible object
+	visible.resize(padded);
+	UINT* out = visible.empty() ? 0 : &visible[0];
+	UINT n = 0;
+
+	const float* cx = spheres.CenterX.empty() ? 0 : &spheres.CenterX[0];
+	const float* cy = spheres.CenterY.empty() ? 0 : &spheres.CenterY[0];
+	const float* cz = spheres.CenterZ.empty() ? 0 : &spheres.CenterZ[0];
+	const float* radius = spheres.Radius.empty() ? 0 : &spheres.Radius[0];
+
+#if defined(CULL_AVX)
+	__m256 px[6], py[6], pz[6], pw[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		px[p] = _mm256_set1_ps(planes[p].x);
+		py[p] = _mm256_set1_ps(planes[p].y);
+		pz[p] = _mm256_set1_ps(planes[p].z);
+		pw[p] = _mm256_set1_ps(planes[p].w);
+	}
+
+	for (UINT i = 0; i < padded; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(cx + i);
+		__m256 y = _mm256_loadu_ps(cy + i);
+		__m256 z = _mm256_loadu_ps(cz + i);
+		__m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)),
+				_mm256_add_ps(_mm256_mul_ps(pz[p], z), pw[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (UINT k = 0; k < 8; ++k)
+		{
+			out[n] = i + k;
+			n += (mask >> k) & 1;
+		}
+	}
+#elif defined(CULL_SSE)
+	__m128 px[6], py[6], pz[6], pw[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		px[p] = _mm_set1_ps(planes[p].x);
+		py[p] = _mm_set1_ps(planes[p].y);
+		pz[p] = _mm_set1_ps(planes[p].z);
+		pw[p] = _mm_set1_ps(planes[p].w);
+	}
+
+	for (UINT i = 0; i < padded; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(cx + i);
+		__m128 y = _mm_loadu_ps(cy + i);
+		__m128 z = _mm_loadu_ps(cz + i);
+		__m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+				_mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (UINT k = 0; k < 4; ++k)
+		{
+			out[n] = i + k;
+			n += (mask >> k) & 1;
+		}
+	}
+#else
+	for (UINT i = 0; i < padded; ++i)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6; ++p)
+		{
+			float d = planes[p].x*cx[i] + planes[p].y*cy[i] + planes[p].z*cz[i] + planes[p].w;
+			inside = inside && d >= -radius[i];
+		}
+
+		out[n] = i;
+		n += inside ? 1 : 0;
+	}
+#endif
+
+	visible.resize(n);
+	return n;
+}
+
+UINT FrustumCuller::CullAabbs(const XMFLOAT4 planes[6], const AabbSet& boxes, std::vector<UINT>& visible)
+{
+	UINT padded = PaddedCount(boxes.Count);
+
+	visible.resize(padded);
+	UINT* out = visible.empty() ? 0 : &visible[0];
+	UINT n = 0;
+
+	const float* cx = boxes.CenterX.empty() ? 0 : &boxes.CenterX[0];
+	const float* cy = boxes.CenterY.empty() ? 0 : &boxes.CenterY[0];
+	const float* cz = boxes.CenterZ.empty() ? 0 : &boxes.CenterZ[0];
+	const float* ex = boxes.ExtentX.empty() ? 0 : &boxes.ExtentX[0];
+	const float* ey = boxes.ExtentY.empty() ? 0 : &boxes.ExtentY[0];
+	const float* ez = boxes.ExtentZ.empty() ? 0 : &boxes.ExtentZ[0];
+
+	//The box reaches |n.x|*e.x + |n.y|*e.y + |n.z|*e.z towards the plane
+#if defined(CULL_AVX)
+	__m256 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		px[p] = _mm256_set1_ps(planes[p].x);
+		py[p] = _mm256_set1_ps(planes[p].y);
+		pz[p] = _mm256_set1_ps(planes[p].z);
+		pw[p] = _mm256_set1_ps(planes[p].w);
+		ax[p] = _mm256_set1_ps(fabsf(planes[p].x));
+		ay[p] = _mm256_set1_ps(fabsf(planes[p].y));
+		az[p] = _mm256_set1_ps(fabsf(planes[p].z));
+	}
+
+	for (UINT i = 0; i < padded; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(cx + i);
+		__m256 y = _mm256_loadu_ps(cy + i);
+		__m256 z = _mm256_loadu_ps(cz + i);
+		__m256 sx = _mm256_loadu_ps(ex + i);
+		__m256 sy = _mm256_loadu_ps(ey + i);
+		__m256 sz = _mm256_loadu_ps(ez + i);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)),
+				_mm256_add_ps(_mm256_mul_ps(pz[p], z), pw[p]));
+			__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], sx), _mm256_mul_ps(ay[p], sy)),
+				_mm256_mul_ps(az[p], sz));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (UINT k = 0; k < 8; ++k)
+		{
+			out[n] = i + k;
+			n += (mask >> k) & 1;
+		}
+	}
+#elif defined(CULL_SSE)
+	__m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		px[p] = _mm_set1_ps(planes[p].x);
+		py[p] = _mm_set1_ps(planes[p].y);
+		pz[p] = _mm_set1_ps(planes[p].z);
+		pw[p] = _mm_set1_ps(planes[p].w);
+		ax[p] = _mm_set1_ps(fabsf(planes[p].x));
+		ay[p] = _mm_set1_ps(fabsf(planes[p].y));
+		az[p] = _mm_set1_ps(fabsf(planes[p].z));
+	}
+
+	for (UINT i = 0; i < padded; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(cx + i);
+		__m128 y = _mm_loadu_ps(cy + i);
+		__m128 z = _mm_loadu_ps(cz + i);
+		__m128 sx = _mm_loadu_ps(ex + i);
+		__m128 sy = _mm_loadu_ps(ey + i);
+		__m128 sz = _mm_loadu_ps(ez + i);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+				_mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], sx), _mm_mul_ps(ay[p], sy)),
+				_mm_mul_ps(az[p], sz));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (UINT k = 0; k < 4; ++k)
+		{
+			out[n] = i + k;
+			n += (mask >> k) & 1;
+		}
+	}
+#else
+	for (UINT i = 0; i < padded; ++i)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6; ++p)
+		{
+			float d = planes[p].x*cx[i] + planes[p].y*cy[i] + planes[p].z*cz[i] + planes[p].w;
+			float r = fabsf(planes[p].x)*ex[i] + fabsf(planes[p].y)*ey[i] + fabsf(planes[p].z)*ez[i];
+			inside = inside && d + r >= 0.0f;
+		}
+
+		out[n] = i;
+		n += inside ? 1 : 0;
+	}
+#endif
+
+	visible.resize(n);
+	return n;
+}
+
+void FrustumCuller::Benchmark(UINT objectCount, UINT iterations, BenchmarkResult& result)
+{
+	//Objects scattered in a 2000 unit cube around a camera at the origin
+	//looking down +z, roughly a tenth of them end up visible
+	SphereSet spheres;
+	AabbSet boxes;
+	spheres.Resize(objectCount);
+	boxes.Resize(objectCount);
+
+	srand(1);
+	for (UINT i = 0; i < objectCount; ++i)
+	{
+		XMFLOAT3 center(MathHelper::RandF(-1000.0f, 1000.0f), MathHelper::RandF(-1000.0f, 1000.0f), MathHelper::RandF(-1000.0f, 1000.0f));
+		float size = MathHelper::RandF(0.5f, 5.0f);
+
+		spheres.Set(i, center, size);
+		boxes.Set(i, center, XMFLOAT3(size, 0.5f*size, size));
+	}
+
+	XMMATRIX view = XMMatrixLookAtLH(XMVectorZero(), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 16.0f / 9.0f, 1.0f, 1000.0f);
+
+	XMFLOAT4 planes[6];
+	ExtractFrustumPlanes(planes, XMMatrixMultiply(view, proj));
+
+	std::vector<UINT> visible;
+	visible.reserve(PaddedCount(objectCount));
+
+	result.ObjectCount = objectCount;
+	result.Iterations = iterations = MathHelper::Max(iterations, 1u);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (UINT i = 0; i < iterations; ++i)
+	{
+		result.VisibleSpheres = CullSpheres(planes, spheres, visible);
+	}
+	std::chrono::high_resolution_clock::time_point middle = std::chrono::high_resolution_clock::now();
+	for (UINT i = 0; i < iterations; ++i)
+	{
+		result.VisibleAabbs = CullAabbs(planes, boxes, visible);
+	}
+	std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+	result.SphereMilliseconds = std::chrono::duration<double, std::milli>(middle - start).count() / iterations;
+	result.AabbMilliseconds = std::chrono::duration<double, std::milli>(end - middle).count() / iterations;
+}
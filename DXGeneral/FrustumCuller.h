@@ -0,0 +1,80 @@
+#pragma once
+
+//Batched view frustum culling
+//
+//Bounding volumes are stored structure-of-arrays so one SIMD register holds
+//the same component of several objects: 8 per iteration when built with AVX
+//(/arch:AVX), 4 with SSE2 otherwise. Each test writes the indices of the
+//objects that are at least partially inside into a visible list.
+//
+//Planes come from ExtractFrustumPlanes (MathHelper.h) and must be in the same
+//space as the bounds, usually world space from view*proj.
+
+#ifndef _FRUSTUMCULLER_H_
+#define _FRUSTUMCULLER_H_
+
+#include "d3dUtil.h"
+
+class FrustumCuller
+{
+public:
+	//Arrays are padded to a multiple of 8 with volumes that always fail,
+	//so the SIMD loops never need a scalar tail
+	struct SphereSet
+	{
+		std::vector<float> CenterX;
+		std::vector<float> CenterY;
+		std::vector<float> CenterZ;
+		std::vector<float> Radius;
+		UINT Count;
+
+		SphereSet() :Count(0) {}
+
+		void Resize(UINT count);
+		void Set(UINT i, const XMFLOAT3& center, float radius);
+	};
+
+	struct AabbSet
+	{
+		std::vector<float> CenterX;
+		std::vector<float> CenterY;
+		std::vector<float> CenterZ;
+		std::vector<float> ExtentX;
+		std::vector<float> ExtentY;
+		std::vector<float> ExtentZ;
+		UINT Count;
+
+		AabbSet() :Count(0) {}
+
+		void Resize(UINT count);
+		void Set(UINT i, const XMFLOAT3& center, const XMFLOAT3& extents);
+
+		//Box of the local bounds after an affine transform
+		void Set(UINT i, const XMFLOAT3& localCenter, const XMFLOAT3& localExtents, CXMMATRIX world);
+	};
+
+	struct BenchmarkResult
+	{
+		UINT ObjectCount;
+		UINT Iterations;
+		UINT VisibleSpheres;
+		UINT VisibleAabbs;
+
+		//Average over the iterations
+		double SphereMilliseconds;
+		double AabbMilliseconds;
+	};
+
+public:
+	//visible is overwritten, returns its size
+	static UINT CullSpheres(const XMFLOAT4 planes[6], const SphereSet& spheres, std::vector<UINT>& visible);
+	static UINT CullAabbs(const XMFLOAT4 planes[6], const AabbSet& boxes, std::vector<UINT>& visible);
+
+	//Culls objectCount random spheres and boxes against a typical camera
+	static void Benchmark(UINT objectCount, UINT iterations, BenchmarkResult& result);
+
+	//"SSE2" or "AVX", whichever the module was built with
+	static const char* InstructionSet();
+};
+
+#endif
@@ -294,7 +294,7 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 	//This is just skipping the top pole vertex
 	UINT baseIndex = 1;
 	UINT ringVertexCount = sliceCount + 1;
-	for (UINT i = 0; i < sliceCount - 2; ++i) //the top and bottom stacks are special
+	for (UINT i = 0; i < stackCount - 2; ++i) //the top and bottom stacks are special
 	{
 		for (UINT j = 0; j < sliceCount; ++j) //number of quads per ring = number of slices
 		{
@@ -0,0 +1,50 @@
+#include "InstanceBatcher.h"
+#include <algorithm>
+
+void InstanceBatcher::Clear()
+{
+	m_draws.clear();
+	m_worlds.clear();
+	m_batches.clear();
+	m_instances.clear();
+}
+
+void InstanceBatcher::Add(UINT mesh, UINT material, const XMFLOAT4X4& world)
+{
+	Draw draw;
+	draw.Key = (static_cast<UINT64>(mesh) << 32) | material;
+	draw.Index = static_cast<UINT>(m_worlds.size());
+
+	m_draws.push_back(draw);
+	m_worlds.push_back(world);
+}
+
+void InstanceBatcher::Build()
+{
+	//The index breaks ties, so a batch keeps the order of Add()
+	std::sort(m_draws.begin(), m_draws.end(), [](const Draw& a, const Draw& b)
+	{
+		return a.Key != b.Key ? a.Key < b.Key : a.Index < b.Index;
+	});
+
+	m_batches.clear();
+	m_instances.resize(m_draws.size());
+
+	for (size_t i = 0; i < m_draws.size(); ++i)
+	{
+		const Draw& draw = m_draws[i];
+
+		if (i == 0 || draw.Key != m_draws[i - 1].Key)
+		{
+			Batch batch;
+			batch.Mesh = static_cast<UINT>(draw.Key >> 32);
+			batch.Material = static_cast<UINT>(draw.Key);
+			batch.FirstInstance = static_cast<UINT>(i);
+			batch.InstanceCount = 0;
+			m_batches.push_back(batch);
+		}
+
+		++m_batches.back().InstanceCount;
+		m_instances[i] = m_worlds[draw.Index];
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+//Groups draws of repeated meshes into instanced draws
+//
+//Each frame the visible objects are added with the mesh and material they
+//are drawn with and their world matrix. Build() sorts them by mesh, then
+//material, and merges equal neighbours into batches: one
+//DrawIndexedInstanced per unique mesh and material, drawing the instances
+//FirstInstance to FirstInstance+InstanceCount-1 of Instances(). Objects of
+//the same batch keep the order they were added in.
+//
+//Only CPU memory is touched here; uploading Instances() into a per
+//instance vertex buffer is up to the caller. The vectors keep their
+//capacity between frames, so steady state frames do not allocate.
+
+#ifndef _INSTANCEBATCHER_H_
+#define _INSTANCEBATCHER_H_
+
+#include "d3dUtil.h"
+
+class InstanceBatcher
+{
+public:
+	struct Batch
+	{
+		UINT Mesh;
+		UINT Material;
+		UINT FirstInstance;
+		UINT InstanceCount;
+	};
+
+public:
+	//Forgets the draws and batches of the last frame
+	void Clear();
+
+	void Add(UINT mesh, UINT material, const XMFLOAT4X4& world);
+
+	//Sorts the draws added since Clear() into batches
+	void Build();
+
+	UINT DrawCount() const { return static_cast<UINT>(m_worlds.size()); }
+
+	//Valid after Build()
+	const std::vector<Batch>& Batches() const { return m_batches; }
+	const std::vector<XMFLOAT4X4>& Instances() const { return m_instances; }
+
+private:
+	struct Draw
+	{
+		UINT64 Key;
+		UINT Index;
+	};
+
+private:
+	std::vector<Draw> m_draws;
+	std::vector<XMFLOAT4X4> m_worlds;
+
+	std::vector<Batch> m_batches;
+	std::vector<XMFLOAT4X4> m_instances;
+};
+
+#endif
@@ -0,0 +1,366 @@
+#include"JobSystem.h"
+#include<algorithm>
+#include<cassert>
+#include<exception>
+
+namespace
+{
+	//Which queue the current thread serves, QUEUE_COUNT for non-worker threads
+	thread_local JobSystem::JobQueue t_workerQueue = JobSystem::QUEUE_COUNT;
+}
+
+JobSystem::JobSystem()
+	:m_nextHandle(1), m_running(false)
+{
+	m_threadCount[QUEUE_CPU] = 0;
+	m_threadCount[QUEUE_IO] = 0;
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+void JobSystem::Init(UINT cpuThreads, UINT ioThreads)
+{
+	//In case Init() called again
+	Shutdown();
+
+	if (cpuThreads == 0)
+	{
+		UINT hw = std::thread::hardware_concurrency();
+		cpuThreads = hw > 1 ? hw - 1 : 1;
+	}
+
+	m_running = true;
+	m_threadCount[QUEUE_CPU] = cpuThreads;
+	m_threadCount[QUEUE_IO] = ioThreads;
+
+	for (UINT i = 0; i < cpuThreads; ++i)
+	{
+		m_workers.push_back(std::thread(&JobSystem::WorkerMain, this, QUEUE_CPU));
+	}
+
+	for (UINT i = 0; i < ioThreads; ++i)
+	{
+		m_workers.push_back(std::thread(&JobSystem::WorkerMain, this, QUEUE_IO));
+	}
+}
+
+void JobSystem::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_running)
+		{
+			return;
+		}
+		m_running = false;
+	}
+
+	m_workAvailable[QUEUE_CPU].notify_all();
+	m_workAvailable[QUEUE_IO].notify_all();
+
+	//Workers drain their queues before exiting
+	for (size_t i = 0; i < m_workers.size(); ++i)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+
+	m_threadCount[QUEUE_CPU] = 0;
+	m_threadCount[QUEUE_IO] = 0;
+}
+
+JobSystem::JobHandle JobSystem::Submit(const std::function<void()>& job,
+	JobPriority priority, JobQueue queue,
+	const JobHandle* dependencies, UINT dependencyCount)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	JobHandle handle = m_nextHandle++;
+
+	//Without workers everything runs inline on the caller.
+	//Dependencies are necessarily done already in that case. An exception
+	//is kept for Wait() like on a worker.
+	if (!m_running)
+	{
+		lock.unlock();
+		try
+		{
+			job();
+		}
+		catch (...)
+		{
+			lock.lock();
+			m_failures[handle] = std::current_exception();
+		}
+		return handle;
+	}
+
+	//No I/O threads, so I/O jobs share the CPU workers
+	if (queue == QUEUE_IO && m_threadCount[QUEUE_IO] == 0)
+	{
+		queue = QUEUE_CPU;
+	}
+
+	Job& j = m_jobs[handle];
+	j.Function = job;
+	j.Priority = priority;
+	j.Queue = queue;
+	j.PendingDependencies = 0;
+
+	for (UINT i = 0; i < dependencyCount; ++i)
+	{
+		auto dep = m_jobs.find(dependencies[i]);
+		if (dep != m_jobs.end())
+		{
+			dep->second.Dependents.push_back(handle);
+			++j.PendingDependencies;
+		}
+	}
+
+	if (j.PendingDependencies == 0)
+	{
+		Enqueue(handle, j);
+	}
+
+	return handle;
+}
+
+bool JobSystem::IsDone(JobHandle job) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return job != 0 && job < m_nextHandle && m_jobs.find(job) == m_jobs.end();
+}
+
+void JobSystem::Wait(JobHandle job)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (m_jobs.find(job) != m_jobs.end())
+	{
+		//I/O workers must not pick up CPU work, they would stall the reads
+		if (t_workerQueue != QUEUE_IO && TryRunOne(lock, QUEUE_CPU))
+		{
+			continue;
+		}
+
+		m_jobFinished.wait(lock);
+	}
+
+	auto failed = m_failures.find(job);
+	if (failed != m_failures.end())
+	{
+		std::exception_ptr failure = failed->second;
+		m_failures.erase(failed);
+		lock.unlock();
+		std::rethrow_exception(failure);
+	}
+}
+
+void JobSystem::WaitAll()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (!m_jobs.empty())
+	{
+		if (t_workerQueue != QUEUE_IO && TryRunOne(lock, QUEUE_CPU))
+		{
+			continue;
+		}
+
+		m_jobFinished.wait(lock);
+	}
+
+	//The first failure not waited for yet, the others are dropped
+	if (!m_failures.empty())
+	{
+		std::exception_ptr failure = m_failures.begin()->second;
+		m_failures.clear();
+		lock.unlock();
+		std::rethrow_exception(failure);
+	}
+}
+
+UINT JobSystem::ThreadCount(JobQueue queue) const
+{
+	return m_threadCount[queue];
+}
+
+UINT JobSystem::ChunkCount(UINT count, UINT grainSize) const
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	grainSize = std::max<UINT>(grainSize, 1);
+
+	//A few chunks per thread balances uneven work without drowning in overhead
+	UINT maxChunks = (m_threadCount[QUEUE_CPU] + 1) * 4;
+	UINT chunks = (count + grainSize - 1) / grainSize;
+
+	return std::min(chunks, maxChunks);
+}
+
+void JobSystem::ParallelFor(UINT count, UINT grainSize, const RangeFunction& body)
+{
+	UINT chunks = ChunkCount(count, grainSize);
+	if (chunks == 0)
+	{
+		return;
+	}
+
+	if (chunks == 1 || !m_running)
+	{
+		for (UINT c = 0; c < chunks; ++c)
+		{
+			body(UINT((UINT64)count * c / chunks), UINT((UINT64)count * (c + 1) / chunks), c);
+		}
+		return;
+	}
+
+	std::vector<JobHandle> jobs(chunks - 1);
+	for (UINT c = 1; c < chunks; ++c)
+	{
+		UINT begin = UINT((UINT64)count * c / chunks);
+		UINT end = UINT((UINT64)count * (c + 1) / chunks);
+
+		jobs[c - 1] = Submit([&body, begin, end, c]() { body(begin, end, c); }, PRIORITY_HIGH);
+	}
+
+	//The caller takes the first chunk itself. The other chunks reference
+	//body, so they are all waited for before any exception leaves.
+	std::exception_ptr failure;
+	try
+	{
+		body(0, UINT((UINT64)count / chunks), 0);
+	}
+	catch (...)
+	{
+		failure = std::current_exception();
+	}
+
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		try
+		{
+			Wait(jobs[i]);
+		}
+		catch (...)
+		{
+			if (!failure)
+				failure = std::current_exception();
+		}
+	}
+
+	if (failure)
+	{
+		std::rethrow_exception(failure);
+	}
+}
+
+JobSystem& JobSystem::Default()
+{
+	static JobSystem pool;
+	static std::once_flag initFlag;
+
+	std::call_once(initFlag, []() { pool.Init(); });
+
+	return pool;
+}
+
+void JobSystem::WorkerMain(JobQueue queue)
+{
+	t_workerQueue = queue;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		if (TryRunOne(lock, queue))
+		{
+			continue;
+		}
+
+		if (!m_running)
+		{
+			break;
+		}
+
+		m_workAvailable[queue].wait(lock);
+	}
+}
+
+//Runs the highest priority ready job of the queue, if any.
+//The lock is released while the job runs.
+bool JobSystem::TryRunOne(std::unique_lock<std::mutex>& lock, JobQueue queue)
+{
+	for (UINT p = 0; p < PRIORITY_COUNT; ++p)
+	{
+		std::deque<JobHandle>& ready = m_ready[queue][p];
+		if (ready.empty())
+		{
+			continue;
+		}
+
+		JobHandle handle = ready.front();
+		ready.pop_front();
+
+		std::function<void()> function;
+		function.swap(m_jobs[handle].Function);
+
+		//A throwing job still finishes, or its waiters would block forever.
+		//The exception goes to whoever waits on the job.
+		std::exception_ptr failure;
+		lock.unlock();
+		try
+		{
+			function();
+		}
+		catch (...)
+		{
+			failure = std::current_exception();
+		}
+		lock.lock();
+
+		if (failure)
+		{
+			m_failures[handle] = failure;
+		}
+
+		Finish(handle);
+		return true;
+	}
+
+	return false;
+}
+
+void JobSystem::Enqueue(JobHandle handle, const Job& job)
+{
+	m_ready[job.Queue][job.Priority].push_back(handle);
+	m_workAvailable[job.Queue].notify_one();
+}
+
+void JobSystem::Finish(JobHandle handle)
+{
+	auto it = m_jobs.find(handle);
+	assert(it != m_jobs.end());
+
+	std::vector<JobHandle> dependents;
+	dependents.swap(it->second.Dependents);
+	m_jobs.erase(it);
+
+	for (size_t i = 0; i < dependents.size(); ++i)
+	{
+		Job& dependent = m_jobs[dependents[i]];
+		if (--dependent.PendingDependencies == 0)
+		{
+			Enqueue(dependents[i], dependent);
+		}
+	}
+
+	m_jobFinished.notify_all();
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+//Small worker thread pool shared by the asset loader and the CPU-side
+//processing modules.
+//
+//Jobs go to one of two queues: CPU jobs (decode, mesh processing) and I/O
+//jobs (file reads), each served by its own group of worker threads so a
+//slow disk read never blocks decoding. Every job carries a priority and may
+//depend on previously submitted jobs, in either queue; it is only handed to
+//a worker once all of its dependencies have finished.
+
+#ifndef _JOBSYSTEM_H_
+#define _JOBSYSTEM_H_
+
+#if defined(_WIN32)
+#include<Windows.h>
+#else
+#include<stdint.h>
+typedef unsigned int UINT;
+typedef uint64_t UINT64;
+#endif
+
+#include<functional>
+#include<vector>
+#include<deque>
+#include<unordered_map>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<exception>
+
+class JobSystem
+{
+public:
+	//0 is never a valid handle, so it can be used as "no job"
+	typedef UINT64 JobHandle;
+
+	enum JobPriority
+	{
+		PRIORITY_CRITICAL = 0,
+		PRIORITY_HIGH,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW,
+		PRIORITY_COUNT
+	};
+
+	enum JobQueue
+	{
+		QUEUE_CPU = 0,
+		QUEUE_IO,
+		QUEUE_COUNT
+	};
+
+	//begin, end, chunk index
+	typedef std::function<void(UINT, UINT, UINT)> RangeFunction;
+
+public:
+	JobSystem();
+	~JobSystem();
+
+	//cpuThreads == 0 uses one worker per hardware thread minus the caller
+	void Init(UINT cpuThreads = 0, UINT ioThreads = 2);
+	void Shutdown();
+
+	JobHandle Submit(const std::function<void()>& job,
+		JobPriority priority = PRIORITY_NORMAL,
+		JobQueue queue = QUEUE_CPU,
+		const JobHandle* dependencies = 0, UINT dependencyCount = 0);
+
+	bool IsDone(JobHandle job) const;
+
+	//Blocks until the job finished. A caller that is not an I/O worker
+	//helps by running ready CPU jobs while it waits.
+	//A job that throws still finishes and its dependents still run; Wait()
+	//rethrows the exception, WaitAll() the first one nobody waited for.
+	void Wait(JobHandle job);
+	void WaitAll();
+
+	UINT ThreadCount(JobQueue queue = QUEUE_CPU) const;
+
+	//Splits [0, count) into chunks of at least grainSize items and runs
+	//them on the CPU workers and the calling thread. The chunk index passed
+	//to the body is stable for a given (count, grainSize), so callers can
+	//keep one accumulation bucket per chunk and reduce afterwards instead
+	//of sharing atomics. An exception of a chunk is rethrown once all
+	//chunks are done.
+	void ParallelFor(UINT count, UINT grainSize, const RangeFunction& body);
+	UINT ChunkCount(UINT count, UINT grainSize) const;
+
+	//Process wide pool, created on first use
+	static JobSystem& Default();
+
+private:
+	struct Job
+	{
+		std::function<void()> Function;
+		JobPriority Priority;
+		JobQueue Queue;
+		UINT PendingDependencies;
+		std::vector<JobHandle> Dependents;
+	};
+
+	void WorkerMain(JobQueue queue);
+	bool TryRunOne(std::unique_lock<std::mutex>& lock, JobQueue queue);
+	void Enqueue(JobHandle handle, const Job& job);
+	void Finish(JobHandle handle);
+
+private:
+	mutable std::mutex m_mutex;
+	std::condition_variable m_workAvailable[QUEUE_COUNT];
+	std::condition_variable m_jobFinished;
+
+	std::unordered_map<JobHandle, Job> m_jobs;
+
+	//Exceptions of finished jobs until waited for
+	std::unordered_map<JobHandle, std::exception_ptr> m_failures;
+	std::deque<JobHandle> m_ready[QUEUE_COUNT][PRIORITY_COUNT];
+
+	std::vector<std::thread> m_workers;
+	UINT m_threadCount[QUEUE_COUNT];
+
+	JobHandle m_nextHandle;
+	bool m_running;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include"LightBaker.h"
+#include"MathHelper.h"
+#include<chrono>
+#include<cmath>
+
+namespace
+{
+	//Blocks of 8 vertices per chunk at least
+	const UINT BLOCK_GRAIN = 32;
+	const UINT BLOCK_SIZE = 8;
+
+	//Rays start this far above the surface along the normal
+	const float RAY_OFFSET = 0.05f;
+}
+
+LightBaker::LightBaker(JobSystem& jobs)
+	:m_jobs(jobs)
+{
+	ZeroMemory(&m_stats, sizeof(m_stats));
+}
+
+void LightBaker::Bake(const Material& mat, const LightingModel::LightSet& lights,
+	const LightingModel::SampleSet& samples, const HeightField& heights,
+	const Settings& settings, std::vector<XMFLOAT4>& colors)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const UINT count = samples.Count;
+	const UINT blockCount = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+	//Specular is not kept, any eye will do
+	m_terms.Resize(count);
+	if (blockCount)
+	{
+		m_jobs.ParallelFor(blockCount, BLOCK_GRAIN, [&](UINT begin, UINT end, UINT)
+		{
+			LightingModel::Compute(mat, lights, XMFLOAT3(0.0f, 0.0f, 0.0f), samples,
+				begin*BLOCK_SIZE, MathHelper::Min(end*BLOCK_SIZE, count), m_terms);
+		});
+	}
+
+	auto lit = std::chrono::high_resolution_clock::now();
+
+	if (settings.OcclusionRays && heights)
+	{
+		ComputeOcclusion(samples, heights, settings);
+	}
+	else
+	{
+		m_occlusion.assign(count, 1.0f);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	colors.resize(count);
+	float occlusionSum = 0.0f;
+	for (UINT i = 0; i < count; ++i)
+	{
+		float ao = m_occlusion[i];
+		colors[i] = XMFLOAT4(
+			m_terms.AmbientR[i] * ao + m_terms.DiffuseR[i],
+			m_terms.AmbientG[i] * ao + m_terms.DiffuseG[i],
+			m_terms.AmbientB[i] * ao + m_terms.DiffuseB[i],
+			mat.Diffuse.w);
+		occlusionSum += ao;
+	}
+
+	m_stats.Vertices = count;
+	m_stats.Rays = settings.OcclusionRays && heights ? settings.OcclusionRays : 0;
+	m_stats.AverageOcclusion = count ? occlusionSum / count : 1.0f;
+	m_stats.LightingMilliseconds = std::chrono::duration<double, std::milli>(lit - start).count();
+	m_stats.OcclusionMilliseconds = std::chrono::duration<double, std::milli>(end - lit).count();
+}
+
+void LightBaker::ComputeOcclusion(const LightingModel::SampleSet& samples, const HeightField& heights,
+	const Settings& settings)
+{
+	//MathHelper draws from rand(), so the directions are drawn here, before
+	//the workers start, and shared by all vertices
+	if (m_directions.size() != settings.OcclusionRays)
+	{
+		m_directions.resize(settings.OcclusionRays);
+		for (UINT r = 0; r < settings.OcclusionRays; ++r)
+		{
+			XMStoreFloat3(&m_directions[r], MathHelper::RandHemisphereUnitVec3(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+		}
+	}
+
+	const UINT count = samples.Count;
+	const UINT blockCount = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const UINT steps = MathHelper::Max(settings.OcclusionSteps, 1u);
+	const float stepLength = settings.OcclusionDistance / steps;
+
+	m_occlusion.resize(count);
+	m_jobs.ParallelFor(blockCount, BLOCK_GRAIN, [&](UINT begin, UINT end, UINT)
+	{
+		for (UINT i = begin*BLOCK_SIZE; i < MathHelper::Min(end*BLOCK_SIZE, count); ++i)
+		{
+			XMVECTOR n = XMVectorSet(samples.NormalX[i], samples.NormalY[i], samples.NormalZ[i], 0.0f);
+			XMVECTOR origin = XMVectorSet(samples.PositionX[i], samples.PositionY[i], samples.PositionZ[i], 1.0f);
+			XMFLOAT3 start;
+			XMStoreFloat3(&start, XMVectorAdd(origin, XMVectorScale(n, RAY_OFFSET)));
+
+			//A tangent frame turned about the normal by a golden ratio step
+			//per vertex, so neighbours do not share the same pattern
+			XMVECTOR axis = fabsf(samples.NormalY[i]) < 0.99f ? XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+			XMVECTOR t = XMVector3Normalize(XMVector3Cross(axis, n));
+			XMVECTOR b = XMVector3Cross(n, t);
+			float angle = 2.0f*MathHelper::Pi*(i*0.618034f - floorf(i*0.618034f));
+			XMVECTOR tangent = XMVectorAdd(XMVectorScale(t, cosf(angle)), XMVectorScale(b, sinf(angle)));
+			XMVECTOR bitangent = XMVector3Cross(n, tangent);
+
+			float open = 0.0f;
+			float total = 0.0f;
+			for (size_t r = 0; r < m_directions.size(); ++r)
+			{
+				const XMFLOAT3& d = m_directions[r];
+				XMFLOAT3 step;
+				XMStoreFloat3(&step, XMVectorScale(XMVectorAdd(XMVectorAdd(XMVectorScale(tangent, d.x),
+					XMVectorScale(n, d.y)), XMVectorScale(bitangent, d.z)), stepLength));
+
+				bool blocked = false;
+				XMFLOAT3 p = start;
+				for (UINT s = 0; s < steps && !blocked; ++s)
+				{
+					p.x += step.x;
+					p.y += step.y;
+					p.z += step.z;
+					blocked = p.y < heights(p.x, p.z);
+				}
+
+				//Cosine weighted, like the ambient light reaching the surface
+				total += d.y;
+				if (!blocked)
+					open += d.y;
+			}
+
+			m_occlusion[i] = total > 0.0f ? open / total : 1.0f;
+		}
+	});
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+//Static lighting baked into vertex colors
+//
+//Bake() runs the LightingModel on the vertices of geometry that never moves,
+//under lights that never move, and stores ambient + diffuse per vertex. The
+//specular term depends on the eye and is left to the pixel shader or dropped.
+//
+//Ambient light can be darkened by hemisphere occlusion: rays around the
+//normal, from one set of directions drawn with
+//MathHelper::RandHemisphereUnitVec3 and turned by a different angle at every
+//vertex, are marched against a height field. The ambient term is scaled by
+//the cosine weighted share of rays that escape.
+//
+//Vertices are split over the workers of the job system in blocks of 8, the
+//width of the LightingModel batches, so the result does not depend on the
+//number of threads.
+
+#ifndef _LIGHTBAKER_H_
+#define _LIGHTBAKER_H_
+
+#include "LightingModel.h"
+#include "JobSystem.h"
+
+#include<functional>
+#include<vector>
+
+class LightBaker
+{
+public:
+	//Height of the occluding surface at (x, z), like GetHillHeight. Called
+	//from the workers at once.
+	typedef std::function<float(float, float)> HeightField;
+
+	struct Settings
+	{
+		UINT OcclusionRays;		//0 bakes without occlusion
+		UINT OcclusionSteps;	//Height tests along each ray
+		float OcclusionDistance;	//Length of the rays
+
+		Settings() :OcclusionRays(32), OcclusionSteps(16), OcclusionDistance(20.0f) {}
+	};
+
+	struct Stats
+	{
+		UINT Vertices;
+		UINT Rays;
+
+		//Average of the ambient scale over the vertices, 1 without occlusion
+		float AverageOcclusion;
+
+		double LightingMilliseconds;
+		double OcclusionMilliseconds;
+	};
+
+public:
+	LightBaker(JobSystem& jobs = JobSystem::Default());
+
+	//Ambient times occlusion plus diffuse for every sample, rgb, with the
+	//alpha of the diffuse material. colors is resized to the samples.
+	//heights may be empty when OcclusionRays is 0.
+	void Bake(const Material& mat, const LightingModel::LightSet& lights,
+		const LightingModel::SampleSet& samples, const HeightField& heights,
+		const Settings& settings, std::vector<XMFLOAT4>& colors);
+
+	//The ambient scale of every sample of the last Bake(), in [0, 1]
+	const std::vector<float>& Occlusion() const { return m_occlusion; }
+
+	const Stats& LastStats() const { return m_stats; }
+
+private:
+	void ComputeOcclusion(const LightingModel::SampleSet& samples, const HeightField& heights,
+		const Settings& settings);
+
+private:
+	JobSystem& m_jobs;
+
+	//Unit vectors around +y, y is the cosine to the normal
+	std::vector<XMFLOAT3> m_directions;
+
+	LightingModel::TermSet m_terms;
+	std::vector<float> m_occlusion;
+
+	Stats m_stats;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#include"LightClusters.h"
+#include"MathHelper.h"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+
+namespace
+{
+	//Lights per chunk at least, a light touches a handful of clusters
+	const UINT LIGHT_GRAIN = 64;
+
+	//Clusters per chunk of the prefix sums
+	const UINT CLUSTER_GRAIN = 256;
+
+	//Distance from the sphere center to the box, squared, against r*r
+	bool SphereIntersectsBox(const XMFLOAT3& center, float radius, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+	{
+		float dx = MathHelper::Max(MathHelper::Max(boxMin.x - center.x, center.x - boxMax.x), 0.0f);
+		float dy = MathHelper::Max(MathHelper::Max(boxMin.y - center.y, center.y - boxMax.y), 0.0f);
+		float dz = MathHelper::Max(MathHelper::Max(boxMin.z - center.z, center.z - boxMax.z), 0.0f);
+		return dx*dx + dy*dy + dz*dz <= radius*radius;
+	}
+
+	//Tile of a coordinate in [-1, 1], clamped to [0, count)
+	int TileOf(float ndc, UINT count)
+	{
+		int tile = static_cast<int>(floorf((ndc + 1.0f)*0.5f*count));
+		return MathHelper::Clamp(tile, 0, static_cast<int>(count) - 1);
+	}
+}
+
+LightClusters::LightClusters(UINT clustersX, UINT clustersY, UINT clustersZ, JobSystem& jobs)
+	:m_jobs(jobs),
+	m_clustersX(MathHelper::Max(clustersX, 1u)), m_clustersY(MathHelper::Max(clustersY, 1u)), m_clustersZ(MathHelper::Max(clustersZ, 1u)),
+	m_nearZ(1.0f), m_farZ(1000.0f), m_tanHalfX(1.0f), m_tanHalfY(1.0f)
+{
+	ZeroMemory(&m_constants, sizeof(m_constants));
+	ZeroMemory(&m_stats, sizeof(m_stats));
+
+	m_clusters.resize(ClusterCount());
+	ZeroMemory(&m_clusters[0], sizeof(Cluster)*m_clusters.size());
+}
+
+void LightClusters::SetProjection(float fovAngleY, float aspectRatio, float nearZ, float farZ, UINT width, UINT height)
+{
+	m_nearZ = nearZ;
+	m_farZ = farZ;
+	m_tanHalfY = tanf(0.5f*fovAngleY);
+	m_tanHalfX = m_tanHalfY*aspectRatio;
+
+	//slice = log2(z/near) / log2(far/near) * slices
+	const float sliceScale = m_clustersZ / log2f(farZ / nearZ);
+
+	m_constants.Scale = XMFLOAT4(
+		static_cast<float>(m_clustersX) / MathHelper::Max(width, 1u),
+		static_cast<float>(m_clustersY) / MathHelper::Max(height, 1u),
+		sliceScale,
+		-log2f(nearZ)*sliceScale);
+	m_constants.Dimensions[0] = m_clustersX;
+	m_constants.Dimensions[1] = m_clustersY;
+	m_constants.Dimensions[2] = m_clustersZ;
+	m_constants.Dimensions[3] = 0;
+
+	//Tiles run left to right and top to bottom, y is up in view space
+	m_clusterMin.resize(ClusterCount());
+	m_clusterMax.resize(ClusterCount());
+	for (UINT k = 0; k < m_clustersZ; ++k)
+	{
+		float z0 = nearZ*powf(farZ / nearZ, static_cast<float>(k) / m_clustersZ);
+		float z1 = nearZ*powf(farZ / nearZ, static_cast<float>(k + 1) / m_clustersZ);
+
+		for (UINT j = 0; j < m_clustersY; ++j)
+		{
+			float top = (1.0f - 2.0f*j / m_clustersY)*m_tanHalfY;
+			float bottom = (1.0f - 2.0f*(j + 1) / m_clustersY)*m_tanHalfY;
+
+			for (UINT i = 0; i < m_clustersX; ++i)
+			{
+				float left = (-1.0f + 2.0f*i / m_clustersX)*m_tanHalfX;
+				float right = (-1.0f + 2.0f*(i + 1) / m_clustersX)*m_tanHalfX;
+
+				//The side planes go through the eye, the extremes are at
+				//either depth
+				UINT c = (k*m_clustersY + j)*m_clustersX + i;
+				m_clusterMin[c] = XMFLOAT3(MathHelper::Min(left*z0, left*z1), MathHelper::Min(bottom*z0, bottom*z1), z0);
+				m_clusterMax[c] = XMFLOAT3(MathHelper::Max(right*z0, right*z1), MathHelper::Max(top*z0, top*z1), z1);
+			}
+		}
+	}
+}
+
+UINT LightClusters::SliceOf(float viewZ) const
+{
+	int slice = static_cast<int>(floorf(log2f(MathHelper::Max(viewZ, m_nearZ))*m_constants.Scale.z + m_constants.Scale.w));
+	return static_cast<UINT>(MathHelper::Clamp(slice, 0, static_cast<int>(m_clustersZ) - 1));
+}
+
+UINT LightClusters::ClusterOf(float x, float y, float viewZ) const
+{
+	UINT i = MathHelper::Min(static_cast<UINT>(MathHelper::Max(x*m_constants.Scale.x, 0.0f)), m_clustersX - 1);
+	UINT j = MathHelper::Min(static_cast<UINT>(MathHelper::Max(y*m_constants.Scale.y, 0.0f)), m_clustersY - 1);
+	return (SliceOf(viewZ)*m_clustersY + j)*m_clustersX + i;
+}
+
+void LightClusters::BinLight(const XMFLOAT3& center, float radius, UINT light, Chunk& chunk) const
+{
+	float zMin = center.z - radius;
+	float zMax = center.z + radius;
+	if (zMax < m_nearZ || zMin > m_farZ)
+		return;
+
+	zMin = MathHelper::Max(zMin, m_nearZ);
+	zMax = MathHelper::Min(zMax, m_farZ);
+
+	//Bounds of x/z and y/z over the box around the sphere, the extremes
+	//are at the nearest or farthest depth
+	float left = MathHelper::Min((center.x - radius) / zMin, (center.x - radius) / zMax) / m_tanHalfX;
+	float right = MathHelper::Max((center.x + radius) / zMin, (center.x + radius) / zMax) / m_tanHalfX;
+	float bottom = MathHelper::Min((center.y - radius) / zMin, (center.y - radius) / zMax) / m_tanHalfY;
+	float top = MathHelper::Max((center.y + radius) / zMin, (center.y + radius) / zMax) / m_tanHalfY;
+	if (right < -1.0f || left > 1.0f || top < -1.0f || bottom > 1.0f)
+		return;
+
+	const int i0 = TileOf(left, m_clustersX);
+	const int i1 = TileOf(right, m_clustersX);
+	const int j0 = TileOf(-top, m_clustersY);
+	const int j1 = TileOf(-bottom, m_clustersY);
+	const UINT k0 = SliceOf(zMin);
+	const UINT k1 = SliceOf(zMax);
+
+	bool visible = false;
+	for (UINT k = k0; k <= k1; ++k)
+	{
+		for (int j = j0; j <= j1; ++j)
+		{
+			UINT c = (k*m_clustersY + j)*m_clustersX + i0;
+			for (int i = i0; i <= i1; ++i, ++c)
+			{
+				if (!SphereIntersectsBox(center, radius, m_clusterMin[c], m_clusterMax[c]))
+					continue;
+
+				chunk.Pairs.push_back(c);
+				chunk.Pairs.push_back(light);
+				++chunk.Counts[c];
+				visible = true;
+			}
+		}
+	}
+
+	if (visible)
+		++chunk.VisibleLights;
+}
+
+void LightClusters::Build(CXMMATRIX view, const PointLight* pointLights, UINT pointCount,
+	const SpotLight* spotLights, UINT spotCount)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const UINT clusterCount = ClusterCount();
+	const UINT lightCount = pointCount + spotCount;
+
+	//Spot lights are binned by their range sphere as well, after the
+	//points, as pointCount + i
+	const UINT chunkCount = lightCount ? m_jobs.ChunkCount(lightCount, LIGHT_GRAIN) : 0;
+	if (m_chunks.size() < chunkCount)
+	{
+		m_chunks.resize(chunkCount);
+	}
+
+	XMFLOAT4X4 viewMatrix;
+	XMStoreFloat4x4(&viewMatrix, view);
+
+	if (lightCount)
+	{
+		m_jobs.ParallelFor(lightCount, LIGHT_GRAIN, [&](UINT begin, UINT end, UINT slice)
+		{
+			Chunk& chunk = m_chunks[slice];
+			chunk.Pairs.clear();
+			chunk.Counts.assign(clusterCount, 0);
+			chunk.VisibleLights = 0;
+
+			XMMATRIX V = XMLoadFloat4x4(&viewMatrix);
+			for (UINT i = begin; i < end; ++i)
+			{
+				const XMFLOAT3& position = i < pointCount ? pointLights[i].Position : spotLights[i - pointCount].Position;
+				float range = i < pointCount ? pointLights[i].Range : spotLights[i - pointCount].Range;
+
+				XMFLOAT3 center;
+				XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&position), V));
+				BinLight(center, range, i, chunk);
+			}
+		});
+	}
+
+	auto binned = std::chrono::high_resolution_clock::now();
+
+	//Totals per cluster, held in PointCount until the split below, then
+	//offsets of the clusters, then offsets of every chunk within every
+	//cluster. The first and last in parallel.
+	m_jobs.ParallelFor(clusterCount, CLUSTER_GRAIN, [&](UINT begin, UINT end, UINT)
+	{
+		for (UINT c = begin; c < end; ++c)
+		{
+			UINT total = 0;
+			for (UINT k = 0; k < chunkCount; ++k)
+			{
+				total += m_chunks[k].Counts[c];
+			}
+			m_clusters[c].PointCount = total;
+		}
+	});
+
+	UINT offset = 0;
+	m_stats.MaxClusterLights = 0;
+	for (UINT c = 0; c < clusterCount; ++c)
+	{
+		m_clusters[c].Offset = offset;
+		offset += m_clusters[c].PointCount;
+		m_stats.MaxClusterLights = MathHelper::Max(m_stats.MaxClusterLights, m_clusters[c].PointCount);
+	}
+
+	m_jobs.ParallelFor(clusterCount, CLUSTER_GRAIN, [&](UINT begin, UINT end, UINT)
+	{
+		for (UINT c = begin; c < end; ++c)
+		{
+			UINT cursor = m_clusters[c].Offset;
+			for (UINT k = 0; k < chunkCount; ++k)
+			{
+				UINT count = m_chunks[k].Counts[c];
+				m_chunks[k].Counts[c] = cursor;
+				cursor += count;
+			}
+		}
+	});
+
+	//Every chunk writes its own part of each list
+	m_indices.resize(offset);
+	if (chunkCount)
+	{
+		m_jobs.ParallelFor(chunkCount, 1, [&](UINT begin, UINT end, UINT)
+		{
+			for (UINT k = begin; k < end; ++k)
+			{
+				Chunk& chunk = m_chunks[k];
+				for (size_t p = 0; p < chunk.Pairs.size(); p += 2)
+				{
+					m_indices[chunk.Counts[chunk.Pairs[p]]++] = chunk.Pairs[p + 1];
+				}
+			}
+		});
+	}
+
+	//Lists are in light order, the points end where the spots start. Spot
+	//indices become indices into the spot lights.
+	m_jobs.ParallelFor(clusterCount, CLUSTER_GRAIN, [&](UINT begin, UINT end, UINT)
+	{
+		for (UINT c = begin; c < end; ++c)
+		{
+			Cluster& cluster = m_clusters[c];
+			UINT* first = m_indices.empty() ? 0 : &m_indices[0] + cluster.Offset;
+			UINT* last = first + cluster.PointCount;
+			UINT* spots = std::lower_bound(first, last, pointCount);
+
+			cluster.SpotCount = static_cast<UINT>(last - spots);
+			cluster.PointCount = static_cast<UINT>(spots - first);
+			cluster.Pad = 0;
+
+			for (UINT* s = spots; s != last; ++s)
+			{
+				*s -= pointCount;
+			}
+		}
+	});
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	m_stats.Lights = lightCount;
+	m_stats.VisibleLights = 0;
+	for (UINT k = 0; k < chunkCount; ++k)
+	{
+		m_stats.VisibleLights += m_chunks[k].VisibleLights;
+	}
+	m_stats.Indices = offset;
+	m_stats.BinMilliseconds = std::chrono::duration<double, std::milli>(binned - start).count();
+	m_stats.CompactMilliseconds = std::chrono::duration<double, std::milli>(end - binned).count();
+}
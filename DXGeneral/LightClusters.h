@@ -0,0 +1,128 @@
+#pragma once
+
+//Clustered light culling
+//
+//The view frustum is split into a grid of clusters: tiles of the screen
+//times slices of view depth, exponentially spaced so clusters stay close to
+//cubes. Build() bins every point and spot light into the clusters its range
+//sphere touches and writes one compact list of light indices per cluster, so
+//a pixel only evaluates the lights of its own cluster.
+//
+//Binning runs on the workers of the job system, one contiguous range of
+//lights per chunk. The chunks count their clusters, a prefix sum over
+//clusters and chunks places every chunk's part of every list, and the chunks
+//scatter their indices in parallel. Lists come out in light order, points
+//first, so the result does not depend on the number of threads.
+//
+//Constants() and the cluster and index arrays are laid out for the pixel
+//shader, see lightingPS.hlsl; ClusterOf() is the same lookup on the CPU.
+
+#ifndef _LIGHTCLUSTERS_H_
+#define _LIGHTCLUSTERS_H_
+
+#include "LightHelper.h"
+#include "JobSystem.h"
+
+#include<vector>
+
+class LightClusters
+{
+public:
+	//The lights of a cluster are LightIndices()[Offset, Offset+PointCount)
+	//into the point lights, then SpotCount indices into the spot lights.
+	//A uint4 in HLSL.
+	struct Cluster
+	{
+		UINT Offset;
+		UINT PointCount;
+		UINT SpotCount;
+		UINT Pad;
+	};
+
+	//cluster = (x*Scale.x, y*Scale.y, log2(viewZ)*Scale.z + Scale.w) for the
+	//pixel (x, y), clamped to Dimensions. 32 bytes of a constant buffer.
+	struct ShaderConstants
+	{
+		XMFLOAT4 Scale;
+		UINT Dimensions[4];
+	};
+
+	struct Stats
+	{
+		UINT Lights;
+		UINT VisibleLights;		//In at least one cluster
+		UINT Indices;			//Light and cluster pairs
+		UINT MaxClusterLights;
+
+		double BinMilliseconds;		//View space bounds and cluster ranges of the lights
+		double CompactMilliseconds;	//Prefix sums and the scatter into lists
+	};
+
+public:
+	LightClusters(UINT clustersX = 16, UINT clustersY = 9, UINT clustersZ = 24, JobSystem& jobs = JobSystem::Default());
+
+	//The camera of the frames to come, as given to XMMatrixPerspectiveFovLH,
+	//and the size of the viewport in pixels
+	void SetProjection(float fovAngleY, float aspectRatio, float nearZ, float farZ, UINT width, UINT height);
+
+	//Bins the lights, in world space, for the camera view
+	void Build(CXMMATRIX view, const PointLight* pointLights, UINT pointCount,
+		const SpotLight* spotLights, UINT spotCount);
+
+	UINT ClusterCount() const { return m_clustersX*m_clustersY*m_clustersZ; }
+
+	//Cluster of the pixel (x, y) at viewZ
+	UINT ClusterOf(float x, float y, float viewZ) const;
+
+	const std::vector<Cluster>& Clusters() const { return m_clusters; }
+	const std::vector<UINT>& LightIndices() const { return m_indices; }
+	const ShaderConstants& Constants() const { return m_constants; }
+
+	const Stats& LastStats() const { return m_stats; }
+
+private:
+	//A range of lights binned by one worker
+	struct Chunk
+	{
+		//Cluster and light index, in light order
+		std::vector<UINT> Pairs;
+
+		//Pairs per cluster, then where the chunk writes into each list
+		std::vector<UINT> Counts;
+
+		UINT VisibleLights;
+	};
+
+	void BinLight(const XMFLOAT3& center, float radius, UINT light, Chunk& chunk) const;
+	UINT SliceOf(float viewZ) const;
+
+private:
+	JobSystem& m_jobs;
+
+	UINT m_clustersX;
+	UINT m_clustersY;
+	UINT m_clustersZ;
+
+	float m_nearZ;
+	float m_farZ;
+
+	//Half extents of the view frustum at z = 1
+	float m_tanHalfX;
+	float m_tanHalfY;
+
+	//View space bounds of every cluster
+	std::vector<XMFLOAT3> m_clusterMin;
+	std::vector<XMFLOAT3> m_clusterMax;
+
+	ShaderConstants m_constants;
+
+	//Kept between frames for their allocations
+	std::vector<Chunk> m_chunks;
+
+	std::vector<Cluster> m_clusters;
+	std::vector<UINT> m_indices;
+
+	Stats m_stats;
+};
+
+#endif
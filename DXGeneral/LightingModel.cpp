@@ -0,0 +1,800 @@
+#include"LightingModel.h"
+#include"MathHelper.h"
+#include<chrono>
+#include<cmath>
+
+#if defined(__AVX__)
+#include<immintrin.h>
+#define LIGHT_AVX
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include<emmintrin.h>
+#define LIGHT_SSE
+#endif
+
+namespace
+{
+	//Every set is padded to this many entries
+	const UINT Padding = 8;
+
+	UINT PaddedCount(UINT count)
+	{
+		return (count + Padding - 1) / Padding*Padding;
+	}
+
+	void Pad(std::vector<float>& v, UINT count)
+	{
+		v.assign(PaddedCount(count), 0.0f);
+	}
+
+	//The few vector operations the equations need, on the widest registers
+	//available. Masks are all bits set per lane that is true.
+#if defined(LIGHT_AVX)
+	typedef __m256 Vec;
+	const UINT Width = 8;
+
+	inline Vec Set1(float f) { return _mm256_set1_ps(f); }
+	inline Vec Load(const float* p) { return _mm256_loadu_ps(p); }
+	inline void Store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+	inline Vec Add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+	inline Vec Sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+	inline Vec Mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+	inline Vec Div(Vec a, Vec b) { return _mm256_div_ps(a, b); }
+	inline Vec Min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+	inline Vec Max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+	inline Vec Sqrt(Vec a) { return _mm256_sqrt_ps(a); }
+	inline Vec Greater(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	inline Vec LessEqual(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	inline Vec And(Vec a, Vec b) { return _mm256_and_ps(a, b); }
+	inline Vec Select(Vec mask, Vec a, Vec b) { return _mm256_blendv_ps(b, a, mask); }
+	inline bool Any(Vec mask) { return _mm256_movemask_ps(mask) != 0; }
+
+	//x = 2^Exponent * Mantissa with the mantissa in [1, 2), x > 0
+	inline Vec Exponent(Vec x)
+	{
+		//No 256 bit integer shifts before AVX2, shift the halves
+		__m256i bits = _mm256_castps_si256(x);
+		__m128i lo = _mm_srli_epi32(_mm256_castsi256_si128(bits), 23);
+		__m128i hi = _mm_srli_epi32(_mm256_extractf128_si256(bits, 1), 23);
+		__m256i e = _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		return _mm256_sub_ps(_mm256_cvtepi32_ps(e), _mm256_set1_ps(127.0f));
+	}
+
+	inline Vec Mantissa(Vec x)
+	{
+		Vec bits = _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x007FFFFF)));
+		return _mm256_or_ps(bits, _mm256_set1_ps(1.0f));
+	}
+
+	//x rounded to the nearest integer n, and 2^n
+	inline void Round(Vec x, Vec& n, Vec& pow2n)
+	{
+		__m256i i = _mm256_cvtps_epi32(x);
+		n = _mm256_cvtepi32_ps(i);
+
+		const __m128i bias = _mm_set1_epi32(127);
+		__m128i lo = _mm_slli_epi32(_mm_add_epi32(_mm256_castsi256_si128(i), bias), 23);
+		__m128i hi = _mm_slli_epi32(_mm_add_epi32(_mm256_extractf128_si256(i, 1), bias), 23);
+		pow2n = _mm256_castsi256_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+	}
+#elif defined(LIGHT_SSE)
+	typedef __m128 Vec;
+	const UINT Width = 4;
+
+	inline Vec Set1(float f) { return _mm_set1_ps(f); }
+	inline Vec Load(const float* p) { return _mm_loadu_ps(p); }
+	inline void Store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+	inline Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+	inline Vec Sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+	inline Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+	inline Vec Div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+	inline Vec Min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+	inline Vec Max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+	inline Vec Sqrt(Vec a) { return _mm_sqrt_ps(a); }
+	inline Vec Greater(Vec a, Vec b) { return _mm_cmpgt_ps(a, b); }
+	inline Vec LessEqual(Vec a, Vec b) { return _mm_cmple_ps(a, b); }
+	inline Vec And(Vec a, Vec b) { return _mm_and_ps(a, b); }
+	inline Vec Select(Vec mask, Vec a, Vec b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	inline bool Any(Vec mask) { return _mm_movemask_ps(mask) != 0; }
+
+	inline Vec Exponent(Vec x)
+	{
+		__m128i e = _mm_srli_epi32(_mm_castps_si128(x), 23);
+		return _mm_sub_ps(_mm_cvtepi32_ps(e), _mm_set1_ps(127.0f));
+	}
+
+	inline Vec Mantissa(Vec x)
+	{
+		Vec bits = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x007FFFFF)));
+		return _mm_or_ps(bits, _mm_set1_ps(1.0f));
+	}
+
+	inline void Round(Vec x, Vec& n, Vec& pow2n)
+	{
+		__m128i i = _mm_cvtps_epi32(x);
+		n = _mm_cvtepi32_ps(i);
+		pow2n = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23));
+	}
+#else
+	typedef float Vec;
+	const UINT Width = 1;
+
+	inline Vec Set1(float f) { return f; }
+	inline Vec Load(const float* p) { return *p; }
+	inline void Store(float* p, Vec v) { *p = v; }
+	inline Vec Add(Vec a, Vec b) { return a + b; }
+	inline Vec Sub(Vec a, Vec b) { return a - b; }
+	inline Vec Mul(Vec a, Vec b) { return a * b; }
+	inline Vec Div(Vec a, Vec b) { return a / b; }
+	inline Vec Min(Vec a, Vec b) { return a < b ? a : b; }
+	inline Vec Max(Vec a, Vec b) { return a > b ? a : b; }
+	inline Vec Sqrt(Vec a) { return sqrtf(a); }
+	inline Vec Greater(Vec a, Vec b) { return a > b ? 1.0f : 0.0f; }
+	inline Vec LessEqual(Vec a, Vec b) { return a <= b ? 1.0f : 0.0f; }
+	inline Vec And(Vec a, Vec b) { return a * b; }
+	inline Vec Select(Vec mask, Vec a, Vec b) { return mask != 0.0f ? a : b; }
+	inline bool Any(Vec mask) { return mask != 0.0f; }
+#endif
+
+#if defined(LIGHT_AVX) || defined(LIGHT_SSE)
+	//log2 for x > 0, about 1e-7 off. m in [sqrt(1/2), sqrt(2)) and the
+	//series of ln((1+t)/(1-t)) with t = (m-1)/(m+1), |t| < 0.172.
+	inline Vec Log2(Vec x)
+	{
+		const Vec one = Set1(1.0f);
+
+		Vec e = Exponent(x);
+		Vec m = Mantissa(x);
+		Vec big = Greater(m, Set1(1.41421356f));
+		m = Select(big, Mul(m, Set1(0.5f)), m);
+		e = Add(e, And(big, one));
+
+		Vec t = Div(Sub(m, one), Add(m, one));
+		Vec t2 = Mul(t, t);
+		Vec series = Add(Mul(Set1(1.0f / 9.0f), t2), Set1(1.0f / 7.0f));
+		series = Add(Mul(series, t2), Set1(1.0f / 5.0f));
+		series = Add(Mul(series, t2), Set1(1.0f / 3.0f));
+		series = Add(Mul(series, t2), one);
+
+		//2/ln(2)
+		return Add(e, Mul(Mul(t, series), Set1(2.88539008f)));
+	}
+
+	//2^x, about 1e-7 off relative. 2^n times the series of e^(f*ln(2))
+	//for the fraction f in [-1/2, 1/2].
+	inline Vec Exp2(Vec x)
+	{
+		x = Min(Max(x, Set1(-126.0f)), Set1(126.0f));
+
+		Vec n, pow2n;
+		Round(x, n, pow2n);
+		Vec g = Mul(Sub(x, n), Set1(0.693147181f));
+
+		Vec series = Add(Mul(Set1(1.0f / 720.0f), g), Set1(1.0f / 120.0f));
+		series = Add(Mul(series, g), Set1(1.0f / 24.0f));
+		series = Add(Mul(series, g), Set1(1.0f / 6.0f));
+		series = Add(Mul(series, g), Set1(1.0f / 2.0f));
+		series = Add(Mul(series, g), Set1(1.0f));
+		series = Add(Mul(series, g), Set1(1.0f));
+
+		return Mul(series, pow2n);
+	}
+#else
+	inline Vec Log2(Vec x) { return log2f(x); }
+	inline Vec Exp2(Vec x) { return exp2f(x); }
+#endif
+
+	//pow(x, p) for x >= 0 and p > 0, as the GPU does it
+	inline Vec Pow(Vec x, Vec p)
+	{
+		Vec zero = Set1(0.0f);
+		return Select(Greater(x, zero), Exp2(Mul(p, Log2(x))), zero);
+	}
+
+	inline Vec Dot(Vec ax, Vec ay, Vec az, Vec bx, Vec by, Vec bz)
+	{
+		return Add(Add(Mul(ax, bx), Mul(ay, by)), Mul(az, bz));
+	}
+
+	//A light with the material folded into its colors
+	struct PreparedLight
+	{
+		float Position[3];
+		float Direction[3];
+		float Range;
+		float Att[3];
+		float Spot;
+		float Ambient[3];
+		float Diffuse[3];
+		float Specular[3];
+	};
+
+	void PrepareColors(const Material& mat, const XMFLOAT4& ambient, const XMFLOAT4& diffuse, const XMFLOAT4& specular,
+		PreparedLight& light)
+	{
+		light.Ambient[0] = mat.Ambient.x*ambient.x;
+		light.Ambient[1] = mat.Ambient.y*ambient.y;
+		light.Ambient[2] = mat.Ambient.z*ambient.z;
+		light.Diffuse[0] = mat.Diffuse.x*diffuse.x;
+		light.Diffuse[1] = mat.Diffuse.y*diffuse.y;
+		light.Diffuse[2] = mat.Diffuse.z*diffuse.z;
+		light.Specular[0] = mat.Specular.x*specular.x;
+		light.Specular[1] = mat.Specular.y*specular.y;
+		light.Specular[2] = mat.Specular.z*specular.z;
+	}
+
+	//A block of samples and its running sums
+	struct Block
+	{
+		Vec PX, PY, PZ;
+		Vec NX, NY, NZ;
+		Vec EX, EY, EZ;	//toEye
+
+		Vec Ambient[3];
+		Vec Diffuse[3];
+		Vec Specular[3];
+	};
+
+	//diffuse and spec, scaled and masked, of a light whose unit light
+	//vector is (lx, ly, lz)
+	inline void AddDiffuseSpecular(Block& b, const PreparedLight& light, Vec specPower,
+		Vec lx, Vec ly, Vec lz, Vec diffuseFactor, Vec scale, Vec mask)
+	{
+		const Vec zero = Set1(0.0f);
+
+		//reflect(-lightVec, normal)
+		Vec k = Add(diffuseFactor, diffuseFactor);
+		Vec vx = Sub(Mul(k, b.NX), lx);
+		Vec vy = Sub(Mul(k, b.NY), ly);
+		Vec vz = Sub(Mul(k, b.NZ), lz);
+		Vec specFactor = Pow(Max(Dot(vx, vy, vz, b.EX, b.EY, b.EZ), zero), specPower);
+
+		Vec diffuse = Select(mask, Mul(diffuseFactor, scale), zero);
+		Vec spec = Select(mask, Mul(specFactor, scale), zero);
+		for (UINT c = 0; c < 3; ++c)
+		{
+			b.Diffuse[c] = Add(b.Diffuse[c], Mul(diffuse, Set1(light.Diffuse[c])));
+			b.Specular[c] = Add(b.Specular[c], Mul(spec, Set1(light.Specular[c])));
+		}
+	}
+
+	void AddDirectionalLight(Block& b, const PreparedLight& light, Vec specPower)
+	{
+		const Vec zero = Set1(0.0f);
+
+		//the light vector aims opposite the direction the light rays travel
+		Vec lx = Set1(-light.Direction[0]);
+		Vec ly = Set1(-light.Direction[1]);
+		Vec lz = Set1(-light.Direction[2]);
+
+		for (UINT c = 0; c < 3; ++c)
+		{
+			b.Ambient[c] = Add(b.Ambient[c], Set1(light.Ambient[c]));
+		}
+
+		//saturate()
+		Vec diffuseFactor = Min(Max(Dot(b.NX, b.NY, b.NZ, lx, ly, lz), zero), Set1(1.0f));
+		AddDiffuseSpecular(b, light, specPower, lx, ly, lz, diffuseFactor, Set1(1.0f), Greater(diffuseFactor, zero));
+	}
+
+	//Point lights are spot lights without the cone
+	template<bool SPOT>
+	void AddPositionalLight(Block& b, const PreparedLight& light, Vec specPower)
+	{
+		const Vec zero = Set1(0.0f);
+
+		Vec lx = Sub(Set1(light.Position[0]), b.PX);
+		Vec ly = Sub(Set1(light.Position[1]), b.PY);
+		Vec lz = Sub(Set1(light.Position[2]), b.PZ);
+		Vec d = Sqrt(Dot(lx, ly, lz, lx, ly, lz));
+
+		//Range test, the whole light for the whole block when possible
+		Vec inRange = LessEqual(d, Set1(light.Range));
+		if (!Any(inRange))
+			return;
+
+		Vec invD = Div(Set1(1.0f), d);
+		lx = Mul(lx, invD);
+		ly = Mul(ly, invD);
+		lz = Mul(lz, invD);
+
+		//1 / dot(L.Att, float3(1.0f, d, d*d))
+		Vec att = Div(Set1(1.0f), Add(Set1(light.Att[0]), Mul(d, Add(Set1(light.Att[1]), Mul(d, Set1(light.Att[2]))))));
+
+		Vec ambient = And(inRange, Set1(1.0f));
+		if (SPOT)
+		{
+			Vec spot = Pow(Max(Sub(zero, Dot(lx, ly, lz, Set1(light.Direction[0]), Set1(light.Direction[1]), Set1(light.Direction[2]))), zero),
+				Set1(light.Spot));
+			ambient = Mul(ambient, spot);
+			att = Mul(att, spot);
+		}
+
+		for (UINT c = 0; c < 3; ++c)
+		{
+			b.Ambient[c] = Add(b.Ambient[c], Mul(ambient, Set1(light.Ambient[c])));
+		}
+
+		Vec diffuseFactor = Dot(lx, ly, lz, b.NX, b.NY, b.NZ);
+		AddDiffuseSpecular(b, light, specPower, lx, ly, lz, diffuseFactor, att, And(inRange, Greater(diffuseFactor, zero)));
+	}
+
+	inline XMFLOAT3 Normalize(const XMFLOAT3& v)
+	{
+		XMFLOAT3 result;
+		XMStoreFloat3(&result, XMVector3Normalize(XMLoadFloat3(&v)));
+		return result;
+	}
+
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x*b.x + a.y*b.y + a.z*b.z;
+	}
+
+	//reflect(i, n) = i - 2*dot(i, n)*n
+	inline XMFLOAT3 Reflect(const XMFLOAT3& i, const XMFLOAT3& n)
+	{
+		float k = 2.0f*Dot(i, n);
+		return XMFLOAT3(i.x - k*n.x, i.y - k*n.y, i.z - k*n.z);
+	}
+
+	inline XMFLOAT4 Mul(const XMFLOAT4& a, const XMFLOAT4& b)
+	{
+		return XMFLOAT4(a.x*b.x, a.y*b.y, a.z*b.z, a.w*b.w);
+	}
+
+	inline XMFLOAT4 Scale(float s, const XMFLOAT4& v)
+	{
+		return XMFLOAT4(s*v.x, s*v.y, s*v.z, s*v.w);
+	}
+
+	inline void Accumulate(XMFLOAT4& sum, const XMFLOAT4& v)
+	{
+		sum.x += v.x;
+		sum.y += v.y;
+		sum.z += v.z;
+		sum.w += v.w;
+	}
+}
+
+void LightingModel::SampleSet::Resize(UINT count)
+{
+	Count = count;
+	Pad(PositionX, count);
+	Pad(PositionY, count);
+	Pad(PositionZ, count);
+	Pad(NormalX, count);
+	Pad(NormalY, count);
+	Pad(NormalZ, count);
+}
+
+void LightingModel::SampleSet::Set(UINT i, const XMFLOAT3& position, const XMFLOAT3& normal)
+{
+	PositionX[i] = position.x;
+	PositionY[i] = position.y;
+	PositionZ[i] = position.z;
+	NormalX[i] = normal.x;
+	NormalY[i] = normal.y;
+	NormalZ[i] = normal.z;
+}
+
+void LightingModel::TermSet::Resize(UINT count)
+{
+	Count = count;
+	Pad(AmbientR, count);
+	Pad(AmbientG, count);
+	Pad(AmbientB, count);
+	Pad(DiffuseR, count);
+	Pad(DiffuseG, count);
+	Pad(DiffuseB, count);
+	Pad(SpecularR, count);
+	Pad(SpecularG, count);
+	Pad(SpecularB, count);
+}
+
+XMFLOAT4 LightingModel::TermSet::LitColor(UINT i, const Material& mat) const
+{
+	return XMFLOAT4(
+		AmbientR[i] + DiffuseR[i] + SpecularR[i],
+		AmbientG[i] + DiffuseG[i] + SpecularG[i],
+		AmbientB[i] + DiffuseB[i] + SpecularB[i],
+		mat.Diffuse.w);
+}
+
+const char* LightingModel::InstructionSet()
+{
+#if defined(LIGHT_AVX)
+	return "AVX";
+#elif defined(LIGHT_SSE)
+	return "SSE2";
+#else
+	return "Scalar";
+#endif
+}
+
+void LightingModel::ComputeDirectionalLight(const Material& mat, const DirectionalLight& L,
+	const XMFLOAT3& normal, const XMFLOAT3& toEye,
+	XMFLOAT4& ambient, XMFLOAT4& diffuse, XMFLOAT4& spec)
+{
+	//Initialize outputs
+	ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	diffuse = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	spec = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	//the light vector aims opposite the direction the light rays travel
+	XMFLOAT3 lightVec(-L.Direction.x, -L.Direction.y, -L.Direction.z);
+
+	//Add ambient term
+	ambient = Mul(mat.Ambient, L.Ambient);
+
+	//Add diffuse and specular term
+	float diffuseFactor = MathHelper::Clamp(Dot(normal, lightVec), 0.0f, 1.0f);
+
+	if (diffuseFactor > 0.0f)
+	{
+		XMFLOAT3 v = Reflect(L.Direction, normal);
+		float specFactor = powf(MathHelper::Max(Dot(v, toEye), 0.0f), mat.Specular.w);
+
+		diffuse = Scale(diffuseFactor, Mul(mat.Diffuse, L.Diffuse));
+		spec = Scale(specFactor, Mul(mat.Specular, L.Specular));
+	}
+}
+
+void LightingModel::ComputePointLight(const Material& mat, const PointLight& L,
+	const XMFLOAT3& pos, const XMFLOAT3& normal, const XMFLOAT3& toEye,
+	XMFLOAT4& ambient, XMFLOAT4& diffuse, XMFLOAT4& spec)
+{
+	//Initialize outputs
+	ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	diffuse = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	spec = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	//light vector
+	XMFLOAT3 lightVec(L.Position.x - pos.x, L.Position.y - pos.y, L.Position.z - pos.z);
+
+	//distance from surface to light
+	float d = sqrtf(Dot(lightVec, lightVec));
+
+	//Range test
+	if (d > L.Range)
+		return;
+
+	//Normalize the lightVector
+	lightVec = XMFLOAT3(lightVec.x / d, lightVec.y / d, lightVec.z / d);
+
+	//Ambient term
+	ambient = Mul(mat.Ambient, L.Ambient);
+
+	//Add diffuse the specular term
+	float diffuseFactor = Dot(lightVec, normal);
+
+	if (diffuseFactor > 0.0f)
+	{
+		XMFLOAT3 v = Reflect(XMFLOAT3(-lightVec.x, -lightVec.y, -lightVec.z), normal);
+		float specFactor = powf(MathHelper::Max(Dot(v, toEye), 0.0f), mat.Specular.w);
+
+		diffuse = Scale(diffuseFactor, Mul(mat.Diffuse, L.Diffuse));
+		spec = Scale(specFactor, Mul(mat.Specular, L.Specular));
+	}
+
+	//Attenuation
+	float att = 1.0f / Dot(L.Att, XMFLOAT3(1.0f, d, d*d));
+
+	//Ambient will not be affected
+	diffuse = Scale(att, diffuse);
+	spec = Scale(att, spec);
+}
+
+void LightingModel::ComputeSpotLight(const Material& mat, const SpotLight& L,
+	const XMFLOAT3& pos, const XMFLOAT3& normal, const XMFLOAT3& toEye,
+	XMFLOAT4& ambient, XMFLOAT4& diffuse, XMFLOAT4& spec)
+{
+	//Initialize outputs
+	ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	diffuse = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	spec = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	//light vector
+	XMFLOAT3 lightVec(L.Position.x - pos.x, L.Position.y - pos.y, L.Position.z - pos.z);
+
+	//distance
+	float d = sqrtf(Dot(lightVec, lightVec));
+
+	//Range test
+	if (d > L.Range)
+		return;
+
+	//Normalize the light vector
+	lightVec = XMFLOAT3(lightVec.x / d, lightVec.y / d, lightVec.z / d);
+
+	//Ambient term
+	ambient = Mul(mat.Ambient, L.Ambient);
+
+	//diffuse and specular term
+	float diffuseFactor = Dot(lightVec, normal);
+
+	if (diffuseFactor > 0.0f)
+	{
+		XMFLOAT3 v = Reflect(XMFLOAT3(-lightVec.x, -lightVec.y, -lightVec.z), normal);
+		float specFactor = powf(MathHelper::Max(Dot(v, toEye), 0.0f), mat.Specular.w);
+
+		diffuse = Scale(diffuseFactor, Mul(mat.Diffuse, L.Diffuse));
+		spec = Scale(specFactor, Mul(mat.Specular, L.Specular));
+	}
+
+	//Scale by spotlight factor and attenuation
+	float spot = powf(MathHelper::Max(-Dot(lightVec, L.Direction), 0.0f), L.Spot);
+
+	float att = spot / Dot(L.Att, XMFLOAT3(1.0f, d, d*d));
+
+	ambient = Scale(spot, ambient); //ambient will not affected by attenuation
+	diffuse = Scale(att, diffuse);
+	spec = Scale(att, spec);
+}
+
+void LightingModel::ComputeLights(const Material& mat, const LightSet& lights, const XMFLOAT3& eyePos,
+	const XMFLOAT3& pos, const XMFLOAT3& normal,
+	XMFLOAT4& ambient, XMFLOAT4& diffuse, XMFLOAT4& spec)
+{
+	XMFLOAT3 toEye = Normalize(XMFLOAT3(eyePos.x - pos.x, eyePos.y - pos.y, eyePos.z - pos.z));
+
+	//Start with a sum of zero
+	ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	diffuse = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	spec = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	//Sum the light contribution from each light source
+	XMFLOAT4 A, D, S;
+	for (size_t i = 0; i < lights.Directional.size(); ++i)
+	{
+		ComputeDirectionalLight(mat, lights.Directional[i], normal, toEye, A, D, S);
+		Accumulate(ambient, A);
+		Accumulate(diffuse, D);
+		Accumulate(spec, S);
+	}
+
+	for (size_t i = 0; i < lights.Point.size(); ++i)
+	{
+		ComputePointLight(mat, lights.Point[i], pos, normal, toEye, A, D, S);
+		Accumulate(ambient, A);
+		Accumulate(diffuse, D);
+		Accumulate(spec, S);
+	}
+
+	for (size_t i = 0; i < lights.Spot.size(); ++i)
+	{
+		ComputeSpotLight(mat, lights.Spot[i], pos, normal, toEye, A, D, S);
+		Accumulate(ambient, A);
+		Accumulate(diffuse, D);
+		Accumulate(spec, S);
+	}
+}
+
+void LightingModel::Compute(const Material& mat, const LightSet& lights, const XMFLOAT3& eyePos,
+	const SampleSet& samples, TermSet& terms)
+{
+	terms.Resize(samples.Count);
+	Compute(mat, lights, eyePos, samples, 0, samples.Count, terms);
+}
+
+void LightingModel::Compute(const Material& mat, const LightSet& lights, const XMFLOAT3& eyePos,
+	const SampleSet& samples, UINT begin, UINT end, TermSet& terms)
+{
+	//The material does not change over the samples, fold it in once
+	std::vector<PreparedLight> directional(lights.Directional.size());
+	for (size_t i = 0; i < directional.size(); ++i)
+	{
+		const DirectionalLight& L = lights.Directional[i];
+		directional[i].Direction[0] = L.Direction.x;
+		directional[i].Direction[1] = L.Direction.y;
+		directional[i].Direction[2] = L.Direction.z;
+		PrepareColors(mat, L.Ambient, L.Diffuse, L.Specular, directional[i]);
+	}
+
+	std::vector<PreparedLight> positional(lights.Point.size() + lights.Spot.size());
+	for (size_t i = 0; i < positional.size(); ++i)
+	{
+		PreparedLight& light = positional[i];
+		if (i < lights.Point.size())
+		{
+			const PointLight& L = lights.Point[i];
+			light.Position[0] = L.Position.x;
+			light.Position[1] = L.Position.y;
+			light.Position[2] = L.Position.z;
+			light.Range = L.Range;
+			light.Att[0] = L.Att.x;
+			light.Att[1] = L.Att.y;
+			light.Att[2] = L.Att.z;
+			PrepareColors(mat, L.Ambient, L.Diffuse, L.Specular, light);
+		}
+		else
+		{
+			const SpotLight& L = lights.Spot[i - lights.Point.size()];
+			light.Position[0] = L.Position.x;
+			light.Position[1] = L.Position.y;
+			light.Position[2] = L.Position.z;
+			light.Direction[0] = L.Direction.x;
+			light.Direction[1] = L.Direction.y;
+			light.Direction[2] = L.Direction.z;
+			light.Range = L.Range;
+			light.Att[0] = L.Att.x;
+			light.Att[1] = L.Att.y;
+			light.Att[2] = L.Att.z;
+			light.Spot = L.Spot;
+			PrepareColors(mat, L.Ambient, L.Diffuse, L.Specular, light);
+		}
+	}
+
+	const size_t pointCount = lights.Point.size();
+	const Vec specPower = Set1(mat.Specular.w);
+	const Vec zero = Set1(0.0f);
+
+	//A partial block at the end reads and writes the padding
+	end = MathHelper::Min(end, samples.Count);
+	for (UINT i = begin; i < end; i += Width)
+	{
+		Block b;
+		b.PX = Load(&samples.PositionX[i]);
+		b.PY = Load(&samples.PositionY[i]);
+		b.PZ = Load(&samples.PositionZ[i]);
+		b.NX = Load(&samples.NormalX[i]);
+		b.NY = Load(&samples.NormalY[i]);
+		b.NZ = Load(&samples.NormalZ[i]);
+
+		//normalize(gEyePosW - pin.PosW.xyz)
+		b.EX = Sub(Set1(eyePos.x), b.PX);
+		b.EY = Sub(Set1(eyePos.y), b.PY);
+		b.EZ = Sub(Set1(eyePos.z), b.PZ);
+		Vec invLength = Div(Set1(1.0f), Sqrt(Dot(b.EX, b.EY, b.EZ, b.EX, b.EY, b.EZ)));
+		b.EX = Mul(b.EX, invLength);
+		b.EY = Mul(b.EY, invLength);
+		b.EZ = Mul(b.EZ, invLength);
+
+		for (UINT c = 0; c < 3; ++c)
+		{
+			b.Ambient[c] = zero;
+			b.Diffuse[c] = zero;
+			b.Specular[c] = zero;
+		}
+
+		for (size_t l = 0; l < directional.size(); ++l)
+		{
+			AddDirectionalLight(b, directional[l], specPower);
+		}
+
+		for (size_t l = 0; l < pointCount; ++l)
+		{
+			AddPositionalLight<false>(b, positional[l], specPower);
+		}
+
+		for (size_t l = pointCount; l < positional.size(); ++l)
+		{
+			AddPositionalLight<true>(b, positional[l], specPower);
+		}
+
+		Store(&terms.AmbientR[i], b.Ambient[0]);
+		Store(&terms.AmbientG[i], b.Ambient[1]);
+		Store(&terms.AmbientB[i], b.Ambient[2]);
+		Store(&terms.DiffuseR[i], b.Diffuse[0]);
+		Store(&terms.DiffuseG[i], b.Diffuse[1]);
+		Store(&terms.DiffuseB[i], b.Diffuse[2]);
+		Store(&terms.SpecularR[i], b.Specular[0]);
+		Store(&terms.SpecularG[i], b.Specular[1]);
+		Store(&terms.SpecularB[i], b.Specular[2]);
+	}
+}
+
+void LightingModel::Benchmark(UINT sampleCount, UINT lightCount, UINT iterations, BenchmarkResult& result)
+{
+	//Samples on a bumpy 100x100 plane in rows, neighbours next to each other
+	//like the vertices of a grid or the pixels of a tile. Lights are
+	//scattered above it with ranges so each sample sees a part of them.
+	srand(1);
+
+	SampleSet samples;
+	samples.Resize(sampleCount);
+	const UINT side = static_cast<UINT>(ceil(sqrt(static_cast<double>(sampleCount))));
+	const float spacing = 100.0f / side;
+	for (UINT i = 0; i < sampleCount; ++i)
+	{
+		XMFLOAT3 position(-50.0f + (i % side + MathHelper::RandF())*spacing, MathHelper::RandF(-1.0f, 1.0f),
+			-50.0f + (i / side + MathHelper::RandF())*spacing);
+		XMFLOAT3 normal = Normalize(XMFLOAT3(MathHelper::RandF(-0.5f, 0.5f), 1.0f, MathHelper::RandF(-0.5f, 0.5f)));
+		samples.Set(i, position, normal);
+	}
+
+	//The land material of LightingDemo
+	Material mat;
+	mat.Ambient = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+	mat.Diffuse = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+	mat.Specular = XMFLOAT4(0.2f, 0.2f, 0.2f, 16.0f);
+
+	LightSet lights;
+	lightCount = MathHelper::Max(lightCount, 1u);
+
+	DirectionalLight sun;
+	sun.Ambient = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+	sun.Diffuse = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
+	sun.Specular = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
+	sun.Direction = XMFLOAT3(0.57735f, -0.57735f, 0.57735f);
+	sun.Pad = 0.0f;
+	lights.Directional.push_back(sun);
+
+	for (UINT i = 1; i < lightCount; ++i)
+	{
+		XMFLOAT4 color(MathHelper::RandF(), MathHelper::RandF(), MathHelper::RandF(), 1.0f);
+		XMFLOAT3 position(MathHelper::RandF(-50.0f, 50.0f), MathHelper::RandF(2.0f, 10.0f), MathHelper::RandF(-50.0f, 50.0f));
+		float range = MathHelper::RandF(5.0f, 20.0f);
+
+		if (i & 1)
+		{
+			PointLight point;
+			point.Ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			point.Diffuse = color;
+			point.Specular = color;
+			point.Position = position;
+			point.Range = range;
+			point.Att = XMFLOAT3(0.0f, 0.1f, 0.0f);
+			point.Pad = 0.0f;
+			lights.Point.push_back(point);
+		}
+		else
+		{
+			SpotLight spot;
+			spot.Ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			spot.Diffuse = color;
+			spot.Specular = color;
+			spot.Position = position;
+			spot.Range = range;
+			spot.Direction = Normalize(XMFLOAT3(MathHelper::RandF(-0.5f, 0.5f), -1.0f, MathHelper::RandF(-0.5f, 0.5f)));
+			spot.Spot = MathHelper::RandF(4.0f, 96.0f);
+			spot.Att = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			spot.Pad = 0.0f;
+			lights.Spot.push_back(spot);
+		}
+	}
+
+	const XMFLOAT3 eyePos(0.0f, 30.0f, -60.0f);
+
+	result.SampleCount = sampleCount;
+	result.LightCount = lightCount;
+	iterations = MathHelper::Max(iterations, 1u);
+
+	TermSet terms;
+	terms.Resize(sampleCount);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (UINT i = 0; i < iterations; ++i)
+	{
+		Compute(mat, lights, eyePos, samples, 0, sampleCount, terms);
+	}
+	std::chrono::high_resolution_clock::time_point middle = std::chrono::high_resolution_clock::now();
+
+	//The scalar path once, it is the reference
+	std::vector<XMFLOAT4> reference(sampleCount);
+	for (UINT i = 0; i < sampleCount; ++i)
+	{
+		XMFLOAT3 position(samples.PositionX[i], samples.PositionY[i], samples.PositionZ[i]);
+		XMFLOAT3 normal(samples.NormalX[i], samples.NormalY[i], samples.NormalZ[i]);
+
+		XMFLOAT4 A, D, S;
+		ComputeLights(mat, lights, eyePos, position, normal, A, D, S);
+		reference[i] = XMFLOAT4(A.x + D.x + S.x, A.y + D.y + S.y, A.z + D.z + S.z, mat.Diffuse.w);
+	}
+	std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+	result.BatchMilliseconds = std::chrono::duration<double, std::milli>(middle - start).count() / iterations;
+	result.ScalarMilliseconds = std::chrono::duration<double, std::milli>(end - middle).count();
+
+	double work = static_cast<double>(sampleCount)*lightCount;
+	result.BatchRate = result.BatchMilliseconds > 0.0 ? work / result.BatchMilliseconds*1000.0 : 0.0;
+	result.ScalarRate = result.ScalarMilliseconds > 0.0 ? work / result.ScalarMilliseconds*1000.0 : 0.0;
+
+	result.MaxError = 0.0f;
+	for (UINT i = 0; i < sampleCount; ++i)
+	{
+		XMFLOAT4 lit = terms.LitColor(i, mat);
+		result.MaxError = MathHelper::Max(result.MaxError, fabsf(lit.x - reference[i].x));
+		result.MaxError = MathHelper::Max(result.MaxError, fabsf(lit.y - reference[i].y));
+		result.MaxError = MathHelper::Max(result.MaxError, fabsf(lit.z - reference[i].z));
+	}
+}
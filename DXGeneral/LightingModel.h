@@ -0,0 +1,125 @@
+#pragma once
+
+//The lighting equations of lighting.hlsli on the CPU
+//
+//ComputeDirectionalLight, ComputePointLight and ComputeSpotLight are the
+//HLSL functions line by line on the structs of LightHelper.h, for single
+//samples and as the reference the batched path is checked against.
+//
+//Compute() evaluates a set of lights on many samples at once. Samples are
+//stored structure-of-arrays so one SIMD register holds the same component
+//of several of them: 8 per iteration when built with AVX (/arch:AVX), 4 with
+//SSE2 otherwise. Each light is broadcast over a block of samples, lights out
+//of range of the whole block are skipped. pow() is exp2(log2) like on the
+//GPU, so results differ from the scalar path in the last few bits only.
+
+#ifndef _LIGHTINGMODEL_H_
+#define _LIGHTINGMODEL_H_
+
+#include "LightHelper.h"
+
+#include<vector>
+
+class LightingModel
+{
+public:
+	//Positions and unit normals, padded to a multiple of 8 so the SIMD
+	//loops never need a scalar tail
+	struct SampleSet
+	{
+		std::vector<float> PositionX;
+		std::vector<float> PositionY;
+		std::vector<float> PositionZ;
+		std::vector<float> NormalX;
+		std::vector<float> NormalY;
+		std::vector<float> NormalZ;
+		UINT Count;
+
+		SampleSet() :Count(0) {}
+
+		void Resize(UINT count);
+		void Set(UINT i, const XMFLOAT3& position, const XMFLOAT3& normal);
+	};
+
+	//The ambient, diffuse and specular sums of every sample, rgb. Kept apart
+	//like the outputs of the HLSL functions, so textures can modulate them.
+	struct TermSet
+	{
+		std::vector<float> AmbientR, AmbientG, AmbientB;
+		std::vector<float> DiffuseR, DiffuseG, DiffuseB;
+		std::vector<float> SpecularR, SpecularG, SpecularB;
+		UINT Count;
+
+		TermSet() :Count(0) {}
+
+		void Resize(UINT count);
+
+		//ambient + diffuse + spec with the alpha of the diffuse material,
+		//as at the end of lightingPS.hlsl
+		XMFLOAT4 LitColor(UINT i, const Material& mat) const;
+	};
+
+	struct LightSet
+	{
+		std::vector<DirectionalLight> Directional;
+		std::vector<PointLight> Point;
+		std::vector<SpotLight> Spot;
+
+		UINT Count() const { return static_cast<UINT>(Directional.size() + Point.size() + Spot.size()); }
+	};
+
+	struct BenchmarkResult
+	{
+		UINT SampleCount;
+		UINT LightCount;
+
+		//Average over the iterations
+		double BatchMilliseconds;
+		double ScalarMilliseconds;
+
+		//Samples times lights per second
+		double BatchRate;
+		double ScalarRate;
+
+		//Largest difference of a lit color channel between both paths
+		float MaxError;
+	};
+
+public:
+	static void ComputeDirectionalLight(const Material& mat, const DirectionalLight& L,
+		const XMFLOAT3& normal, const XMFLOAT3& toEye,
+		XMFLOAT4& ambient, XMFLOAT4& diffuse, XMFLOAT4& spec);
+
+	static void ComputePointLight(const Material& mat, const PointLight& L,
+		const XMFLOAT3& pos, const XMFLOAT3& normal, const XMFLOAT3& toEye,
+		XMFLOAT4& ambient, XMFLOAT4& diffuse, XMFLOAT4& spec);
+
+	static void ComputeSpotLight(const Material& mat, const SpotLight& L,
+		const XMFLOAT3& pos, const XMFLOAT3& normal, const XMFLOAT3& toEye,
+		XMFLOAT4& ambient, XMFLOAT4& diffuse, XMFLOAT4& spec);
+
+	//Sum of all lights on one sample with the scalar functions, toward eyePos
+	//as in lightingPS.hlsl. The alpha of the terms is not meaningful.
+	static void ComputeLights(const Material& mat, const LightSet& lights, const XMFLOAT3& eyePos,
+		const XMFLOAT3& pos, const XMFLOAT3& normal,
+		XMFLOAT4& ambient, XMFLOAT4& diffuse, XMFLOAT4& spec);
+
+	//Sum of all lights on every sample. terms is resized to the samples.
+	static void Compute(const Material& mat, const LightSet& lights, const XMFLOAT3& eyePos,
+		const SampleSet& samples, TermSet& terms);
+
+	//Samples [begin, end) only, into a TermSet already sized for the
+	//samples. begin and end are multiples of 8 or end is the sample count,
+	//then ranges can run on different threads.
+	static void Compute(const Material& mat, const LightSet& lights, const XMFLOAT3& eyePos,
+		const SampleSet& samples, UINT begin, UINT end, TermSet& terms);
+
+	//sampleCount random samples on a plane under lightCount directional,
+	//point and spot lights, batched and scalar
+	static void Benchmark(UINT sampleCount, UINT lightCount, UINT iterations, BenchmarkResult& result);
+
+	//"SSE2" or "AVX", whichever the module was built with
+	static const char* InstructionSet();
+};
+
+#endif
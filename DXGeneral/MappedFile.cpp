@@ -0,0 +1,149 @@
+#include"MappedFile.h"
+
+#if defined(_WIN32)
+#include<Windows.h>
+#else
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<errno.h>
+#include<stdlib.h>
+#include<vector>
+#endif
+
+MappedFile::MappedFile()
+	:m_data(0), m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const wchar_t* fileName)
+{
+	Close();
+
+	HANDLE file = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool result = Map(file);
+
+	//The view keeps the mapping and the file alive
+	CloseHandle(file);
+	return result;
+}
+
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool result = Map(file);
+	CloseHandle(file);
+	return result;
+}
+
+bool MappedFile::Map(void* file)
+{
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+		return false;
+
+	if (size.QuadPart == 0 || static_cast<unsigned long long>(size.QuadPart) > static_cast<size_t>(-1))
+	{
+		SetLastError(ERROR_FILE_INVALID);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+		return false;
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!view)
+		return false;
+
+	m_data = static_cast<const uint8_t*>(view);
+	m_size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+
+	m_data = 0;
+	m_size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const wchar_t* fileName)
+{
+	std::vector<char> path(wcstombs(0, fileName, 0) + 1);
+	if (path.size() == 0 || wcstombs(&path[0], fileName, path.size()) == static_cast<size_t>(-1))
+		return false;
+
+	return Open(&path[0]);
+}
+
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+
+	int file = open(fileName, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	bool result = Map(file);
+	close(file);
+	return result;
+}
+
+bool MappedFile::Map(int file)
+{
+	struct stat info;
+	if (fstat(file, &info) != 0)
+		return false;
+
+	if (info.st_size <= 0)
+	{
+		errno = EINVAL;
+		return false;
+	}
+
+	void* view = mmap(0, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	if (view == MAP_FAILED)
+		return false;
+
+	//Most loads read the file front to back once
+	madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+	m_data = static_cast<const uint8_t*>(view);
+	m_size = static_cast<size_t>(info.st_size);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data)
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+
+	m_data = 0;
+	m_size = 0;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+//Read-only memory mapping of a whole file
+//
+//The contents are paged in on first touch instead of being copied into a
+//heap buffer, so parsers can hand out pointers straight into the file.
+//CreateFileMapping on Windows, mmap everywhere else.
+
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include<stddef.h>
+#include<stdint.h>
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	//Unmaps whatever was open before. Fails on missing and empty files,
+	//GetLastError()/errno tells why.
+	bool Open(const wchar_t* fileName);
+	bool Open(const char* fileName);
+
+	void Close();
+
+	bool IsOpen() const { return m_data != 0; }
+	const uint8_t* Data() const { return m_data; }
+	size_t Size() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+#if defined(_WIN32)
+	bool Map(void* file);
+#else
+	bool Map(int file);
+#endif
+
+private:
+	const uint8_t* m_data;
+	size_t m_size;
+};
+
+#endif
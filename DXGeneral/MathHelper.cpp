@@ -72,4 +72,40 @@ XMVECTOR MathHelper::RandHemisphereUnitVec3(XMVECTOR n)
 		return XMVector3Normalize(v);
 
 	}
-}
\ No newline at end of file
+}
+
+//for chap19 Terrain rendering
+//M is usually view*proj, planes then come out in world space.
+//Plane normals point into the frustum and are normalized, so
+//dot(n, p) + d is the signed distance of p to the plane.
+void ExtractFrustumPlanes(XMFLOAT4 planes[6], CXMMATRIX M)
+{
+	//With row vectors clip = p*M, so clip.x is the dot product
+	//of p with the first column of M, and so on
+	XMMATRIX T = XMMatrixTranspose(M);
+
+	XMVECTOR p[6];
+
+	//Left, -w <= x
+	p[0] = T.r[3] + T.r[0];
+
+	//Right, x <= w
+	p[1] = T.r[3] - T.r[0];
+
+	//Bottom, -w <= y
+	p[2] = T.r[3] + T.r[1];
+
+	//Top, y <= w
+	p[3] = T.r[3] - T.r[1];
+
+	//Near, 0 <= z
+	p[4] = T.r[2];
+
+	//Far, z <= w
+	p[5] = T.r[3] - T.r[2];
+
+	for (int i = 0; i < 6; ++i)
+	{
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(p[i]));
+	}
+}
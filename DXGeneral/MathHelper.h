@@ -74,4 +74,6 @@ public:
 	static const float Pi;
 };
 
+void ExtractFrustumPlanes(XMFLOAT4 planes[6], CXMMATRIX M);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,358 @@
+#include"MeshProcessor.h"
+#include<algorithm>
+#include<climits>
+#include<unordered_map>
+
+namespace
+{
+	//Triangles per ParallelFor chunk
+	const UINT TriangleGrain = 4096;
+	const UINT VertexGrain = 8192;
+
+	XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	XMFLOAT3 Scale(const XMFLOAT3& a, float s)
+	{
+		return XMFLOAT3(a.x*s, a.y*s, a.z*s);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x*b.x + a.y*b.y + a.z*b.z;
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+	}
+
+	//Returns false and leaves v alone if it is (nearly) zero
+	bool Normalize(XMFLOAT3& v)
+	{
+		float lengthSq = Dot(v, v);
+		if (lengthSq < 1e-20f)
+		{
+			return false;
+		}
+
+		v = Scale(v, 1.0f / sqrtf(lengthSq));
+		return true;
+	}
+
+	//Removes the part of v along the unit vector n
+	XMFLOAT3 Project(const XMFLOAT3& v, const XMFLOAT3& n)
+	{
+		return Sub(v, Scale(n, Dot(n, v)));
+	}
+
+	//Angle between two edges, both already normalized
+	float Angle(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return acosf(MathHelper::Clamp(Dot(a, b), -1.0f, 1.0f));
+	}
+
+	//Any unit vector perpendicular to the unit vector n
+	XMFLOAT3 Perpendicular(const XMFLOAT3& n)
+	{
+		XMFLOAT3 t = fabsf(n.x) < 0.9f ? Cross(n, XMFLOAT3(1.0f, 0.0f, 0.0f)) : Cross(n, XMFLOAT3(0.0f, 1.0f, 0.0f));
+		Normalize(t);
+		return t;
+	}
+
+	//Sums of one chunk, for the vertices [First, First + Sum.size()) its
+	//triangles reference. Meshes keep neighbouring triangles on nearby
+	//vertices, so a chunk covers a small range, not the whole mesh.
+	template<typename T>
+	struct Bucket
+	{
+		UINT First;
+		std::vector<T> Sum;
+	};
+
+	//Sizes bucket for the targets of the triangles [begin, end) and fills it
+	//with zero
+	template<typename T, typename Target>
+	void ResizeBucket(Bucket<T>& bucket, const T& zero, const std::vector<UINT>& indices, UINT begin, UINT end, Target target)
+	{
+		UINT first = UINT_MAX;
+		UINT last = 0;
+		for (UINT i = 3 * begin; i < 3 * end; ++i)
+		{
+			UINT v = target(indices[i]);
+			first = std::min(first, v);
+			last = std::max(last, v);
+		}
+
+		bucket.First = first <= last ? first : 0;
+		bucket.Sum.assign(first <= last ? last - first + 1 : 0, zero);
+	}
+
+	//The chunks whose buckets overlap the vertices [begin, end), in chunk
+	//order, so every vertex adds its sums in the same order
+	template<typename T>
+	void OverlappingBuckets(const std::vector<Bucket<T> >& buckets, UINT begin, UINT end, std::vector<UINT>& chunks)
+	{
+		chunks.clear();
+		for (UINT c = 0; c < buckets.size(); ++c)
+		{
+			const Bucket<T>& bucket = buckets[c];
+			if (bucket.First < end && bucket.First + bucket.Sum.size() > begin)
+				chunks.push_back(c);
+		}
+	}
+}
+
+void MeshProcessor::BuildPositionRemap(const GeometryGenerator::MeshData& meshData, std::vector<UINT>& remap)
+{
+	struct PositionHash
+	{
+		size_t operator()(const XMFLOAT3& p) const
+		{
+			UINT x, y, z;
+			memcpy(&x, &p.x, 4);
+			memcpy(&y, &p.y, 4);
+			memcpy(&z, &p.z, 4);
+			return (x * 73856093u) ^ (y * 19349663u) ^ (z * 83492791u);
+		}
+	};
+
+	struct PositionEqual
+	{
+		bool operator()(const XMFLOAT3& a, const XMFLOAT3& b) const
+		{
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+	};
+
+	UINT vcount = static_cast<UINT>(meshData.Vertices.size());
+
+	std::unordered_map<XMFLOAT3, UINT, PositionHash, PositionEqual> first(vcount);
+	remap.resize(vcount);
+
+	for (UINT i = 0; i < vcount; ++i)
+	{
+		remap[i] = first.insert(std::make_pair(meshData.Vertices[i].Position, i)).first->second;
+	}
+}
+
+void MeshProcessor::ComputeNormals(GeometryGenerator::MeshData& meshData, bool weldPositions, JobSystem& jobs)
+{
+	std::vector<GeometryGenerator::Vertex>& vertices = meshData.Vertices;
+	const std::vector<UINT>& indices = meshData.Indices;
+
+	UINT vcount = static_cast<UINT>(vertices.size());
+	UINT tcount = static_cast<UINT>(indices.size() / 3);
+
+	//Without welding every vertex is its own target
+	std::vector<UINT> remap;
+	if (weldPositions)
+	{
+		BuildPositionRemap(meshData, remap);
+	}
+	else
+	{
+		remap.resize(vcount);
+		for (UINT i = 0; i < vcount; ++i)
+		{
+			remap[i] = i;
+		}
+	}
+
+	UINT chunks = jobs.ChunkCount(tcount, TriangleGrain);
+	std::vector<Bucket<XMFLOAT3> > buckets(chunks);
+
+	jobs.ParallelFor(tcount, TriangleGrain, [&](UINT begin, UINT end, UINT chunk)
+	{
+		Bucket<XMFLOAT3>& bucket = buckets[chunk];
+		ResizeBucket(bucket, XMFLOAT3(0.0f, 0.0f, 0.0f), indices, begin, end, [&remap](UINT i) { return remap[i]; });
+
+		for (UINT t = begin; t < end; ++t)
+		{
+			UINT i[3] = { indices[3 * t + 0], indices[3 * t + 1], indices[3 * t + 2] };
+			const XMFLOAT3* p[3] = { &vertices[i[0]].Position, &vertices[i[1]].Position, &vertices[i[2]].Position };
+
+			XMFLOAT3 e[3] = { Sub(*p[1], *p[0]), Sub(*p[2], *p[1]), Sub(*p[0], *p[2]) };
+
+			XMFLOAT3 faceNormal = Cross(e[0], Scale(e[2], -1.0f));
+			if (!Normalize(faceNormal) || !Normalize(e[0]) || !Normalize(e[1]) || !Normalize(e[2]))
+			{
+				//Degenerate triangles contribute nothing
+				continue;
+			}
+
+			//Corner k sits between the outgoing edge e[k] and the incoming edge e[k+2]
+			for (UINT k = 0; k < 3; ++k)
+			{
+				float w = Angle(e[k], Scale(e[(k + 2) % 3], -1.0f));
+
+				XMFLOAT3& n = bucket.Sum[remap[i[k]] - bucket.First];
+				n.x += w*faceNormal.x;
+				n.y += w*faceNormal.y;
+				n.z += w*faceNormal.z;
+			}
+		}
+	});
+
+	//Reduce the buckets, chunk order is fixed so the sum is deterministic
+	jobs.ParallelFor(vcount, VertexGrain, [&](UINT begin, UINT end, UINT)
+	{
+		std::vector<UINT> overlapping;
+		OverlappingBuckets(buckets, begin, end, overlapping);
+
+		for (UINT v = begin; v < end; ++v)
+		{
+			if (remap[v] != v)
+			{
+				continue;
+			}
+
+			XMFLOAT3 n(0.0f, 0.0f, 0.0f);
+			for (size_t c = 0; c < overlapping.size(); ++c)
+			{
+				const Bucket<XMFLOAT3>& bucket = buckets[overlapping[c]];
+				if (v < bucket.First || v - bucket.First >= bucket.Sum.size())
+					continue;
+
+				const XMFLOAT3& sum = bucket.Sum[v - bucket.First];
+				n.x += sum.x;
+				n.y += sum.y;
+				n.z += sum.z;
+			}
+
+			//Unreferenced vertices keep whatever normal they had
+			if (Normalize(n))
+			{
+				vertices[v].Normal = n;
+			}
+		}
+	});
+
+	//Welded vertices copy their representative
+	jobs.ParallelFor(vcount, VertexGrain, [&](UINT begin, UINT end, UINT)
+	{
+		for (UINT v = begin; v < end; ++v)
+		{
+			if (remap[v] != v)
+			{
+				vertices[v].Normal = vertices[remap[v]].Normal;
+			}
+		}
+	});
+}
+
+void MeshProcessor::ComputeTangents(GeometryGenerator::MeshData& meshData, std::vector<float>* handedness, JobSystem& jobs)
+{
+	std::vector<GeometryGenerator::Vertex>& vertices = meshData.Vertices;
+	const std::vector<UINT>& indices = meshData.Indices;
+
+	UINT vcount = static_cast<UINT>(vertices.size());
+	UINT tcount = static_cast<UINT>(indices.size() / 3);
+
+	//xyz tangent, w angle weighted orientation
+	UINT chunks = jobs.ChunkCount(tcount, TriangleGrain);
+	std::vector<Bucket<XMFLOAT4> > buckets(chunks);
+
+	jobs.ParallelFor(tcount, TriangleGrain, [&](UINT begin, UINT end, UINT chunk)
+	{
+		Bucket<XMFLOAT4>& bucket = buckets[chunk];
+		ResizeBucket(bucket, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f), indices, begin, end, [](UINT i) { return i; });
+
+		for (UINT t = begin; t < end; ++t)
+		{
+			UINT i[3] = { indices[3 * t + 0], indices[3 * t + 1], indices[3 * t + 2] };
+			const GeometryGenerator::Vertex* v[3] = { &vertices[i[0]], &vertices[i[1]], &vertices[i[2]] };
+
+			XMFLOAT3 e1 = Sub(v[1]->Position, v[0]->Position);
+			XMFLOAT3 e2 = Sub(v[2]->Position, v[0]->Position);
+
+			float du1 = v[1]->TexC.x - v[0]->TexC.x;
+			float dv1 = v[1]->TexC.y - v[0]->TexC.y;
+			float du2 = v[2]->TexC.x - v[0]->TexC.x;
+			float dv2 = v[2]->TexC.y - v[0]->TexC.y;
+
+			//Like MikkTSpace only the sign of the UV area is used, not its size
+			float det = du1*dv2 - du2*dv1;
+			float orientation = det > 0.0f ? 1.0f : -1.0f;
+
+			XMFLOAT3 faceTangent(
+				orientation*(dv2*e1.x - dv1*e2.x),
+				orientation*(dv2*e1.y - dv1*e2.y),
+				orientation*(dv2*e1.z - dv1*e2.z));
+
+			if (det == 0.0f || Dot(faceTangent, faceTangent) < 1e-20f)
+			{
+				//No usable UV mapping on this triangle
+				continue;
+			}
+
+			for (UINT k = 0; k < 3; ++k)
+			{
+				const XMFLOAT3& n = v[k]->Normal;
+
+				XMFLOAT3 tangent = Project(faceTangent, n);
+				XMFLOAT3 edge0 = Project(Sub(v[(k + 1) % 3]->Position, v[k]->Position), n);
+				XMFLOAT3 edge1 = Project(Sub(v[(k + 2) % 3]->Position, v[k]->Position), n);
+
+				if (!Normalize(tangent) || !Normalize(edge0) || !Normalize(edge1))
+				{
+					continue;
+				}
+
+				//Angle of the corner measured in the tangent plane
+				float w = Angle(edge0, edge1);
+
+				XMFLOAT4& s = bucket.Sum[i[k] - bucket.First];
+				s.x += w*tangent.x;
+				s.y += w*tangent.y;
+				s.z += w*tangent.z;
+				s.w += w*orientation;
+			}
+		}
+	});
+
+	if (handedness)
+	{
+		handedness->resize(vcount);
+	}
+
+	jobs.ParallelFor(vcount, VertexGrain, [&](UINT begin, UINT end, UINT)
+	{
+		std::vector<UINT> overlapping;
+		OverlappingBuckets(buckets, begin, end, overlapping);
+
+		for (UINT v = begin; v < end; ++v)
+		{
+			XMFLOAT4 s(0.0f, 0.0f, 0.0f, 0.0f);
+			for (size_t c = 0; c < overlapping.size(); ++c)
+			{
+				const Bucket<XMFLOAT4>& bucket = buckets[overlapping[c]];
+				if (v < bucket.First || v - bucket.First >= bucket.Sum.size())
+					continue;
+
+				const XMFLOAT4& sum = bucket.Sum[v - bucket.First];
+				s.x += sum.x;
+				s.y += sum.y;
+				s.z += sum.z;
+				s.w += sum.w;
+			}
+
+			//Gram-Schmidt against the final normal
+			const XMFLOAT3& n = vertices[v].Normal;
+			XMFLOAT3 tangent = Project(XMFLOAT3(s.x, s.y, s.z), n);
+			if (!Normalize(tangent))
+			{
+				tangent = Perpendicular(n);
+			}
+
+			vertices[v].TangentU = tangent;
+
+			if (handedness)
+			{
+				(*handedness)[v] = s.w < 0.0f ? -1.0f : 1.0f;
+			}
+		}
+	});
+}
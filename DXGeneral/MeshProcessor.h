@@ -0,0 +1,42 @@
+#pragma once
+
+//CPU mesh processing on GeometryGenerator::MeshData
+//
+//Normals are smooth and angle weighted: every triangle adds its face normal
+//to its three corners, weighted by the angle at that corner, so the result
+//does not depend on how a surface happens to be triangulated.
+//
+//Tangents are MikkTSpace-style per-face tangents from the UV derivatives,
+//projected onto the vertex normal, angle weighted, then orthonormalized.
+//There is no MikkTSpace face grouping or vertex splitting, so maps baked by
+//MikkTSpace tools match only where a vertex has one tangent frame.
+//
+//Both run in parallel over triangles. Each JobSystem chunk accumulates into
+//its own bucket, which covers only the vertices its triangles reference,
+//and the buckets are summed per vertex in chunk order afterwards, so no
+//atomics are needed and the result does not depend on the thread timing.
+
+#ifndef _MESHPROCESSOR_H_
+#define _MESHPROCESSOR_H_
+
+#include "GeometryGenerator.h"
+#include "JobSystem.h"
+
+class MeshProcessor
+{
+public:
+	//weldPositions shares the normal between vertices at the same position
+	//(UV or material seams), otherwise every vertex index is smoothed alone
+	static void ComputeNormals(GeometryGenerator::MeshData& meshData,
+		bool weldPositions = true, JobSystem& jobs = JobSystem::Default());
+
+	//Needs normals and texture coordinates. handedness, if given, receives
+	//the bitangent sign per vertex (B = handedness * cross(N, T)).
+	static void ComputeTangents(GeometryGenerator::MeshData& meshData,
+		std::vector<float>* handedness = 0, JobSystem& jobs = JobSystem::Default());
+
+	//Maps every vertex to the first vertex with the same position
+	static void BuildPositionRemap(const GeometryGenerator::MeshData& meshData, std::vector<UINT>& remap);
+};
+
+#endif
@@ -0,0 +1,774 @@
+#include"MeshSimplifier.h"
+#include<algorithm>
+#include<cfloat>
+
+namespace
+{
+	//Below this many triangles the slab pass is not worth it
+	const UINT ParallelTriangleThreshold = 16384;
+	const UINT MaxIterations = 100;
+
+	//Collapses costlier than this (squared distance, in the unit cube) would
+	//visibly change the silhouette, stop short of the target instead
+	const double MaxCollapseError = 1e-3;
+
+	//Symmetric 4x4 matrix, upper triangle
+	//	0 1 2 3
+	//	  4 5 6
+	//	    7 8
+	//	      9
+	struct Quadric
+	{
+		double m[10];
+
+		Quadric()
+		{
+			for (int i = 0; i < 10; ++i)
+			{
+				m[i] = 0.0;
+			}
+		}
+
+		//Plane ax + by + cz + d = 0
+		Quadric(double a, double b, double c, double d)
+		{
+			m[0] = a*a; m[1] = a*b; m[2] = a*c; m[3] = a*d;
+			m[4] = b*b; m[5] = b*c; m[6] = b*d;
+			m[7] = c*c; m[8] = c*d;
+			m[9] = d*d;
+		}
+
+		Quadric& operator+=(const Quadric& q)
+		{
+			for (int i = 0; i < 10; ++i)
+			{
+				m[i] += q.m[i];
+			}
+			return *this;
+		}
+
+		double Error(double x, double y, double z) const
+		{
+			return m[0] * x*x + 2 * m[1] * x*y + 2 * m[2] * x*z + 2 * m[3] * x
+				+ m[4] * y*y + 2 * m[5] * y*z + 2 * m[6] * y
+				+ m[7] * z*z + 2 * m[8] * z
+				+ m[9];
+		}
+	};
+
+	struct Triangle
+	{
+		UINT v[3];
+
+		//Collapse error of the three edges, [3] is their minimum
+		double Error[4];
+
+		XMFLOAT3 Normal;
+		bool Deleted;
+		bool Dirty;
+	};
+
+	//A corner of a triangle, the vertex -> triangle adjacency
+	struct Ref
+	{
+		UINT Triangle;
+		UINT Corner;
+	};
+
+	//Mesh being simplified. Positions are normalized into the unit cube so
+	//the error thresholds do not depend on the model scale.
+	struct Work
+	{
+		std::vector<GeometryGenerator::Vertex> Vertices;
+		std::vector<XMFLOAT3> Positions;
+		std::vector<Quadric> Quadrics;
+		std::vector<char> Locked;
+		std::vector<UINT> RefStart;
+		std::vector<UINT> RefCount;
+
+		std::vector<Triangle> Triangles;
+		std::vector<Ref> Refs;
+
+		//Original index of each vertex, used to stitch slabs back together
+		std::vector<UINT> Origin;
+
+		//Vertices that must not move regardless of the topology
+		std::vector<char> Pinned;
+
+		XMFLOAT3 Offset;
+		float Scale;
+	};
+
+	XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x*b.x + a.y*b.y + a.z*b.z;
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+	}
+
+	XMFLOAT3 Normalized(const XMFLOAT3& v)
+	{
+		float length = sqrtf(Dot(v, v));
+		return length > 0.0f ? XMFLOAT3(v.x / length, v.y / length, v.z / length) : v;
+	}
+
+	XMFLOAT3 Lerp(const XMFLOAT3& a, const XMFLOAT3& b, float t)
+	{
+		return XMFLOAT3(a.x + (b.x - a.x)*t, a.y + (b.y - a.y)*t, a.z + (b.z - a.z)*t);
+	}
+
+	XMFLOAT2 Lerp(const XMFLOAT2& a, const XMFLOAT2& b, float t)
+	{
+		return XMFLOAT2(a.x + (b.x - a.x)*t, a.y + (b.y - a.y)*t);
+	}
+
+	double Det3(double a, double b, double c, double d, double e, double f, double g, double h, double i)
+	{
+		return a*(e*i - f*h) - b*(d*i - f*g) + c*(d*h - e*g);
+	}
+
+	//Error of collapsing edge v0-v1 and the point it collapses to
+	double EdgeError(const Work& w, UINT v0, UINT v1, XMFLOAT3& p)
+	{
+		Quadric q = w.Quadrics[v0];
+		q += w.Quadrics[v1];
+		const double* m = q.m;
+
+		//Relative to the trace so flat and creased regions count as singular
+		double det = Det3(m[0], m[1], m[2], m[1], m[4], m[5], m[2], m[5], m[7]);
+		double trace = m[0] + m[4] + m[7];
+		if (fabs(det) > 1e-6*trace*trace*trace)
+		{
+			//Cramer's rule on the 3x3 part, right hand side -(m3, m6, m8)
+			double x = -Det3(m[3], m[1], m[2], m[6], m[4], m[5], m[8], m[5], m[7]) / det;
+			double y = -Det3(m[0], m[3], m[2], m[1], m[6], m[5], m[2], m[8], m[7]) / det;
+			double z = -Det3(m[0], m[1], m[3], m[1], m[4], m[6], m[2], m[5], m[8]) / det;
+
+			p = XMFLOAT3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+			return q.Error(x, y, z);
+		}
+
+		//Singular: best of the end points and the midpoint
+		const XMFLOAT3& a = w.Positions[v0];
+		const XMFLOAT3& b = w.Positions[v1];
+		XMFLOAT3 mid = Lerp(a, b, 0.5f);
+
+		double ea = q.Error(a.x, a.y, a.z);
+		double eb = q.Error(b.x, b.y, b.z);
+		double em = q.Error(mid.x, mid.y, mid.z);
+
+		double best = std::min(ea, std::min(eb, em));
+		p = best == ea ? a : (best == eb ? b : mid);
+		return best;
+	}
+
+	void UpdateTriangleErrors(const Work& w, Triangle& t)
+	{
+		XMFLOAT3 p;
+		for (int j = 0; j < 3; ++j)
+		{
+			t.Error[j] = EdgeError(w, t.v[j], t.v[(j + 1) % 3], p);
+		}
+		t.Error[3] = std::min(t.Error[0], std::min(t.Error[1], t.Error[2]));
+	}
+
+	XMFLOAT3 TriangleNormal(const Work& w, const Triangle& t)
+	{
+		const XMFLOAT3& p0 = w.Positions[t.v[0]];
+		return Normalized(Cross(Sub(w.Positions[t.v[1]], p0), Sub(w.Positions[t.v[2]], p0)));
+	}
+
+	//Drops deleted triangles and rebuilds the vertex -> triangle references.
+	//The first call also builds the quadrics and locks the open edges.
+	void Compact(Work& w, bool first)
+	{
+		size_t live = 0;
+		for (size_t i = 0; i < w.Triangles.size(); ++i)
+		{
+			if (!w.Triangles[i].Deleted)
+			{
+				w.Triangles[live++] = w.Triangles[i];
+			}
+		}
+		w.Triangles.resize(live);
+
+		UINT vcount = static_cast<UINT>(w.Positions.size());
+		w.RefStart.assign(vcount, 0);
+		w.RefCount.assign(vcount, 0);
+
+		for (size_t i = 0; i < w.Triangles.size(); ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				++w.RefCount[w.Triangles[i].v[j]];
+			}
+		}
+
+		UINT start = 0;
+		for (UINT v = 0; v < vcount; ++v)
+		{
+			w.RefStart[v] = start;
+			start += w.RefCount[v];
+			w.RefCount[v] = 0;
+		}
+
+		w.Refs.resize(w.Triangles.size() * 3);
+		for (size_t i = 0; i < w.Triangles.size(); ++i)
+		{
+			for (UINT j = 0; j < 3; ++j)
+			{
+				UINT v = w.Triangles[i].v[j];
+				Ref& r = w.Refs[w.RefStart[v] + w.RefCount[v]++];
+				r.Triangle = static_cast<UINT>(i);
+				r.Corner = j;
+			}
+		}
+
+		if (!first)
+		{
+			return;
+		}
+
+		//An edge used by a single triangle is open: count the edges around
+		//each vertex by their far end, ones that show up once are open
+		w.Locked = w.Pinned;
+		std::vector<UINT> ends;
+		std::vector<UINT> uses;
+
+		for (UINT v = 0; v < vcount; ++v)
+		{
+			ends.clear();
+			uses.clear();
+
+			for (UINT k = 0; k < w.RefCount[v]; ++k)
+			{
+				const Ref& r = w.Refs[w.RefStart[v] + k];
+				const Triangle& t = w.Triangles[r.Triangle];
+
+				for (UINT j = 1; j < 3; ++j)
+				{
+					UINT other = t.v[(r.Corner + j) % 3];
+
+					size_t e = std::find(ends.begin(), ends.end(), other) - ends.begin();
+					if (e == ends.size())
+					{
+						ends.push_back(other);
+						uses.push_back(0);
+					}
+					++uses[e];
+				}
+			}
+
+			for (size_t e = 0; e < ends.size(); ++e)
+			{
+				if (uses[e] == 1)
+				{
+					w.Locked[v] = 1;
+					w.Locked[ends[e]] = 1;
+				}
+			}
+		}
+
+		w.Quadrics.assign(vcount, Quadric());
+		for (size_t i = 0; i < w.Triangles.size(); ++i)
+		{
+			Triangle& t = w.Triangles[i];
+			const XMFLOAT3& p0 = w.Positions[t.v[0]];
+
+			XMFLOAT3 n = TriangleNormal(w, t);
+			Quadric q(n.x, n.y, n.z, -Dot(n, p0));
+
+			for (int j = 0; j < 3; ++j)
+			{
+				w.Quadrics[t.v[j]] += q;
+			}
+
+			t.Normal = n;
+		}
+
+		for (size_t i = 0; i < w.Triangles.size(); ++i)
+		{
+			UpdateTriangleErrors(w, w.Triangles[i]);
+		}
+	}
+
+	//Would moving v0 to p (while v1 goes away) fold a triangle around v0 over?
+	//Marks the triangles shared with v1, they are removed by the collapse.
+	bool Flipped(const Work& w, const XMFLOAT3& p, UINT v0, UINT v1, std::vector<char>& deleted)
+	{
+		for (UINT k = 0; k < w.RefCount[v0]; ++k)
+		{
+			const Ref& r = w.Refs[w.RefStart[v0] + k];
+			const Triangle& t = w.Triangles[r.Triangle];
+			if (t.Deleted)
+			{
+				continue;
+			}
+
+			UINT id1 = t.v[(r.Corner + 1) % 3];
+			UINT id2 = t.v[(r.Corner + 2) % 3];
+
+			if (id1 == v1 || id2 == v1)
+			{
+				deleted[k] = 1;
+				continue;
+			}
+
+			XMFLOAT3 d1 = Normalized(Sub(w.Positions[id1], p));
+			XMFLOAT3 d2 = Normalized(Sub(w.Positions[id2], p));
+
+			//Needle triangle
+			if (fabsf(Dot(d1, d2)) > 0.999f)
+			{
+				return true;
+			}
+
+			deleted[k] = 0;
+
+			XMFLOAT3 n = Normalized(Cross(d1, d2));
+			if (Dot(n, t.Normal) < 0.2f)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	//Points the surviving triangles of v at v0 and appends them to v0's references
+	void UpdateTriangles(Work& w, UINT v0, UINT v, const std::vector<char>& deleted, UINT& deletedCount)
+	{
+		for (UINT k = 0; k < w.RefCount[v]; ++k)
+		{
+			Ref r = w.Refs[w.RefStart[v] + k];
+			Triangle& t = w.Triangles[r.Triangle];
+			if (t.Deleted)
+			{
+				continue;
+			}
+
+			if (deleted[k])
+			{
+				t.Deleted = true;
+				++deletedCount;
+				continue;
+			}
+
+			t.v[r.Corner] = v0;
+			t.Dirty = true;
+			t.Normal = TriangleNormal(w, t);
+			UpdateTriangleErrors(w, t);
+
+			w.Refs.push_back(r);
+		}
+	}
+
+	//Returns the largest accepted collapse error
+	double SimplifyWork(Work& w, UINT targetTriangleCount)
+	{
+		Compact(w, true);
+
+		UINT triangleCount = static_cast<UINT>(w.Triangles.size());
+		UINT deletedCount = 0;
+		double maxError = 0.0;
+
+		std::vector<char> deleted0;
+		std::vector<char> deleted1;
+
+		for (UINT iteration = 0; iteration < MaxIterations; ++iteration)
+		{
+			if (triangleCount - deletedCount <= targetTriangleCount)
+			{
+				break;
+			}
+
+			if (iteration > 0 && iteration % 5 == 0)
+			{
+				Compact(w, false);
+			}
+
+			for (size_t i = 0; i < w.Triangles.size(); ++i)
+			{
+				w.Triangles[i].Dirty = false;
+			}
+
+			//Accept only collapses below a threshold that grows every iteration
+			double threshold = MathHelper::Min(1e-9*pow(double(iteration + 3), 7.0), MaxCollapseError);
+
+			for (size_t i = 0; i < w.Triangles.size(); ++i)
+			{
+				Triangle& t = w.Triangles[i];
+				if (t.Error[3] > threshold || t.Deleted || t.Dirty)
+				{
+					continue;
+				}
+
+				for (int j = 0; j < 3; ++j)
+				{
+					if (t.Error[j] > threshold)
+					{
+						continue;
+					}
+
+					UINT v0 = t.v[j];
+					UINT v1 = t.v[(j + 1) % 3];
+					if (w.Locked[v0] || w.Locked[v1])
+					{
+						continue;
+					}
+
+					XMFLOAT3 p;
+					double error = EdgeError(w, v0, v1, p);
+
+					deleted0.assign(w.RefCount[v0], 0);
+					deleted1.assign(w.RefCount[v1], 0);
+					if (Flipped(w, p, v0, v1, deleted0) || Flipped(w, p, v1, v0, deleted1))
+					{
+						continue;
+					}
+
+					//Interpolate the other attributes by where p falls on the edge
+					XMFLOAT3 edge = Sub(w.Positions[v1], w.Positions[v0]);
+					float lengthSq = Dot(edge, edge);
+					float s = lengthSq > 0.0f ? MathHelper::Clamp(Dot(Sub(p, w.Positions[v0]), edge) / lengthSq, 0.0f, 1.0f) : 0.0f;
+
+					GeometryGenerator::Vertex& a = w.Vertices[v0];
+					const GeometryGenerator::Vertex& b = w.Vertices[v1];
+					a.Normal = Normalized(Lerp(a.Normal, b.Normal, s));
+					a.TangentU = Normalized(Lerp(a.TangentU, b.TangentU, s));
+					a.TexC = Lerp(a.TexC, b.TexC, s);
+
+					w.Positions[v0] = p;
+					w.Quadrics[v0] += w.Quadrics[v1];
+
+					UINT start = static_cast<UINT>(w.Refs.size());
+					UpdateTriangles(w, v0, v0, deleted0, deletedCount);
+					UpdateTriangles(w, v0, v1, deleted1, deletedCount);
+
+					w.RefStart[v0] = start;
+					w.RefCount[v0] = static_cast<UINT>(w.Refs.size()) - start;
+
+					maxError = std::max(maxError, error);
+					break;
+				}
+
+				if (triangleCount - deletedCount <= targetTriangleCount)
+				{
+					break;
+				}
+			}
+		}
+
+		Compact(w, false);
+		return maxError;
+	}
+
+	//Builds the work mesh from a set of triangles of meshData
+	void InitWork(Work& w, const GeometryGenerator::MeshData& meshData,
+		const UINT* triangles, UINT triangleCount, const XMFLOAT3& offset, float scale,
+		const std::vector<char>* pinned = 0)
+	{
+		std::vector<UINT> local(meshData.Vertices.size(), UINT(-1));
+
+		w.Offset = offset;
+		w.Scale = scale;
+		w.Triangles.resize(triangleCount);
+
+		for (UINT i = 0; i < triangleCount; ++i)
+		{
+			Triangle& t = w.Triangles[i];
+			t.Deleted = false;
+			t.Dirty = false;
+
+			for (UINT j = 0; j < 3; ++j)
+			{
+				UINT v = meshData.Indices[3 * triangles[i] + j];
+				if (local[v] == UINT(-1))
+				{
+					local[v] = static_cast<UINT>(w.Vertices.size());
+
+					const XMFLOAT3& p = meshData.Vertices[v].Position;
+					w.Vertices.push_back(meshData.Vertices[v]);
+					w.Positions.push_back(XMFLOAT3((p.x - offset.x)*scale, (p.y - offset.y)*scale, (p.z - offset.z)*scale));
+					w.Origin.push_back(v);
+					w.Pinned.push_back(pinned ? (*pinned)[v] : 0);
+				}
+
+				t.v[j] = local[v];
+			}
+		}
+	}
+
+	//Writes the simplified positions back into the vertices
+	void FinishWork(Work& w)
+	{
+		float invScale = 1.0f / w.Scale;
+		for (size_t i = 0; i < w.Vertices.size(); ++i)
+		{
+			const XMFLOAT3& p = w.Positions[i];
+			w.Vertices[i].Position = XMFLOAT3(p.x*invScale + w.Offset.x, p.y*invScale + w.Offset.y, p.z*invScale + w.Offset.z);
+		}
+	}
+
+	//Keeps only the referenced vertices
+	void ExtractMesh(const std::vector<GeometryGenerator::Vertex>& vertices, const std::vector<Triangle>& triangles,
+		GeometryGenerator::MeshData& result)
+	{
+		std::vector<UINT> remap(vertices.size(), UINT(-1));
+
+		result.Vertices.clear();
+		result.Indices.resize(triangles.size() * 3);
+
+		for (size_t i = 0; i < triangles.size(); ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				UINT v = triangles[i].v[j];
+				if (remap[v] == UINT(-1))
+				{
+					remap[v] = static_cast<UINT>(result.Vertices.size());
+					result.Vertices.push_back(vertices[v]);
+				}
+
+				result.Indices[3 * i + j] = remap[v];
+			}
+		}
+	}
+}
+
+float MeshSimplifier::Simplify(const GeometryGenerator::MeshData& meshData, UINT targetTriangleCount,
+	GeometryGenerator::MeshData& result, JobSystem& jobs)
+{
+	UINT vcount = static_cast<UINT>(meshData.Vertices.size());
+	UINT tcount = static_cast<UINT>(meshData.Indices.size() / 3);
+
+	if (tcount <= targetTriangleCount || vcount == 0)
+	{
+		result = meshData;
+		return 0.0f;
+	}
+
+	//Normalize into the unit cube
+	XMFLOAT3 vMin(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
+	XMFLOAT3 vMax(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+	for (UINT i = 0; i < vcount; ++i)
+	{
+		const XMFLOAT3& p = meshData.Vertices[i].Position;
+		vMin = XMFLOAT3(MathHelper::Min(vMin.x, p.x), MathHelper::Min(vMin.y, p.y), MathHelper::Min(vMin.z, p.z));
+		vMax = XMFLOAT3(MathHelper::Max(vMax.x, p.x), MathHelper::Max(vMax.y, p.y), MathHelper::Max(vMax.z, p.z));
+	}
+
+	XMFLOAT3 extent = Sub(vMax, vMin);
+	float size = MathHelper::Max(extent.x, MathHelper::Max(extent.y, extent.z));
+	float scale = size > 0.0f ? 1.0f / size : 1.0f;
+
+	const GeometryGenerator::MeshData* source = &meshData;
+	GeometryGenerator::MeshData stitched;
+	double error = 0.0;
+
+	//Parallel pass: slabs along the longest axis, one per worker
+	UINT slabs = MathHelper::Min(jobs.ThreadCount() + 1, tcount / (ParallelTriangleThreshold / 2));
+	if (tcount >= ParallelTriangleThreshold && slabs > 1)
+	{
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		float axisMin = (&vMin.x)[axis];
+		float axisSize = MathHelper::Max((&extent.x)[axis], FLT_MIN);
+
+		//Bucket the triangles by centroid, vertices used by several slabs are
+		//pinned (open edges lock the cut already, this also covers non-manifold spots)
+		std::vector<std::vector<UINT> > slabTriangles(slabs);
+		std::vector<UINT> vertexSlab(vcount, UINT(-1));
+		std::vector<char> pinned(vcount, 0);
+		for (UINT i = 0; i < tcount; ++i)
+		{
+			float c = 0.0f;
+			for (int j = 0; j < 3; ++j)
+			{
+				c += (&meshData.Vertices[meshData.Indices[3 * i + j]].Position.x)[axis];
+			}
+
+			UINT s = static_cast<UINT>((c / 3.0f - axisMin) / axisSize*slabs);
+			s = MathHelper::Min(s, slabs - 1);
+			slabTriangles[s].push_back(i);
+
+			for (int j = 0; j < 3; ++j)
+			{
+				UINT v = meshData.Indices[3 * i + j];
+				if (vertexSlab[v] == UINT(-1))
+				{
+					vertexSlab[v] = s;
+				}
+				else if (vertexSlab[v] != s)
+				{
+					pinned[v] = 1;
+				}
+			}
+		}
+
+		std::vector<Work> works(slabs);
+		std::vector<double> errors(slabs, 0.0);
+
+		//Grain 1, one chunk per slab
+		jobs.ParallelFor(slabs, 1, [&](UINT begin, UINT end, UINT)
+		{
+			for (UINT s = begin; s < end; ++s)
+			{
+				UINT count = static_cast<UINT>(slabTriangles[s].size());
+				if (count == 0)
+				{
+					continue;
+				}
+
+				UINT target = static_cast<UINT>(UINT64(count)*targetTriangleCount / tcount);
+
+				InitWork(works[s], meshData, &slabTriangles[s][0], count, vMin, scale, &pinned);
+				errors[s] = SimplifyWork(works[s], target);
+				FinishWork(works[s]);
+			}
+		});
+
+		//Cut vertices were pinned, so every surviving vertex still belongs
+		//to exactly one slab or is untouched, stitch by original index
+		stitched.Vertices = meshData.Vertices;
+		for (UINT s = 0; s < slabs; ++s)
+		{
+			Work& w = works[s];
+			for (size_t i = 0; i < w.Triangles.size(); ++i)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					UINT v = w.Triangles[i].v[j];
+					stitched.Vertices[w.Origin[v]] = w.Vertices[v];
+					stitched.Indices.push_back(w.Origin[v]);
+				}
+			}
+
+			error = std::max(error, errors[s]);
+		}
+
+		source = &stitched;
+	}
+
+	//Serial pass over everything, the slab seams are free to move now
+	UINT count = static_cast<UINT>(source->Indices.size() / 3);
+	std::vector<UINT> triangles(count);
+	for (UINT i = 0; i < count; ++i)
+	{
+		triangles[i] = i;
+	}
+
+	Work w;
+	InitWork(w, *source, &triangles[0], count, vMin, scale);
+	error = std::max(error, SimplifyWork(w, targetTriangleCount));
+	FinishWork(w);
+
+	ExtractMesh(w.Vertices, w.Triangles, result);
+
+	//Quadric error is a squared distance in the normalized space
+	return static_cast<float>(sqrt(error)) / scale;
+}
+
+void MeshSimplifier::BuildLodChain(const GeometryGenerator::MeshData& meshData,
+	const float* ratios, UINT ratioCount, LodChain& chain, JobSystem& jobs)
+{
+	chain.Vertices.clear();
+	chain.Indices.clear();
+	chain.Lods.clear();
+
+	UINT tcount = static_cast<UINT>(meshData.Indices.size() / 3);
+
+	GeometryGenerator::MeshData previous = meshData;
+	float error = 0.0f;
+
+	for (UINT level = 0; level <= ratioCount; ++level)
+	{
+		GeometryGenerator::MeshData simplified;
+		if (level > 0)
+		{
+			UINT target = static_cast<UINT>(tcount*ratios[level - 1]);
+			error = MathHelper::Max(error, Simplify(previous, target, simplified, jobs));
+			previous.Vertices.swap(simplified.Vertices);
+			previous.Indices.swap(simplified.Indices);
+		}
+
+		Lod lod;
+		lod.StartIndex = static_cast<UINT>(chain.Indices.size());
+		lod.IndexCount = static_cast<UINT>(previous.Indices.size());
+		lod.BaseVertex = static_cast<UINT>(chain.Vertices.size());
+		lod.VertexCount = static_cast<UINT>(previous.Vertices.size());
+
+		//Errors of the successive steps do not add up exactly, the max is a fair estimate
+		lod.Error = error;
+
+		chain.Vertices.insert(chain.Vertices.end(), previous.Vertices.begin(), previous.Vertices.end());
+		chain.Indices.insert(chain.Indices.end(), previous.Indices.begin(), previous.Indices.end());
+		chain.Lods.push_back(lod);
+	}
+
+	//Bounding sphere around the box center
+	XMFLOAT3 vMin(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
+	XMFLOAT3 vMax(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+	for (size_t i = 0; i < meshData.Vertices.size(); ++i)
+	{
+		const XMFLOAT3& p = meshData.Vertices[i].Position;
+		vMin = XMFLOAT3(MathHelper::Min(vMin.x, p.x), MathHelper::Min(vMin.y, p.y), MathHelper::Min(vMin.z, p.z));
+		vMax = XMFLOAT3(MathHelper::Max(vMax.x, p.x), MathHelper::Max(vMax.y, p.y), MathHelper::Max(vMax.z, p.z));
+	}
+
+	chain.Center = Lerp(vMin, vMax, 0.5f);
+	chain.Radius = 0.0f;
+	for (size_t i = 0; i < meshData.Vertices.size(); ++i)
+	{
+		XMFLOAT3 d = Sub(meshData.Vertices[i].Position, chain.Center);
+		chain.Radius = MathHelper::Max(chain.Radius, sqrtf(Dot(d, d)));
+	}
+}
+
+UINT MeshSimplifier::SelectLod(const LodChain& chain, CXMMATRIX world, CXMMATRIX view, CXMMATRIX proj,
+	float viewportHeight, float maxPixelError)
+{
+	XMMATRIX worldView = XMMatrixMultiply(world, view);
+
+	//Largest scale of the world matrix grows the sphere
+	float scale = sqrtf(MathHelper::Max(XMVectorGetX(XMVector3LengthSq(world.r[0])),
+		MathHelper::Max(XMVectorGetX(XMVector3LengthSq(world.r[1])), XMVectorGetX(XMVector3LengthSq(world.r[2])))));
+
+	XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&chain.Center), worldView);
+	float radius = chain.Radius*scale;
+	float depth = XMVectorGetZ(center);
+
+	//Camera inside the sphere, always full detail
+	if (depth <= radius)
+	{
+		return 0;
+	}
+
+	//proj(1,1) = cot(fovY/2), projects view space heights to [-1, 1]
+	float projectedRadius = radius*XMVectorGetY(proj.r[1]) / depth*0.5f*viewportHeight;
+
+	return SelectLod(chain, projectedRadius, maxPixelError);
+}
+
+UINT MeshSimplifier::SelectLod(const LodChain& chain, float projectedRadius, float maxPixelError)
+{
+	UINT level = 0;
+	for (UINT i = 1; i < chain.Lods.size(); ++i)
+	{
+		//Error relative to the sphere, scaled by its size on screen
+		float pixelError = chain.Radius > 0.0f ? chain.Lods[i].Error / chain.Radius*projectedRadius : 0.0f;
+		if (pixelError <= maxPixelError)
+		{
+			level = i;
+		}
+	}
+
+	return level;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+//Quadric error metric mesh simplification and LOD chains
+//
+//Edge collapse in the style of Garland & Heckbert: every vertex carries the
+//sum of the plane quadrics of its triangles, edges are collapsed cheapest
+//first (by an increasing error threshold) to the point minimizing the summed
+//quadric, and collapses that would fold a triangle over are rejected.
+//Vertices on open edges (mesh borders, split UV/normal seams) are locked.
+//
+//Large meshes are first cut into slabs along their longest axis and the
+//slabs are simplified in parallel with the cut vertices locked, then one
+//serial pass over the stitched result closes the seams and hits the target.
+
+#ifndef _MESHSIMPLIFIER_H_
+#define _MESHSIMPLIFIER_H_
+
+#include "GeometryGenerator.h"
+#include "JobSystem.h"
+
+class MeshSimplifier
+{
+public:
+	struct Lod
+	{
+		//DrawIndexed(IndexCount, StartIndex, BaseVertex)
+		UINT StartIndex;
+		UINT IndexCount;
+		UINT BaseVertex;
+		UINT VertexCount;
+
+		//Largest collapse error, as a distance in model units
+		float Error;
+	};
+
+	//All levels share one vertex and one index array for a single upload
+	struct LodChain
+	{
+		std::vector<GeometryGenerator::Vertex> Vertices;
+		std::vector<UINT> Indices;
+		std::vector<Lod> Lods;
+
+		//Bounding sphere in model space
+		XMFLOAT3 Center;
+		float Radius;
+	};
+
+public:
+	//Returns the error of the simplified mesh, see Lod::Error
+	static float Simplify(const GeometryGenerator::MeshData& meshData, UINT targetTriangleCount,
+		GeometryGenerator::MeshData& result, JobSystem& jobs = JobSystem::Default());
+
+	//Level 0 is the mesh itself, level i+1 keeps ratios[i] of its triangles,
+	//e.g. { 0.5f, 0.25f, 0.1f }. Each level is simplified from the previous one.
+	static void BuildLodChain(const GeometryGenerator::MeshData& meshData,
+		const float* ratios, UINT ratioCount, LodChain& chain, JobSystem& jobs = JobSystem::Default());
+
+	//Picks the coarsest level whose error, projected to the screen, stays
+	//below maxPixelError. world/view/proj place the chain's bounding sphere,
+	//viewportHeight is in pixels.
+	static UINT SelectLod(const LodChain& chain, CXMMATRIX world, CXMMATRIX view, CXMMATRIX proj,
+		float viewportHeight, float maxPixelError = 1.0f);
+
+	//Same from an already known projected bounding sphere radius in pixels
+	static UINT SelectLod(const LodChain& chain, float projectedRadius, float maxPixelError = 1.0f);
+};
+
+#endif
@@ -0,0 +1,386 @@
+#include"MeshletBuilder.h"
+#include<algorithm>
+
+namespace
+{
+	//Spreads the low 10 bits of x to every third bit
+	UINT Part1By2(UINT x)
+	{
+		x &= 0x000003ff;
+		x = (x ^ (x << 16)) & 0xff0000ff;
+		x = (x ^ (x << 8)) & 0x0300f00f;
+		x = (x ^ (x << 4)) & 0x030c30c3;
+		x = (x ^ (x << 2)) & 0x09249249;
+		return x;
+	}
+
+	float DistanceSq(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		float dx = a.x - b.x;
+		float dy = a.y - b.y;
+		float dz = a.z - b.z;
+		return dx*dx + dy*dy + dz*dz;
+	}
+}
+
+void MeshletBuilder::Build(const GeometryGenerator::MeshData& meshData, MeshletMesh& result,
+	UINT maxVertices, UINT maxTriangles)
+{
+	Build(meshData.Vertices.empty() ? 0 : &meshData.Vertices[0], static_cast<UINT>(meshData.Vertices.size()),
+		meshData.Indices.empty() ? 0 : &meshData.Indices[0], static_cast<UINT>(meshData.Indices.size()),
+		result, maxVertices, maxTriangles);
+}
+
+void MeshletBuilder::Build(const GeometryGenerator::Vertex* vertices, UINT vertexCount,
+	const UINT* indices, UINT indexCount, MeshletMesh& result,
+	UINT maxVertices, UINT maxTriangles)
+{
+	result.Meshlets.clear();
+	result.Indices.clear();
+	result.Indices.reserve(indexCount);
+
+	UINT tcount = indexCount / 3;
+	if (tcount == 0)
+	{
+		return;
+	}
+
+	//Triangle centroids, unit normals and the centroid bounds
+	std::vector<XMFLOAT3> centroids(tcount);
+	std::vector<XMFLOAT3> faceNormals(tcount);
+	XMFLOAT3 vMin(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
+	XMFLOAT3 vMax(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+
+	for (UINT t = 0; t < tcount; ++t)
+	{
+		const XMFLOAT3& p0 = vertices[indices[3 * t + 0]].Position;
+		const XMFLOAT3& p1 = vertices[indices[3 * t + 1]].Position;
+		const XMFLOAT3& p2 = vertices[indices[3 * t + 2]].Position;
+
+		XMFLOAT3& c = centroids[t];
+		c = XMFLOAT3((p0.x + p1.x + p2.x) / 3.0f, (p0.y + p1.y + p2.y) / 3.0f, (p0.z + p1.z + p2.z) / 3.0f);
+
+		vMin = XMFLOAT3(MathHelper::Min(vMin.x, c.x), MathHelper::Min(vMin.y, c.y), MathHelper::Min(vMin.z, c.z));
+		vMax = XMFLOAT3(MathHelper::Max(vMax.x, c.x), MathHelper::Max(vMax.y, c.y), MathHelper::Max(vMax.z, c.z));
+
+		XMVECTOR a = XMLoadFloat3(&p0);
+		XMStoreFloat3(&faceNormals[t], XMVector3Normalize(XMVector3Cross(XMLoadFloat3(&p1) - a, XMLoadFloat3(&p2) - a)));
+	}
+
+	//Seeds are taken in Morton order so consecutive meshlets stay close
+	float size = MathHelper::Max(vMax.x - vMin.x, MathHelper::Max(vMax.y - vMin.y, vMax.z - vMin.z));
+	float scale = size > 0.0f ? 1023.0f / size : 0.0f;
+
+	std::vector<std::pair<UINT, UINT> > order(tcount);
+	for (UINT t = 0; t < tcount; ++t)
+	{
+		const XMFLOAT3& c = centroids[t];
+		UINT code = Part1By2(UINT((c.x - vMin.x)*scale)) |
+			(Part1By2(UINT((c.y - vMin.y)*scale)) << 1) |
+			(Part1By2(UINT((c.z - vMin.z)*scale)) << 2);
+
+		order[t] = std::make_pair(code, t);
+	}
+	std::sort(order.begin(), order.end());
+
+	//Vertex -> triangle adjacency
+	std::vector<UINT> adjacencyStart(vertexCount + 1, 0);
+	for (UINT i = 0; i < indexCount; ++i)
+	{
+		++adjacencyStart[indices[i] + 1];
+	}
+	for (UINT v = 0; v < vertexCount; ++v)
+	{
+		adjacencyStart[v + 1] += adjacencyStart[v];
+	}
+
+	std::vector<UINT> adjacency(indexCount);
+	std::vector<UINT> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (UINT i = 0; i < indexCount; ++i)
+	{
+		adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<char> used(tcount, 0);
+
+	//Meshlet a vertex was last added to, to count new vertices without clearing
+	std::vector<UINT> vertexMeshlet(vertexCount, UINT(-1));
+
+	std::vector<UINT> candidates;
+	std::vector<UINT> meshletVertices;
+	UINT seedCursor = 0;
+
+	while (true)
+	{
+		while (seedCursor < tcount && used[order[seedCursor].second])
+		{
+			++seedCursor;
+		}
+		if (seedCursor == tcount)
+		{
+			break;
+		}
+
+		UINT id = static_cast<UINT>(result.Meshlets.size());
+
+		Meshlet m;
+		m.StartIndex = static_cast<UINT>(result.Indices.size());
+		m.TriangleCount = 0;
+		m.VertexCount = 0;
+
+		candidates.clear();
+		meshletVertices.clear();
+
+		XMFLOAT3 centroidSum(0.0f, 0.0f, 0.0f);
+		XMFLOAT3 normalSum(0.0f, 0.0f, 0.0f);
+		UINT next = order[seedCursor].second;
+
+		while (true)
+		{
+			//Take the triangle
+			used[next] = 1;
+			++m.TriangleCount;
+
+			centroidSum.x += centroids[next].x;
+			centroidSum.y += centroids[next].y;
+			centroidSum.z += centroids[next].z;
+
+			normalSum.x += faceNormals[next].x;
+			normalSum.y += faceNormals[next].y;
+			normalSum.z += faceNormals[next].z;
+
+			for (int j = 0; j < 3; ++j)
+			{
+				UINT v = indices[3 * next + j];
+				result.Indices.push_back(v);
+
+				if (vertexMeshlet[v] != id)
+				{
+					vertexMeshlet[v] = id;
+					meshletVertices.push_back(v);
+
+					for (UINT a = adjacencyStart[v]; a < adjacencyStart[v + 1]; ++a)
+					{
+						if (!used[adjacency[a]])
+						{
+							candidates.push_back(adjacency[a]);
+						}
+					}
+				}
+			}
+
+			if (m.TriangleCount == maxTriangles)
+			{
+				break;
+			}
+
+			//Fewest new vertices first, then closest to the meshlet center with
+			//distance stretched for triangles turned away from the average
+			//normal, which keeps the normal cones narrow
+			XMFLOAT3 center(centroidSum.x / m.TriangleCount, centroidSum.y / m.TriangleCount, centroidSum.z / m.TriangleCount);
+
+			XMFLOAT3 normal(0.0f, 0.0f, 0.0f);
+			XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&normalSum)));
+
+			UINT best = UINT(-1);
+			UINT bestNew = 4;
+			float bestDistance = 0.0f;
+
+			for (size_t c = 0; c < candidates.size();)
+			{
+				UINT t = candidates[c];
+				if (used[t])
+				{
+					candidates[c] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+
+				UINT newVertices = 0;
+				for (int j = 0; j < 3; ++j)
+				{
+					newVertices += vertexMeshlet[indices[3 * t + j]] != id ? 1 : 0;
+				}
+
+				const XMFLOAT3& n = faceNormals[t];
+				float facing = n.x*normal.x + n.y*normal.y + n.z*normal.z;
+				float distance = DistanceSq(centroids[t], center)*(2.0f - facing);
+				if (meshletVertices.size() + newVertices <= maxVertices &&
+					(newVertices < bestNew || (newVertices == bestNew && distance < bestDistance)))
+				{
+					best = t;
+					bestNew = newVertices;
+					bestDistance = distance;
+				}
+
+				++c;
+			}
+
+			//Island used up while the meshlet is still small: continue with
+			//the next triangle along the Morton curve, which is close by
+			if (best == UINT(-1) && candidates.empty() && 2 * m.TriangleCount < maxTriangles &&
+				meshletVertices.size() + 3 <= maxVertices)
+			{
+				while (seedCursor < tcount && used[order[seedCursor].second])
+				{
+					++seedCursor;
+				}
+				if (seedCursor < tcount)
+				{
+					best = order[seedCursor].second;
+				}
+			}
+
+			if (best == UINT(-1))
+			{
+				break;
+			}
+
+			next = best;
+		}
+
+		m.VertexCount = static_cast<UINT>(meshletVertices.size());
+
+		//Bounding sphere around the box center of the vertices
+		XMFLOAT3 bMin(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
+		XMFLOAT3 bMax(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+		for (size_t i = 0; i < meshletVertices.size(); ++i)
+		{
+			const XMFLOAT3& p = vertices[meshletVertices[i]].Position;
+			bMin = XMFLOAT3(MathHelper::Min(bMin.x, p.x), MathHelper::Min(bMin.y, p.y), MathHelper::Min(bMin.z, p.z));
+			bMax = XMFLOAT3(MathHelper::Max(bMax.x, p.x), MathHelper::Max(bMax.y, p.y), MathHelper::Max(bMax.z, p.z));
+		}
+
+		m.Center = XMFLOAT3(0.5f*(bMin.x + bMax.x), 0.5f*(bMin.y + bMax.y), 0.5f*(bMin.z + bMax.z));
+		m.Radius = 0.0f;
+		for (size_t i = 0; i < meshletVertices.size(); ++i)
+		{
+			m.Radius = MathHelper::Max(m.Radius, DistanceSq(vertices[meshletVertices[i]].Position, m.Center));
+		}
+		m.Radius = sqrtf(m.Radius);
+
+		//Normal cone from the unit face normals
+		std::vector<XMVECTOR> normals(m.TriangleCount);
+		XMVECTOR axis = XMVectorZero();
+		for (UINT t = 0; t < m.TriangleCount; ++t)
+		{
+			const UINT* tri = &result.Indices[m.StartIndex + 3 * t];
+			XMVECTOR p0 = XMLoadFloat3(&vertices[tri[0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[tri[1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[tri[2]].Position);
+
+			normals[t] = XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0));
+			axis += normals[t];
+		}
+
+		m.ConeCutoff = 1.0f;
+		m.ConeAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+		if (XMVectorGetX(XMVector3LengthSq(axis)) > 1e-12f)
+		{
+			axis = XMVector3Normalize(axis);
+
+			float minDot = 1.0f;
+			for (UINT t = 0; t < m.TriangleCount; ++t)
+			{
+				minDot = MathHelper::Min(minDot, XMVectorGetX(XMVector3Dot(axis, normals[t])));
+			}
+
+			//Spread of 90 degrees or more can never be entirely backfacing
+			if (minDot > 0.0f)
+			{
+				XMStoreFloat3(&m.ConeAxis, axis);
+				m.ConeCutoff = sqrtf(1.0f - minDot*minDot);
+			}
+		}
+
+		result.Meshlets.push_back(m);
+	}
+}
+
+void MeshletBuilder::GetStats(const MeshletMesh& mesh, MeshletStats& stats)
+{
+	stats.MeshletCount = static_cast<UINT>(mesh.Meshlets.size());
+	stats.TriangleCount = 0;
+	stats.MinTriangles = stats.MeshletCount ? UINT(-1) : 0;
+	stats.MaxTriangles = 0;
+	stats.MaxVertices = 0;
+
+	UINT vertexTotal = 0;
+	for (size_t i = 0; i < mesh.Meshlets.size(); ++i)
+	{
+		const Meshlet& m = mesh.Meshlets[i];
+
+		stats.TriangleCount += m.TriangleCount;
+		stats.MinTriangles = MathHelper::Min(stats.MinTriangles, m.TriangleCount);
+		stats.MaxTriangles = MathHelper::Max(stats.MaxTriangles, m.TriangleCount);
+		stats.MaxVertices = MathHelper::Max(stats.MaxVertices, m.VertexCount);
+		vertexTotal += m.VertexCount;
+	}
+
+	stats.AverageTriangles = stats.MeshletCount ? static_cast<float>(stats.TriangleCount) / stats.MeshletCount : 0.0f;
+	stats.AverageVertices = stats.MeshletCount ? static_cast<float>(vertexTotal) / stats.MeshletCount : 0.0f;
+}
+
+UINT MeshletBuilder::Cull(const MeshletMesh& mesh, CXMMATRIX world, CXMMATRIX viewProj,
+	const XMFLOAT3& eyePosW, std::vector<UINT>& visibleIndices, CullStats* stats)
+{
+	//Everything is tested in model space
+	XMFLOAT4 planes[6];
+	ExtractFrustumPlanes(planes, XMMatrixMultiply(world, viewProj));
+
+	XMVECTOR det = XMMatrixDeterminant(world);
+	XMMATRIX invWorld = XMMatrixInverse(&det, world);
+
+	XMFLOAT3 eye;
+	XMStoreFloat3(&eye, XMVector3TransformCoord(XMLoadFloat3(&eyePosW), invWorld));
+
+	UINT frustumCulled = 0;
+	UINT backfaceCulled = 0;
+	UINT triangleCount = 0;
+	size_t first = visibleIndices.size();
+
+	for (size_t i = 0; i < mesh.Meshlets.size(); ++i)
+	{
+		const Meshlet& m = mesh.Meshlets[i];
+		triangleCount += m.TriangleCount;
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; ++p)
+		{
+			const XMFLOAT4& plane = planes[p];
+			outside = plane.x*m.Center.x + plane.y*m.Center.y + plane.z*m.Center.z + plane.w < -m.Radius;
+		}
+
+		if (outside)
+		{
+			++frustumCulled;
+			continue;
+		}
+
+		//Every triangle faces away if the eye sits behind the whole cone
+		XMFLOAT3 d(m.Center.x - eye.x, m.Center.y - eye.y, m.Center.z - eye.z);
+		float distance = sqrtf(d.x*d.x + d.y*d.y + d.z*d.z);
+		if (d.x*m.ConeAxis.x + d.y*m.ConeAxis.y + d.z*m.ConeAxis.z >= m.ConeCutoff*distance + m.Radius)
+		{
+			++backfaceCulled;
+			continue;
+		}
+
+		visibleIndices.insert(visibleIndices.end(),
+			mesh.Indices.begin() + m.StartIndex, mesh.Indices.begin() + m.StartIndex + 3 * m.TriangleCount);
+	}
+
+	UINT added = static_cast<UINT>(visibleIndices.size() - first);
+
+	if (stats)
+	{
+		stats->MeshletCount = static_cast<UINT>(mesh.Meshlets.size());
+		stats->FrustumCulled = frustumCulled;
+		stats->BackfaceCulled = backfaceCulled;
+		stats->TriangleCount = triangleCount;
+		stats->VisibleTriangleCount = added / 3;
+	}
+
+	return added;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+//Meshlets: small clusters of neighbouring triangles that can be culled on
+//their own
+//
+//The builder walks the triangles in Morton order of their centroids and
+//grows each meshlet through shared vertices, preferring triangles that add
+//no or few new vertices, until it reaches the triangle or vertex limit.
+//
+//Each meshlet keeps a bounding sphere and a normal cone. Per frame Cull()
+//drops meshlets outside the view frustum or facing away from the eye and
+//writes the indices of the rest into one compacted list for DrawIndexed.
+//Nothing here touches the device, so it can run and be checked headless.
+
+#ifndef _MESHLETBUILDER_H_
+#define _MESHLETBUILDER_H_
+
+#include "GeometryGenerator.h"
+
+class MeshletBuilder
+{
+public:
+	struct Meshlet
+	{
+		//Range in MeshletMesh::Indices
+		UINT StartIndex;
+		UINT TriangleCount;
+		UINT VertexCount;
+
+		//Bounding sphere
+		XMFLOAT3 Center;
+		float Radius;
+
+		//All triangle normals lie within the cone around ConeAxis,
+		//ConeCutoff is the sine of its half angle, 1 disables the test
+		XMFLOAT3 ConeAxis;
+		float ConeCutoff;
+	};
+
+	struct MeshletMesh
+	{
+		std::vector<Meshlet> Meshlets;
+
+		//The input indices regrouped meshlet by meshlet
+		std::vector<UINT> Indices;
+	};
+
+	struct MeshletStats
+	{
+		UINT MeshletCount;
+		UINT TriangleCount;
+		UINT MinTriangles;
+		UINT MaxTriangles;
+		float AverageTriangles;
+		UINT MaxVertices;
+		float AverageVertices;
+	};
+
+	struct CullStats
+	{
+		UINT MeshletCount;
+		UINT FrustumCulled;
+		UINT BackfaceCulled;
+		UINT TriangleCount;
+		UINT VisibleTriangleCount;
+	};
+
+public:
+	static void Build(const GeometryGenerator::Vertex* vertices, UINT vertexCount,
+		const UINT* indices, UINT indexCount, MeshletMesh& result,
+		UINT maxVertices = 64, UINT maxTriangles = 124);
+
+	static void Build(const GeometryGenerator::MeshData& meshData, MeshletMesh& result,
+		UINT maxVertices = 64, UINT maxTriangles = 124);
+
+	static void GetStats(const MeshletMesh& mesh, MeshletStats& stats);
+
+	//Appends the indices of the visible meshlets to visibleIndices and
+	//returns how many were added. world places the mesh, eyePosW is the
+	//camera position in world space.
+	static UINT Cull(const MeshletMesh& mesh, CXMMATRIX world, CXMMATRIX viewProj,
+		const XMFLOAT3& eyePosW, std::vector<UINT>& visibleIndices, CullStats* stats = 0);
+};
+
+#endif
@@ -0,0 +1,635 @@
+#include"MipGenerator.h"
+#include"TexelLayout.h"
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include<emmintrin.h>
+#define MIP_SSE
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	//The layouts the filters read and write
+	TexelLayout GetLayout(DXGI_FORMAT format, bool* srgb)
+	{
+		TexelLayout layout = GetTexelLayout(format, srgb);
+		switch (layout)
+		{
+		case LAYOUT_RGB10A2:
+		case LAYOUT_RGB32F:
+		case LAYOUT_R11G11B10:
+		case LAYOUT_RGB9E5:
+			return LAYOUT_NONE;
+
+		default:
+			return layout;
+		}
+	}
+
+	const float* SRGBToLinearTable()
+	{
+		static float table[256];
+		static bool built = [&]()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				float c = i / 255.0f;
+				table[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return true;
+		}();
+		(void)built;
+
+		return table;
+	}
+
+	inline float LinearToSRGB(float c)
+	{
+		if (c <= 0.0031308f)
+			return 12.92f*c;
+		return 1.055f*powf(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	inline float Saturate(float v)
+	{
+		return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+	}
+
+	inline uint8_t ToUnorm8(float v)
+	{
+		return static_cast<uint8_t>(Saturate(v)*255.0f + 0.5f);
+	}
+
+	inline uint16_t ToUnorm16(float v)
+	{
+		return static_cast<uint16_t>(Saturate(v)*65535.0f + 0.5f);
+	}
+
+	//Width texels into RGBA floats, colors to linear space when srgb is set
+	void LoadRow(TexelLayout layout, bool srgb, const uint8_t* src, size_t width, float* dst)
+	{
+		const float* toLinear = SRGBToLinearTable();
+		const float unorm = 1.0f / 255.0f;
+
+		for (size_t x = 0; x < width; ++x, dst += 4)
+		{
+			switch (layout)
+			{
+			case LAYOUT_RGBA8:
+			case LAYOUT_BGRA8:
+			case LAYOUT_BGRX8:
+			{
+				const uint8_t* t = src + x * 4;
+				bool bgr = layout != LAYOUT_RGBA8;
+				uint8_t r = bgr ? t[2] : t[0];
+				uint8_t b = bgr ? t[0] : t[2];
+				dst[0] = srgb ? toLinear[r] : r*unorm;
+				dst[1] = srgb ? toLinear[t[1]] : t[1] * unorm;
+				dst[2] = srgb ? toLinear[b] : b*unorm;
+				dst[3] = (layout == LAYOUT_BGRX8) ? 1.0f : t[3] * unorm;
+				break;
+			}
+
+			case LAYOUT_RG8:
+				dst[0] = src[x * 2] * unorm;
+				dst[1] = src[x * 2 + 1] * unorm;
+				dst[2] = 0.0f;
+				dst[3] = 1.0f;
+				break;
+
+			case LAYOUT_R8:
+				dst[0] = src[x] * unorm;
+				dst[1] = dst[2] = 0.0f;
+				dst[3] = 1.0f;
+				break;
+
+			case LAYOUT_A8:
+				dst[0] = dst[1] = dst[2] = 0.0f;
+				dst[3] = src[x] * unorm;
+				break;
+
+			case LAYOUT_RGBA16:
+			{
+				const uint16_t* t = reinterpret_cast<const uint16_t*>(src) + x * 4;
+				for (int c = 0; c < 4; ++c)
+					dst[c] = t[c] * (1.0f / 65535.0f);
+				break;
+			}
+
+			case LAYOUT_RGBA16F:
+			{
+				const uint16_t* t = reinterpret_cast<const uint16_t*>(src) + x * 4;
+				for (int c = 0; c < 4; ++c)
+					dst[c] = HalfToFloat(t[c]);
+				break;
+			}
+
+			case LAYOUT_R16F:
+				dst[0] = HalfToFloat(reinterpret_cast<const uint16_t*>(src)[x]);
+				dst[1] = dst[2] = 0.0f;
+				dst[3] = 1.0f;
+				break;
+
+			case LAYOUT_RGBA32F:
+				memcpy(dst, src + x * 16, 16);
+				break;
+
+			case LAYOUT_R32F:
+				memcpy(dst, src + x * 4, 4);
+				dst[1] = dst[2] = 0.0f;
+				dst[3] = 1.0f;
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+
+	void StoreRow(TexelLayout layout, bool srgb, const float* src, size_t width, float alphaScale, uint8_t* dst)
+	{
+		for (size_t x = 0; x < width; ++x, src += 4)
+		{
+			float r = srgb ? LinearToSRGB(src[0]) : src[0];
+			float g = srgb ? LinearToSRGB(src[1]) : src[1];
+			float b = srgb ? LinearToSRGB(src[2]) : src[2];
+			float a = src[3] * alphaScale;
+
+			switch (layout)
+			{
+			case LAYOUT_RGBA8:
+			case LAYOUT_BGRA8:
+			case LAYOUT_BGRX8:
+			{
+				uint8_t* t = dst + x * 4;
+				bool bgr = layout != LAYOUT_RGBA8;
+				t[bgr ? 2 : 0] = ToUnorm8(r);
+				t[1] = ToUnorm8(g);
+				t[bgr ? 0 : 2] = ToUnorm8(b);
+				t[3] = (layout == LAYOUT_BGRX8) ? 255 : ToUnorm8(a);
+				break;
+			}
+
+			case LAYOUT_RG8:
+				dst[x * 2] = ToUnorm8(r);
+				dst[x * 2 + 1] = ToUnorm8(g);
+				break;
+
+			case LAYOUT_R8:
+				dst[x] = ToUnorm8(r);
+				break;
+
+			case LAYOUT_A8:
+				dst[x] = ToUnorm8(a);
+				break;
+
+			case LAYOUT_RGBA16:
+			{
+				uint16_t* t = reinterpret_cast<uint16_t*>(dst) + x * 4;
+				t[0] = ToUnorm16(r);
+				t[1] = ToUnorm16(g);
+				t[2] = ToUnorm16(b);
+				t[3] = ToUnorm16(a);
+				break;
+			}
+
+			case LAYOUT_RGBA16F:
+			{
+				uint16_t* t = reinterpret_cast<uint16_t*>(dst) + x * 4;
+				t[0] = FloatToHalf(r);
+				t[1] = FloatToHalf(g);
+				t[2] = FloatToHalf(b);
+				t[3] = FloatToHalf(a);
+				break;
+			}
+
+			case LAYOUT_R16F:
+				reinterpret_cast<uint16_t*>(dst)[x] = FloatToHalf(r);
+				break;
+
+			case LAYOUT_RGBA32F:
+			{
+				float t[4] = { r, g, b, a };
+				memcpy(dst + x * 16, t, 16);
+				break;
+			}
+
+			case LAYOUT_R32F:
+				memcpy(dst + x * 4, &r, 4);
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+
+	//Zeroth order modified Bessel function of the first kind
+	double Bessel0(double x)
+	{
+		double sum = 1.0;
+		double term = 1.0;
+		for (int k = 1; k < 32; ++k)
+		{
+			term *= (x / (2.0*k))*(x / (2.0*k));
+			sum += term;
+			if (term < sum*1e-12)
+				break;
+		}
+		return sum;
+	}
+
+	//x in destination texels
+	const double KaiserWidth = 3.0;
+	const double KaiserAlpha = 4.0;
+
+	double Kaiser(double x)
+	{
+		const double pi = 3.14159265358979323846;
+
+		double t = x / KaiserWidth;
+		if (t <= -1.0 || t >= 1.0)
+			return 0.0;
+
+		double sinc = (fabs(x) < 1e-6) ? 1.0 : sin(pi*x) / (pi*x);
+		return sinc*Bessel0(KaiserAlpha*sqrt(1.0 - t*t)) / Bessel0(KaiserAlpha);
+	}
+}
+
+MipGenerator::Options::Options()
+	:Filter(MIP_FILTER_BOX),
+	ForceSRGB(false),
+	Wrap(false),
+	AlphaReference(0.0f),
+	MipLevels(0)
+{
+}
+
+MipGenerator::MipGenerator(JobSystem& jobs)
+	:m_jobs(jobs)
+{
+}
+
+bool MipGenerator::IsSupported(DXGI_FORMAT format)
+{
+	if (IsCompressed(format))
+		format = GetDecompressedFormat(format);
+
+	bool srgb;
+	return GetLayout(format, &srgb) != LAYOUT_NONE;
+}
+
+UINT MipGenerator::CountMips(size_t width, size_t height)
+{
+	UINT count = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max<size_t>(width >> 1, 1);
+		height = std::max<size_t>(height >> 1, 1);
+		++count;
+	}
+	return count;
+}
+
+void MipGenerator::BuildTaps(size_t srcSize, size_t dstSize, MipFilter filter, bool wrap, Taps& taps)
+{
+	taps.First.resize(dstSize);
+	taps.Count.resize(dstSize);
+	taps.Index.clear();
+	taps.Weight.clear();
+
+	const double scale = double(srcSize) / double(dstSize);
+	const long long size = static_cast<long long>(srcSize);
+
+	for (size_t d = 0; d < dstSize; ++d)
+	{
+		taps.First[d] = static_cast<UINT>(taps.Index.size());
+
+		if (srcSize == dstSize)
+		{
+			taps.Index.push_back(static_cast<UINT>(d));
+			taps.Weight.push_back(1.0f);
+		}
+		else if (filter == MIP_FILTER_BOX)
+		{
+			//Overlap of every source texel with the footprint
+			double start = d*scale;
+			double end = (d + 1)*scale;
+			for (long long s = static_cast<long long>(floor(start)); s < end; ++s)
+			{
+				double w = std::min<double>(end, double(s + 1)) - std::max<double>(start, double(s));
+				if (w > 0.0)
+				{
+					taps.Index.push_back(static_cast<UINT>(std::min<long long>(s, size - 1)));
+					taps.Weight.push_back(static_cast<float>(w));
+				}
+			}
+		}
+		else
+		{
+			double center = (d + 0.5)*scale;
+			double radius = KaiserWidth*scale;
+			long long first = static_cast<long long>(floor(center - radius));
+			long long last = static_cast<long long>(ceil(center + radius));
+			for (long long s = first; s <= last; ++s)
+			{
+				double w = Kaiser((s + 0.5 - center) / scale);
+				if (w == 0.0)
+					continue;
+
+				long long i = s;
+				if (wrap)
+					i = ((i % size) + size) % size;
+				else
+					i = std::min<long long>(std::max<long long>(i, 0), size - 1);
+
+				taps.Index.push_back(static_cast<UINT>(i));
+				taps.Weight.push_back(static_cast<float>(w));
+			}
+		}
+
+		taps.Count[d] = static_cast<UINT>(taps.Index.size()) - taps.First[d];
+
+		float sum = 0.0f;
+		for (UINT i = taps.First[d]; i < taps.First[d] + taps.Count[d]; ++i)
+			sum += taps.Weight[i];
+		for (UINT i = taps.First[d]; i < taps.First[d] + taps.Count[d]; ++i)
+			taps.Weight[i] /= sum;
+	}
+}
+
+void MipGenerator::Downsample(const Image& src, Image& dst, const Taps& horizontal, const Taps& vertical, Image& temp)
+{
+	temp.Width = dst.Width;
+	temp.Height = src.Height;
+	temp.Slices = src.Slices;
+	temp.Texels.resize(temp.Width*temp.Height*temp.Slices * 4);
+
+	//Width then height, rows of all slices at once
+	UINT rows = static_cast<UINT>(src.Slices*src.Height);
+	UINT grain = static_cast<UINT>(std::max<size_t>(1, 16384 / src.Width));
+	m_jobs.ParallelFor(rows, grain, [&](UINT begin, UINT end, UINT)
+	{
+		for (UINT row = begin; row < end; ++row)
+		{
+			const float* in = &src.Texels[size_t(row)*src.Width * 4];
+			float* out = &temp.Texels[size_t(row)*temp.Width * 4];
+
+			for (size_t x = 0; x < temp.Width; ++x, out += 4)
+			{
+				const UINT* index = &horizontal.Index[horizontal.First[x]];
+				const float* weight = &horizontal.Weight[horizontal.First[x]];
+				UINT count = horizontal.Count[x];
+#if defined(MIP_SSE)
+				__m128 sum = _mm_setzero_ps();
+				for (UINT i = 0; i < count; ++i)
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + index[i] * 4), _mm_set1_ps(weight[i])));
+				_mm_storeu_ps(out, sum);
+#else
+				out[0] = out[1] = out[2] = out[3] = 0.0f;
+				for (UINT i = 0; i < count; ++i)
+				{
+					const float* t = in + index[i] * 4;
+					for (int c = 0; c < 4; ++c)
+						out[c] += t[c] * weight[i];
+				}
+#endif
+			}
+		}
+	});
+
+	rows = static_cast<UINT>(dst.Slices*dst.Height);
+	grain = static_cast<UINT>(std::max<size_t>(1, 16384 / dst.Width));
+	m_jobs.ParallelFor(rows, grain, [&](UINT begin, UINT end, UINT)
+	{
+		const size_t floats = dst.Width * 4;
+		for (UINT row = begin; row < end; ++row)
+		{
+			size_t slice = row / dst.Height;
+			size_t y = row % dst.Height;
+			float* out = dst.Row(slice, y);
+			memset(out, 0, floats*sizeof(float));
+
+			for (UINT i = vertical.First[y]; i < vertical.First[y] + vertical.Count[y]; ++i)
+			{
+				const float* in = temp.Row(slice, vertical.Index[i]);
+				float w = vertical.Weight[i];
+#if defined(MIP_SSE)
+				__m128 weight = _mm_set1_ps(w);
+				for (size_t f = 0; f < floats; f += 4)
+					_mm_storeu_ps(out + f, _mm_add_ps(_mm_loadu_ps(out + f), _mm_mul_ps(_mm_loadu_ps(in + f), weight)));
+#else
+				for (size_t f = 0; f < floats; ++f)
+					out[f] += in[f] * w;
+#endif
+			}
+		}
+	});
+}
+
+float MipGenerator::Coverage(const float* texels, size_t count, float reference, float scale)
+{
+	size_t passed = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (std::min(texels[i * 4 + 3] * scale, 1.0f) >= reference)
+			++passed;
+	}
+	return float(passed) / float(count);
+}
+
+float MipGenerator::FindAlphaScale(const float* texels, size_t count, float reference, float coverage)
+{
+	//Coverage only grows with the scale
+	float low = 0.0f;
+	float high = 1.0f;
+	while (Coverage(texels, count, reference, high) < coverage && high < 256.0f)
+	{
+		low = high;
+		high *= 2.0f;
+	}
+
+	for (int i = 0; i < 16; ++i)
+	{
+		float mid = 0.5f*(low + high);
+		if (Coverage(texels, count, reference, mid) < coverage)
+			low = mid;
+		else
+			high = mid;
+	}
+	return high;
+}
+
+bool MipGenerator::Generate(const DDSTextureInfo& info,
+	const std::vector<DDSSubresource>& subresources,
+	const Options& options,
+	DDSTextureInfo& outInfo,
+	std::vector<DDSSubresource>& outSubresources,
+	std::vector<uint8_t>& outData)
+{
+	outSubresources.clear();
+	outData.clear();
+
+	if (!IsSupported(info.format) || info.resourceDimension == DDS_DIMENSION_TEXTURE3D
+		|| !info.width || !info.height || !info.arraySize || !info.mipLevels
+		|| subresources.size() != info.mipLevels*info.arraySize)
+		return false;
+
+	const size_t slices = info.arraySize;
+
+	//Level 0 of every slice, decoded when block compressed
+	DXGI_FORMAT format = info.format;
+	std::vector<const uint8_t*> topData(slices);
+	std::vector<size_t> topPitch(slices);
+	std::vector<uint8_t> decoded;
+
+	if (IsCompressed(format))
+	{
+		format = GetDecompressedFormat(format);
+
+		size_t pitch = info.width*BitsPerPixel(format) / 8;
+		decoded.resize(pitch*info.height*slices);
+		for (size_t s = 0; s < slices; ++s)
+		{
+			const DDSSubresource& sub = subresources[CalcDDSSubresource(0, s, info.mipLevels)];
+			topData[s] = &decoded[s*pitch*info.height];
+			topPitch[s] = pitch;
+			if (FAILED(DecompressBC(info.format, info.width, info.height, sub.pData, sub.rowPitch,
+				&decoded[s*pitch*info.height], pitch)))
+				return false;
+		}
+	}
+	else
+	{
+		for (size_t s = 0; s < slices; ++s)
+		{
+			const DDSSubresource& sub = subresources[CalcDDSSubresource(0, s, info.mipLevels)];
+			topData[s] = sub.pData;
+			topPitch[s] = sub.rowPitch;
+		}
+	}
+
+	bool srgb;
+	const TexelLayout layout = GetLayout(format, &srgb);
+	if (options.ForceSRGB && (layout == LAYOUT_RGBA8 || layout == LAYOUT_BGRA8 || layout == LAYOUT_BGRX8))
+		srgb = true;
+
+	UINT levels = CountMips(info.width, info.height);
+	if (options.MipLevels)
+		levels = std::min(levels, options.MipLevels);
+
+	//Output laid out like a DDS body: all levels of slice 0, then slice 1...
+	const size_t texelBytes = BitsPerPixel(format) / 8;
+	outSubresources.resize(levels*slices);
+
+	size_t offset = 0;
+	for (size_t s = 0; s < slices; ++s)
+	{
+		size_t w = info.width;
+		size_t h = info.height;
+		for (UINT level = 0; level < levels; ++level)
+		{
+			DDSSubresource& sub = outSubresources[CalcDDSSubresource(level, s, levels)];
+			sub.pData = 0;
+			sub.offset = offset;
+			sub.rowPitch = w*texelBytes;
+			sub.slicePitch = sub.rowPitch*h;
+			sub.width = w;
+			sub.height = h;
+			sub.depth = 1;
+			offset += sub.slicePitch;
+
+			w = std::max<size_t>(w >> 1, 1);
+			h = std::max<size_t>(h >> 1, 1);
+		}
+	}
+
+	outData.resize(offset);
+	for (DDSSubresource& sub : outSubresources)
+		sub.pData = &outData[sub.offset];
+
+	//The top level keeps its exact bits
+	for (size_t s = 0; s < slices; ++s)
+	{
+		const DDSSubresource& sub = outSubresources[CalcDDSSubresource(0, s, levels)];
+		for (size_t y = 0; y < info.height; ++y)
+			memcpy(&outData[sub.offset + y*sub.rowPitch], topData[s] + y*topPitch[s], sub.rowPitch);
+	}
+
+	Image current;
+	current.Width = info.width;
+	current.Height = info.height;
+	current.Slices = slices;
+	current.Texels.resize(current.Width*current.Height*slices * 4);
+
+	UINT rows = static_cast<UINT>(slices*info.height);
+	m_jobs.ParallelFor(rows, static_cast<UINT>(std::max<size_t>(1, 16384 / info.width)), [&](UINT begin, UINT end, UINT)
+	{
+		for (UINT row = begin; row < end; ++row)
+		{
+			size_t s = row / info.height;
+			size_t y = row % info.height;
+			LoadRow(layout, srgb, topData[s] + y*topPitch[s], info.width, current.Row(s, y));
+		}
+	});
+
+	//Share of texels passing the alpha test at the top
+	const float reference = options.AlphaReference;
+	std::vector<float> coverage(slices, 0.0f);
+	if (reference > 0.0f)
+	{
+		for (size_t s = 0; s < slices; ++s)
+			coverage[s] = Coverage(current.Row(s, 0), info.width*info.height, reference, 1.0f);
+	}
+
+	Image next;
+	Image temp;
+	Taps horizontal;
+	Taps vertical;
+	std::vector<float> alphaScale(slices, 1.0f);
+
+	for (UINT level = 1; level < levels; ++level)
+	{
+		next.Width = std::max<size_t>(current.Width >> 1, 1);
+		next.Height = std::max<size_t>(current.Height >> 1, 1);
+		next.Slices = slices;
+		next.Texels.resize(next.Width*next.Height*slices * 4);
+
+		BuildTaps(current.Width, next.Width, options.Filter, options.Wrap, horizontal);
+		BuildTaps(current.Height, next.Height, options.Filter, options.Wrap, vertical);
+		Downsample(current, next, horizontal, vertical, temp);
+
+		if (reference > 0.0f)
+		{
+			m_jobs.ParallelFor(static_cast<UINT>(slices), 1, [&](UINT begin, UINT end, UINT)
+			{
+				for (UINT s = begin; s < end; ++s)
+					alphaScale[s] = FindAlphaScale(next.Row(s, 0), next.Width*next.Height, reference, coverage[s]);
+			});
+		}
+
+		rows = static_cast<UINT>(slices*next.Height);
+		m_jobs.ParallelFor(rows, static_cast<UINT>(std::max<size_t>(1, 16384 / next.Width)), [&](UINT begin, UINT end, UINT)
+		{
+			for (UINT row = begin; row < end; ++row)
+			{
+				size_t s = row / next.Height;
+				size_t y = row % next.Height;
+				const DDSSubresource& sub = outSubresources[CalcDDSSubresource(level, s, levels)];
+				StoreRow(layout, srgb, next.Row(s, y), next.Width, alphaScale[s], &outData[sub.offset + y*sub.rowPitch]);
+			}
+		});
+
+		//Each level is filtered from the unscaled one above it
+		std::swap(current, next);
+	}
+
+	outInfo = info;
+	outInfo.format = format;
+	outInfo.mipLevels = levels;
+	return true;
+}
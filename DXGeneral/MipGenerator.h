@@ -0,0 +1,107 @@
+#pragma once
+
+//CPU mip chain generation for textures stored with a single level
+//
+//Replaces ID3D11DeviceContext::GenerateMips, which needs a device, makes
+//the texture a render target and does not take block compressed formats.
+//Each level is filtered from the one above it in float RGBA, one horizontal
+//and one vertical pass, with the rows of all array slices spread over the
+//job system. Colors of sRGB textures are filtered in linear space. With an
+//alpha reference set, the alpha of every level is scaled so the share of
+//texels passing an alpha test at that reference stays what it was at the
+//top, which keeps foliage and fences from thinning out in the distance.
+//
+//Block compressed tops are decoded first, the chain then comes out in the
+//decoded format (see DirectX::GetDecompressedFormat).
+//
+//The Ex loaders of DDSTextureLoader run it for DEFAULT and IMMUTABLE
+//textures when given DDS_LOADER_GENERATE_MIPS.
+
+#ifndef _MIPGENERATOR_H_
+#define _MIPGENERATOR_H_
+
+#include"DDSParser.h"
+#include"JobSystem.h"
+
+class MipGenerator
+{
+public:
+	enum MipFilter
+	{
+		//Area average, a plain 2x2 box for even sizes
+		MIP_FILTER_BOX = 0,
+
+		//Kaiser windowed sinc, 3 texels wide, keeps distant detail sharper
+		MIP_FILTER_KAISER
+	};
+
+	struct Options
+	{
+		Options();
+
+		MipFilter Filter;
+
+		//Filter colors in linear space even though the format is not _SRGB
+		bool ForceSRGB;
+
+		//Sample across the edges from the opposite side, for tiling textures
+		bool Wrap;
+
+		//Alpha test reference to preserve coverage for, 0 filters alpha as is
+		float AlphaReference;
+
+		//Levels in the result including the top, 0 for a full chain to 1x1
+		UINT MipLevels;
+	};
+
+public:
+	MipGenerator(JobSystem& jobs = JobSystem::Default());
+
+	//Formats Generate() can read; block compressed ones included
+	static bool IsSupported(DXGI_FORMAT format);
+
+	//Builds the chain below level 0 of every array slice of a 1D, 2D or cube
+	//texture. outSubresources point into outData, laid out like a DDS file
+	//body, so the result goes straight to WriteDDS() or to texture creation.
+	bool Generate(const DirectX::DDSTextureInfo& info,
+		const std::vector<DirectX::DDSSubresource>& subresources,
+		const Options& options,
+		DirectX::DDSTextureInfo& outInfo,
+		std::vector<DirectX::DDSSubresource>& outSubresources,
+		std::vector<uint8_t>& outData);
+
+	static UINT CountMips(size_t width, size_t height);
+
+private:
+	//Source texels and weights of one output texel along one axis
+	struct Taps
+	{
+		std::vector<UINT> First;
+		std::vector<UINT> Count;
+		std::vector<UINT> Index;
+		std::vector<float> Weight;
+	};
+
+	//One level of every slice in float RGBA
+	struct Image
+	{
+		size_t Width;
+		size_t Height;
+		size_t Slices;
+		std::vector<float> Texels;
+
+		float* Row(size_t slice, size_t y) { return &Texels[((slice*Height) + y)*Width * 4]; }
+		const float* Row(size_t slice, size_t y) const { return &Texels[((slice*Height) + y)*Width * 4]; }
+	};
+
+	static void BuildTaps(size_t srcSize, size_t dstSize, MipFilter filter, bool wrap, Taps& taps);
+	void Downsample(const Image& src, Image& dst, const Taps& horizontal, const Taps& vertical, Image& temp);
+
+	static float Coverage(const float* texels, size_t count, float reference, float scale);
+	static float FindAlphaScale(const float* texels, size_t count, float reference, float coverage);
+
+private:
+	JobSystem& m_jobs;
+};
+
+#endif
@@ -0,0 +1,1141 @@
+#include "NullDevice.h"
+#include "DDSParser.h"
+
+#include<algorithm>
+#include<atomic>
+#include<string.h>
+
+void NullDeviceLog::Clear()
+{
+	Commands.clear();
+	ZeroMemory(&Totals, sizeof(Totals));
+}
+
+namespace
+{
+	//Bytes of all mips and slices, through the DDS size rules
+	UINT64 TextureBytes(UINT width, UINT height, UINT mipLevels, UINT arraySize, DXGI_FORMAT format)
+	{
+		if (!mipLevels)
+		{
+			//A full chain
+			for (UINT size = width > height ? width : height; size; size >>= 1)
+				++mipLevels;
+		}
+
+		UINT64 bytes = 0;
+		for (UINT mip = 0; mip < mipLevels; ++mip)
+		{
+			size_t numBytes = 0;
+			size_t rowBytes = 0;
+			size_t numRows = 0;
+			DirectX::GetSurfaceInfo((std::max)(width >> mip, 1u), (std::max)(height >> mip, 1u), format,
+				&numBytes, &rowBytes, &numRows);
+			bytes += numBytes;
+		}
+
+		return bytes*arraySize;
+	}
+
+	//IUnknown and ID3D11DeviceChild of every object of the device. Each
+	//holds a reference to the device, as on a real one.
+	template<typename Interface>
+	class NullDeviceChild : public Interface
+	{
+	public:
+		NullDeviceChild(NullDevice* device)
+			:m_device(device), m_references(1)
+		{
+			m_device->AddRef();
+		}
+
+		virtual ~NullDeviceChild()
+		{
+			m_device->Release();
+		}
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object)
+		{
+			if (!object)
+				return E_POINTER;
+
+			if (riid == __uuidof(Interface) || riid == __uuidof(ID3D11DeviceChild) ||
+				riid == __uuidof(IUnknown) || Implements(riid))
+			{
+				*object = static_cast<Interface*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*object = 0;
+			return E_NOINTERFACE;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef()
+		{
+			return ++m_references;
+		}
+
+		ULONG STDMETHODCALLTYPE Release()
+		{
+			ULONG references = --m_references;
+			if (!references)
+				delete this;
+
+			return references;
+		}
+
+		void STDMETHODCALLTYPE GetDevice(ID3D11Device** device)
+		{
+			m_device->AddRef();
+			*device = m_device;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT* dataSize, void*)
+		{
+			if (dataSize)
+				*dataSize = 0;
+
+			return DXGI_ERROR_NOT_FOUND;
+		}
+
+		//Debug names and the like are dropped
+		HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) { return S_OK; }
+		HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) { return S_OK; }
+
+	protected:
+		//Interfaces between Interface and ID3D11DeviceChild
+		virtual bool Implements(REFIID) const { return false; }
+
+	protected:
+		NullDevice* m_device;
+
+	private:
+		std::atomic<ULONG> m_references;
+	};
+
+	template<typename Interface, D3D11_RESOURCE_DIMENSION Dimension>
+	class NullResource : public NullDeviceChild<Interface>
+	{
+	public:
+		NullResource(NullDevice* device)
+			:NullDeviceChild<Interface>(device), m_evictionPriority(0)
+		{
+		}
+
+		void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION* dimension) { *dimension = Dimension; }
+		void STDMETHODCALLTYPE SetEvictionPriority(UINT priority) { m_evictionPriority = priority; }
+		UINT STDMETHODCALLTYPE GetEvictionPriority() { return m_evictionPriority; }
+
+	protected:
+		bool Implements(REFIID riid) const { return riid == __uuidof(ID3D11Resource); }
+
+	private:
+		UINT m_evictionPriority;
+	};
+
+	//Keeps its contents, for Map() and UpdateSubresource()
+	class NullBuffer : public NullResource<ID3D11Buffer, D3D11_RESOURCE_DIMENSION_BUFFER>
+	{
+	public:
+		NullBuffer(NullDevice* device, const D3D11_BUFFER_DESC& desc)
+			:NullResource(device), m_desc(desc), m_data(desc.ByteWidth)
+		{
+		}
+
+		void STDMETHODCALLTYPE GetDesc(D3D11_BUFFER_DESC* desc) { *desc = m_desc; }
+
+		BYTE* Data() { return m_data.data(); }
+		UINT Size() const { return m_desc.ByteWidth; }
+
+	private:
+		D3D11_BUFFER_DESC m_desc;
+		std::vector<BYTE> m_data;
+	};
+
+	//Contents are not kept
+	class NullTexture2D : public NullResource<ID3D11Texture2D, D3D11_RESOURCE_DIMENSION_TEXTURE2D>
+	{
+	public:
+		NullTexture2D(NullDevice* device, const D3D11_TEXTURE2D_DESC& desc)
+			:NullResource(device), m_desc(desc)
+		{
+		}
+
+		void STDMETHODCALLTYPE GetDesc(D3D11_TEXTURE2D_DESC* desc) { *desc = m_desc; }
+
+	private:
+		D3D11_TEXTURE2D_DESC m_desc;
+	};
+
+	template<typename Interface, typename Desc>
+	class NullView : public NullDeviceChild<Interface>
+	{
+	public:
+		//A null desc views the whole resource, the desc is then left zeroed
+		NullView(NullDevice* device, ID3D11Resource* resource, const Desc* desc)
+			:NullDeviceChild<Interface>(device), m_resource(resource)
+		{
+			m_resource->AddRef();
+
+			if (desc)
+				m_desc = *desc;
+			else
+				ZeroMemory(&m_desc, sizeof(m_desc));
+		}
+
+		~NullView()
+		{
+			m_resource->Release();
+		}
+
+		void STDMETHODCALLTYPE GetResource(ID3D11Resource** resource)
+		{
+			m_resource->AddRef();
+			*resource = m_resource;
+		}
+
+		void STDMETHODCALLTYPE GetDesc(Desc* desc) { *desc = m_desc; }
+
+	protected:
+		bool Implements(REFIID riid) const { return riid == __uuidof(ID3D11View); }
+
+	private:
+		ID3D11Resource* m_resource;
+		Desc m_desc;
+	};
+
+	template<typename Interface, typename Desc>
+	class NullState : public NullDeviceChild<Interface>
+	{
+	public:
+		NullState(NullDevice* device, const Desc& desc)
+			:NullDeviceChild<Interface>(device), m_desc(desc)
+		{
+		}
+
+		void STDMETHODCALLTYPE GetDesc(Desc* desc) { *desc = m_desc; }
+
+	private:
+		Desc m_desc;
+	};
+
+	NullBuffer* AsBuffer(ID3D11Resource* resource)
+	{
+		D3D11_RESOURCE_DIMENSION dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+		if (resource)
+			resource->GetType(&dimension);
+
+		if (dimension != D3D11_RESOURCE_DIMENSION_BUFFER)
+			return 0;
+
+		return static_cast<NullBuffer*>(static_cast<ID3D11Buffer*>(resource));
+	}
+
+	//Clears what a Get call of the context returns
+	template<typename T>
+	void ClearOut(T** objects, UINT count)
+	{
+		if (!objects)
+			return;
+
+		for (UINT i = 0; i < count; ++i)
+		{
+			objects[i] = 0;
+		}
+	}
+
+	//The immediate context. Binds are counted and forgotten; it shares the
+	//reference count of the device, like the real one.
+	class NullDeviceContext : public ID3D11DeviceContext
+	{
+	public:
+		NullDeviceContext(NullDevice* device)
+			:m_device(device)
+		{
+		}
+
+		//IUnknown
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object)
+		{
+			if (!object)
+				return E_POINTER;
+
+			if (riid == __uuidof(ID3D11DeviceContext) || riid == __uuidof(ID3D11DeviceChild) || riid == __uuidof(IUnknown))
+			{
+				*object = static_cast<ID3D11DeviceContext*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*object = 0;
+			return E_NOINTERFACE;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef() { return m_device->AddRef(); }
+		ULONG STDMETHODCALLTYPE Release() { return m_device->Release(); }
+
+		//ID3D11DeviceChild
+		void STDMETHODCALLTYPE GetDevice(ID3D11Device** device)
+		{
+			m_device->AddRef();
+			*device = m_device;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* dataSize, void* data) { return m_device->GetPrivateData(guid, dataSize, data); }
+		HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT dataSize, const void* data) { return m_device->SetPrivateData(guid, dataSize, data); }
+		HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* data) { return m_device->SetPrivateDataInterface(guid, data); }
+
+		//Shader stages
+		void STDMETHODCALLTYPE VSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE VSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE VSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE VSSetShader(ID3D11VertexShader*, ID3D11ClassInstance* const*, UINT) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE HSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE HSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE HSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE HSSetShader(ID3D11HullShader*, ID3D11ClassInstance* const*, UINT) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE DSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE DSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE DSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE DSSetShader(ID3D11DomainShader*, ID3D11ClassInstance* const*, UINT) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE GSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE GSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE GSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE GSSetShader(ID3D11GeometryShader*, ID3D11ClassInstance* const*, UINT) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE PSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE PSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE PSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE PSSetShader(ID3D11PixelShader*, ID3D11ClassInstance* const*, UINT) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE CSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE CSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE CSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE CSSetShader(ID3D11ComputeShader*, ID3D11ClassInstance* const*, UINT) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE CSSetUnorderedAccessViews(UINT, UINT, ID3D11UnorderedAccessView* const*, const UINT*) { m_device->RecordStateCall(); }
+
+		//Input assembler, rasterizer, output merger
+		void STDMETHODCALLTYPE IASetInputLayout(ID3D11InputLayout*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE IASetVertexBuffers(UINT, UINT, ID3D11Buffer* const*, const UINT*, const UINT*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE IASetIndexBuffer(ID3D11Buffer*, DXGI_FORMAT, UINT) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE RSSetState(ID3D11RasterizerState*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE RSSetViewports(UINT, const D3D11_VIEWPORT*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE RSSetScissorRects(UINT, const D3D11_RECT*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE OMSetRenderTargets(UINT, ID3D11RenderTargetView* const*, ID3D11DepthStencilView*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE OMSetRenderTargetsAndUnorderedAccessViews(UINT, ID3D11RenderTargetView* const*, ID3D11DepthStencilView*,
+			UINT, UINT, ID3D11UnorderedAccessView* const*, const UINT*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE OMSetBlendState(ID3D11BlendState*, const FLOAT[4], UINT) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE OMSetDepthStencilState(ID3D11DepthStencilState*, UINT) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE SOSetTargets(UINT, ID3D11Buffer* const*, const UINT*) { m_device->RecordStateCall(); }
+		void STDMETHODCALLTYPE SetPredication(ID3D11Predicate*, BOOL) { m_device->RecordStateCall(); }
+
+		//Draws
+		void STDMETHODCALLTYPE Draw(UINT vertexCount, UINT)
+		{
+			m_device->Record(NullDeviceLog::COMMAND_DRAW, vertexCount);
+		}
+
+		void STDMETHODCALLTYPE DrawIndexed(UINT indexCount, UINT, INT)
+		{
+			m_device->Record(NullDeviceLog::COMMAND_DRAW, indexCount);
+		}
+
+		void STDMETHODCALLTYPE DrawInstanced(UINT vertexCount, UINT instanceCount, UINT, UINT)
+		{
+			m_device->Record(NullDeviceLog::COMMAND_DRAW, (UINT64)vertexCount*instanceCount);
+		}
+
+		void STDMETHODCALLTYPE DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT, INT, UINT)
+		{
+			m_device->Record(NullDeviceLog::COMMAND_DRAW, (UINT64)indexCount*instanceCount);
+		}
+
+		//The counts of these are on the GPU
+		void STDMETHODCALLTYPE DrawAuto() { m_device->Record(NullDeviceLog::COMMAND_DRAW, 0); }
+		void STDMETHODCALLTYPE DrawIndexedInstancedIndirect(ID3D11Buffer*, UINT) { m_device->Record(NullDeviceLog::COMMAND_DRAW, 0); }
+		void STDMETHODCALLTYPE DrawInstancedIndirect(ID3D11Buffer*, UINT) { m_device->Record(NullDeviceLog::COMMAND_DRAW, 0); }
+		void STDMETHODCALLTYPE Dispatch(UINT, UINT, UINT) {}
+		void STDMETHODCALLTYPE DispatchIndirect(ID3D11Buffer*, UINT) {}
+
+		//Resources. Only buffers can be mapped.
+		HRESULT STDMETHODCALLTYPE Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP, UINT, D3D11_MAPPED_SUBRESOURCE* mapped)
+		{
+			NullBuffer* buffer = AsBuffer(resource);
+			if (!buffer || subresource != 0 || !mapped)
+				return E_INVALIDARG;
+
+			mapped->pData = buffer->Data();
+			mapped->RowPitch = buffer->Size();
+			mapped->DepthPitch = buffer->Size();
+
+			m_device->Record(NullDeviceLog::COMMAND_MAP, buffer->Size());
+			return S_OK;
+		}
+
+		void STDMETHODCALLTYPE Unmap(ID3D11Resource*, UINT) {}
+
+		void STDMETHODCALLTYPE UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box,
+			const void* data, UINT rowPitch, UINT)
+		{
+			NullBuffer* buffer = AsBuffer(resource);
+			if (!buffer)
+			{
+				//A texture, counted by its rows
+				UINT rows = box ? box->bottom - box->top : 0;
+				if (!rows)
+				{
+					D3D11_RESOURCE_DIMENSION dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+					resource->GetType(&dimension);
+					if (dimension == D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+					{
+						D3D11_TEXTURE2D_DESC desc;
+						static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+						UINT mipLevels = desc.MipLevels ? desc.MipLevels : 1;
+						rows = (std::max)(desc.Height >> (subresource % mipLevels), 1u);
+					}
+				}
+
+				m_device->Record(NullDeviceLog::COMMAND_UPDATE, (UINT64)rowPitch*rows);
+				return;
+			}
+
+			UINT begin = box ? box->left : 0;
+			UINT end = box ? box->right : buffer->Size();
+			if (begin < end && end <= buffer->Size() && data)
+				memcpy(buffer->Data() + begin, data, end - begin);
+
+			m_device->Record(NullDeviceLog::COMMAND_UPDATE, end - begin);
+		}
+
+		void STDMETHODCALLTYPE CopySubresourceRegion(ID3D11Resource* destination, UINT, UINT x, UINT, UINT,
+			ID3D11Resource* source, UINT, const D3D11_BOX* box)
+		{
+			NullBuffer* to = AsBuffer(destination);
+			NullBuffer* from = AsBuffer(source);
+			if (to && from)
+			{
+				UINT begin = box ? box->left : 0;
+				UINT end = box ? box->right : from->Size();
+				if (begin < end && end <= from->Size() && x + (end - begin) <= to->Size())
+					memmove(to->Data() + x, from->Data() + begin, end - begin);
+			}
+
+			m_device->Record(NullDeviceLog::COMMAND_COPY, 0);
+		}
+
+		void STDMETHODCALLTYPE CopyResource(ID3D11Resource* destination, ID3D11Resource* source)
+		{
+			NullBuffer* to = AsBuffer(destination);
+			NullBuffer* from = AsBuffer(source);
+			if (to && from && to->Size() == from->Size())
+				memcpy(to->Data(), from->Data(), to->Size());
+
+			m_device->Record(NullDeviceLog::COMMAND_COPY, 0);
+		}
+
+		void STDMETHODCALLTYPE CopyStructureCount(ID3D11Buffer*, UINT, ID3D11UnorderedAccessView*) { m_device->Record(NullDeviceLog::COMMAND_COPY, 0); }
+		void STDMETHODCALLTYPE ResolveSubresource(ID3D11Resource*, UINT, ID3D11Resource*, UINT, DXGI_FORMAT) { m_device->Record(NullDeviceLog::COMMAND_COPY, 0); }
+		void STDMETHODCALLTYPE GenerateMips(ID3D11ShaderResourceView*) {}
+		void STDMETHODCALLTYPE SetResourceMinLOD(ID3D11Resource*, FLOAT) {}
+		FLOAT STDMETHODCALLTYPE GetResourceMinLOD(ID3D11Resource*) { return 0.0f; }
+
+		//Clears
+		void STDMETHODCALLTYPE ClearRenderTargetView(ID3D11RenderTargetView*, const FLOAT[4]) { m_device->Record(NullDeviceLog::COMMAND_CLEAR, 0); }
+		void STDMETHODCALLTYPE ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView*, const UINT[4]) { m_device->Record(NullDeviceLog::COMMAND_CLEAR, 0); }
+		void STDMETHODCALLTYPE ClearUnorderedAccessViewFloat(ID3D11UnorderedAccessView*, const FLOAT[4]) { m_device->Record(NullDeviceLog::COMMAND_CLEAR, 0); }
+		void STDMETHODCALLTYPE ClearDepthStencilView(ID3D11DepthStencilView*, UINT, FLOAT, UINT8) { m_device->Record(NullDeviceLog::COMMAND_CLEAR, 0); }
+
+		//Queries cannot be created
+		void STDMETHODCALLTYPE Begin(ID3D11Asynchronous*) {}
+		void STDMETHODCALLTYPE End(ID3D11Asynchronous*) {}
+		HRESULT STDMETHODCALLTYPE GetData(ID3D11Asynchronous*, void*, UINT, UINT) { return E_INVALIDARG; }
+
+		//Nothing is kept, every Get returns nulls
+		void STDMETHODCALLTYPE VSGetConstantBuffers(UINT, UINT count, ID3D11Buffer** buffers) { ClearOut(buffers, count); }
+		void STDMETHODCALLTYPE VSGetShaderResources(UINT, UINT count, ID3D11ShaderResourceView** views) { ClearOut(views, count); }
+		void STDMETHODCALLTYPE VSGetSamplers(UINT, UINT count, ID3D11SamplerState** samplers) { ClearOut(samplers, count); }
+		void STDMETHODCALLTYPE VSGetShader(ID3D11VertexShader** shader, ID3D11ClassInstance**, UINT* instanceCount) { GetShader(shader, instanceCount); }
+		void STDMETHODCALLTYPE HSGetConstantBuffers(UINT, UINT count, ID3D11Buffer** buffers) { ClearOut(buffers, count); }
+		void STDMETHODCALLTYPE HSGetShaderResources(UINT, UINT count, ID3D11ShaderResourceView** views) { ClearOut(views, count); }
+		void STDMETHODCALLTYPE HSGetSamplers(UINT, UINT count, ID3D11SamplerState** samplers) { ClearOut(samplers, count); }
+		void STDMETHODCALLTYPE HSGetShader(ID3D11HullShader** shader, ID3D11ClassInstance**, UINT* instanceCount) { GetShader(shader, instanceCount); }
+		void STDMETHODCALLTYPE DSGetConstantBuffers(UINT, UINT count, ID3D11Buffer** buffers) { ClearOut(buffers, count); }
+		void STDMETHODCALLTYPE DSGetShaderResources(UINT, UINT count, ID3D11ShaderResourceView** views) { ClearOut(views, count); }
+		void STDMETHODCALLTYPE DSGetSamplers(UINT, UINT count, ID3D11SamplerState** samplers) { ClearOut(samplers, count); }
+		void STDMETHODCALLTYPE DSGetShader(ID3D11DomainShader** shader, ID3D11ClassInstance**, UINT* instanceCount) { GetShader(shader, instanceCount); }
+		void STDMETHODCALLTYPE GSGetConstantBuffers(UINT, UINT count, ID3D11Buffer** buffers) { ClearOut(buffers, count); }
+		void STDMETHODCALLTYPE GSGetShaderResources(UINT, UINT count, ID3D11ShaderResourceView** views) { ClearOut(views, count); }
+		void STDMETHODCALLTYPE GSGetSamplers(UINT, UINT count, ID3D11SamplerState** samplers) { ClearOut(samplers, count); }
+		void STDMETHODCALLTYPE GSGetShader(ID3D11GeometryShader** shader, ID3D11ClassInstance**, UINT* instanceCount) { GetShader(shader, instanceCount); }
+		void STDMETHODCALLTYPE PSGetConstantBuffers(UINT, UINT count, ID3D11Buffer** buffers) { ClearOut(buffers, count); }
+		void STDMETHODCALLTYPE PSGetShaderResources(UINT, UINT count, ID3D11ShaderResourceView** views) { ClearOut(views, count); }
+		void STDMETHODCALLTYPE PSGetSamplers(UINT, UINT count, ID3D11SamplerState** samplers) { ClearOut(samplers, count); }
+		void STDMETHODCALLTYPE PSGetShader(ID3D11PixelShader** shader, ID3D11ClassInstance**, UINT* instanceCount) { GetShader(shader, instanceCount); }
+		void STDMETHODCALLTYPE CSGetConstantBuffers(UINT, UINT count, ID3D11Buffer** buffers) { ClearOut(buffers, count); }
+		void STDMETHODCALLTYPE CSGetShaderResources(UINT, UINT count, ID3D11ShaderResourceView** views) { ClearOut(views, count); }
+		void STDMETHODCALLTYPE CSGetSamplers(UINT, UINT count, ID3D11SamplerState** samplers) { ClearOut(samplers, count); }
+		void STDMETHODCALLTYPE CSGetShader(ID3D11ComputeShader** shader, ID3D11ClassInstance**, UINT* instanceCount) { GetShader(shader, instanceCount); }
+		void STDMETHODCALLTYPE CSGetUnorderedAccessViews(UINT, UINT count, ID3D11UnorderedAccessView** views) { ClearOut(views, count); }
+
+		void STDMETHODCALLTYPE IAGetInputLayout(ID3D11InputLayout** inputLayout) { ClearOut(inputLayout, 1); }
+
+		void STDMETHODCALLTYPE IAGetVertexBuffers(UINT, UINT count, ID3D11Buffer** buffers, UINT* strides, UINT* offsets)
+		{
+			ClearOut(buffers, count);
+			for (UINT i = 0; i < count; ++i)
+			{
+				if (strides)
+					strides[i] = 0;
+				if (offsets)
+					offsets[i] = 0;
+			}
+		}
+
+		void STDMETHODCALLTYPE IAGetIndexBuffer(ID3D11Buffer** buffer, DXGI_FORMAT* format, UINT* offset)
+		{
+			ClearOut(buffer, 1);
+			if (format)
+				*format = DXGI_FORMAT_UNKNOWN;
+			if (offset)
+				*offset = 0;
+		}
+
+		void STDMETHODCALLTYPE IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY* topology) { *topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED; }
+
+		void STDMETHODCALLTYPE GetPredication(ID3D11Predicate** predicate, BOOL* value)
+		{
+			ClearOut(predicate, 1);
+			if (value)
+				*value = FALSE;
+		}
+
+		void STDMETHODCALLTYPE OMGetRenderTargets(UINT count, ID3D11RenderTargetView** views, ID3D11DepthStencilView** depthView)
+		{
+			ClearOut(views, count);
+			ClearOut(depthView, 1);
+		}
+
+		void STDMETHODCALLTYPE OMGetRenderTargetsAndUnorderedAccessViews(UINT count, ID3D11RenderTargetView** views,
+			ID3D11DepthStencilView** depthView, UINT, UINT uavCount, ID3D11UnorderedAccessView** uavs)
+		{
+			ClearOut(views, count);
+			ClearOut(depthView, 1);
+			ClearOut(uavs, uavCount);
+		}
+
+		void STDMETHODCALLTYPE OMGetBlendState(ID3D11BlendState** state, FLOAT blendFactor[4], UINT* sampleMask)
+		{
+			ClearOut(state, 1);
+			if (blendFactor)
+				blendFactor[0] = blendFactor[1] = blendFactor[2] = blendFactor[3] = 1.0f;
+			if (sampleMask)
+				*sampleMask = 0xffffffff;
+		}
+
+		void STDMETHODCALLTYPE OMGetDepthStencilState(ID3D11DepthStencilState** state, UINT* stencilRef)
+		{
+			ClearOut(state, 1);
+			if (stencilRef)
+				*stencilRef = 0;
+		}
+
+		void STDMETHODCALLTYPE SOGetTargets(UINT count, ID3D11Buffer** buffers) { ClearOut(buffers, count); }
+		void STDMETHODCALLTYPE RSGetState(ID3D11RasterizerState** state) { ClearOut(state, 1); }
+		void STDMETHODCALLTYPE RSGetViewports(UINT* count, D3D11_VIEWPORT*) { *count = 0; }
+		void STDMETHODCALLTYPE RSGetScissorRects(UINT* count, D3D11_RECT*) { *count = 0; }
+
+		//Context
+		void STDMETHODCALLTYPE ExecuteCommandList(ID3D11CommandList*, BOOL) {}
+		void STDMETHODCALLTYPE ClearState() {}
+		void STDMETHODCALLTYPE Flush() {}
+		D3D11_DEVICE_CONTEXT_TYPE STDMETHODCALLTYPE GetType() { return D3D11_DEVICE_CONTEXT_IMMEDIATE; }
+		UINT STDMETHODCALLTYPE GetContextFlags() { return 0; }
+
+		HRESULT STDMETHODCALLTYPE FinishCommandList(BOOL, ID3D11CommandList** commandList)
+		{
+			ClearOut(commandList, 1);
+			return DXGI_ERROR_INVALID_CALL;
+		}
+
+	private:
+		template<typename Shader>
+		void GetShader(Shader** shader, UINT* instanceCount)
+		{
+			ClearOut(shader, 1);
+			if (instanceCount)
+				*instanceCount = 0;
+		}
+
+	private:
+		NullDevice* m_device;
+	};
+
+	//Presents nothing; the back buffer is a texture of the window size
+	class NullSwapChain : public IDXGISwapChain
+	{
+	public:
+		NullSwapChain(NullDevice* device, UINT width, UINT height)
+			:m_device(device), m_references(1), m_backBuffer(0), m_presentCount(0)
+		{
+			m_device->AddRef();
+
+			ZeroMemory(&m_desc, sizeof(m_desc));
+			m_desc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+			m_desc.SampleDesc.Count = 1;
+			m_desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+			m_desc.BufferCount = 1;
+			m_desc.Windowed = TRUE;
+
+			ResizeBuffers(1, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0);
+		}
+
+		~NullSwapChain()
+		{
+			ReleaseCOM(m_backBuffer);
+			m_device->Release();
+		}
+
+		//IUnknown
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object)
+		{
+			if (!object)
+				return E_POINTER;
+
+			if (riid == __uuidof(IDXGISwapChain) || riid == __uuidof(IDXGIDeviceSubObject) ||
+				riid == __uuidof(IDXGIObject) || riid == __uuidof(IUnknown))
+			{
+				*object = static_cast<IDXGISwapChain*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*object = 0;
+			return E_NOINTERFACE;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef()
+		{
+			return ++m_references;
+		}
+
+		ULONG STDMETHODCALLTYPE Release()
+		{
+			ULONG references = --m_references;
+			if (!references)
+				delete this;
+
+			return references;
+		}
+
+		//IDXGIObject
+		HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) { return S_OK; }
+		HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) { return S_OK; }
+
+		HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT* dataSize, void*)
+		{
+			if (dataSize)
+				*dataSize = 0;
+
+			return DXGI_ERROR_NOT_FOUND;
+		}
+
+		//There is no factory
+		HRESULT STDMETHODCALLTYPE GetParent(REFIID, void** parent)
+		{
+			*parent = 0;
+			return E_NOINTERFACE;
+		}
+
+		//IDXGIDeviceSubObject
+		HRESULT STDMETHODCALLTYPE GetDevice(REFIID riid, void** device)
+		{
+			return m_device->QueryInterface(riid, device);
+		}
+
+		//IDXGISwapChain
+		HRESULT STDMETHODCALLTYPE Present(UINT, UINT)
+		{
+			++m_presentCount;
+			m_device->Record(NullDeviceLog::COMMAND_PRESENT, 0);
+			return S_OK;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetBuffer(UINT buffer, REFIID riid, void** surface)
+		{
+			if (buffer != 0)
+				return DXGI_ERROR_INVALID_CALL;
+
+			return m_backBuffer->QueryInterface(riid, surface);
+		}
+
+		HRESULT STDMETHODCALLTYPE SetFullscreenState(BOOL, IDXGIOutput*) { return S_OK; }
+
+		HRESULT STDMETHODCALLTYPE GetFullscreenState(BOOL* fullscreen, IDXGIOutput** target)
+		{
+			if (fullscreen)
+				*fullscreen = FALSE;
+			ClearOut(target, 1);
+			return S_OK;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetDesc(DXGI_SWAP_CHAIN_DESC* desc)
+		{
+			*desc = m_desc;
+			return S_OK;
+		}
+
+		//0 keeps the current value, as on a real swap chain without a window
+		HRESULT STDMETHODCALLTYPE ResizeBuffers(UINT bufferCount, UINT width, UINT height, DXGI_FORMAT format, UINT flags)
+		{
+			if (bufferCount)
+				m_desc.BufferCount = bufferCount;
+			if (width)
+				m_desc.BufferDesc.Width = width;
+			if (height)
+				m_desc.BufferDesc.Height = height;
+			if (format != DXGI_FORMAT_UNKNOWN)
+				m_desc.BufferDesc.Format = format;
+			m_desc.Flags = flags;
+
+			D3D11_TEXTURE2D_DESC desc;
+			ZeroMemory(&desc, sizeof(desc));
+			desc.Width = m_desc.BufferDesc.Width;
+			desc.Height = m_desc.BufferDesc.Height;
+			desc.MipLevels = 1;
+			desc.ArraySize = 1;
+			desc.Format = m_desc.BufferDesc.Format;
+			desc.SampleDesc = m_desc.SampleDesc;
+			desc.Usage = D3D11_USAGE_DEFAULT;
+			desc.BindFlags = D3D11_BIND_RENDER_TARGET;
+
+			ReleaseCOM(m_backBuffer);
+			m_backBuffer = new NullTexture2D(m_device, desc);
+			return S_OK;
+		}
+
+		HRESULT STDMETHODCALLTYPE ResizeTarget(const DXGI_MODE_DESC*) { return S_OK; }
+
+		HRESULT STDMETHODCALLTYPE GetContainingOutput(IDXGIOutput** output)
+		{
+			ClearOut(output, 1);
+			return E_NOTIMPL;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetFrameStatistics(DXGI_FRAME_STATISTICS*) { return E_NOTIMPL; }
+
+		HRESULT STDMETHODCALLTYPE GetLastPresentCount(UINT* presentCount)
+		{
+			*presentCount = m_presentCount;
+			return S_OK;
+		}
+
+	private:
+		NullDevice* m_device;
+		std::atomic<ULONG> m_references;
+
+		DXGI_SWAP_CHAIN_DESC m_desc;
+		NullTexture2D* m_backBuffer;
+		UINT m_presentCount;
+	};
+
+	//Returns one of the created objects
+	template<typename Interface, typename Object>
+	HRESULT Hand(Object* object, Interface** result)
+	{
+		if (!result)
+		{
+			//Only validating the arguments, as D3D allows
+			object->Release();
+			return S_FALSE;
+		}
+
+		*result = object;
+		return S_OK;
+	}
+}
+
+NullDevice::NullDevice()
+	:m_references(1), m_context(0)
+{
+	m_log.Clear();
+	m_context = new NullDeviceContext(this);
+}
+
+NullDevice::~NullDevice()
+{
+	delete static_cast<NullDeviceContext*>(m_context);
+}
+
+HRESULT NullDevice::Create(UINT width, UINT height,
+	NullDevice** device, ID3D11DeviceContext** context, IDXGISwapChain** swapChain)
+{
+	NullDevice* created = new NullDevice();
+
+	*swapChain = new NullSwapChain(created, width, height);
+	created->GetImmediateContext(context);
+	*device = created;
+
+	return S_OK;
+}
+
+void NullDevice::ClearLog()
+{
+	std::lock_guard<std::mutex> lock(m_logMutex);
+	m_log.Clear();
+}
+
+void NullDevice::Record(NullDeviceLog::CommandType type, UINT64 value)
+{
+	std::lock_guard<std::mutex> lock(m_logMutex);
+
+	NullDeviceLog::Command command;
+	command.Type = type;
+	command.Value = value;
+	m_log.Commands.push_back(command);
+
+	NullDeviceLog::Counters& totals = m_log.Totals;
+	switch (type)
+	{
+	case NullDeviceLog::COMMAND_CREATE_BUFFER:
+		++totals.Buffers;
+		totals.BufferBytes += value;
+		break;
+	case NullDeviceLog::COMMAND_CREATE_TEXTURE:
+		++totals.Textures;
+		break;
+	case NullDeviceLog::COMMAND_MAP:
+		++totals.Maps;
+		totals.MappedBytes += value;
+		break;
+	case NullDeviceLog::COMMAND_UPDATE:
+		++totals.Updates;
+		totals.UpdatedBytes += value;
+		break;
+	case NullDeviceLog::COMMAND_DRAW:
+		++totals.Draws;
+		totals.Vertices += value;
+		break;
+	case NullDeviceLog::COMMAND_PRESENT:
+		++totals.Presents;
+		break;
+	default:
+		break;
+	}
+}
+
+void NullDevice::RecordStateCall()
+{
+	std::lock_guard<std::mutex> lock(m_logMutex);
+	++m_log.Totals.StateCalls;
+}
+
+void NullDevice::RecordObject()
+{
+	std::lock_guard<std::mutex> lock(m_logMutex);
+	++m_log.Totals.OtherObjects;
+}
+
+HRESULT NullDevice::QueryInterface(REFIID riid, void** object)
+{
+	if (!object)
+		return E_POINTER;
+
+	if (riid == __uuidof(ID3D11Device) || riid == __uuidof(IUnknown))
+	{
+		*object = static_cast<ID3D11Device*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*object = 0;
+	return E_NOINTERFACE;
+}
+
+ULONG NullDevice::AddRef()
+{
+	return ++m_references;
+}
+
+ULONG NullDevice::Release()
+{
+	ULONG references = --m_references;
+	if (!references)
+		delete this;
+
+	return references;
+}
+
+HRESULT NullDevice::CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer)
+{
+	if (!desc || !desc->ByteWidth)
+		return E_INVALIDARG;
+
+	NullBuffer* created = new NullBuffer(this, *desc);
+	if (initialData && initialData->pSysMem)
+		memcpy(created->Data(), initialData->pSysMem, desc->ByteWidth);
+
+	Record(NullDeviceLog::COMMAND_CREATE_BUFFER, desc->ByteWidth);
+	return Hand(created, buffer);
+}
+
+HRESULT NullDevice::CreateTexture1D(const D3D11_TEXTURE1D_DESC*, const D3D11_SUBRESOURCE_DATA*, ID3D11Texture1D**)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT NullDevice::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA*, ID3D11Texture2D** texture)
+{
+	if (!desc || !desc->Width || !desc->Height)
+		return E_INVALIDARG;
+
+	NullTexture2D* created = new NullTexture2D(this, *desc);
+
+	Record(NullDeviceLog::COMMAND_CREATE_TEXTURE,
+		TextureBytes(desc->Width, desc->Height, desc->MipLevels, desc->ArraySize, desc->Format));
+	return Hand(created, texture);
+}
+
+HRESULT NullDevice::CreateTexture3D(const D3D11_TEXTURE3D_DESC*, const D3D11_SUBRESOURCE_DATA*, ID3D11Texture3D**)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT NullDevice::CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** view)
+{
+	if (!resource)
+		return E_INVALIDARG;
+
+	RecordObject();
+	return Hand(new NullView<ID3D11ShaderResourceView, D3D11_SHADER_RESOURCE_VIEW_DESC>(this, resource, desc), view);
+}
+
+HRESULT NullDevice::CreateUnorderedAccessView(ID3D11Resource*, const D3D11_UNORDERED_ACCESS_VIEW_DESC*, ID3D11UnorderedAccessView**)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT NullDevice::CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** view)
+{
+	if (!resource)
+		return E_INVALIDARG;
+
+	RecordObject();
+	return Hand(new NullView<ID3D11RenderTargetView, D3D11_RENDER_TARGET_VIEW_DESC>(this, resource, desc), view);
+}
+
+HRESULT NullDevice::CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** view)
+{
+	if (!resource)
+		return E_INVALIDARG;
+
+	RecordObject();
+	return Hand(new NullView<ID3D11DepthStencilView, D3D11_DEPTH_STENCIL_VIEW_DESC>(this, resource, desc), view);
+}
+
+HRESULT NullDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount,
+	const void* bytecode, SIZE_T, ID3D11InputLayout** inputLayout)
+{
+	if (!elements || !elementCount || !bytecode)
+		return E_INVALIDARG;
+
+	RecordObject();
+	return Hand(new NullDeviceChild<ID3D11InputLayout>(this), inputLayout);
+}
+
+HRESULT NullDevice::CreateVertexShader(const void* bytecode, SIZE_T, ID3D11ClassLinkage*, ID3D11VertexShader** shader)
+{
+	if (!bytecode)
+		return E_INVALIDARG;
+
+	RecordObject();
+	return Hand(new NullDeviceChild<ID3D11VertexShader>(this), shader);
+}
+
+HRESULT NullDevice::CreateGeometryShader(const void* bytecode, SIZE_T, ID3D11ClassLinkage*, ID3D11GeometryShader** shader)
+{
+	if (!bytecode)
+		return E_INVALIDARG;
+
+	RecordObject();
+	return Hand(new NullDeviceChild<ID3D11GeometryShader>(this), shader);
+}
+
+HRESULT NullDevice::CreateGeometryShaderWithStreamOutput(const void*, SIZE_T, const D3D11_SO_DECLARATION_ENTRY*, UINT,
+	const UINT*, UINT, UINT, ID3D11ClassLinkage*, ID3D11GeometryShader**)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT NullDevice::CreatePixelShader(const void* bytecode, SIZE_T, ID3D11ClassLinkage*, ID3D11PixelShader** shader)
+{
+	if (!bytecode)
+		return E_INVALIDARG;
+
+	RecordObject();
+	return Hand(new NullDeviceChild<ID3D11PixelShader>(this), shader);
+}
+
+HRESULT NullDevice::CreateHullShader(const void*, SIZE_T, ID3D11ClassLinkage*, ID3D11HullShader**)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT NullDevice::CreateDomainShader(const void*, SIZE_T, ID3D11ClassLinkage*, ID3D11DomainShader**)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT NullDevice::CreateComputeShader(const void*, SIZE_T, ID3D11ClassLinkage*, ID3D11ComputeShader**)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT NullDevice::CreateClassLinkage(ID3D11ClassLinkage**)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT NullDevice::CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state)
+{
+	if (!desc)
+		return E_INVALIDARG;
+
+	RecordObject();
+	return Hand(new NullState<ID3D11BlendState, D3D11_BLEND_DESC>(this, *desc), state);
+}
+
+HRESULT NullDevice::CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state)
+{
+	if (!desc)
+		return E_INVALIDARG;
+
+	RecordObject();
+	return Hand(new NullState<ID3D11DepthStencilState, D3D11_DEPTH_STENCIL_DESC>(this, *desc), state);
+}
+
+HRESULT NullDevice::CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state)
+{
+	if (!desc)
+		return E_INVALIDARG;
+
+	RecordObject();
+	return Hand(new NullState<ID3D11RasterizerState, D3D11_RASTERIZER_DESC>(this, *desc), state);
+}
+
+HRESULT NullDevice::CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** state)
+{
+	if (!desc)
+		return E_INVALIDARG;
+
+	RecordObject();
+	return Hand(new NullState<ID3D11SamplerState, D3D11_SAMPLER_DESC>(this, *desc), state);
+}
+
+HRESULT NullDevice::CreateQuery(const D3D11_QUERY_DESC*, ID3D11Query**)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT NullDevice::CreatePredicate(const D3D11_QUERY_DESC*, ID3D11Predicate**)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT NullDevice::CreateCounter(const D3D11_COUNTER_DESC*, ID3D11Counter**)
+{
+	return E_NOTIMPL;
+}
+
+//Callers fall back to the immediate context
+HRESULT NullDevice::CreateDeferredContext(UINT, ID3D11DeviceContext**)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT NullDevice::OpenSharedResource(HANDLE, REFIID, void**)
+{
+	return E_NOTIMPL;
+}
+
+//Everything is supported, nothing is drawn
+HRESULT NullDevice::CheckFormatSupport(DXGI_FORMAT, UINT* support)
+{
+	*support = 0xffffffff;
+	return S_OK;
+}
+
+HRESULT NullDevice::CheckMultisampleQualityLevels(DXGI_FORMAT, UINT, UINT* qualityLevels)
+{
+	*qualityLevels = 1;
+	return S_OK;
+}
+
+void NullDevice::CheckCounterInfo(D3D11_COUNTER_INFO* info)
+{
+	ZeroMemory(info, sizeof(*info));
+}
+
+HRESULT NullDevice::CheckCounter(const D3D11_COUNTER_DESC*, D3D11_COUNTER_TYPE*, UINT*,
+	LPSTR, UINT*, LPSTR, UINT*, LPSTR, UINT*)
+{
+	return E_NOTIMPL;
+}
+
+//Optional features all read as missing, so callers take their 11.0 paths
+HRESULT NullDevice::CheckFeatureSupport(D3D11_FEATURE, void* data, UINT dataSize)
+{
+	if (!data)
+		return E_INVALIDARG;
+
+	ZeroMemory(data, dataSize);
+	return S_OK;
+}
+
+HRESULT NullDevice::GetPrivateData(REFGUID, UINT* dataSize, void*)
+{
+	if (dataSize)
+		*dataSize = 0;
+
+	return DXGI_ERROR_NOT_FOUND;
+}
+
+HRESULT NullDevice::SetPrivateData(REFGUID, UINT, const void*)
+{
+	return S_OK;
+}
+
+HRESULT NullDevice::SetPrivateDataInterface(REFGUID, const IUnknown*)
+{
+	return S_OK;
+}
+
+D3D_FEATURE_LEVEL NullDevice::GetFeatureLevel()
+{
+	return D3D_FEATURE_LEVEL_11_0;
+}
+
+UINT NullDevice::GetCreationFlags()
+{
+	return 0;
+}
+
+HRESULT NullDevice::GetDeviceRemovedReason()
+{
+	return S_OK;
+}
+
+void NullDevice::GetImmediateContext(ID3D11DeviceContext** context)
+{
+	m_context->AddRef();
+	*context = m_context;
+}
+
+HRESULT NullDevice::SetExceptionMode(UINT)
+{
+	return S_OK;
+}
+
+UINT NullDevice::GetExceptionMode()
+{
+	return 0;
+}
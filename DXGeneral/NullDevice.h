@@ -0,0 +1,154 @@
+#pragma once
+
+//Headless Direct3D 11 device
+//
+//NullDevice implements the device, immediate context and swap chain that
+//D3DApp hands to the demos, without a display adapter or a window. Every
+//object it creates keeps its desc; buffers also keep their bytes in system
+//memory, so Map(), UpdateSubresource() and the initial data behave as on
+//a real device and the CPU work of a demo runs unchanged. Shaders and
+//states are accepted without being looked at, and nothing is rasterized.
+//
+//Buffer creation, maps, updates and draws are recorded into a
+//NullDeviceLog that the caller reads and clears, one frame at a time.
+//
+//Interfaces the demos do not use (tessellation and compute shaders,
+//queries, unordered access views, 1D/3D textures, deferred contexts, the
+//11.1 context) fail with E_NOTIMPL or E_NOINTERFACE, so code that can do
+//without them falls back as on older hardware.
+
+#ifndef _NULLDEVICE_H_
+#define _NULLDEVICE_H_
+
+#include "d3dUtil.h"
+#include <atomic>
+#include <mutex>
+
+struct NullDeviceLog
+{
+	enum CommandType
+	{
+		COMMAND_CREATE_BUFFER,
+		COMMAND_CREATE_TEXTURE,
+		COMMAND_MAP,
+		COMMAND_UPDATE,
+		COMMAND_COPY,
+		COMMAND_CLEAR,
+		COMMAND_DRAW,
+		COMMAND_PRESENT
+	};
+
+	//Value is the size in bytes of a creation, map or update, and the
+	//vertex or index count of a draw times its instances
+	struct Command
+	{
+		CommandType Type;
+		UINT64 Value;
+	};
+
+	struct Counters
+	{
+		UINT Buffers;
+		UINT64 BufferBytes;
+		UINT Textures;
+		UINT OtherObjects;		//Views, shaders, layouts and states
+		UINT Maps;
+		UINT64 MappedBytes;
+		UINT Updates;
+		UINT64 UpdatedBytes;
+		UINT StateCalls;		//Binds of the context, not logged one by one
+		UINT Draws;
+		UINT64 Vertices;
+		UINT Presents;
+	};
+
+	std::vector<Command> Commands;
+	Counters Totals;
+
+	void Clear();
+};
+
+class NullDevice : public ID3D11Device
+{
+public:
+	//A device with its immediate context and a swap chain of width x height,
+	//each holding one reference
+	static HRESULT Create(UINT width, UINT height,
+		NullDevice** device, ID3D11DeviceContext** context, IDXGISwapChain** swapChain);
+
+	//Since the last ClearLog(). Not to be read while other threads create
+	//objects.
+	const NullDeviceLog& Log() const { return m_log; }
+	void ClearLog();
+
+	//From the context, swap chain and objects of this device, any thread
+	void Record(NullDeviceLog::CommandType type, UINT64 value);
+	void RecordStateCall();
+	void RecordObject();
+
+	//IUnknown
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object);
+	ULONG STDMETHODCALLTYPE AddRef();
+	ULONG STDMETHODCALLTYPE Release();
+
+	//ID3D11Device
+	HRESULT STDMETHODCALLTYPE CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer);
+	HRESULT STDMETHODCALLTYPE CreateTexture1D(const D3D11_TEXTURE1D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture1D** texture);
+	HRESULT STDMETHODCALLTYPE CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture);
+	HRESULT STDMETHODCALLTYPE CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** texture);
+	HRESULT STDMETHODCALLTYPE CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** view);
+	HRESULT STDMETHODCALLTYPE CreateUnorderedAccessView(ID3D11Resource* resource, const D3D11_UNORDERED_ACCESS_VIEW_DESC* desc, ID3D11UnorderedAccessView** view);
+	HRESULT STDMETHODCALLTYPE CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** view);
+	HRESULT STDMETHODCALLTYPE CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** view);
+	HRESULT STDMETHODCALLTYPE CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount,
+		const void* bytecode, SIZE_T bytecodeLength, ID3D11InputLayout** inputLayout);
+	HRESULT STDMETHODCALLTYPE CreateVertexShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11VertexShader** shader);
+	HRESULT STDMETHODCALLTYPE CreateGeometryShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader);
+	HRESULT STDMETHODCALLTYPE CreateGeometryShaderWithStreamOutput(const void* bytecode, SIZE_T bytecodeLength,
+		const D3D11_SO_DECLARATION_ENTRY* declaration, UINT entryCount, const UINT* bufferStrides, UINT strideCount,
+		UINT rasterizedStream, ID3D11ClassLinkage* linkage, ID3D11GeometryShader** shader);
+	HRESULT STDMETHODCALLTYPE CreatePixelShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11PixelShader** shader);
+	HRESULT STDMETHODCALLTYPE CreateHullShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11HullShader** shader);
+	HRESULT STDMETHODCALLTYPE CreateDomainShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11DomainShader** shader);
+	HRESULT STDMETHODCALLTYPE CreateComputeShader(const void* bytecode, SIZE_T bytecodeLength, ID3D11ClassLinkage* linkage, ID3D11ComputeShader** shader);
+	HRESULT STDMETHODCALLTYPE CreateClassLinkage(ID3D11ClassLinkage** linkage);
+	HRESULT STDMETHODCALLTYPE CreateBlendState(const D3D11_BLEND_DESC* desc, ID3D11BlendState** state);
+	HRESULT STDMETHODCALLTYPE CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state);
+	HRESULT STDMETHODCALLTYPE CreateRasterizerState(const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state);
+	HRESULT STDMETHODCALLTYPE CreateSamplerState(const D3D11_SAMPLER_DESC* desc, ID3D11SamplerState** state);
+	HRESULT STDMETHODCALLTYPE CreateQuery(const D3D11_QUERY_DESC* desc, ID3D11Query** query);
+	HRESULT STDMETHODCALLTYPE CreatePredicate(const D3D11_QUERY_DESC* desc, ID3D11Predicate** predicate);
+	HRESULT STDMETHODCALLTYPE CreateCounter(const D3D11_COUNTER_DESC* desc, ID3D11Counter** counter);
+	HRESULT STDMETHODCALLTYPE CreateDeferredContext(UINT flags, ID3D11DeviceContext** context);
+	HRESULT STDMETHODCALLTYPE OpenSharedResource(HANDLE handle, REFIID riid, void** resource);
+	HRESULT STDMETHODCALLTYPE CheckFormatSupport(DXGI_FORMAT format, UINT* support);
+	HRESULT STDMETHODCALLTYPE CheckMultisampleQualityLevels(DXGI_FORMAT format, UINT sampleCount, UINT* qualityLevels);
+	void STDMETHODCALLTYPE CheckCounterInfo(D3D11_COUNTER_INFO* info);
+	HRESULT STDMETHODCALLTYPE CheckCounter(const D3D11_COUNTER_DESC* desc, D3D11_COUNTER_TYPE* type, UINT* activeCounters,
+		LPSTR name, UINT* nameLength, LPSTR units, UINT* unitsLength, LPSTR description, UINT* descriptionLength);
+	HRESULT STDMETHODCALLTYPE CheckFeatureSupport(D3D11_FEATURE feature, void* data, UINT dataSize);
+	HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* dataSize, void* data);
+	HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT dataSize, const void* data);
+	HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* data);
+	D3D_FEATURE_LEVEL STDMETHODCALLTYPE GetFeatureLevel();
+	UINT STDMETHODCALLTYPE GetCreationFlags();
+	HRESULT STDMETHODCALLTYPE GetDeviceRemovedReason();
+	void STDMETHODCALLTYPE GetImmediateContext(ID3D11DeviceContext** context);
+	HRESULT STDMETHODCALLTYPE SetExceptionMode(UINT flags);
+	UINT STDMETHODCALLTYPE GetExceptionMode();
+
+private:
+	NullDevice();
+	~NullDevice();
+
+private:
+	std::atomic<ULONG> m_references;
+
+	//Not counted, the context refers to the device and not the other way
+	ID3D11DeviceContext* m_context;
+
+	std::mutex m_logMutex;
+	NullDeviceLog m_log;
+};
+
+#endif
@@ -0,0 +1,188 @@
+#include"ParallelRenderQueue.h"
+#include<algorithm>
+#include<chrono>
+#include<string.h>
+
+ParallelRenderQueue::ParallelRenderQueue(JobSystem& jobs)
+	:m_jobs(jobs), m_sliceCount(0)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void ParallelRenderQueue::Record(UINT count, UINT grainSize, const RecordFunction& record)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Grown only, a slice keeps its queue between frames
+	m_sliceCount = m_jobs.ChunkCount(count, grainSize);
+	if (m_slices.size() < m_sliceCount)
+	{
+		m_slices.resize(m_sliceCount);
+	}
+
+	m_jobs.ParallelFor(count, grainSize, [this, &record](UINT begin, UINT end, UINT slice)
+	{
+		RenderQueue& queue = m_slices[slice];
+		queue.Clear();
+		record(begin, end, queue);
+		queue.Sort();
+	});
+
+	auto recorded = std::chrono::high_resolution_clock::now();
+
+	Merge();
+
+	auto merged = std::chrono::high_resolution_clock::now();
+
+	m_stats.Slices = m_sliceCount;
+	m_stats.RecordMilliseconds = std::chrono::duration<double, std::milli>(recorded - start).count();
+	m_stats.MergeMilliseconds = std::chrono::duration<double, std::milli>(merged - recorded).count();
+
+	m_stats.Replay.SortMilliseconds = 0.0;
+	for (UINT slice = 0; slice < m_sliceCount; ++slice)
+	{
+		m_stats.Replay.SortMilliseconds = std::max(m_stats.Replay.SortMilliseconds, m_slices[slice].LastStats().SortMilliseconds);
+	}
+}
+
+void ParallelRenderQueue::Merge()
+{
+	UINT total = 0;
+	for (UINT slice = 0; slice < m_sliceCount; ++slice)
+	{
+		total += m_slices[slice].Count();
+	}
+
+	m_merged.resize(total);
+	if (m_sliceCount == 1)
+	{
+		const RenderQueue& queue = m_slices[0];
+		const std::vector<UINT>& order = queue.Order();
+		for (UINT i = 0; i < total; ++i)
+		{
+			m_merged[i] = &queue.Packet(order[i]);
+		}
+		return;
+	}
+
+	//K-way merge over the heads of the slices, in a binary min heap ordered
+	//by key, then by slice, which keeps equal keys in scene order
+	m_heap.clear();
+	m_cursors.assign(m_sliceCount, 0);
+	for (UINT slice = 0; slice < m_sliceCount; ++slice)
+	{
+		const RenderQueue& queue = m_slices[slice];
+		if (queue.Count())
+		{
+			m_heap.push_back(std::make_pair(queue.SortedKeys()[0], slice));
+		}
+	}
+	std::make_heap(m_heap.begin(), m_heap.end(), std::greater<std::pair<UINT64, UINT>>());
+
+	for (UINT i = 0; i < total; ++i)
+	{
+		UINT slice = m_heap[0].second;
+
+		const RenderQueue& queue = m_slices[slice];
+		UINT& cursor = m_cursors[slice];
+		m_merged[i] = &queue.Packet(queue.Order()[cursor]);
+
+		//The next head of the slice replaces the top and sinks, one pass
+		//instead of a pop and a push
+		std::pair<UINT64, UINT> head;
+		if (++cursor < queue.Count())
+		{
+			head = std::make_pair(queue.SortedKeys()[cursor], slice);
+		}
+		else
+		{
+			head = m_heap.back();
+			m_heap.pop_back();
+			if (m_heap.empty())
+				continue;
+		}
+
+		const size_t size = m_heap.size();
+		size_t parent = 0;
+		for (;;)
+		{
+			size_t child = parent * 2 + 1;
+			if (child >= size)
+				break;
+			if (child + 1 < size && m_heap[child + 1] < m_heap[child])
+				++child;
+			if (!(m_heap[child] < head))
+				break;
+
+			m_heap[parent] = m_heap[child];
+			parent = child;
+		}
+		m_heap[parent] = head;
+	}
+}
+
+void ParallelRenderQueue::ResetReplayStats()
+{
+	m_stats.Replay.Draws = 0;
+	m_stats.Replay.ShaderChanges = 0;
+	m_stats.Replay.MaterialChanges = 0;
+	m_stats.Replay.MeshChanges = 0;
+	m_stats.Replay.ConstantChanges = 0;
+}
+
+void ParallelRenderQueue::Submit(RenderBackend& backend)
+{
+	ResetReplayStats();
+	Replay(backend, 0, Count(), m_stats.Replay);
+}
+
+void ParallelRenderQueue::SubmitParallel(RenderBackend* const* backends, UINT backendCount)
+{
+	ResetReplayStats();
+	if (!backendCount)
+		return;
+
+	const UINT count = Count();
+
+	m_rangeStats.resize(backendCount);
+	memset(m_rangeStats.data(), 0, backendCount*sizeof(RenderQueue::Stats));
+
+	std::vector<JobSystem::JobHandle> jobs(backendCount - 1);
+	for (UINT range = 1; range < backendCount; ++range)
+	{
+		UINT begin = UINT((UINT64)count * range / backendCount);
+		UINT end = UINT((UINT64)count * (range + 1) / backendCount);
+		RenderBackend* backend = backends[range];
+		RenderQueue::Stats* stats = &m_rangeStats[range];
+
+		jobs[range - 1] = m_jobs.Submit([this, backend, begin, end, stats]() { Replay(*backend, begin, end, *stats); },
+			JobSystem::PRIORITY_HIGH);
+	}
+
+	//The caller replays the first range itself
+	Replay(*backends[0], 0, UINT((UINT64)count / backendCount), m_rangeStats[0]);
+
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		m_jobs.Wait(jobs[i]);
+	}
+
+	for (UINT range = 0; range < backendCount; ++range)
+	{
+		const RenderQueue::Stats& stats = m_rangeStats[range];
+		m_stats.Replay.Draws += stats.Draws;
+		m_stats.Replay.ShaderChanges += stats.ShaderChanges;
+		m_stats.Replay.MaterialChanges += stats.MaterialChanges;
+		m_stats.Replay.MeshChanges += stats.MeshChanges;
+		m_stats.Replay.ConstantChanges += stats.ConstantChanges;
+	}
+}
+
+void ParallelRenderQueue::Replay(RenderBackend& backend, UINT begin, UINT end, RenderQueue::Stats& stats) const
+{
+	RenderReplay replay(backend, stats);
+	for (UINT i = begin; i < end; ++i)
+	{
+		replay.Draw(*m_merged[i]);
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+//RenderQueue recorded on several threads
+//
+//Record() splits the scene into contiguous slices and runs the record
+//function of each slice on a worker of the job system. Every slice writes
+//its packets into a RenderQueue of its own and sorts it right there, so
+//recording and sorting need no locks. The sorted slices are then merged
+//into one stream in key order. Equal keys are taken from the lower slice
+//first, and the slices are in scene order, so the stream is the same as
+//recording everything into one RenderQueue on one thread.
+//
+//Submit() replays the stream through one backend. SubmitParallel() splits
+//it into contiguous ranges and replays each through its own backend at the
+//same time, for deferred contexts whose command lists are executed in
+//range order. Every range starts with unknown state.
+//
+//Like RenderQueue this needs no device; RecordingRenderBackend compares
+//its replay with the one of a single RenderQueue.
+
+#ifndef _PARALLELRENDERQUEUE_H_
+#define _PARALLELRENDERQUEUE_H_
+
+#include "RenderQueue.h"
+#include "JobSystem.h"
+
+#include<functional>
+
+class ParallelRenderQueue
+{
+public:
+	//begin, end, the queue of the slice. Runs on any worker thread.
+	typedef std::function<void(UINT, UINT, RenderQueue&)> RecordFunction;
+
+	struct Stats
+	{
+		//Of the last Submit(), summed over the ranges of SubmitParallel().
+		//SortMilliseconds is the slowest slice.
+		RenderQueue::Stats Replay;
+
+		UINT Slices;
+		double RecordMilliseconds;	//Recording and sorting of all slices
+		double MergeMilliseconds;
+	};
+
+public:
+	ParallelRenderQueue(JobSystem& jobs = JobSystem::Default());
+
+	//Records the items [0, count) in slices of at least grainSize items,
+	//sorts the slices and merges them
+	void Record(UINT count, UINT grainSize, const RecordFunction& record);
+
+	//The merged packets in key order, valid until the next Record()
+	UINT Count() const { return static_cast<UINT>(m_merged.size()); }
+	const DrawPacket& Packet(UINT i) const { return *m_merged[i]; }
+
+	void Submit(RenderBackend& backend);
+
+	//Replays backendCount contiguous ranges of the stream on the workers,
+	//range i through backends[i]
+	void SubmitParallel(RenderBackend* const* backends, UINT backendCount);
+
+	//Replays [begin, end) of the stream, starting with unknown state
+	void Replay(RenderBackend& backend, UINT begin, UINT end, RenderQueue::Stats& stats) const;
+
+	const Stats& LastStats() const { return m_stats; }
+
+private:
+	void Merge();
+	void ResetReplayStats();
+
+private:
+	JobSystem& m_jobs;
+
+	//One per slice, kept between frames for their allocations
+	std::vector<RenderQueue> m_slices;
+	UINT m_sliceCount;
+
+	std::vector<const DrawPacket*> m_merged;
+
+	//Merge heap entries: key and slice, and the read position per slice
+	std::vector<std::pair<UINT64, UINT>> m_heap;
+	std::vector<UINT> m_cursors;
+
+	std::vector<RenderQueue::Stats> m_rangeStats;
+
+	Stats m_stats;
+};
+
+#endif
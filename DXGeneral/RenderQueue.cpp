@@ -0,0 +1,218 @@
+#include"RenderQueue.h"
+#include<algorithm>
+#include<chrono>
+#include<string.h>
+
+namespace
+{
+	const UINT NO_STATE = 0xffffffff;
+
+	//Below this an insertion sort beats clearing the histograms
+	const size_t RADIX_MIN_COUNT = 64;
+
+	UINT64 ClampField(UINT value, UINT bits)
+	{
+		const UINT maxValue = (1u << bits) - 1;
+		return value < maxValue ? value : maxValue;
+	}
+}
+
+RenderQueue::RenderQueue()
+	:m_sorted(true)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+UINT64 RenderQueue::MakeSortKey(UINT pass, UINT shader, UINT material, UINT mesh, UINT depth)
+{
+	return (ClampField(pass, 4) << 60) |
+		(ClampField(shader, 12) << 48) |
+		(ClampField(material, 16) << 32) |
+		(ClampField(mesh, 16) << 16) |
+		ClampField(depth, 16);
+}
+
+UINT RenderQueue::QuantizeDepth(float depth, float nearZ, float farZ)
+{
+	float t = farZ > nearZ ? (depth - nearZ) / (farZ - nearZ) : 0.0f;
+	t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	return static_cast<UINT>(t*65535.0f + 0.5f);
+}
+
+void RenderQueue::Clear()
+{
+	m_packets.clear();
+
+	//Submit() replays m_order without sorting again
+	m_keys.clear();
+	m_order.clear();
+	m_sorted = true;
+}
+
+void RenderQueue::Add(const DrawPacket& packet)
+{
+	m_packets.push_back(packet);
+	m_sorted = false;
+}
+
+void RenderQueue::Sort()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const size_t count = m_packets.size();
+	m_keys.resize(count);
+	m_order.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_keys[i] = m_packets[i].Key;
+		m_order[i] = static_cast<UINT>(i);
+	}
+
+	RadixSort();
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_stats.SortMilliseconds = elapsed.count();
+	m_sorted = true;
+}
+
+void RenderQueue::RadixSort()
+{
+	const size_t count = m_keys.size();
+	if (count < RADIX_MIN_COUNT)
+	{
+		//Stable insertion sort
+		for (size_t i = 1; i < count; ++i)
+		{
+			UINT64 key = m_keys[i];
+			UINT index = m_order[i];
+
+			size_t j = i;
+			for (; j > 0 && m_keys[j - 1] > key; --j)
+			{
+				m_keys[j] = m_keys[j - 1];
+				m_order[j] = m_order[j - 1];
+			}
+
+			m_keys[j] = key;
+			m_order[j] = index;
+		}
+		return;
+	}
+
+	m_keysTemp.resize(count);
+	m_orderTemp.resize(count);
+
+	//The histograms of all eight digits in one pass over the keys
+	UINT histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; ++i)
+	{
+		UINT64 key = m_keys[i];
+		for (UINT digit = 0; digit < 8; ++digit)
+		{
+			++histograms[digit][(key >> (8 * digit)) & 0xff];
+		}
+	}
+
+	UINT64* keys = m_keys.data();
+	UINT* order = m_order.data();
+	UINT64* keysTemp = m_keysTemp.data();
+	UINT* orderTemp = m_orderTemp.data();
+
+	for (UINT digit = 0; digit < 8; ++digit)
+	{
+		const UINT shift = 8 * digit;
+		UINT* histogram = histograms[digit];
+
+		//All keys in one bucket, this digit orders nothing. Common for the
+		//pass and the upper shader bits.
+		if (histogram[(keys[0] >> shift) & 0xff] == count)
+			continue;
+
+		//Bucket counts to bucket starts
+		UINT offset = 0;
+		for (UINT bucket = 0; bucket < 256; ++bucket)
+		{
+			UINT bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			UINT position = histogram[(keys[i] >> shift) & 0xff]++;
+			keysTemp[position] = keys[i];
+			orderTemp[position] = order[i];
+		}
+
+		std::swap(keys, keysTemp);
+		std::swap(order, orderTemp);
+	}
+
+	//An odd number of scatters left the result in the temporaries
+	if (keys != m_keys.data())
+	{
+		m_keys.swap(m_keysTemp);
+		m_order.swap(m_orderTemp);
+	}
+}
+
+void RenderQueue::Submit(RenderBackend& backend)
+{
+	if (!m_sorted)
+	{
+		Sort();
+	}
+
+	m_stats.Draws = 0;
+	m_stats.ShaderChanges = 0;
+	m_stats.MaterialChanges = 0;
+	m_stats.MeshChanges = 0;
+	m_stats.ConstantChanges = 0;
+
+	RenderReplay replay(backend, m_stats);
+	for (size_t i = 0; i < m_order.size(); ++i)
+	{
+		replay.Draw(m_packets[m_order[i]]);
+	}
+}
+
+RenderReplay::RenderReplay(RenderBackend& backend, RenderQueue::Stats& stats)
+	:m_backend(backend), m_stats(stats),
+	m_shader(NO_STATE), m_material(NO_STATE), m_mesh(NO_STATE), m_constants(NO_STATE)
+{
+}
+
+void RenderReplay::Draw(const DrawPacket& packet)
+{
+	if (packet.Shader != m_shader)
+	{
+		m_shader = packet.Shader;
+		m_backend.SetShader(m_shader);
+		++m_stats.ShaderChanges;
+	}
+
+	if (packet.Material != m_material)
+	{
+		m_material = packet.Material;
+		m_backend.SetMaterial(m_material);
+		++m_stats.MaterialChanges;
+	}
+
+	if (packet.Mesh != m_mesh)
+	{
+		m_mesh = packet.Mesh;
+		m_backend.SetMesh(m_mesh);
+		++m_stats.MeshChanges;
+	}
+
+	if (packet.Constants != DrawPacket::NO_CONSTANTS && packet.Constants != m_constants)
+	{
+		m_constants = packet.Constants;
+		m_backend.SetConstants(m_constants);
+		++m_stats.ConstantChanges;
+	}
+
+	m_backend.Draw(packet);
+	++m_stats.Draws;
+}
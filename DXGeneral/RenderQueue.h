@@ -0,0 +1,198 @@
+#pragma once
+
+//Sorted, state filtered draw submission
+//
+//Instead of calling the context, DrawScene records one DrawPacket per draw:
+//the ids of the shader, material, mesh and constant block it needs, the
+//draw ranges, and a 64 bit sort key built by MakeSortKey. Submit() radix
+//sorts the packets by key and replays them through a RenderBackend. The
+//backend is only told about state that differs from the packet before,
+//so draws sharing a shader set it once however they were recorded.
+//
+//Key layout, most significant first:
+//	pass 4 | shader 12 | material 16 | mesh 16 | depth 16
+//Packets of equal keys keep the order they were added in.
+//
+//The queue knows state only by id and never touches a device;
+//D3DRenderBackend maps the ids to D3D11 objects.
+
+#ifndef _RENDERQUEUE_H_
+#define _RENDERQUEUE_H_
+
+#include<Windows.h>
+#include<stdint.h>
+#include<vector>
+
+struct DrawPacket
+{
+	UINT64 Key;
+
+	//Ids into the tables of the backend
+	UINT16 Shader;
+	UINT16 Material;
+	UINT16 Mesh;
+	UINT16 Constants;	//NO_CONSTANTS when the draw has no constant block
+
+	UINT IndexCount;
+	UINT StartIndex;
+	INT BaseVertex;
+	UINT InstanceCount;
+	UINT StartInstance;
+
+	static const UINT16 NO_CONSTANTS = 0xffff;
+};
+
+//Receives the replay of a RenderQueue
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() {}
+
+	virtual void SetShader(UINT shader) = 0;
+	virtual void SetMaterial(UINT material) = 0;
+	virtual void SetMesh(UINT mesh) = 0;
+	virtual void SetConstants(UINT block) = 0;
+	virtual void Draw(const DrawPacket& packet) = 0;
+};
+
+//Drops everything, to measure the queue alone
+class NullRenderBackend : public RenderBackend
+{
+public:
+	void SetShader(UINT) {}
+	void SetMaterial(UINT) {}
+	void SetMesh(UINT) {}
+	void SetConstants(UINT) {}
+	void Draw(const DrawPacket&) {}
+};
+
+//Keeps every call, to compare two replays of the same scene
+class RecordingRenderBackend : public RenderBackend
+{
+public:
+	enum CommandType
+	{
+		COMMAND_SHADER,
+		COMMAND_MATERIAL,
+		COMMAND_MESH,
+		COMMAND_CONSTANTS,
+		COMMAND_DRAW
+	};
+
+	//Value is the id, or the key of a drawn packet
+	struct Command
+	{
+		CommandType Type;
+		UINT64 Value;
+
+		bool operator==(const Command& other) const { return Type == other.Type && Value == other.Value; }
+	};
+
+	void Clear() { m_commands.clear(); }
+	const std::vector<Command>& Commands() const { return m_commands; }
+
+	void SetShader(UINT shader) { Add(COMMAND_SHADER, shader); }
+	void SetMaterial(UINT material) { Add(COMMAND_MATERIAL, material); }
+	void SetMesh(UINT mesh) { Add(COMMAND_MESH, mesh); }
+	void SetConstants(UINT block) { Add(COMMAND_CONSTANTS, block); }
+	void Draw(const DrawPacket& packet) { Add(COMMAND_DRAW, packet.Key); }
+
+private:
+	void Add(CommandType type, UINT64 value)
+	{
+		Command command;
+		command.Type = type;
+		command.Value = value;
+		m_commands.push_back(command);
+	}
+
+private:
+	std::vector<Command> m_commands;
+};
+
+class RenderQueue
+{
+public:
+	//Of the last Submit()
+	struct Stats
+	{
+		UINT Draws;
+		UINT ShaderChanges;
+		UINT MaterialChanges;
+		UINT MeshChanges;
+		UINT ConstantChanges;
+		double SortMilliseconds;
+
+		UINT StateChanges() const { return ShaderChanges + MaterialChanges + MeshChanges + ConstantChanges; }
+	};
+
+public:
+	RenderQueue();
+
+	//Fields wider than the key layout are clamped
+	static UINT64 MakeSortKey(UINT pass, UINT shader, UINT material, UINT mesh, UINT depth);
+
+	//Depth between nearZ and farZ as the 16 bit depth field, nearest first.
+	//Opaque passes sort front to back with it, transparent ones can pass
+	//0xffff minus the result.
+	static UINT QuantizeDepth(float depth, float nearZ, float farZ);
+
+	void Clear();
+	void Add(const DrawPacket& packet);
+
+	UINT Count() const { return static_cast<UINT>(m_packets.size()); }
+
+	//Indices of the packets in key order. Submit() sorts by itself, Sort()
+	//alone is for measuring and inspecting.
+	void Sort();
+	const std::vector<UINT>& Order() const { return m_order; }
+
+	//The keys in the same order, ascending
+	const std::vector<UINT64>& SortedKeys() const { return m_keys; }
+
+	//Sorts when needed and replays the packets. Every Submit() starts with
+	//unknown state, so the first packet sets everything.
+	void Submit(RenderBackend& backend);
+
+	const Stats& LastStats() const { return m_stats; }
+
+	//Packet i in recording order
+	const DrawPacket& Packet(UINT i) const { return m_packets[i]; }
+
+private:
+	//LSD radix sort of m_keys and m_order by 8 bit digits, skipping digits
+	//that are equal in all keys
+	void RadixSort();
+
+private:
+	std::vector<DrawPacket> m_packets;
+	bool m_sorted;
+
+	std::vector<UINT64> m_keys;
+	std::vector<UINT> m_order;
+	std::vector<UINT64> m_keysTemp;
+	std::vector<UINT> m_orderTemp;
+
+	Stats m_stats;
+};
+
+//Sends packets to a backend, skipping state equal to the packet before.
+//Starts with unknown state and adds its calls to stats.
+class RenderReplay
+{
+public:
+	RenderReplay(RenderBackend& backend, RenderQueue::Stats& stats);
+
+	void Draw(const DrawPacket& packet);
+
+private:
+	RenderBackend& m_backend;
+	RenderQueue::Stats& m_stats;
+
+	UINT m_shader;
+	UINT m_material;
+	UINT m_mesh;
+	UINT m_constants;
+};
+
+#endif
@@ -0,0 +1,740 @@
+#include"SoftwareRasterizer.h"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<stdio.h>
+#include<string.h>
+
+#include<emmintrin.h>
+
+namespace
+{
+	const INT SUBPIXEL_BITS = 4;
+	const INT SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+
+	//Screen positions stay within this many pixels of the screen center,
+	//so coordinates fit 18 bits of 1/16 pixels and an edge changes by less
+	//than 2^28 across a tile
+	const float GUARD_BAND_PIXELS = 4096.0f;
+	const UINT MAX_SIZE = 8192;
+
+	//Edge values at a tile corner beyond this are clamped. Whole tiles then
+	//stay on one side of the edge and 32 bits hold the steps within it.
+	const INT64 EDGE_CLAMP = 1 << 30;
+
+	const UINT VERTEX_GRAIN = 256;
+	const UINT TRIANGLE_GRAIN = 128;
+
+	//Near plane and guard band, as dot(plane, position) >= 0
+	const UINT CLIP_PLANE_COUNT = 5;
+	const UINT MAX_CLIPPED_VERTICES = 3 + CLIP_PLANE_COUNT;
+
+	UINT PackColor(const XMFLOAT4& color)
+	{
+		auto channel = [](float value) -> UINT
+		{
+			value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+			return static_cast<UINT>(value*255.0f + 0.5f);
+		};
+
+		return channel(color.x) | (channel(color.y) << 8) | (channel(color.z) << 16) | (channel(color.w) << 24);
+	}
+
+	//Plane of q over a triangle at screen positions x, y, relative to vertex 0
+	void SetupPlane(float q0, float q1, float q2, double d1x, double d1y, double d2x, double d2y, double invDet,
+		float& origin, float& dx, float& dy)
+	{
+		double dq1 = q1 - q0;
+		double dq2 = q2 - q0;
+
+		origin = q0;
+		dx = static_cast<float>((dq1*d2y - dq2*d1y)*invDet);
+		dy = static_cast<float>((dq2*d1x - dq1*d2x)*invDet);
+	}
+}
+
+SoftwareRasterizer::SoftwareRasterizer(JobSystem& jobs)
+	:m_jobs(jobs), m_width(0), m_height(0), m_pitch(0), m_tilesX(0), m_tilesY(0),
+	m_guardX(1.0f), m_guardY(1.0f),
+	m_clearPending(false), m_clearColor(0), m_clearDepth(1.0f),
+	m_chunkCount(0), m_nextTile(0)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void SoftwareRasterizer::Resize(UINT width, UINT height)
+{
+	m_width = std::min(std::max(width, 1u), MAX_SIZE);
+	m_height = std::min(std::max(height, 1u), MAX_SIZE);
+
+	//Whole blocks of four pixels on every row
+	m_pitch = (m_width + 3) & ~3u;
+	m_tilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+	m_tilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+
+	m_guardX = 2.0f*GUARD_BAND_PIXELS / m_width;
+	m_guardY = 2.0f*GUARD_BAND_PIXELS / m_height;
+
+	m_color.assign(m_pitch*m_height, 0);
+	m_depth.assign(m_pitch*m_height, 1.0f);
+}
+
+void SoftwareRasterizer::Clear(const XMFLOAT4& color, float depth)
+{
+	m_clearPending = true;
+	m_clearColor = PackColor(color);
+	m_clearDepth = depth;
+
+	m_chunkCount = 0;
+	m_draws.clear();
+
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void SoftwareRasterizer::Draw(const DrawCall& draw)
+{
+	const UINT triangleCount = draw.IndexCount / 3;
+	if (!triangleCount || !m_width)
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Only the vertices the draw uses are shaded, meshes are often packed
+	//into one buffer
+	const UINT* indices = draw.Indices + draw.StartIndex;
+	INT64 first = INT64(indices[0]) + draw.BaseVertex;
+	INT64 last = first;
+	for (UINT i = 1; i < triangleCount * 3; ++i)
+	{
+		INT64 index = INT64(indices[i]) + draw.BaseVertex;
+		first = std::min(first, index);
+		last = std::max(last, index);
+	}
+
+	if (first < 0 || last >= draw.VertexCount)
+		return;
+
+	const UINT vertexCount = static_cast<UINT>(last - first + 1);
+	const BYTE* vertices = static_cast<const BYTE*>(draw.Vertices) + first*draw.VertexStride;
+	m_shaded.resize(vertexCount);
+	m_jobs.ParallelFor(vertexCount, VERTEX_GRAIN, [this, &draw, vertices](UINT begin, UINT end, UINT)
+	{
+		for (UINT i = begin; i < end; ++i)
+		{
+			draw.VS(vertices + i*draw.VertexStride, draw.Instance, m_shaded[i]);
+		}
+	});
+
+	const UINT drawIndex = static_cast<UINT>(m_draws.size());
+	DrawState state;
+	state.PS = draw.PS;
+	state.VaryingCount = std::min<UINT>(draw.VaryingCount, MAX_VARYINGS);
+	m_draws.push_back(state);
+
+	//Grown only, a chunk keeps its vectors between frames
+	const UINT chunkBase = m_chunkCount;
+	m_chunkCount += m_jobs.ChunkCount(triangleCount, TRIANGLE_GRAIN);
+	if (m_chunks.size() < m_chunkCount)
+	{
+		m_chunks.resize(m_chunkCount);
+	}
+
+	const INT vertexBase = static_cast<INT>(draw.BaseVertex - first);
+	m_jobs.ParallelFor(triangleCount, TRIANGLE_GRAIN,
+		[this, &draw, &state, indices, vertexBase, chunkBase, drawIndex](UINT begin, UINT end, UINT slice)
+	{
+		Chunk& chunk = m_chunks[chunkBase + slice];
+		chunk.Triangles.clear();
+		chunk.Bins.clear();
+		chunk.Culled = 0;
+		chunk.Clipped = 0;
+
+		for (UINT i = begin; i < end; ++i)
+		{
+			const ShadedVertex* triangle[3] =
+			{
+				&m_shaded[indices[i * 3 + 0] + vertexBase],
+				&m_shaded[indices[i * 3 + 1] + vertexBase],
+				&m_shaded[indices[i * 3 + 2] + vertexBase]
+			};
+			SetupTriangle(triangle, state.VaryingCount, draw.CullBack, drawIndex, chunk);
+		}
+	});
+
+	for (UINT c = chunkBase; c < m_chunkCount; ++c)
+	{
+		m_stats.CulledTriangles += m_chunks[c].Culled;
+		m_stats.ClippedTriangles += m_chunks[c].Clipped;
+	}
+
+	++m_stats.Draws;
+	m_stats.Triangles += triangleCount;
+	m_stats.SetupMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void SoftwareRasterizer::SetupTriangle(const ShadedVertex* const* vertices, UINT varyingCount, bool cullBack, UINT draw, Chunk& chunk) const
+{
+	//Outside one plane of the frustum, nothing to draw
+	UINT frustumAnd = 0x3f;
+	UINT clipOr = 0;
+	for (UINT i = 0; i < 3; ++i)
+	{
+		const XMFLOAT4& p = vertices[i]->Position;
+
+		UINT frustum = 0;
+		frustum |= p.z < 0.0f ? 1 : 0;
+		frustum |= p.z > p.w ? 2 : 0;
+		frustum |= p.x < -p.w ? 4 : 0;
+		frustum |= p.x > p.w ? 8 : 0;
+		frustum |= p.y < -p.w ? 16 : 0;
+		frustum |= p.y > p.w ? 32 : 0;
+		frustumAnd &= frustum;
+
+		clipOr |= p.z < 0.0f ? 1 : 0;
+		clipOr |= p.x < -m_guardX*p.w ? 2 : 0;
+		clipOr |= p.x > m_guardX*p.w ? 4 : 0;
+		clipOr |= p.y < -m_guardY*p.w ? 8 : 0;
+		clipOr |= p.y > m_guardY*p.w ? 16 : 0;
+	}
+
+	if (frustumAnd)
+	{
+		++chunk.Culled;
+		return;
+	}
+
+	if (!clipOr)
+	{
+		EmitTriangle(vertices, varyingCount, cullBack, draw, chunk);
+		return;
+	}
+
+	++chunk.Clipped;
+
+	//Sutherland-Hodgman against the planes the triangle crosses. Position
+	//and varyings are linear in clip space.
+	const XMFLOAT4 planes[CLIP_PLANE_COUNT] =
+	{
+		XMFLOAT4(0.0f, 0.0f, 1.0f, 0.0f),
+		XMFLOAT4(1.0f, 0.0f, 0.0f, m_guardX),
+		XMFLOAT4(-1.0f, 0.0f, 0.0f, m_guardX),
+		XMFLOAT4(0.0f, 1.0f, 0.0f, m_guardY),
+		XMFLOAT4(0.0f, -1.0f, 0.0f, m_guardY)
+	};
+
+	ShadedVertex polygons[2][MAX_CLIPPED_VERTICES];
+	UINT count = 3;
+	for (UINT i = 0; i < 3; ++i)
+	{
+		polygons[0][i] = *vertices[i];
+	}
+
+	UINT current = 0;
+	for (UINT plane = 0; plane < CLIP_PLANE_COUNT && count >= 3; ++plane)
+	{
+		if (!(clipOr & (1 << plane)))
+			continue;
+
+		const XMFLOAT4& n = planes[plane];
+		auto distance = [&n](const ShadedVertex& v)
+		{
+			return n.x*v.Position.x + n.y*v.Position.y + n.z*v.Position.z + n.w*v.Position.w;
+		};
+
+		const ShadedVertex* in = polygons[current];
+		ShadedVertex* out = polygons[current ^ 1];
+		UINT outCount = 0;
+
+		for (UINT i = 0; i < count; ++i)
+		{
+			const ShadedVertex& a = in[i];
+			const ShadedVertex& b = in[(i + 1) % count];
+			float da = distance(a);
+			float db = distance(b);
+
+			if (da >= 0.0f)
+			{
+				out[outCount++] = a;
+			}
+
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				float t = da / (da - db);
+				ShadedVertex& v = out[outCount++];
+				v.Position.x = a.Position.x + (b.Position.x - a.Position.x)*t;
+				v.Position.y = a.Position.y + (b.Position.y - a.Position.y)*t;
+				v.Position.z = a.Position.z + (b.Position.z - a.Position.z)*t;
+				v.Position.w = a.Position.w + (b.Position.w - a.Position.w)*t;
+				for (UINT k = 0; k < varyingCount; ++k)
+				{
+					v.Varyings[k] = a.Varyings[k] + (b.Varyings[k] - a.Varyings[k])*t;
+				}
+			}
+		}
+
+		count = outCount;
+		current ^= 1;
+	}
+
+	//A fan over the convex remainder
+	const ShadedVertex* polygon = polygons[current];
+	for (UINT i = 1; i + 1 < count; ++i)
+	{
+		const ShadedVertex* triangle[3] = { &polygon[0], &polygon[i], &polygon[i + 1] };
+		EmitTriangle(triangle, varyingCount, cullBack, draw, chunk);
+	}
+}
+
+void SoftwareRasterizer::EmitTriangle(const ShadedVertex* const* vertices, UINT varyingCount, bool cullBack, UINT draw, Chunk& chunk) const
+{
+	INT fx[3], fy[3];
+	float sx[3], sy[3], z[3], invW[3];
+	for (UINT i = 0; i < 3; ++i)
+	{
+		const XMFLOAT4& p = vertices[i]->Position;
+		invW[i] = 1.0f / p.w;
+		z[i] = p.z*invW[i];
+
+		//Snapped, the planes are set up from the same positions the edges use
+		fx[i] = static_cast<INT>(floorf(((p.x*invW[i])*0.5f + 0.5f)*m_width*SUBPIXEL_ONE + 0.5f));
+		fy[i] = static_cast<INT>(floorf((0.5f - (p.y*invW[i])*0.5f)*m_height*SUBPIXEL_ONE + 0.5f));
+		sx[i] = static_cast<float>(fx[i]) / SUBPIXEL_ONE;
+		sy[i] = static_cast<float>(fy[i]) / SUBPIXEL_ONE;
+	}
+
+	//Clockwise on screen, y down, is a positive area and a front face
+	INT64 area = INT64(fx[1] - fx[0])*(fy[2] - fy[0]) - INT64(fx[2] - fx[0])*(fy[1] - fy[0]);
+	if (area == 0 || (area < 0 && cullBack))
+	{
+		++chunk.Culled;
+		return;
+	}
+
+	UINT order[3] = { 0, 1, 2 };
+	if (area < 0)
+	{
+		std::swap(order[1], order[2]);
+	}
+
+	//Pixel centers at (x + 0.5, y + 0.5) in the bounds
+	INT minX = std::min(fx[0], std::min(fx[1], fx[2]));
+	INT maxX = std::max(fx[0], std::max(fx[1], fx[2]));
+	INT minY = std::min(fy[0], std::min(fy[1], fy[2]));
+	INT maxY = std::max(fy[0], std::max(fy[1], fy[2]));
+
+	Triangle t;
+	t.MinX = std::max((minX + SUBPIXEL_ONE / 2 - 1) >> SUBPIXEL_BITS, 0);
+	t.MinY = std::max((minY + SUBPIXEL_ONE / 2 - 1) >> SUBPIXEL_BITS, 0);
+	t.MaxX = std::min((maxX - SUBPIXEL_ONE / 2) >> SUBPIXEL_BITS, static_cast<INT>(m_width) - 1);
+	t.MaxY = std::min((maxY - SUBPIXEL_ONE / 2) >> SUBPIXEL_BITS, static_cast<INT>(m_height) - 1);
+	if (t.MinX > t.MaxX || t.MinY > t.MaxY)
+	{
+		++chunk.Culled;
+		return;
+	}
+
+	for (UINT k = 0; k < 3; ++k)
+	{
+		UINT a = order[k];
+		UINT b = order[(k + 1) % 3];
+
+		t.A[k] = fy[a] - fy[b];
+		t.B[k] = fx[b] - fx[a];
+		t.C[k] = -(INT64(t.A[k])*fx[a] + INT64(t.B[k])*fy[a]);
+
+		//Top-left rule: pixel centers on a left or top edge are inside,
+		//on the others they are not
+		bool topLeft = t.A[k] > 0 || (t.A[k] == 0 && t.B[k] > 0);
+		if (!topLeft)
+		{
+			t.C[k] -= 1;
+		}
+	}
+
+	double d1x = sx[1] - sx[0];
+	double d1y = sy[1] - sy[0];
+	double d2x = sx[2] - sx[0];
+	double d2y = sy[2] - sy[0];
+	double invDet = 1.0 / (d1x*d2y - d2x*d1y);
+
+	t.X0 = sx[0];
+	t.Y0 = sy[0];
+	SetupPlane(z[0], z[1], z[2], d1x, d1y, d2x, d2y, invDet, t.Z.Origin, t.Z.DX, t.Z.DY);
+	SetupPlane(invW[0], invW[1], invW[2], d1x, d1y, d2x, d2y, invDet, t.InvW.Origin, t.InvW.DX, t.InvW.DY);
+	for (UINT k = 0; k < varyingCount; ++k)
+	{
+		SetupPlane(vertices[0]->Varyings[k] * invW[0], vertices[1]->Varyings[k] * invW[1], vertices[2]->Varyings[k] * invW[2],
+			d1x, d1y, d2x, d2y, invDet, t.Varyings[k].Origin, t.Varyings[k].DX, t.Varyings[k].DY);
+	}
+	t.Draw = draw;
+
+	const UINT index = static_cast<UINT>(chunk.Triangles.size());
+	chunk.Triangles.push_back(t);
+
+	for (INT ty = t.MinY / TILE_SIZE; ty <= t.MaxY / TILE_SIZE; ++ty)
+	{
+		for (INT tx = t.MinX / TILE_SIZE; tx <= t.MaxX / TILE_SIZE; ++tx)
+		{
+			BinEntry entry;
+			entry.Tile = ty*m_tilesX + tx;
+			entry.Triangle = index;
+			chunk.Bins.push_back(entry);
+		}
+	}
+}
+
+void SoftwareRasterizer::Finish()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const UINT tileCount = m_tilesX*m_tilesY;
+
+	//Bins to per tile lists, in draw order and within a draw in slice
+	//order, which is submission order
+	m_tileStart.assign(tileCount + 1, 0);
+	for (UINT c = 0; c < m_chunkCount; ++c)
+	{
+		const std::vector<BinEntry>& bins = m_chunks[c].Bins;
+		for (size_t i = 0; i < bins.size(); ++i)
+		{
+			++m_tileStart[bins[i].Tile + 1];
+		}
+	}
+
+	for (UINT tile = 0; tile < tileCount; ++tile)
+	{
+		m_tileStart[tile + 1] += m_tileStart[tile];
+	}
+
+	m_tileTriangles.resize(m_tileStart[tileCount]);
+	std::vector<UINT> cursors(m_tileStart.begin(), m_tileStart.end() - 1);
+	for (UINT c = 0; c < m_chunkCount; ++c)
+	{
+		const Chunk& chunk = m_chunks[c];
+		for (size_t i = 0; i < chunk.Bins.size(); ++i)
+		{
+			const BinEntry& entry = chunk.Bins[i];
+			m_tileTriangles[cursors[entry.Tile]++] = &chunk.Triangles[entry.Triangle];
+		}
+	}
+
+	//Tiles differ a lot in cost, so the workers take them one at a time
+	//instead of in fixed ranges
+	const UINT workers = m_jobs.ChunkCount(tileCount, 1);
+	std::vector<UINT64> pixels(workers, 0);
+	m_nextTile = 0;
+	m_jobs.ParallelFor(workers, 1, [this, tileCount, &pixels](UINT, UINT, UINT worker)
+	{
+		for (UINT tile = m_nextTile++; tile < tileCount; tile = m_nextTile++)
+		{
+			pixels[worker] += RasterTile(tile);
+		}
+	});
+
+	for (UINT worker = 0; worker < workers; ++worker)
+	{
+		m_stats.ShadedPixels += pixels[worker];
+	}
+
+	m_stats.BinnedTriangles = static_cast<UINT>(m_tileTriangles.size());
+	m_stats.RasterMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	m_clearPending = false;
+	m_chunkCount = 0;
+	m_draws.clear();
+}
+
+UINT64 SoftwareRasterizer::RasterTile(UINT tile)
+{
+	const INT tileX = (tile % m_tilesX)*TILE_SIZE;
+	const INT tileY = (tile / m_tilesX)*TILE_SIZE;
+	const INT tileRight = std::min<INT>(tileX + TILE_SIZE, m_width) - 1;
+	const INT tileBottom = std::min<INT>(tileY + TILE_SIZE, m_height) - 1;
+
+	if (m_clearPending)
+	{
+		for (INT y = tileY; y <= tileBottom; ++y)
+		{
+			//The padding of the last tile of a row too
+			const INT right = tileRight == static_cast<INT>(m_width) - 1 ? static_cast<INT>(m_pitch) - 1 : tileRight;
+			std::fill(m_color.begin() + y*m_pitch + tileX, m_color.begin() + y*m_pitch + right + 1, m_clearColor);
+			std::fill(m_depth.begin() + y*m_pitch + tileX, m_depth.begin() + y*m_pitch + right + 1, m_clearDepth);
+		}
+	}
+
+	UINT64 shaded = 0;
+	float varyings[MAX_VARYINGS];
+
+	const __m128i minusOne = _mm_set1_epi32(-1);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 laneOffsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	const __m128i laneIndices = _mm_set_epi32(3, 2, 1, 0);
+	const __m128i screenWidth = _mm_set1_epi32(m_width);
+
+	for (UINT i = m_tileStart[tile]; i < m_tileStart[tile + 1]; ++i)
+	{
+		const Triangle& t = *m_tileTriangles[i];
+		const DrawState& draw = m_draws[t.Draw];
+
+		//Blocks of four start at multiples of four, the tiles do as well
+		const INT x0 = std::max(t.MinX, tileX) & ~3;
+		const INT x1 = std::min(t.MaxX, tileRight);
+		const INT y0 = std::max(t.MinY, tileY);
+		const INT y1 = std::min(t.MaxY, tileBottom);
+
+		//Edges at the center of pixel (x0, y0), and whether the blocks
+		//covering the rectangle are outside one of them or inside all three
+		const INT64 px = INT64(x0)*SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+		const INT64 py = INT64(y0)*SUBPIXEL_ONE + SUBPIXEL_ONE / 2;
+		const INT64 spanX = INT64((x1 | 3) - x0)*SUBPIXEL_ONE;
+		const INT64 spanY = INT64(y1 - y0)*SUBPIXEL_ONE;
+
+		INT rowEdges[3];
+		__m128i stepX[3];
+		INT stepY[3];
+		bool outside = false;
+		bool covered = true;
+		for (UINT k = 0; k < 3; ++k)
+		{
+			INT64 e = t.A[k] * px + t.B[k] * py + t.C[k];
+			INT64 eMin = e + std::min<INT64>(t.A[k] * spanX, 0) + std::min<INT64>(t.B[k] * spanY, 0);
+			INT64 eMax = e + std::max<INT64>(t.A[k] * spanX, 0) + std::max<INT64>(t.B[k] * spanY, 0);
+			outside |= eMax < 0;
+			covered &= eMin >= 0;
+
+			rowEdges[k] = static_cast<INT>(std::max(std::min(e, EDGE_CLAMP), -EDGE_CLAMP));
+			stepX[k] = _mm_set1_epi32(t.A[k] * SUBPIXEL_ONE * 4);
+			stepY[k] = t.B[k] * SUBPIXEL_ONE;
+		}
+
+		if (outside)
+			continue;
+
+		const INT stepA[3] = { t.A[0] * SUBPIXEL_ONE, t.A[1] * SUBPIXEL_ONE, t.A[2] * SUBPIXEL_ONE };
+		const __m128i laneEdges[3] =
+		{
+			_mm_set_epi32(stepA[0] * 3, stepA[0] * 2, stepA[0], 0),
+			_mm_set_epi32(stepA[1] * 3, stepA[1] * 2, stepA[1], 0),
+			_mm_set_epi32(stepA[2] * 3, stepA[2] * 2, stepA[2], 0)
+		};
+
+		const __m128 zDX = _mm_set1_ps(t.Z.DX);
+		const __m128 zDX4 = _mm_set1_ps(t.Z.DX*4.0f);
+
+		for (INT y = y0; y <= y1; ++y)
+		{
+			__m128i e0 = _mm_add_epi32(_mm_set1_epi32(rowEdges[0]), laneEdges[0]);
+			__m128i e1 = _mm_add_epi32(_mm_set1_epi32(rowEdges[1]), laneEdges[1]);
+			__m128i e2 = _mm_add_epi32(_mm_set1_epi32(rowEdges[2]), laneEdges[2]);
+
+			const float fy = y + 0.5f - t.Y0;
+			const float fx0 = x0 + 0.5f - t.X0;
+			__m128 z = _mm_add_ps(_mm_set1_ps(t.Z.Origin + t.Z.DY*fy + t.Z.DX*fx0), _mm_mul_ps(zDX, laneOffsets));
+
+			UINT* colorRow = &m_color[y*m_pitch];
+			float* depthRow = &m_depth[y*m_pitch];
+
+			for (INT x = x0; x <= x1; x += 4)
+			{
+				__m128i inside;
+				if (covered)
+				{
+					inside = minusOne;
+				}
+				else
+				{
+					inside = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(e0, minusOne), _mm_cmpgt_epi32(e1, minusOne)),
+						_mm_cmpgt_epi32(e2, minusOne));
+				}
+
+				//The last block of a row may reach into the padding
+				if (x + 3 >= static_cast<INT>(m_width))
+				{
+					inside = _mm_and_si128(inside, _mm_cmplt_epi32(_mm_add_epi32(_mm_set1_epi32(x), laneIndices), screenWidth));
+				}
+
+				if (_mm_movemask_epi8(inside))
+				{
+					__m128 depth = _mm_loadu_ps(depthRow + x);
+					__m128 pass = _mm_and_ps(_mm_castsi128_ps(inside), _mm_cmplt_ps(z, depth));
+					pass = _mm_and_ps(pass, _mm_and_ps(_mm_cmpge_ps(z, zero), _mm_cmple_ps(z, one)));
+
+					int mask = _mm_movemask_ps(pass);
+					if (mask)
+					{
+						_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, depth)));
+
+						for (INT lane = 0; lane < 4; ++lane)
+						{
+							if (!(mask & (1 << lane)))
+								continue;
+
+							const float fx = x + lane + 0.5f - t.X0;
+							const float w = 1.0f / (t.InvW.Origin + t.InvW.DX*fx + t.InvW.DY*fy);
+							for (UINT k = 0; k < draw.VaryingCount; ++k)
+							{
+								const Plane& plane = t.Varyings[k];
+								varyings[k] = (plane.Origin + plane.DX*fx + plane.DY*fy)*w;
+							}
+
+							colorRow[x + lane] = PackColor(draw.PS(varyings));
+							++shaded;
+						}
+					}
+				}
+
+				e0 = _mm_add_epi32(e0, stepX[0]);
+				e1 = _mm_add_epi32(e1, stepX[1]);
+				e2 = _mm_add_epi32(e2, stepX[2]);
+				z = _mm_add_ps(z, zDX4);
+			}
+
+			rowEdges[0] += stepY[0];
+			rowEdges[1] += stepY[1];
+			rowEdges[2] += stepY[2];
+		}
+	}
+
+	return shaded;
+}
+
+UINT64 SoftwareRasterizer::Checksum() const
+{
+	UINT64 hash = 14695981039346656037ull;
+	for (UINT y = 0; y < m_height; ++y)
+	{
+		const BYTE* row = reinterpret_cast<const BYTE*>(&m_color[y*m_pitch]);
+		for (UINT i = 0; i < m_width * 4; ++i)
+		{
+			hash = (hash ^ row[i]) * 1099511628211ull;
+		}
+	}
+
+	return hash;
+}
+
+bool SoftwareRasterizer::SaveBitmap(const char* fileName) const
+{
+	FILE* file = fopen(fileName, "wb");
+	if (!file)
+		return false;
+
+	//Rows are BGR, padded to four bytes, bottom up
+	const UINT rowSize = (m_width * 3 + 3) & ~3u;
+	const UINT imageSize = rowSize*m_height;
+
+	BYTE header[54];
+	memset(header, 0, sizeof(header));
+	auto put32 = [&header](UINT offset, UINT value)
+	{
+		header[offset + 0] = static_cast<BYTE>(value);
+		header[offset + 1] = static_cast<BYTE>(value >> 8);
+		header[offset + 2] = static_cast<BYTE>(value >> 16);
+		header[offset + 3] = static_cast<BYTE>(value >> 24);
+	};
+
+	header[0] = 'B';
+	header[1] = 'M';
+	put32(2, sizeof(header) + imageSize);
+	put32(10, sizeof(header));
+	put32(14, 40);
+	put32(18, m_width);
+	put32(22, m_height);
+	header[26] = 1;
+	header[28] = 24;
+	put32(34, imageSize);
+
+	bool result = fwrite(header, sizeof(header), 1, file) == 1;
+
+	std::vector<BYTE> row(rowSize, 0);
+	for (UINT y = m_height; y-- > 0 && result;)
+	{
+		const UINT* pixels = &m_color[y*m_pitch];
+		for (UINT x = 0; x < m_width; ++x)
+		{
+			row[x * 3 + 0] = static_cast<BYTE>(pixels[x] >> 16);
+			row[x * 3 + 1] = static_cast<BYTE>(pixels[x] >> 8);
+			row[x * 3 + 2] = static_cast<BYTE>(pixels[x]);
+		}
+		result = fwrite(row.data(), rowSize, 1, file) == 1;
+	}
+
+	fclose(file);
+	return result;
+}
+
+SoftwareRenderBackend::SoftwareRenderBackend(SoftwareRasterizer& rasterizer)
+	:m_rasterizer(rasterizer), m_shader(0), m_material(0), m_mesh(0), m_constants(DrawPacket::NO_CONSTANTS)
+{
+}
+
+UINT SoftwareRenderBackend::AddShader(const ShaderState& shader)
+{
+	m_shaders.push_back(shader);
+	return static_cast<UINT>(m_shaders.size() - 1);
+}
+
+UINT SoftwareRenderBackend::AddMesh(const MeshState& mesh)
+{
+	m_meshes.push_back(mesh);
+	return static_cast<UINT>(m_meshes.size() - 1);
+}
+
+void SoftwareRenderBackend::SetShader(UINT shader)
+{
+	m_shader = shader;
+}
+
+void SoftwareRenderBackend::SetMaterial(UINT material)
+{
+	m_material = material;
+}
+
+void SoftwareRenderBackend::SetMesh(UINT mesh)
+{
+	m_mesh = mesh;
+}
+
+void SoftwareRenderBackend::SetConstants(UINT block)
+{
+	m_constants = block;
+}
+
+//One draw per instance
+void SoftwareRenderBackend::Draw(const DrawPacket& packet)
+{
+	if (m_shader >= m_shaders.size() || m_mesh >= m_meshes.size())
+		return;
+
+	const ShaderState& shader = m_shaders[m_shader];
+	const MeshState& mesh = m_meshes[m_mesh];
+	if (packet.StartIndex + packet.IndexCount > mesh.IndexCount)
+		return;
+
+	const UINT material = m_material;
+	const UINT constants = m_constants;
+	const SoftwareRenderBackend::VertexShader& vs = shader.VS;
+
+	SoftwareRasterizer::DrawCall draw;
+	draw.Vertices = mesh.Vertices;
+	draw.VertexStride = mesh.VertexStride;
+	draw.VertexCount = mesh.VertexCount;
+	draw.Indices = mesh.Indices;
+	draw.IndexCount = packet.IndexCount;
+	draw.StartIndex = packet.StartIndex;
+	draw.BaseVertex = packet.BaseVertex;
+	draw.VS = [&vs, material, constants](const void* vertex, UINT instance, SoftwareRasterizer::ShadedVertex& out)
+	{
+		vs(vertex, instance, material, constants, out);
+	};
+	draw.PS = shader.PS;
+	draw.VaryingCount = shader.VaryingCount;
+	draw.CullBack = shader.CullBack;
+
+	for (UINT i = 0; i < packet.InstanceCount; ++i)
+	{
+		draw.Instance = packet.StartInstance + i;
+		m_rasterizer.Draw(draw);
+	}
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+//Tile based CPU rasterizer for indexed triangle lists
+//
+//Draw() runs the vertex shader over the vertices the draw references, then
+//clips, sets up and bins its triangles into 64x64 pixel tiles, both on the
+//workers of the job system. Finish() rasterizes the tiles in parallel, each
+//one by one worker, so pixels need no locks. Within a tile triangles are
+//drawn in submission order.
+//
+//Coverage and the depth test run on four pixels at a time with SSE2, on
+//edge functions in 1/16 pixel fixed point with the top-left fill rule of
+//D3D. The pixel shader is called per covered pixel that passed the depth
+//test, with its varyings interpolated perspective correct. Depth is a float
+//per pixel tested with LESS; color is R8G8B8A8.
+//
+//Vertex and pixel shaders are C++ callables and run on any worker thread.
+//Triangles are clipped against the near plane and a guard band around the
+//screen, front faces are clockwise as on the default D3D rasterizer state.
+//
+//SoftwareRenderBackend replays a RenderQueue into the rasterizer, so a demo
+//can draw the packets it records for the device on the CPU instead.
+
+#ifndef _SOFTWARERASTERIZER_H_
+#define _SOFTWARERASTERIZER_H_
+
+#include "MathHelper.h"
+#include "RenderQueue.h"
+#include "JobSystem.h"
+
+#include<atomic>
+#include<functional>
+
+class SoftwareRasterizer
+{
+public:
+	enum
+	{
+		MAX_VARYINGS = 8,
+		TILE_SIZE = 64
+	};
+
+	//What the vertex shader writes: the clip space position and up to
+	//MAX_VARYINGS attributes for the pixel shader
+	struct ShadedVertex
+	{
+		XMFLOAT4 Position;
+		float Varyings[MAX_VARYINGS];
+	};
+
+	//vertex, instance of the draw, output
+	typedef std::function<void(const void*, UINT, ShadedVertex&)> VertexShader;
+
+	//Interpolated varyings to RGBA in [0, 1]
+	typedef std::function<XMFLOAT4(const float*)> PixelShader;
+
+	//DrawIndexed of a single instance. Indices plus BaseVertex index
+	//Vertices, which is VertexCount vertices of VertexStride bytes.
+	struct DrawCall
+	{
+		const void* Vertices;
+		UINT VertexStride;
+		UINT VertexCount;
+		const UINT* Indices;
+		UINT IndexCount;
+		UINT StartIndex;
+		INT BaseVertex;
+		UINT Instance;
+
+		VertexShader VS;
+		PixelShader PS;
+		UINT VaryingCount;
+		bool CullBack;
+	};
+
+	struct Stats
+	{
+		UINT Draws;
+		UINT Triangles;
+		UINT CulledTriangles;	//Back faces, outside the frustum or covering no pixel center
+		UINT ClippedTriangles;	//Crossing the near plane or the guard band
+		UINT BinnedTriangles;	//Triangle and tile pairs
+		UINT64 ShadedPixels;
+
+		double SetupMilliseconds;	//Vertex shading, setup and binning of all draws
+		double RasterMilliseconds;	//Finish()
+	};
+
+public:
+	SoftwareRasterizer(JobSystem& jobs = JobSystem::Default());
+
+	//Up to 8192 x 8192, the guard band is sized for that
+	void Resize(UINT width, UINT height);
+
+	//Starts a frame. The targets are cleared by the tiles in Finish().
+	void Clear(const XMFLOAT4& color, float depth = 1.0f);
+
+	//Shades, sets up and bins the triangles. The shaders are called before
+	//Finish() returns; the vertex and index arrays only during Draw().
+	void Draw(const DrawCall& draw);
+
+	//Rasterizes everything drawn since Clear()
+	void Finish();
+
+	UINT Width() const { return m_width; }
+	UINT Height() const { return m_height; }
+
+	//Rows of Pitch() pixels, R8G8B8A8 and depth
+	UINT Pitch() const { return m_pitch; }
+	const UINT* Pixels() const { return m_color.data(); }
+	const float* Depth() const { return m_depth.data(); }
+
+	//FNV-1a of the visible pixels, to compare against golden images
+	UINT64 Checksum() const;
+
+	//24 bit BMP
+	bool SaveBitmap(const char* fileName) const;
+
+	const Stats& LastStats() const { return m_stats; }
+
+private:
+	//q = Origin + DX*(x - X0) + DY*(y - Y0) at pixel (x, y)
+	struct Plane
+	{
+		float Origin;
+		float DX;
+		float DY;
+	};
+
+	//Edge k runs from vertex k to vertex k+1, inside where
+	//A*x + B*y + C >= 0 in 1/16 pixels. C holds the fill rule.
+	struct Triangle
+	{
+		INT A[3];
+		INT B[3];
+		INT64 C[3];
+
+		//Pixels, inclusive and on screen
+		INT MinX, MinY, MaxX, MaxY;
+
+		float X0, Y0;
+		Plane Z;
+		Plane InvW;
+		Plane Varyings[MAX_VARYINGS];	//Divided by w
+
+		UINT Draw;
+	};
+
+	struct BinEntry
+	{
+		UINT Tile;
+		UINT Triangle;
+	};
+
+	//Triangles of one slice of one draw, written by one worker
+	struct Chunk
+	{
+		std::vector<Triangle> Triangles;
+		std::vector<BinEntry> Bins;
+		UINT Culled;
+		UINT Clipped;
+	};
+
+	struct DrawState
+	{
+		PixelShader PS;
+		UINT VaryingCount;
+	};
+
+	void SetupTriangle(const ShadedVertex* const* vertices, UINT varyingCount, bool cullBack, UINT draw, Chunk& chunk) const;
+	void EmitTriangle(const ShadedVertex* const* vertices, UINT varyingCount, bool cullBack, UINT draw, Chunk& chunk) const;
+	UINT64 RasterTile(UINT tile);
+
+private:
+	JobSystem& m_jobs;
+
+	UINT m_width;
+	UINT m_height;
+	UINT m_pitch;
+	UINT m_tilesX;
+	UINT m_tilesY;
+
+	//Guard band in clip space, as a multiple of w
+	float m_guardX;
+	float m_guardY;
+
+	std::vector<UINT> m_color;
+	std::vector<float> m_depth;
+
+	bool m_clearPending;
+	UINT m_clearColor;
+	float m_clearDepth;
+
+	//Of the draw in flight
+	std::vector<ShadedVertex> m_shaded;
+
+	//Kept between frames for their allocations, m_chunkCount used
+	std::vector<Chunk> m_chunks;
+	UINT m_chunkCount;
+	std::vector<DrawState> m_draws;
+
+	//Triangles of tile i are m_tileTriangles[m_tileStart[i], m_tileStart[i+1])
+	std::vector<UINT> m_tileStart;
+	std::vector<const Triangle*> m_tileTriangles;
+	std::atomic<UINT> m_nextTile;
+
+	Stats m_stats;
+};
+
+//Draws DrawPackets through a SoftwareRasterizer. Shaders and meshes are
+//registered up front like the D3D objects of D3DRenderBackend; materials
+//and constant blocks are passed on to the shaders as ids.
+class SoftwareRenderBackend : public RenderBackend
+{
+public:
+	//vertex, instance, material, constant block, output
+	typedef std::function<void(const void*, UINT, UINT, UINT, SoftwareRasterizer::ShadedVertex&)> VertexShader;
+
+	struct ShaderState
+	{
+		VertexShader VS;
+		SoftwareRasterizer::PixelShader PS;
+		UINT VaryingCount;
+		bool CullBack;
+	};
+
+	//CPU copies of the vertex and index buffers
+	struct MeshState
+	{
+		const void* Vertices;
+		UINT VertexStride;
+		UINT VertexCount;
+		const UINT* Indices;
+		UINT IndexCount;
+	};
+
+public:
+	SoftwareRenderBackend(SoftwareRasterizer& rasterizer);
+
+	UINT AddShader(const ShaderState& shader);
+	UINT AddMesh(const MeshState& mesh);
+
+	void SetShader(UINT shader);
+	void SetMaterial(UINT material);
+	void SetMesh(UINT mesh);
+	void SetConstants(UINT block);
+	void Draw(const DrawPacket& packet);
+
+private:
+	SoftwareRasterizer& m_rasterizer;
+
+	std::vector<ShaderState> m_shaders;
+	std::vector<MeshState> m_meshes;
+
+	UINT m_shader;
+	UINT m_material;
+	UINT m_mesh;
+	UINT m_constants;
+};
+
+#endif
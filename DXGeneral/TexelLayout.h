@@ -0,0 +1,149 @@
+#pragma once
+
+//Memory layouts of the uncompressed DXGI formats the CPU texture code reads
+//and writes, and scalar half float conversion
+//
+//Shared by MipGenerator and FormatConverter. Each handles a subset of the
+//layouts and treats the others as unsupported.
+
+#ifndef _TEXELLAYOUT_H_
+#define _TEXELLAYOUT_H_
+
+#include<stdint.h>
+#include<cstring>
+
+#if defined(_WIN32)
+#include<dxgiformat.h>
+#else
+#include<directx/dxgiformat.h>
+#endif
+
+//How texels of a format are laid out in memory
+enum TexelLayout
+{
+	LAYOUT_NONE = 0,
+	LAYOUT_RGBA8,
+	LAYOUT_BGRA8,
+	LAYOUT_BGRX8,
+	LAYOUT_RG8,
+	LAYOUT_R8,
+	LAYOUT_A8,
+	LAYOUT_RGBA16,
+	LAYOUT_RGB10A2,
+	LAYOUT_RGBA16F,
+	LAYOUT_R16F,
+	LAYOUT_RGBA32F,
+	LAYOUT_RGB32F,
+	LAYOUT_R32F,
+	LAYOUT_R11G11B10,
+	LAYOUT_RGB9E5
+};
+
+//LAYOUT_NONE for formats with none of these layouts. srgb tells whether
+//the color channels are sRGB encoded.
+inline TexelLayout GetTexelLayout(DXGI_FORMAT format, bool* srgb)
+{
+	*srgb = false;
+
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		*srgb = true;
+		return LAYOUT_RGBA8;
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+		return LAYOUT_RGBA8;
+
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		*srgb = true;
+		return LAYOUT_BGRA8;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+		return LAYOUT_BGRA8;
+
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		*srgb = true;
+		return LAYOUT_BGRX8;
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+		return LAYOUT_BGRX8;
+
+	case DXGI_FORMAT_R8G8_UNORM:			return LAYOUT_RG8;
+	case DXGI_FORMAT_R8_UNORM:				return LAYOUT_R8;
+	case DXGI_FORMAT_A8_UNORM:				return LAYOUT_A8;
+	case DXGI_FORMAT_R16G16B16A16_UNORM:	return LAYOUT_RGBA16;
+	case DXGI_FORMAT_R10G10B10A2_UNORM:		return LAYOUT_RGB10A2;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:	return LAYOUT_RGBA16F;
+	case DXGI_FORMAT_R16_FLOAT:				return LAYOUT_R16F;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:	return LAYOUT_RGBA32F;
+	case DXGI_FORMAT_R32G32B32_FLOAT:		return LAYOUT_RGB32F;
+	case DXGI_FORMAT_R32_FLOAT:				return LAYOUT_R32F;
+	case DXGI_FORMAT_R11G11B10_FLOAT:		return LAYOUT_R11G11B10;
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:	return LAYOUT_RGB9E5;
+
+	default:
+		return LAYOUT_NONE;
+	}
+}
+
+inline float HalfToFloat(uint16_t h)
+{
+	uint32_t sign = uint32_t(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1f;
+	uint32_t mantissa = h & 0x3ff;
+
+	uint32_t bits;
+	if (exponent == 0x1f)
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	else if (exponent)
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	else
+	{
+		//Zero and denormals, mantissa * 2^-24
+		float f = mantissa * (1.0f / 16777216.0f);
+		return sign ? -f : f;
+	}
+
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+//Round to nearest even. Values past 65504 become infinity and NaN stays
+//NaN.
+inline uint16_t FloatToHalf(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+
+	uint16_t sign = uint16_t((x >> 16) & 0x8000);
+	x &= 0x7fffffff;
+
+	//Inf and NaN
+	if (x >= 0x7f800000)
+		return sign | (x > 0x7f800000 ? 0x7e00 : 0x7c00);
+
+	//Rounds up past 65504
+	if (x >= 0x477ff000)
+		return sign | 0x7c00;
+
+	if (x < 0x38800000)
+	{
+		if (x < 0x33000000)
+			return sign;
+
+		uint32_t mantissa = (x & 0x7fffff) | 0x800000;
+		uint32_t shift = 126 - (x >> 23);
+		uint32_t h = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t half = 1u << (shift - 1);
+		if (rest > half || (rest == half && (h & 1)))
+			++h;
+		return sign | uint16_t(h);
+	}
+
+	uint32_t h = (x - 0x38000000) >> 13;
+	uint32_t rest = x & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+		++h;
+	return sign | uint16_t(h);
+}
+
+#endif
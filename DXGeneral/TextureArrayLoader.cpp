@@ -0,0 +1,66 @@
+#include "TextureArrayLoader.h"
+#include "DDSTextureLoader.h"
+#include "MappedFile.h"
+#include<algorithm>
+
+//Maps and parses every file on the job system, packs them, then hands the
+//result to the DDS loader as one file image
+static ID3D11ShaderResourceView* CreatePackedSRV(ID3D11Device* device,
+	const std::vector<std::wstring>& filenames,
+	bool atlas,
+	const TexturePacker::Options& options,
+	std::vector<TexturePacker::Region>& regions)
+{
+	std::vector<MappedFile> files(filenames.size());
+	std::vector<TexturePacker::Source> sources(filenames.size());
+	std::vector<char> parsed(filenames.size());
+	JobSystem::Default().ParallelFor(static_cast<UINT>(filenames.size()), 1, [&](UINT begin, UINT end, UINT)
+	{
+		for (UINT i = begin; i < end; ++i)
+		{
+			parsed[i] = files[i].Open(filenames[i].c_str())
+				&& SUCCEEDED(DirectX::ParseDDS(files[i].Data(), files[i].Size(), sources[i].Info, sources[i].Subresources));
+		}
+	});
+
+	if (std::find(parsed.begin(), parsed.end(), 0) != parsed.end())
+		return 0;
+
+	DirectX::DDSTextureInfo info;
+	std::vector<DirectX::DDSSubresource> subresources;
+	std::vector<uint8_t> data;
+	TexturePacker packer;
+	bool packed = atlas
+		? packer.BuildAtlas(sources, options, info, subresources, data, regions)
+		: packer.BuildArray(sources, options, info, subresources, data, regions);
+	if (!packed)
+		return 0;
+
+	std::vector<uint8_t> ddsData;
+	if (FAILED(DirectX::WriteDDS(info, subresources, ddsData)))
+		return 0;
+
+	//Without DDS_LOADER_GENERATE_MIPS, single level pages stay single level
+	ID3D11ShaderResourceView* srv = 0;
+	if (FAILED(DirectX::CreateDDSTextureFromMemory(device, ddsData.data(), ddsData.size(), 0, &srv)))
+		return 0;
+
+	return srv;
+}
+
+ID3D11ShaderResourceView* TextureArrayLoader::CreateTexture2DArraySRV(
+	ID3D11Device* device,
+	const std::vector<std::wstring>& filenames)
+{
+	std::vector<TexturePacker::Region> regions;
+	return CreatePackedSRV(device, filenames, false, TexturePacker::Options(), regions);
+}
+
+ID3D11ShaderResourceView* TextureArrayLoader::CreateTextureAtlasSRV(
+	ID3D11Device* device,
+	const std::vector<std::wstring>& filenames,
+	std::vector<TexturePacker::Region>& regions,
+	const TexturePacker::Options& options)
+{
+	return CreatePackedSRV(device, filenames, true, options, regions);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+//Texture arrays and atlases built from DDS files at load time, instead of
+//with texassemble offline
+//
+//The files are mapped and parsed on the job system, packed by TexturePacker
+//and created through the DDS loader as one file image. Each texture keeps
+//the levels of its file; the loader filters nothing, as a chain generated
+//for a whole atlas page would blend neighbouring textures.
+//
+//Kept out of d3dUtil so only the projects that pack textures compile
+//TexturePacker.
+
+#ifndef _TEXTUREARRAYLOADER_H_
+#define _TEXTUREARRAYLOADER_H_
+
+#include "d3dUtil.h"
+#include "TexturePacker.h"
+
+class TextureArrayLoader
+{
+public:
+	//DDS files of one format and size as the slices of one texture array.
+	//Returns 0 on failure.
+	static ID3D11ShaderResourceView* CreateTexture2DArraySRV(
+		ID3D11Device* device,
+		const std::vector<std::wstring>& filenames);
+
+	//DDS files of one format packed into atlas pages; a Texture2D for one
+	//page, an array for more. regions gets the uv remap of every file.
+	static ID3D11ShaderResourceView* CreateTextureAtlasSRV(
+		ID3D11Device* device,
+		const std::vector<std::wstring>& filenames,
+		std::vector<TexturePacker::Region>& regions,
+		const TexturePacker::Options& options = TexturePacker::Options());
+};
+
+#endif
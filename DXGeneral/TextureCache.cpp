@@ -0,0 +1,419 @@
+#include"TextureCache.h"
+#include"DDSParser.h"
+#include"DDSTextureLoader.h"
+#include<algorithm>
+#include<cstring>
+#include<cwctype>
+
+TextureCache::TextureCache()
+	:m_device(0), m_budget(0), m_residentBytes(0),
+	m_pathHits(0), m_contentHits(0), m_loads(0), m_evictions(0), m_bytesRead(0)
+{
+}
+
+TextureCache::~TextureCache()
+{
+	//Whatever is still held dies with the cache
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		ReleaseCOM(m_textures[i].View);
+	}
+}
+
+void TextureCache::Init(ID3D11Device* device, size_t budgetBytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_device = device;
+	m_budget = budgetBytes;
+}
+
+void TextureCache::SetBudget(size_t budgetBytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_budget = budgetBytes;
+	Trim();
+}
+
+TextureCache::TextureHandle TextureCache::Acquire(const std::wstring& fileName)
+{
+	if (!m_device)
+		return 0;
+
+	std::wstring path = CanonicalPath(fileName);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		TextureHandle texture = HitPath(path);
+		if (texture)
+			return texture;
+	}
+
+	MappedFile file;
+	if (!file.Open(path.c_str()))
+		return 0;
+
+	ContentKey key = { HashContents(file.Data(), file.Size()), file.Size() };
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_bytesRead += file.Size();
+
+		//Another thread may have loaded it meanwhile
+		TextureHandle texture = Share(path, key, file, lock);
+		if (texture)
+			return texture;
+	}
+
+	ID3D11Resource* resource = 0;
+	ID3D11ShaderResourceView* view = 0;
+	HRESULT hr = DirectX::CreateDDSTextureFromMemory(m_device, file.Data(), file.Size(), &resource, &view);
+	if (FAILED(hr))
+		return 0;
+
+	size_t bytes = ResourceBytes(resource);
+	ReleaseCOM(resource);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	//Lost a race against a load of the same file or contents, keep the first one
+	TextureHandle shared = Share(path, key, file, lock);
+	if (shared)
+	{
+		ReleaseCOM(view);
+		return shared;
+	}
+
+	TextureHandle handle;
+	if (!m_free.empty())
+	{
+		handle = m_free.back();
+		m_free.pop_back();
+	}
+	else
+	{
+		m_textures.push_back(Texture());
+		handle = static_cast<TextureHandle>(m_textures.size());
+	}
+
+	Texture& t = *Find(handle);
+	t.IsLoaded = true;
+	t.References = 1;
+	t.Key = key;
+	t.Paths.assign(1, path);
+	t.View = view;
+	t.Bytes = bytes;
+	t.Unused = m_unused.end();
+
+	m_byPath[path] = handle;
+	m_byContent.insert(std::make_pair(key, handle));
+	m_residentBytes += bytes;
+	++m_loads;
+
+	Trim();
+	return handle;
+}
+
+void TextureCache::AddRef(TextureHandle texture)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Texture* t = Find(texture);
+	if (t && t->IsLoaded && t->References)
+		++t->References;
+}
+
+void TextureCache::Release(TextureHandle texture)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Texture* t = Find(texture);
+	if (!t || !t->IsLoaded || !t->References)
+		return;
+
+	if (--t->References == 0)
+	{
+		t->Unused = m_unused.insert(m_unused.end(), texture);
+		Trim();
+	}
+}
+
+ID3D11ShaderResourceView* TextureCache::GetView(TextureHandle texture) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const Texture* t = Find(texture);
+	return (t && t->IsLoaded) ? t->View : 0;
+}
+
+size_t TextureCache::GetSize(TextureHandle texture) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const Texture* t = Find(texture);
+	return (t && t->IsLoaded) ? t->Bytes : 0;
+}
+
+void TextureCache::GetStats(Stats& stats) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	stats.BudgetBytes = m_budget;
+	stats.ResidentBytes = m_residentBytes;
+	stats.TextureCount = 0;
+	stats.ReferencedCount = 0;
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		if (m_textures[i].IsLoaded)
+		{
+			++stats.TextureCount;
+			if (m_textures[i].References)
+				++stats.ReferencedCount;
+		}
+	}
+
+	stats.PathHits = m_pathHits;
+	stats.ContentHits = m_contentHits;
+	stats.Loads = m_loads;
+	stats.Evictions = m_evictions;
+	stats.BytesRead = m_bytesRead;
+}
+
+void TextureCache::Flush()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	while (!m_unused.empty())
+	{
+		Evict(m_unused.front());
+	}
+}
+
+std::wstring TextureCache::CanonicalPath(const std::wstring& fileName)
+{
+	std::wstring path = fileName;
+
+	wchar_t buffer[MAX_PATH];
+	DWORD length = GetFullPathNameW(fileName.c_str(), MAX_PATH, buffer, 0);
+	if (length && length < MAX_PATH)
+		path.assign(buffer, length);
+
+	for (size_t i = 0; i < path.size(); ++i)
+	{
+		path[i] = (path[i] == L'/') ? L'\\' : static_cast<wchar_t>(towlower(path[i]));
+	}
+	return path;
+}
+
+UINT64 TextureCache::HashContents(const uint8_t* data, size_t size)
+{
+	//Eight bytes a step, multiply and rotate, then a final avalanche
+	const UINT64 prime0 = 0x9e3779b97f4a7c15ull;
+	const UINT64 prime1 = 0xff51afd7ed558ccdull;
+
+	UINT64 h = static_cast<UINT64>(size) * prime0;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		UINT64 v;
+		memcpy(&v, data + i, sizeof(v));
+		h ^= v * prime1;
+		h = ((h << 31) | (h >> 33)) * prime0;
+	}
+
+	if (i < size)
+	{
+		UINT64 v = 0;
+		memcpy(&v, data + i, size - i);
+		h ^= v * prime1;
+		h = ((h << 31) | (h >> 33)) * prime0;
+	}
+
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+size_t TextureCache::ResourceBytes(ID3D11Resource* resource)
+{
+	D3D11_RESOURCE_DIMENSION dimension;
+	resource->GetType(&dimension);
+
+	size_t width = 1;
+	size_t height = 1;
+	size_t depth = 1;
+	UINT mips = 1;
+	UINT slices = 1;
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+
+	switch (dimension)
+	{
+	case D3D11_RESOURCE_DIMENSION_TEXTURE1D:
+	{
+		D3D11_TEXTURE1D_DESC desc;
+		static_cast<ID3D11Texture1D*>(resource)->GetDesc(&desc);
+		width = desc.Width;
+		mips = desc.MipLevels;
+		slices = desc.ArraySize;
+		format = desc.Format;
+		break;
+	}
+
+	case D3D11_RESOURCE_DIMENSION_TEXTURE2D:
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+		width = desc.Width;
+		height = desc.Height;
+		mips = desc.MipLevels;
+		slices = desc.ArraySize;
+		format = desc.Format;
+		break;
+	}
+
+	case D3D11_RESOURCE_DIMENSION_TEXTURE3D:
+	{
+		D3D11_TEXTURE3D_DESC desc;
+		static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc);
+		width = desc.Width;
+		height = desc.Height;
+		depth = desc.Depth;
+		mips = desc.MipLevels;
+		format = desc.Format;
+		break;
+	}
+
+	default:
+		return 0;
+	}
+
+	size_t total = 0;
+	for (UINT mip = 0; mip < mips; ++mip)
+	{
+		size_t bytes, rowBytes, rows;
+		DirectX::GetSurfaceInfo(width, height, format, &bytes, &rowBytes, &rows);
+		total += bytes*depth*slices;
+
+		width = std::max<size_t>(width >> 1, 1);
+		height = std::max<size_t>(height >> 1, 1);
+		depth = std::max<size_t>(depth >> 1, 1);
+	}
+	return total;
+}
+
+TextureCache::TextureHandle TextureCache::Hit(TextureHandle texture)
+{
+	Texture* t = Find(texture);
+	if (t->References++ == 0)
+	{
+		m_unused.erase(t->Unused);
+		t->Unused = m_unused.end();
+	}
+	return texture;
+}
+
+TextureCache::TextureHandle TextureCache::HitPath(const std::wstring& path)
+{
+	auto found = m_byPath.find(path);
+	if (found == m_byPath.end())
+		return 0;
+
+	++m_pathHits;
+	return Hit(found->second);
+}
+
+TextureCache::TextureHandle TextureCache::Share(const std::wstring& path, const ContentKey& key,
+	const MappedFile& file, std::unique_lock<std::mutex>& lock)
+{
+	for (;;)
+	{
+		TextureHandle texture = HitPath(path);
+		if (texture)
+			return texture;
+
+		//One file of every texture that may hold the same contents
+		std::vector<std::pair<TextureHandle, std::wstring> > candidates;
+		auto range = m_byContent.equal_range(key);
+		for (auto i = range.first; i != range.second; ++i)
+		{
+			candidates.push_back(std::make_pair(i->second, Find(i->second)->Paths[0]));
+		}
+		if (candidates.empty())
+			return 0;
+
+		lock.unlock();
+		size_t match = 0;
+		while (match < candidates.size() && !SameContents(file, candidates[match].second))
+			++match;
+		lock.lock();
+
+		//The path may have been loaded meanwhile. A texture of the same
+		//contents under another path is loaded again at worst.
+		texture = HitPath(path);
+		if (texture || match == candidates.size())
+			return texture;
+
+		texture = candidates[match].first;
+		Texture* t = Find(texture);
+		if (t->IsLoaded && t->Key == key &&
+			std::find(t->Paths.begin(), t->Paths.end(), candidates[match].second) != t->Paths.end())
+		{
+			t->Paths.push_back(path);
+			m_byPath[path] = texture;
+			++m_contentHits;
+			return Hit(texture);
+		}
+
+		//Evicted while the files were compared, look again
+	}
+}
+
+bool TextureCache::SameContents(const MappedFile& file, const std::wstring& fileName)
+{
+	MappedFile other;
+	return other.Open(fileName.c_str()) && other.Size() == file.Size() &&
+		memcmp(other.Data(), file.Data(), file.Size()) == 0;
+}
+
+void TextureCache::Evict(TextureHandle texture)
+{
+	Texture* t = Find(texture);
+
+	m_unused.erase(t->Unused);
+	t->Unused = m_unused.end();
+
+	for (size_t i = 0; i < t->Paths.size(); ++i)
+	{
+		m_byPath.erase(t->Paths[i]);
+	}
+	auto range = m_byContent.equal_range(t->Key);
+	for (auto i = range.first; i != range.second; ++i)
+	{
+		if (i->second == texture)
+		{
+			m_byContent.erase(i);
+			break;
+		}
+	}
+
+	ReleaseCOM(t->View);
+	m_residentBytes -= t->Bytes;
+
+	t->IsLoaded = false;
+	t->Bytes = 0;
+	std::vector<std::wstring>().swap(t->Paths);
+
+	m_free.push_back(texture);
+	++m_evictions;
+}
+
+void TextureCache::Trim()
+{
+	while (m_residentBytes > m_budget && !m_unused.empty())
+	{
+		Evict(m_unused.front());
+	}
+}
+
+TextureCache::Texture* TextureCache::Find(TextureHandle texture)
+{
+	return (texture > 0 && texture <= m_textures.size()) ? &m_textures[texture - 1] : 0;
+}
+
+const TextureCache::Texture* TextureCache::Find(TextureHandle texture) const
+{
+	return (texture > 0 && texture <= m_textures.size()) ? &m_textures[texture - 1] : 0;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+//Shared DDS textures, loaded once however many objects use them
+//
+//Acquire() looks a file up by its canonical path first, which costs no I/O
+//at all. A path seen for the first time is mapped and hashed. When its size
+//and hash match a texture already loaded under another name, the two files
+//are compared byte for byte, and only if they are the same is that texture
+//shared instead of creating a copy. Handles are reference counted;
+//textures nobody holds stay cached for the next Acquire() until the total
+//goes over budget, then the least recently released ones go first.
+//Textures in use are never evicted, even over budget.
+//
+//All calls are safe from any thread. Files are read and textures created
+//outside the lock, ID3D11Device being free threaded.
+
+#ifndef _TEXTURECACHE_H_
+#define _TEXTURECACHE_H_
+
+#include "d3dUtil.h"
+#include "MappedFile.h"
+
+#include<deque>
+#include<list>
+#include<mutex>
+#include<unordered_map>
+
+class TextureCache
+{
+public:
+	//0 is never a valid handle
+	typedef UINT TextureHandle;
+
+	struct Stats
+	{
+		size_t BudgetBytes;
+		size_t ResidentBytes;
+
+		UINT TextureCount;
+		UINT ReferencedCount;
+
+		//Acquire() calls served by path, by contents, and from the file
+		UINT PathHits;
+		UINT ContentHits;
+		UINT Loads;
+
+		UINT Evictions;
+		UINT64 BytesRead;
+	};
+
+public:
+	TextureCache();
+	~TextureCache();
+
+	void Init(ID3D11Device* device, size_t budgetBytes);
+	void SetBudget(size_t budgetBytes);
+
+	//Returns a handle holding one reference, 0 on failure
+	TextureHandle Acquire(const std::wstring& fileName);
+
+	//One more reference to a texture already held
+	void AddRef(TextureHandle texture);
+
+	//Once the last reference is gone the texture may be evicted, the
+	//handle must not be used any more
+	void Release(TextureHandle texture);
+
+	ID3D11ShaderResourceView* GetView(TextureHandle texture) const;
+	size_t GetSize(TextureHandle texture) const;
+	void GetStats(Stats& stats) const;
+
+	//Evicts every texture nobody holds
+	void Flush();
+
+	//Full path, lower case, backslashes: one key per file on NTFS
+	static std::wstring CanonicalPath(const std::wstring& fileName);
+
+	static UINT64 HashContents(const uint8_t* data, size_t size);
+
+	//Video memory of every mip and slice of a texture
+	static size_t ResourceBytes(ID3D11Resource* resource);
+
+private:
+	struct ContentKey
+	{
+		UINT64 Hash;
+		size_t Size;
+
+		bool operator==(const ContentKey& other) const { return Hash == other.Hash && Size == other.Size; }
+	};
+
+	struct ContentKeyHash
+	{
+		size_t operator()(const ContentKey& key) const { return static_cast<size_t>(key.Hash); }
+	};
+
+	struct Texture
+	{
+		bool IsLoaded;
+		UINT References;
+
+		ContentKey Key;
+
+		//Every canonical path that led here
+		std::vector<std::wstring> Paths;
+
+		ID3D11ShaderResourceView* View;
+		size_t Bytes;
+
+		//Place in m_unused while nobody holds the texture
+		std::list<TextureHandle>::iterator Unused;
+	};
+
+	TextureHandle Hit(TextureHandle texture);
+	TextureHandle HitPath(const std::wstring& path);
+
+	//A texture loaded under path or from the same contents, with one more
+	//reference, 0 if there is none. Unlocks while files are compared.
+	TextureHandle Share(const std::wstring& path, const ContentKey& key, const MappedFile& file,
+		std::unique_lock<std::mutex>& lock);
+
+	static bool SameContents(const MappedFile& file, const std::wstring& fileName);
+
+	void Evict(TextureHandle texture);
+	void Trim();
+
+	Texture* Find(TextureHandle texture);
+	const Texture* Find(TextureHandle texture) const;
+
+private:
+	ID3D11Device* m_device;
+	size_t m_budget;
+
+	mutable std::mutex m_mutex;
+
+	//deque keeps the records in place, evicted ones are reused
+	std::deque<Texture> m_textures;
+	std::vector<TextureHandle> m_free;
+
+	std::unordered_map<std::wstring, TextureHandle> m_byPath;
+	//Files of one size and hash may still differ, each gets its texture
+	std::unordered_multimap<ContentKey, TextureHandle, ContentKeyHash> m_byContent;
+
+	//Loaded textures without references, least recently released first
+	std::list<TextureHandle> m_unused;
+
+	size_t m_residentBytes;
+	UINT m_pathHits;
+	UINT m_contentHits;
+	UINT m_loads;
+	UINT m_evictions;
+	UINT64 m_bytesRead;
+};
+
+#endif
@@ -0,0 +1,460 @@
+#include"TexturePacker.h"
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	//Largest texture side and array of feature level 11
+	const UINT MAX_TEXTURE_SIZE = 16384;
+	const UINT MAX_ARRAY_SIZE = 2048;
+
+	UINT FloorPowerOfTwo(UINT x)
+	{
+		UINT p = 1;
+		while (p <= x / 2)
+			p <<= 1;
+		return p;
+	}
+
+	UINT CeilPowerOfTwo(UINT x)
+	{
+		UINT p = 1;
+		while (p < x)
+			p <<= 1;
+		return p;
+	}
+}
+
+TexturePacker::Options::Options()
+	:MaxSize(4096), Padding(8), MipLevels(0)
+{
+}
+
+TexturePacker::TexturePacker(JobSystem& jobs)
+	:m_jobs(jobs)
+{
+}
+
+TexturePacker::Skyline::Skyline(UINT width, UINT height)
+	:m_width(width), m_height(height)
+{
+	Segment floor = { 0, 0, width };
+	m_segments.push_back(floor);
+}
+
+bool TexturePacker::Skyline::Fit(size_t index, UINT width, UINT height, UINT& y) const
+{
+	UINT x = m_segments[index].X;
+	if (x + width > m_width)
+		return false;
+
+	//Rests on the highest segment it spans
+	y = 0;
+	UINT left = width;
+	for (size_t i = index; left; ++i)
+	{
+		y = std::max(y, m_segments[i].Y);
+		if (y + height > m_height)
+			return false;
+		left -= std::min(left, m_segments[i].Width);
+	}
+	return true;
+}
+
+bool TexturePacker::Skyline::Insert(UINT width, UINT height, UINT& x, UINT& y)
+{
+	//Bottom-left: lowest top edge, then leftmost
+	size_t best = m_segments.size();
+	UINT bestTop = UINT(-1);
+	UINT bestY = 0;
+	for (size_t i = 0; i < m_segments.size(); ++i)
+	{
+		UINT top;
+		if (Fit(i, width, height, top) && top + height < bestTop)
+		{
+			best = i;
+			bestTop = top + height;
+			bestY = top;
+		}
+	}
+
+	if (best == m_segments.size())
+		return false;
+
+	x = m_segments[best].X;
+	y = bestY;
+
+	//The new segment covers [x, x + width), shorten or drop what it hides
+	Segment placed = { x, bestTop, width };
+	size_t i = best;
+	while (i < m_segments.size() && m_segments[i].X < x + width)
+	{
+		Segment& s = m_segments[i];
+		UINT end = s.X + s.Width;
+		if (end <= x + width)
+		{
+			m_segments.erase(m_segments.begin() + i);
+		}
+		else
+		{
+			s.Width = end - (x + width);
+			s.X = x + width;
+			break;
+		}
+	}
+	m_segments.insert(m_segments.begin() + best, placed);
+
+	//Neighbours at the same height become one
+	for (size_t j = 1; j < m_segments.size();)
+	{
+		if (m_segments[j - 1].Y == m_segments[j].Y)
+		{
+			m_segments[j - 1].Width += m_segments[j].Width;
+			m_segments.erase(m_segments.begin() + j);
+		}
+		else
+		{
+			++j;
+		}
+	}
+	return true;
+}
+
+bool TexturePacker::CheckSources(const std::vector<Source>& sources, UINT& unitTexels, size_t& unitBytes)
+{
+	if (sources.empty())
+		return false;
+
+	const DXGI_FORMAT format = sources[0].Info.format;
+	if (IsCompressed(format))
+	{
+		size_t rowBytes, rows;
+		unitTexels = 4;
+		GetSurfaceInfo(4, 4, format, &unitBytes, &rowBytes, &rows);
+	}
+	else
+	{
+		//Packed and planar formats do not split into whole texels
+		size_t bytes, rowBytes, rows;
+		GetSurfaceInfo(1, 1, format, &bytes, &rowBytes, &rows);
+
+		size_t bits = BitsPerPixel(format);
+		if (!bits || bits % 8 || rowBytes * 8 != bits || rows != 1)
+			return false;
+
+		unitTexels = 1;
+		unitBytes = bits / 8;
+	}
+
+	for (const Source& s : sources)
+	{
+		const DDSTextureInfo& info = s.Info;
+		if (info.format != format || info.resourceDimension != DDS_DIMENSION_TEXTURE2D || info.isCubeMap
+			|| info.arraySize != 1 || info.depth != 1 || !info.mipLevels
+			|| !info.width || !info.height || info.width % unitTexels || info.height % unitTexels
+			|| s.Subresources.size() != info.mipLevels)
+			return false;
+	}
+	return true;
+}
+
+void TexturePacker::AllocatePages(const DDSTextureInfo& info,
+	std::vector<DDSSubresource>& subresources,
+	std::vector<uint8_t>& data)
+{
+	//Laid out like a DDS body: all levels of slice 0, then slice 1...
+	subresources.resize(info.mipLevels*info.arraySize);
+
+	size_t offset = 0;
+	for (size_t s = 0; s < info.arraySize; ++s)
+	{
+		size_t w = info.width;
+		size_t h = info.height;
+		for (size_t level = 0; level < info.mipLevels; ++level)
+		{
+			size_t bytes, rowBytes, rows;
+			GetSurfaceInfo(w, h, info.format, &bytes, &rowBytes, &rows);
+
+			DDSSubresource& sub = subresources[CalcDDSSubresource(level, s, info.mipLevels)];
+			sub.pData = 0;
+			sub.offset = offset;
+			sub.rowPitch = rowBytes;
+			sub.slicePitch = bytes;
+			sub.width = w;
+			sub.height = h;
+			sub.depth = 1;
+			offset += bytes;
+
+			w = std::max<size_t>(w >> 1, 1);
+			h = std::max<size_t>(h >> 1, 1);
+		}
+	}
+
+	//Space between textures stays zero
+	data.assign(offset, 0);
+	for (DDSSubresource& sub : subresources)
+		sub.pData = &data[sub.offset];
+}
+
+bool TexturePacker::BuildAtlas(const std::vector<Source>& sources,
+	const Options& options,
+	DDSTextureInfo& outInfo,
+	std::vector<DDSSubresource>& outSubresources,
+	std::vector<uint8_t>& outData,
+	std::vector<Region>& outRegions)
+{
+	outSubresources.clear();
+	outData.clear();
+	outRegions.clear();
+
+	UINT unit;
+	size_t unitBytes;
+	if (!CheckSources(sources, unit, unitBytes))
+		return false;
+
+	//Level m of a source lands exactly on level m of the page while its size
+	//stays a multiple of unit << m. Left to choose, stop before the gutter
+	//shrinks below one unit rather than widen it for deeper levels.
+	UINT levels = options.MipLevels;
+	if (!levels)
+	{
+		levels = 1;
+		while (levels < 16 && (!options.Padding || (options.Padding >> levels) >= unit))
+			++levels;
+	}
+	for (const Source& s : sources)
+	{
+		UINT exact = 1;
+		while (exact < levels && exact < s.Info.mipLevels
+			&& s.Info.width % (size_t(unit) << exact) == 0 && s.Info.height % (size_t(unit) << exact) == 0)
+			++exact;
+		levels = std::min(levels, exact);
+	}
+
+	const UINT grid = unit << (levels - 1);
+	const UINT padding = (options.Padding + grid - 1) / grid * grid;
+	const UINT maxSize = FloorPowerOfTwo(std::min(std::max(options.MaxSize, 1u), MAX_TEXTURE_SIZE));
+	if (maxSize < grid)
+		return false;
+
+	//Slots with their gutter, in grid cells
+	const size_t count = sources.size();
+	std::vector<UINT> cellsWide(count);
+	std::vector<UINT> cellsHigh(count);
+	UINT64 area = 0;
+	UINT widest = 0;
+	UINT tallest = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		size_t w = sources[i].Info.width + 2 * padding;
+		size_t h = sources[i].Info.height + 2 * padding;
+		if (w > maxSize || h > maxSize)
+			return false;
+
+		cellsWide[i] = static_cast<UINT>(w / grid);
+		cellsHigh[i] = static_cast<UINT>(h / grid);
+		area += UINT64(w)*h;
+		widest = std::max(widest, static_cast<UINT>(w));
+		tallest = std::max(tallest, static_cast<UINT>(h));
+	}
+
+	//Tallest first, then widest
+	std::vector<UINT> order(count);
+	for (size_t i = 0; i < count; ++i)
+		order[i] = static_cast<UINT>(i);
+	std::sort(order.begin(), order.end(), [&](UINT a, UINT b)
+	{
+		if (cellsHigh[a] != cellsHigh[b])
+			return cellsHigh[a] > cellsHigh[b];
+		if (cellsWide[a] != cellsWide[b])
+			return cellsWide[a] > cellsWide[b];
+		return a < b;
+	});
+
+	std::vector<UINT> cellX(count);
+	std::vector<UINT> cellY(count);
+	std::vector<UINT> page(count, 0);
+
+	//One page as small as possible: start from the total area, then grow
+	//the shorter side until everything fits
+	UINT pageWidth = CeilPowerOfTwo(std::max(widest, static_cast<UINT>(std::sqrt(double(area)))));
+	UINT pageHeight = CeilPowerOfTwo(std::max(tallest, static_cast<UINT>((area + pageWidth - 1) / pageWidth)));
+	UINT pages = 0;
+	while (pageWidth <= maxSize && pageHeight <= maxSize)
+	{
+		Skyline skyline(pageWidth / grid, pageHeight / grid);
+		size_t placed = 0;
+		for (; placed < count; ++placed)
+		{
+			UINT i = order[placed];
+			if (!skyline.Insert(cellsWide[i], cellsHigh[i], cellX[i], cellY[i]))
+				break;
+		}
+
+		if (placed == count)
+		{
+			pages = 1;
+			break;
+		}
+
+		if (pageWidth <= pageHeight)
+			pageWidth *= 2;
+		else
+			pageHeight *= 2;
+	}
+
+	//Otherwise full size pages, each taking whatever still fits
+	if (!pages)
+	{
+		pageWidth = maxSize;
+		pageHeight = maxSize;
+
+		std::vector<UINT> left = order;
+		while (!left.empty())
+		{
+			Skyline skyline(maxSize / grid, maxSize / grid);
+			std::vector<UINT> next;
+			for (UINT i : left)
+			{
+				if (skyline.Insert(cellsWide[i], cellsHigh[i], cellX[i], cellY[i]))
+					page[i] = pages;
+				else
+					next.push_back(i);
+			}
+
+			if (next.size() == left.size() || pages == MAX_ARRAY_SIZE)
+				return false;
+
+			left.swap(next);
+			++pages;
+		}
+	}
+
+	outInfo = sources[0].Info;
+	outInfo.width = pageWidth;
+	outInfo.height = pageHeight;
+	outInfo.depth = 1;
+	outInfo.mipLevels = levels;
+	outInfo.arraySize = pages;
+	outInfo.headerSize = 0;
+	AllocatePages(outInfo, outSubresources, outData);
+
+	outRegions.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Region& r = outRegions[i];
+		r.Page = page[i];
+		r.X = cellX[i] * grid + padding;
+		r.Y = cellY[i] * grid + padding;
+		r.Width = static_cast<UINT>(sources[i].Info.width);
+		r.Height = static_cast<UINT>(sources[i].Info.height);
+		r.ScaleU = float(r.Width) / pageWidth;
+		r.ScaleV = float(r.Height) / pageHeight;
+		r.OffsetU = float(r.X) / pageWidth;
+		r.OffsetV = float(r.Y) / pageHeight;
+	}
+
+	//Slots never overlap, so sources copy independently
+	m_jobs.ParallelFor(static_cast<UINT>(count), 1, [&](UINT begin, UINT end, UINT)
+	{
+		for (UINT i = begin; i < end; ++i)
+		{
+			const Source& s = sources[i];
+			for (UINT level = 0; level < levels; ++level)
+			{
+				const DDSSubresource& src = s.Subresources[level];
+				const DDSSubresource& dst = outSubresources[CalcDDSSubresource(level, page[i], levels)];
+
+				//Everything in units: texels, or blocks when compressed
+				const size_t x = ((cellX[i] * grid) >> level) / unit;
+				const size_t y = ((cellY[i] * grid) >> level) / unit;
+				const size_t pad = (padding >> level) / unit;
+				const size_t wide = (s.Info.width >> level) / unit;
+				const size_t high = (s.Info.height >> level) / unit;
+
+				for (size_t row = 0; row < high + 2 * pad; ++row)
+				{
+					size_t srcRow = std::min(std::max(row, pad) - pad, high - 1);
+					const uint8_t* in = src.pData + srcRow*src.rowPitch;
+					uint8_t* out = const_cast<uint8_t*>(dst.pData) + (y + row)*dst.rowPitch + x*unitBytes;
+
+					for (size_t k = 0; k < pad; ++k)
+						memcpy(out + k*unitBytes, in, unitBytes);
+					memcpy(out + pad*unitBytes, in, wide*unitBytes);
+					for (size_t k = 0; k < pad; ++k)
+						memcpy(out + (pad + wide + k)*unitBytes, in + (wide - 1)*unitBytes, unitBytes);
+				}
+			}
+		}
+	});
+
+	return true;
+}
+
+bool TexturePacker::BuildArray(const std::vector<Source>& sources,
+	const Options& options,
+	DDSTextureInfo& outInfo,
+	std::vector<DDSSubresource>& outSubresources,
+	std::vector<uint8_t>& outData,
+	std::vector<Region>& outRegions)
+{
+	outSubresources.clear();
+	outData.clear();
+	outRegions.clear();
+
+	UINT unit;
+	size_t unitBytes;
+	if (!CheckSources(sources, unit, unitBytes) || sources.size() > MAX_ARRAY_SIZE)
+		return false;
+
+	size_t levels = options.MipLevels ? options.MipLevels : sources[0].Info.mipLevels;
+	for (const Source& s : sources)
+	{
+		if (s.Info.width != sources[0].Info.width || s.Info.height != sources[0].Info.height)
+			return false;
+		levels = std::min(levels, s.Info.mipLevels);
+	}
+
+	const size_t count = sources.size();
+	outInfo = sources[0].Info;
+	outInfo.mipLevels = levels;
+	outInfo.arraySize = count;
+	outInfo.headerSize = 0;
+	AllocatePages(outInfo, outSubresources, outData);
+
+	outRegions.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Region& r = outRegions[i];
+		r.Page = static_cast<UINT>(i);
+		r.X = 0;
+		r.Y = 0;
+		r.Width = static_cast<UINT>(outInfo.width);
+		r.Height = static_cast<UINT>(outInfo.height);
+		r.ScaleU = 1.0f;
+		r.ScaleV = 1.0f;
+		r.OffsetU = 0.0f;
+		r.OffsetV = 0.0f;
+	}
+
+	m_jobs.ParallelFor(static_cast<UINT>(count), 1, [&](UINT begin, UINT end, UINT)
+	{
+		for (UINT i = begin; i < end; ++i)
+		{
+			for (size_t level = 0; level < levels; ++level)
+			{
+				const DDSSubresource& src = sources[i].Subresources[level];
+				const DDSSubresource& dst = outSubresources[CalcDDSSubresource(level, i, levels)];
+
+				size_t rows = dst.slicePitch / dst.rowPitch;
+				for (size_t row = 0; row < rows; ++row)
+					memcpy(const_cast<uint8_t*>(dst.pData) + row*dst.rowPitch, src.pData + row*src.rowPitch, dst.rowPitch);
+			}
+		}
+	});
+
+	return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+//Packs many small textures into few, so a scene binds one view instead of
+//hundreds
+//
+//BuildAtlas() places textures of one format side by side on pages with a
+//skyline bottom-left packer. Pages that fill up spill into the next one;
+//all pages share one size and come out as the slices of a texture array.
+//Every texture keeps its own mips: level m of a source is copied to level m
+//of its page, so nothing is filtered twice and block compressed textures
+//are packed without decoding. To keep that exact, textures are placed on a
+//grid of 2^(mips - 1) texels (times 4 for block compressed formats) and the
+//page gets no more levels than every source can fill at that alignment.
+//The gutter around each texture repeats its edge at every level, so
+//bilinear and trilinear sampling near a border never reads a neighbour.
+//Block compressed gutters repeat whole edge blocks.
+//
+//BuildArray() stacks textures of one format and size into array slices.
+//
+//Both return a Region per source in input order, mapping the texture's own
+//uv into the packed texture: uv * Scale + Offset on slice Page. Wrap and
+//mirror addressing do not work inside an atlas; tile such textures with
+//frac() in the shader or put them in an array.
+//
+//Sources are DDS images as ParseDDS describes them and must outlive the
+//call. The output is laid out like a DDS body, ready for WriteDDS() or
+//CreateDDSTextureFromMemory(), which TextureArrayLoader does for files.
+//Copies are spread over the job system.
+
+#ifndef _TEXTUREPACKER_H_
+#define _TEXTUREPACKER_H_
+
+#include"DDSParser.h"
+#include"JobSystem.h"
+
+class TexturePacker
+{
+public:
+	struct Source
+	{
+		DirectX::DDSTextureInfo Info;
+		std::vector<DirectX::DDSSubresource> Subresources;
+	};
+
+	struct Region
+	{
+		UINT Page;
+
+		//Placement on level 0 in texels, gutter excluded
+		UINT X;
+		UINT Y;
+		UINT Width;
+		UINT Height;
+
+		float ScaleU;
+		float ScaleV;
+		float OffsetU;
+		float OffsetV;
+	};
+
+	struct Options
+	{
+		Options();
+
+		//Largest page side. Pages are powers of two up to this, and all
+		//this size once more than one is needed.
+		UINT MaxSize;
+
+		//Gutter around each texture on level 0, in texels. Rounded up to
+		//the placement grid so every level keeps at least one.
+		UINT Padding;
+
+		//Levels in the result, 0 for as many as the sources and the
+		//padding allow without growing the gutter
+		UINT MipLevels;
+	};
+
+public:
+	TexturePacker(JobSystem& jobs = JobSystem::Default());
+
+	bool BuildAtlas(const std::vector<Source>& sources,
+		const Options& options,
+		DirectX::DDSTextureInfo& outInfo,
+		std::vector<DirectX::DDSSubresource>& outSubresources,
+		std::vector<uint8_t>& outData,
+		std::vector<Region>& outRegions);
+
+	//Options::MaxSize and Padding are ignored
+	bool BuildArray(const std::vector<Source>& sources,
+		const Options& options,
+		DirectX::DDSTextureInfo& outInfo,
+		std::vector<DirectX::DDSSubresource>& outSubresources,
+		std::vector<uint8_t>& outData,
+		std::vector<Region>& outRegions);
+
+private:
+	//Top of the skyline over [X, X + Width)
+	struct Segment
+	{
+		UINT X;
+		UINT Y;
+		UINT Width;
+	};
+
+	//One page being filled, in grid cells
+	class Skyline
+	{
+	public:
+		Skyline(UINT width, UINT height);
+		bool Insert(UINT width, UINT height, UINT& x, UINT& y);
+
+	private:
+		bool Fit(size_t index, UINT width, UINT height, UINT& y) const;
+
+		UINT m_width;
+		UINT m_height;
+		std::vector<Segment> m_segments;
+	};
+
+	//Same format, plain 2D, one slice, a format copied in whole units
+	static bool CheckSources(const std::vector<Source>& sources, UINT& unitTexels, size_t& unitBytes);
+
+	static void AllocatePages(const DirectX::DDSTextureInfo& info,
+		std::vector<DirectX::DDSSubresource>& subresources,
+		std::vector<uint8_t>& data);
+
+private:
+	JobSystem& m_jobs;
+};
+
+#endif
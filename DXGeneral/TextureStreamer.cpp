@@ -0,0 +1,502 @@
+#include"TextureStreamer.h"
+#include"MappedFile.h"
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+
+using namespace DirectX;
+
+TextureStreamer::TextureStreamer(JobSystem& jobs)
+	:m_jobs(jobs), m_device(0), m_budget(0), m_tailSize(64), m_maxPendingReads(4),
+	m_frame(0), m_residentBytes(0), m_pendingBytes(0), m_pendingReads(0),
+	m_bytesRead(0), m_levelsLoaded(0), m_levelsEvicted(0)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		Close(static_cast<TextureHandle>(i + 1));
+	}
+}
+
+void TextureStreamer::Init(ID3D11Device* device, size_t budgetBytes, UINT tailSize, UINT maxPendingReads)
+{
+	m_device = device;
+	m_budget = budgetBytes;
+	m_tailSize = std::max<UINT>(tailSize, 1);
+	m_maxPendingReads = std::max<UINT>(maxPendingReads, 1);
+}
+
+void TextureStreamer::SetBudget(size_t budgetBytes)
+{
+	m_budget = budgetBytes;
+}
+
+TextureStreamer::TextureHandle TextureStreamer::Open(const std::wstring& fileName)
+{
+	if (!m_device)
+		return 0;
+
+	//Only the pages of the header and the tail are touched
+	MappedFile file;
+	if (!file.Open(fileName.c_str()))
+		return 0;
+
+	const size_t fileSize = file.Size();
+
+	//Magic number, DDS_HEADER and the DX10 extension at most
+	const size_t headerBytes = std::min(fileSize, sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10));
+
+	Texture t;
+	if (FAILED(ParseDDSHeader(file.Data(), headerBytes, t.Info)) ||
+		t.Info.resourceDimension != DDS_DIMENSION_TEXTURE2D ||
+		FAILED(GetDDSSubresources(t.Info, nullptr, fileSize, t.Layout)))
+	{
+		return 0;
+	}
+
+	t.IsOpen = true;
+	t.FileName = fileName;
+	t.MipCount = static_cast<UINT>(t.Info.mipLevels);
+
+	//The tail starts at the first level that fits in tailSize x tailSize
+	t.TailMip = t.MipCount - 1;
+	for (UINT mip = 0; mip < t.MipCount; ++mip)
+	{
+		if (t.Layout[mip].width <= m_tailSize && t.Layout[mip].height <= m_tailSize)
+		{
+			t.TailMip = mip;
+			break;
+		}
+	}
+
+	std::vector<Range> ranges;
+	GetLevelRanges(t, t.TailMip, t.MipCount - 1, &ranges);
+
+	std::vector<uint8_t> tail;
+	if (!ReadRanges(file, ranges, tail))
+		return 0;
+
+	m_bytesRead += tail.size();
+
+	//Slices are back to back in the buffer, each with its tail levels in order
+	UINT levels = t.MipCount - t.TailMip;
+	std::vector<D3D11_SUBRESOURCE_DATA> initData(levels * t.Info.arraySize);
+
+	const uint8_t* src = tail.data();
+	for (size_t item = 0; item < t.Info.arraySize; ++item)
+	{
+		for (UINT mip = t.TailMip; mip < t.MipCount; ++mip)
+		{
+			const DDSSubresource& sub = t.Layout[CalcDDSSubresource(mip, item, t.MipCount)];
+
+			D3D11_SUBRESOURCE_DATA& data = initData[D3D11CalcSubresource(mip - t.TailMip, static_cast<UINT>(item), levels)];
+			data.pSysMem = src;
+			data.SysMemPitch = static_cast<UINT>(sub.rowPitch);
+			data.SysMemSlicePitch = static_cast<UINT>(sub.slicePitch);
+
+			src += sub.slicePitch * sub.depth;
+		}
+	}
+
+	t.Resource = 0;
+	t.View = 0;
+	if (!CreateTexture(t, t.TailMip, initData.data(), &t.Resource, &t.View))
+		return 0;
+
+	t.ResidentMip = t.TailMip;
+	t.ResidentBytes = tail.size();
+	t.RequestedMip = t.TailMip;
+	t.RequestFrame = 0;
+	t.ReadJob = 0;
+	t.LoadingMip = 0;
+	t.LoadingBytes = 0;
+	t.ReadFailed = false;
+	t.Failed = false;
+
+	m_residentBytes += t.ResidentBytes;
+	m_textures.push_back(t);
+
+	return static_cast<TextureHandle>(m_textures.size());
+}
+
+void TextureStreamer::Close(TextureHandle texture)
+{
+	Texture* t = Find(texture);
+	if (!t || !t->IsOpen)
+		return;
+
+	if (t->ReadJob)
+	{
+		m_jobs.Wait(t->ReadJob);
+
+		m_pendingBytes -= t->LoadingBytes;
+		--m_pendingReads;
+	}
+
+	m_residentBytes -= t->ResidentBytes;
+
+	ReleaseCOM(t->View);
+	ReleaseCOM(t->Resource);
+
+	t->IsOpen = false;
+	t->ReadJob = 0;
+	t->ResidentBytes = 0;
+	std::vector<DDSSubresource>().swap(t->Layout);
+	std::vector<uint8_t>().swap(t->Staging);
+}
+
+void TextureStreamer::Request(TextureHandle texture, UINT mip)
+{
+	Texture* t = Find(texture);
+	if (!t || !t->IsOpen)
+		return;
+
+	//Two requests in one frame keep the more detailed one
+	mip = std::min(mip, t->TailMip);
+	t->RequestedMip = (t->RequestFrame == m_frame) ? std::min(t->RequestedMip, mip) : mip;
+	t->RequestFrame = m_frame;
+}
+
+void TextureStreamer::Update(ID3D11DeviceContext* context)
+{
+	//Finished reads
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		Texture& t = m_textures[i];
+		if (!t.ReadJob || !m_jobs.IsDone(t.ReadJob))
+			continue;
+
+		t.ReadJob = 0;
+		m_pendingBytes -= t.LoadingBytes;
+		--m_pendingReads;
+
+		if (t.ReadFailed)
+		{
+			t.Failed = true;
+		}
+		else
+		{
+			m_bytesRead += t.Staging.size();
+
+			if (Rebuild(context, t, t.LoadingMip, t.Staging))
+				++m_levelsLoaded;
+			else
+				t.Failed = true;
+		}
+
+		std::vector<uint8_t>().swap(t.Staging);
+	}
+
+	//Over budget: first levels nobody wants at the moment, then wanted ones
+	//if the budget was lowered below what is requested
+	while (m_residentBytes > m_budget && EvictOne(context, false))
+	{
+	}
+	while (m_residentBytes > m_budget && EvictOne(context, true))
+	{
+	}
+
+	//New reads, furthest from the wanted level first
+	std::vector<Texture*> candidates;
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		Texture& t = m_textures[i];
+		if (t.IsOpen && !t.Failed && !t.ReadJob && WantedMip(t) < t.ResidentMip)
+			candidates.push_back(&t);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [this](const Texture* a, const Texture* b)
+	{
+		return a->ResidentMip - WantedMip(*a) > b->ResidentMip - WantedMip(*b);
+	});
+
+	for (size_t i = 0; i < candidates.size() && m_pendingReads < m_maxPendingReads; ++i)
+	{
+		Texture& t = *candidates[i];
+
+		//Levels nobody wants at the moment make room, otherwise smaller
+		//levels further down may still fit
+		size_t bytes = GetLevelRanges(t, t.ResidentMip - 1, t.ResidentMip - 1, 0);
+		while (m_residentBytes + m_pendingBytes + bytes > m_budget && EvictOne(context, false))
+		{
+		}
+		if (m_residentBytes + m_pendingBytes + bytes > m_budget)
+			continue;
+
+		StartRead(t);
+	}
+
+	++m_frame;
+}
+
+ID3D11ShaderResourceView* TextureStreamer::GetView(TextureHandle texture) const
+{
+	const Texture* t = Find(texture);
+	return (t && t->IsOpen) ? t->View : 0;
+}
+
+UINT TextureStreamer::GetResidentMip(TextureHandle texture) const
+{
+	const Texture* t = Find(texture);
+	return (t && t->IsOpen) ? t->ResidentMip : 0;
+}
+
+UINT TextureStreamer::GetMipCount(TextureHandle texture) const
+{
+	const Texture* t = Find(texture);
+	return (t && t->IsOpen) ? t->MipCount : 0;
+}
+
+void TextureStreamer::GetStats(Stats& stats) const
+{
+	stats.BudgetBytes = m_budget;
+	stats.ResidentBytes = m_residentBytes;
+	stats.PendingBytes = m_pendingBytes;
+	stats.PendingReads = m_pendingReads;
+	stats.BytesRead = m_bytesRead;
+	stats.LevelsLoaded = m_levelsLoaded;
+	stats.LevelsEvicted = m_levelsEvicted;
+
+	stats.TextureCount = 0;
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		if (m_textures[i].IsOpen)
+			++stats.TextureCount;
+	}
+}
+
+UINT TextureStreamer::SelectMip(UINT width, UINT height, float screenWidth, float screenHeight)
+{
+	float ratio = std::max(width / std::max(screenWidth, 1.0f), height / std::max(screenHeight, 1.0f));
+	if (ratio <= 1.0f)
+		return 0;
+
+	return static_cast<UINT>(std::floor(std::log2(ratio)));
+}
+
+//Within a slice the levels are contiguous in the file, so every slice
+//is one range. Returns the total size.
+size_t TextureStreamer::GetLevelRanges(const Texture& t, UINT firstMip, UINT lastMip, std::vector<Range>* ranges) const
+{
+	if (ranges)
+		ranges->clear();
+
+	size_t total = 0;
+	for (size_t item = 0; item < t.Info.arraySize; ++item)
+	{
+		Range range;
+		range.Offset = t.Layout[CalcDDSSubresource(firstMip, item, t.MipCount)].offset;
+		range.Size = 0;
+
+		for (UINT mip = firstMip; mip <= lastMip; ++mip)
+		{
+			const DDSSubresource& sub = t.Layout[CalcDDSSubresource(mip, item, t.MipCount)];
+			range.Size += sub.slicePitch * sub.depth;
+		}
+
+		total += range.Size;
+		if (ranges)
+			ranges->push_back(range);
+	}
+
+	return total;
+}
+
+//Copies the ranges of the mapped file back to back into data. False when
+//the file got shorter than the ranges since it was opened.
+bool TextureStreamer::ReadRanges(const MappedFile& file, const std::vector<Range>& ranges, std::vector<uint8_t>& data)
+{
+	size_t total = 0;
+	for (size_t i = 0; i < ranges.size(); ++i)
+	{
+		if (ranges[i].Offset > file.Size() || ranges[i].Size > file.Size() - ranges[i].Offset)
+			return false;
+
+		total += ranges[i].Size;
+	}
+
+	data.resize(total);
+
+	uint8_t* dest = data.data();
+	for (size_t i = 0; i < ranges.size(); ++i)
+	{
+		memcpy(dest, file.Data() + ranges[i].Offset, ranges[i].Size);
+		dest += ranges[i].Size;
+	}
+
+	return true;
+}
+
+bool TextureStreamer::CreateTexture(const Texture& t, UINT topMip, const D3D11_SUBRESOURCE_DATA* initData,
+	ID3D11Texture2D** texture, ID3D11ShaderResourceView** view) const
+{
+	const DDSSubresource& top = t.Layout[topMip];
+
+	D3D11_TEXTURE2D_DESC desc;
+	desc.Width = static_cast<UINT>(top.width);
+	desc.Height = static_cast<UINT>(top.height);
+	desc.MipLevels = t.MipCount - topMip;
+	desc.ArraySize = static_cast<UINT>(t.Info.arraySize);
+	desc.Format = t.Info.format;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = t.Info.isCubeMap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+	if (FAILED(m_device->CreateTexture2D(&desc, initData, texture)))
+		return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = desc.Format;
+
+	if (t.Info.isCubeMap)
+	{
+		if (desc.ArraySize > 6)
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBEARRAY;
+			srvDesc.TextureCubeArray.MipLevels = desc.MipLevels;
+			srvDesc.TextureCubeArray.NumCubes = desc.ArraySize / 6;
+		}
+		else
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+			srvDesc.TextureCube.MipLevels = desc.MipLevels;
+		}
+	}
+	else if (desc.ArraySize > 1)
+	{
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+		srvDesc.Texture2DArray.ArraySize = desc.ArraySize;
+	}
+	else
+	{
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = desc.MipLevels;
+	}
+
+	if (FAILED(m_device->CreateShaderResourceView(*texture, &srvDesc, view)))
+	{
+		ReleaseCOM((*texture));
+		return false;
+	}
+
+	return true;
+}
+
+//Moves the most detailed resident level to newMip. When growing, levels
+//holds [newMip, ResidentMip) of every slice as read by StartRead.
+bool TextureStreamer::Rebuild(ID3D11DeviceContext* context, Texture& t, UINT newMip, const std::vector<uint8_t>& levels)
+{
+	ID3D11Texture2D* texture = 0;
+	ID3D11ShaderResourceView* view = 0;
+	if (!CreateTexture(t, newMip, 0, &texture, &view))
+		return false;
+
+	UINT newLevels = t.MipCount - newMip;
+	UINT oldLevels = t.MipCount - t.ResidentMip;
+	UINT keptMip = std::max(newMip, t.ResidentMip);
+
+	const uint8_t* src = levels.data();
+	for (UINT item = 0; item < t.Info.arraySize; ++item)
+	{
+		//New levels from the file
+		for (UINT mip = newMip; mip < keptMip; ++mip)
+		{
+			const DDSSubresource& sub = t.Layout[CalcDDSSubresource(mip, item, t.MipCount)];
+
+			context->UpdateSubresource(texture, D3D11CalcSubresource(mip - newMip, item, newLevels), 0,
+				src, static_cast<UINT>(sub.rowPitch), static_cast<UINT>(sub.slicePitch));
+			src += sub.slicePitch * sub.depth;
+		}
+
+		//Kept levels from the old texture
+		for (UINT mip = keptMip; mip < t.MipCount; ++mip)
+		{
+			context->CopySubresourceRegion(texture, D3D11CalcSubresource(mip - newMip, item, newLevels), 0, 0, 0,
+				t.Resource, D3D11CalcSubresource(mip - t.ResidentMip, item, oldLevels), 0);
+		}
+	}
+
+	ReleaseCOM(t.View);
+	ReleaseCOM(t.Resource);
+	t.Resource = texture;
+	t.View = view;
+
+	size_t bytes = GetLevelRanges(t, newMip, t.MipCount - 1, 0);
+	m_residentBytes = m_residentBytes - t.ResidentBytes + bytes;
+	t.ResidentBytes = bytes;
+	t.ResidentMip = newMip;
+
+	return true;
+}
+
+//Reads the next more detailed level of every slice on an I/O worker
+void TextureStreamer::StartRead(Texture& t)
+{
+	std::vector<Range> ranges;
+
+	t.LoadingMip = t.ResidentMip - 1;
+	t.LoadingBytes = GetLevelRanges(t, t.LoadingMip, t.LoadingMip, &ranges);
+	t.ReadFailed = false;
+
+	m_pendingBytes += t.LoadingBytes;
+	++m_pendingReads;
+
+	Texture* target = &t;
+	t.ReadJob = m_jobs.Submit([target, ranges]()
+	{
+		MappedFile file;
+		target->ReadFailed = !file.Open(target->FileName.c_str()) || !ReadRanges(file, ranges, target->Staging);
+	}, JobSystem::PRIORITY_NORMAL, JobSystem::QUEUE_IO);
+}
+
+//Drops the most detailed level of one texture. Without wantedToo only
+//textures holding more than they were asked for are considered; among
+//those the one asked for longest ago goes first.
+bool TextureStreamer::EvictOne(ID3D11DeviceContext* context, bool wantedToo)
+{
+	Texture* victim = 0;
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		Texture& t = m_textures[i];
+		if (!t.IsOpen || t.ReadJob || t.ResidentMip >= t.TailMip)
+			continue;
+
+		if (!wantedToo && t.ResidentMip >= WantedMip(t))
+			continue;
+
+		if (!victim || t.RequestFrame < victim->RequestFrame ||
+			(t.RequestFrame == victim->RequestFrame && t.ResidentBytes > victim->ResidentBytes))
+		{
+			victim = &t;
+		}
+	}
+
+	if (!victim || !Rebuild(context, *victim, victim->ResidentMip + 1, std::vector<uint8_t>()))
+		return false;
+
+	++m_levelsEvicted;
+	return true;
+}
+
+//A texture nobody asked for this frame only needs its tail
+UINT TextureStreamer::WantedMip(const Texture& t) const
+{
+	return (t.RequestFrame == m_frame) ? t.RequestedMip : t.TailMip;
+}
+
+TextureStreamer::Texture* TextureStreamer::Find(TextureHandle texture)
+{
+	return (texture > 0 && texture <= m_textures.size()) ? &m_textures[texture - 1] : 0;
+}
+
+const TextureStreamer::Texture* TextureStreamer::Find(TextureHandle texture) const
+{
+	return (texture > 0 && texture <= m_textures.size()) ? &m_textures[texture - 1] : 0;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+//Mip-tail streaming of DDS textures under a global memory budget
+//
+//Open() reads only the DDS header and the mip tail (the levels no larger
+//than tailSize texels), so startup time and memory no longer grow with the
+//resolution of the texture set. Each frame the caller says which level it
+//would like per texture; Update() then copies missing levels one at a time
+//out of a mapping of the file on the I/O workers, uploads them, and takes
+//levels away from the textures nobody asked for when the resident total is
+//over budget or a wanted level does not fit.
+//
+//A texture only ever holds its resident levels. Growing or shrinking it
+//creates a texture of the new size and copies the kept levels across on the
+//GPU, so GetView() may return a different view after Update(). Only 2D
+//textures (arrays and cubes included) are streamed. All calls are meant for
+//the thread that owns the immediate context.
+
+#ifndef _TEXTURESTREAMER_H_
+#define _TEXTURESTREAMER_H_
+
+#include "d3dUtil.h"
+#include "DDSParser.h"
+#include "JobSystem.h"
+
+#include<deque>
+
+class MappedFile;
+
+class TextureStreamer
+{
+public:
+	//0 is never a valid handle
+	typedef UINT TextureHandle;
+
+	struct Stats
+	{
+		size_t BudgetBytes;
+		size_t ResidentBytes;
+
+		//Levels being read right now
+		size_t PendingBytes;
+		UINT PendingReads;
+
+		UINT TextureCount;
+		UINT64 BytesRead;
+		UINT LevelsLoaded;
+		UINT LevelsEvicted;
+	};
+
+public:
+	TextureStreamer(JobSystem& jobs = JobSystem::Default());
+	~TextureStreamer();
+
+	void Init(ID3D11Device* device, size_t budgetBytes, UINT tailSize = 64, UINT maxPendingReads = 4);
+	void SetBudget(size_t budgetBytes);
+
+	//Blocks, but only for the header and the tail. Returns 0 on failure.
+	TextureHandle Open(const std::wstring& fileName);
+	void Close(TextureHandle texture);
+
+	//Most detailed level wanted this frame, 0 for full resolution. Textures
+	//that were not asked for since the last Update() lose their levels first.
+	void Request(TextureHandle texture, UINT mip);
+
+	//Uploads finished reads, evicts down to the budget and starts new reads
+	void Update(ID3D11DeviceContext* context);
+
+	ID3D11ShaderResourceView* GetView(TextureHandle texture) const;
+	UINT GetResidentMip(TextureHandle texture) const;
+	UINT GetMipCount(TextureHandle texture) const;
+	void GetStats(Stats& stats) const;
+
+	//Level whose texel density matches a footprint of screenWidth x
+	//screenHeight pixels, for Request()
+	static UINT SelectMip(UINT width, UINT height, float screenWidth, float screenHeight);
+
+private:
+	struct Texture
+	{
+		bool IsOpen;
+		std::wstring FileName;
+
+		DirectX::DDSTextureInfo Info;
+
+		//File offsets of every level, nothing in memory
+		std::vector<DirectX::DDSSubresource> Layout;
+
+		UINT MipCount;
+		UINT TailMip;
+		UINT ResidentMip;
+		size_t ResidentBytes;
+
+		UINT RequestedMip;
+		UINT64 RequestFrame;
+
+		ID3D11Texture2D* Resource;
+		ID3D11ShaderResourceView* View;
+
+		//Pending read of level LoadingMip of every slice
+		JobSystem::JobHandle ReadJob;
+		UINT LoadingMip;
+		size_t LoadingBytes;
+		std::vector<uint8_t> Staging;
+		bool ReadFailed;
+
+		//Set after a failed read, the texture keeps what it has
+		bool Failed;
+	};
+
+	struct Range
+	{
+		size_t Offset;
+		size_t Size;
+	};
+
+	size_t GetLevelRanges(const Texture& t, UINT firstMip, UINT lastMip, std::vector<Range>* ranges) const;
+	static bool ReadRanges(const MappedFile& file, const std::vector<Range>& ranges, std::vector<uint8_t>& data);
+
+	bool CreateTexture(const Texture& t, UINT topMip, const D3D11_SUBRESOURCE_DATA* initData,
+		ID3D11Texture2D** texture, ID3D11ShaderResourceView** view) const;
+	bool Rebuild(ID3D11DeviceContext* context, Texture& t, UINT newMip, const std::vector<uint8_t>& levels);
+
+	void StartRead(Texture& t);
+	bool EvictOne(ID3D11DeviceContext* context, bool wantedToo);
+
+	UINT WantedMip(const Texture& t) const;
+
+	Texture* Find(TextureHandle texture);
+	const Texture* Find(TextureHandle texture) const;
+
+private:
+	JobSystem& m_jobs;
+	ID3D11Device* m_device;
+
+	size_t m_budget;
+	UINT m_tailSize;
+	UINT m_maxPendingReads;
+
+	//deque keeps the records in place while the reads fill them in
+	std::deque<Texture> m_textures;
+
+	UINT64 m_frame;
+	size_t m_residentBytes;
+	size_t m_pendingBytes;
+	UINT m_pendingReads;
+
+	UINT64 m_bytesRead;
+	UINT m_levelsLoaded;
+	UINT m_levelsEvicted;
+};
+
+#endif
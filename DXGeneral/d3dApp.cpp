@@ -1,7 +1,11 @@
 
 #include"d3dApp.h"
+#include"NullDevice.h"
 #include<Windows.h> //include a set of headers
 #include<sstream>
+#include<chrono>
+#include<float.h>
+#include<stdio.h>
 
 #include<windowsx.h> //useful macros for WIN32 programming
 
@@ -11,6 +15,8 @@ namespace
 	//procedure to our member function window procedure, because we cannot
 	//assign a member function to WNDCLASS::lpfnwndProc
 	D3DApp* gd3dApp = 0;
+
+	const UINT DEFAULT_HEADLESS_FRAMES = 300;
 }
 
 LRESULT CALLBACK
@@ -41,7 +47,14 @@ D3DApp::D3DApp(HINSTANCE hInstance)
 	m_depthStencilBuffer(0),
 	m_renderTargetView(0),
 	m_depthStencilView(0),
-	m_rasterState(0)
+	m_rasterState(0),
+
+	m_headless(false),
+	m_headlessFrames(DEFAULT_HEADLESS_FRAMES),
+	m_nullDevice(0),
+	m_profiler(FrameProfiler::Default()),
+	m_statsFrames(0),
+	m_statsTime(0.0f)
 {
 	ZeroMemory(&m_screenViewport, sizeof(D3D11_VIEWPORT)); //specifies the view port used to display the final frame
 	//relative the the window.
@@ -52,6 +65,33 @@ D3DApp::D3DApp(HINSTANCE hInstance)
 	//Windows messages to the object's window procedure through the 
 	//glocal window procedure
 	gd3dApp = this;
+
+	//"-headless" optionally followed by the frame count
+	const wchar_t* headless = wcsstr(GetCommandLineW(), L"-headless");
+	if (headless)
+	{
+		m_headless = true;
+
+		UINT frames = wcstoul(headless + wcslen(L"-headless"), 0, 10);
+		if (frames)
+			m_headlessFrames = frames;
+	}
+
+	//"-profile" optionally followed by the trace file
+	const wchar_t* profile = wcsstr(GetCommandLineW(), L"-profile");
+	if (profile)
+	{
+		m_profiler.SetEnabled(true);
+
+		const wchar_t* name = profile + wcslen(L"-profile");
+		while (*name == L' ')
+			++name;
+		if (*name != L'-')
+		{
+			while (*name && *name != L' ')
+				m_profileTrace.push_back(static_cast<char>(*name++));
+		}
+	}
 }
 
 D3DApp::~D3DApp()
@@ -95,6 +135,11 @@ float D3DApp::AspectRatio()const
 
 int D3DApp::Run()
 {
+	if (m_headless)
+	{
+		return RunHeadless();
+	}
+
 	MSG msg = { 0 };
 	bool result;
 
@@ -107,6 +152,7 @@ int D3DApp::Run()
 		//if there are window messages then process them
 		if (PeekMessage(&msg, 0, 0, 0, PM_REMOVE))
 		{
+			FrameProfiler::Scope scope("Messages", m_profiler);
 			TranslateMessage(&msg); //keyboard info translation
 			DispatchMessage(&msg); //dispatch to the appropriate window procedure
 		}
@@ -117,9 +163,17 @@ int D3DApp::Run()
 
 			if (!m_appPaused)
 			{
+				m_profiler.BeginFrame();
 				CalculateFrameStats();
-				UpdateScene(m_timer.DeltaTime());
-				result = DrawScene();
+				{
+					FrameProfiler::Scope scope("UpdateScene", m_profiler);
+					UpdateScene(m_timer.DeltaTime());
+				}
+				{
+					FrameProfiler::Scope scope("DrawScene", m_profiler);
+					result = DrawScene();
+				}
+				m_profiler.EndFrame();
 				if (!result)
 				{
 					return -1;
@@ -132,11 +186,18 @@ int D3DApp::Run()
 		}
 	}
 
+	WriteProfile();
+
 	return (int)msg.wParam;
 }
 
 bool D3DApp::Init()
 {
+	if (m_headless)
+	{
+		return InitHeadless();
+	}
+
 	if (!InitMainWindow())
 	{
 		return false;
@@ -559,33 +620,177 @@ bool D3DApp::InitDirect3D()
 	return true;
 }
 
+bool D3DApp::InitHeadless()
+{
+	//No window; the swap chain takes the client size as if there was one
+	HR(NullDevice::Create(m_clientWidth, m_clientHeight, &m_nullDevice, &m_d3dImmediateContext, &m_swapChain));
+	m_d3dDevice = m_nullDevice;
+
+	HR(m_d3dDevice->CheckMultisampleQualityLevels(
+		DXGI_FORMAT_R8G8B8A8_UNORM, 4, &m_4xMsaaQuality
+	));
+
+	OnResize();
+
+	return true;
+}
+
+int D3DApp::RunHeadless()
+{
+	//A GUI process has no console of its own. Output redirected by the
+	//caller is kept, otherwise it goes to the console that started us.
+	HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+	if ((!output || output == INVALID_HANDLE_VALUE) && AttachConsole(ATTACH_PARENT_PROCESS))
+	{
+		FILE* stream = 0;
+		freopen_s(&stream, "CONOUT$", "w", stdout);
+	}
+
+	//Init() of the demo, before the first frame
+	const NullDeviceLog::Counters init = m_nullDevice->Log().Totals;
+	m_nullDevice->ClearLog();
+
+	//A fixed step, so runs are repeatable
+	const float dt = 1.0f / 60.0f;
+
+	double updateTotal = 0.0;
+	double drawTotal = 0.0;
+	double frameMin = DBL_MAX;
+	double frameMax = 0.0;
+	UINT64 draws = 0;
+	UINT64 vertices = 0;
+	UINT64 maps = 0;
+	UINT64 mappedBytes = 0;
+	UINT64 updatedBytes = 0;
+	UINT64 stateCalls = 0;
+
+	m_timer.Reset();
+
+	for (UINT frame = 0; frame < m_headlessFrames; ++frame)
+	{
+		m_timer.Tick();
+
+		m_profiler.BeginFrame();
+		auto start = std::chrono::high_resolution_clock::now();
+		{
+			FrameProfiler::Scope scope("UpdateScene", m_profiler);
+			UpdateScene(dt);
+		}
+		auto updated = std::chrono::high_resolution_clock::now();
+		bool result;
+		{
+			FrameProfiler::Scope scope("DrawScene", m_profiler);
+			result = DrawScene();
+		}
+		auto drawn = std::chrono::high_resolution_clock::now();
+		m_profiler.EndFrame();
+
+		if (!result)
+		{
+			wprintf(L"%ls: DrawScene failed in frame %u\n", m_mainWndCaption.c_str(), frame);
+			return -1;
+		}
+
+		double update = std::chrono::duration<double, std::milli>(updated - start).count();
+		double draw = std::chrono::duration<double, std::milli>(drawn - updated).count();
+		updateTotal += update;
+		drawTotal += draw;
+		frameMin = (std::min)(frameMin, update + draw);
+		frameMax = (std::max)(frameMax, update + draw);
+
+		const NullDeviceLog::Counters& totals = m_nullDevice->Log().Totals;
+		draws += totals.Draws;
+		vertices += totals.Vertices;
+		maps += totals.Maps;
+		mappedBytes += totals.MappedBytes;
+		updatedBytes += totals.UpdatedBytes;
+		stateCalls += totals.StateCalls;
+		m_nullDevice->ClearLog();
+	}
+
+	const double frames = m_headlessFrames;
+
+	FrameProfiler::Summary profile;
+	m_profiler.Summarize(m_headlessFrames, profile);
+
+	std::wostringstream outs;
+	outs.precision(4);
+	outs << m_mainWndCaption << L", headless, " << m_headlessFrames << L" frames\n"
+		<< L"Init: " << init.Buffers << L" buffers (" << init.BufferBytes / 1024 << L" KB), "
+		<< init.Textures << L" textures, " << init.OtherObjects << L" views, shaders and states\n"
+		<< L"UpdateScene: " << updateTotal / frames << L" ms\n"
+		<< L"DrawScene: " << drawTotal / frames << L" ms\n"
+		<< L"Frame: " << (updateTotal + drawTotal) / frames << L" ms, min " << frameMin << L", max " << frameMax
+		<< L", p50 " << profile.P50Milliseconds << L", p95 " << profile.P95Milliseconds
+		<< L", p99 " << profile.P99Milliseconds << L"\n"
+		<< L"Per frame: " << draws / frames << L" draws, " << vertices / frames << L" vertices, "
+		<< stateCalls / frames << L" state calls, " << maps / frames << L" maps ("
+		<< mappedBytes / frames / 1024.0 << L" KB), " << updatedBytes / frames / 1024.0 << L" KB updated"
+		<< L"\nLast frame:" << FrameStatsText() << L"\n";
+
+	//Mean and max per frame of every phase, nested ones included
+	for (size_t p = 0; p < profile.Phases.size(); ++p)
+	{
+		const FrameProfiler::PhaseStats& phase = profile.Phases[p];
+		outs << phase.Name << L": " << phase.MeanMilliseconds << L" ms, max " << phase.MaxMilliseconds
+			<< L", in " << phase.Frames << L" frames\n";
+	}
+
+	fputws(outs.str().c_str(), stdout);
+	fflush(stdout);
+
+	WriteProfile();
+
+	return 0;
+}
+
 void D3DApp::CalculateFrameStats()
 {
 	//Code computes the average frames per second, and also
 	//the average time it takes to render one frame, These stats
 	//are append to the window caption bar
 
-	static int frameCnt = 0;
-	static float timeElapsed = 0.0f;
-
-	frameCnt++;
+	m_statsFrames++;
 
 	//Compute averages over one second period
-	if ((m_timer.TotalTime() - timeElapsed) >= 1.0f)
+	if ((m_timer.TotalTime() - m_statsTime) >= 1.0f)
 	{
-		float fps = (float)frameCnt;  //fps = frameCnt / 1
+		float fps = (float)m_statsFrames;  //fps = frames / 1
 		float mspf = 1000.0f / fps; //milli sec per frame
 
+		//The CPU time of the frames of that second, spikes included
+		FrameProfiler::Summary profile;
+		m_profiler.Summarize(m_statsFrames, profile);
+
 		std::wostringstream outs;
 		outs.precision(6);
 		outs << m_mainWndCaption << L"  "
 			<< L"FPS: " << fps << L"  "
-			<< L"Frame Time: " << mspf << L" (ms)";
+			<< L"Frame Time: " << mspf << L" (ms)"
+			<< L"  p99: " << profile.P99Milliseconds << L" max: " << profile.MaxMilliseconds << L" (ms)"
+			<< FrameStatsText();
 		SetWindowText(m_hMainWnd, outs.str().c_str());
 		
 		//Reset for next average
-		frameCnt = 0;
-		timeElapsed += 1.0f;
+		m_statsFrames = 0;
+		m_statsTime += 1.0f;
+	}
+}
+
+void D3DApp::WriteProfile()
+{
+	if (!m_profiler.Enabled() || m_profileTrace.empty())
+		return;
+
+	bool written = m_profiler.WriteChromeTrace(m_profileTrace.c_str());
+	if (m_headless)
+	{
+		printf(written ? "Trace written to %s\n" : "Could not write the trace to %s\n", m_profileTrace.c_str());
+		fflush(stdout);
+	}
+	else if (!written)
+	{
+		OutputDebugStringA("Could not write the profile trace\n");
 	}
 }
 //
\ No newline at end of file
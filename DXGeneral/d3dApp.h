@@ -7,8 +7,11 @@
 
 #include "d3dUtil.h"
 #include "GameTimer.h"
+#include "FrameProfiler.h"
 #include <string>
 
+class NullDevice;
+
 class D3DApp
 {
 public:
@@ -21,6 +24,15 @@ public:
 
 	int Run();
 
+	//"-headless [frames]" on the command line: no window, a NullDevice
+	//instead of the adapter, and Run() draws that many frames and prints
+	//their timings and device work
+	bool Headless() const { return m_headless; }
+
+	//"-profile [trace.json]" enables the scopes of FrameProfiler::Default(),
+	//the trace is written when Run() returns. Frame times are always kept.
+	bool Profiling() const { return m_profiler.Enabled(); }
+
 	//Framework methods, Derived client classes overrides these methods to
 	//implement specific application requirements
 
@@ -37,8 +49,14 @@ public:
 protected:
 	bool InitMainWindow();
 	bool InitDirect3D();
+	bool InitHeadless();
+	int RunHeadless();
 
 	void CalculateFrameStats();
+	void WriteProfile();
+
+	//Appended to the caption with the frame stats, once a second
+	virtual std::wstring FrameStatsText() const { return std::wstring(); }
 
 protected:
 
@@ -62,6 +80,17 @@ protected:
 
 	ID3D11RasterizerState* m_rasterState;
 
+	bool m_headless;
+	UINT m_headlessFrames;
+	NullDevice* m_nullDevice;	//m_d3dDevice when headless, not counted
+
+	FrameProfiler& m_profiler;
+	std::string m_profileTrace;
+
+	//Frames and start of the current second of CalculateFrameStats
+	UINT m_statsFrames;
+	float m_statsTime;
+
 	//Derived class should set these in derived constructor to customize starting values
 	std::wstring m_mainWndCaption;
 	D3D_DRIVER_TYPE m_d3dDriverType;
@@ -38,16 +38,6 @@ void OutputShaderErrorMessage(ID3D10Blob* errorMessage, HWND hwnd, WCHAR* shader
 	return;
 }
 
-//Use texassemble tool instead to create a texture array offline
-//which would be the preferred process anyway
-
-//ID3D11ShaderResourceView* d3dHelper::CreateTexture2DArraySRV(
-//		ID3D11Device* device, ID3D11DeviceContext* context,
-//		std::vector<std::wstring>& filenames,
-//		DXGI_FORMAT format,
-//		UINT filter, 
-//		UINT mipFilter)
-
 //for chap 20 particel system
 ID3D11ShaderResourceView* D3DHelper::CreateRandomTexture1DSRV(ID3D11Device* device)
 {
@@ -67,9 +57,3 @@ ID3D11ShaderResourceView* D3DHelper::CreateRandomTexture1DSRV(ID3D11Device* devi
 
 	return randomTexSRV;
 }
-
-//for chap19 Terrain rendering
-void ExtractFrustumPlanes(XMFLOAT4 planes[6], CXMMATRIX M)
-{
-
-}
\ No newline at end of file
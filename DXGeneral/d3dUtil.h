@@ -57,14 +57,7 @@ void OutputShaderErrorMessage(ID3D10Blob* errorMessage, HWND hwnd, WCHAR* shader
 //For chapter 11 geometry shader
 class D3DHelper
 {
-
-	//
-	//static ID3D11ShaderResourceView* CreateTexture2DArraySRV(
-	//	ID3D11Device* device, ID3D11DeviceContext* context,
-	//	std::vector<std::wstring>& filenames,
-	//	
-	//)
-
+public:
 	static ID3D11ShaderResourceView* CreateRandomTexture1DSRV(ID3D11Device* device);
 };
 
@@ -91,8 +84,6 @@ public:
 	}
 };
 
-void ExtractFrustumPlanes(XMFLOAT4 planes[6], CXMMATRIX M);
-
 namespace Colors
 { 
 	//const XMVECTOR instances should use the XMVECTORF32 type
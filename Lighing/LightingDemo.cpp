@@ -10,6 +10,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
 	LightingApp theApp(hInstance);
 
+	//"-lights N" adds N small lights to the animated one
+	const char* lights = cmdLine ? strstr(cmdLine, "-lights") : 0;
+	if (lights)
+		theApp.AddLights(static_cast<UINT>(strtoul(lights + strlen("-lights"), 0, 10)));
+
 	if (!theApp.Init())
 		return 0;
 
@@ -22,8 +27,10 @@ LightingApp::LightingApp(HINSTANCE hInstance)
 	m_wavesVB(0), m_wavesIB(0),
 	m_vertexShader(0), m_pixelShader(0),
 	m_inputLayout(0), m_wireframeRS(0),
+	m_bakedVertexShader(0), m_bakedPixelShader(0), m_bakedInputLayout(0),
 	m_theta(1.5f*MathHelper::Pi), m_phi(0.1f*MathHelper::Pi), m_radius(80.0f),
-	m_matrixBuffer(0),
+	m_frameBuffer(0),
+	m_lightingShader(0), m_bakedShader(0), m_landMesh(0), m_wavesMesh(0),
 	//
 	m_eyePosW(0.0f, 0.0f, 0.0f)
 {
@@ -64,6 +71,14 @@ LightingApp::LightingApp(HINSTANCE hInstance)
 	m_spotLight.Spot = 96.0;
 	m_spotLight.Range = 10000.0f;
 
+	//The spot light above stays off, as the scene had it
+	m_pointLights.push_back(m_pointLight);
+
+	ZeroMemory(&m_pointLightBuffer, sizeof(StructuredBuffer));
+	ZeroMemory(&m_spotLightBuffer, sizeof(StructuredBuffer));
+	ZeroMemory(&m_clusterBuffer, sizeof(StructuredBuffer));
+	ZeroMemory(&m_lightIndexBuffer, sizeof(StructuredBuffer));
+
 	//Setup once and never changes
 	m_landMat.Ambient = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
 	m_landMat.Diffuse = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
@@ -89,7 +104,54 @@ LightingApp::~LightingApp()
 	ReleaseCOM(m_vertexShader);
 	ReleaseCOM(m_pixelShader);
 
-	ReleaseCOM(m_matrixBuffer);
+	ReleaseCOM(m_bakedInputLayout);
+	ReleaseCOM(m_bakedVertexShader);
+	ReleaseCOM(m_bakedPixelShader);
+
+	ReleaseCOM(m_frameBuffer);
+	m_objectConstants.Release();
+
+	ReleaseStructuredBuffer(m_pointLightBuffer);
+	ReleaseStructuredBuffer(m_spotLightBuffer);
+	ReleaseStructuredBuffer(m_clusterBuffer);
+	ReleaseStructuredBuffer(m_lightIndexBuffer);
+}
+
+void LightingApp::AddLights(UINT count)
+{
+	for (UINT i = 0; i < count; ++i)
+	{
+		float x = MathHelper::RandF(-80.0f, 80.0f);
+		float z = MathHelper::RandF(-80.0f, 80.0f);
+		XMFLOAT3 position(x, MathHelper::Max(GetHillHeight(x, z), -3.0f) + MathHelper::RandF(2.0f, 6.0f), z);
+		XMFLOAT4 color(MathHelper::RandF(0.1f, 0.4f), MathHelper::RandF(0.1f, 0.4f), MathHelper::RandF(0.1f, 0.4f), 1.0f);
+
+		//Every other light a spot looking down
+		if (i & 1)
+		{
+			SpotLight spot;
+			spot.Ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			spot.Diffuse = color;
+			spot.Specular = color;
+			spot.Position = position;
+			spot.Range = MathHelper::RandF(8.0f, 15.0f);
+			spot.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+			spot.Spot = 8.0f;
+			spot.Att = XMFLOAT3(0.0f, 0.2f, 0.0f);
+			m_spotLights.push_back(spot);
+		}
+		else
+		{
+			PointLight point;
+			point.Ambient = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			point.Diffuse = color;
+			point.Specular = color;
+			point.Position = position;
+			point.Range = MathHelper::RandF(5.0f, 10.0f);
+			point.Att = XMFLOAT3(0.0f, 0.2f, 0.0f);
+			m_pointLights.push_back(point);
+		}
+	}
 }
 
 
@@ -103,12 +165,27 @@ bool LightingApp::Init()
 	BuildLandGeometryBuffers();
 	BuildWaveGeometryBuffers();
 
-	bool result = BuildShader(L"lightingVS.hlsl", L"lightingPS.hlsl");
+	bool result = BuildShader(L"lightingVS.hlsl", L"lightingPS.hlsl", false);
+	if (!result)
+	{
+		return false;
+	}
+
+	result = BuildShader(L"lightingVS.hlsl", L"lightingPS.hlsl", true);
+	if (!result)
+	{
+		return false;
+	}
+
+	//64KB hold 128 frames of the two 256 byte object blocks between wraps
+	result = m_objectConstants.Init(m_d3dDevice, m_d3dImmediateContext, 64 * 1024);
 	if (!result)
 	{
 		return false;
 	}
 
+	BuildRenderBackend();
+
 	D3D11_RASTERIZER_DESC wireframeDesc;
 	ZeroMemory(&wireframeDesc, sizeof(D3D11_RASTERIZER_DESC));
 	wireframeDesc.FillMode = D3D11_FILL_WIREFRAME;
@@ -128,6 +205,8 @@ void LightingApp::OnResize()
 
 	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 	XMStoreFloat4x4(&m_proj, P);
+
+	m_lightClusters.SetProjection(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f, m_clientWidth, m_clientHeight);
 }
 
 void LightingApp::UpdateScene(float dt)
@@ -163,20 +242,26 @@ void LightingApp::UpdateScene(float dt)
 		m_waves.Disturb(i, j, r);
 	}
 
-	m_waves.Update(dt);
+	{
+		PROFILE_SCOPE("Waves update");
+		m_waves.Update(dt);
+	}
 
 	//Update Waves vertex buffer
-	D3D11_MAPPED_SUBRESOURCE mappedData;
-	HR(m_d3dImmediateContext->Map(m_wavesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
-
-	VertexType* v = reinterpret_cast<VertexType*>(mappedData.pData);
-	for (UINT i = 0; i < m_waves.VertexCount(); ++i)
 	{
-		v[i].Pos = m_waves[i];
-		v[i].Normal = m_waves.Normal(i);
-	}
+		PROFILE_SCOPE("Waves buffer");
+		D3D11_MAPPED_SUBRESOURCE mappedData;
+		HR(m_d3dImmediateContext->Map(m_wavesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
 
-	m_d3dImmediateContext->Unmap(m_wavesVB, 0);
+		VertexType* v = reinterpret_cast<VertexType*>(mappedData.pData);
+		for (UINT i = 0; i < m_waves.VertexCount(); ++i)
+		{
+			v[i].Pos = m_waves[i];
+			v[i].Normal = m_waves.Normal(i);
+		}
+
+		m_d3dImmediateContext->Unmap(m_wavesVB, 0);
+	}
 
 	//
 	//Animate the lights
@@ -203,48 +288,48 @@ bool LightingApp::DrawScene()
 	m_d3dImmediateContext->ClearRenderTargetView(m_renderTargetView, reinterpret_cast<const float*>(&Colors::LightSteelBlue));
 	m_d3dImmediateContext->ClearDepthStencilView(m_depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 
-	m_d3dImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-	bool result;
-
-	//Can't use RenderBuffer() here, since the Vertex and Index buffers are different
-
 	XMMATRIX view = XMLoadFloat4x4(&m_view);
 	XMMATRIX proj = XMLoadFloat4x4(&m_proj);
 
-	
-	UINT stride = sizeof(VertexType);
-	UINT offset = 0;
-	
-	/////////////Land
-	XMMATRIX landWorld = XMLoadFloat4x4(&m_landWorld);
-	XMMATRIX landInvTrans = MathHelper::InverseTranspose(landWorld);
+	if (!SetFrameParameters(view, proj))
+		return false;
 
-	m_d3dImmediateContext->IASetVertexBuffers(0, 1, &m_landVB, &stride, &offset);
-	m_d3dImmediateContext->IASetIndexBuffer(m_landIB, DXGI_FORMAT_R32_UINT, 0);
+	if (!SetLightParameters(view))
+		return false;
 
-	SetShaderParameters(landWorld, view, proj, landInvTrans, m_landMat, m_landIndexCount, 0, 0);
+	//All per object constants of the frame in one Map
+	if (!m_objectConstants.Begin(2, sizeof(ObjectBufferType)))
+		return false;
 
-	/////////////Waves
-	XMMATRIX wavesWorld = XMLoadFloat4x4(&m_wavesWorld);
-	XMMATRIX wavesInvTrans = MathHelper::InverseTranspose(wavesWorld);
+	SetObjectParameters(m_objectConstants.Block<ObjectBufferType>(0), XMLoadFloat4x4(&m_landWorld), m_landMat);
+	SetObjectParameters(m_objectConstants.Block<ObjectBufferType>(1), XMLoadFloat4x4(&m_wavesWorld), m_wavesMat);
 
-	m_d3dImmediateContext->IASetVertexBuffers(0, 1, &m_wavesVB, &stride, &offset);
-	m_d3dImmediateContext->IASetIndexBuffer(m_wavesIB, DXGI_FORMAT_R32_UINT, 0);
+	m_objectConstants.End();
 
-	SetShaderParameters(wavesWorld, view, proj, wavesInvTrans, m_wavesMat, 3 * m_waves.TriangleCount(), 0, 0);
+	//The land and the waves have their own buffers and object block
+	m_renderQueue.Clear();
+	AddDraw(m_bakedShader, m_landMesh, 0, m_landIndexCount);
+	AddDraw(m_lightingShader, m_wavesMesh, 1, 3 * m_waves.TriangleCount());
+
+	{
+		PROFILE_SCOPE("Submit");
+		m_renderQueue.Submit(m_renderBackend);
+	}
 
 	
 	//End Scene
 	//Present the back buffer to the screen
-	if (VSYNC_ENABLED)
-	{
-		HR(m_swapChain->Present(1, 0));
-	}
-	else
 	{
-		//Present as fast as possible
-		HR(m_swapChain->Present(0, 0));
+		PROFILE_SCOPE("Present");
+		if (VSYNC_ENABLED)
+		{
+			HR(m_swapChain->Present(1, 0));
+		}
+		else
+		{
+			//Present as fast as possible
+			HR(m_swapChain->Present(0, 0));
+		}
 	}
 
 	return true;
@@ -344,7 +429,9 @@ void LightingApp::BuildLandGeometryBuffers()
 
 	//Extract the vertex elements we are interested and apply the height function
 	//to each vertex
-	std::vector<VertexType> vertices(grid.Vertices.size());
+	std::vector<BakedVertexType> vertices(grid.Vertices.size());
+	LightingModel::SampleSet samples;
+	samples.Resize(static_cast<UINT>(grid.Vertices.size()));
 
 	for (size_t i = 0; i < grid.Vertices.size(); ++i)
 	{
@@ -353,11 +440,25 @@ void LightingApp::BuildLandGeometryBuffers()
 
 		vertices[i].Pos = p;
 		vertices[i].Normal = GetHillNormal(p.x, p.z);
+		samples.Set(static_cast<UINT>(i), vertices[i].Pos, vertices[i].Normal);
+	}
+
+	//The directional light, with the hills shading their own valleys
+	LightingModel::LightSet lights;
+	lights.Directional.push_back(m_dirLight);
+
+	std::vector<XMFLOAT4> colors;
+	m_lightBaker.Bake(m_landMat, lights, samples,
+		[this](float x, float z) { return GetHillHeight(x, z); }, LightBaker::Settings(), colors);
+
+	for (size_t i = 0; i < grid.Vertices.size(); ++i)
+	{
+		vertices[i].Baked = colors[i];
 	}
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(VertexType)*grid.Vertices.size();
+	vbd.ByteWidth = sizeof(BakedVertexType)*grid.Vertices.size();
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -425,15 +526,23 @@ void LightingApp::BuildWaveGeometryBuffers()
 }
 
 
-bool LightingApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
+//baked builds the variant of the shaders that reads the lighting baked into
+//BakedVertexType instead of computing the directional light
+bool LightingApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename, bool baked)
 {
 	HRESULT result;
 	ID3D10Blob* errorMessage;
 	ID3D10Blob* vertexShaderBuffer;
 	ID3D10Blob* pixelShaderBuffer;
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[2]; //input layout structure
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[3]; //input layout structure
 	unsigned int numElements;
-	D3D11_BUFFER_DESC matrixBufferDesc;
+
+	const D3D_SHADER_MACRO bakedMacros[] = { { "BAKED_LIGHTING", "1" }, { NULL, NULL } };
+	const D3D_SHADER_MACRO* macros = baked ? bakedMacros : NULL;
+
+	ID3D11VertexShader*& vertexShader = baked ? m_bakedVertexShader : m_vertexShader;
+	ID3D11PixelShader*& pixelShader = baked ? m_bakedPixelShader : m_pixelShader;
+	ID3D11InputLayout*& inputLayout = baked ? m_bakedInputLayout : m_inputLayout;
 
 	//Initialize the pointers to null
 	errorMessage = 0;
@@ -441,7 +550,7 @@ bool LightingApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
 	pixelShaderBuffer = 0;
 
 	//compile the vertex shader code
-	result = D3DCompileFromFile(vsFilename, NULL, D3D_COMPILE_STANDARD_FILE_INCLUDE, "LightingVertexShader", "vs_5_0", D3DCOMPILE_ENABLE_STRICTNESS|D3DCOMPILE_DEBUG|D3DCOMPILE_SKIP_OPTIMIZATION,
+	result = D3DCompileFromFile(vsFilename, macros, D3D_COMPILE_STANDARD_FILE_INCLUDE, "LightingVertexShader", "vs_5_0", D3DCOMPILE_ENABLE_STRICTNESS|D3DCOMPILE_DEBUG|D3DCOMPILE_SKIP_OPTIMIZATION,
 		0, &vertexShaderBuffer, &errorMessage);
 	if (FAILED(result))
 	{
@@ -459,7 +568,7 @@ bool LightingApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
 	}
 
 	//compile the pixel shader code
-	result = D3DCompileFromFile(psFilename, NULL, D3D_COMPILE_STANDARD_FILE_INCLUDE, "LightingPixelShader", "ps_5_0", D3DCOMPILE_ENABLE_STRICTNESS | D3DCOMPILE_DEBUG|D3DCOMPILE_SKIP_OPTIMIZATION,
+	result = D3DCompileFromFile(psFilename, macros, D3D_COMPILE_STANDARD_FILE_INCLUDE, "LightingPixelShader", "ps_5_0", D3DCOMPILE_ENABLE_STRICTNESS | D3DCOMPILE_DEBUG|D3DCOMPILE_SKIP_OPTIMIZATION,
 		0, &pixelShaderBuffer, &errorMessage);
 	if (FAILED(result))
 	{
@@ -478,7 +587,7 @@ bool LightingApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
 
 	//Create the vertex shader from the buffer
 	result = m_d3dDevice->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(),
-		NULL, &m_vertexShader);
+		NULL, &vertexShader);
 	if (FAILED(result))
 	{
 		return false;
@@ -486,7 +595,7 @@ bool LightingApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
 
 	//Create the pixel shader from the buffer
 	result = m_d3dDevice->CreatePixelShader(pixelShaderBuffer->GetBufferPointer(), pixelShaderBuffer->GetBufferSize(),
-		NULL, &m_pixelShader);
+		NULL, &pixelShader);
 	if (FAILED(result))
 	{
 		return false;
@@ -510,12 +619,20 @@ bool LightingApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
 	polygonLayout[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	polygonLayout[1].InstanceDataStepRate = 0;
 
-	//Get a count of the elements in the layout
-	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
+	polygonLayout[2].SemanticName = "COLOR";
+	polygonLayout[2].SemanticIndex = 0;
+	polygonLayout[2].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	polygonLayout[2].InputSlot = 0;
+	polygonLayout[2].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+	polygonLayout[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	polygonLayout[2].InstanceDataStepRate = 0;
+
+	//Get a count of the elements in the layout, the baked color is last
+	numElements = baked ? 3 : 2;
 
 	//Create the vertex input layout
 	result = m_d3dDevice->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(),
-		vertexShaderBuffer->GetBufferSize(), &m_inputLayout);
+		vertexShaderBuffer->GetBufferSize(), &inputLayout);
 	if (FAILED(result))
 	{
 		return false;
@@ -528,149 +645,211 @@ bool LightingApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
 	pixelShaderBuffer->Release();
 	pixelShaderBuffer = 0;
 
-	//Setup the description of the dynamic matrix constant buffer that is in the vertex shader
-	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
-	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixBufferDesc.MiscFlags = 0;
-	matrixBufferDesc.StructureByteStride = 0;
-
-	//Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class
-	HR(m_d3dDevice->CreateBuffer(&matrixBufferDesc, NULL, &m_matrixBuffer));
-	
+	//Both variants share the constant buffer
+	if (m_frameBuffer)
+		return true;
 
-	//Setup the description of the eye dynamic constant buffer that is in the vertex shader
+	//Setup the description of the per frame dynamic constant buffer, shared by both shaders
 
 	//Note that ByteWidth always needs to be a multiple of 16 if using D3D11_BIND_CONSTANT_BUFFER or
 	//CreateBuffer will fail.
-	D3D11_BUFFER_DESC eyeBufferDesc;
-	eyeBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	eyeBufferDesc.ByteWidth = sizeof(EyeBufferType);
-	eyeBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	eyeBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	eyeBufferDesc.MiscFlags = 0;
-	eyeBufferDesc.StructureByteStride = 0;
+	D3D11_BUFFER_DESC frameBufferDesc;
+	frameBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	frameBufferDesc.ByteWidth = sizeof(FrameBufferType);
+	frameBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	frameBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	frameBufferDesc.MiscFlags = 0;
+	frameBufferDesc.StructureByteStride = 0;
 
-	HR(m_d3dDevice->CreateBuffer(&eyeBufferDesc, 0, &m_eyeBuffer));
-
-	//Setup the description of the light dynamic constant buffer that is in the pixel shader
-	D3D11_BUFFER_DESC lightBufferDesc;
-	lightBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	lightBufferDesc.ByteWidth = sizeof(LightBufferType);
-	lightBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	lightBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	lightBufferDesc.MiscFlags = 0;
-	lightBufferDesc.StructureByteStride = 0;
-
-	HR(m_d3dDevice->CreateBuffer(&lightBufferDesc, 0, &m_lightBuffer));
+	HR(m_d3dDevice->CreateBuffer(&frameBufferDesc, 0, &m_frameBuffer));
 
 
 	return true;
 }
 
-bool LightingApp::SetShaderParameters(XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projectionMatrix,
-	XMMATRIX worldInvTrans, Material material,
-	int indexCount, int indexOffset, int vertexOffset)
+bool LightingApp::SetFrameParameters(XMMATRIX viewMatrix, XMMATRIX projectionMatrix)
 {
-	HRESULT result;
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
-	MatrixBufferType* dataPtr;
-	unsigned int bufferNumber;
-
-	LightBufferType* dataPtr2;
-	EyeBufferType* dataPtr3;
-	
-
-	///////////////////////////
-	//////Transformation Matrix//
-	///////////////////////////
-	//Transpose the matrices to prepare them for the shader
-	worldMatrix = XMMatrixTranspose(worldMatrix);
-	viewMatrix = XMMatrixTranspose(viewMatrix);
-	projectionMatrix = XMMatrixTranspose(projectionMatrix);
-
-	worldInvTrans = XMMatrixTranspose(worldInvTrans);
+	FrameBufferType* dataPtr;
 
 	//Lock the constant buffer so it can be written to
-	HR(m_d3dImmediateContext->Map(m_matrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource));
-
-	//Get a pointer to the data in the constant buffer
-	dataPtr = reinterpret_cast<MatrixBufferType*>(mappedResource.pData);
-
-	//Copy the matrices into constant buffer
-	dataPtr->world = worldMatrix;
-	dataPtr->view = viewMatrix;
-	dataPtr->projection = projectionMatrix;
+	HR(m_d3dImmediateContext->Map(m_frameBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource));
 
-	dataPtr->wInvTrans = worldInvTrans; //for normal trsnsformation
+	dataPtr = reinterpret_cast<FrameBufferType*>(mappedResource.pData);
 
+	//Transpose the matrix to prepare it for the shader
+	dataPtr->viewProj = XMMatrixTranspose(XMMatrixMultiply(viewMatrix, projectionMatrix));
 
+	//The land has it baked, the waves compute it
+	dataPtr->dir = m_dirLight;
 
-	//Unlock the constant buffer
-	m_d3dImmediateContext->Unmap(m_matrixBuffer, 0);
+	dataPtr->eye = m_eyePosW;
+	dataPtr->pad = 0.0f;
 
-	//Set the position of the constant buffer in the vertex shader
-	bufferNumber = 0;
+	dataPtr->clusters = m_lightClusters.Constants();
 
-	//Finally set the constant buffer in the vertex shader with the updated values
-	m_d3dImmediateContext->VSSetConstantBuffers(bufferNumber, 1, &m_matrixBuffer);
+	m_d3dImmediateContext->Unmap(m_frameBuffer, 0);
 
+	//The first constant buffer in both shaders
+	m_d3dImmediateContext->VSSetConstantBuffers(0, 1, &m_frameBuffer);
+	m_d3dImmediateContext->PSSetConstantBuffers(0, 1, &m_frameBuffer);
 
-	///////////////////////////
-	/////Light Buffer/////////
-	//////////////////////////
-	HR(m_d3dImmediateContext->Map(m_lightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource));
-	
-	dataPtr2 = reinterpret_cast<LightBufferType*>(mappedResource.pData);
-
+	return true;
+}
 
-	dataPtr2->dir = DirectionalLight(); 
-					//m_dirLight;
-	dataPtr2->point = //PointLight(); 
-					m_pointLight;
-	dataPtr2->spot = SpotLight(); 
-					 //m_spotLight;
+//Lists the lights of every cluster for this view and uploads the lights and
+//the lists for the pixel shader
+bool LightingApp::SetLightParameters(XMMATRIX view)
+{
+	PROFILE_SCOPE("Light clusters");
 
-	dataPtr2->mat = material; //actually could be static
+	m_pointLights[0] = m_pointLight;
 
-	m_d3dImmediateContext->Unmap(m_lightBuffer, 0);
+	m_lightClusters.Build(view, &m_pointLights[0], static_cast<UINT>(m_pointLights.size()),
+		m_spotLights.empty() ? 0 : &m_spotLights[0], static_cast<UINT>(m_spotLights.size()));
 
-	bufferNumber = 0; //the first constant buffer in pixel shader
+	const std::vector<LightClusters::Cluster>& clusters = m_lightClusters.Clusters();
+	const std::vector<UINT>& indices = m_lightClusters.LightIndices();
 
-	m_d3dImmediateContext->PSSetConstantBuffers(bufferNumber, 1, &m_lightBuffer);
+	if (!UpdateStructuredBuffer(m_pointLightBuffer, &m_pointLights[0], static_cast<UINT>(m_pointLights.size()), sizeof(PointLight)))
+		return false;
+	if (!UpdateStructuredBuffer(m_spotLightBuffer, m_spotLights.empty() ? 0 : &m_spotLights[0], static_cast<UINT>(m_spotLights.size()), sizeof(SpotLight)))
+		return false;
+	if (!UpdateStructuredBuffer(m_clusterBuffer, &clusters[0], static_cast<UINT>(clusters.size()), sizeof(LightClusters::Cluster)))
+		return false;
+	if (!UpdateStructuredBuffer(m_lightIndexBuffer, indices.empty() ? 0 : &indices[0], static_cast<UINT>(indices.size()), sizeof(UINT)))
+		return false;
 
+	ID3D11ShaderResourceView* views[4] = { m_pointLightBuffer.View, m_spotLightBuffer.View, m_clusterBuffer.View, m_lightIndexBuffer.View };
+	m_d3dImmediateContext->PSSetShaderResources(1, 4, views);
 
-	///////////////////////////
-	////Eye Buffer////////////
-	//////////////////////////
-	HR(m_d3dImmediateContext->Map(m_eyeBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource));
+	return true;
+}
 
-	dataPtr3 = reinterpret_cast<EyeBufferType*>(mappedResource.pData);
+//Recreates the buffer with room to spare when count does not fit, then
+//writes the elements with a discarding Map
+bool LightingApp::UpdateStructuredBuffer(StructuredBuffer& buffer, const void* data, UINT count, UINT stride)
+{
+	if (!buffer.Buffer || count > buffer.Capacity)
+	{
+		ReleaseStructuredBuffer(buffer);
+		buffer.Capacity = MathHelper::Max(count + count / 2, 64u);
+
+		D3D11_BUFFER_DESC desc;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth = buffer.Capacity*stride;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = stride;
+		if (FAILED(m_d3dDevice->CreateBuffer(&desc, 0, &buffer.Buffer)))
+			return false;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = buffer.Capacity;
+		if (FAILED(m_d3dDevice->CreateShaderResourceView(buffer.Buffer, &srvDesc, &buffer.View)))
+			return false;
+	}
 
-	dataPtr3->eye = m_eyePosW;
-	dataPtr3->pad = 0.0f;
+	if (!count)
+		return true;
 
-	m_d3dImmediateContext->Unmap(m_eyeBuffer, 0);
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HR(m_d3dImmediateContext->Map(buffer.Buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource));
+	memcpy(mappedResource.pData, data, count*stride);
+	m_d3dImmediateContext->Unmap(buffer.Buffer, 0);
 
-	bufferNumber = 1; //the second constant buffer in pixel shader
+	return true;
+}
 
-	m_d3dImmediateContext->PSSetConstantBuffers(bufferNumber, 1, &m_eyeBuffer);
+void LightingApp::ReleaseStructuredBuffer(StructuredBuffer& buffer)
+{
+	ReleaseCOM(buffer.View);
+	ReleaseCOM(buffer.Buffer);
+	buffer.Capacity = 0;
+}
 
-	//
-	RenderShader(indexCount, indexOffset, vertexOffset);
-	//
+void LightingApp::SetObjectParameters(ObjectBufferType* block, XMMATRIX worldMatrix, const Material& material)
+{
+	//Transpose the matrices to prepare them for the shader
+	block->world = XMMatrixTranspose(worldMatrix);
+	block->wInvTrans = XMMatrixTranspose(MathHelper::InverseTranspose(worldMatrix)); //for normal trsnsformation
 
-	return true;
+	block->mat = material;
 }
 
-void LightingApp::RenderShader(int indexCount, int indexOffset, int vertexOffset)
+//The shader, the buffers of land and waves and the object blocks, for the
+//packets of DrawScene
+void LightingApp::BuildRenderBackend()
 {
-	m_d3dImmediateContext->IASetInputLayout(m_inputLayout);
+	m_renderBackend.SetContext(m_d3dImmediateContext);
+	m_renderBackend.SetConstantRing(&m_objectConstants, 1);
+
+	D3DRenderBackend::ShaderState shader;
+	shader.InputLayout = m_inputLayout;
+	shader.VertexShader = m_vertexShader;
+	shader.PixelShader = m_pixelShader;
+	m_lightingShader = m_renderBackend.AddShader(shader);
+
+	shader.InputLayout = m_bakedInputLayout;
+	shader.VertexShader = m_bakedVertexShader;
+	shader.PixelShader = m_bakedPixelShader;
+	m_bakedShader = m_renderBackend.AddShader(shader);
+
+	//Materials live in the object blocks, material 0 binds nothing
+	D3DRenderBackend::MaterialState material;
+	material.Texture = 0;
+	material.Sampler = 0;
+	m_renderBackend.AddMaterial(material);
+
+	D3DRenderBackend::MeshState mesh;
+	mesh.VertexStride = sizeof(BakedVertexType);
+	mesh.InstanceBuffer = 0;
+	mesh.InstanceStride = 0;
+	mesh.IndexFormat = DXGI_FORMAT_R32_UINT;
+	mesh.Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+	mesh.VertexBuffer = m_landVB;
+	mesh.IndexBuffer = m_landIB;
+	m_landMesh = m_renderBackend.AddMesh(mesh);
+
+	mesh.VertexStride = sizeof(VertexType);
+	mesh.VertexBuffer = m_wavesVB;
+	mesh.IndexBuffer = m_wavesIB;
+	m_wavesMesh = m_renderBackend.AddMesh(mesh);
+}
 
-	//Set the vertex and pixel shaders that will be used to render this model
-	m_d3dImmediateContext->VSSetShader(m_vertexShader, NULL, 0);
-	m_d3dImmediateContext->PSSetShader(m_pixelShader, NULL, 0);
+void LightingApp::AddDraw(UINT shader, UINT mesh, UINT constants, UINT indexCount)
+{
+	DrawPacket packet;
+	packet.Key = RenderQueue::MakeSortKey(0, shader, 0, mesh, 0);
+	packet.Shader = static_cast<UINT16>(shader);
+	packet.Material = 0;
+	packet.Mesh = static_cast<UINT16>(mesh);
+	packet.Constants = static_cast<UINT16>(constants);
+	packet.IndexCount = indexCount;
+	packet.StartIndex = 0;
+	packet.BaseVertex = 0;
+	packet.InstanceCount = 1;
+	packet.StartInstance = 0;
+	m_renderQueue.Add(packet);
+}
 
-	m_d3dImmediateContext->DrawIndexed(indexCount, indexOffset, vertexOffset);
-}
\ No newline at end of file
+std::wstring LightingApp::FrameStatsText() const
+{
+	const RenderQueue::Stats& stats = m_renderQueue.LastStats();
+	const LightClusters::Stats& lights = m_lightClusters.LastStats();
+
+	std::wostringstream outs;
+	outs.precision(3);
+	outs << L"  Draws: " << stats.Draws
+		<< L"  State changes: " << stats.StateChanges()
+		<< L"  Sort: " << stats.SortMilliseconds << L" (ms)"
+		<< L"  Lights: " << lights.VisibleLights << L"/" << lights.Lights
+		<< L"  Clusters: " << lights.BinMilliseconds + lights.CompactMilliseconds << L" (ms)"
+		<< L"  Bake: " << m_lightBaker.LastStats().LightingMilliseconds + m_lightBaker.LastStats().OcclusionMilliseconds << L" (ms)";
+	return outs.str();
+}
@@ -4,6 +4,10 @@
 #include"MathHelper.h"
 #include"LightHelper.h"
 #include"Waves.h"
+#include"ConstantRing.h"
+#include"D3DRenderBackend.h"
+#include"LightClusters.h"
+#include"LightBaker.h"
 
 class LightingApp : public D3DApp
 {
@@ -14,30 +18,44 @@ private:
 		XMFLOAT3 Normal;
 	};
 
-
-	//Vertex constant buffers.
-	struct MatrixBufferType
+	//The land never moves, nor does the directional light: their ambient
+	//and diffuse terms are baked into the vertices
+	struct BakedVertexType
 	{
-		XMMATRIX world;
-		XMMATRIX view;
-		XMMATRIX projection;
-
-		XMMATRIX wInvTrans;
+		XMFLOAT3 Pos;
+		XMFLOAT3 Normal;
+		XMFLOAT4 Baked;
 	};
 
-	struct EyeBufferType
+
+	//Constant buffers.
+	//Camera, directional light and the cluster grid, mapped once per frame,
+	//slot b0 of both stages. Point and spot lights are in structured buffers.
+	struct FrameBufferType
 	{
+		XMMATRIX viewProj;
+
+		DirectionalLight dir;
+
 		XMFLOAT3 eye;
 		float pad;
+
+		LightClusters::ShaderConstants clusters;
 	};
 
-	//Pixel constant buffer
-	//Color of lights, color of objects
-	struct LightBufferType
+	//A dynamic structured buffer and its view, grown when too small
+	struct StructuredBuffer
 	{
-		DirectionalLight dir;
-		PointLight point;
-		SpotLight spot;
+		ID3D11Buffer* Buffer;
+		ID3D11ShaderResourceView* View;
+		UINT Capacity;
+	};
+
+	//One block per object in m_objectConstants, slot b1 of both stages
+	struct ObjectBufferType
+	{
+		XMMATRIX world;
+		XMMATRIX wInvTrans;
 
 		Material mat;
 	};
@@ -53,6 +71,11 @@ public:
 	void UpdateScene(float dt);
 	bool DrawScene();
 
+	std::wstring FrameStatsText() const;
+
+	//Scatters count dim point and spot lights over the hills, before Init()
+	void AddLights(UINT count);
+
 	void OnMouseDown(WPARAM, int, int);
 	void OnMouseUp(WPARAM, int, int);
 	void OnMouseMove(WPARAM, int, int);
@@ -63,11 +86,15 @@ private:
 	void BuildLandGeometryBuffers();
 	void BuildWaveGeometryBuffers();
 
-	bool BuildShader(WCHAR*, WCHAR*);
-	bool SetShaderParameters(XMMATRIX, XMMATRIX, XMMATRIX, XMMATRIX, Material, int, int, int);
-	void RenderShader(int, int, int);
+	bool BuildShader(WCHAR*, WCHAR*, bool baked);
+	bool SetFrameParameters(XMMATRIX, XMMATRIX);
+	void SetObjectParameters(ObjectBufferType*, XMMATRIX, const Material&);
+	void BuildRenderBackend();
+	void AddDraw(UINT shader, UINT mesh, UINT constants, UINT indexCount);
 
-	void RenderBuffers();
+	bool SetLightParameters(XMMATRIX view);
+	bool UpdateStructuredBuffer(StructuredBuffer& buffer, const void* data, UINT count, UINT stride);
+	void ReleaseStructuredBuffer(StructuredBuffer& buffer);
 
 private:
 	ID3D11Buffer* m_landVB;
@@ -81,13 +108,25 @@ private:
 
 	ID3D11InputLayout* m_inputLayout;
 
+	//The same shaders built with BAKED_LIGHTING, for BakedVertexType
+	ID3D11VertexShader* m_bakedVertexShader;
+	ID3D11PixelShader* m_bakedPixelShader;
+	ID3D11InputLayout* m_bakedInputLayout;
+
 	//constant buffers
-	ID3D11Buffer* m_matrixBuffer;
-	ID3D11Buffer* m_lightBuffer;
-	ID3D11Buffer* m_eyeBuffer;
+	ID3D11Buffer* m_frameBuffer;
+	ConstantRing m_objectConstants;
 
 	ID3D11RasterizerState* m_wireframeRS;
 
+	//The draws of a frame, sorted and replayed without redundant state
+	RenderQueue m_renderQueue;
+	D3DRenderBackend m_renderBackend;
+	UINT m_lightingShader;
+	UINT m_bakedShader;
+	UINT m_landMesh;
+	UINT m_wavesMesh;
+
 	XMFLOAT4X4 m_view;
 	XMFLOAT4X4 m_proj;
 
@@ -113,6 +152,20 @@ private:
 	PointLight m_pointLight;
 	SpotLight m_spotLight;
 
+	//Every point and spot light of the scene, m_pointLight first. The lights
+	//of each cluster are listed every frame, pixels only evaluate those.
+	std::vector<PointLight> m_pointLights;
+	std::vector<SpotLight> m_spotLights;
+	LightClusters m_lightClusters;
+
+	//Pixel shader slots t1 to t4
+	StructuredBuffer m_pointLightBuffer;
+	StructuredBuffer m_spotLightBuffer;
+	StructuredBuffer m_clusterBuffer;
+	StructuredBuffer m_lightIndexBuffer;
+
+	LightBaker m_lightBaker;
+
 	Material m_landMat;
 	Material m_wavesMat;
 
@@ -1,24 +1,44 @@
 #include "lighting.hlsli"
 
-cbuffer cbPerFrame
+//Same layouts as in lightingVS.hlsl
+cbuffer cbPerFrame : register(b0)
 {
+	matrix gViewProj;
+
 	DirectionalLight gDirLight;
-	PointLight gPointLight;
-	SpotLight gSpotLight;
-	Material gMaterial;
-};
 
-cbuffer EyeBuffer
-{
 	float3 gEyePosW;
 	float pad;
+
+	//Pixel and log2 of view depth to cluster, and the cluster counts,
+	//see LightClusters.h
+	float4 gClusterScale;
+	uint4 gClusterCounts;
+};
+
+cbuffer cbPerObject : register(b1)
+{
+	matrix worldMatrix;
+	matrix worldInvTrans;
+
+	Material gMaterial;
 };
 
+//The lights, and per cluster (offset, point count, spot count, 0) into
+//gLightIndices, where the point light indices come before the spot ones
+StructuredBuffer<PointLight> gPointLights : register(t1);
+StructuredBuffer<SpotLight> gSpotLights : register(t2);
+StructuredBuffer<uint4> gClusters : register(t3);
+StructuredBuffer<uint> gLightIndices : register(t4);
+
 struct PixelIn
 {
 	float4 PosH : SV_POSITION;
 	float4 PosW : POSITION;
 	float3 NormalW : NORMAL;
+#ifdef BAKED_LIGHTING
+	float4 Baked : COLOR;
+#endif
 };
 
 float4 LightingPixelShader(PixelIn pin):SV_TARGET
@@ -36,20 +56,39 @@ float4 LightingPixelShader(PixelIn pin):SV_TARGET
 	//Sum the light contribution from each light source
 	float4 A, D, S;
 
+#ifdef BAKED_LIGHTING
+	//Ambient and diffuse of the directional light were baked with occlusion,
+	//its specular is left out
+	diffuse += pin.Baked;
+#else
 	ComputeDirectionalLight(gMaterial, gDirLight, pin.NormalW, toEyeW, A, D, S);
 	ambient += A;
 	diffuse += D;
 	spec += S;
+#endif
 
-	ComputePointLight(gMaterial, gPointLight, pin.PosW.xyz, pin.NormalW, toEyeW, A, D, S);
-	ambient += A;
-	diffuse += D;
-	spec += S;
+	//The cluster of the pixel, SV_POSITION.w is the view space depth
+	uint2 tile = min(uint2(pin.PosH.xy*gClusterScale.xy), gClusterCounts.xy - 1);
+	uint slice = (uint)clamp(floor(log2(pin.PosH.w)*gClusterScale.z + gClusterScale.w), 0.0f, (float)(gClusterCounts.z - 1));
+	uint4 cluster = gClusters[(slice*gClusterCounts.y + tile.y)*gClusterCounts.x + tile.x];
 
-	ComputeSpotLight(gMaterial, gSpotLight, pin.PosW.xyz, pin.NormalW, toEyeW, A, D, S);
-	ambient += A;
-	diffuse += D;
-	spec += S;
+	//Only the lights reaching the cluster
+	uint i;
+	for (i = 0; i < cluster.y; ++i)
+	{
+		ComputePointLight(gMaterial, gPointLights[gLightIndices[cluster.x + i]], pin.PosW.xyz, pin.NormalW, toEyeW, A, D, S);
+		ambient += A;
+		diffuse += D;
+		spec += S;
+	}
+
+	for (i = 0; i < cluster.z; ++i)
+	{
+		ComputeSpotLight(gMaterial, gSpotLights[gLightIndices[cluster.x + cluster.y + i]], pin.PosW.xyz, pin.NormalW, toEyeW, A, D, S);
+		ambient += A;
+		diffuse += D;
+		spec += S;
+	}
 
 	float4 litColor = ambient + diffuse + spec;
 
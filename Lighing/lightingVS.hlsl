@@ -1,11 +1,27 @@
+#include "lighting.hlsli"
 
-cbuffer MatrixBuffer
+//Same layouts as in lightingPS.hlsl
+cbuffer cbPerFrame : register(b0)
 {
-	matrix worldMatrix;
-	matrix viewMatrix;
-	matrix projectionMatrix;
+	matrix gViewProj;
+
+	DirectionalLight gDirLight;
+
+	float3 gEyePosW;
+	float pad;
+
+	//Pixel and log2 of view depth to cluster, and the cluster counts,
+	//see LightClusters.h
+	float4 gClusterScale;
+	uint4 gClusterCounts;
+};
 
+cbuffer cbPerObject : register(b1)
+{
+	matrix worldMatrix;
 	matrix worldInvTrans;
+
+	Material gMaterial;
 };
 
 
@@ -17,6 +33,9 @@ struct VertexIn
 {
 	float4 PosL  : POSITION;
 	float4 NormalL : NORMAL;
+#ifdef BAKED_LIGHTING
+	float4 Baked : COLOR;
+#endif
 };
 
 struct PixelIn
@@ -24,6 +43,9 @@ struct PixelIn
 	float4 PosH : SV_POSITION;
 	float4 PosW : POSITION;
 	float3 NormalW : NORMAL;
+#ifdef BAKED_LIGHTING
+	float4 Baked : COLOR;
+#endif
 };
 
 PixelIn LightingVertexShader(VertexIn vin)
@@ -38,12 +60,14 @@ PixelIn LightingVertexShader(VertexIn vin)
 
 
 	//Transform Positon
-	vout.PosH = mul(vin.PosL, worldMatrix);
-	vout.PosH = mul(vout.PosH, viewMatrix);
-	vout.PosH = mul(vout.PosH, projectionMatrix);
+	vout.PosH = mul(vout.PosW, gViewProj);
 
 	//Transform Normal
 	vout.NormalW = mul(vin.NormalL, (float3x3)worldInvTrans);
 
+#ifdef BAKED_LIGHTING
+	vout.Baked = vin.Baked;
+#endif
+
 	return vout;
 }
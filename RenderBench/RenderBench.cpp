@@ -0,0 +1,2308 @@
+//Command line benchmarks of the device free render code in DXGeneral
+//
+//RenderBench queue [draws frames]
+//	RenderQueue sort and replay time per frame, and the state changes it
+//	saves over the recorded order, after checking the replay order and that
+//	a cleared queue replays nothing
+//RenderBench mtqueue [draws frames]
+//	ParallelRenderQueue recording and merge time against one RenderQueue,
+//	after checking that both replay the same calls
+//RenderBench raster [width height frames [image.bmp]]
+//	SoftwareRasterizer time per frame of a ShapesDemo like scene, after
+//	checking that meshes sharing edges cover every pixel exactly once
+//RenderBench lighting [samples lights iterations]
+//	LightingModel samples*lights per second batched and scalar, and the
+//	largest difference between both
+//RenderBench clusters [lights frames]
+//	LightClusters binning time per frame for an orbiting camera, after
+//	checking that every light reaching a point is in the list of its cluster
+//RenderBench bake [grid rays]
+//	LightBaker lighting and occlusion time for a grid x grid hill terrain,
+//	after checking the colors against the scalar lighting functions
+//RenderBench profiler [frames [trace.json]]
+//	FrameProfiler cost per scope and its share of a frame of nested scopes
+//	on the main and worker threads, after checking the events it collects
+//RenderBench meshlets [slices iterations]
+//	MeshletBuilder build and cull time for GeometryGenerator meshes, after
+//	checking that the meshlets keep every triangle and stay within the limits
+//RenderBench cull [objects iterations]
+//	FrustumCuller sphere and box culling time with the instruction set it was
+//	built with, after checking its visible lists against plain plane tests
+//RenderBench ring [objects frames]
+//	RingAllocator time per frame of per object constant blocks, after
+//	checking wraps, stride rounding and that no block is reused before a
+//	discard
+//RenderBench instancing [objects frames]
+//	InstanceBatcher time per frame to batch a scene, after checking one
+//	batch per mesh and material, their instance ranges and that every batch
+//	keeps the order the objects were added in
+//RenderBench mesh [slices iterations]
+//	MeshProcessor normal and tangent and MeshSimplifier LOD chain time for a
+//	sphere, after checking them against single threaded references and the
+//	triangle targets, and that AssetLoader fails missing and broken models
+
+#include"RenderQueue.h"
+#include"ParallelRenderQueue.h"
+#include"SoftwareRasterizer.h"
+#include"LightingModel.h"
+#include"LightClusters.h"
+#include"LightBaker.h"
+#include"FrameProfiler.h"
+#include"MeshletBuilder.h"
+#include"FrustumCuller.h"
+#include"ConstantRing.h"
+#include"InstanceBatcher.h"
+#include"AssetLoader.h"
+#include"MeshProcessor.h"
+#include"MeshSimplifier.h"
+
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<map>
+#include<random>
+#include<set>
+
+namespace
+{
+	void PrintUsage()
+	{
+		printf("usage: RenderBench queue [draws frames]\n");
+		printf("       RenderBench mtqueue [draws frames]\n");
+		printf("       RenderBench raster [width height frames [image.bmp]]\n");
+		printf("       RenderBench lighting [samples lights iterations]\n");
+		printf("       RenderBench clusters [lights frames]\n");
+		printf("       RenderBench bake [grid rays]\n");
+		printf("       RenderBench profiler [frames [trace.json]]\n");
+		printf("       RenderBench meshlets [slices iterations]\n");
+		printf("       RenderBench cull [objects iterations]\n");
+		printf("       RenderBench ring [objects frames]\n");
+		printf("       RenderBench instancing [objects frames]\n");
+		printf("       RenderBench mesh [slices iterations]\n");
+	}
+
+	//A scene of draws recorded in traversal order: objects of random meshes
+	//at random depths. Each mesh is drawn with its own material and each
+	//material with one of the shaders.
+	void MakePackets(std::vector<DrawPacket>& packets, UINT count, bool sortKeys)
+	{
+		const UINT shaders = 16;
+		const UINT materials = 256;
+		const UINT meshes = 1024;
+
+		std::mt19937 random(12345);
+		packets.resize(count);
+		for (UINT i = 0; i < count; ++i)
+		{
+			UINT mesh = random() % meshes;
+			UINT material = mesh * 7 % materials;
+
+			DrawPacket& packet = packets[i];
+			packet.Shader = static_cast<UINT16>(material % shaders);
+			packet.Material = static_cast<UINT16>(material);
+			packet.Mesh = static_cast<UINT16>(mesh);
+			packet.Constants = DrawPacket::NO_CONSTANTS;
+			packet.IndexCount = 36;
+			packet.StartIndex = 0;
+			packet.BaseVertex = 0;
+			packet.InstanceCount = 1;
+			packet.StartInstance = 0;
+
+			//Equal keys keep the recorded order, the baseline
+			UINT depth = random() & 0xffff;
+			packet.Key = sortKeys ? RenderQueue::MakeSortKey(0, packet.Shader, packet.Material, packet.Mesh, depth) : 0;
+		}
+	}
+
+	struct QueueTimes
+	{
+		double SortMilliseconds;
+		double SubmitMilliseconds;
+		RenderQueue::Stats Stats;
+	};
+
+	QueueTimes MeasureQueue(const std::vector<DrawPacket>& packets, UINT frames)
+	{
+		RenderQueue queue;
+		NullRenderBackend backend;
+
+		QueueTimes times;
+		times.SortMilliseconds = 0.0;
+		times.SubmitMilliseconds = 0.0;
+
+		for (UINT frame = 0; frame <= frames; ++frame)
+		{
+			queue.Clear();
+			for (size_t i = 0; i < packets.size(); ++i)
+			{
+				queue.Add(packets[i]);
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			queue.Submit(backend);
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+			//Frame 0 warms up the allocations
+			if (frame > 0)
+			{
+				times.SortMilliseconds += queue.LastStats().SortMilliseconds;
+				times.SubmitMilliseconds += elapsed.count();
+			}
+		}
+
+		times.SortMilliseconds /= frames;
+		times.SubmitMilliseconds /= frames;
+		times.Stats = queue.LastStats();
+		return times;
+	}
+
+	//std::sort of the same keys, for reference
+	double MeasureStdSort(const std::vector<DrawPacket>& packets, UINT frames)
+	{
+		std::vector<std::pair<UINT64, UINT>> keys(packets.size());
+
+		double total = 0.0;
+		for (UINT frame = 0; frame < frames; ++frame)
+		{
+			for (size_t i = 0; i < packets.size(); ++i)
+			{
+				keys[i] = std::make_pair(packets[i].Key, static_cast<UINT>(i));
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			std::sort(keys.begin(), keys.end());
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			total += elapsed.count();
+		}
+
+		return total / frames;
+	}
+
+	//Draws in ascending keys, equal keys in the order added, and nothing of
+	//a frame left after Clear()
+	bool VerifyQueue(const std::vector<DrawPacket>& packets)
+	{
+		RenderQueue queue;
+		RecordingRenderBackend backend;
+
+		for (size_t i = 0; i < packets.size(); ++i)
+		{
+			queue.Add(packets[i]);
+		}
+		queue.Submit(backend);
+
+		const std::vector<UINT>& order = queue.Order();
+		if (order.size() != packets.size() || queue.LastStats().Draws != packets.size())
+		{
+			printf("%u packets replayed as %u draws\n", static_cast<UINT>(packets.size()), queue.LastStats().Draws);
+			return false;
+		}
+		for (size_t i = 1; i < order.size(); ++i)
+		{
+			const UINT64 previous = packets[order[i - 1]].Key;
+			const UINT64 key = packets[order[i]].Key;
+			if (previous > key || (previous == key && order[i - 1] > order[i]))
+			{
+				printf("draw %u is out of order\n", static_cast<UINT>(i));
+				return false;
+			}
+		}
+
+		//Cleared with nothing added, then a smaller frame
+		queue.Clear();
+		backend.Clear();
+		queue.Submit(backend);
+		if (!backend.Commands().empty() || queue.LastStats().Draws != 0 || !queue.Order().empty())
+		{
+			printf("a cleared queue replayed %u commands\n", static_cast<UINT>(backend.Commands().size()));
+			return false;
+		}
+
+		queue.Clear();
+		queue.Add(packets[0]);
+		queue.Submit(backend);
+		if (backend.Commands().empty() || queue.LastStats().Draws != 1)
+		{
+			printf("one packet after Clear() replayed as %u draws\n", queue.LastStats().Draws);
+			return false;
+		}
+
+		return true;
+	}
+
+	int RunQueueBench(int argc, char* argv[])
+	{
+		UINT draws = 10000;
+		UINT frames = 200;
+		if (argc >= 2)
+		{
+			draws = static_cast<UINT>(strtoul(argv[0], 0, 10));
+			frames = static_cast<UINT>(strtoul(argv[1], 0, 10));
+		}
+		if (!draws || !frames)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		std::vector<DrawPacket> recorded;
+		std::vector<DrawPacket> sorted;
+		MakePackets(recorded, draws, false);
+		MakePackets(sorted, draws, true);
+
+		if (!VerifyQueue(recorded) || !VerifyQueue(sorted))
+		{
+			printf("queue verification failed\n");
+			return 1;
+		}
+
+		QueueTimes recordedTimes = MeasureQueue(recorded, frames);
+		QueueTimes sortedTimes = MeasureQueue(sorted, frames);
+		double stdSort = MeasureStdSort(sorted, frames);
+
+		printf("%u draws, %u frames, %u byte packets\n", draws, frames, static_cast<UINT>(sizeof(DrawPacket)));
+		printf("%-10s %8s %8s %8s %8s %10s %10s\n", "", "shader", "material", "mesh", "total", "sort ms", "submit ms");
+
+		const QueueTimes* rows[] = { &recordedTimes, &sortedTimes };
+		const char* names[] = { "recorded", "sorted" };
+		for (int i = 0; i < 2; ++i)
+		{
+			const RenderQueue::Stats& stats = rows[i]->Stats;
+			printf("%-10s %8u %8u %8u %8u %10.3f %10.3f\n", names[i],
+				stats.ShaderChanges, stats.MaterialChanges, stats.MeshChanges, stats.StateChanges(),
+				rows[i]->SortMilliseconds, rows[i]->SubmitMilliseconds);
+		}
+
+		printf("radix sort %.1f Mdraws/s, std::sort %.3f ms\n",
+			draws / sortedTimes.SortMilliseconds / 1000.0, stdSort);
+
+		return 0;
+	}
+
+	//Slices of the parallel recording
+	const UINT RECORD_GRAIN = 1024;
+
+	//Index of the first command that differs, or the length of the shorter
+	//list
+	size_t FirstDifference(const std::vector<RecordingRenderBackend::Command>& a,
+		const std::vector<RecordingRenderBackend::Command>& b)
+	{
+		size_t count = std::min(a.size(), b.size());
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!(a[i] == b[i]))
+				return i;
+		}
+		return count;
+	}
+
+	//The parallel recording must replay exactly like one RenderQueue
+	bool VerifyParallelQueue(const std::vector<DrawPacket>& packets)
+	{
+		const UINT count = static_cast<UINT>(packets.size());
+
+		RenderQueue serial;
+		for (UINT i = 0; i < count; ++i)
+		{
+			serial.Add(packets[i]);
+		}
+
+		RecordingRenderBackend expected;
+		serial.Submit(expected);
+
+		ParallelRenderQueue parallel;
+		parallel.Record(count, RECORD_GRAIN, [&packets](UINT begin, UINT end, RenderQueue& queue)
+		{
+			for (UINT i = begin; i < end; ++i)
+			{
+				queue.Add(packets[i]);
+			}
+		});
+
+		RecordingRenderBackend merged;
+		parallel.Submit(merged);
+
+		size_t difference = FirstDifference(expected.Commands(), merged.Commands());
+		if (difference != expected.Commands().size() || difference != merged.Commands().size())
+		{
+			printf("merged replay differs at command %u of %u\n",
+				static_cast<UINT>(difference), static_cast<UINT>(expected.Commands().size()));
+			return false;
+		}
+
+		//Split replay: the same draws in the same order, each range setting
+		//its state again
+		const UINT ranges = 4;
+		RecordingRenderBackend rangeBackends[ranges];
+		RenderBackend* backends[ranges];
+		for (UINT i = 0; i < ranges; ++i)
+		{
+			backends[i] = &rangeBackends[i];
+		}
+		parallel.SubmitParallel(backends, ranges);
+
+		std::vector<UINT64> expectedDraws;
+		std::vector<UINT64> rangeDraws;
+		for (size_t i = 0; i < expected.Commands().size(); ++i)
+		{
+			if (expected.Commands()[i].Type == RecordingRenderBackend::COMMAND_DRAW)
+				expectedDraws.push_back(expected.Commands()[i].Value);
+		}
+		for (UINT range = 0; range < ranges; ++range)
+		{
+			const std::vector<RecordingRenderBackend::Command>& commands = rangeBackends[range].Commands();
+			for (size_t i = 0; i < commands.size(); ++i)
+			{
+				if (commands[i].Type == RecordingRenderBackend::COMMAND_DRAW)
+					rangeDraws.push_back(commands[i].Value);
+			}
+		}
+
+		if (expectedDraws != rangeDraws)
+		{
+			printf("split replay draws differ\n");
+			return false;
+		}
+
+		return true;
+	}
+
+	int RunParallelQueueBench(int argc, char* argv[])
+	{
+		UINT draws = 100000;
+		UINT frames = 100;
+		if (argc >= 2)
+		{
+			draws = static_cast<UINT>(strtoul(argv[0], 0, 10));
+			frames = static_cast<UINT>(strtoul(argv[1], 0, 10));
+		}
+		if (!draws || !frames)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		std::vector<DrawPacket> packets;
+		MakePackets(packets, draws, true);
+
+		if (!VerifyParallelQueue(packets))
+			return 1;
+
+		NullRenderBackend backend;
+
+		//One thread: record everything, sort, replay
+		RenderQueue serial;
+		double serialTotal = 0.0;
+		for (UINT frame = 0; frame <= frames; ++frame)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+
+			serial.Clear();
+			for (UINT i = 0; i < draws; ++i)
+			{
+				serial.Add(packets[i]);
+			}
+			serial.Submit(backend);
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			if (frame > 0)
+				serialTotal += elapsed.count();
+		}
+
+		ParallelRenderQueue parallel;
+		double parallelTotal = 0.0;
+		double recordTotal = 0.0;
+		double mergeTotal = 0.0;
+		for (UINT frame = 0; frame <= frames; ++frame)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+
+			parallel.Record(draws, RECORD_GRAIN, [&packets](UINT begin, UINT end, RenderQueue& queue)
+			{
+				for (UINT i = begin; i < end; ++i)
+				{
+					queue.Add(packets[i]);
+				}
+			});
+			parallel.Submit(backend);
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			if (frame > 0)
+			{
+				parallelTotal += elapsed.count();
+				recordTotal += parallel.LastStats().RecordMilliseconds;
+				mergeTotal += parallel.LastStats().MergeMilliseconds;
+			}
+		}
+
+		const ParallelRenderQueue::Stats& stats = parallel.LastStats();
+		printf("%u draws, %u frames, %u worker threads, %u slices, replay verified\n",
+			draws, frames, JobSystem::Default().ThreadCount(), stats.Slices);
+		printf("one queue    %8.3f ms/frame\n", serialTotal / frames);
+		printf("parallel     %8.3f ms/frame (record and sort %.3f, merge %.3f)\n",
+			parallelTotal / frames, recordTotal / frames, mergeTotal / frames);
+		printf("state changes %u, the same as one queue\n", stats.Replay.StateChanges());
+
+		return 0;
+	}
+
+	//The vertex layout of the color demos
+	struct ColorVertex
+	{
+		XMFLOAT3 Pos;
+		XMFLOAT4 Color;
+	};
+
+	//A jittered grid of triangles over the screen and beyond, each
+	//triangle drawn nearer than the one before, so a pixel covered twice
+	//is shaded twice. Every pixel must be shaded exactly once.
+	bool VerifyCoverage(float extent)
+	{
+		const UINT width = 250;
+		const UINT height = 170;
+		const UINT cellsX = 7;
+		const UINT cellsY = 5;
+
+		std::mt19937 random(6789);
+		std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+
+		std::vector<XMFLOAT2> corners((cellsX + 1)*(cellsY + 1));
+		for (UINT y = 0; y <= cellsY; ++y)
+		{
+			for (UINT x = 0; x <= cellsX; ++x)
+			{
+				bool border = x == 0 || y == 0 || x == cellsX || y == cellsY;
+				float fx = (x + (border ? 0.0f : jitter(random))) / cellsX;
+				float fy = (y + (border ? 0.0f : jitter(random))) / cellsY;
+				corners[y*(cellsX + 1) + x] = XMFLOAT2((fx*2.0f - 1.0f)*extent, (fy*2.0f - 1.0f)*extent);
+			}
+		}
+
+		//Unshared vertices, z per triangle
+		std::vector<XMFLOAT4> vertices;
+		for (UINT y = 0; y < cellsY; ++y)
+		{
+			for (UINT x = 0; x < cellsX; ++x)
+			{
+				const XMFLOAT2& a = corners[y*(cellsX + 1) + x];
+				const XMFLOAT2& b = corners[y*(cellsX + 1) + x + 1];
+				const XMFLOAT2& c = corners[(y + 1)*(cellsX + 1) + x];
+				const XMFLOAT2& d = corners[(y + 1)*(cellsX + 1) + x + 1];
+
+				//Alternating diagonals, clockwise on screen
+				const XMFLOAT2* triangles[2][3] = { { &a, &c, &b }, { &b, &c, &d } };
+				if ((x + y) & 1)
+				{
+					triangles[0][0] = &a; triangles[0][1] = &c; triangles[0][2] = &d;
+					triangles[1][0] = &a; triangles[1][1] = &d; triangles[1][2] = &b;
+				}
+
+				for (UINT t = 0; t < 2; ++t)
+				{
+					float z = 0.9f - vertices.size() / 3 * 0.001f;
+					for (UINT k = 0; k < 3; ++k)
+					{
+						vertices.push_back(XMFLOAT4(triangles[t][k]->x, triangles[t][k]->y, z, 1.0f));
+					}
+				}
+			}
+		}
+
+		std::vector<UINT> indices(vertices.size());
+		for (UINT i = 0; i < indices.size(); ++i)
+		{
+			indices[i] = i;
+		}
+
+		std::atomic<UINT> shaded(0);
+
+		SoftwareRasterizer rasterizer;
+		rasterizer.Resize(width, height);
+		rasterizer.Clear(XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+
+		SoftwareRasterizer::DrawCall draw;
+		draw.Vertices = vertices.data();
+		draw.VertexStride = sizeof(XMFLOAT4);
+		draw.VertexCount = static_cast<UINT>(vertices.size());
+		draw.Indices = indices.data();
+		draw.IndexCount = static_cast<UINT>(indices.size());
+		draw.StartIndex = 0;
+		draw.BaseVertex = 0;
+		draw.Instance = 0;
+		draw.VS = [](const void* vertex, UINT, SoftwareRasterizer::ShadedVertex& out)
+		{
+			out.Position = *static_cast<const XMFLOAT4*>(vertex);
+		};
+		draw.PS = [&shaded](const float*)
+		{
+			++shaded;
+			return XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+		};
+		draw.VaryingCount = 0;
+		draw.CullBack = true;
+
+		rasterizer.Draw(draw);
+		rasterizer.Finish();
+
+		UINT holes = 0;
+		for (UINT y = 0; y < height; ++y)
+		{
+			for (UINT x = 0; x < width; ++x)
+			{
+				if (rasterizer.Pixels()[y*rasterizer.Pitch() + x] == 0)
+					++holes;
+			}
+		}
+
+		if (holes || shaded != width*height)
+		{
+			printf("coverage at extent %.1f: %u pixels shaded of %u, %u holes\n", extent, shaded.load(), width*height, holes);
+			return false;
+		}
+
+		return true;
+	}
+
+	void AddGrid(std::vector<ColorVertex>& vertices, std::vector<UINT>& indices,
+		float width, float depth, UINT m, UINT n, const XMFLOAT4& color)
+	{
+		const UINT base = static_cast<UINT>(vertices.size());
+		for (UINT i = 0; i < m; ++i)
+		{
+			for (UINT j = 0; j < n; ++j)
+			{
+				ColorVertex v;
+				v.Pos = XMFLOAT3(-0.5f*width + j*width / (n - 1), 0.0f, 0.5f*depth - i*depth / (m - 1));
+				v.Color = color;
+				vertices.push_back(v);
+			}
+		}
+
+		for (UINT i = 0; i + 1 < m; ++i)
+		{
+			for (UINT j = 0; j + 1 < n; ++j)
+			{
+				UINT a = base + i*n + j;
+				indices.push_back(a);
+				indices.push_back(a + 1);
+				indices.push_back(a + n);
+				indices.push_back(a + n);
+				indices.push_back(a + 1);
+				indices.push_back(a + n + 1);
+			}
+		}
+	}
+
+	void AddSphere(std::vector<ColorVertex>& vertices, std::vector<UINT>& indices,
+		float radius, UINT slices, UINT stacks, const XMFLOAT4& color)
+	{
+		const UINT base = static_cast<UINT>(vertices.size());
+		for (UINT i = 0; i <= stacks; ++i)
+		{
+			float phi = XM_PI*i / stacks;
+			for (UINT j = 0; j <= slices; ++j)
+			{
+				float theta = 2.0f*XM_PI*j / slices;
+				ColorVertex v;
+				v.Pos = XMFLOAT3(radius*sinf(phi)*cosf(theta), radius*cosf(phi), radius*sinf(phi)*sinf(theta));
+
+				//Shaded by height, so the image shows the depth test
+				float shade = 0.6f + 0.4f*cosf(phi);
+				v.Color = XMFLOAT4(color.x*shade, color.y*shade, color.z*shade, 1.0f);
+				vertices.push_back(v);
+			}
+		}
+
+		const UINT ring = slices + 1;
+		for (UINT i = 0; i < stacks; ++i)
+		{
+			for (UINT j = 0; j < slices; ++j)
+			{
+				UINT a = base + i*ring + j;
+				indices.push_back(a);
+				indices.push_back(a + 1);
+				indices.push_back(a + ring);
+				indices.push_back(a + ring);
+				indices.push_back(a + 1);
+				indices.push_back(a + ring + 1);
+			}
+		}
+	}
+
+	int RunRasterBench(int argc, char* argv[])
+	{
+		UINT width = 1920;
+		UINT height = 1080;
+		UINT frames = 20;
+		const char* image = 0;
+		if (argc >= 3)
+		{
+			width = static_cast<UINT>(strtoul(argv[0], 0, 10));
+			height = static_cast<UINT>(strtoul(argv[1], 0, 10));
+			frames = static_cast<UINT>(strtoul(argv[2], 0, 10));
+		}
+		if (argc >= 4)
+		{
+			image = argv[3];
+		}
+		if (!width || !height || !frames)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		//Inside the screen, past it and past the guard band
+		if (!VerifyCoverage(1.0f) || !VerifyCoverage(1.5f) || !VerifyCoverage(100.0f))
+			return 1;
+
+		//The ShapesDemo layout: a grid, a center sphere and two rows of five
+		//columns topped by spheres, here all spheres
+		std::vector<ColorVertex> vertices;
+		std::vector<UINT> indices;
+		AddGrid(vertices, indices, 20.0f, 30.0f, 60, 40, XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f));
+		const UINT gridIndexCount = static_cast<UINT>(indices.size());
+		AddSphere(vertices, indices, 0.5f, 40, 40, XMFLOAT4(0.1f, 0.8f, 0.2f, 1.0f));
+		const UINT sphereIndexCount = static_cast<UINT>(indices.size()) - gridIndexCount;
+
+		std::vector<XMFLOAT4X4> worlds;
+		auto addWorld = [&worlds](CXMMATRIX world)
+		{
+			XMFLOAT4X4 stored;
+			XMStoreFloat4x4(&stored, world);
+			worlds.push_back(stored);
+		};
+
+		addWorld(XMMatrixIdentity());
+		addWorld(XMMatrixMultiply(XMMatrixScaling(2.0f, 2.0f, 2.0f), XMMatrixTranslation(0.0f, 2.0f, 0.0f)));
+		for (int i = 0; i < 5; ++i)
+		{
+			addWorld(XMMatrixMultiply(XMMatrixScaling(1.0f, 3.0f, 1.0f), XMMatrixTranslation(-5.0f, 1.5f, -10.0f + i*5.0f)));
+			addWorld(XMMatrixMultiply(XMMatrixScaling(1.0f, 3.0f, 1.0f), XMMatrixTranslation(+5.0f, 1.5f, -10.0f + i*5.0f)));
+			addWorld(XMMatrixTranslation(-5.0f, 3.5f, -10.0f + i*5.0f));
+			addWorld(XMMatrixTranslation(+5.0f, 3.5f, -10.0f + i*5.0f));
+		}
+
+		//The ShapesDemo camera
+		XMVECTOR eye = XMVectorSet(0.0f, 15.0f*cosf(0.1f*XM_PI), -15.0f*sinf(0.1f*XM_PI), 1.0f);
+		XMMATRIX view = XMMatrixLookAtLH(eye, XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*XM_PI, static_cast<float>(width) / height, 1.0f, 1000.0f);
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, XMMatrixMultiply(view, proj));
+
+		SoftwareRasterizer rasterizer;
+		rasterizer.Resize(width, height);
+		SoftwareRenderBackend backend(rasterizer);
+
+		SoftwareRenderBackend::ShaderState shader;
+		shader.VS = [&worlds, &viewProj](const void* vertex, UINT instance, UINT, UINT, SoftwareRasterizer::ShadedVertex& out)
+		{
+			const ColorVertex& v = *static_cast<const ColorVertex*>(vertex);
+			XMMATRIX worldViewProj = XMMatrixMultiply(XMLoadFloat4x4(&worlds[instance]), XMLoadFloat4x4(&viewProj));
+			XMStoreFloat4(&out.Position, XMVector3Transform(XMLoadFloat3(&v.Pos), worldViewProj));
+			out.Varyings[0] = v.Color.x;
+			out.Varyings[1] = v.Color.y;
+			out.Varyings[2] = v.Color.z;
+			out.Varyings[3] = v.Color.w;
+		};
+		shader.PS = [](const float* varyings)
+		{
+			return XMFLOAT4(varyings[0], varyings[1], varyings[2], varyings[3]);
+		};
+		shader.VaryingCount = 4;
+		shader.CullBack = true;
+		backend.AddShader(shader);
+
+		SoftwareRenderBackend::MeshState mesh;
+		mesh.Vertices = vertices.data();
+		mesh.VertexStride = sizeof(ColorVertex);
+		mesh.VertexCount = static_cast<UINT>(vertices.size());
+		mesh.Indices = indices.data();
+		mesh.IndexCount = static_cast<UINT>(indices.size());
+		backend.AddMesh(mesh);
+
+		//Grid first, then all spheres as one instanced draw
+		RenderQueue queue;
+		DrawPacket packet;
+		packet.Key = 0;
+		packet.Shader = 0;
+		packet.Material = 0;
+		packet.Mesh = 0;
+		packet.Constants = DrawPacket::NO_CONSTANTS;
+		packet.IndexCount = gridIndexCount;
+		packet.StartIndex = 0;
+		packet.BaseVertex = 0;
+		packet.InstanceCount = 1;
+		packet.StartInstance = 0;
+		queue.Add(packet);
+
+		packet.IndexCount = sphereIndexCount;
+		packet.StartIndex = gridIndexCount;
+		packet.InstanceCount = static_cast<UINT>(worlds.size()) - 1;
+		packet.StartInstance = 1;
+		queue.Add(packet);
+
+		double total = 0.0;
+		double setupTotal = 0.0;
+		double rasterTotal = 0.0;
+		for (UINT frame = 0; frame <= frames; ++frame)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+
+			rasterizer.Clear(XMFLOAT4(0.69f, 0.77f, 0.87f, 1.0f));
+			queue.Submit(backend);
+			rasterizer.Finish();
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			if (frame > 0)
+			{
+				total += elapsed.count();
+				setupTotal += rasterizer.LastStats().SetupMilliseconds;
+				rasterTotal += rasterizer.LastStats().RasterMilliseconds;
+			}
+		}
+
+		const SoftwareRasterizer::Stats& stats = rasterizer.LastStats();
+		printf("%ux%u, %u frames, %u worker threads, coverage verified\n",
+			width, height, frames, JobSystem::Default().ThreadCount());
+		printf("%u draws, %u triangles, %u culled, %u clipped, %u tile bins, %llu pixels shaded\n",
+			stats.Draws, stats.Triangles, stats.CulledTriangles, stats.ClippedTriangles, stats.BinnedTriangles,
+			static_cast<unsigned long long>(stats.ShadedPixels));
+		printf("frame %8.3f ms (vertex and setup %.3f, raster %.3f)\n",
+			total / frames, setupTotal / frames, rasterTotal / frames);
+		printf("checksum %016llx\n", static_cast<unsigned long long>(rasterizer.Checksum()));
+
+		if (image && !rasterizer.SaveBitmap(image))
+		{
+			printf("cannot write %s\n", image);
+			return 1;
+		}
+
+		return 0;
+	}
+
+	int RunLightingBench(int argc, char* argv[])
+	{
+		UINT samples = 65536;
+		UINT lights = 64;
+		UINT iterations = 10;
+		if (argc >= 3)
+		{
+			samples = static_cast<UINT>(strtoul(argv[0], 0, 10));
+			lights = static_cast<UINT>(strtoul(argv[1], 0, 10));
+			iterations = static_cast<UINT>(strtoul(argv[2], 0, 10));
+		}
+		if (!samples || !lights || !iterations)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		LightingModel::BenchmarkResult result;
+		LightingModel::Benchmark(samples, lights, iterations, result);
+
+		printf("%s, %u samples, %u lights\n", LightingModel::InstructionSet(), result.SampleCount, result.LightCount);
+		printf("batched %10.3f ms, %8.1f M samples*lights/s\n", result.BatchMilliseconds, result.BatchRate / 1e6);
+		printf("scalar  %10.3f ms, %8.1f M samples*lights/s\n", result.ScalarMilliseconds, result.ScalarRate / 1e6);
+		printf("largest difference %g\n", result.MaxError);
+
+		//pow() differs in the last bits, colors add up to a few units
+		if (result.MaxError > 1e-3f)
+		{
+			printf("batched and scalar lighting disagree\n");
+			return 1;
+		}
+
+		return 0;
+	}
+
+	//Pixels at random depths, each against every light by distance
+	bool VerifyClusters(const LightClusters& clusters, CXMMATRIX view,
+		const std::vector<PointLight>& points, const std::vector<SpotLight>& spots,
+		float tanHalfX, float tanHalfY, UINT width, UINT height)
+	{
+		std::vector<XMFLOAT4> spheres;
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			XMFLOAT4 sphere;
+			XMStoreFloat4(&sphere, XMVector3TransformCoord(XMLoadFloat3(&points[i].Position), view));
+			sphere.w = points[i].Range;
+			spheres.push_back(sphere);
+		}
+		for (size_t i = 0; i < spots.size(); ++i)
+		{
+			XMFLOAT4 sphere;
+			XMStoreFloat4(&sphere, XMVector3TransformCoord(XMLoadFloat3(&spots[i].Position), view));
+			sphere.w = spots[i].Range;
+			spheres.push_back(sphere);
+		}
+
+		std::mt19937 random(4321);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		const UINT pointCount = static_cast<UINT>(points.size());
+		UINT checked = 0;
+		for (UINT n = 0; n < 4000; ++n)
+		{
+			float x = unit(random)*width;
+			float y = unit(random)*height;
+			float z = 1.0f + unit(random)*unit(random)*999.0f;
+			XMFLOAT3 p((2.0f*x / width - 1.0f)*z*tanHalfX, (1.0f - 2.0f*y / height)*z*tanHalfY, z);
+
+			const LightClusters::Cluster& cluster = clusters.Clusters()[clusters.ClusterOf(x, y, z)];
+			const UINT* list = clusters.LightIndices().empty() ? 0 : &clusters.LightIndices()[0] + cluster.Offset;
+
+			for (UINT i = 0; i < spheres.size(); ++i)
+			{
+				const XMFLOAT4& s = spheres[i];
+				float dx = s.x - p.x, dy = s.y - p.y, dz = s.z - p.z;
+				if (dx*dx + dy*dy + dz*dz > s.w*s.w)
+					continue;
+
+				bool listed = i < pointCount ?
+					std::binary_search(list, list + cluster.PointCount, i) :
+					std::binary_search(list + cluster.PointCount, list + cluster.PointCount + cluster.SpotCount, i - pointCount);
+				if (!listed)
+				{
+					printf("light %u reaches pixel (%.1f, %.1f) at depth %.2f but is not in its cluster\n", i, x, y, z);
+					return false;
+				}
+				++checked;
+			}
+		}
+
+		return checked > 0 || spheres.empty();
+	}
+
+	int RunClusterBench(int argc, char* argv[])
+	{
+		UINT lightCount = 10000;
+		UINT frames = 100;
+		if (argc >= 2)
+		{
+			lightCount = static_cast<UINT>(strtoul(argv[0], 0, 10));
+			frames = static_cast<UINT>(strtoul(argv[1], 0, 10));
+		}
+		if (!frames)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		const UINT width = 1920;
+		const UINT height = 1080;
+		const float fovY = 0.25f*XM_PI;
+		const float aspect = static_cast<float>(width) / height;
+
+		//Half points, half spots over a 1000x1000 field around the camera
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> field(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> above(1.0f, 20.0f);
+		std::uniform_real_distribution<float> range(5.0f, 30.0f);
+
+		std::vector<PointLight> points;
+		std::vector<SpotLight> spots;
+		for (UINT i = 0; i < lightCount; ++i)
+		{
+			XMFLOAT3 position(field(random), above(random), field(random));
+			if (i & 1)
+			{
+				SpotLight spot;
+				spot.Position = position;
+				spot.Range = range(random);
+				spot.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+				spots.push_back(spot);
+			}
+			else
+			{
+				PointLight point;
+				point.Position = position;
+				point.Range = range(random);
+				points.push_back(point);
+			}
+		}
+
+		LightClusters clusters;
+		clusters.SetProjection(fovY, aspect, 1.0f, 1000.0f, width, height);
+
+		double binTotal = 0.0;
+		double compactTotal = 0.0;
+		double indexTotal = 0.0;
+		UINT maxClusterLights = 0;
+		XMMATRIX view = XMMatrixIdentity();
+		for (UINT frame = 0; frame <= frames; ++frame)
+		{
+			//Circling the field, looking at its center from above
+			float angle = 2.0f*XM_PI*frame / (frames + 1);
+			XMVECTOR eye = XMVectorSet(200.0f*cosf(angle), 40.0f, 200.0f*sinf(angle), 1.0f);
+			view = XMMatrixLookAtLH(eye, XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+			clusters.Build(view, points.empty() ? 0 : &points[0], static_cast<UINT>(points.size()),
+				spots.empty() ? 0 : &spots[0], static_cast<UINT>(spots.size()));
+
+			//The first frame grows the allocations
+			if (frame > 0)
+			{
+				const LightClusters::Stats& stats = clusters.LastStats();
+				binTotal += stats.BinMilliseconds;
+				compactTotal += stats.CompactMilliseconds;
+				indexTotal += stats.Indices;
+				maxClusterLights = std::max(maxClusterLights, stats.MaxClusterLights);
+			}
+		}
+
+		float tanHalfY = tanf(0.5f*fovY);
+		if (!VerifyClusters(clusters, view, points, spots, tanHalfY*aspect, tanHalfY, width, height))
+		{
+			printf("cluster lists verification failed\n");
+			return 1;
+		}
+
+		const LightClusters::Stats& stats = clusters.LastStats();
+		printf("%u lights, %u clusters, %u frames, %u worker threads, lists verified\n",
+			lightCount, clusters.ClusterCount(), frames, JobSystem::Default().ThreadCount());
+		printf("%u lights visible in the last frame, %.0f indices per frame, at most %u in a cluster\n",
+			stats.VisibleLights, indexTotal / frames, maxClusterLights);
+		printf("build %8.3f ms (bin %.3f, compact %.3f)\n",
+			(binTotal + compactTotal) / frames, binTotal / frames, compactTotal / frames);
+
+		return 0;
+	}
+
+	//The hills of the lighting demo
+	float HillHeight(float x, float z)
+	{
+		return 0.3f*(z*sinf(0.1f*x) + x*cosf(0.1f*z));
+	}
+
+	XMFLOAT3 HillNormal(float x, float z)
+	{
+		XMFLOAT3 n(
+			-0.03f*z*cosf(0.1f*x) - 0.3f*cosf(0.1f*z),
+			1.0f,
+			-0.3f*sinf(0.1f*x) + 0.03f*x*sinf(0.1f*z));
+		XMStoreFloat3(&n, XMVector3Normalize(XMLoadFloat3(&n)));
+		return n;
+	}
+
+	int RunBakeBench(int argc, char* argv[])
+	{
+		UINT grid = 256;
+		UINT rays = 32;
+		if (argc >= 2)
+		{
+			grid = static_cast<UINT>(strtoul(argv[0], 0, 10));
+			rays = static_cast<UINT>(strtoul(argv[1], 0, 10));
+		}
+		if (grid < 2)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		//A 160x160 patch of the hills, as BuildLandGeometryBuffers makes it
+		LightingModel::SampleSet samples;
+		samples.Resize(grid*grid);
+		for (UINT i = 0; i < grid*grid; ++i)
+		{
+			float x = -80.0f + 160.0f*(i % grid) / (grid - 1);
+			float z = 80.0f - 160.0f*(i / grid) / (grid - 1);
+			samples.Set(i, XMFLOAT3(x, HillHeight(x, z), z), HillNormal(x, z));
+		}
+
+		Material mat;
+		mat.Ambient = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+		mat.Diffuse = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+		mat.Specular = XMFLOAT4(0.2f, 0.2f, 0.2f, 16.0f);
+
+		LightingModel::LightSet lights;
+		DirectionalLight sun;
+		sun.Ambient = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+		sun.Diffuse = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
+		sun.Specular = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
+		sun.Direction = XMFLOAT3(0.57735f, -0.57735f, 0.57735f);
+		lights.Directional.push_back(sun);
+
+		LightBaker baker;
+		LightBaker::Settings settings;
+		std::vector<XMFLOAT4> colors;
+
+		//Without occlusion the colors are ambient + diffuse of the scalar path
+		settings.OcclusionRays = 0;
+		baker.Bake(mat, lights, samples, LightBaker::HeightField(), settings, colors);
+
+		float maxError = 0.0f;
+		for (UINT i = 0; i < grid*grid; ++i)
+		{
+			XMFLOAT4 A, D, S;
+			LightingModel::ComputeLights(mat, lights, XMFLOAT3(0.0f, 0.0f, 0.0f),
+				XMFLOAT3(samples.PositionX[i], samples.PositionY[i], samples.PositionZ[i]),
+				XMFLOAT3(samples.NormalX[i], samples.NormalY[i], samples.NormalZ[i]), A, D, S);
+			maxError = std::max(maxError, fabsf(colors[i].x - (A.x + D.x)));
+			maxError = std::max(maxError, fabsf(colors[i].y - (A.y + D.y)));
+			maxError = std::max(maxError, fabsf(colors[i].z - (A.z + D.z)));
+		}
+		if (maxError > 1e-3f)
+		{
+			printf("baked colors differ from the scalar lighting by %g\n", maxError);
+			return 1;
+		}
+
+		//Nothing above the surface occludes nothing
+		settings.OcclusionRays = rays;
+		baker.Bake(mat, lights, samples, [](float, float) { return -1000.0f; }, settings, colors);
+		if (baker.LastStats().AverageOcclusion != 1.0f)
+		{
+			printf("an open sky occludes %g of the ambient light\n", 1.0f - baker.LastStats().AverageOcclusion);
+			return 1;
+		}
+
+		baker.Bake(mat, lights, samples, HillHeight, settings, colors);
+		for (UINT i = 0; i < grid*grid; ++i)
+		{
+			float ao = baker.Occlusion()[i];
+			if (!(ao >= 0.0f && ao <= 1.0f))
+			{
+				printf("occlusion %g of vertex %u is out of [0, 1]\n", ao, i);
+				return 1;
+			}
+		}
+
+		const LightBaker::Stats& stats = baker.LastStats();
+		printf("%s, %u vertices, %u rays of %u steps, %u worker threads, colors verified\n",
+			LightingModel::InstructionSet(), stats.Vertices, stats.Rays, settings.OcclusionSteps,
+			JobSystem::Default().ThreadCount());
+		printf("lighting  %10.3f ms\n", stats.LightingMilliseconds);
+		printf("occlusion %10.3f ms, average ambient scale %.3f\n", stats.OcclusionMilliseconds, stats.AverageOcclusion);
+
+		return 0;
+	}
+
+	//Where the results of Spin() go so the work is kept
+	volatile float g_sink = 0.0f;
+
+	//Arithmetic the compiler cannot drop, about a microsecond per 100 steps
+	float Spin(UINT steps, float seed)
+	{
+		float x = seed;
+		for (UINT i = 0; i < steps; ++i)
+		{
+			x = x*0.999f + 0.5f;
+		}
+		return x;
+	}
+
+	//A frame shaped like the demos: a few phases on the frame thread, one
+	//of them split over the workers with a scope per chunk
+	float ProfiledFrame(FrameProfiler& profiler, JobSystem& jobs)
+	{
+		const char* phases[] = { "Update", "Waves update", "Waves buffer", "Light clusters", "Submit", "Present" };
+		float sink = 0.0f;
+
+		profiler.BeginFrame();
+		for (UINT p = 0; p < sizeof(phases) / sizeof(phases[0]); ++p)
+		{
+			FrameProfiler::Scope scope(phases[p], profiler);
+			sink += Spin(20000, sink);
+
+			if (p == 3)
+			{
+				std::atomic<UINT> chunks(0);
+				jobs.ParallelFor(64, 4, [&](UINT begin, UINT end, UINT)
+				{
+					FrameProfiler::Scope chunk("Cluster chunk", profiler);
+					float x = Spin(2000 * (end - begin), static_cast<float>(begin));
+					if (x < 0.0f)
+						++chunks;
+				});
+				sink += chunks;
+			}
+		}
+		profiler.EndFrame();
+
+		return sink;
+	}
+
+	int RunProfilerBench(int argc, char* argv[])
+	{
+		UINT frames = 300;
+		const char* traceFile = 0;
+		if (argc >= 1)
+			frames = static_cast<UINT>(strtoul(argv[0], 0, 10));
+		if (argc >= 2)
+			traceFile = argv[1];
+		if (!frames)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		JobSystem& jobs = JobSystem::Default();
+		const UINT chunksPerFrame = jobs.ChunkCount(64, 4);
+		const UINT eventsPerFrame = 6 + chunksPerFrame + 1;
+
+		//A ring too small for one frame keeps the newest events only, all but
+		//the slot the owner would write next
+		{
+			FrameProfiler small(16);
+			small.SetEnabled(true);
+			small.BeginFrame();
+			for (UINT i = 0; i < 100; ++i)
+			{
+				FrameProfiler::Scope scope("Overflow", small);
+			}
+			small.EndFrame();
+
+			FrameProfiler::Summary summary;
+			small.Summarize(0, summary);
+			if (summary.TraceEvents != 15 || summary.DroppedEvents != 101 - 15)
+			{
+				printf("overflowing ring kept %u events and dropped %u, expected 15 and %u\n",
+					static_cast<UINT>(summary.TraceEvents), static_cast<UINT>(summary.DroppedEvents), 101 - 15);
+				return 1;
+			}
+		}
+
+		//The same frames without and with scopes, alternating so both see
+		//the same machine state
+		FrameProfiler disabled;
+		FrameProfiler enabled;
+		enabled.SetEnabled(true);
+
+		float sink = 0.0f;
+		for (UINT frame = 0; frame < frames; ++frame)
+		{
+			sink += ProfiledFrame(disabled, jobs);
+			sink += ProfiledFrame(enabled, jobs);
+		}
+
+		FrameProfiler::Summary off, on;
+		disabled.Summarize(0, off);
+		enabled.Summarize(0, on);
+
+		if (on.DroppedEvents || on.TraceEvents != static_cast<UINT64>(frames)*eventsPerFrame)
+		{
+			printf("collected %u events and dropped %u, expected %u\n", static_cast<UINT>(on.TraceEvents),
+				static_cast<UINT>(on.DroppedEvents), frames*eventsPerFrame);
+			return 1;
+		}
+		if (!off.Phases.empty() || off.TraceEvents)
+		{
+			printf("a disabled profiler recorded events\n");
+			return 1;
+		}
+
+		//What one scope costs on its own
+		FrameProfiler timing(1 << 16);
+		timing.SetEnabled(true);
+		const UINT scopes = 1 << 16;
+		timing.BeginFrame();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (UINT i = 0; i < scopes; ++i)
+		{
+			FrameProfiler::Scope scope("Empty", timing);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		timing.EndFrame();
+		const double scopeNanoseconds = std::chrono::duration<double, std::nano>(end - start).count() / scopes;
+		const double overhead = scopeNanoseconds*1e-6*eventsPerFrame / off.MeanMilliseconds;
+
+		g_sink = sink;
+
+		printf("%u frames, %u events per frame, %u worker threads, events verified\n", frames, eventsPerFrame,
+			jobs.ThreadCount());
+		printf("disabled: mean %.3f ms, p50 %.3f, p95 %.3f, p99 %.3f, max %.3f\n", off.MeanMilliseconds,
+			off.P50Milliseconds, off.P95Milliseconds, off.P99Milliseconds, off.MaxMilliseconds);
+		printf("enabled:  mean %.3f ms, p50 %.3f, p95 %.3f, p99 %.3f, max %.3f\n", on.MeanMilliseconds,
+			on.P50Milliseconds, on.P95Milliseconds, on.P99Milliseconds, on.MaxMilliseconds);
+		for (size_t p = 0; p < on.Phases.size(); ++p)
+		{
+			printf("  %-16s %8.3f ms, max %.3f\n", on.Phases[p].Name, on.Phases[p].MeanMilliseconds, on.Phases[p].MaxMilliseconds);
+		}
+		printf("scope %.1f ns, %.4f%% of a frame\n", scopeNanoseconds, overhead*100.0);
+
+		if (traceFile)
+		{
+			if (!enabled.WriteChromeTrace(traceFile))
+			{
+				printf("could not write %s\n", traceFile);
+				return 1;
+			}
+			printf("trace written to %s\n", traceFile);
+		}
+
+		if (overhead > 0.01)
+		{
+			printf("profiling costs more than 1%% of the frame\n");
+			return 1;
+		}
+
+		return 0;
+	}
+
+	//Every source triangle once in the meshlets, and every meshlet within
+	//the limits, counting its distinct vertices again
+	bool VerifyMeshlets(const GeometryGenerator::MeshData& source, const MeshletBuilder::MeshletMesh& mesh,
+		UINT maxVertices, UINT maxTriangles)
+	{
+		MeshletBuilder::MeshletStats stats;
+		MeshletBuilder::GetStats(mesh, stats);
+
+		const UINT sourceTriangles = static_cast<UINT>(source.Indices.size() / 3);
+		if (stats.TriangleCount != sourceTriangles || mesh.Indices.size() != source.Indices.size())
+		{
+			printf("%u triangles in the meshlets, %u in the mesh\n", stats.TriangleCount, sourceTriangles);
+			return false;
+		}
+		if (stats.MaxTriangles > maxTriangles || stats.MaxVertices > maxVertices || stats.MinTriangles == 0)
+		{
+			printf("meshlets of %u to %u triangles and up to %u vertices, limits %u and %u\n",
+				stats.MinTriangles, stats.MaxTriangles, stats.MaxVertices, maxTriangles, maxVertices);
+			return false;
+		}
+
+		UINT next = 0;
+		std::vector<UINT> used;
+		for (size_t i = 0; i < mesh.Meshlets.size(); ++i)
+		{
+			const MeshletBuilder::Meshlet& m = mesh.Meshlets[i];
+			if (m.StartIndex != next)
+			{
+				printf("meshlet %u starts at index %u, not %u\n", static_cast<UINT>(i), m.StartIndex, next);
+				return false;
+			}
+			next += 3 * m.TriangleCount;
+
+			used.assign(mesh.Indices.begin() + m.StartIndex, mesh.Indices.begin() + next);
+			std::sort(used.begin(), used.end());
+			UINT vertexCount = static_cast<UINT>(std::unique(used.begin(), used.end()) - used.begin());
+			if (vertexCount != m.VertexCount || vertexCount > maxVertices)
+			{
+				printf("meshlet %u uses %u vertices, it counts %u\n", static_cast<UINT>(i), vertexCount, m.VertexCount);
+				return false;
+			}
+		}
+
+		//Same triangles, in any order
+		typedef std::pair<UINT, std::pair<UINT, UINT> > Triangle;
+		std::vector<Triangle> a(sourceTriangles);
+		std::vector<Triangle> b(sourceTriangles);
+		for (UINT t = 0; t < sourceTriangles; ++t)
+		{
+			a[t] = Triangle(source.Indices[3 * t], std::make_pair(source.Indices[3 * t + 1], source.Indices[3 * t + 2]));
+			b[t] = Triangle(mesh.Indices[3 * t], std::make_pair(mesh.Indices[3 * t + 1], mesh.Indices[3 * t + 2]));
+		}
+		std::sort(a.begin(), a.end());
+		std::sort(b.begin(), b.end());
+		if (a != b)
+		{
+			printf("the meshlets do not hold the triangles of the mesh\n");
+			return false;
+		}
+
+		return true;
+	}
+
+	int RunMeshletBench(int argc, char* argv[])
+	{
+		UINT slices = 256;
+		UINT iterations = 20;
+		if (argc >= 2)
+		{
+			slices = static_cast<UINT>(strtoul(argv[0], 0, 10));
+			iterations = static_cast<UINT>(strtoul(argv[1], 0, 10));
+		}
+		if (slices < 3 || !iterations)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		const UINT maxVertices = 64;
+		const UINT maxTriangles = 124;
+
+		GeometryGenerator generator;
+		GeometryGenerator::MeshData meshes[3];
+		const char* names[3] = { "sphere", "grid", "cylinder" };
+		generator.CreateSphere(10.0f, slices, slices / 2, meshes[0]);
+		generator.CreateGrid(100.0f, 100.0f, slices, slices, meshes[1]);
+		generator.CreateCylinder(5.0f, 3.0f, 20.0f, slices, slices / 4, meshes[2]);
+
+		//Looking at the origin from the side, so part of every mesh faces away
+		XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 15.0f, -40.0f, 1.0f), XMVectorZero(),
+			XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*XM_PI, 16.0f / 9.0f, 1.0f, 1000.0f);
+		XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+		const XMFLOAT3 eye(0.0f, 15.0f, -40.0f);
+
+		for (UINT i = 0; i < 3; ++i)
+		{
+			MeshletBuilder::MeshletMesh mesh;
+			std::vector<UINT> visible;
+			MeshletBuilder::CullStats cull;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (UINT it = 0; it < iterations; ++it)
+			{
+				MeshletBuilder::Build(meshes[i], mesh, maxVertices, maxTriangles);
+			}
+			auto built = std::chrono::high_resolution_clock::now();
+			for (UINT it = 0; it < iterations; ++it)
+			{
+				visible.clear();
+				MeshletBuilder::Cull(mesh, XMMatrixIdentity(), viewProj, eye, visible, &cull);
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+
+			if (!VerifyMeshlets(meshes[i], mesh, maxVertices, maxTriangles))
+			{
+				printf("%s meshlets verification failed\n", names[i]);
+				return 1;
+			}
+
+			MeshletBuilder::MeshletStats stats;
+			MeshletBuilder::GetStats(mesh, stats);
+			printf("%-8s %7u triangles, %5u meshlets of %.1f triangles (%u-%u) and %.1f vertices (max %u), verified\n",
+				names[i], stats.TriangleCount, stats.MeshletCount, stats.AverageTriangles,
+				stats.MinTriangles, stats.MaxTriangles, stats.AverageVertices, stats.MaxVertices);
+			printf("         build %8.3f ms, cull %6.3f ms, %u of %u triangles visible (%u frustum, %u backface culled meshlets)\n",
+				std::chrono::duration<double, std::milli>(built - start).count() / iterations,
+				std::chrono::duration<double, std::milli>(end - built).count() / iterations,
+				cull.VisibleTriangleCount, cull.TriangleCount, cull.FrustumCulled, cull.BackfaceCulled);
+		}
+
+		return 0;
+	}
+
+	//The SIMD lists against one plane test per object and plane, summed in
+	//the same order so both round alike
+	bool VerifyCulling(const XMFLOAT4 planes[6], UINT count)
+	{
+		std::mt19937 random(99);
+		std::uniform_real_distribution<float> position(-1200.0f, 1200.0f);
+		std::uniform_real_distribution<float> size(0.5f, 50.0f);
+
+		FrustumCuller::SphereSet spheres;
+		FrustumCuller::AabbSet boxes;
+		spheres.Resize(count);
+		boxes.Resize(count);
+		std::vector<XMFLOAT4> sphereData(count);
+		std::vector<std::pair<XMFLOAT3, XMFLOAT3> > boxData(count);
+		for (UINT i = 0; i < count; ++i)
+		{
+			XMFLOAT3 center(position(random), position(random), 0.5f*position(random) + 600.0f);
+			XMFLOAT3 extents(size(random), size(random), size(random));
+			sphereData[i] = XMFLOAT4(center.x, center.y, center.z, extents.x);
+			boxData[i] = std::make_pair(center, extents);
+			spheres.Set(i, center, extents.x);
+			boxes.Set(i, center, extents);
+		}
+
+		std::vector<UINT> sphereVisible;
+		std::vector<UINT> boxVisible;
+		FrustumCuller::CullSpheres(planes, spheres, sphereVisible);
+		FrustumCuller::CullAabbs(planes, boxes, boxVisible);
+
+		std::vector<UINT> sphereExpected;
+		std::vector<UINT> boxExpected;
+		for (UINT i = 0; i < count; ++i)
+		{
+			bool sphereInside = true;
+			bool boxInside = true;
+			const XMFLOAT4& s = sphereData[i];
+			const XMFLOAT3& c = boxData[i].first;
+			const XMFLOAT3& e = boxData[i].second;
+			for (int p = 0; p < 6; ++p)
+			{
+				const XMFLOAT4& n = planes[p];
+				float ds = (n.x*s.x + n.y*s.y) + (n.z*s.z + n.w);
+				float db = (n.x*c.x + n.y*c.y) + (n.z*c.z + n.w);
+				float rb = (fabsf(n.x)*e.x + fabsf(n.y)*e.y) + fabsf(n.z)*e.z;
+				sphereInside = sphereInside && ds + s.w >= 0.0f;
+				boxInside = boxInside && db + rb >= 0.0f;
+			}
+			if (sphereInside)
+				sphereExpected.push_back(i);
+			if (boxInside)
+				boxExpected.push_back(i);
+		}
+
+		if (sphereVisible != sphereExpected || boxVisible != boxExpected)
+		{
+			printf("%u spheres and %u boxes visible, %u and %u expected\n",
+				static_cast<UINT>(sphereVisible.size()), static_cast<UINT>(boxVisible.size()),
+				static_cast<UINT>(sphereExpected.size()), static_cast<UINT>(boxExpected.size()));
+			return false;
+		}
+
+		//Both inside and outside objects were tested
+		return !sphereExpected.empty() && sphereExpected.size() < count && !boxExpected.empty() && boxExpected.size() < count;
+	}
+
+	int RunCullBench(int argc, char* argv[])
+	{
+		UINT objectCount = 1000000;
+		UINT iterations = 50;
+		if (argc >= 2)
+		{
+			objectCount = static_cast<UINT>(strtoul(argv[0], 0, 10));
+			iterations = static_cast<UINT>(strtoul(argv[1], 0, 10));
+		}
+		if (!objectCount || !iterations)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		//The camera of FrustumCuller::Benchmark, at the origin looking down +z
+		XMMATRIX view = XMMatrixLookAtLH(XMVectorZero(), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*XM_PI, 16.0f / 9.0f, 1.0f, 1000.0f);
+		XMFLOAT4 planes[6];
+		ExtractFrustumPlanes(planes, XMMatrixMultiply(view, proj));
+
+		//Counts that are not a multiple of the SIMD width test the padding
+		if (!VerifyCulling(planes, 10007))
+		{
+			printf("culling verification failed\n");
+			return 1;
+		}
+
+		FrustumCuller::BenchmarkResult bench;
+		FrustumCuller::Benchmark(objectCount, iterations, bench);
+
+		printf("%s, %u objects, %u iterations, visible lists verified\n",
+			FrustumCuller::InstructionSet(), bench.ObjectCount, bench.Iterations);
+		printf("spheres %8.3f ms, %u visible (%.1f M objects/s)\n",
+			bench.SphereMilliseconds, bench.VisibleSpheres, bench.ObjectCount / (bench.SphereMilliseconds*1e3));
+		printf("boxes   %8.3f ms, %u visible (%.1f M objects/s)\n",
+			bench.AabbMilliseconds, bench.VisibleAabbs, bench.ObjectCount / (bench.AabbMilliseconds*1e3));
+
+		return 0;
+	}
+
+	//One Allocate() and what it must return, or fail when fits is false
+	bool ExpectAllocation(RingAllocator& ring, UINT count, UINT blockSize, bool fits,
+		UINT expectedOffset, UINT expectedStride, bool expectedDiscard)
+	{
+		const UINT head = ring.Head();
+		const UINT wraps = ring.WrapCount();
+
+		UINT offset = 0xffffffff;
+		UINT stride = 0xffffffff;
+		bool discard = false;
+		bool allocated = ring.Allocate(count, blockSize, offset, stride, discard);
+
+		bool expected = fits
+			? allocated && offset == expectedOffset && stride == expectedStride && discard == expectedDiscard
+			&& ring.Head() == offset + count*stride && ring.WrapCount() == wraps + (discard ? 1 : 0)
+			: !allocated && ring.Head() == head && ring.WrapCount() == wraps;
+		if (!expected)
+		{
+			printf("%u blocks of %u bytes at head %u of %u: %s, offset %u, stride %u, discard %d\n",
+				count, blockSize, head, ring.Capacity(), allocated ? "allocated" : "failed", offset, stride, discard);
+		}
+		return expected;
+	}
+
+	//The cases the ring must get right, then random frames that check no
+	//block written since the last discard is handed out again
+	bool VerifyRing()
+	{
+		RingAllocator ring;
+		ring.Reset(4096, 256);
+		if (ring.Capacity() != 4096 || ring.Head() != 4096)
+		{
+			printf("a reset ring of 4096 bytes holds %u with the head at %u\n", ring.Capacity(), ring.Head());
+			return false;
+		}
+
+		//The first allocation wraps, so the first map discards
+		bool passed = ExpectAllocation(ring, 1, 64, true, 0, 256, true)
+			&& ExpectAllocation(ring, 3, 256, true, 256, 256, false)
+			//Strides round up to the alignment
+			&& ExpectAllocation(ring, 2, 257, true, 1024, 512, false)
+			//Exactly up to the end still fits
+			&& ExpectAllocation(ring, 8, 200, true, 2048, 256, false)
+			//Past the end the range starts over
+			&& ExpectAllocation(ring, 1, 1, true, 0, 256, true)
+			&& ExpectAllocation(ring, 15, 256, true, 256, 256, false)
+			&& ExpectAllocation(ring, 2, 256, true, 0, 256, true)
+			//The whole buffer at once wraps too
+			&& ExpectAllocation(ring, 16, 256, true, 0, 256, true)
+			//Larger than the buffer, and nothing at all
+			&& ExpectAllocation(ring, 5, 1000, false, 0, 0, false)
+			&& ExpectAllocation(ring, 1, 4097, false, 0, 0, false)
+			&& ExpectAllocation(ring, 0, 256, false, 0, 0, false)
+			&& ExpectAllocation(ring, 1, 0, false, 0, 0, false);
+		if (!passed)
+			return false;
+
+		//The capacity is rounded down to the alignment
+		ring.Reset(1000, 256);
+		if (ring.Capacity() != 768)
+		{
+			printf("a ring of 1000 bytes holds %u\n", ring.Capacity());
+			return false;
+		}
+		if (!ExpectAllocation(ring, 3, 256, true, 0, 256, true) || !ExpectAllocation(ring, 4, 256, false, 0, 0, false))
+			return false;
+
+		//Blocks tagged with their frame; all tags since the last discard
+		//must survive the frames after them
+		const UINT capacity = 64 * 1024;
+		ring.Reset(capacity, 256);
+		std::vector<UINT> memory(capacity / sizeof(UINT), 0);
+		std::vector<std::pair<UINT, UINT> > live;		//offset and frame of every block since the discard
+		std::mt19937 random(5);
+		for (UINT frame = 1; frame <= 20000; ++frame)
+		{
+			UINT count = 1 + random() % 40;
+			UINT blockSize = 16 + random() % 600;
+			UINT offset, stride;
+			bool discard;
+			if (!ring.Allocate(count, blockSize, offset, stride, discard))
+			{
+				if (static_cast<UINT64>((blockSize + 255) & ~255u)*count <= capacity)
+				{
+					printf("frame %u: %u blocks of %u bytes fit but were refused\n", frame, count, blockSize);
+					return false;
+				}
+				continue;
+			}
+
+			if (offset % 256 || stride % 256 || stride < blockSize || offset + count*stride > capacity)
+			{
+				printf("frame %u: %u blocks of %u bytes at %u, stride %u\n", frame, count, blockSize, offset, stride);
+				return false;
+			}
+
+			if (discard)
+				live.clear();
+			for (UINT i = 0; i < count; ++i)
+			{
+				memory[(offset + i*stride) / sizeof(UINT)] = frame;
+				live.push_back(std::make_pair(offset + i*stride, frame));
+			}
+			for (size_t i = 0; i < live.size(); ++i)
+			{
+				if (memory[live[i].first / sizeof(UINT)] != live[i].second)
+				{
+					printf("frame %u overwrote a block of frame %u without a discard\n", frame, live[i].second);
+					return false;
+				}
+			}
+		}
+
+		return ring.WrapCount() > 1;
+	}
+
+	int RunRingBench(int argc, char* argv[])
+	{
+		UINT objectCount = 10000;
+		UINT frames = 1000;
+		if (argc >= 2)
+		{
+			objectCount = static_cast<UINT>(strtoul(argv[0], 0, 10));
+			frames = static_cast<UINT>(strtoul(argv[1], 0, 10));
+		}
+		if (!objectCount || !frames)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!VerifyRing())
+		{
+			printf("ring verification failed\n");
+			return 1;
+		}
+
+		//Three frames of blocks, a world matrix and a material each, written
+		//into plain memory as ConstantRing writes into the mapped buffer
+		const UINT blockSize = sizeof(XMFLOAT4X4) + 4 * sizeof(XMFLOAT4);
+		const UINT stride = (blockSize + 255) & ~255u;
+		const UINT64 capacity = static_cast<UINT64>(stride)*objectCount * 3;
+		if (capacity > 0x7fffffff)
+		{
+			printf("%u objects do not fit a ring\n", objectCount);
+			return 1;
+		}
+
+		RingAllocator ring;
+		ring.Reset(static_cast<UINT>(capacity), 256);
+		std::vector<BYTE> memory(static_cast<size_t>(capacity));
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixIdentity());
+
+		auto start = std::chrono::high_resolution_clock::now();
+		UINT discards = 0;
+		for (UINT frame = 0; frame < frames; ++frame)
+		{
+			UINT offset, frameStride;
+			bool discard;
+			ring.Allocate(objectCount, blockSize, offset, frameStride, discard);
+			discards += discard ? 1 : 0;
+
+			for (UINT i = 0; i < objectCount; ++i)
+			{
+				world._41 = static_cast<float>(i);
+				memcpy(&memory[offset + i*frameStride], &world, sizeof(world));
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		g_sink = memory[stride];
+
+		const double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+		printf("%u objects, %u frames, %u byte blocks, allocations verified\n", objectCount, frames, stride);
+		printf("%.3f ms per frame, %.1f ns per block, %u maps with discard (one per %.1f frames)\n",
+			milliseconds / frames, milliseconds*1e6 / (static_cast<double>(objectCount)*frames),
+			discards, static_cast<double>(frames) / std::max(discards, 1u));
+
+		return 0;
+	}
+
+	//Objects of random meshes and materials, the object index stored in the
+	//translation of its world matrix
+	void AddInstancingScene(InstanceBatcher& batcher, std::vector<std::pair<UINT, UINT> >& objects,
+		UINT count, UINT meshes, UINT materials, UINT seed)
+	{
+		std::mt19937 random(seed);
+		objects.resize(count);
+		batcher.Clear();
+		for (UINT i = 0; i < count; ++i)
+		{
+			objects[i] = std::make_pair(random() % meshes, random() % materials);
+
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMMatrixTranslation(static_cast<float>(i), 0.0f, 0.0f));
+			batcher.Add(objects[i].first, objects[i].second, world);
+		}
+	}
+
+	//One batch per unique mesh and material, covering the instances in
+	//order, each instance of its batch's pair and in the order of Add()
+	bool VerifyInstancing(UINT count, UINT meshes, UINT materials, UINT seed)
+	{
+		InstanceBatcher batcher;
+		std::vector<std::pair<UINT, UINT> > objects;
+
+		//Twice, the second frame reusing the vectors of the first
+		for (int frame = 0; frame < 2; ++frame)
+		{
+			AddInstancingScene(batcher, objects, count, meshes, materials, seed + frame);
+			batcher.Build();
+
+			const std::vector<InstanceBatcher::Batch>& batches = batcher.Batches();
+			const std::vector<XMFLOAT4X4>& instances = batcher.Instances();
+
+			std::set<std::pair<UINT, UINT> > pairs(objects.begin(), objects.end());
+			if (batches.size() != pairs.size() || instances.size() != count || batcher.DrawCount() != count)
+			{
+				printf("%u batches of %u instances for %u pairs of %u objects\n", static_cast<UINT>(batches.size()),
+					static_cast<UINT>(instances.size()), static_cast<UINT>(pairs.size()), count);
+				return false;
+			}
+
+			std::vector<char> seen(count, 0);
+			UINT next = 0;
+			for (size_t b = 0; b < batches.size(); ++b)
+			{
+				const InstanceBatcher::Batch& batch = batches[b];
+				if (batch.FirstInstance != next || !batch.InstanceCount || batch.FirstInstance + batch.InstanceCount > count)
+				{
+					printf("batch %u covers instances %u to %u, expected to start at %u\n", static_cast<UINT>(b),
+						batch.FirstInstance, batch.FirstInstance + batch.InstanceCount, next);
+					return false;
+				}
+				if (b > 0 && std::make_pair(batches[b - 1].Mesh, batches[b - 1].Material) >= std::make_pair(batch.Mesh, batch.Material))
+				{
+					printf("batch %u repeats or is out of order\n", static_cast<UINT>(b));
+					return false;
+				}
+				next += batch.InstanceCount;
+
+				UINT previous = 0;
+				for (UINT i = batch.FirstInstance; i < batch.FirstInstance + batch.InstanceCount; ++i)
+				{
+					UINT object = static_cast<UINT>(instances[i]._41);
+					if (object >= count || seen[object] || objects[object] != std::make_pair(batch.Mesh, batch.Material)
+						|| (i > batch.FirstInstance && object <= previous))
+					{
+						printf("instance %u of batch %u is object %u\n", i, static_cast<UINT>(b), object);
+						return false;
+					}
+					seen[object] = 1;
+					previous = object;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	int RunInstancingBench(int argc, char* argv[])
+	{
+		UINT objectCount = 10000;
+		UINT frames = 1000;
+		if (argc >= 2)
+		{
+			objectCount = static_cast<UINT>(strtoul(argv[0], 0, 10));
+			frames = static_cast<UINT>(strtoul(argv[1], 0, 10));
+		}
+		if (!objectCount || !frames)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		//Few pairs with many instances, many with one or two, and one pair
+		if (!VerifyInstancing(10007, 8, 4, 1) || !VerifyInstancing(10007, 1000, 50, 2) || !VerifyInstancing(100, 1, 1, 3))
+		{
+			printf("instancing verification failed\n");
+			return 1;
+		}
+
+		//A ShapesDemo like scene: a handful of meshes, each with a few materials
+		const UINT meshes = 16;
+		const UINT materials = 4;
+		InstanceBatcher batcher;
+		std::vector<std::pair<UINT, UINT> > objects;
+		AddInstancingScene(batcher, objects, objectCount, meshes, materials, 7);
+
+		std::vector<XMFLOAT4X4> worlds(objectCount);
+		for (UINT i = 0; i < objectCount; ++i)
+			XMStoreFloat4x4(&worlds[i], XMMatrixTranslation(static_cast<float>(i), 0.0f, 0.0f));
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (UINT frame = 0; frame < frames; ++frame)
+		{
+			batcher.Clear();
+			for (UINT i = 0; i < objectCount; ++i)
+				batcher.Add(objects[i].first, objects[i].second, worlds[i]);
+			batcher.Build();
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		g_sink = batcher.Instances().back()._41;
+
+		const double milliseconds = std::chrono::duration<double, std::milli>(end - start).count() / frames;
+		printf("%u objects, %u frames, batches verified\n", objectCount, frames);
+		printf("%.3f ms per frame to batch, %u draws instead of %u\n", milliseconds,
+			static_cast<UINT>(batcher.Batches().size()), batcher.DrawCount());
+
+		return 0;
+	}
+
+	//Mesh processing checks work on a bumpy sphere with its triangles
+	//shuffled, so the chunks of the parallel passes reach all over the vertex
+	//array. The ends of every ring share their position exactly, which the
+	//generator leaves a few bits apart, and the lower half mirrors the
+	//texture so both tangent handednesses occur.
+	void CreateTestSphere(UINT slices, GeometryGenerator::MeshData& meshData)
+	{
+		GeometryGenerator generator;
+		generator.CreateSphere(10.0f, slices, slices / 2, meshData);
+
+		typedef std::pair<int, std::pair<int, int> > Cell;
+		std::map<Cell, XMFLOAT3> first;
+		for (size_t i = 0; i < meshData.Vertices.size(); ++i)
+		{
+			GeometryGenerator::Vertex& v = meshData.Vertices[i];
+			Cell cell(static_cast<int>(floorf(v.Position.x*1e4f + 0.5f)),
+				std::make_pair(static_cast<int>(floorf(v.Position.y*1e4f + 0.5f)), static_cast<int>(floorf(v.Position.z*1e4f + 0.5f))));
+			v.Position = first.insert(std::make_pair(cell, v.Position)).first->second;
+
+			const XMFLOAT3& p = v.Position;
+			float bump = 1.0f + 0.05f*sinf(0.7f*p.x)*sinf(0.5f*p.y + 0.3f*p.z);
+			v.Position = XMFLOAT3(p.x*bump, p.y*bump, p.z*bump);
+
+			if (p.y < 0.0f)
+				v.TexC.x = -v.TexC.x;
+		}
+
+		std::mt19937 random(13);
+		std::vector<UINT> order(meshData.Indices.size() / 3);
+		for (UINT t = 0; t < order.size(); ++t)
+			order[t] = t;
+		std::shuffle(order.begin(), order.end(), random);
+
+		std::vector<UINT> indices(meshData.Indices.size());
+		for (UINT t = 0; t < order.size(); ++t)
+		{
+			for (UINT k = 0; k < 3; ++k)
+				indices[3 * t + k] = meshData.Indices[3 * order[t] + k];
+		}
+		meshData.Indices.swap(indices);
+	}
+
+	//Keeps the first vertex at every position
+	void WeldPositions(const GeometryGenerator::MeshData& meshData, GeometryGenerator::MeshData& welded)
+	{
+		std::vector<UINT> remap;
+		MeshProcessor::BuildPositionRemap(meshData, remap);
+
+		std::vector<UINT> index(remap.size());
+		welded.Vertices.clear();
+		for (UINT i = 0; i < remap.size(); ++i)
+		{
+			if (remap[i] == i)
+			{
+				index[i] = static_cast<UINT>(welded.Vertices.size());
+				welded.Vertices.push_back(meshData.Vertices[i]);
+			}
+		}
+
+		welded.Indices.resize(meshData.Indices.size());
+		for (size_t i = 0; i < meshData.Indices.size(); ++i)
+			welded.Indices[i] = index[remap[meshData.Indices[i]]];
+	}
+
+	XMVECTOR LoadPosition(const GeometryGenerator::MeshData& meshData, UINT i)
+	{
+		return XMLoadFloat3(&meshData.Vertices[i].Position);
+	}
+
+	float CornerAngle(FXMVECTOR a, FXMVECTOR b)
+	{
+		return acosf(MathHelper::Clamp(XMVectorGetX(XMVector3Dot(XMVector3Normalize(a), XMVector3Normalize(b))), -1.0f, 1.0f));
+	}
+
+	//Single threaded MeshProcessor::ComputeNormals, summing in triangle order
+	void ReferenceNormals(const GeometryGenerator::MeshData& meshData, bool weldPositions, std::vector<XMFLOAT3>& normals)
+	{
+		const UINT vcount = static_cast<UINT>(meshData.Vertices.size());
+
+		std::vector<UINT> target(vcount);
+		std::map<std::pair<float, std::pair<float, float> >, UINT> first;
+		for (UINT i = 0; i < vcount; ++i)
+		{
+			const XMFLOAT3& p = meshData.Vertices[i].Position;
+			target[i] = weldPositions ? first.insert(std::make_pair(std::make_pair(p.x, std::make_pair(p.y, p.z)), i)).first->second : i;
+		}
+
+		std::vector<XMVECTOR> sums(vcount, XMVectorZero());
+		for (size_t t = 0; t < meshData.Indices.size(); t += 3)
+		{
+			const UINT* i = &meshData.Indices[t];
+			XMVECTOR p[3] = { LoadPosition(meshData, i[0]), LoadPosition(meshData, i[1]), LoadPosition(meshData, i[2]) };
+			XMVECTOR faceNormal = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+			if (XMVectorGetX(XMVector3LengthSq(faceNormal)) < 1e-20f)
+				continue;
+			faceNormal = XMVector3Normalize(faceNormal);
+
+			for (UINT k = 0; k < 3; ++k)
+			{
+				float angle = CornerAngle(p[(k + 1) % 3] - p[k], p[(k + 2) % 3] - p[k]);
+				sums[target[i[k]]] += angle*faceNormal;
+			}
+		}
+
+		normals.resize(vcount);
+		for (UINT v = 0; v < vcount; ++v)
+			XMStoreFloat3(&normals[v], XMVector3Normalize(sums[target[v]]));
+	}
+
+	//Single threaded MeshProcessor::ComputeTangents on the normals of the mesh.
+	//ambiguous flags vertices whose tangents or orientations cancel out (the
+	//poles and the mirror line), where rounding alone picks the direction.
+	void ReferenceTangents(const GeometryGenerator::MeshData& meshData, std::vector<XMFLOAT4>& tangents,
+		std::vector<bool>& ambiguous)
+	{
+		const UINT vcount = static_cast<UINT>(meshData.Vertices.size());
+
+		std::vector<XMFLOAT4> sums(vcount, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+		std::vector<float> weights(vcount, 0.0f);
+		for (size_t t = 0; t < meshData.Indices.size(); t += 3)
+		{
+			const UINT* i = &meshData.Indices[t];
+			const GeometryGenerator::Vertex* v[3] = { &meshData.Vertices[i[0]], &meshData.Vertices[i[1]], &meshData.Vertices[i[2]] };
+			XMVECTOR p[3] = { LoadPosition(meshData, i[0]), LoadPosition(meshData, i[1]), LoadPosition(meshData, i[2]) };
+
+			float du1 = v[1]->TexC.x - v[0]->TexC.x;
+			float dv1 = v[1]->TexC.y - v[0]->TexC.y;
+			float du2 = v[2]->TexC.x - v[0]->TexC.x;
+			float dv2 = v[2]->TexC.y - v[0]->TexC.y;
+			float det = du1*dv2 - du2*dv1;
+			float orientation = det > 0.0f ? 1.0f : -1.0f;
+
+			XMVECTOR faceTangent = orientation*(dv2*(p[1] - p[0]) - dv1*(p[2] - p[0]));
+			if (det == 0.0f || XMVectorGetX(XMVector3LengthSq(faceTangent)) < 1e-20f)
+				continue;
+
+			for (UINT k = 0; k < 3; ++k)
+			{
+				XMVECTOR n = XMLoadFloat3(&v[k]->Normal);
+				XMVECTOR tangent = faceTangent - XMVector3Dot(n, faceTangent)*n;
+				XMVECTOR edge0 = p[(k + 1) % 3] - p[k];
+				XMVECTOR edge1 = p[(k + 2) % 3] - p[k];
+				edge0 -= XMVector3Dot(n, edge0)*n;
+				edge1 -= XMVector3Dot(n, edge1)*n;
+				if (XMVectorGetX(XMVector3LengthSq(tangent)) < 1e-20f ||
+					XMVectorGetX(XMVector3LengthSq(edge0)) < 1e-20f || XMVectorGetX(XMVector3LengthSq(edge1)) < 1e-20f)
+				{
+					continue;
+				}
+
+				float angle = CornerAngle(edge0, edge1);
+				XMFLOAT3 unit;
+				XMStoreFloat3(&unit, XMVector3Normalize(tangent));
+				sums[i[k]].x += angle*unit.x;
+				sums[i[k]].y += angle*unit.y;
+				sums[i[k]].z += angle*unit.z;
+				sums[i[k]].w += angle*orientation;
+				weights[i[k]] += angle;
+			}
+		}
+
+		tangents.resize(vcount);
+		ambiguous.resize(vcount);
+		for (UINT v = 0; v < vcount; ++v)
+		{
+			XMVECTOR n = XMLoadFloat3(&meshData.Vertices[v].Normal);
+			XMVECTOR s = XMLoadFloat4(&sums[v]);
+			XMVECTOR tangent = s - XMVector3Dot(n, s)*n;
+			float length = XMVectorGetX(XMVector3Length(tangent));
+
+			ambiguous[v] = length < 1e-3f*weights[v] || fabsf(sums[v].w) < 1e-3f*weights[v];
+			XMStoreFloat4(&tangents[v], XMVectorSetW(XMVector3Normalize(tangent), sums[v].w < 0.0f ? -1.0f : 1.0f));
+		}
+	}
+
+	bool SameDirection(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMVectorGetX(XMVector3Dot(XMLoadFloat3(&a), XMLoadFloat3(&b))) > 0.99999f;
+	}
+
+	//Welded and unwelded normals and tangents against the single threaded
+	//reference
+	bool VerifyMeshProcessor(const GeometryGenerator::MeshData& source)
+	{
+		for (int weld = 0; weld < 2; ++weld)
+		{
+			GeometryGenerator::MeshData mesh = source;
+			MeshProcessor::ComputeNormals(mesh, weld != 0);
+
+			std::vector<XMFLOAT3> normals;
+			ReferenceNormals(source, weld != 0, normals);
+			for (UINT v = 0; v < mesh.Vertices.size(); ++v)
+			{
+				if (!SameDirection(mesh.Vertices[v].Normal, normals[v]))
+				{
+					printf("vertex %u normal (%g %g %g), reference (%g %g %g)%s\n", v,
+						mesh.Vertices[v].Normal.x, mesh.Vertices[v].Normal.y, mesh.Vertices[v].Normal.z,
+						normals[v].x, normals[v].y, normals[v].z, weld ? " welded" : "");
+					return false;
+				}
+			}
+
+			std::vector<float> handedness;
+			MeshProcessor::ComputeTangents(mesh, &handedness);
+
+			std::vector<XMFLOAT4> tangents;
+			std::vector<bool> ambiguous;
+			ReferenceTangents(mesh, tangents, ambiguous);
+			UINT checked = 0;
+			for (UINT v = 0; v < mesh.Vertices.size(); ++v)
+			{
+				if (ambiguous[v])
+					continue;
+
+				const XMFLOAT4& t = tangents[v];
+				if (!SameDirection(mesh.Vertices[v].TangentU, XMFLOAT3(t.x, t.y, t.z)) || handedness[v] != t.w)
+				{
+					printf("vertex %u tangent (%g %g %g) %g, reference (%g %g %g) %g%s\n", v,
+						mesh.Vertices[v].TangentU.x, mesh.Vertices[v].TangentU.y, mesh.Vertices[v].TangentU.z, handedness[v],
+						t.x, t.y, t.z, t.w, weld ? " welded" : "");
+					return false;
+				}
+				++checked;
+			}
+
+			//Only the poles and the mirror line may be left out
+			if (checked < mesh.Vertices.size() / 2)
+			{
+				printf("%u of %u tangents could be checked\n", checked, static_cast<UINT>(mesh.Vertices.size()));
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	//Every level within its triangle target, inside the shared arrays and
+	//indexing only its own vertices
+	bool VerifyLodChain(const GeometryGenerator::MeshData& source, const float* ratios, UINT ratioCount,
+		const MeshSimplifier::LodChain& chain)
+	{
+		if (chain.Lods.size() != ratioCount + 1)
+		{
+			printf("%u levels for %u ratios\n", static_cast<UINT>(chain.Lods.size()), ratioCount);
+			return false;
+		}
+
+		const UINT tcount = static_cast<UINT>(source.Indices.size() / 3);
+		for (UINT level = 0; level <= ratioCount; ++level)
+		{
+			const MeshSimplifier::Lod& lod = chain.Lods[level];
+			const UINT target = level > 0 ? static_cast<UINT>(tcount*ratios[level - 1]) : tcount;
+			const UINT triangles = lod.IndexCount / 3;
+
+			//Collapses remove one or two triangles, so a level may end a few short
+			if (lod.IndexCount % 3 || triangles > target || triangles + 16 < target)
+			{
+				printf("level %u has %u indices, target %u triangles\n", level, lod.IndexCount, target);
+				return false;
+			}
+			if (lod.StartIndex + lod.IndexCount > chain.Indices.size() ||
+				lod.BaseVertex + lod.VertexCount > chain.Vertices.size())
+			{
+				printf("level %u reaches past the shared arrays\n", level);
+				return false;
+			}
+			for (UINT i = lod.StartIndex; i < lod.StartIndex + lod.IndexCount; ++i)
+			{
+				if (chain.Indices[i] >= lod.VertexCount)
+				{
+					printf("level %u index %u is %u, the level has %u vertices\n",
+						level, i - lod.StartIndex, chain.Indices[i], lod.VertexCount);
+					return false;
+				}
+			}
+			if (level > 0 && lod.Error < chain.Lods[level - 1].Error)
+			{
+				printf("level %u error %g is below the error %g of level %u\n",
+					level, lod.Error, chain.Lods[level - 1].Error, level - 1);
+				return false;
+			}
+		}
+
+		//Simplify on its own keeps to the target too
+		GeometryGenerator::MeshData simplified;
+		const UINT target = tcount / 3;
+		MeshSimplifier::Simplify(source, target, simplified);
+		const UINT vcount = static_cast<UINT>(simplified.Vertices.size());
+		if (simplified.Indices.size() / 3 > target ||
+			std::find_if(simplified.Indices.begin(), simplified.Indices.end(), [vcount](UINT i) { return i >= vcount; }) != simplified.Indices.end())
+		{
+			printf("Simplify to %u triangles gave %u, or indices past its %u vertices\n",
+				target, static_cast<UINT>(simplified.Indices.size() / 3), vcount);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool WriteModel(const char* fileName, const GeometryGenerator::MeshData& meshData, UINT badIndex)
+	{
+		FILE* file = 0;
+#if defined(_MSC_VER)
+		if (fopen_s(&file, fileName, "w") != 0)
+			return false;
+#else
+		file = fopen(fileName, "w");
+		if (!file)
+			return false;
+#endif
+
+		fprintf(file, "VertexCount: %u\nTriangleCount: %u\nVertexList (pos, normal)\n{\n",
+			static_cast<UINT>(meshData.Vertices.size()), static_cast<UINT>(meshData.Indices.size() / 3));
+		for (size_t i = 0; i < meshData.Vertices.size(); ++i)
+		{
+			const GeometryGenerator::Vertex& v = meshData.Vertices[i];
+			fprintf(file, "\t%.9g %.9g %.9g %.9g %.9g %.9g\n",
+				v.Position.x, v.Position.y, v.Position.z, v.Normal.x, v.Normal.y, v.Normal.z);
+		}
+		fprintf(file, "}\nTriangleList\n{\n");
+		for (size_t i = 0; i < meshData.Indices.size(); i += 3)
+		{
+			fprintf(file, "\t%u %u %u\n", meshData.Indices[i],
+				i == 0 && badIndex ? badIndex : meshData.Indices[i + 1], meshData.Indices[i + 2]);
+		}
+		fprintf(file, "}\n");
+
+		return fclose(file) == 0;
+	}
+
+	//A model round trip, and a missing and a broken file failing together
+	//with what depends on them while the good model stays loaded
+	bool VerifyAssetLoader(const GeometryGenerator::MeshData& source)
+	{
+		const UINT vcount = static_cast<UINT>(source.Vertices.size());
+		if (!WriteModel("RenderBenchModel.txt", source, 0) || !WriteModel("RenderBenchBroken.txt", source, vcount))
+		{
+			printf("cannot write the test models\n");
+			return false;
+		}
+
+		bool ok = true;
+		{
+			AssetLoader loader;
+			AssetLoader::AssetHandle model = loader.LoadMesh(L"RenderBenchModel.txt");
+			AssetLoader::AssetHandle missing = loader.LoadMesh(L"RenderBenchMissing.txt", JobSystem::PRIORITY_NORMAL);
+			AssetLoader::AssetHandle broken = loader.LoadMesh(L"RenderBenchBroken.txt", JobSystem::PRIORITY_NORMAL);
+			AssetLoader::AssetHandle dependent = loader.LoadMesh(L"RenderBenchModel.txt", JobSystem::PRIORITY_NORMAL, &missing, 1);
+
+			if (!loader.WaitForCritical())
+			{
+				printf("the model failed to load\n");
+				ok = false;
+			}
+			else if (loader.WaitForAll())
+			{
+				printf("waiting for the missing and broken models succeeded\n");
+				ok = false;
+			}
+			else if (loader.GetState(model) != AssetLoader::ASSET_READY || loader.GetState(missing) != AssetLoader::ASSET_FAILED ||
+				loader.GetState(broken) != AssetLoader::ASSET_FAILED || loader.GetState(dependent) != AssetLoader::ASSET_FAILED)
+			{
+				printf("states %d %d %d %d for the model, the missing, the broken and the dependent model\n",
+					loader.GetState(model), loader.GetState(missing), loader.GetState(broken), loader.GetState(dependent));
+				ok = false;
+			}
+			else if (loader.GetMesh(missing) || loader.GetMesh(broken) || loader.GetMesh(dependent) || loader.Progress() != 1.0f)
+			{
+				printf("failed models hand out meshes or loading is not done\n");
+				ok = false;
+			}
+			else
+			{
+				const GeometryGenerator::MeshData* mesh = loader.GetMesh(model);
+				ok = mesh && mesh->Indices == source.Indices && mesh->Vertices.size() == vcount;
+				for (UINT i = 0; ok && i < vcount; ++i)
+				{
+					const GeometryGenerator::Vertex& a = mesh->Vertices[i];
+					const GeometryGenerator::Vertex& b = source.Vertices[i];
+					ok = memcmp(&a.Position, &b.Position, sizeof(a.Position)) == 0 && memcmp(&a.Normal, &b.Normal, sizeof(a.Normal)) == 0;
+				}
+				if (!ok)
+					printf("the loaded model differs from the written one\n");
+			}
+		}
+
+		remove("RenderBenchModel.txt");
+		remove("RenderBenchBroken.txt");
+		return ok;
+	}
+
+	int RunMeshBench(int argc, char* argv[])
+	{
+		UINT slices = 256;
+		UINT iterations = 10;
+		if (argc >= 2)
+		{
+			slices = static_cast<UINT>(strtoul(argv[0], 0, 10));
+			iterations = static_cast<UINT>(strtoul(argv[1], 0, 10));
+		}
+		//Coarser spheres stop at the simplifier's error limit above the 10% level
+		if (slices < 128 || !iterations)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		GeometryGenerator::MeshData sphere;
+		CreateTestSphere(slices, sphere);
+
+		if (!VerifyMeshProcessor(sphere))
+		{
+			printf("MeshProcessor verification failed\n");
+			return 1;
+		}
+
+		//Seams are locked, welded the sphere is closed
+		GeometryGenerator::MeshData welded;
+		WeldPositions(sphere, welded);
+
+		const float ratios[] = { 0.5f, 0.25f, 0.1f };
+		const UINT ratioCount = sizeof(ratios) / sizeof(ratios[0]);
+		MeshSimplifier::LodChain chain;
+		MeshSimplifier::BuildLodChain(welded, ratios, ratioCount, chain);
+		if (!VerifyLodChain(welded, ratios, ratioCount, chain))
+		{
+			printf("MeshSimplifier verification failed\n");
+			return 1;
+		}
+
+		if (!VerifyAssetLoader(sphere))
+		{
+			printf("AssetLoader verification failed\n");
+			return 1;
+		}
+
+		GeometryGenerator::MeshData mesh = sphere;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (UINT it = 0; it < iterations; ++it)
+			MeshProcessor::ComputeNormals(mesh);
+		auto normals = std::chrono::high_resolution_clock::now();
+		for (UINT it = 0; it < iterations; ++it)
+			MeshProcessor::ComputeTangents(mesh);
+		auto tangents = std::chrono::high_resolution_clock::now();
+		for (UINT it = 0; it < iterations; ++it)
+			MeshSimplifier::BuildLodChain(welded, ratios, ratioCount, chain);
+		auto end = std::chrono::high_resolution_clock::now();
+		g_sink = mesh.Vertices[0].TangentU.x + chain.Lods.back().Error;
+
+		printf("%u triangles, %u threads, normals, tangents, LODs and loading verified\n",
+			static_cast<UINT>(sphere.Indices.size() / 3), JobSystem::Default().ThreadCount());
+		printf("normals %.3f ms, tangents %.3f ms, LOD chain %.3f ms\n",
+			std::chrono::duration<double, std::milli>(normals - start).count() / iterations,
+			std::chrono::duration<double, std::milli>(tangents - normals).count() / iterations,
+			std::chrono::duration<double, std::milli>(end - tangents).count() / iterations);
+		for (size_t level = 0; level < chain.Lods.size(); ++level)
+		{
+			printf("  level %u: %6u triangles, %6u vertices, error %g\n", static_cast<UINT>(level),
+				chain.Lods[level].IndexCount / 3, chain.Lods[level].VertexCount, chain.Lods[level].Error);
+		}
+
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (strcmp(argv[1], "queue") == 0)
+		return RunQueueBench(argc - 2, argv + 2);
+
+	if (strcmp(argv[1], "mtqueue") == 0)
+		return RunParallelQueueBench(argc - 2, argv + 2);
+
+	if (strcmp(argv[1], "raster") == 0)
+		return RunRasterBench(argc - 2, argv + 2);
+
+	if (strcmp(argv[1], "lighting") == 0)
+		return RunLightingBench(argc - 2, argv + 2);
+
+	if (strcmp(argv[1], "clusters") == 0)
+		return RunClusterBench(argc - 2, argv + 2);
+
+	if (strcmp(argv[1], "bake") == 0)
+		return RunBakeBench(argc - 2, argv + 2);
+
+	if (strcmp(argv[1], "profiler") == 0)
+		return RunProfilerBench(argc - 2, argv + 2);
+
+	if (strcmp(argv[1], "meshlets") == 0)
+		return RunMeshletBench(argc - 2, argv + 2);
+
+	if (strcmp(argv[1], "cull") == 0)
+		return RunCullBench(argc - 2, argv + 2);
+
+	if (strcmp(argv[1], "ring") == 0)
+		return RunRingBench(argc - 2, argv + 2);
+
+	if (strcmp(argv[1], "instancing") == 0)
+		return RunInstancingBench(argc - 2, argv + 2);
+
+	if (strcmp(argv[1], "mesh") == 0)
+		return RunMeshBench(argc - 2, argv + 2);
+
+	PrintUsage();
+	return 1;
+}
@@ -11,19 +11,36 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
 	ShapesApp  theApp(hInstance);
 
+	//"-softraster" draws on the CPU too and writes the last frame to ShapesDemo.bmp
+	bool softRaster = cmdLine && strstr(cmdLine, "-softraster");
+	if (softRaster)
+		theApp.EnableSoftRaster();
+
+	//"-deferred" records the few instanced draws on deferred contexts anyway,
+	//which the submitter would skip at this scene size
+	if (cmdLine && strstr(cmdLine, "-deferred"))
+		theApp.EnableDeferredContexts();
+
 	if (!theApp.Init())
 		return 0;
 
-	return theApp.Run();
+	int result = theApp.Run();
+
+	if (softRaster)
+		theApp.SaveSoftRasterImage("ShapesDemo.bmp");
+
+	return result;
 }
 
 ShapesApp::ShapesApp(HINSTANCE hInstance)
 	:D3DApp(hInstance),
 	m_shapeVB(0), m_shapeIB(0),
 	m_vertexShader(0), m_pixelShader(0),
-	m_inputLayout(0), m_wireFrameRS(0),
-	m_theta(1.5f*MathHelper::Pi), m_phi(0.1f*MathHelper::Pi), m_radius(15.0f),
-	m_matrixBuffer(0)
+	m_inputLayout(0), m_frameBuffer(0),
+	m_instanceVB(0), m_wireFrameRS(0),
+	m_solid(true), m_deferred(false), m_shapeShader(0), m_shapeMesh(0),
+	m_softRaster(false), m_softBackend(m_softRasterizer),
+	m_theta(1.5f*MathHelper::Pi), m_phi(0.1f*MathHelper::Pi), m_radius(15.0f)
 {
 	m_mainWndCaption = L"Shapes Demo";
 
@@ -72,8 +89,10 @@ ShapesApp::~ShapesApp()
 	ReleaseCOM(m_vertexShader);
 	ReleaseCOM(m_pixelShader);
 	
-	ReleaseCOM(m_matrixBuffer);
+	ReleaseCOM(m_frameBuffer);
+	ReleaseCOM(m_instanceVB);
 
+	m_renderSubmitter.Release();
 }
 
 bool ShapesApp::Init()
@@ -82,6 +101,7 @@ bool ShapesApp::Init()
 		return false;
 
 	BuildGeometryBuffers();
+	BuildRenderItems();
 
 	bool result = BuildShader(L"shape.vs",L"shape.ps");
 	if (!result)
@@ -89,6 +109,18 @@ bool ShapesApp::Init()
 		return false;
 	}
 
+	result = BuildInstanceBuffer();
+	if (!result)
+	{
+		return false;
+	}
+
+	BuildRenderBackend();
+	if (m_softRaster)
+	{
+		BuildSoftRasterBackend();
+	}
+
 	D3D11_RASTERIZER_DESC wireframeDesc;
 	ZeroMemory(&wireframeDesc, sizeof(D3D11_RASTERIZER_DESC));
 	wireframeDesc.FillMode = D3D11_FILL_WIREFRAME;
@@ -107,9 +139,9 @@ bool ShapesApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
 	ID3D10Blob* errorMessage;
 	ID3D10Blob* vertexShaderBuffer;
 	ID3D10Blob* pixelShaderBuffer;
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[2]; //input layout structure
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[6]; //input layout structure
 	unsigned int numElements;
-	D3D11_BUFFER_DESC matrixBufferDesc;
+	D3D11_BUFFER_DESC frameBufferDesc;
 
 	//Initialize the pointers to null
 	errorMessage = 0;
@@ -186,6 +218,18 @@ bool ShapesApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
 	polygonLayout[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	polygonLayout[1].InstanceDataStepRate = 0;
 
+	//The world matrix of the instance, one row per element from slot 1
+	for (UINT i = 0; i < 4; ++i)
+	{
+		polygonLayout[2 + i].SemanticName = "WORLD";
+		polygonLayout[2 + i].SemanticIndex = i;
+		polygonLayout[2 + i].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		polygonLayout[2 + i].InputSlot = 1;
+		polygonLayout[2 + i].AlignedByteOffset = 16 * i;
+		polygonLayout[2 + i].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+		polygonLayout[2 + i].InstanceDataStepRate = 1;
+	}
+
 	//Get a count of the elements in the layout
 	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
 
@@ -204,16 +248,16 @@ bool ShapesApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
 	pixelShaderBuffer->Release();
 	pixelShaderBuffer = 0;
 
-	//Setup the description of the dynamic matrix constant buffer that is in the vertex shader
-	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
-	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixBufferDesc.MiscFlags = 0;
-	matrixBufferDesc.StructureByteStride = 0;
+	//Setup the description of the per frame dynamic constant buffer that is in the vertex shader
+	frameBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	frameBufferDesc.ByteWidth = sizeof(FrameBufferType);
+	frameBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	frameBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	frameBufferDesc.MiscFlags = 0;
+	frameBufferDesc.StructureByteStride = 0;
 
 	//Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class
-	result = m_d3dDevice->CreateBuffer(&matrixBufferDesc, NULL, &m_matrixBuffer);
+	result = m_d3dDevice->CreateBuffer(&frameBufferDesc, NULL, &m_frameBuffer);
 	if (FAILED(result))
 	{
 		return false;
@@ -228,6 +272,11 @@ void ShapesApp::OnResize()
 
 	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 	XMStoreFloat4x4(&m_proj, P);
+
+	if (m_softRaster)
+	{
+		m_softRasterizer.Resize(m_clientWidth, m_clientHeight);
+	}
 }
 
 void ShapesApp::UpdateScene(float dt)
@@ -253,36 +302,68 @@ bool ShapesApp::DrawScene()
 	m_d3dImmediateContext->ClearRenderTargetView(m_renderTargetView, reinterpret_cast<const float*>(&Colors::LightSteelBlue));
 	m_d3dImmediateContext->ClearDepthStencilView(m_depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 
-	bool result;
-
-	RenderBuffers();
-
 	XMMATRIX view = XMLoadFloat4x4(&m_view);
 	XMMATRIX proj = XMLoadFloat4x4(&m_proj);
 
-	XMMATRIX gridWorld = XMLoadFloat4x4(&m_gridWorld);
-	SetShaderParameters(gridWorld, view, proj, m_gridIndexCount,m_gridIndexOffset, m_gridVertexOffset);
+	//Draw only what intersects the view frustum
+	XMFLOAT4 planes[6];
+	ExtractFrustumPlanes(planes, XMMatrixMultiply(view, proj));
+	FrustumCuller::CullAabbs(planes, m_renderItemBounds, m_visibleItems);
 
-	XMMATRIX boxWorld = XMLoadFloat4x4(&m_boxWorld);
-	SetShaderParameters(boxWorld, view, proj, m_boxIndexCount, m_boxIndexOffset, m_boxVertexOffset);
+	if (!SetFrameParameters(view, proj))
+		return false;
 
-	XMMATRIX centerSphereWorld = XMLoadFloat4x4(&m_centerSphere);
-	SetShaderParameters(centerSphereWorld, view, proj, m_sphereIndexCount, m_sphereIndexOffset, m_sphereVertexOffset);
+	//Items sharing a mesh become one instanced draw
+	m_batcher.Clear();
+	for (size_t i = 0; i < m_visibleItems.size(); ++i)
+	{
+		const RenderItem& item = m_renderItems[m_visibleItems[i]];
+		m_batcher.Add(item.Mesh, 0, item.World);
+	}
+	m_batcher.Build();
 
-	XMMATRIX cylWorld[10];
-	XMMATRIX sphereWorld[10];
+	if (!SetInstanceParameters())
+		return false;
 
-	for (int i = 0; i < 10; ++i) 
+	//One packet per batch, all share the shader and the packed buffers.
+	//There are only a few batches, each slice records one of them on a
+	//worker.
+	const std::vector<InstanceBatcher::Batch>& batches = m_batcher.Batches();
+	m_renderQueue.Record(static_cast<UINT>(batches.size()), 1, [this, &batches](UINT begin, UINT end, RenderQueue& queue)
 	{
-		cylWorld[i] = XMLoadFloat4x4(&m_cylWorld[i]);
-		SetShaderParameters(cylWorld[i], view, proj, m_cylinderIndexCount,m_cylinderIndexOffset, m_cylinderVertexOffset);
-
-		sphereWorld[i] = XMLoadFloat4x4(&m_sphereWorld[i]);
-		SetShaderParameters(sphereWorld[i], view, proj, m_sphereIndexCount, m_sphereIndexOffset, m_sphereVertexOffset);
-	}
+		for (UINT i = begin; i < end; ++i)
+		{
+			const InstanceBatcher::Batch& batch = batches[i];
+			const MeshRange& mesh = m_meshes[batch.Mesh];
+
+			DrawPacket packet;
+			packet.Key = RenderQueue::MakeSortKey(0, m_shapeShader, batch.Material, batch.Mesh, 0);
+			packet.Shader = static_cast<UINT16>(m_shapeShader);
+			packet.Material = static_cast<UINT16>(batch.Material);
+			packet.Mesh = static_cast<UINT16>(m_shapeMesh);
+			packet.Constants = DrawPacket::NO_CONSTANTS;
+			packet.IndexCount = mesh.IndexCount;
+			packet.StartIndex = mesh.IndexOffset;
+			packet.BaseVertex = mesh.VertexOffset;
+			packet.InstanceCount = batch.InstanceCount;
+			packet.StartInstance = batch.FirstInstance;
+			queue.Add(packet);
+		}
+	});
 
+	//Deferred contexts start from default state, give them the frame's
+	m_renderSubmitter.Submit(m_renderQueue, m_renderBackend, [this](ID3D11DeviceContext* context)
+	{
+		context->OMSetRenderTargets(1, &m_renderTargetView, m_depthStencilView);
+		context->RSSetViewports(1, &m_screenViewport);
+		context->RSSetState(m_solid ? 0 : m_wireFrameRS);
+		context->VSSetConstantBuffers(0, 1, &m_frameBuffer);
+	});
 
-	//RenderShader();
+	if (m_softRaster)
+	{
+		DrawSoftRaster(XMMatrixMultiply(view, proj));
+	}
 	
 	//End Scene
 	//Present the back buffer to the screen
@@ -299,8 +380,6 @@ bool ShapesApp::DrawScene()
 	return true;
 }
 
-static bool solidFlag = true;
-
 void ShapesApp::OnMouseDown(WPARAM btnState, int x, int y)
 {
 	m_lastMousePos.x = x;
@@ -308,15 +387,15 @@ void ShapesApp::OnMouseDown(WPARAM btnState, int x, int y)
 
 	if ((btnState & MK_MBUTTON) != 0)
 	{
-		if (solidFlag)
+		if (m_solid)
 		{
 			m_d3dImmediateContext->RSSetState(m_wireFrameRS);
-			solidFlag = false;
+			m_solid = false;
 		}
 		else
 		{
 			m_d3dImmediateContext->RSSetState(0);
-			solidFlag = true;
+			m_solid = true;
 		}
 	}
 
@@ -360,6 +439,23 @@ void ShapesApp::OnMouseMove(WPARAM btnState, int x, int y)
 	m_lastMousePos.y = y;
 }
 
+//Axis aligned box around the vertices as center and half extents
+static void ComputeBounds(const GeometryGenerator::MeshData& mesh, XMFLOAT3& center, XMFLOAT3& extents)
+{
+	XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+
+	for (size_t i = 0; i < mesh.Vertices.size(); ++i)
+	{
+		XMVECTOR p = XMLoadFloat3(&mesh.Vertices[i].Position);
+		vMin = XMVectorMin(vMin, p);
+		vMax = XMVectorMax(vMax, p);
+	}
+
+	XMStoreFloat3(&center, 0.5f*(vMin + vMax));
+	XMStoreFloat3(&extents, 0.5f*(vMax - vMin));
+}
+
 bool ShapesApp::BuildGeometryBuffers()
 {
 	GeometryGenerator::MeshData box;
@@ -375,35 +471,26 @@ bool ShapesApp::BuildGeometryBuffers()
 	geoGen.CreateGeosphere(0.5f, 2, sphere);
 	geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, cylinder);
 
-	//Cache the vertex offsets to each object in the concatenated vertex buffer
-	m_boxVertexOffset = 0;
-	m_gridVertexOffset = box.Vertices.size();
-	m_sphereVertexOffset = m_gridVertexOffset + grid.Vertices.size();
-	m_cylinderVertexOffset = m_sphereVertexOffset + sphere.Vertices.size();
-
-	//Cache the index count of each object
-	m_boxIndexCount = box.Indices.size();
-	m_gridIndexCount = grid.Indices.size();
-	m_sphereIndexCount = sphere.Indices.size();
-	m_cylinderIndexCount = cylinder.Indices.size();
-
-	//Cache the starting index for each object in the concatenated index buffer
-	m_boxIndexOffset = 0;
-	m_gridIndexOffset = m_boxIndexCount;
-	m_sphereIndexOffset = m_gridIndexOffset + m_gridIndexCount;
-	m_cylinderIndexOffset = m_sphereIndexOffset + m_sphereIndexCount;
-
-	UINT totalVertexCount = 
-		box.Vertices.size() +
-		grid.Vertices.size() +
-		sphere.Vertices.size() +
-		cylinder.Vertices.size();
-
-	UINT totalIndexCount = 
-		m_boxIndexCount +
-		m_gridIndexCount +
-		m_sphereIndexCount +
-		m_cylinderIndexCount;
+	ComputeBounds(box, m_boxCenter, m_boxExtents);
+	ComputeBounds(grid, m_gridCenter, m_gridExtents);
+	ComputeBounds(sphere, m_sphereCenter, m_sphereExtents);
+	ComputeBounds(cylinder, m_cylinderCenter, m_cylinderExtents);
+
+	//Cache the index count of each object and where its vertices and
+	//indices start in the concatenated buffers, packed in MeshId order
+	const GeometryGenerator::MeshData* meshData[MESH_COUNT] = { &box, &grid, &sphere, &cylinder };
+
+	UINT totalVertexCount = 0;
+	UINT totalIndexCount = 0;
+	for (UINT mesh = 0; mesh < MESH_COUNT; ++mesh)
+	{
+		m_meshes[mesh].IndexCount = static_cast<UINT>(meshData[mesh]->Indices.size());
+		m_meshes[mesh].IndexOffset = totalIndexCount;
+		m_meshes[mesh].VertexOffset = static_cast<int>(totalVertexCount);
+
+		totalVertexCount += static_cast<UINT>(meshData[mesh]->Vertices.size());
+		totalIndexCount += m_meshes[mesh].IndexCount;
+	}
 
 	////Extract the vertex elements we are interested in and pack the 
 	////vertices of all the meshes into one vertex buffer
@@ -471,72 +558,227 @@ bool ShapesApp::BuildGeometryBuffers()
 	iinitData.pSysMem = &indices[0];
 	HR(m_d3dDevice->CreateBuffer(&ibd, &iinitData, &m_shapeIB));
 
+	//The software rasterizer reads the meshes from memory
+	if (m_softRaster)
+	{
+		m_shapeVertices.swap(vertices);
+		m_shapeIndices.swap(indices);
+	}
+
 	return true;
 }
 
-bool ShapesApp::SetShaderParameters(XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, int indexCount,int indexOffset, int vertexOffset)
+//The 22 objects of the scene and their world space bounds.
+//Nothing moves, so the bounds are computed once.
+void ShapesApp::BuildRenderItems()
+{
+	m_renderItems.clear();
+	m_renderItemBounds.Resize(22);
+
+	auto add = [this](const XMFLOAT4X4& world, MeshId mesh, const XMFLOAT3& center, const XMFLOAT3& extents)
+	{
+		RenderItem item;
+		item.World = world;
+		item.Mesh = mesh;
+
+		m_renderItemBounds.Set(static_cast<UINT>(m_renderItems.size()), center, extents, XMLoadFloat4x4(&world));
+		m_renderItems.push_back(item);
+	};
+
+	add(m_gridWorld, MESH_GRID, m_gridCenter, m_gridExtents);
+	add(m_boxWorld, MESH_BOX, m_boxCenter, m_boxExtents);
+	add(m_centerSphere, MESH_SPHERE, m_sphereCenter, m_sphereExtents);
+
+	for (int i = 0; i < 10; ++i)
+	{
+		add(m_cylWorld[i], MESH_CYLINDER, m_cylinderCenter, m_cylinderExtents);
+		add(m_sphereWorld[i], MESH_SPHERE, m_sphereCenter, m_sphereExtents);
+	}
+
+	m_visibleItems.reserve(m_renderItems.size());
+}
+
+//Room for every item, the most a frame can draw
+bool ShapesApp::BuildInstanceBuffer()
+{
+	D3D11_BUFFER_DESC vbd;
+	vbd.Usage = D3D11_USAGE_DYNAMIC;
+	vbd.ByteWidth = sizeof(XMFLOAT4X4)*m_renderItems.size();
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	vbd.MiscFlags = 0;
+	vbd.StructureByteStride = 0;
+
+	HRESULT result = m_d3dDevice->CreateBuffer(&vbd, 0, &m_instanceVB);
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool ShapesApp::SetFrameParameters(XMMATRIX viewMatrix, XMMATRIX projectionMatrix)
 {
 	HRESULT result;
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
-	MatrixBufferType* dataPtr;
+	FrameBufferType* dataPtr;
 	unsigned int bufferNumber;
 
-	//Transpose the matrices to prepare them for the shader
-	worldMatrix = XMMatrixTranspose(worldMatrix);
-	viewMatrix = XMMatrixTranspose(viewMatrix);
-	projectionMatrix = XMMatrixTranspose(projectionMatrix);
-
 	//Lock the constant buffer so it can be written to
-	result = m_d3dImmediateContext->Map(m_matrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	result = m_d3dImmediateContext->Map(m_frameBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
 	if (FAILED(result))
 	{
 		return false;
 	}
 
 	//Get a pointer to the data in the constant buffer
-	dataPtr = (MatrixBufferType*)mappedResource.pData;
-
+	dataPtr = (FrameBufferType*)mappedResource.pData;
 
-	//Copy the matrices into constant buffer
-	dataPtr->world = worldMatrix;
-	dataPtr->view = viewMatrix;
-	dataPtr->projection = projectionMatrix;
+	//Transpose the matrix to prepare it for the shader
+	dataPtr->viewProj = XMMatrixTranspose(XMMatrixMultiply(viewMatrix, projectionMatrix));
 
 	//Unlock the constant buffer
-	m_d3dImmediateContext->Unmap(m_matrixBuffer, 0);
+	m_d3dImmediateContext->Unmap(m_frameBuffer, 0);
 
 	//Set the position of the constant buffer in the vertex shader
 	bufferNumber = 0;
 
 	//Finally set the constant buffer in the vertex shader with the updated values
-	m_d3dImmediateContext->VSSetConstantBuffers(bufferNumber, 1, &m_matrixBuffer);
+	m_d3dImmediateContext->VSSetConstantBuffers(bufferNumber, 1, &m_frameBuffer);
+
+	return true;
+}
 
-	//
-	RenderShader(indexCount,indexOffset,vertexOffset);
-	//
+//Copies the instances of all batches into the instance buffer
+bool ShapesApp::SetInstanceParameters()
+{
+	const std::vector<XMFLOAT4X4>& instances = m_batcher.Instances();
+	if (instances.empty())
+	{
+		return true;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT result = m_d3dImmediateContext->Map(m_instanceVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		return false;
+	}
+
+	memcpy(mappedResource.pData, &instances[0], sizeof(XMFLOAT4X4)*instances.size());
+
+	m_d3dImmediateContext->Unmap(m_instanceVB, 0);
 
 	return true;
 }
 
-void ShapesApp::RenderShader(int indexCount, int indexOffset, int vertexOffset)
+//The shader and the packed buffers, for the packets of DrawScene
+void ShapesApp::BuildRenderBackend()
 {
-	m_d3dImmediateContext->IASetInputLayout(m_inputLayout);
+	m_renderBackend.SetContext(m_d3dImmediateContext);
+
+	D3DRenderBackend::ShaderState shader;
+	shader.InputLayout = m_inputLayout;
+	shader.VertexShader = m_vertexShader;
+	shader.PixelShader = m_pixelShader;
+	m_shapeShader = m_renderBackend.AddShader(shader);
+
+	//Shapes are colored per vertex, material 0 binds nothing
+	D3DRenderBackend::MaterialState material;
+	material.Texture = 0;
+	material.Sampler = 0;
+	m_renderBackend.AddMaterial(material);
+
+	//Slot 0 holds the shapes, slot 1 the world matrix of each instance
+	D3DRenderBackend::MeshState mesh;
+	mesh.VertexBuffer = m_shapeVB;
+	mesh.VertexStride = sizeof(VertexType);
+	mesh.InstanceBuffer = m_instanceVB;
+	mesh.InstanceStride = sizeof(XMFLOAT4X4);
+	mesh.IndexBuffer = m_shapeIB;
+	mesh.IndexFormat = DXGI_FORMAT_R32_UINT;
+	mesh.Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	m_shapeMesh = m_renderBackend.AddMesh(mesh);
+
+	//Falls back to the immediate context by itself when deferred ones are
+	//missing
+	m_renderSubmitter.Init(m_d3dDevice, m_d3dImmediateContext, m_renderBackend);
+	if (m_deferred)
+	{
+		m_renderSubmitter.SetMinDrawsPerContext(0);
+	}
+}
+
+//Mirrors BuildRenderBackend, the ids of both backends are the same
+void ShapesApp::BuildSoftRasterBackend()
+{
+	SoftwareRenderBackend::ShaderState shader;
+	shader.VS = [this](const void* vertex, UINT instance, UINT, UINT, SoftwareRasterizer::ShadedVertex& out)
+	{
+		//shape.vs
+		const VertexType& vin = *static_cast<const VertexType*>(vertex);
+		XMMATRIX world = XMLoadFloat4x4(&m_batcher.Instances()[instance]);
+		XMMATRIX worldViewProj = XMMatrixMultiply(world, XMLoadFloat4x4(&m_softViewProj));
+
+		XMStoreFloat4(&out.Position, XMVector3Transform(XMLoadFloat3(&vin.Pos), worldViewProj));
+		out.Varyings[0] = vin.Color.x;
+		out.Varyings[1] = vin.Color.y;
+		out.Varyings[2] = vin.Color.z;
+		out.Varyings[3] = vin.Color.w;
+	};
+	shader.PS = [](const float* color)
+	{
+		return XMFLOAT4(color[0], color[1], color[2], color[3]);
+	};
+	shader.VaryingCount = 4;
+	shader.CullBack = true;
+	m_softBackend.AddShader(shader);
+
+	SoftwareRenderBackend::MeshState mesh;
+	mesh.Vertices = &m_shapeVertices[0];
+	mesh.VertexStride = sizeof(VertexType);
+	mesh.VertexCount = static_cast<UINT>(m_shapeVertices.size());
+	mesh.Indices = &m_shapeIndices[0];
+	mesh.IndexCount = static_cast<UINT>(m_shapeIndices.size());
+	m_softBackend.AddMesh(mesh);
+
+	m_softRasterizer.Resize(m_clientWidth, m_clientHeight);
+}
 
-	//Set the vertex and pixel shaders that will be used to render this model
-	m_d3dImmediateContext->VSSetShader(m_vertexShader, NULL, 0);
-	m_d3dImmediateContext->PSSetShader(m_pixelShader, NULL, 0);
+//Replays the packets of the frame once more, without touching the stats
+//of the device replay
+void ShapesApp::DrawSoftRaster(CXMMATRIX viewProj)
+{
+	XMStoreFloat4x4(&m_softViewProj, viewProj);
+
+	RenderQueue::Stats stats = {};
+	m_softRasterizer.Clear(XMFLOAT4(reinterpret_cast<const float*>(&Colors::LightSteelBlue)));
+	m_renderQueue.Replay(m_softBackend, 0, m_renderQueue.Count(), stats);
+	m_softRasterizer.Finish();
+}
 
-	m_d3dImmediateContext->DrawIndexed(indexCount, indexOffset, vertexOffset);
+bool ShapesApp::SaveSoftRasterImage(const char* fileName) const
+{
+	return m_softRaster && m_softRasterizer.SaveBitmap(fileName);
 }
 
-void ShapesApp::RenderBuffers()
+std::wstring ShapesApp::FrameStatsText() const
 {
-	UINT stride = sizeof(VertexType);
-	UINT offset = 0;
+	const ParallelRenderQueue::Stats& stats = m_renderQueue.LastStats();
 
-	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	m_d3dImmediateContext->IASetVertexBuffers(0, 1, &m_shapeVB, &stride, &offset);
-	m_d3dImmediateContext->IASetIndexBuffer(m_shapeIB, DXGI_FORMAT_R32_UINT, 0);
+	std::wostringstream outs;
+	outs.precision(3);
+	outs << L"  Draws: " << stats.Replay.Draws
+		<< L"  State changes: " << stats.Replay.StateChanges()
+		<< L"  Record: " << stats.RecordMilliseconds << L" (ms)"
+		<< L"  Slices: " << stats.Slices
+		<< L"  Command lists: " << m_renderSubmitter.LastListCount();
 
-	m_d3dImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	if (m_softRaster)
+	{
+		const SoftwareRasterizer::Stats& raster = m_softRasterizer.LastStats();
+		outs << L"  Software raster: " << raster.SetupMilliseconds + raster.RasterMilliseconds << L" (ms)";
+	}
+	return outs.str();
 }
\ No newline at end of file
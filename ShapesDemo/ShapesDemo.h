@@ -3,6 +3,10 @@
 #include "d3dApp.h"
 #include "GeometryGenerator.h"
 #include "MathHelper.h"
+#include "FrustumCuller.h"
+#include "InstanceBatcher.h"
+#include "D3DRenderBackend.h"
+#include "SoftwareRasterizer.h"
 
 class ShapesApp :public D3DApp
 {
@@ -13,13 +17,36 @@ private:
 		XMFLOAT4 Color;
 	};
 
-	//Constant buffer
-	struct MatrixBufferType
+	//The meshes packed into m_shapeVB and m_shapeIB
+	enum MeshId
 	{
-		XMMATRIX world;
-		XMMATRIX view;
-		XMMATRIX projection;
+		MESH_BOX,
+		MESH_GRID,
+		MESH_SPHERE,
+		MESH_CYLINDER,
+		MESH_COUNT
+	};
+
+	struct MeshRange
+	{
+		UINT IndexCount;
+		UINT IndexOffset;
+		int VertexOffset;
+	};
 
+	//One instance of a shape, culled against the frustum every frame
+	struct RenderItem
+	{
+		XMFLOAT4X4 World;
+		MeshId Mesh;
+	};
+
+	//Constant buffers
+	//Camera, mapped once per frame, slot b0. World matrices come from the
+	//instance buffer.
+	struct FrameBufferType
+	{
+		XMMATRIX viewProj;
 	};
 
 public:
@@ -31,19 +58,31 @@ public:
 	void UpdateScene(float dt);
 	bool DrawScene();
 
+	std::wstring FrameStatsText() const;
+
+	//Draws every frame on the CPU as well, before Init()
+	void EnableSoftRaster() { m_softRaster = true; }
+	bool SaveSoftRasterImage(const char* fileName) const;
+
+	//Submits on deferred contexts whatever the draw count, before Init()
+	void EnableDeferredContexts() { m_deferred = true; }
+
 	void OnMouseDown(WPARAM btnState, int x, int y);
 	void OnMouseUp(WPARAM btnState, int x, int y);
 	void OnMouseMove(WPARAM btnState, int x, int y);
 
 private:
 	bool BuildGeometryBuffers();
+	void BuildRenderItems();
 	
 	bool BuildShader(WCHAR*, WCHAR*);
-	bool SetShaderParameters(XMMATRIX, XMMATRIX, XMMATRIX,int,int,int);
-
-	void RenderShader(int, int, int);
+	bool BuildInstanceBuffer();
+	void BuildRenderBackend();
+	void BuildSoftRasterBackend();
+	void DrawSoftRaster(CXMMATRIX viewProj);
 
-	void RenderBuffers();
+	bool SetFrameParameters(XMMATRIX, XMMATRIX);
+	bool SetInstanceParameters();
 
 private:
 	ID3D11Buffer* m_shapeVB;
@@ -54,7 +93,10 @@ private:
 
 	ID3D11InputLayout *m_inputLayout;
 
-	ID3D11Buffer* m_matrixBuffer;
+	ID3D11Buffer* m_frameBuffer;
+
+	//World matrices of the visible items, one per instance, input slot 1
+	ID3D11Buffer* m_instanceVB;
 	
 	//
 	ID3D11RasterizerState* m_wireFrameRS;
@@ -69,22 +111,42 @@ private:
 	XMFLOAT4X4 m_view;
 	XMFLOAT4X4 m_proj;
 
-	//for draw call
-	int m_boxVertexOffset;
-	int m_gridVertexOffset;
-	int m_sphereVertexOffset;
-	int m_cylinderVertexOffset;
-
-	UINT m_boxIndexOffset;
-	UINT m_gridIndexOffset;
-	UINT m_sphereIndexOffset;
-	UINT m_cylinderIndexOffset;
-
-	UINT m_boxIndexCount;
-	UINT m_gridIndexCount;
-	UINT m_sphereIndexCount;
-	UINT m_cylinderIndexCount;
-
+	//Local bounding boxes of the meshes
+	XMFLOAT3 m_boxCenter, m_boxExtents;
+	XMFLOAT3 m_gridCenter, m_gridExtents;
+	XMFLOAT3 m_sphereCenter, m_sphereExtents;
+	XMFLOAT3 m_cylinderCenter, m_cylinderExtents;
+
+	//Where each mesh lives in m_shapeVB and m_shapeIB
+	MeshRange m_meshes[MESH_COUNT];
+	std::vector<RenderItem> m_renderItems;
+
+	//World space bounds of m_renderItems, same order
+	FrustumCuller::AabbSet m_renderItemBounds;
+	std::vector<UINT> m_visibleItems;
+
+	//Visible items grouped by mesh, one instanced draw each
+	InstanceBatcher m_batcher;
+
+	//The draws of a frame, recorded on the worker threads, merged in key
+	//order and replayed without redundant state, on deferred contexts when
+	//there are enough of them
+	ParallelRenderQueue m_renderQueue;
+	D3DRenderBackend m_renderBackend;
+	D3DParallelSubmitter m_renderSubmitter;
+	bool m_solid;
+	bool m_deferred;
+	UINT m_shapeShader;
+	UINT m_shapeMesh;
+
+	//The same packets replayed into a SoftwareRasterizer, which draws from
+	//CPU copies of the packed buffers
+	bool m_softRaster;
+	SoftwareRasterizer m_softRasterizer;
+	SoftwareRenderBackend m_softBackend;
+	std::vector<VertexType> m_shapeVertices;
+	std::vector<UINT> m_shapeIndices;
+	XMFLOAT4X4 m_softViewProj;
 
 	float m_theta;
 	float m_phi;
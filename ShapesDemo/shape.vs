@@ -1,10 +1,8 @@
 
 
-cbuffer cbPerObject
+cbuffer cbPerFrame : register(b0)
 {
-	matrix worldMatrix;
-	matrix viewMatrix;
-	matrix projectionMatrix;
+	matrix viewProjMatrix;
 };
 
 //////////////////////////////
@@ -14,6 +12,7 @@ struct VertexIn
 {
 	float4 PosL  : POSITION;
 	float4 Color : COLOR;
+	row_major float4x4 World : WORLD;
 };
 
 struct PixelIn
@@ -28,9 +27,8 @@ PixelIn ShapeVertexShader(VertexIn vin)
 	
 	vin.PosL.w=1.0f;
 	
-	vout.PosH = mul(vin.PosL,worldMatrix);
-	vout.PosH = mul(vout.PosH,viewMatrix);
-	vout.PosH = mul(vout.PosH,projectionMatrix);
+	vout.PosH = mul(vin.PosL,vin.World);
+	vout.PosH = mul(vout.PosH,viewProjMatrix);
 	
 	//Store the input color for the pixel shader to use
 	vout.Color = vin.Color;
@@ -1,5 +1,8 @@
 #include"SkullDemo.h"
-#include<fstream>
+#include"AssetLoader.h"
+#include"MeshProcessor.h"
+#include"MeshSimplifier.h"
+#include"MeshletBuilder.h"
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	PSTR cmdLine, int showCmd)
@@ -10,10 +13,20 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
 	SkullApp theApp(hInstance);
 
+	//"-softraster" draws on the CPU too and writes the last frame to SkullDemo.bmp
+	bool softRaster = cmdLine && strstr(cmdLine, "-softraster");
+	if (softRaster)
+		theApp.EnableSoftRaster();
+
 	if (!theApp.Init())
 		return 0;
 
-	return theApp.Run();
+	int result = theApp.Run();
+
+	if (softRaster)
+		theApp.SaveSoftRasterImage("SkullDemo.bmp");
+
+	return result;
 }
 
 SkullApp::SkullApp(HINSTANCE hInstance)
@@ -22,13 +35,15 @@ SkullApp::SkullApp(HINSTANCE hInstance)
 	m_vertexShader(0), m_pixelShader(0),
 	m_inputLayout(0), m_wireframeRS(0),
 	m_theta(1.5f*MathHelper::Pi), m_phi(0.1f*MathHelper::Pi), m_radius(20.0f),
-	m_matrixBuffer(0)
+	m_matrixBuffer(0), m_softRaster(false)
 {
 	m_mainWndCaption = L"Skull Demo";
 
 	m_lastMousePos.x = 0;
 	m_lastMousePos.y = 0;
 
+	m_eyePosW = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
 	XMMATRIX I = XMMatrixIdentity();
 	XMStoreFloat4x4(&m_view, I);
 	XMStoreFloat4x4(&m_proj, I);
@@ -56,9 +71,59 @@ bool SkullApp::Init()
 	if (!D3DApp::Init())
 		return false;
 
-	BuildGeometryBuffers();
+	WCHAR* modelFilename = L"Models/car.txt";
+	WCHAR* vsFilename = L"skull.vs";
+	WCHAR* psFilename = L"skull.ps";
+
+	//Model and both shaders are read and parsed/compiled on the job system in parallel
+	AssetLoader loader;
+	AssetLoader::AssetHandle model = loader.LoadMesh(modelFilename);
+	AssetLoader::AssetHandle vs = loader.LoadShader(vsFilename, "SkullVertexShader", "vs_5_0", D3D10_SHADER_ENABLE_STRICTNESS);
+	AssetLoader::AssetHandle ps = loader.LoadShader(psFilename, "SkullPixelShader", "ps_5_0", D3D10_SHADER_ENABLE_STRICTNESS);
+
+	loader.WaitForCritical();
+
+	if (!loader.GetMesh(model))
+	{
+		MessageBox(0, L"Models/car.txt not found", 0, 0);
+		return false;
+	}
+
+	//Rebuild smooth normals from the triangles, they shade the vertex colors
+	GeometryGenerator::MeshData mesh = *loader.GetMesh(model);
+	MeshProcessor::ComputeNormals(mesh);
+
+	//50%, 25% and 10% of the triangles, all levels in one vertex/index buffer
+	const float lodRatios[3] = { 0.5f, 0.25f, 0.1f };
+	MeshSimplifier::BuildLodChain(mesh, lodRatios, 3, m_skullLods);
 
-	bool result = BuildShader(L"skull.vs", L"skull.ps");
+	if (!BuildGeometryBuffers(m_skullLods))
+	{
+		return false;
+	}
+
+	WCHAR* shaderFilenames[2] = { vsFilename, psFilename };
+	AssetLoader::AssetHandle shaders[2] = { vs, ps };
+	for (int i = 0; i < 2; ++i)
+	{
+		if (!loader.GetShaderBlob(shaders[i]))
+		{
+			//if the shader failed to compile, it should have written something to the errorMessage
+			ID3D10Blob* errorMessage = loader.DetachShaderErrors(shaders[i]);
+			if (errorMessage)
+			{
+				OutputShaderErrorMessage(errorMessage, m_hMainWnd, shaderFilenames[i]);
+			}
+			else
+			{
+				//if there was noting in the error message then it simply could not find the shader file itself
+				MessageBox(m_hMainWnd, shaderFilenames[i], L"missing Shader File", MB_OK);
+			}
+			return false;
+		}
+	}
+
+	bool result = BuildShader(loader.GetShaderBlob(vs), loader.GetShaderBlob(ps));
 	if (!result)
 	{
 		return false;
@@ -82,6 +147,11 @@ void SkullApp::OnResize()
 
 	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 	XMStoreFloat4x4(&m_proj, P);
+
+	if (m_softRaster)
+	{
+		m_softRasterizer.Resize(m_clientWidth, m_clientHeight);
+	}
 }
 
 void SkullApp::UpdateScene(float dt)
@@ -98,59 +168,18 @@ void SkullApp::UpdateScene(float dt)
 
 	XMMATRIX V = XMMatrixLookAtLH(pos, target, up);
 	XMStoreFloat4x4(&m_view, V);
+
+	m_eyePosW = XMFLOAT3(x, y, z);
 }
 
-bool SkullApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
+//The blobs are owned by the asset loader
+bool SkullApp::BuildShader(ID3D10Blob* vertexShaderBuffer, ID3D10Blob* pixelShaderBuffer)
 {
 	HRESULT result;
-	ID3D10Blob* errorMessage;
-	ID3D10Blob* vertexShaderBuffer;
-	ID3D10Blob* pixelShaderBuffer;
 	D3D11_INPUT_ELEMENT_DESC polygonLayout[2]; //input layout structure
 	unsigned int numElements;
 	D3D11_BUFFER_DESC matrixBufferDesc;
 
-	//Initialize the pointers to null
-	errorMessage = 0;
-	vertexShaderBuffer = 0;
-	pixelShaderBuffer = 0;
-
-	//compile the vertex shader code
-	result = D3DCompileFromFile(vsFilename, NULL, NULL, "SkullVertexShader", "vs_5_0", D3D10_SHADER_ENABLE_STRICTNESS,
-		0, &vertexShaderBuffer, &errorMessage);
-	if (FAILED(result))
-	{
-		//if the shader failed to compile, it should have written something to the errorMessage
-		if (errorMessage)
-		{
-			OutputShaderErrorMessage(errorMessage, m_hMainWnd, vsFilename);
-		}
-		else
-		{
-			//if there was noting in the error message then it simply could not find the shader file itself
-			MessageBox(m_hMainWnd, vsFilename, L"missing Shader File", MB_OK);
-		}
-		return false;
-	}
-
-	//compile the pixel shader code
-	result = D3DCompileFromFile(psFilename, NULL, NULL, "SkullPixelShader", "ps_5_0", D3D10_SHADER_ENABLE_STRICTNESS,
-		0, &pixelShaderBuffer, &errorMessage);
-	if (FAILED(result))
-	{
-		//if the shader failed to compile, it should have written something to the errorMessage
-		if (errorMessage)
-		{
-			OutputShaderErrorMessage(errorMessage, m_hMainWnd, psFilename);
-		}
-		else
-		{
-			//if there was noting in the error message then it simply could not find the shader file itself
-			MessageBox(m_hMainWnd, psFilename, L"missing Shader File", MB_OK);
-		}
-		return false;
-	}
-
 	//Create the vertex shader from the buffer
 	result = m_d3dDevice->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(),
 		NULL, &m_vertexShader);
@@ -196,13 +225,6 @@ bool SkullApp::BuildShader(WCHAR* vsFilename, WCHAR* psFilename)
 		return false;
 	}
 
-	//Release the vertex shader buffer and pixel shader buffer since they are no longer needed
-	vertexShaderBuffer->Release();
-	vertexShaderBuffer = 0;
-
-	pixelShaderBuffer->Release();
-	pixelShaderBuffer = 0;
-
 	//Setup the description of the dynamic matrix constant buffer that is in the vertex shader
 	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
 	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
@@ -237,7 +259,28 @@ bool SkullApp::DrawScene()
 	XMMATRIX view = XMLoadFloat4x4(&m_view);
 	XMMATRIX proj = XMLoadFloat4x4(&m_proj);
 
-	SetShaderParameters(world, view, proj, m_indexCount, 0, 0);
+	//Coarser levels as the model gets smaller on screen
+	UINT lod = MeshSimplifier::SelectLod(m_skullLods, world, view, proj, static_cast<float>(m_clientHeight));
+	const MeshSimplifier::Lod& level = m_skullLods.Lods[lod];
+
+	//Only the meshlets of that level facing the eye and inside the frustum
+	m_visibleIndices.clear();
+	UINT indexCount = MeshletBuilder::Cull(m_skullMeshlets[lod], world, XMMatrixMultiply(view, proj), m_eyePosW, m_visibleIndices);
+
+	if (indexCount > 0)
+	{
+		D3D11_MAPPED_SUBRESOURCE mappedResource;
+		HR(m_d3dImmediateContext->Map(m_skullIB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource));
+		memcpy(mappedResource.pData, &m_visibleIndices[0], sizeof(UINT)*indexCount);
+		m_d3dImmediateContext->Unmap(m_skullIB, 0);
+
+		SetShaderParameters(world, view, proj, indexCount, 0, level.BaseVertex);
+	}
+
+	if (m_softRaster)
+	{
+		DrawSoftRaster(XMMatrixMultiply(XMMatrixMultiply(world, view), proj), indexCount, level.BaseVertex);
+	}
 
 
 	//End Scene
@@ -317,52 +360,38 @@ void SkullApp::OnMouseMove(WPARAM btnState, int x, int y)
 	m_lastMousePos.y = y;
 }
 
-bool SkullApp::BuildGeometryBuffers()
+bool SkullApp::BuildGeometryBuffers(MeshSimplifier::LodChain& mesh)
 {
-	std::ifstream fin("Models/car.txt");
+	UINT vcount = static_cast<UINT>(mesh.Vertices.size());
 
-	if (!fin)
-	{
-		MessageBox(0, L"Models/skull.txt not found", 0, 0);
-		return false;
-	}
-
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
-
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
-
-	float nx, ny, nz;
-	XMFLOAT4 black = XMFLOAT4(reinterpret_cast<const float*>(&Colors::Black));
+	//Fixed directional light plus ambient, baked per vertex
+	XMVECTOR lightDir = XMVector3Normalize(XMVectorSet(-0.57735f, 0.57735f, -0.57735f, 0.0f));
+	XMVECTOR silver = Colors::Silver;
 
 	std::vector<VertexType> vertices(vcount);
 	for (UINT i = 0; i < vcount; ++i)
 	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
+		vertices[i].Pos = mesh.Vertices[i].Position;
 
-		vertices[i].Color = black;
+		XMVECTOR n = XMLoadFloat3(&mesh.Vertices[i].Normal);
+		float diffuse = MathHelper::Max(XMVectorGetX(XMVector3Dot(n, lightDir)), 0.0f);
 
-		//Normal not used in this demo
-		fin >> nx >> ny >> nz;
+		XMStoreFloat4(&vertices[i].Color, XMVectorSetW(silver*(0.25f + 0.75f*diffuse), 1.0f));
 	}
 
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
-
-	m_indexCount = 3 * tcount;
-	std::vector<UINT> indices(m_indexCount);
-
-	for (UINT i = 0; i < tcount; ++i)
+	//Split every level into meshlets, the index buffer is refilled each
+	//frame with the visible ones so it only needs room for the largest level
+	m_skullMeshlets.resize(mesh.Lods.size());
+	UINT indexCount = 0;
+	for (size_t i = 0; i < mesh.Lods.size(); ++i)
 	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-	}
-
-	fin.close();
+		const MeshSimplifier::Lod& level = mesh.Lods[i];
+		MeshletBuilder::Build(&mesh.Vertices[level.BaseVertex], level.VertexCount,
+			&mesh.Indices[level.StartIndex], level.IndexCount, m_skullMeshlets[i]);
 
+		indexCount = MathHelper::Max(indexCount, level.IndexCount);
+	}
+	m_visibleIndices.reserve(indexCount);
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
@@ -374,19 +403,85 @@ bool SkullApp::BuildGeometryBuffers()
 	vinitData.pSysMem = &vertices[0];
 	HR(m_d3dDevice->CreateBuffer(&vbd, &vinitData, &m_skullVB));
 
+	//The software rasterizer reads the vertices from memory
+	if (m_softRaster)
+	{
+		m_skullVertices.swap(vertices);
+	}
+
 	D3D11_BUFFER_DESC ibd;
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT)*m_indexCount;
+	ibd.Usage = D3D11_USAGE_DYNAMIC;
+	ibd.ByteWidth = sizeof(UINT)*indexCount;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibd.CPUAccessFlags = 0;
+	ibd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 	ibd.MiscFlags = 0;
-	D3D11_SUBRESOURCE_DATA iinitData;
-	iinitData.pSysMem = &indices[0];
-	HR(m_d3dDevice->CreateBuffer(&ibd, &iinitData, &m_skullIB));
+	HR(m_d3dDevice->CreateBuffer(&ibd, NULL, &m_skullIB));
+
+	//Only the level table is needed from now on
+	std::vector<GeometryGenerator::Vertex>().swap(mesh.Vertices);
+	std::vector<UINT>().swap(mesh.Indices);
 
 	return true;
 }
 
+//skull.vs and skull.ps on the CPU, over the visible meshlets of the level
+void SkullApp::DrawSoftRaster(CXMMATRIX worldViewProj, UINT indexCount, UINT baseVertex)
+{
+	XMFLOAT4X4 transform;
+	XMStoreFloat4x4(&transform, worldViewProj);
+
+	m_softRasterizer.Clear(XMFLOAT4(reinterpret_cast<const float*>(&Colors::LightSteelBlue)));
+
+	if (indexCount > 0)
+	{
+		SoftwareRasterizer::DrawCall draw;
+		draw.Vertices = &m_skullVertices[0];
+		draw.VertexStride = sizeof(VertexType);
+		draw.VertexCount = static_cast<UINT>(m_skullVertices.size());
+		draw.Indices = &m_visibleIndices[0];
+		draw.IndexCount = indexCount;
+		draw.StartIndex = 0;
+		draw.BaseVertex = baseVertex;
+		draw.Instance = 0;
+		draw.VS = [&transform](const void* vertex, UINT, SoftwareRasterizer::ShadedVertex& out)
+		{
+			const VertexType& vin = *static_cast<const VertexType*>(vertex);
+			XMStoreFloat4(&out.Position, XMVector3Transform(XMLoadFloat3(&vin.Pos), XMLoadFloat4x4(&transform)));
+			out.Varyings[0] = vin.Color.x;
+			out.Varyings[1] = vin.Color.y;
+			out.Varyings[2] = vin.Color.z;
+			out.Varyings[3] = vin.Color.w;
+		};
+		draw.PS = [](const float* color)
+		{
+			return XMFLOAT4(color[0], color[1], color[2], color[3]);
+		};
+		draw.VaryingCount = 4;
+		draw.CullBack = true;
+		m_softRasterizer.Draw(draw);
+	}
+
+	m_softRasterizer.Finish();
+}
+
+bool SkullApp::SaveSoftRasterImage(const char* fileName) const
+{
+	return m_softRaster && m_softRasterizer.SaveBitmap(fileName);
+}
+
+std::wstring SkullApp::FrameStatsText() const
+{
+	if (!m_softRaster)
+		return std::wstring();
+
+	const SoftwareRasterizer::Stats& raster = m_softRasterizer.LastStats();
+
+	std::wostringstream outs;
+	outs.precision(3);
+	outs << L"  Software raster: " << raster.SetupMilliseconds + raster.RasterMilliseconds << L" (ms)";
+	return outs.str();
+}
+
 bool SkullApp::SetShaderParameters(XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projectionMatrix,
 	int indexCount, int indexOffset, int vertexOffset)
 {
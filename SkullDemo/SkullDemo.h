@@ -3,6 +3,9 @@
 #include"d3dApp.h"
 #include"GeometryGenerator.h"
 #include"MathHelper.h"
+#include"MeshSimplifier.h"
+#include"MeshletBuilder.h"
+#include"SoftwareRasterizer.h"
 
 class SkullApp :public D3DApp
 {
@@ -29,20 +32,28 @@ public:
 	void UpdateScene(float dt);
 	bool DrawScene();
 
+	std::wstring FrameStatsText() const;
+
+	//Draws every frame on the CPU as well, before Init()
+	void EnableSoftRaster() { m_softRaster = true; }
+	bool SaveSoftRasterImage(const char* fileName) const;
+
 	void OnMouseDown(WPARAM btnState, int x, int y);
 	void OnMouseUp(WPARAM btnState, int x, int y);
 	void OnMouseMove(WPARAM btnState, int x, int y);
 
 private:
-	bool BuildGeometryBuffers();
+	bool BuildGeometryBuffers(MeshSimplifier::LodChain&);
 
-	bool BuildShader(WCHAR*, WCHAR*);
+	bool BuildShader(ID3D10Blob*, ID3D10Blob*);
 	bool SetShaderParameters(XMMATRIX, XMMATRIX, XMMATRIX, int, int, int);
 
 	void RenderShader(int, int, int);
 
 	void RenderBuffers();
 
+	void DrawSoftRaster(CXMMATRIX worldViewProj, UINT indexCount, UINT baseVertex);
+
 private:
 	ID3D11Buffer* m_skullVB;
 	ID3D11Buffer* m_skullIB;
@@ -54,7 +65,17 @@ private:
 
 	ID3D11Buffer* m_matrixBuffer;
 
-	int m_indexCount;
+	MeshSimplifier::LodChain m_skullLods;
+
+	//One meshlet set per LOD level, culled into m_visibleIndices every frame
+	std::vector<MeshletBuilder::MeshletMesh> m_skullMeshlets;
+	std::vector<UINT> m_visibleIndices;
+
+	//m_visibleIndices drawn once more by a SoftwareRasterizer, from a CPU
+	//copy of the vertex buffer
+	bool m_softRaster;
+	SoftwareRasterizer m_softRasterizer;
+	std::vector<VertexType> m_skullVertices;
 
 	ID3D11RasterizerState* m_wireframeRS;
 
@@ -63,6 +84,8 @@ private:
 
 	XMFLOAT4X4 m_world;
 
+	XMFLOAT3 m_eyePosW;
+
 	float m_theta;
 	float m_phi;
 	float m_radius;
@@ -247,8 +247,12 @@ void WavesApp::UpdateScene(float dt)
 		m_waves.Disturb(i, j, r);
 	}
 
-	m_waves.Update(dt);
+	{
+		PROFILE_SCOPE("Waves update");
+		m_waves.Update(dt);
+	}
 
+	PROFILE_SCOPE("Waves buffer");
 	D3D11_MAPPED_SUBRESOURCE mappedData;
 	HR(m_d3dImmediateContext->Map(m_wavesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
 
@@ -304,14 +308,17 @@ bool WavesApp::DrawScene()
 
 	//End Scene
 	//Present the back buffer to the screen
-	if (VSYNC_ENABLED)
 	{
-		HR(m_swapChain->Present(1, 0));
-	}
-	else
-	{
-		//Present as fast as possible
-		HR(m_swapChain->Present(0, 0));
+		PROFILE_SCOPE("Present");
+		if (VSYNC_ENABLED)
+		{
+			HR(m_swapChain->Present(1, 0));
+		}
+		else
+		{
+			//Present as fast as possible
+			HR(m_swapChain->Present(0, 0));
+		}
 	}
 
 	return true;